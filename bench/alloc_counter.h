@@ -0,0 +1,16 @@
+#ifndef XIAOZI_BENCH_ALLOC_COUNTER_H_
+#define XIAOZI_BENCH_ALLOC_COUNTER_H_
+
+#include <cstdint>
+
+namespace xiaozi::bench {
+
+// Totals over every global operator new call in the process, all threads.
+// Only the bench executable replaces operator new; the library itself is
+// never built with these hooks.
+uint64_t alloc_count();
+uint64_t alloc_bytes();
+
+}  // namespace xiaozi::bench
+
+#endif  // XIAOZI_BENCH_ALLOC_COUNTER_H_
@@ -0,0 +1,123 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+#include "alloc_counter.h"
+
+namespace xiaozi::bench {
+namespace {
+
+uint64_t now_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+constexpr uint64_t kMaxIterations = 1000000000;
+
+}  // namespace
+
+void State::pause_timing() {
+  if (!running_) return;
+  elapsed_ns_ += now_ns() - start_ns_;
+  allocs_ += alloc_count() - start_allocs_;
+  bytes_ += alloc_bytes() - start_bytes_;
+  running_ = false;
+}
+
+void State::resume_timing() {
+  if (running_) return;
+  running_ = true;
+  start_allocs_ = alloc_count();
+  start_bytes_ = alloc_bytes();
+  start_ns_ = now_ns();
+}
+
+State::Iterator State::begin() {
+  resume_timing();
+  return Iterator(this, iterations_);
+}
+
+void State::finish() { pause_timing(); }
+
+std::vector<Case>& registry() {
+  static std::vector<Case> cases;
+  return cases;
+}
+
+Registrar::Registrar(const char* name, Function fn) {
+  registry().push_back(Case{name, fn});
+}
+
+Result run(const Case& c, uint64_t min_time_ns) {
+  uint64_t n = 1;
+  for (;;) {
+    State state(n);
+    c.fn(state);
+    if (state.skipped()) {
+      Result r;
+      r.name = c.name;
+      r.skip_reason = state.skip_reason();
+      return r;
+    }
+    uint64_t elapsed = std::max<uint64_t>(state.elapsed_ns(), 1);
+    if (elapsed >= min_time_ns || n >= kMaxIterations) {
+      Result r;
+      r.name = c.name;
+      r.iterations = n;
+      r.ns_per_op = static_cast<double>(elapsed) / static_cast<double>(n);
+      r.bytes_per_op =
+          static_cast<double>(state.allocated_bytes()) / static_cast<double>(n);
+      r.allocs_per_op =
+          static_cast<double>(state.allocations()) / static_cast<double>(n);
+      return r;
+    }
+    // Same growth rule as Go's testing package: aim 20% past the target,
+    // never more than 100x per step, so a warm cache on the first few runs
+    // does not overshoot by orders of magnitude.
+    double per_op = static_cast<double>(elapsed) / static_cast<double>(n);
+    auto predicted =
+        static_cast<uint64_t>(static_cast<double>(min_time_ns) * 1.2 / per_op);
+    n = std::clamp<uint64_t>(predicted, n + 1, n * 100);
+    n = std::min(n, kMaxIterations);
+  }
+}
+
+std::string format_result(const Result& r) {
+  if (!r.skip_reason.empty()) {
+    return "# " + r.name + " skipped: " + r.skip_reason;
+  }
+  char line[256];
+  std::snprintf(line, sizeof(line),
+                "%-48s %12" PRIu64 " %14.2f ns/op %12.2f B/op %10.3f allocs/op",
+                r.name.c_str(), r.iterations, r.ns_per_op, r.bytes_per_op,
+                r.allocs_per_op);
+  return line;
+}
+
+bool parse_result(std::string_view line, Result* r) {
+  if (line.empty() || line.front() == '#') return false;
+  char name[128];
+  uint64_t iterations;
+  double ns, bytes, allocs;
+  char tail[2];
+  const std::string copy(line);
+  if (std::sscanf(copy.c_str(),
+                  "%127s %" SCNu64 " %lf ns/op %lf B/op %lf allocs/op %1s",
+                  name, &iterations, &ns, &bytes, &allocs, tail) != 5) {
+    return false;
+  }
+  r->name = name;
+  r->iterations = iterations;
+  r->ns_per_op = ns;
+  r->bytes_per_op = bytes;
+  r->allocs_per_op = allocs;
+  r->skip_reason.clear();
+  return true;
+}
+
+}  // namespace xiaozi::bench
@@ -0,0 +1,141 @@
+#ifndef XIAOZI_BENCH_BENCH_H_
+#define XIAOZI_BENCH_BENCH_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace xiaozi::bench {
+
+// Handed to every benchmark body. The body runs the measured operation
+// exactly iterations() times, normally as `for (auto _ : state) { ... }`.
+// Timing and allocation counting start at the first iteration and stop after
+// the last one, so setup before the loop is not measured.
+class State {
+ public:
+  explicit State(uint64_t iterations) : iterations_(iterations) {}
+
+  uint64_t iterations() const { return iterations_; }
+
+  // Brackets per-iteration setup that must not be measured.
+  void pause_timing();
+  void resume_timing();
+
+  // Marks the case as not applicable on this machine (e.g. an instruction
+  // set the CPU lacks). Call before the loop and return.
+  void skip(std::string reason) { skip_reason_ = std::move(reason); }
+  bool skipped() const { return !skip_reason_.empty(); }
+  const std::string& skip_reason() const { return skip_reason_; }
+
+  struct [[maybe_unused]] Value {};
+  class Iterator {
+   public:
+    Iterator(State* state, uint64_t remaining)
+        : state_(state), remaining_(remaining) {}
+    Value operator*() const { return {}; }
+    Iterator& operator++() {
+      --remaining_;
+      return *this;
+    }
+    bool operator!=(const Iterator&) {
+      if (remaining_ != 0) return true;
+      state_->finish();
+      return false;
+    }
+
+   private:
+    State* state_;
+    uint64_t remaining_;
+  };
+
+  Iterator begin();
+  Iterator end() { return Iterator(this, 0); }
+
+  uint64_t elapsed_ns() const { return elapsed_ns_; }
+  uint64_t allocations() const { return allocs_; }
+  uint64_t allocated_bytes() const { return bytes_; }
+
+ private:
+  void finish();
+
+  uint64_t iterations_;
+  bool running_ = false;
+  uint64_t start_ns_ = 0;
+  uint64_t start_allocs_ = 0;
+  uint64_t start_bytes_ = 0;
+  uint64_t elapsed_ns_ = 0;
+  uint64_t allocs_ = 0;
+  uint64_t bytes_ = 0;
+  std::string skip_reason_;
+};
+
+using Function = void (*)(State&);
+
+struct Case {
+  std::string name;
+  Function fn;
+};
+
+// All registered cases, in registration order. The runner sorts them by name
+// so the output order does not depend on link order.
+std::vector<Case>& registry();
+
+struct Registrar {
+  Registrar(const char* name, Function fn);
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations = 0;
+  double ns_per_op = 0;
+  double bytes_per_op = 0;
+  double allocs_per_op = 0;
+  // Non-empty if the case called State::skip(); the numbers are then unset.
+  std::string skip_reason;
+};
+
+// Grows the iteration count until one run takes at least min_time_ns.
+Result run(const Case& c, uint64_t min_time_ns);
+
+// One line per case, whitespace separated:
+//   <name> <iterations> <ns> ns/op <bytes> B/op <allocs> allocs/op
+// Names never contain whitespace; the format is part of the release diffing
+// workflow, so change it only together with the tooling that parses it.
+// Skipped cases become a `# <name> skipped: <reason>` comment line.
+std::string format_result(const Result& r);
+
+// The inverse of format_result() for a measured case. False for comment
+// lines (skipped cases included) and anything malformed.
+bool parse_result(std::string_view line, Result* r);
+
+// Keeps the compiler from discarding a computed value or a buffer write.
+template <typename T>
+inline void do_not_optimize(T const& value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+inline void clobber_memory() {
+#if defined(__GNUC__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+}  // namespace xiaozi::bench
+
+#define XIAOZI_BENCH_CONCAT_(a, b) a##b
+#define XIAOZI_BENCH_CONCAT(a, b) XIAOZI_BENCH_CONCAT_(a, b)
+
+// Registers `fn` under `name`. Use "<area>/<case>" names, e.g.
+// "alloc/new_pcm_20ms", so related cases sort together.
+#define XIAOZI_BENCH(name, fn)                                      \
+  static const ::xiaozi::bench::Registrar XIAOZI_BENCH_CONCAT(      \
+      xiaozi_bench_registrar_, __COUNTER__)(name, fn)
+
+#endif  // XIAOZI_BENCH_BENCH_H_
@@ -0,0 +1,50 @@
+// Heap baselines for the per-frame buffers the audio and network paths need.
+// These are the numbers the pooled allocators are measured against.
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "bench.h"
+
+namespace xiaozi::bench {
+namespace {
+
+// 20 ms of 16 kHz mono PCM and a typical 60 ms Opus packet.
+constexpr size_t kPcm20msSamples = 320;
+constexpr size_t kOpusPacketBytes = 120;
+
+void new_pcm_20ms(State& state) {
+  for (auto _ : state) {
+    auto* pcm = new int16_t[kPcm20msSamples];
+    do_not_optimize(pcm);
+    delete[] pcm;
+  }
+}
+XIAOZI_BENCH("alloc/new_pcm_20ms", new_pcm_20ms);
+
+void vector_opus_packet(State& state) {
+  uint8_t payload[kOpusPacketBytes];
+  std::memset(payload, 0x5a, sizeof(payload));
+  for (auto _ : state) {
+    std::vector<uint8_t> packet(payload, payload + sizeof(payload));
+    do_not_optimize(packet.data());
+  }
+}
+XIAOZI_BENCH("alloc/vector_opus_packet", vector_opus_packet);
+
+// Capture -> encoder -> sender handoff as it works with shared_ptr buffers:
+// one control block plus one buffer allocation per frame.
+void shared_pcm_handoff(State& state) {
+  for (auto _ : state) {
+    auto frame = std::make_shared<std::vector<int16_t>>(kPcm20msSamples);
+    auto encoder_ref = frame;
+    auto sender_ref = encoder_ref;
+    do_not_optimize(sender_ref->data());
+  }
+}
+XIAOZI_BENCH("alloc/shared_pcm_handoff", shared_pcm_handoff);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,235 @@
+// Boot-time asset loading: decoding the source formats into heap buffers
+// (what the firmware did before asset packs) against mapping a pack built
+// by AssetPackWriter and looking the same assets up in place. The font is a
+// synthetic 16 px BDF with 3000 glyphs, the images are one opaque 240x240
+// P6 and one 64x64 P7 with alpha. Glyph lookups are timed separately,
+// against the unordered_map a heap-decoded font would be indexed by. The
+// pack must hold exactly what the sources decode to; a mismatch aborts.
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "assets/asset_pack.h"
+#include "assets/asset_pack_writer.h"
+#include "assets/asset_sources.h"
+#include "bench.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr uint32_t kFirstCodepoint = 0x4e00;
+constexpr int kGlyphs = 3000;
+
+// The text a status screen renders per frame.
+constexpr uint32_t kText[] = {0x4e00, 0x4e8c, 0x4e09, 0x56db, 0x4e94,
+                              0x516d, 0x4e03, 0x516b, 0x4e5d, 0x5341};
+
+std::string make_bdf() {
+  std::string s =
+      "STARTFONT 2.1\nFONT synthetic\nSIZE 16 75 75\n"
+      "FONTBOUNDINGBOX 16 16 0 -2\nSTARTPROPERTIES 2\nFONT_ASCENT 14\n"
+      "FONT_DESCENT 2\nENDPROPERTIES\n";
+  s += "CHARS " + std::to_string(kGlyphs) + "\n";
+  char line[64];
+  for (int i = 0; i < kGlyphs; ++i) {
+    const uint32_t cp = kFirstCodepoint + i;
+    std::snprintf(line, sizeof(line), "STARTCHAR u%04X\nENCODING %u\n", cp,
+                  cp);
+    s += line;
+    s += "SWIDTH 1000 0\nDWIDTH 16 0\nBBX 16 16 0 -2\nBITMAP\n";
+    for (int row = 0; row < 16; ++row) {
+      std::snprintf(line, sizeof(line), "%04X\n",
+                    (cp * 2654435761u >> row) & 0xffff);
+      s += line;
+    }
+    s += "ENDCHAR\n";
+  }
+  s += "ENDFONT\n";
+  return s;
+}
+
+std::vector<uint8_t> make_ppm(int w, int h) {
+  const std::string header =
+      "P6\n# synthetic\n" + std::to_string(w) + " " + std::to_string(h) +
+      "\n255\n";
+  std::vector<uint8_t> out(header.begin(), header.end());
+  for (int i = 0; i < w * h * 3; ++i) out.push_back(uint8_t(i * 7 + i / w));
+  return out;
+}
+
+std::vector<uint8_t> make_pam(int w, int h) {
+  const std::string header = "P7\nWIDTH " + std::to_string(w) + "\nHEIGHT " +
+                             std::to_string(h) +
+                             "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\n"
+                             "ENDHDR\n";
+  std::vector<uint8_t> out(header.begin(), header.end());
+  for (int i = 0; i < w * h * 4; ++i) out.push_back(uint8_t(i * 13 + 5));
+  return out;
+}
+
+struct Sources {
+  std::string bdf = make_bdf();
+  std::vector<uint8_t> background = make_ppm(240, 240);
+  std::vector<uint8_t> icon = make_pam(64, 64);
+};
+
+const Sources& sources() {
+  static const Sources s;
+  return s;
+}
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: asset pack %s\n", what);
+  std::abort();
+}
+
+bool same_image(const DecodedImage& d, const ImageView& v) {
+  if (v.width != d.width || v.height != d.height ||
+      v.alpha.size() != d.alpha.size() ||
+      // An opaque image has no alpha, and memcmp() may not see null.
+      (!d.alpha.empty() &&
+       std::memcmp(v.alpha.data(), d.alpha.data(), d.alpha.size()) != 0)) {
+    return false;
+  }
+  for (std::size_t y = 0; y < d.height; ++y) {
+    if (std::memcmp(&v.pixels[y * v.stride], &d.rgb565[y * d.width],
+                    std::size_t{d.width} * 2) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Outlives every static object, so the atexit handler can still use it.
+char pack_file[] = "/tmp/xiaozi_bench_assets_XXXXXX";
+
+// Builds the pack from the sources once, writes it under /tmp and checks
+// every asset against its decoded source.
+const char* pack_path() {
+  static const char* path = [] {
+    const Sources& src = sources();
+    const auto font = parse_bdf(src.bdf);
+    const auto background = parse_pnm(src.background);
+    const auto icon = parse_pnm(src.icon);
+    if (!font || !background || !icon) fail("sources do not decode");
+
+    AssetPackWriter writer;
+    if (!writer.add_font("font/ui16", *font) ||
+        !writer.add_image("image/background", *background) ||
+        !writer.add_image("image/icon", *icon)) {
+      fail("writer rejected an asset");
+    }
+    const auto bytes = writer.finish();
+    if (!bytes) fail("writer failed");
+
+    const int fd = mkstemp(pack_file);
+    if (fd < 0 || write(fd, bytes->data(), bytes->size()) !=
+                      static_cast<ssize_t>(bytes->size())) {
+      fail("could not be written to /tmp");
+    }
+    close(fd);
+    std::atexit([] { unlink(pack_file); });
+
+    const auto pack = AssetPack::open(pack_file);
+    if (!pack) fail("does not open");
+    const auto view = pack->font("font/ui16");
+    if (!view || view->size() != font->glyphs.size() ||
+        view->line_height() != font->line_height ||
+        view->ascent() != font->ascent) {
+      fail("font header differs");
+    }
+    for (const DecodedGlyph& g : font->glyphs) {
+      const auto p = view->find(g.codepoint);
+      if (!p || p->metrics->width != g.width ||
+          p->metrics->height != g.height ||
+          p->metrics->x_offset != g.x_offset ||
+          p->metrics->y_offset != g.y_offset ||
+          p->metrics->advance != g.advance ||
+          p->bitmap.size() != g.bitmap.size() ||
+          std::memcmp(p->bitmap.data(), g.bitmap.data(), g.bitmap.size())) {
+        fail("glyph differs");
+      }
+    }
+    const auto bg = pack->image("image/background");
+    const auto ic = pack->image("image/icon");
+    if (!bg || !ic || !same_image(*background, *bg) ||
+        !same_image(*icon, *ic)) {
+      fail("image differs");
+    }
+    if (pack->find("image/missing") != nullptr || pack->clip("image/icon")) {
+      fail("lookup misbehaves");
+    }
+    return pack_file;
+  }();
+  return path;
+}
+
+// The pre-pack boot: decode every source and index the font.
+void BM_BootDecode(State& state) {
+  const Sources& src = sources();
+  for (auto _ : state) {
+    auto font = parse_bdf(src.bdf);
+    auto background = parse_pnm(src.background);
+    auto icon = parse_pnm(src.icon);
+    std::unordered_map<uint32_t, const DecodedGlyph*> index;
+    index.reserve(font->glyphs.size());
+    for (const DecodedGlyph& g : font->glyphs) index.emplace(g.codepoint, &g);
+    do_not_optimize(index.size());
+    do_not_optimize(background->rgb565.data());
+    do_not_optimize(icon->alpha.data());
+  }
+}
+
+// Map the pack, find the same assets and draw one line of text's worth of
+// glyphs, so the pages a first frame needs are faulted in too.
+void BM_BootMapped(State& state) {
+  const char* path = pack_path();
+  for (auto _ : state) {
+    auto pack = AssetPack::open(path);
+    auto font = pack->font("font/ui16");
+    auto background = pack->image("image/background");
+    auto icon = pack->image("image/icon");
+    uint32_t sum = 0;
+    for (uint32_t cp : kText) sum += font->find(cp)->bitmap[0];
+    do_not_optimize(sum);
+    do_not_optimize(background->pixels.data());
+    do_not_optimize(icon->alpha.data());
+  }
+}
+
+void BM_GlyphFindHeap(State& state) {
+  const auto font = parse_bdf(sources().bdf);
+  std::unordered_map<uint32_t, const DecodedGlyph*> index;
+  for (const DecodedGlyph& g : font->glyphs) index.emplace(g.codepoint, &g);
+  for (auto _ : state) {
+    uint32_t sum = 0;
+    for (uint32_t cp : kText) sum += index.find(cp)->second->bitmap[0];
+    do_not_optimize(sum);
+  }
+}
+
+void BM_GlyphFindPacked(State& state) {
+  const auto pack = AssetPack::open(pack_path());
+  const auto font = pack->font("font/ui16");
+  for (auto _ : state) {
+    uint32_t sum = 0;
+    for (uint32_t cp : kText) sum += font->find(cp)->bitmap[0];
+    do_not_optimize(sum);
+  }
+}
+
+XIAOZI_BENCH("assets/boot/decode_sources", BM_BootDecode);
+XIAOZI_BENCH("assets/boot/map_pack", BM_BootMapped);
+XIAOZI_BENCH("assets/glyph_find_10/heap_map", BM_GlyphFindHeap);
+XIAOZI_BENCH("assets/glyph_find_10/packed", BM_GlyphFindPacked);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,316 @@
+// Adaptive bitrate on a simulated contended Wi-Fi uplink: each packet pays
+// a fixed airtime on top of its bytes, so long packets are cheaper per
+// second of audio. ns/op is one 500 ms controller tick, simulation
+// included; `update` is the controller alone.
+//
+// Checks before timing, any failure aborts: the controller steps down on
+// the first tick of congestion, settles on the rung that fits without
+// bouncing, keeps queueing delay far below a fixed 32 kbit/s, 20 ms
+// sender, recovers once the link clears but only after its hold-off,
+// which doubles after a failed probe, toggles FEC with loss, and
+// EncoderStage sends multi-frame packets.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "base/clock.h"
+#include "bench.h"
+#include "codec/bitrate_controller.h"
+#include "codec/encoder_stage.h"
+#include "codec/g711_codec.h"
+#include "memory/frame_pool.h"
+#include "net/packet_sink.h"
+#include "net/transport.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr uint64_t kTickNs = 500000000;
+constexpr uint64_t kHeaderBytes = 54;  // IPv4 + TCP + WebSocket
+constexpr uint64_t kAirtimeNs = 2000000;
+// The sender gives up on audio older than this.
+constexpr uint64_t kMaxQueueNs = 400000000;
+constexpr uint32_t kBaseRttUs = 30000;
+
+constexpr uint64_t kFastLinkBps = 100000;
+constexpr uint64_t kSlowLinkBps = 40000;
+// The highest rung that fits kSlowLinkBps.
+constexpr int kFittingRung = 2;
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: bitrate %s\n", what);
+  std::abort();
+}
+
+// The uplink as the transport would report it: a FIFO served at
+// `capacity_bps` plus kAirtimeNs per packet, one TCP segment each, and
+// random loss that costs a retransmission.
+class SimulatedLink {
+ public:
+  uint64_t capacity_bps = kFastLinkBps;
+  uint32_t loss_per_mille = 0;
+
+  // Sends one tick of audio at `bitrate` in `frame_ms` packets.
+  void tick(int bitrate, int frame_ms) {
+    const uint64_t interval = static_cast<uint64_t>(frame_ms) * 1000000;
+    const uint64_t payload = static_cast<uint64_t>(bitrate) *
+                             static_cast<uint64_t>(frame_ms) / 8000;
+    const uint64_t airtime =
+        kAirtimeNs + (payload + kHeaderBytes) * 8 * 1000000000 / capacity_bps;
+    const uint64_t end = now_ + kTickNs;
+    uint32_t waiting = 0;
+    for (uint64_t t = now_; t < end; t += interval) {
+      const uint64_t start = std::max(t, link_free_ns_);
+      if (start - t > kMaxQueueNs) {
+        ++stats_.packets_dropped;
+        continue;
+      }
+      link_free_ns_ = start + airtime;
+      ++stats_.segments_sent;
+      if (next_random() % 1000 < loss_per_mille) {
+        ++stats_.retransmits;
+        ++stats_.segments_sent;
+        link_free_ns_ += airtime;
+      }
+      if (start > end) ++waiting;
+      ++stats_.packets_sent;
+      stats_.bytes_sent += payload;
+      stats_.queue_delay_total_ns += start - t;
+    }
+    now_ = end;
+    stats_.queue_depth = waiting;
+    const uint64_t backlog = link_free_ns_ > now_ ? link_free_ns_ - now_ : 0;
+    stats_.rtt_us = kBaseRttUs + static_cast<uint32_t>(backlog / 1000);
+  }
+
+  const TransportStats& stats() const { return stats_; }
+  double mean_queue_delay_ms() const {
+    return stats_.mean_queue_delay_us() / 1000.0;
+  }
+
+ private:
+  uint32_t next_random() {
+    seed_ = seed_ * 1664525u + 1013904223u;
+    return seed_ >> 8;
+  }
+
+  TransportStats stats_;
+  uint64_t now_ = 0;
+  uint64_t link_free_ns_ = 0;
+  uint32_t seed_ = 1;
+};
+
+struct Sender {
+  SimulatedLink link;
+  BitrateController controller;
+  BitrateController::Decision decision{};
+
+  BitrateController::Decision tick() {
+    link.tick(decision.bitrate, decision.frame_ms);
+    decision = controller.update(controller.sample(link.stats()));
+    return decision;
+  }
+
+  int rung() const { return controller.stats().rung; }
+};
+
+void check_controller() {
+  constexpr int kSteadyTicks = 600;
+  const BitrateController::Config config;
+
+  Sender s;
+  s.decision = s.controller.update({});
+  if (!s.decision.changed || s.decision.bitrate != 32000) {
+    fail("first decision not the top rung");
+  }
+  for (int i = 0; i < 60; ++i) {
+    if (s.tick().changed) fail("changed on a clear link");
+  }
+
+  // Congestion: down on the first tick, then settle.
+  s.link.capacity_bps = kSlowLinkBps;
+  const BitrateController::Decision first = s.tick();
+  if (!first.changed || first.bitrate >= 32000) {
+    fail("no step down on the first congested tick");
+  }
+  int at_fit = 0;
+  int lowest = 0;
+  const BitrateController::Stats before = s.controller.stats();
+  for (int i = 0; i < kSteadyTicks; ++i) {
+    s.tick();
+    if (s.rung() == kFittingRung) ++at_fit;
+    lowest = std::max(lowest, s.rung());
+  }
+  const BitrateController::Stats steady = s.controller.stats();
+  if (lowest > kFittingRung + 1) fail("overshot the fitting rung");
+  if (at_fit < kSteadyTicks * 9 / 10) fail("did not settle");
+  // Probes spaced 10, 20, 40 and then 80 ticks apart.
+  if (steady.steps_up - before.steps_up > 10 ||
+      steady.backoff != config.max_backoff) {
+    fail("oscillates under steady congestion");
+  }
+
+  // Fixed top rung on the same link: the queue runs to the drop limit.
+  Sender fixed;
+  fixed.link.capacity_bps = kSlowLinkBps;
+  for (int i = 0; i < kSteadyTicks; ++i) fixed.link.tick(32000, 20);
+  if (s.link.mean_queue_delay_ms() * 4 > fixed.link.mean_queue_delay_ms()) {
+    fail("adaptive queueing delay not well below fixed");
+  }
+
+  // Recovery: back at the top within the longest hold-off and a probe
+  // per rung.
+  s.link.capacity_bps = kFastLinkBps;
+  int ticks = 0;
+  while (s.rung() != 0) {
+    if (++ticks > (config.max_backoff + 2 * kFittingRung) * config.up_after) {
+      fail("did not recover");
+    }
+    s.tick();
+  }
+
+  // FEC follows loss, with a longer hold before it goes off.
+  s.link.loss_per_mille = 50;
+  int lossy = 0;
+  while (!s.tick().fec) {
+    if (++lossy > 8) fail("FEC not on at 5% loss");
+  }
+  for (int i = 0; i < 100; ++i) {
+    if (!s.tick().fec) fail("FEC off at 5% loss");
+  }
+  if (s.rung() != 0) fail("stepped down for loss under the limit");
+  s.link.loss_per_mille = 0;
+  for (int i = 0; i < config.fec_off_after; ++i) {
+    if (!s.tick().fec) fail("FEC off before its hold");
+  }
+  int quiet = 0;
+  while (s.tick().fec) {
+    // Plus the time the smoothed loss takes to fall below fec_off_loss.
+    if (++quiet > 10) fail("FEC still on after its hold");
+  }
+}
+
+// The hold-off itself, on hand-made samples: up_after clear ticks before a
+// step up, twice that after a failed probe.
+void check_hysteresis() {
+  const BitrateController::Config config;
+  BitrateController c;
+  BitrateController::LinkSample clear;
+  BitrateController::LinkSample queued;
+  queued.queue_delay_ns = 100000000;
+  c.update(clear);
+  if (c.update(queued).reason != BitrateController::Reason::kQueue) {
+    fail("queue backlog not seen");
+  }
+  auto ticks_to_step_up = [&] {
+    for (int i = 1; i <= 4 * config.up_after; ++i) {
+      if (c.update(clear).changed) return i;
+    }
+    return -1;
+  };
+  if (ticks_to_step_up() != config.up_after) fail("hold-off not up_after");
+  c.update(queued);
+  if (c.stats().backoff != 2) fail("failed probe did not back off");
+  if (ticks_to_step_up() != 2 * config.up_after) {
+    fail("backed-off hold-off not doubled");
+  }
+}
+
+// Counts packets and their sizes.
+class CountingSink : public PacketSink {
+ public:
+  std::span<uint8_t> reserve(std::size_t max_bytes) override {
+    return {buffer_, std::min(max_bytes, sizeof(buffer_))};
+  }
+  bool commit(std::size_t bytes, uint64_t) override {
+    ++packets;
+    last_bytes = bytes;
+    return true;
+  }
+
+  int packets = 0;
+  std::size_t last_bytes = 0;
+
+ private:
+  uint8_t buffer_[4096];
+};
+
+void check_packet_frames() {
+  constexpr int kFrameSamples = 320;
+  static FramePool pool(kFrameSamples * sizeof(int16_t), 16);
+  G711Encoder encoder(16000, kFrameSamples);
+  CountingSink sink;
+  EncoderStage::Config config;
+  config.max_packet_bytes = 4096;
+  EncoderStage stage(encoder, sink, config);
+  auto submit = [&](int frames) {
+    for (int i = 0; i < frames; ++i) {
+      FrameRef frame = pool.acquire();
+      frame.set_size(kFrameSamples * sizeof(int16_t));
+      frame.set_timestamp_ns(monotonic_ns());
+      std::memset(frame.data(), 0, frame.size());
+      stage.submit(std::move(frame));
+    }
+    stage.run_once();
+  };
+
+  BitrateController::Decision d{8000, 60, false, 0, true,
+                                BitrateController::Reason::kStart};
+  BitrateController::apply(d, stage, 20);
+  submit(9);
+  if (sink.packets != 3 || sink.last_bytes != 3 * kFrameSamples ||
+      stage.stats().packet_frames != 3 || stage.stats().frames_encoded != 9) {
+    fail("packet_frames 3 not applied");
+  }
+  submit(2);
+  if (sink.packets != 3) fail("partial packet sent early");
+  stage.flush();
+  stage.run_once();
+  if (sink.packets != 4 || sink.last_bytes != 2 * kFrameSamples ||
+      stage.stats().frames_encoded != 11) {
+    fail("flush did not send the partial packet");
+  }
+}
+
+void check_bitrate() {
+  static const bool checked = [] {
+    check_controller();
+    check_hysteresis();
+    check_packet_frames();
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void contended_link(State& state) {
+  check_bitrate();
+  Sender s;
+  s.decision = s.controller.update({});
+  uint64_t i = 0;
+  for (auto _ : state) {
+    // Alternate a minute of each link.
+    s.link.capacity_bps = (i++ / 120) % 2 == 0 ? kSlowLinkBps : kFastLinkBps;
+    do_not_optimize(s.tick());
+  }
+}
+XIAOZI_BENCH("codec/bitrate_contended_link", contended_link);
+
+void update(State& state) {
+  check_bitrate();
+  BitrateController controller;
+  BitrateController::LinkSample link;
+  uint32_t i = 0;
+  for (auto _ : state) {
+    link.rtt_us = kBaseRttUs + (++i % 64) * 1000;
+    link.loss = (i % 32) / 256.0f;
+    link.queue_delay_ns = (i % 16) * 5000000;
+    do_not_optimize(controller.update(link));
+  }
+}
+XIAOZI_BENCH("codec/bitrate_update", update);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,143 @@
+// Codec and codec pipeline stages. G.711 runs everywhere; the Opus cases are
+// only built when libopus is found.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "base/clock.h"
+#include "bench.h"
+#include "codec/decoder_stage.h"
+#include "codec/encoder_stage.h"
+#include "codec/g711_codec.h"
+#include "memory/frame_pool.h"
+#include "net/packet_sink.h"
+
+#if defined(XIAOZI_HAVE_OPUS)
+#include "codec/opus_codec.h"
+#endif
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr int kFrameSamples = 320;  // 20 ms
+
+// Stands in for a transport send buffer: hands out space linearly and
+// wraps, discarding what was committed.
+class DiscardSink : public PacketSink {
+ public:
+  std::span<uint8_t> reserve(std::size_t max_bytes) override {
+    if (offset_ + max_bytes > sizeof(buffer_)) offset_ = 0;
+    return {buffer_ + offset_, max_bytes};
+  }
+  bool commit(std::size_t bytes, uint64_t) override {
+    offset_ += bytes;
+    return true;
+  }
+
+ private:
+  uint8_t buffer_[16384];
+  std::size_t offset_ = 0;
+};
+
+void fill_speech_like(std::span<int16_t> pcm) {
+  for (size_t i = 0; i < pcm.size(); ++i) {
+    pcm[i] = static_cast<int16_t>(((i * 2654435761u) >> 20) & 0x1fff) - 4096;
+  }
+}
+
+void g711_encode_20ms(State& state) {
+  G711Encoder encoder(kSampleRate, kFrameSamples);
+  int16_t pcm[kFrameSamples];
+  uint8_t out[kFrameSamples];
+  fill_speech_like(pcm);
+  for (auto _ : state) {
+    int n = encoder.encode(pcm, out);
+    do_not_optimize(n);
+    clobber_memory();
+  }
+}
+XIAOZI_BENCH("codec/g711_encode_20ms", g711_encode_20ms);
+
+// The pre-stage shape: encode into a fresh vector, then copy the packet
+// into the send buffer.
+void g711_encode_vector_copy(State& state) {
+  G711Encoder encoder(kSampleRate, kFrameSamples);
+  DiscardSink sink;
+  std::vector<int16_t> pcm(kFrameSamples);
+  fill_speech_like(pcm);
+  for (auto _ : state) {
+    std::vector<uint8_t> packet(kFrameSamples);
+    int n = encoder.encode(pcm, packet);
+    auto out = sink.reserve(packet.size());
+    std::memcpy(out.data(), packet.data(), static_cast<size_t>(n));
+    sink.commit(static_cast<size_t>(n), 0);
+  }
+}
+XIAOZI_BENCH("codec/g711_encode_vector_copy", g711_encode_vector_copy);
+
+// ns/op is per frame: pool acquire, capture-side fill, submit, and the
+// batched encode into the sink.
+void encoder_stage_g711_batch3(State& state) {
+  static FramePool pool(kFrameSamples * sizeof(int16_t), 32);
+  G711Encoder encoder(kSampleRate, kFrameSamples);
+  DiscardSink sink;
+  EncoderStage::Config config;
+  config.frames_per_wakeup = 3;
+  config.max_packet_bytes = kFrameSamples;
+  EncoderStage stage(encoder, sink, config);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    FrameRef frame = pool.acquire();
+    frame.set_size(kFrameSamples * sizeof(int16_t));
+    frame.set_timestamp_ns(monotonic_ns());
+    fill_speech_like(frame.as<int16_t>());
+    stage.submit(std::move(frame));
+    if (++i % 3 == 0) stage.run_once();
+  }
+  stage.run_once();
+}
+XIAOZI_BENCH("codec/encoder_stage_g711_batch3", encoder_stage_g711_batch3);
+
+void decoder_stage_g711(State& state) {
+  static FramePool packets(kFrameSamples, 32);
+  static FramePool pcm(kFrameSamples * sizeof(int16_t), 32);
+  G711Decoder decoder(kSampleRate, kFrameSamples);
+  DecoderStage stage(decoder, pcm);
+  for (auto _ : state) {
+    FrameRef packet = packets.acquire();
+    std::memset(packet.data(), 0x55, kFrameSamples);
+    packet.set_size(kFrameSamples);
+    packet.set_timestamp_ns(monotonic_ns());
+    stage.submit(std::move(packet));
+    stage.run_once();
+    FrameRef out;
+    stage.pop(out);
+    do_not_optimize(out.data());
+  }
+}
+XIAOZI_BENCH("codec/decoder_stage_g711", decoder_stage_g711);
+
+#if defined(XIAOZI_HAVE_OPUS)
+void opus_encode_20ms(State& state, int complexity) {
+  OpusAudioEncoder encoder(kSampleRate, 20, 24000);
+  encoder.set_complexity(complexity);
+  int16_t pcm[kFrameSamples];
+  uint8_t out[1276];
+  fill_speech_like(pcm);
+  for (auto _ : state) {
+    int n = encoder.encode(pcm, out);
+    do_not_optimize(n);
+  }
+}
+XIAOZI_BENCH("codec/opus_encode_20ms/c0",
+             [](State& s) { opus_encode_20ms(s, 0); });
+XIAOZI_BENCH("codec/opus_encode_20ms/c5",
+             [](State& s) { opus_encode_20ms(s, 5); });
+XIAOZI_BENCH("codec/opus_encode_20ms/c10",
+             [](State& s) { opus_encode_20ms(s, 10); });
+#endif
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,187 @@
+// Coroutines on the executor: the cost of awaiting a nested Task against
+// the callback-plus-heap-state shape it replaces, a request/reply over a
+// socket pair, an audio-style event handoff and timer accuracy. Every
+// coroutine case must run without heap frames after warm-up; a fallback
+// allocation aborts the run.
+
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <semaphore>
+
+#include "bench.h"
+#include "net/async_stream.h"
+#include "net/tcp_stream.h"
+#include "runtime/async_event.h"
+#include "runtime/executor.h"
+#include "runtime/frame_allocator.h"
+#include "runtime/io_reactor.h"
+#include "runtime/task.h"
+
+namespace xiaozi::bench {
+namespace {
+
+Executor::Config pool_config() {
+  Executor::Config config;
+  config.workers = 2;
+  return config;
+}
+
+void check_no_heap_frames(uint64_t before) {
+  if (FrameAllocator::global().stats().heap_fallback != before) {
+    std::fprintf(stderr, "xiaozi_bench: coroutine frame fell back to heap\n");
+    std::abort();
+  }
+}
+
+// Runs `body` as a coroutine on a fresh executor and waits for it.
+template <typename Body>
+void run_on_executor(Body body) {
+  const uint64_t fallbacks = FrameAllocator::global().stats().heap_fallback;
+  Executor executor(pool_config());
+  std::binary_semaphore done{0};
+  spawn(executor, Priority::kInteractive, body(executor, done));
+  done.acquire();
+  check_no_heap_frames(fallbacks);
+}
+
+Task<int> parse_field(int value) { co_return value * 3 + 1; }
+
+Task<int> handle_request(int id) {
+  const int a = co_await parse_field(id);
+  const int b = co_await parse_field(a);
+  co_return a + b;
+}
+
+// ns/op is per request: one task awaiting two nested tasks.
+void await_nested_task(State& state) {
+  run_on_executor([&state](Executor&, std::binary_semaphore& done)
+                      -> Task<void> {
+    int sum = 0;
+    for (auto _ : state) sum += co_await handle_request(sum & 0xff);
+    do_not_optimize(sum);
+    done.release();
+  });
+}
+XIAOZI_BENCH("coro/await_nested_task", await_nested_task);
+
+// The callback shape: request state on the heap, shared between the
+// continuations, each step a std::function.
+struct RequestState {
+  int id;
+  int a = 0;
+  std::function<void(int)> on_done;
+};
+
+void parse_field_cb(int value, std::function<void(int)> cb) {
+  cb(value * 3 + 1);
+}
+
+void handle_request_cb(int id, std::function<void(int)> on_done) {
+  auto st = std::make_shared<RequestState>();
+  st->id = id;
+  st->on_done = std::move(on_done);
+  parse_field_cb(id, [st](int a) {
+    st->a = a;
+    parse_field_cb(a, [st](int b) { st->on_done(st->a + b); });
+  });
+}
+
+void callback_heap_state(State& state) {
+  int sum = 0;
+  for (auto _ : state) {
+    handle_request_cb(sum & 0xff, [&sum](int r) { sum += r; });
+  }
+  do_not_optimize(sum);
+}
+XIAOZI_BENCH("coro/callback_heap_state", callback_heap_state);
+
+Task<void> echo_server(IoReactor& reactor, Stream& stream) {
+  uint8_t buf[256];
+  for (;;) {
+    const ssize_t n = co_await async_read(reactor, stream, buf);
+    if (n <= 0) co_return;
+    if (co_await async_write(reactor, stream, {buf, size_t(n)}) < 0) {
+      co_return;
+    }
+  }
+}
+
+// ns/op is per 64-byte request and reply through the reactor.
+void socket_echo_roundtrip(State& state) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) != 0) {
+    state.skip("socketpair failed");
+    return;
+  }
+  TcpStream client(fds[0]);
+  TcpStream server(fds[1]);
+  run_on_executor([&](Executor& executor, std::binary_semaphore& done)
+                      -> Task<void> {
+    IoReactor reactor(executor);
+    spawn(executor, Priority::kInteractive, echo_server(reactor, server));
+    uint8_t request[64] = {1, 2, 3};
+    uint8_t reply[64];
+    for (auto _ : state) {
+      co_await async_write(reactor, client, request);
+      size_t got = 0;
+      while (got < sizeof(reply)) {
+        const ssize_t n = co_await async_read(
+            reactor, client, std::span(reply).subspan(got));
+        if (n <= 0) std::abort();
+        got += static_cast<size_t>(n);
+      }
+    }
+    // EOF ends the server coroutine before the reactor goes away.
+    client.close();
+    co_await reactor.sleep_for(std::chrono::milliseconds(5));
+    done.release();
+  });
+}
+XIAOZI_BENCH("coro/socket_echo_roundtrip", socket_echo_roundtrip);
+
+// A capture-side thread sets the event; the coroutine wakes on the
+// executor and answers. ns/op is per set-to-answer round trip.
+void event_roundtrip(State& state) {
+  const uint64_t fallbacks = FrameAllocator::global().stats().heap_fallback;
+  Executor executor(pool_config());
+  AsyncEvent event(executor);
+  std::binary_semaphore answered{0};
+  std::binary_semaphore finished{0};
+  const uint64_t rounds = state.iterations();
+  auto listener = [&]() -> Task<void> {
+    for (uint64_t i = 0; i < rounds; ++i) {
+      co_await event;
+      answered.release();
+    }
+    finished.release();
+  };
+  spawn(executor, Priority::kRealtime, listener());
+  for (auto _ : state) {
+    event.set();
+    answered.acquire();
+  }
+  finished.acquire();
+  check_no_heap_frames(fallbacks);
+}
+XIAOZI_BENCH("coro/event_roundtrip", event_roundtrip);
+
+// ns/op is the real duration of a 1 ms sleep.
+void sleep_1ms(State& state) {
+  run_on_executor([&state](Executor& executor, std::binary_semaphore& done)
+                      -> Task<void> {
+    IoReactor reactor(executor);
+    for (auto _ : state) {
+      co_await reactor.sleep_for(std::chrono::milliseconds(1));
+    }
+    done.release();
+  });
+}
+XIAOZI_BENCH("coro/sleep_1ms", sleep_1ms);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,210 @@
+// Display updates on a 320x240 status screen (status bar, clock, emoji
+// with alpha, a wrapping chat line): repainting and sending the whole
+// screen for every change against the retained renderer, which sends only
+// the dirty rectangles, and with its text cache cleared before each update
+// against kept warm. ns/op is per update, rasterization plus a memory copy
+// standing in for the DMA; on an SPI panel the sent pixels dominate (a full
+// 320x240 frame is 31 ms at 40 MHz). After every update the dirty-rect
+// screen must equal a full redraw of the same scene; a mismatch aborts.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "assets/asset_pack.h"
+#include "assets/asset_pack_writer.h"
+#include "assets/asset_sources.h"
+#include "bench.h"
+#include "display/panel.h"
+#include "display/renderer.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr int kWidth = 320;
+constexpr int kHeight = 240;
+
+const char* const kMessages[] = {
+    "\xe4\xbd\xa0\xe5\xa5\xbd\xef\xbc\x8c\xe6\x88\x91\xe6\x98\xaf\xe5\xb0\x8f"
+    "\xe6\x99\xba\xe3\x80\x82 How can I help you today?",
+    "The weather in Shanghai is 23 degrees and cloudy, with light rain "
+    "expected this evening.",
+    "\xe5\xa5\xbd\xe7\x9a\x84\xef\xbc\x8c\xe5\xb7\xb2\xe4\xb8\xba\xe4\xbd\xa0"
+    "\xe8\xae\xbe\xe7\xbd\xae\xe4\xb8\x83\xe7\x82\xb9\xe7\x9a\x84\xe9\x97\xb9"
+    "\xe9\x92\x9f\xe3\x80\x82",
+    "Playing your morning playlist on the living room speaker.",
+};
+
+// ASCII at 8 px and the CJK block at 16 px, with arbitrary bits.
+DecodedFont make_font() {
+  DecodedFont font;
+  font.line_height = 18;
+  font.ascent = 14;
+  auto add = [&](uint32_t cp, uint8_t width) {
+    DecodedGlyph g{cp, width, 14, 0, -2, width, {}};
+    const std::size_t stride = (width + 7) / 8;
+    for (std::size_t i = 0; i < stride * g.height; ++i) {
+      g.bitmap.push_back(uint8_t(cp * 2654435761u >> (i % 24)));
+    }
+    font.glyphs.push_back(std::move(g));
+  };
+  for (uint32_t cp = 0x20; cp < 0x7f; ++cp) add(cp, 8);
+  for (uint32_t cp = 0x3000; cp < 0x3040; ++cp) add(cp, 16);
+  for (uint32_t cp = 0x4e00; cp < 0x9fa6; ++cp) add(cp, 16);
+  for (uint32_t cp = 0xff00; cp < 0xff60; ++cp) add(cp, 16);
+  return font;
+}
+
+DecodedImage make_emoji() {
+  DecodedImage image;
+  image.width = 64;
+  image.height = 64;
+  for (int y = 0; y < 64; ++y) {
+    for (int x = 0; x < 64; ++x) {
+      const int dx = x - 32, dy = y - 32;
+      image.rgb565.push_back(to_rgb565(255, uint8_t(4 * y), 0));
+      image.alpha.push_back(dx * dx + dy * dy < 900   ? 255
+                            : dx * dx + dy * dy < 1024 ? 128
+                                                       : 0);
+    }
+  }
+  return image;
+}
+
+struct Assets {
+  std::vector<uint8_t> bytes;
+  std::unique_ptr<AssetPack> pack;
+  FontView font;
+  ImageView emoji;
+
+  Assets() {
+    AssetPackWriter writer;
+    writer.add_font("font/ui", make_font());
+    writer.add_image("emoji/happy", make_emoji());
+    bytes = *writer.finish();
+    pack = AssetPack::attach(std::as_bytes(std::span(bytes)));
+    font = *pack->font("font/ui");
+    emoji = *pack->image("emoji/happy");
+  }
+};
+
+const Assets& assets() {
+  static const Assets a;
+  return a;
+}
+
+// The screen shown while the assistant speaks.
+struct Screen {
+  FramebufferPanel panel{kWidth, kHeight};
+  Renderer renderer;
+  Renderer::NodeId clock;
+  Renderer::NodeId chat;
+
+  Screen() : renderer(panel) {
+    const Assets& a = assets();
+    renderer.add_fill({0, 0, kWidth, 24}, 0x2104);
+    clock = renderer.add_text({4, 3, 48, 18}, a.font, "12:00", 0xffff);
+    renderer.add_text({120, 3, 120, 18}, a.font,
+                      "\xe8\xaf\xb4\xe8\xaf\x9d\xe4\xb8\xad", 0x07e0);
+    renderer.add_fill({280, 6, 32, 12}, 0x07e0);
+    renderer.add_image(128, 40, a.emoji);
+    chat = renderer.add_text({8, 120, 304, 112}, a.font, kMessages[0],
+                             0xffff);
+    renderer.render();
+  }
+};
+
+std::string clock_text(uint64_t i) {
+  char text[8];
+  std::snprintf(text, sizeof(text), "12:%02u", unsigned(i % 60));
+  return text;
+}
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: %s\n", what);
+  std::abort();
+}
+
+// Drives a full-redraw screen and a dirty-rect screen through the same
+// updates and compares them after each.
+void check_screens() {
+  static const bool checked = [] {
+    Screen full, dirty;
+    for (int i = 0; i < 12; ++i) {
+      const std::string clock = clock_text(i);
+      const char* message = kMessages[i % 4];
+      for (Screen* s : {&full, &dirty}) {
+        s->renderer.set_text(s->clock, clock);
+        s->renderer.set_text(s->chat, message);
+      }
+      if (i == 5) dirty.renderer.text_cache().clear();
+      full.renderer.invalidate_all();
+      full.renderer.render();
+      dirty.renderer.render();
+      if (!std::equal(full.panel.pixels().begin(), full.panel.pixels().end(),
+                      dirty.panel.pixels().begin())) {
+        fail("dirty-rect screen differs from a full redraw");
+      }
+    }
+    if (dirty.panel.stats().pixels >= full.panel.stats().pixels) {
+      fail("dirty-rect screen sent no fewer pixels than a full redraw");
+    }
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void BM_ClockFull(State& state) {
+  check_screens();
+  Screen screen;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    screen.renderer.set_text(screen.clock, clock_text(++i));
+    screen.renderer.invalidate_all();
+    do_not_optimize(screen.renderer.render());
+  }
+}
+
+void BM_ClockDirty(State& state) {
+  check_screens();
+  Screen screen;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    screen.renderer.set_text(screen.clock, clock_text(++i));
+    do_not_optimize(screen.renderer.render());
+  }
+}
+
+void BM_ChatUncached(State& state) {
+  check_screens();
+  Screen screen;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    screen.renderer.text_cache().clear();
+    screen.renderer.set_text(screen.chat, kMessages[++i % 4]);
+    do_not_optimize(screen.renderer.render());
+  }
+}
+
+void BM_ChatCached(State& state) {
+  check_screens();
+  Screen screen;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    screen.renderer.set_text(screen.chat, kMessages[++i % 4]);
+    do_not_optimize(screen.renderer.render());
+  }
+}
+
+XIAOZI_BENCH("display/chat_message/dirty_cached", BM_ChatCached);
+XIAOZI_BENCH("display/chat_message/dirty_uncached", BM_ChatUncached);
+XIAOZI_BENCH("display/clock_tick/dirty", BM_ClockDirty);
+XIAOZI_BENCH("display/clock_tick/full_redraw", BM_ClockFull);
+
+}  // namespace
+}  // namespace xiaozi::bench
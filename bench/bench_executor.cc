@@ -0,0 +1,192 @@
+// Executor: handing work to a pool thread against a thread of its own,
+// continuation chains, fan-out with stealing, and how long a realtime task
+// waits while background work keeps every worker busy. Ordering and
+// lane placement are checked first; a violation aborts the run.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <semaphore>
+#include <thread>
+
+#include "base/clock.h"
+#include "bench.h"
+#include "runtime/executor.h"
+
+namespace xiaozi::bench {
+namespace {
+
+void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: executor %s\n", what);
+  std::abort();
+}
+
+Executor::Config pool_config() {
+  Executor::Config config;
+  config.workers = 2;
+  config.realtime_sched_priority = 10;
+  return config;
+}
+
+struct Chain {
+  Executor* executor;
+  std::binary_semaphore* done;
+  int remaining;
+  int expected_next = 0;
+  bool in_order = true;
+};
+
+void chain_step(Chain* chain, int step) {
+  if (step != chain->expected_next++) chain->in_order = false;
+  if (--chain->remaining == 0) {
+    chain->done->release();
+    return;
+  }
+  chain->executor->defer([chain, step] { chain_step(chain, step + 1); });
+}
+
+void verify_executor() {
+  Executor executor(pool_config());
+  std::binary_semaphore done{0};
+  Chain chain{&executor, &done, 100};
+  executor.post(Priority::kBackground, [&] { chain_step(&chain, 0); });
+  done.acquire();
+  if (!chain.in_order) fail("ran deferred steps out of order");
+
+  bool on_lane = false;
+  executor.post(Priority::kRealtime, [&] {
+    on_lane = Executor::current() == &executor &&
+              Executor::current_priority() == Priority::kRealtime;
+    done.release();
+  });
+  done.acquire();
+  if (!on_lane) fail("ran a realtime task off the lane");
+
+  std::atomic<int> ran{0};
+  for (int i = 0; i < 500; ++i) {
+    while (!executor.post(i % 2 ? Priority::kInteractive
+                                : Priority::kBackground,
+                          [&] { ran.fetch_add(1); })) {
+      std::this_thread::yield();
+    }
+  }
+  executor.stop();
+  if (ran.load() != 500) fail("lost tasks across stop()");
+}
+
+void post_roundtrip(State& state) {
+  verify_executor();
+  Executor executor(pool_config());
+  std::binary_semaphore done{0};
+  for (auto _ : state) {
+    executor.post(Priority::kInteractive, [&] { done.release(); });
+    done.acquire();
+  }
+}
+XIAOZI_BENCH("executor/post_roundtrip", post_roundtrip);
+
+// The per-feature-thread shape: a thread of its own parked on a semaphore.
+void dedicated_thread_roundtrip(State& state) {
+  std::binary_semaphore request{0};
+  std::binary_semaphore done{0};
+  std::atomic<bool> quit{false};
+  std::thread thread([&] {
+    for (;;) {
+      request.acquire();
+      if (quit.load(std::memory_order_relaxed)) return;
+      done.release();
+    }
+  });
+  for (auto _ : state) {
+    request.release();
+    done.acquire();
+  }
+  quit.store(true, std::memory_order_relaxed);
+  request.release();
+  thread.join();
+}
+XIAOZI_BENCH("executor/dedicated_thread_roundtrip",
+             dedicated_thread_roundtrip);
+
+// ns/op is per 64-step chain; each step defers the next.
+void defer_chain_64(State& state) {
+  Executor executor(pool_config());
+  std::binary_semaphore done{0};
+  for (auto _ : state) {
+    Chain chain{&executor, &done, 64};
+    executor.post(Priority::kInteractive, [&] { chain_step(&chain, 0); });
+    done.acquire();
+  }
+}
+XIAOZI_BENCH("executor/defer_chain_64", defer_chain_64);
+
+// ns/op is per batch of 64 tasks posted from inside a task, which lands
+// them on one worker's deque for the others to steal.
+void fanout_64(State& state) {
+  Executor executor(pool_config());
+  std::binary_semaphore done{0};
+  std::atomic<int> left{0};
+  for (auto _ : state) {
+    left.store(64, std::memory_order_relaxed);
+    executor.post(Priority::kInteractive, [&] {
+      for (int i = 0; i < 64; ++i) {
+        executor.post(Priority::kInteractive, [&] {
+          if (left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            done.release();
+          }
+        });
+      }
+    });
+    done.acquire();
+  }
+}
+XIAOZI_BENCH("executor/fanout_64", fanout_64);
+
+// Busy-loops for about 2 ms per task and reposts itself, so every worker
+// is always in the middle of a background task.
+struct Load {
+  Executor* executor;
+  std::atomic<bool>* quit;
+};
+
+void background_spin(Load load) {
+  const uint64_t end = monotonic_ns() + 2'000'000;
+  while (monotonic_ns() < end) {
+  }
+  if (!load.quit->load(std::memory_order_relaxed)) {
+    load.executor->post(Priority::kBackground,
+                        [load] { background_spin(load); });
+  }
+}
+
+void roundtrip_under_background(State& state, Priority priority) {
+  Executor executor(pool_config());
+  std::atomic<bool> quit{false};
+  for (std::size_t i = 0; i < executor.workers(); ++i) {
+    executor.post(Priority::kBackground,
+                  [load = Load{&executor, &quit}] { background_spin(load); });
+  }
+  std::binary_semaphore done{0};
+  for (auto _ : state) {
+    executor.post(priority, [&] { done.release(); });
+    done.acquire();
+  }
+  quit.store(true, std::memory_order_relaxed);
+}
+
+void realtime_under_background(State& state) {
+  roundtrip_under_background(state, Priority::kRealtime);
+}
+XIAOZI_BENCH("executor/realtime_under_background", realtime_under_background);
+
+// The same wait without the lane: interactive work queues behind whatever
+// background task each worker is in.
+void interactive_under_background(State& state) {
+  roundtrip_under_background(state, Priority::kInteractive);
+}
+XIAOZI_BENCH("executor/interactive_under_background",
+             interactive_under_background);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,64 @@
+// FramePool against the heap baselines in bench_alloc.cc.
+
+#include <cstdint>
+#include <thread>
+
+#include "bench.h"
+#include "memory/frame_pool.h"
+#include "memory/spsc_ring.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr size_t kPcm20msBytes = 320 * sizeof(int16_t);
+
+void frame_pool_acquire_release(State& state) {
+  static FramePool pool(kPcm20msBytes, 64);
+  for (auto _ : state) {
+    FrameRef frame = pool.acquire();
+    do_not_optimize(frame.data());
+  }
+}
+XIAOZI_BENCH("alloc/frame_pool_acquire_release",
+             frame_pool_acquire_release);
+
+// Same shape as alloc/shared_pcm_handoff: three holders of one frame.
+void frame_pool_handoff(State& state) {
+  static FramePool pool(kPcm20msBytes, 64);
+  for (auto _ : state) {
+    FrameRef frame = pool.acquire();
+    frame.set_size(kPcm20msBytes);
+    FrameRef encoder_ref = frame;
+    FrameRef sender_ref = encoder_ref;
+    do_not_optimize(sender_ref.data());
+  }
+}
+XIAOZI_BENCH("alloc/frame_pool_handoff", frame_pool_handoff);
+
+// Frames acquired on a producer thread and released on the consumer thread,
+// i.e. the capture -> processing path.
+void frame_pool_cross_thread(State& state) {
+  static FramePool pool(kPcm20msBytes, 128);
+  static SpscRing<FrameRef, 64> ring;
+  const uint64_t n = state.iterations();
+  std::thread producer([n] {
+    for (uint64_t i = 0; i < n;) {
+      FrameRef frame = pool.acquire();
+      if (frame && ring.try_push(std::move(frame))) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  FrameRef frame;
+  for (auto _ : state) {
+    while (!ring.try_pop(frame)) std::this_thread::yield();
+    frame.reset();
+  }
+  producer.join();
+}
+XIAOZI_BENCH("alloc/frame_pool_cross_thread", frame_pool_cross_thread);
+
+}  // namespace
+}  // namespace xiaozi::bench
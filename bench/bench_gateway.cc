@@ -0,0 +1,386 @@
+// Fleet gateway relaying device audio to the ASR backend over loopback.
+// 64 devices are connected over WebSocket to a two-shard Gateway. In each
+// round every device sends one 80-byte audio packet, and the round ends
+// once a stand-in backend has read all 64. ns/op is one round: the device
+// sends, the gateway and the backend together.
+//
+// Checks before timing, any failure aborts:
+// - every session is owned by the shard its Device-Id hashes to, and some
+//   had to be handed over from the shard that accepted them;
+// - the backend gets each device's packets intact and in order, on the
+//   owning shard's link;
+// - text the backend sends for a session reaches that device.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bench.h"
+#include "gateway/gateway.h"
+#include "net/websocket_frame.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr int kDevices = 64;
+constexpr std::size_t kPacketBytes = 80;  // 20 ms at 32 kbps
+constexpr std::size_t kRecordHeader = BackendLink::kHeaderBytes;
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: gateway %s\n", what);
+  std::abort();
+}
+
+uint32_t get_be32(const uint8_t* p) {
+  return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 |
+         p[3];
+}
+
+void put_be32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+bool write_all(int fd, const void* data, std::size_t n) {
+  const auto* p = static_cast<const uint8_t*>(data);
+  while (n > 0) {
+    const ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+    if (w <= 0) return false;
+    p += w;
+    n -= static_cast<std::size_t>(w);
+  }
+  return true;
+}
+
+bool read_exact(int fd, uint8_t* out, std::size_t n) {
+  while (n > 0) {
+    const ssize_t r = recv(fd, out, n, 0);
+    if (r <= 0) return false;
+    out += r;
+    n -= static_cast<std::size_t>(r);
+  }
+  return true;
+}
+
+std::string device_name(int i) { return "dev-" + std::to_string(i); }
+
+// Reads records from every shard link and checks them; the links are
+// accepted as the shards connect.
+class Backend {
+ public:
+  Backend() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+        listen(listen_fd_, 16) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len)) {
+      fail("backend cannot listen");
+    }
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this] { run(); });
+  }
+
+  ~Backend() {
+    stop_.store(true);
+    thread_.join();
+    for (const Link& l : links_) ::close(l.fd);
+    ::close(listen_fd_);
+  }
+
+  int port() const { return port_; }
+  uint64_t audio() const { return audio_.load(std::memory_order_acquire); }
+  const char* error() const { return error_.load(); }
+
+  // Session ID the device was announced under.
+  std::optional<uint32_t> session_of(int device) {
+    std::lock_guard lock(mutex_);
+    auto it = sessions_.find(device);
+    if (it == sessions_.end()) return std::nullopt;
+    return it->second.id;
+  }
+
+  // Sends a text record to `device` down the link its session came on.
+  void send_text(int device, std::string_view text) {
+    int fd;
+    uint32_t id;
+    {
+      std::lock_guard lock(mutex_);
+      fd = sessions_.at(device).link_fd;
+      id = sessions_.at(device).id;
+    }
+    std::vector<uint8_t> record(kRecordHeader + text.size(), 0);
+    record[0] = BackendLink::kText;
+    put_be32(&record[4], id);
+    put_be32(&record[8], static_cast<uint32_t>(text.size()));
+    std::memcpy(&record[kRecordHeader], text.data(), text.size());
+    if (!write_all(fd, record.data(), record.size())) fail("backend write");
+  }
+
+ private:
+  struct Link {
+    int fd;
+    std::vector<uint8_t> rx;
+  };
+  struct SessionInfo {
+    uint32_t id;
+    int link_fd;
+  };
+
+  void run() {
+    std::vector<pollfd> fds;
+    while (!stop_.load()) {
+      fds.clear();
+      fds.push_back({listen_fd_, POLLIN, 0});
+      for (const Link& l : links_) fds.push_back({l.fd, POLLIN, 0});
+      if (poll(fds.data(), fds.size(), 10) <= 0) continue;
+      if (fds[0].revents & POLLIN) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) links_.push_back({fd, {}});
+      }
+      for (std::size_t i = 1; i < fds.size(); ++i) {
+        if (fds[i].revents & POLLIN) read_link(links_[i - 1]);
+      }
+    }
+  }
+
+  void read_link(Link& link) {
+    uint8_t buf[65536];
+    const ssize_t n = recv(link.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n <= 0) return;
+    link.rx.insert(link.rx.end(), buf, buf + n);
+    std::size_t at = 0;
+    while (link.rx.size() - at >= kRecordHeader) {
+      const uint8_t* p = &link.rx[at];
+      const uint32_t len = get_be32(p + 8);
+      if (link.rx.size() - at < kRecordHeader + len) break;
+      on_record(link, p[0], get_be32(p + 4), p + kRecordHeader, len);
+      at += kRecordHeader + len;
+    }
+    link.rx.erase(link.rx.begin(), link.rx.begin() + at);
+  }
+
+  void on_record(const Link& link, uint8_t type, uint32_t id,
+                 const uint8_t* payload, uint32_t len) {
+    if (type == BackendLink::kOpen) {
+      const std::string name(reinterpret_cast<const char*>(payload), len);
+      const int device = std::atoi(name.c_str() + 4);
+      std::lock_guard lock(mutex_);
+      sessions_[device] = {id, link.fd};
+      devices_[id] = device;
+      return;
+    }
+    if (type != BackendLink::kAudio) return;
+    auto it = devices_.find(id);
+    if (it == devices_.end()) {
+      error_.store("audio for a session never opened");
+      return;
+    }
+    const int device = it->second;
+    if (len != kPacketBytes || get_be32(payload) != next_seq_[device] ||
+        payload[kPacketBytes - 1] != static_cast<uint8_t>(device)) {
+      error_.store("audio packet corrupted or out of order");
+    }
+    ++next_seq_[device];
+    audio_.fetch_add(1, std::memory_order_release);
+  }
+
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> audio_{0};
+  std::atomic<const char*> error_{nullptr};
+  std::vector<Link> links_;
+  std::mutex mutex_;
+  std::map<int, SessionInfo> sessions_;
+  std::map<uint32_t, int> devices_;
+  uint32_t next_seq_[kDevices] = {};
+};
+
+struct Device {
+  int fd = -1;
+  uint32_t seq = 0;
+  uint8_t frame[ws::kMaxHeaderBytes + kPacketBytes];
+};
+
+std::size_t masked_frame(uint8_t* out, ws::Opcode opcode,
+                         std::span<const uint8_t> payload, uint32_t key) {
+  const std::size_t n =
+      ws::encode_header(out, opcode, payload.size(), true, key);
+  std::memcpy(out + n, payload.data(), payload.size());
+  ws::apply_mask({out + n, payload.size()}, key);
+  return n + payload.size();
+}
+
+// Reads one server frame; returns its payload.
+std::string read_frame(int fd, ws::Opcode expected) {
+  uint8_t head[2];
+  if (!read_exact(fd, head, 2)) fail("device read");
+  std::size_t len = head[1] & 0x7f;
+  if (len == 126) {
+    uint8_t ext[2];
+    if (!read_exact(fd, ext, 2)) fail("device read");
+    len = std::size_t{ext[0]} << 8 | ext[1];
+  }
+  if ((head[0] & 0x0f) != expected || (head[1] & 0x80) != 0) {
+    fail("device got an unexpected frame");
+  }
+  std::string payload(len, '\0');
+  if (!read_exact(fd, reinterpret_cast<uint8_t*>(payload.data()), len)) {
+    fail("device read");
+  }
+  return payload;
+}
+
+Device connect_device(int port, int index) {
+  Device d;
+  d.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(d.fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    fail("device cannot connect");
+  }
+  const int one = 1;
+  setsockopt(d.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  // The RFC 6455 sample key, with the hello pipelined behind the request.
+  std::string out =
+      "GET /xiaozhi/v1/ HTTP/1.1\r\nHost: gateway\r\nUpgrade: websocket\r\n"
+      "Connection: Upgrade\r\nSec-WebSocket-Version: 13\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nDevice-Id: " +
+      device_name(index) + "\r\n\r\n";
+  constexpr std::string_view kHello =
+      R"({"type":"hello","version":1,"transport":"websocket",)"
+      R"("audio_params":{"format":"opus","sample_rate":16000}})";
+  uint8_t frame[256];
+  const std::size_t n = masked_frame(
+      frame, ws::kText,
+      {reinterpret_cast<const uint8_t*>(kHello.data()), kHello.size()},
+      0x5a5a0000u + index);
+  out.append(reinterpret_cast<const char*>(frame), n);
+  if (!write_all(d.fd, out.data(), out.size())) fail("device write");
+
+  std::string response;
+  char c;
+  while (!response.ends_with("\r\n\r\n")) {
+    if (recv(d.fd, &c, 1, 0) != 1) fail("upgrade refused");
+    response += c;
+  }
+  if (!response.starts_with("HTTP/1.1 101") ||
+      response.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == std::string::npos) {
+    fail("upgrade response is wrong");
+  }
+  const std::string hello = read_frame(d.fd, ws::kText);
+  if (hello.find(R"("type":"hello")") == std::string::npos ||
+      hello.find(R"("session_id")") == std::string::npos) {
+    fail("hello reply is wrong");
+  }
+  return d;
+}
+
+void send_packet(Device& d, int index) {
+  uint8_t payload[kPacketBytes];
+  std::memset(payload, index, sizeof(payload));
+  put_be32(payload, d.seq++);
+  const std::size_t n =
+      masked_frame(d.frame, ws::kBinary, payload, 0x01020304u * (index + 1));
+  if (!write_all(d.fd, d.frame, n)) fail("device write");
+}
+
+struct Fleet {
+  Backend backend;
+  std::unique_ptr<Gateway> gateway;
+  std::vector<Device> devices;
+  uint64_t sent = 0;
+
+  Fleet() {
+    Gateway::Config config;
+    config.port = 0;
+    config.shards = 2;
+    config.pin_threads = false;
+    config.backend_port = backend.port();
+    gateway = std::make_unique<Gateway>(config);
+    if (!gateway->start()) fail("does not start");
+    for (int i = 0; i < kDevices; ++i) {
+      devices.push_back(connect_device(gateway->port(), i));
+    }
+    // The kOpen records trail the hello replies.
+    for (int i = 0; i < kDevices; ++i) {
+      while (!backend.session_of(i)) std::this_thread::yield();
+    }
+  }
+
+  ~Fleet() {
+    for (Device& d : devices) ::close(d.fd);
+    gateway->stop();
+  }
+
+  void round() {
+    for (int i = 0; i < kDevices; ++i) send_packet(devices[i], i);
+    sent += kDevices;
+    while (backend.audio() < sent) std::this_thread::yield();
+  }
+};
+
+void check_gateway() {
+  static const bool checked = [] {
+    Fleet fleet;
+    for (int i = 0; i < kDevices; ++i) {
+      const uint32_t id = *fleet.backend.session_of(i);
+      if ((id & 0xff) != fleet.gateway->shard_for(device_name(i))) {
+        fail("session is not on its Device-Id's shard");
+      }
+    }
+    for (int r = 0; r < 20; ++r) fleet.round();
+    if (fleet.backend.error() != nullptr) fail(fleet.backend.error());
+    for (int i : {0, 1, kDevices - 1}) {
+      const std::string text =
+          R"({"type":"stt","text":"device )" + std::to_string(i) + "\"}";
+      fleet.backend.send_text(i, text);
+      if (read_frame(fleet.devices[i].fd, ws::kText) != text) {
+        fail("backend text reached the wrong device");
+      }
+    }
+    const Gateway::Stats stats = fleet.gateway->stats();
+    if (stats.sessions != kDevices || stats.rejected != 0 ||
+        stats.handed_off == 0 || stats.frames != 20 * kDevices) {
+      fail("stats disagree with the traffic");
+    }
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void gateway_forward_round(State& state) {
+  check_gateway();
+  Fleet fleet;
+  for (auto _ : state) fleet.round();
+  if (fleet.backend.error() != nullptr) fail(fleet.backend.error());
+}
+XIAOZI_BENCH("gateway/forward_round_64_devices", gateway_forward_round);
+
+}  // namespace
+}  // namespace xiaozi::bench
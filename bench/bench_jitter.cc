@@ -0,0 +1,48 @@
+// Jitter buffer steady state: one packet in, one frame out per op, with a
+// fixed pattern of reordering, loss and arrival jitter.
+
+#include <cstdint>
+
+#include "audio/jitter_buffer.h"
+#include "bench.h"
+#include "memory/frame_pool.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr size_t kOpusPacketBytes = 120;
+constexpr uint64_t kFrameNs = 60'000'000;
+
+// Sequence number sent in position i: neighbours swapped every 8th pair, so
+// roughly one packet in eight arrives a frame late.
+uint32_t sequence_at(uint64_t i) {
+  if (i % 16 == 6) return static_cast<uint32_t>(i + 1);
+  if (i % 16 == 7) return static_cast<uint32_t>(i - 1);
+  return static_cast<uint32_t>(i);
+}
+
+void jitter_reorder_push_pop(State& state) {
+  static FramePool pool(kOpusPacketBytes, 128);
+  JitterBuffer jitter;
+  uint64_t i = 0;
+  uint64_t played = 0;
+  FrameRef out;
+  for (auto _ : state) {
+    const uint32_t seq = sequence_at(i);
+    // 2% loss, and every packet up to 15 ms off its nominal arrival.
+    if (i % 50 != 49) {
+      FrameRef packet = pool.acquire();
+      packet.set_size(kOpusPacketBytes);
+      packet.set_sequence(seq);
+      packet.set_timestamp_ns(seq * kFrameNs + (i * 7919 % 16) * 1'000'000);
+      jitter.push(std::move(packet));
+    }
+    if (jitter.pop(out) != JitterBuffer::Status::kNotReady) ++played;
+    ++i;
+  }
+  do_not_optimize(played);
+}
+XIAOZI_BENCH("jitter/reorder_push_pop", jitter_reorder_push_pop);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,233 @@
+// Control-message parsing: the arena parser against a conventional heap
+// DOM (std::string, std::vector, std::map per node) on the same messages.
+// Parsed values are checked against the expected ones first, and malformed
+// inputs must be rejected; any mismatch aborts the run.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench.h"
+#include "memory/arena.h"
+#include "protocol/json.h"
+
+namespace xiaozi::bench {
+namespace {
+
+// One of each server control message, in the proportions a conversation
+// sends them: mostly tts and llm, a few stt, iot and MCP.
+const std::string_view kMessages[] = {
+    R"({"type":"tts","state":"start","sample_rate":24000,)"
+    R"("session_id":"a1b2c3"})",
+    R"({"type":"stt","text":"\u4eca\u5929\u5929\u6c14\u600e\u4e48\u6837",)"
+    R"("session_id":"a1b2c3"})",
+    R"({"type":"llm","emotion":"happy","text":"\ud83d\ude00",)"
+    R"("session_id":"a1b2c3"})",
+    R"({"type":"tts","state":"sentence_start",)"
+    R"("text":"今天晴，最高二十六度。","session_id":"a1b2c3"})",
+    R"({"type":"tts","state":"sentence_end",)"
+    R"("text":"今天晴，最高二十六度。","session_id":"a1b2c3"})",
+    R"({"type":"iot","commands":[{"name":"Speaker","method":"SetVolume",)"
+    R"("parameters":{"volume":60}},{"name":"Lamp","method":"TurnOn",)"
+    R"("parameters":{}}]})",
+    R"({"type":"mcp","session_id":"a1b2c3","payload":{"jsonrpc":"2.0",)"
+    R"("id":7,"method":"tools/call","params":{)"
+    R"("name":"self.audio_speaker.set_volume","arguments":{"volume":42}}}})",
+    R"({"type":"tts","state":"stop","session_id":"a1b2c3"})",
+};
+
+// An MCP tools/list reply of the size a full device reports (~8 KB).
+std::string tools_list_reply() {
+  std::string s =
+      R"({"type":"mcp","payload":{"jsonrpc":"2.0","id":1,"result":{"tools":[)";
+  for (int i = 0; i < 24; ++i) {
+    if (i != 0) s += ',';
+    s += R"({"name":"self.device.tool_)" + std::to_string(i) +
+         R"(","description":"Adjusts setting )" + std::to_string(i) +
+         R"( of the device. Use when the user asks to change it.",)"
+         R"("inputSchema":{"type":"object","properties":{"value":)"
+         R"({"type":"integer","minimum":0,"maximum":100},"mode":)"
+         R"({"type":"string","enum":["auto","manual"]}},)"
+         R"("required":["value"]}})";
+  }
+  s += "]}}}";
+  return s;
+}
+
+void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: json %s\n", what);
+  std::abort();
+}
+
+void verify_parser() {
+  JsonParser parser;
+  Arena arena;
+  const JsonValue* stt = parser.parse(kMessages[1], arena);
+  if (stt == nullptr || stt->string_at("text") != "今天天气怎么样") {
+    fail("escaped string decoded wrong");
+  }
+  const JsonValue* llm = parser.parse(kMessages[2], arena);
+  if (llm == nullptr || llm->string_at("text") != "\xf0\x9f\x98\x80") {
+    fail("surrogate pair decoded wrong");
+  }
+  const JsonValue* mcp = parser.parse(kMessages[6], arena);
+  const JsonValue* args =
+      mcp == nullptr ? nullptr
+                     : mcp->find("payload")->find("params")->find("arguments");
+  if (args == nullptr || args->find("volume")->as_int() != 42) {
+    fail("nested number wrong");
+  }
+  const JsonValue* iot = parser.parse(kMessages[5], arena);
+  if (iot == nullptr || iot->find("commands")->items().size() != 2 ||
+      iot->find("commands")->items()[1].string_at("method") != "TurnOn") {
+    fail("array wrong");
+  }
+  const std::string reply = tools_list_reply();
+  const JsonValue* tools = parser.parse(reply, arena);
+  if (tools == nullptr || tools->find("payload")
+                                  ->find("result")
+                                  ->find("tools")
+                                  ->items()
+                                  .size() != 24) {
+    fail("tools/list reply wrong");
+  }
+  const std::string too_deep = std::string(40, '[') + std::string(40, ']');
+  for (std::string_view bad :
+       {std::string_view(R"({"a":1,})"), std::string_view("[01]"),
+        std::string_view(R"({"a" 1})"), std::string_view("\"tab\tin\""),
+        std::string_view(R"({"a":1} x)"), std::string_view("[1.]"),
+        std::string_view(R"("\x")"), std::string_view(too_deep)}) {
+    if (parser.parse(bad, arena) != nullptr) fail("accepted malformed input");
+  }
+}
+
+void parse_arena(State& state) {
+  verify_parser();
+  JsonParser parser;
+  Arena arena;
+  size_t i = 0;
+  for (auto _ : state) {
+    const JsonValue* msg = parser.parse(kMessages[i], arena);
+    do_not_optimize(msg->string_at("type").data());
+    arena.reset();
+    i = (i + 1) % std::size(kMessages);
+  }
+}
+XIAOZI_BENCH("json/parse_arena_control_message", parse_arena);
+
+// The DOM this replaces: every node, key and string on the heap.
+struct HeapJson {
+  enum Kind { kNull, kBool, kNumber, kString, kArray, kObject } kind = kNull;
+  bool boolean = false;
+  double number = 0;
+  std::string string;
+  std::vector<std::unique_ptr<HeapJson>> items;
+  std::map<std::string, std::unique_ptr<HeapJson>> members;
+};
+
+class HeapParser {
+ public:
+  explicit HeapParser(std::string_view text)
+      : p_(text.data()), end_(text.data() + text.size()) {}
+
+  std::unique_ptr<HeapJson> value() {
+    space();
+    auto v = std::make_unique<HeapJson>();
+    if (*p_ == '{') {
+      v->kind = HeapJson::kObject;
+      ++p_;
+      space();
+      while (*p_ != '}') {
+        std::string key = string();
+        space();
+        ++p_;  // ':'
+        v->members[std::move(key)] = value();
+        space();
+        if (*p_ == ',') ++p_;
+        space();
+      }
+      ++p_;
+    } else if (*p_ == '[') {
+      v->kind = HeapJson::kArray;
+      ++p_;
+      space();
+      while (*p_ != ']') {
+        v->items.push_back(value());
+        space();
+        if (*p_ == ',') ++p_;
+      }
+      ++p_;
+    } else if (*p_ == '"') {
+      v->kind = HeapJson::kString;
+      v->string = string();
+    } else if (*p_ == 't' || *p_ == 'f') {
+      v->kind = HeapJson::kBool;
+      v->boolean = *p_ == 't';
+      p_ += v->boolean ? 4 : 5;
+    } else if (*p_ == 'n') {
+      p_ += 4;
+    } else {
+      v->kind = HeapJson::kNumber;
+      char* stop;
+      v->number = std::strtod(p_, &stop);
+      p_ = stop;
+    }
+    return v;
+  }
+
+ private:
+  void space() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\n')) ++p_;
+  }
+  // Escapes are kept as-is; decoding would only make the baseline slower.
+  std::string string() {
+    const char* start = ++p_;
+    while (*p_ != '"') p_ += *p_ == '\\' ? 2 : 1;
+    return std::string(start, p_++);
+  }
+
+  const char* p_;
+  const char* end_;
+};
+
+// The heap parser needs terminated input; std::string provides it.
+std::vector<std::string> terminated_messages() {
+  return {std::begin(kMessages), std::end(kMessages)};
+}
+
+void parse_heap_dom(State& state) {
+  const std::vector<std::string> messages = terminated_messages();
+  size_t i = 0;
+  for (auto _ : state) {
+    auto msg = HeapParser(messages[i]).value();
+    do_not_optimize(msg->members["type"]->string.data());
+    i = (i + 1) % messages.size();
+  }
+}
+XIAOZI_BENCH("json/parse_heap_dom_control_message", parse_heap_dom);
+
+// Throughput on a large document; ns/op is per ~8 KB reply.
+void parse_arena_tools_list(State& state) {
+  const std::string reply = tools_list_reply();
+  JsonParser parser;
+  Arena arena(16384);
+  for (auto _ : state) {
+    do_not_optimize(parser.parse(reply, arena));
+    arena.reset();
+  }
+}
+XIAOZI_BENCH("json/parse_arena_tools_list_8k", parse_arena_tools_list);
+
+void parse_heap_dom_tools_list(State& state) {
+  const std::string reply = tools_list_reply();
+  for (auto _ : state) do_not_optimize(HeapParser(reply).value());
+}
+XIAOZI_BENCH("json/parse_heap_dom_tools_list_8k", parse_heap_dom_tools_list);
+
+}  // namespace
+}  // namespace xiaozi::bench
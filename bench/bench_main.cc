@@ -0,0 +1,142 @@
+// xiaozi_bench: runs every registered case and writes one line per case to
+// bench_output.txt (see format_result() for the line format). With
+// XIAOZI_TRACE each case is followed by the latency histograms of the
+// pipeline stages it ran, as `# trace <case> <stage> ...` comment lines.
+//
+//   xiaozi_bench [--filter=<substring>] [--benchtime=<ms>] [--out=<path>]
+//                [--list] [--check]
+//
+// Most cases verify what they measure before timing it (bit-exact SIMD
+// kernels, a converged canceller, a round-tripped pack) and abort on a
+// mismatch. --check runs every case once, untimed and without writing
+// bench_output.txt, so those checks can run as a ctest test.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "base/trace.h"
+#include "bench.h"
+
+namespace {
+
+constexpr const char* kFormatHeader =
+    "# xiaozi_bench v1: name iterations ns/op B/op allocs/op";
+
+bool parse_flag(std::string_view arg, std::string_view name,
+                std::string* value) {
+  if (arg.substr(0, name.size()) != name) return false;
+  arg.remove_prefix(name.size());
+  if (arg.empty() || arg.front() != '=') return false;
+  *value = std::string(arg.substr(1));
+  return true;
+}
+
+void usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s [--filter=<substring>] [--benchtime=<ms>] "
+               "[--out=<path>] [--list] [--check]\n",
+               argv0);
+}
+
+#if defined(XIAOZI_TRACE)
+// Histograms cover every run of the case, calibration runs included.
+void write_trace_stats(std::FILE* out, const std::string& name) {
+  const std::string stats = xiaozi::trace::format_stats();
+  xiaozi::trace::reset();
+  std::size_t begin = 0;
+  while (begin < stats.size()) {
+    std::size_t end = stats.find('\n', begin);
+    std::string line =
+        "# trace " + name + " " + stats.substr(begin, end - begin);
+    std::fprintf(out, "%s\n", line.c_str());
+    std::printf("%s\n", line.c_str());
+    begin = end + 1;
+  }
+}
+#endif
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string filter;
+  std::string out_path = "bench_output.txt";
+  uint64_t benchtime_ms = 200;
+  bool list_only = false;
+  bool check_only = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    std::string value;
+    if (parse_flag(arg, "--filter", &value)) {
+      filter = value;
+    } else if (parse_flag(arg, "--out", &value)) {
+      out_path = value;
+    } else if (parse_flag(arg, "--benchtime", &value)) {
+      benchtime_ms = std::strtoull(value.c_str(), nullptr, 10);
+      if (benchtime_ms == 0) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (arg == "--list") {
+      list_only = true;
+    } else if (arg == "--check") {
+      check_only = true;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  auto cases = xiaozi::bench::registry();
+  std::sort(cases.begin(), cases.end(),
+            [](const auto& a, const auto& b) { return a.name < b.name; });
+
+  if (list_only) {
+    for (const auto& c : cases) std::printf("%s\n", c.name.c_str());
+    return 0;
+  }
+
+  if (check_only) {
+    for (const auto& c : cases) {
+      if (!filter.empty() && c.name.find(filter) == std::string::npos) {
+        continue;
+      }
+      xiaozi::bench::State state(1);
+      c.fn(state);
+      std::printf("%s %s\n", state.skipped() ? "skip" : "ok  ",
+                  c.name.c_str());
+      std::fflush(stdout);
+    }
+    return 0;
+  }
+
+  std::FILE* out = std::fopen(out_path.c_str(), "w");
+  if (out == nullptr) {
+    std::fprintf(stderr, "xiaozi_bench: cannot open %s: %s\n",
+                 out_path.c_str(), std::strerror(errno));
+    return 1;
+  }
+  std::fprintf(out, "%s\n", kFormatHeader);
+  std::printf("%s\n", kFormatHeader);
+
+  for (const auto& c : cases) {
+    if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+    auto result = xiaozi::bench::run(c, benchtime_ms * 1000000);
+    auto line = xiaozi::bench::format_result(result);
+    std::fprintf(out, "%s\n", line.c_str());
+    std::printf("%s\n", line.c_str());
+#if defined(XIAOZI_TRACE)
+    write_trace_stats(out, c.name);
+#endif
+    std::fflush(out);
+    std::fflush(stdout);
+  }
+
+  std::fclose(out);
+  return 0;
+}
@@ -0,0 +1,380 @@
+// MCP request handling on a device offering 24 tools, against the usual
+// first version: the descriptor list serialized again for every tools/list
+// and tools/call matched by comparing the name with each tool in turn,
+// arguments looked up by hand. ns/op is one request, parse included.
+//
+// Checks before timing, any failure aborts: every tool is reached by name
+// with its typed arguments, tools/list parses and lists every tool with
+// its schema, is rendered once per change and not per request, unknown
+// tools, bad arguments, and unknown methods get the JSON-RPC errors, ids
+// are echoed as sent, notifications get no reply, and the stats tool
+// answers with the trace and memory stats.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base/perfect_hash.h"
+#include "base/trace.h"
+#include "bench.h"
+#include "memory/arena.h"
+#include "memory/memory_domain.h"
+#include "protocol/json.h"
+#include "protocol/mcp_server.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr int kTools = 24;
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: mcp %s\n", what);
+  std::abort();
+}
+
+struct SetValue {
+  int64_t value = 0;
+  std::string_view mode = "auto";
+};
+
+std::string tool_name(int i) {
+  return "self.device.tool_" + std::to_string(i);
+}
+
+// Tool i stores its last arguments in calls[i].
+struct Device {
+  McpServer server;
+  std::vector<SetValue> calls = std::vector<SetValue>(kTools);
+
+  Device() {
+    for (int i = 0; i < kTools; ++i) add(i);
+  }
+
+  void add(int i) {
+    server.add_tool<SetValue>(
+        tool_name(i),
+        "Adjusts a setting of the device. Use when the user asks to "
+        "change it.",
+        {McpParam<SetValue>::integer("value", &SetValue::value, 0, 100),
+         McpParam<SetValue>::string("mode", &SetValue::mode).optional()},
+        [this, i](const SetValue& args, std::string& text) {
+          calls[static_cast<std::size_t>(i)] = args;
+          text = "ok";
+          return true;
+        });
+  }
+};
+
+std::string call_request(int tool, int value) {
+  return R"({"jsonrpc":"2.0","id":7,"method":"tools/call","params":{)"
+         R"("name":")" +
+         tool_name(tool) + R"(","arguments":{"value":)" +
+         std::to_string(value) + R"(,"mode":"manual"}}})";
+}
+
+constexpr std::string_view kListRequest =
+    R"({"jsonrpc":"2.0","id":"list-1","method":"tools/list"})";
+
+// Parses `request`, handles it and parses the reply back.
+const JsonValue* exchange(McpServer& server, std::string_view request,
+                          Arena& arena, std::string& reply) {
+  JsonParser parser;
+  const JsonValue* r = parser.parse(request, arena);
+  if (r == nullptr) fail("request does not parse");
+  if (!server.handle(*r, arena, reply)) return nullptr;
+  const JsonValue* parsed = parser.parse(reply, arena);
+  if (parsed == nullptr) fail("reply does not parse");
+  return parsed;
+}
+
+int64_t error_code(const JsonValue* reply) {
+  const JsonValue* error = reply->find("error");
+  return error == nullptr ? 0 : error->find("code")->as_int().value_or(0);
+}
+
+void check_server() {
+  Device d;
+  Arena arena;
+  std::string reply;
+  for (int i = 0; i < kTools; ++i) {
+    const std::string request = call_request(i, i + 50);
+    const JsonValue* r = exchange(d.server, request, arena, reply);
+    const JsonValue* result = r->find("result");
+    if (result == nullptr || result->find("isError")->as_bool(true) ||
+        result->find("content")->items()[0].string_at("text") != "ok") {
+      fail("tools/call did not succeed");
+    }
+    if (d.calls[i].value != i + 50 || d.calls[i].mode != "manual") {
+      fail("arguments not delivered to the tool");
+    }
+    if (r->find("id")->as_int() != 7) fail("numeric id not echoed");
+  }
+
+  const McpServer::Stats before = d.server.stats();
+  for (int pass = 0; pass < 3; ++pass) {
+    const JsonValue* r = exchange(d.server, kListRequest, arena, reply);
+    const JsonValue* tools = r->find("result")->find("tools");
+    if (r->string_at("id") != "list-1") fail("string id not echoed");
+    if (tools->items().size() != kTools ||
+        tools->items()[3].string_at("name") != tool_name(3) ||
+        tools->items()[3]
+                .find("inputSchema")
+                ->find("properties")
+                ->find("value")
+                ->find("maximum")
+                ->as_int() != 100 ||
+        tools->items()[3].find("inputSchema")->find("required")->size() !=
+            1) {
+      fail("tools/list wrong");
+    }
+  }
+  if (d.server.stats().list_renders != before.list_renders) {
+    fail("tools/list rendered again without a change");
+  }
+  d.server.remove_tool(tool_name(5));
+  if (exchange(d.server, kListRequest, arena, reply)
+              ->find("result")
+              ->find("tools")
+              ->items()
+              .size() != kTools - 1 ||
+      d.server.stats().list_renders != before.list_renders + 1) {
+    fail("removing a tool did not refresh tools/list");
+  }
+  if (error_code(exchange(d.server, call_request(5, 1), arena, reply)) !=
+      -32602) {
+    fail("removed tool still callable");
+  }
+  d.add(5);
+  if (error_code(exchange(d.server, call_request(5, 1), arena, reply)) != 0) {
+    fail("re-added tool not callable");
+  }
+
+  // Out of range, wrong type, missing.
+  for (std::string_view args :
+       {R"({"value":101})", R"({"value":"high"})", R"({"mode":"auto"})"}) {
+    const std::string request =
+        R"({"jsonrpc":"2.0","id":1,"method":"tools/call","params":{)"
+        R"("name":"self.device.tool_1","arguments":)" +
+        std::string(args) + "}}";
+    if (error_code(exchange(d.server, request, arena, reply)) != -32602 ||
+        reply.find("value") == std::string::npos) {
+      fail("bad arguments not reported");
+    }
+  }
+  if (error_code(exchange(
+          d.server, R"({"jsonrpc":"2.0","id":2,"method":"resources/list"})",
+          arena, reply)) != -32601) {
+    fail("unknown method not reported");
+  }
+  if (exchange(d.server,
+               R"({"jsonrpc":"2.0","method":"notifications/initialized"})",
+               arena, reply) != nullptr ||
+      !reply.empty()) {
+    fail("notification answered");
+  }
+  if (d.server.add_tool<SetValue>(tool_name(0), "", {}, {})) {
+    fail("duplicate tool name accepted");
+  }
+
+  if (!add_stats_tool(d.server) || add_stats_tool(d.server)) {
+    fail("stats tool not registered once");
+  }
+  std::string expected;
+#if defined(XIAOZI_TRACE)
+  trace::record(trace::Stage::kVad, 1000);
+  expected = trace::format_stats();
+#endif
+  expected += memory::format_stats();
+  const JsonValue* r = exchange(
+      d.server,
+      R"({"jsonrpc":"2.0","id":3,"method":"tools/call","params":{)"
+      R"("name":"self.get_stats"}})",
+      arena, reply);
+  const JsonValue* result = r->find("result");
+  if (result == nullptr || result->find("isError")->as_bool(true) ||
+      result->find("content")->items()[0].string_at("text") != expected) {
+    fail("stats tool did not reply with the trace and memory stats");
+  }
+#if defined(XIAOZI_TRACE)
+  trace::reset();
+#endif
+}
+
+void check_mcp() {
+  static const bool checked = [] {
+    check_server();
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+// The first version: descriptors kept as a list of structs and serialized
+// per request, calls matched by comparing names.
+struct LinearDevice {
+  struct Tool {
+    std::string name;
+    std::string description;
+    std::function<void(int64_t, std::string_view)> handler;
+  };
+  std::vector<Tool> tools;
+  int64_t last = 0;
+
+  LinearDevice() {
+    for (int i = 0; i < kTools; ++i) {
+      tools.push_back({tool_name(i),
+                       "Adjusts a setting of the device. Use when the user "
+                       "asks to change it.",
+                       [this](int64_t v, std::string_view) { last = v; }});
+    }
+  }
+
+  void handle(const JsonValue& request, std::string& reply) {
+    const std::string_view method = request.string_at("method");
+    reply = R"({"jsonrpc":"2.0","id":)";
+    reply += request.find("id")->is_string()
+                 ? "\"" + std::string(request.string_at("id")) + "\""
+                 : std::string(request.find("id")->number_text());
+    if (method == "tools/list") {
+      reply += R"(,"result":{"tools":[)";
+      for (std::size_t i = 0; i < tools.size(); ++i) {
+        if (i != 0) reply += ',';
+        reply += R"({"name":)";
+        append_json_string(reply, tools[i].name);
+        reply += R"(,"description":)";
+        append_json_string(reply, tools[i].description);
+        reply += R"(,"inputSchema":{"type":"object","properties":{)"
+                 R"("value":{"type":"integer","minimum":0,"maximum":100},)"
+                 R"("mode":{"type":"string"}},"required":["value"]}})";
+      }
+      reply += "]}}";
+    } else if (method == "tools/call") {
+      const JsonValue* params = request.find("params");
+      const std::string_view name = params->string_at("name");
+      for (const Tool& t : tools) {
+        if (t.name != name) continue;
+        const JsonValue* args = params->find("arguments");
+        t.handler(args->find("value")->as_int().value_or(0),
+                  args->string_at("mode"));
+        reply += R"(,"result":{"content":[{"type":"text","text":"ok"}],)"
+                 R"("isError":false}})";
+        return;
+      }
+      reply += R"(,"error":{"code":-32602,"message":"unknown tool"}})";
+    }
+  }
+};
+
+std::vector<std::string> call_requests() {
+  std::vector<std::string> requests;
+  for (int i = 0; i < kTools; ++i) requests.push_back(call_request(i, 42));
+  return requests;
+}
+
+void call_registry(State& state) {
+  check_mcp();
+  Device d;
+  const std::vector<std::string> requests = call_requests();
+  JsonParser parser;
+  Arena arena;
+  std::string reply;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const JsonValue* r = parser.parse(requests[i], arena);
+    d.server.handle(*r, arena, reply);
+    do_not_optimize(reply.data());
+    arena.reset();
+    i = (i + 1) % requests.size();
+  }
+}
+XIAOZI_BENCH("mcp/tools_call_registry", call_registry);
+
+void call_linear(State& state) {
+  check_mcp();
+  LinearDevice d;
+  const std::vector<std::string> requests = call_requests();
+  JsonParser parser;
+  Arena arena;
+  std::string reply;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const JsonValue* r = parser.parse(requests[i], arena);
+    d.handle(*r, reply);
+    do_not_optimize(reply.data());
+    arena.reset();
+    i = (i + 1) % requests.size();
+  }
+}
+XIAOZI_BENCH("mcp/tools_call_linear", call_linear);
+
+void list_cached(State& state) {
+  check_mcp();
+  Device d;
+  JsonParser parser;
+  Arena arena;
+  std::string reply;
+  for (auto _ : state) {
+    const JsonValue* r = parser.parse(kListRequest, arena);
+    d.server.handle(*r, arena, reply);
+    do_not_optimize(reply.data());
+    arena.reset();
+  }
+}
+XIAOZI_BENCH("mcp/tools_list_cached", list_cached);
+
+void list_rendered(State& state) {
+  check_mcp();
+  LinearDevice d;
+  JsonParser parser;
+  Arena arena;
+  std::string reply;
+  for (auto _ : state) {
+    const JsonValue* r = parser.parse(kListRequest, arena);
+    d.handle(*r, reply);
+    do_not_optimize(reply.data());
+    arena.reset();
+  }
+}
+XIAOZI_BENCH("mcp/tools_list_rendered", list_rendered);
+
+// Name lookup alone: the perfect hash against comparing in turn, over the
+// same 24 names.
+void lookup_perfect_hash(State& state) {
+  check_mcp();
+  std::vector<std::string> names;
+  for (int i = 0; i < kTools; ++i) names.push_back(tool_name(i));
+  PerfectHash index;
+  if (!index.build({names.begin(), names.end()})) fail("hash build failed");
+  std::size_t i = 0;
+  for (auto _ : state) {
+    do_not_optimize(index.find(names[i]));
+    i = (i + 1) % names.size();
+  }
+}
+XIAOZI_BENCH("mcp/lookup_perfect_hash", lookup_perfect_hash);
+
+void lookup_linear(State& state) {
+  check_mcp();
+  std::vector<std::string> names;
+  for (int i = 0; i < kTools; ++i) names.push_back(tool_name(i));
+  std::size_t i = 0;
+  for (auto _ : state) {
+    const std::string_view key = names[i];
+    int found = -1;
+    for (std::size_t j = 0; j < names.size(); ++j) {
+      if (names[j] == key) {
+        found = static_cast<int>(j);
+        break;
+      }
+    }
+    do_not_optimize(found);
+    i = (i + 1) % names.size();
+  }
+}
+XIAOZI_BENCH("mcp/lookup_linear", lookup_linear);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,223 @@
+// Memory domain accounting (memory/memory_domain.h): the cost every
+// charged allocation pays.
+// - charge_release: one try_charge() and release() pair, profile off;
+// - charge_release_sampled: the same with the sampled profile on;
+// - json_budgeted: a control message parsed into an arena whose domain
+//   has a budget, the arena reset each time (cf. json/parse_hello).
+//
+// Checks before timing, any failure aborts: charges show up in the
+// domain's live, current and peak counters and go away on release, a
+// budget refuses what would cross it and counts the refusal, a pool over
+// budget is built smaller and gives its bytes back, an arena over budget
+// fails the parse instead of growing and parses again once there is
+// room, heap coroutine frames are charged and released, and the sampled
+// profile logs charges with their sizes.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "bench.h"
+#include "memory/arena.h"
+#include "memory/frame_pool.h"
+#include "memory/memory_domain.h"
+#include "protocol/json.h"
+#include "runtime/frame_allocator.h"
+
+namespace xiaozi::bench {
+namespace {
+
+// Other cases' pools and arenas are charged here too, so the checks look
+// at deltas.
+constexpr MemoryDomain kDomain = MemoryDomain::kUntagged;
+
+constexpr std::string_view kHello =
+    R"({"type":"hello","version":1,"transport":"websocket","features":)"
+    R"({"mcp":true},"audio_params":{"format":"opus","sample_rate":16000,)"
+    R"("channels":1,"frame_duration":60}})";
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: memory %s\n", what);
+  std::abort();
+}
+
+void check_counters() {
+  const memory::DomainStats before = memory::stats(kDomain);
+  memory::charge(kDomain, 1000);
+  if (!memory::try_charge(kDomain, 500)) fail("unbudgeted charge refused");
+  memory::DomainStats s = memory::stats(kDomain);
+  if (s.live != before.live + 2 ||
+      s.current_bytes != before.current_bytes + 1500 ||
+      s.peak_bytes < s.current_bytes) {
+    fail("charges not counted");
+  }
+  memory::release(kDomain, 1000);
+  memory::release(kDomain, 500);
+  s = memory::stats(kDomain);
+  if (s.live != before.live || s.current_bytes != before.current_bytes ||
+      s.peak_bytes < before.current_bytes + 1500) {
+    fail("releases not counted, or peak lost");
+  }
+}
+
+void check_budget() {
+  const uint64_t base = memory::stats(kDomain).current_bytes;
+  memory::set_budget(kDomain, base + 4096);
+  if (memory::headroom(kDomain) != 4096) fail("headroom off");
+  if (!memory::try_charge(kDomain, 4000)) fail("charge under budget refused");
+  const uint64_t refusals = memory::stats(kDomain).refusals;
+  if (memory::try_charge(kDomain, 100)) fail("charge over budget accepted");
+  if (memory::stats(kDomain).refusals != refusals + 1) {
+    fail("refusal not counted");
+  }
+  if (memory::stats(kDomain).current_bytes != base + 4000) {
+    fail("refused charge counted");
+  }
+  memory::release(kDomain, 4000);
+
+  // Room for about 4 of the 16 blocks.
+  const std::size_t per_block = FramePool::storage_bytes(256, 1) + 2;
+  memory::set_budget(kDomain, base + 4 * per_block + per_block / 2);
+  {
+    FramePool pool(256, 16, kDomain);
+    if (pool.block_count() != 4 || !pool.acquire()) {
+      fail("pool over budget not built smaller");
+    }
+    if (memory::stats(kDomain).current_bytes != base + 4 * per_block) {
+      fail("pool storage not charged");
+    }
+  }
+  memory::set_budget(kDomain, base + 1);
+  {
+    FramePool pool(256, 16, kDomain);
+    if (pool.block_count() != 1) fail("pool without room not one block");
+  }
+  if (memory::stats(kDomain).current_bytes != base) {
+    fail("pool storage not released");
+  }
+  memory::set_budget(kDomain, 0);
+}
+
+void check_arena() {
+  std::string big = "[";
+  for (int i = 0; i < 2000; ++i) big += i == 0 ? "\"a\\n\"" : ",\"a\\n\"";
+  big += "]";
+  const uint64_t base = memory::stats(kDomain).current_bytes;
+  JsonParser parser;
+  {
+    Arena arena(1024, kDomain);
+    memory::set_budget(kDomain, base + 2048);
+    if (parser.parse(big, arena) != nullptr) fail("arena grew past budget");
+    if (memory::stats(kDomain).current_bytes > base + 2048) {
+      fail("arena charged past budget");
+    }
+    arena.reset();
+    if (parser.parse(kHello, arena) == nullptr) {
+      fail("small message refused after a refusal");
+    }
+    memory::set_budget(kDomain, 0);
+    arena.reset();
+    if (parser.parse(big, arena) == nullptr) {
+      fail("parse still refused without a budget");
+    }
+  }
+  if (memory::stats(kDomain).current_bytes != base) {
+    fail("arena blocks not released");
+  }
+}
+
+void check_frames() {
+  FrameAllocator::Config config;
+  config.blocks = {1, 0, 0, 0};
+  config.domain = kDomain;
+  FrameAllocator frames(config);
+  const memory::DomainStats before = memory::stats(kDomain);
+  void* pooled = frames.allocate(64);
+  void* heap = frames.allocate(8192);
+  const memory::DomainStats s = memory::stats(kDomain);
+  if (s.live != before.live + 1 ||
+      s.current_bytes < before.current_bytes + 8192) {
+    fail("heap frame not charged");
+  }
+  frames.deallocate(heap);
+  frames.deallocate(pooled);
+  if (memory::stats(kDomain).current_bytes != before.current_bytes) {
+    fail("heap frame not released");
+  }
+}
+
+void check_samples() {
+  static const int site = 0;
+  memory::set_sample_interval(4096);
+  const std::size_t before = memory::samples().size();
+  for (int i = 0; i < 16; ++i) {
+    memory::charge(kDomain, 1024, &site);
+    memory::release(kDomain, 1024);
+  }
+  memory::set_sample_interval(0);
+  const auto samples = memory::samples();
+  if (samples.size() < before + 3 || samples.size() > before + 5) {
+    fail("sample rate off");
+  }
+  const memory::Sample& last = samples.back();
+  if (last.bytes != 1024 || last.domain != kDomain ||
+      last.site != reinterpret_cast<uintptr_t>(&site)) {
+    fail("sample fields wrong");
+  }
+  if (memory::format_stats().find("memory untagged live=") ==
+      std::string::npos) {
+    fail("domain missing from format_stats");
+  }
+}
+
+void check_memory() {
+  static const bool checked = [] {
+    check_counters();
+    check_budget();
+    check_arena();
+    check_frames();
+    check_samples();
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void charge_release(State& state) {
+  check_memory();
+  for (auto _ : state) {
+    do_not_optimize(memory::try_charge(kDomain, 256));
+    memory::release(kDomain, 256);
+  }
+}
+XIAOZI_BENCH("memory/charge_release", charge_release);
+
+void charge_release_sampled(State& state) {
+  check_memory();
+  memory::set_sample_interval(512 * 1024);
+  for (auto _ : state) {
+    do_not_optimize(memory::try_charge(kDomain, 256));
+    memory::release(kDomain, 256);
+  }
+  memory::set_sample_interval(0);
+}
+XIAOZI_BENCH("memory/charge_release_sampled", charge_release_sampled);
+
+void json_budgeted(State& state) {
+  check_memory();
+  const uint64_t base = memory::stats(kDomain).current_bytes;
+  memory::set_budget(kDomain, base + 64 * 1024);
+  {
+    Arena arena(4096, kDomain);
+    JsonParser parser;
+    for (auto _ : state) {
+      arena.reset();
+      do_not_optimize(parser.parse(kHello, arena));
+    }
+  }
+  memory::set_budget(kDomain, 0);
+}
+XIAOZI_BENCH("memory/json_budgeted", json_budgeted);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,439 @@
+// Firmware update apply on the device side, into a partition in RAM:
+// ns/op is one whole 512 KiB image.
+// - apply_delta: a compressed delta against the running image;
+// - apply_full_lz: the whole image, LZ-compressed;
+// - apply_full_raw: the whole image, uncompressed (flash and hash only);
+// plus the pieces on their own, per 16 KiB block: SHA-256 and LZ decode.
+//
+// Checks before timing, any failure aborts: the delta is a small fraction
+// of the compressed image, every kind of file applies byte-exact when fed
+// in random pieces, the decode window stays under 64 KiB whatever the
+// image size, a delta against the wrong base and a corrupted file are
+// refused, a stream rebuilt from a checkpoint finishes the update, and
+// OtaUpdater completes a download whose connection keeps dropping by
+// resuming with range requests.
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/sha256.h"
+#include "bench.h"
+#include "net/url.h"
+#include "ota/flash_partition.h"
+#include "ota/lz_block.h"
+#include "ota/ota_updater.h"
+#include "ota/update_stream.h"
+#include "ota/update_writer.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr std::size_t kImageWords = 128 * 1024;  // 512 KiB
+constexpr std::size_t kPartitionBytes = 1024 * 1024;
+constexpr std::size_t kSectorBytes = 4096;
+constexpr std::size_t kMaxWindowBytes = 64 * 1024;
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: ota %s\n", what);
+  std::abort();
+}
+
+uint32_t next_random(uint32_t& seed) {
+  seed = seed * 1664525u + 1013904223u;
+  return seed >> 8;
+}
+
+// A stand-in for a firmware image: mostly instruction words from a small
+// vocabulary, PC-relative branches, absolute addresses of other words and
+// literals.
+struct Word {
+  enum Kind : uint8_t { kOpcode, kBranch, kAddress, kLiteral } kind;
+  uint32_t value;  // kAddress: index of the word it points at
+};
+
+std::vector<Word> make_program(std::size_t words, uint32_t seed) {
+  std::vector<Word> program;
+  program.reserve(words);
+  for (std::size_t i = 0; i < words; ++i) {
+    const uint32_t r = next_random(seed) % 100;
+    if (r < 70) {
+      program.push_back({Word::kOpcode, 0xe000u + next_random(seed) % 64});
+    } else if (r < 90) {
+      program.push_back({Word::kBranch, 0xf0000000u | next_random(seed)});
+    } else if (r < 95) {
+      program.push_back(
+          {Word::kAddress, static_cast<uint32_t>(next_random(seed) % words)});
+    } else {
+      program.push_back({Word::kLiteral, next_random(seed)});
+    }
+  }
+  return program;
+}
+
+// The next release: a function inserted in the middle, so everything
+// behind it moves and every address pointing there changes, a few
+// constants edited and some code added at the end.
+std::vector<Word> next_release(std::vector<Word> program) {
+  uint32_t seed = 99;
+  const std::size_t insert_at = program.size() * 2 / 5;
+  const std::vector<Word> inserted = make_program(512, 7);
+  for (Word& w : program) {
+    if (w.kind == Word::kAddress && w.value >= insert_at) w.value += 512;
+  }
+  program.insert(program.begin() + static_cast<std::ptrdiff_t>(insert_at),
+                 inserted.begin(), inserted.end());
+  for (int i = 0; i < 32; ++i) {
+    Word& w = program[next_random(seed) % program.size()];
+    if (w.kind == Word::kLiteral) w.value ^= 0x10;
+  }
+  const std::vector<Word> tail = make_program(2048, 11);
+  program.insert(program.end(), tail.begin(), tail.end());
+  return program;
+}
+
+std::vector<uint8_t> render(const std::vector<Word>& program) {
+  std::vector<uint8_t> image(program.size() * 4);
+  for (std::size_t i = 0; i < program.size(); ++i) {
+    const Word& w = program[i];
+    const uint32_t v =
+        w.kind == Word::kAddress ? 0x42000000u + w.value * 4 : w.value;
+    std::memcpy(image.data() + i * 4, &v, 4);
+  }
+  return image;
+}
+
+struct Firmware {
+  std::vector<uint8_t> v1;
+  std::vector<uint8_t> v2;
+  std::vector<uint8_t> delta;
+  std::vector<uint8_t> full_lz;
+  std::vector<uint8_t> full_raw;
+};
+
+const Firmware& firmware() {
+  static const Firmware fw = [] {
+    Firmware f;
+    const std::vector<Word> program = make_program(kImageWords, 1);
+    f.v1 = render(program);
+    f.v2 = render(next_release(program));
+    f.delta = UpdateWriter().delta(f.v1, f.v2);
+    f.full_lz = UpdateWriter().full(f.v2);
+    UpdateWriter::Config raw;
+    raw.compress = false;
+    f.full_raw = UpdateWriter(raw).full(f.v2);
+    return f;
+  }();
+  return fw;
+}
+
+MemoryPartition& running_partition() {
+  static MemoryPartition* p = [] {
+    auto* part = new MemoryPartition(kPartitionBytes, kSectorBytes);
+    const std::vector<uint8_t>& v1 = firmware().v1;
+    part->write(0, v1);
+    return part;
+  }();
+  return *p;
+}
+
+// Feeds `file` in pieces of 1..max_piece bytes.
+UpdateStream::Status feed_pieces(UpdateStream& stream,
+                                 std::span<const uint8_t> file,
+                                 std::size_t max_piece, uint32_t seed) {
+  UpdateStream::Status status = stream.status();
+  while (!file.empty() && status == UpdateStream::Status::kRunning) {
+    const std::size_t n =
+        std::min<std::size_t>(file.size(), 1 + next_random(seed) % max_piece);
+    status = stream.feed(file.first(n));
+    file = file.subspan(n);
+  }
+  return status;
+}
+
+bool holds(MemoryPartition& part, const std::vector<uint8_t>& image) {
+  return std::memcmp(part.bytes().data(), image.data(), image.size()) == 0;
+}
+
+void check_apply() {
+  const Firmware& fw = firmware();
+  if (fw.delta.size() * 10 > fw.full_lz.size()) {
+    fail("delta not well below the compressed image");
+  }
+  if (fw.full_lz.size() >= fw.full_raw.size()) fail("LZ did not compress");
+
+  for (const std::vector<uint8_t>* file :
+       {&fw.delta, &fw.full_lz, &fw.full_raw}) {
+    for (std::size_t piece : {1u, 100u, 5000u, 70000u}) {
+      MemoryPartition target(kPartitionBytes, kSectorBytes);
+      UpdateStream stream(running_partition(), target);
+      if (feed_pieces(stream, *file, piece, 5) != UpdateStream::Status::kDone ||
+          !holds(target, fw.v2)) {
+        fail("update did not apply byte-exact");
+      }
+      if (stream.window_bytes() > kMaxWindowBytes) fail("window over 64 KiB");
+      const std::size_t sectors =
+          (fw.v2.size() + kSectorBytes - 1) / kSectorBytes;
+      if (target.stats().sectors_erased != sectors) {
+        fail("sectors erased more than once");
+      }
+    }
+  }
+
+  // Against an image the delta was not made from.
+  MemoryPartition other(kPartitionBytes, kSectorBytes);
+  other.write(0, fw.v2);
+  MemoryPartition target(kPartitionBytes, kSectorBytes);
+  UpdateStream wrong_base(other, target);
+  if (wrong_base.feed(fw.delta) != UpdateStream::Status::kBadBase) {
+    fail("delta accepted against the wrong base");
+  }
+  // A flipped bit anywhere past the header.
+  for (const std::vector<uint8_t>* file : {&fw.delta, &fw.full_raw}) {
+    std::vector<uint8_t> bad = *file;
+    bad[bad.size() / 2] ^= 0x04;
+    UpdateStream stream(running_partition(), target);
+    const UpdateStream::Status s = stream.feed(bad);
+    if (s != UpdateStream::Status::kCorrupt &&
+        s != UpdateStream::Status::kHashMismatch) {
+      fail("corrupted file accepted");
+    }
+  }
+}
+
+void check_resume() {
+  const Firmware& fw = firmware();
+  for (const std::vector<uint8_t>* file : {&fw.delta, &fw.full_raw}) {
+    MemoryPartition target(kPartitionBytes, kSectorBytes);
+    UpdateStream::Checkpoint checkpoint;
+    {
+      UpdateStream first(running_partition(), target);
+      feed_pieces(first, std::span(*file).first(file->size() * 3 / 5), 3000,
+                  9);
+      checkpoint = first.checkpoint();
+    }
+    if (checkpoint.file_offset == 0) fail("no checkpoint");
+    UpdateStream second(running_partition(), target, UpdateStream::Config{},
+                        checkpoint);
+    if (feed_pieces(second, std::span(*file).subspan(checkpoint.file_offset),
+                    3000, 13) != UpdateStream::Status::kDone ||
+        !holds(target, fw.v2)) {
+      fail("resumed stream did not finish the update");
+    }
+  }
+}
+
+// Serves one file over HTTP/1.1 with Range support, closing each
+// connection after `drop_after` body bytes.
+class FlakyServer {
+ public:
+  FlakyServer(const std::vector<uint8_t>& file, std::size_t drop_after)
+      : file_(file), drop_after_(drop_after) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+        listen(listen_fd_, 4) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len)) {
+      fail("server cannot listen");
+    }
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this] { run(); });
+  }
+
+  ~FlakyServer() {
+    stop_.store(true);
+    thread_.join();
+    ::close(listen_fd_);
+  }
+
+  int port() const { return port_; }
+  uint64_t range_requests() const { return range_requests_.load(); }
+
+ private:
+  void run() {
+    while (!stop_.load()) {
+      pollfd pfd{listen_fd_, POLLIN, 0};
+      if (::poll(&pfd, 1, 10) != 1) continue;
+      const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) continue;
+      serve(fd);
+      ::close(fd);
+    }
+  }
+
+  void serve(int fd) {
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+      const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) return;
+      request.append(buf, static_cast<std::size_t>(n));
+    }
+    std::size_t from = 0;
+    constexpr std::string_view kRange = "Range: bytes=";
+    const std::size_t at = request.find(kRange);
+    std::string head;
+    if (at != std::string::npos) {
+      from = std::strtoull(request.c_str() + at + kRange.size(), nullptr, 10);
+      range_requests_.fetch_add(1);
+      head = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " +
+             std::to_string(from) + "-" + std::to_string(file_.size() - 1) +
+             "/" + std::to_string(file_.size()) + "\r\n";
+    } else {
+      head = "HTTP/1.1 200 OK\r\n";
+    }
+    head += "Content-Length: " + std::to_string(file_.size() - from) +
+            "\r\nConnection: close\r\n\r\n";
+    if (!send_all(fd, head.data(), head.size())) return;
+    const std::size_t end = std::min(file_.size(), from + drop_after_);
+    send_all(fd, file_.data() + from, end - from);
+  }
+
+  static bool send_all(int fd, const void* data, std::size_t n) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (n > 0) {
+      const ssize_t sent = ::send(fd, p, n, MSG_NOSIGNAL);
+      if (sent <= 0) return false;
+      p += sent;
+      n -= static_cast<std::size_t>(sent);
+    }
+    return true;
+  }
+
+  const std::vector<uint8_t>& file_;
+  std::size_t drop_after_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<uint64_t> range_requests_{0};
+};
+
+void check_download() {
+  const Firmware& fw = firmware();
+  FlakyServer server(fw.full_lz, 100000);
+  const auto url = parse_url("http://127.0.0.1:" +
+                             std::to_string(server.port()) + "/fw.xzup");
+  MemoryPartition target(kPartitionBytes, kSectorBytes);
+  OtaUpdater::Config config;
+  config.min_backoff = std::chrono::milliseconds(1);
+  config.fetch.allow_http = true;  // loopback
+  OtaUpdater updater(running_partition(), target, config);
+  uint64_t checkpoints = 0;
+  uint64_t last_offset = 0;
+  const OtaUpdater::Status status = updater.run(
+      *url, Sha256::of(fw.v2), [&](const UpdateStream::Checkpoint& c) {
+        if (c.file_offset <= last_offset) fail("checkpoint went backwards");
+        last_offset = c.file_offset;
+        ++checkpoints;
+      });
+  const OtaUpdater::Stats s = updater.stats();
+  if (status != OtaUpdater::Status::kDone || !holds(target, fw.v2)) {
+    fail("download over a dropping connection did not complete");
+  }
+  // Each resume refetches at most the block that was cut off.
+  const uint64_t drops = fw.full_lz.size() / 100000;
+  const uint64_t refetch = lz_bound(ota::kDefaultBlockBytes);
+  if (s.resumes < drops || server.range_requests() != s.resumes ||
+      s.requests != s.resumes + 1 || s.target_bytes != fw.v2.size() ||
+      checkpoints == 0) {
+    fail("download did not resume from its checkpoints");
+  }
+  if (s.bytes_downloaded > fw.full_lz.size() + s.resumes * refetch) {
+    fail("resume refetched more than a block");
+  }
+}
+
+void check_lz() {
+  uint32_t seed = 3;
+  std::vector<uint8_t> raw(ota::kDefaultBlockBytes);
+  for (int pass = 0; pass < 3; ++pass) {
+    for (uint8_t& b : raw) {
+      b = pass == 0 ? static_cast<uint8_t>(next_random(seed))
+                    : static_cast<uint8_t>(next_random(seed) % (pass * 3));
+    }
+    std::vector<uint8_t> packed;
+    lz_compress(raw, packed);
+    if (packed.size() > lz_bound(raw.size())) fail("LZ over its bound");
+    std::vector<uint8_t> out(raw.size());
+    if (!lz_decompress(packed, out) || out != raw) fail("LZ round trip");
+    if (lz_decompress(std::span(packed).first(packed.size() - 1), out)) {
+      fail("truncated LZ block accepted");
+    }
+  }
+}
+
+void check_ota() {
+  static const bool checked = [] {
+    const uint8_t abc[] = {'a', 'b', 'c'};
+    const Sha256::Digest d = Sha256::of(abc);
+    if (d[0] != 0xba || d[1] != 0x78 || d[31] != 0xad) fail("SHA-256 of abc");
+    check_lz();
+    check_apply();
+    check_resume();
+    check_download();
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void apply(State& state, const std::vector<uint8_t>& file) {
+  check_ota();
+  MemoryPartition target(kPartitionBytes, kSectorBytes);
+  for (auto _ : state) {
+    UpdateStream stream(running_partition(), target);
+    // Network-sized pieces.
+    for (std::size_t at = 0; at < file.size(); at += 1460) {
+      stream.feed(std::span(file).subspan(
+          at, std::min<std::size_t>(1460, file.size() - at)));
+    }
+    if (stream.status() != UpdateStream::Status::kDone) fail("apply failed");
+  }
+}
+
+void apply_delta(State& state) { apply(state, firmware().delta); }
+XIAOZI_BENCH("ota/apply_delta", apply_delta);
+
+void apply_full_lz(State& state) { apply(state, firmware().full_lz); }
+XIAOZI_BENCH("ota/apply_full_lz", apply_full_lz);
+
+void apply_full_raw(State& state) { apply(state, firmware().full_raw); }
+XIAOZI_BENCH("ota/apply_full_raw", apply_full_raw);
+
+void sha256_block(State& state) {
+  check_ota();
+  const auto block =
+      std::span(firmware().v2).first(ota::kDefaultBlockBytes);
+  for (auto _ : state) do_not_optimize(Sha256::of(block));
+}
+XIAOZI_BENCH("ota/sha256_16k", sha256_block);
+
+void lz_decode_block(State& state) {
+  check_ota();
+  const auto raw = std::span(firmware().v2).first(ota::kDefaultBlockBytes);
+  std::vector<uint8_t> packed;
+  lz_compress(raw, packed);
+  std::vector<uint8_t> out(raw.size());
+  for (auto _ : state) {
+    do_not_optimize(lz_decompress(packed, out));
+    clobber_memory();
+  }
+}
+XIAOZI_BENCH("ota/lz_decode_16k", lz_decode_block);
+
+}  // namespace
+}  // namespace xiaozi::bench
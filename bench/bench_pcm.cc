@@ -0,0 +1,95 @@
+// PCM kernels, one case per instruction set. That every variant matches
+// the scalar one bit for bit is tests/pcm_kernels_test.cc's job.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "audio/pcm_kernels.h"
+#include "bench.h"
+
+namespace xiaozi::bench {
+namespace {
+
+using pcm::Kernels;
+
+// 20 ms at 48 kHz capture rate.
+constexpr size_t kCapture20ms = 960;
+
+const Kernels* find_kernels(const char* name) {
+  for (const Kernels* k : pcm::available_kernels()) {
+    if (std::strcmp(k->name, name) == 0) return k;
+  }
+  return nullptr;
+}
+
+// Full-scale noise with runs pinned at the rails, so saturation paths and
+// the odd-length tails are both exercised.
+std::vector<int16_t> test_signal(size_t n, uint32_t seed) {
+  std::vector<int16_t> v(n);
+  for (size_t i = 0; i < n; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    v[i] = static_cast<int16_t>(seed >> 16);
+    if (i % 97 < 5) v[i] = (i & 1) ? 32767 : -32768;
+  }
+  return v;
+}
+
+const Kernels* prepare(State& state, const char* name) {
+  const Kernels* k = find_kernels(name);
+  if (k == nullptr) state.skip("not supported on this CPU or build");
+  return k;
+}
+
+void int16_to_float_20ms(State& state, const char* isa) {
+  const Kernels* k = prepare(state, isa);
+  if (k == nullptr) return;
+  auto in = test_signal(kCapture20ms, 1);
+  std::vector<float> out(kCapture20ms);
+  for (auto _ : state) {
+    k->int16_to_float(in.data(), out.data(), in.size());
+    do_not_optimize(out.data());
+    clobber_memory();
+  }
+}
+
+void gain_q12_20ms(State& state, const char* isa) {
+  const Kernels* k = prepare(state, isa);
+  if (k == nullptr) return;
+  auto samples = test_signal(kCapture20ms, 2);
+  for (auto _ : state) {
+    k->apply_gain_q12(samples.data(), samples.size(), 4105);
+    do_not_optimize(samples.data());
+    clobber_memory();
+  }
+}
+
+// The whole 48 kHz -> 16 kHz step including history handling.
+void downsample3_20ms(State& state, const char* isa) {
+  const Kernels* k = prepare(state, isa);
+  if (k == nullptr) return;
+  pcm::Downsampler3 down(*k);
+  auto in = test_signal(kCapture20ms, 3);
+  int16_t out[kCapture20ms / 3 + 1];
+  for (auto _ : state) {
+    size_t n = down.process(in, out);
+    do_not_optimize(n);
+    clobber_memory();
+  }
+}
+
+#define XIAOZI_PCM_BENCH(isa)                                               \
+  XIAOZI_BENCH("pcm/int16_to_float_20ms/" isa,                              \
+               [](State& s) { int16_to_float_20ms(s, isa); });              \
+  XIAOZI_BENCH("pcm/gain_q12_20ms/" isa,                                    \
+               [](State& s) { gain_q12_20ms(s, isa); });                    \
+  XIAOZI_BENCH("pcm/downsample3_20ms/" isa,                                 \
+               [](State& s) { downsample3_20ms(s, isa); })
+
+XIAOZI_PCM_BENCH("scalar");
+XIAOZI_PCM_BENCH("sse4.1");
+XIAOZI_PCM_BENCH("avx2");
+XIAOZI_PCM_BENCH("neon");
+
+}  // namespace
+}  // namespace xiaozi::bench
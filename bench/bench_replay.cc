@@ -0,0 +1,146 @@
+// The whole device audio path driven by a capture (PipelineReplay): ns/op
+// is one replay.
+// - pipeline_synthetic: 60 s of synthetic conversation (synthetic_capture);
+// - pipeline_capture: the capture named by $XIAOZI_REPLAY_CAPTURE, e.g.
+//   one recorded in the field; skipped when unset.
+//
+// Checks before timing, any failure aborts: a capture reads back record
+// for record as written, a capture cut off mid-record keeps the records
+// before the cut, two replays of one capture send the same packets and
+// play the same samples, every gated frame reaches the encoder, and every
+// reply in the capture is played.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "replay/capture_file.h"
+#include "replay/pipeline_replay.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr uint32_t kSeconds = 60;
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: replay %s\n", what);
+  std::abort();
+}
+
+const std::vector<uint8_t>& synthetic() {
+  static const std::vector<uint8_t> capture =
+      synthetic_capture(kSeconds, 7);
+  return capture;
+}
+
+void check_format() {
+  const CaptureFormat format = {160, false, replay::Codec::kG711, 8000, 20};
+  CaptureWriter writer(format);
+  const std::vector<int16_t> pcm(160, 1234);
+  writer.reply_start(5);
+  writer.mic(10, pcm);
+  const uint8_t packet[] = {1, 2, 3};
+  writer.packet(20, 77, packet);
+  writer.reply_end(30);
+
+  CaptureReader reader;
+  if (!reader.open(writer.bytes()) || reader.records() != 4 ||
+      reader.duration_ns() != 30 || reader.truncated() ||
+      reader.format().downlink_rate != 8000 ||
+      reader.format().frame_samples != 160) {
+    fail("capture does not read back");
+  }
+  CaptureReader::Record r;
+  if (!reader.next(r) || r.kind != replay::Kind::kReplyStart ||
+      !reader.next(r) || r.kind != replay::Kind::kMic ||
+      r.payload.size() != 320 || r.payload[0] != (1234 & 0xff) ||
+      !reader.next(r) || r.kind != replay::Kind::kPacket ||
+      r.sequence != 77 || r.payload.size() != 3 || r.payload[2] != 3 ||
+      !reader.next(r) || r.kind != replay::Kind::kReplyEnd ||
+      reader.next(r)) {
+    fail("records differ from what was written");
+  }
+
+  std::vector<uint8_t> cut = writer.bytes();
+  cut.resize(cut.size() - 16 - 2);  // into the packet record
+  if (!reader.open(cut) || !reader.truncated() || reader.records() != 2) {
+    fail("cut-off capture not opened up to the cut");
+  }
+  std::vector<uint8_t> bad = writer.bytes();
+  bad[0] = 'Y';
+  if (reader.open(bad)) fail("foreign file opened as a capture");
+}
+
+void check_replay() {
+  CaptureReader capture;
+  if (!capture.open(synthetic())) fail("synthetic capture does not open");
+  PipelineReplay replay(capture.format());
+  if (!replay.ok()) fail("synthetic capture not replayable");
+  const PipelineReplay::Result a = replay.run(capture);
+  const PipelineReplay::Result b = replay.run(capture);
+  if (a.uplink_digest != b.uplink_digest ||
+      a.playback_digest != b.playback_digest ||
+      a.uplink_packets != b.uplink_packets ||
+      a.max_first_audio_ns != b.max_first_audio_ns) {
+    fail("two replays differ");
+  }
+  // G.711 sends one packet per 20 ms frame.
+  if (a.mic_frames != kSeconds * 50 || a.vad_wakes == 0 ||
+      a.uplink_packets != a.frames_forwarded) {
+    fail("uplink frames lost between gate and encoder");
+  }
+  const uint64_t replies = (kSeconds + 6) / 8;
+  if (a.replies != replies || a.played_samples < replies * 16000) {
+    fail("replies not played");
+  }
+}
+
+void check_replay_all() {
+  static const bool checked = [] {
+    check_format();
+    check_replay();
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void run_capture(State& state, CaptureReader& capture) {
+  PipelineReplay replay(capture.format());
+  if (!replay.ok()) {
+    state.skip("capture not replayable in this build");
+    return;
+  }
+  for (auto _ : state) {
+    const PipelineReplay::Result r = replay.run(capture);
+    do_not_optimize(r.uplink_digest);
+  }
+}
+
+void pipeline_synthetic(State& state) {
+  check_replay_all();
+  CaptureReader capture;
+  capture.open(synthetic());
+  run_capture(state, capture);
+}
+XIAOZI_BENCH("replay/pipeline_synthetic", pipeline_synthetic);
+
+void pipeline_capture(State& state) {
+  check_replay_all();
+  const char* path = std::getenv("XIAOZI_REPLAY_CAPTURE");
+  if (path == nullptr || *path == '\0') {
+    state.skip("set XIAOZI_REPLAY_CAPTURE to a capture file");
+    return;
+  }
+  CaptureReader capture;
+  if (!capture.load(path)) {
+    state.skip("XIAOZI_REPLAY_CAPTURE is not a capture");
+    return;
+  }
+  run_capture(state, capture);
+}
+XIAOZI_BENCH("replay/pipeline_capture", pipeline_capture);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,101 @@
+// Capture -> processing handoff: the lock-free ring against the
+// mutex-guarded deque it replaces.
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "bench.h"
+#include "memory/spsc_ring.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr size_t kPcm20msSamples = 320;
+
+void spsc_push_pop(State& state) {
+  static SpscRing<uint32_t, 1024> ring;
+  uint32_t v = 0;
+  for (auto _ : state) {
+    ring.try_push(v);
+    ring.try_pop(v);
+    do_not_optimize(v);
+  }
+}
+XIAOZI_BENCH("ring/spsc_push_pop", spsc_push_pop);
+
+// One 20 ms block of 16 kHz samples in and out per op, crossing the wrap
+// point regularly because 4096 is not a multiple of 320.
+void spsc_push_n_pop_n_20ms(State& state) {
+  static SpscRing<int16_t, 4096> ring;
+  int16_t in[kPcm20msSamples] = {};
+  int16_t out[kPcm20msSamples];
+  for (auto _ : state) {
+    ring.push_n(in);
+    ring.pop_n(out);
+    do_not_optimize(out);
+  }
+}
+XIAOZI_BENCH("ring/spsc_push_n_pop_n_20ms", spsc_push_n_pop_n_20ms);
+
+// ns/op is per element handed from a producer thread to the benchmark
+// thread.
+void spsc_cross_thread(State& state) {
+  static SpscRing<uint32_t, 1024> ring;
+  const uint64_t n = state.iterations();
+  std::thread producer([n] {
+    for (uint64_t i = 0; i < n;) {
+      if (ring.try_push(static_cast<uint32_t>(i))) {
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint32_t v = 0;
+  for (auto _ : state) {
+    while (!ring.try_pop(v)) std::this_thread::yield();
+    do_not_optimize(v);
+  }
+  producer.join();
+}
+XIAOZI_BENCH("ring/spsc_cross_thread", spsc_cross_thread);
+
+void mutex_deque_cross_thread(State& state) {
+  static std::mutex mutex;
+  static std::deque<uint32_t> queue;
+  const uint64_t n = state.iterations();
+  std::thread producer([n] {
+    for (uint64_t i = 0; i < n;) {
+      std::unique_lock lock(mutex);
+      if (queue.size() < 1024) {
+        queue.push_back(static_cast<uint32_t>(i));
+        ++i;
+      } else {
+        lock.unlock();
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (auto _ : state) {
+    uint32_t v;
+    for (;;) {
+      std::unique_lock lock(mutex);
+      if (!queue.empty()) {
+        v = queue.front();
+        queue.pop_front();
+        break;
+      }
+      lock.unlock();
+      std::this_thread::yield();
+    }
+    do_not_optimize(v);
+  }
+  producer.join();
+}
+XIAOZI_BENCH("ring/mutex_deque_cross_thread", mutex_deque_cross_thread);
+
+}  // namespace
+}  // namespace xiaozi::bench
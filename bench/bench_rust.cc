@@ -0,0 +1,171 @@
+// A/B of the Rust components against the C++ ones they mirror: the UDP
+// audio cipher (OpenSSL vs Rust AES-128-CTR) and the jitter buffer. Both
+// sides of a pair must agree before they are timed: the keystreams byte
+// for byte, the jitter buffers on every pop and on their final stats.
+// Any disagreement aborts the run.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bench.h"
+
+#if defined(XIAOZI_HAVE_RUST)
+#include "audio/jitter_buffer.h"
+#include "memory/frame_pool.h"
+#include "rust/rust_aes_ctr.h"
+#include "rust/rust_jitter_buffer.h"
+#endif
+#if defined(XIAOZI_HAVE_RUST) && defined(XIAOZI_HAVE_OPENSSL)
+#include "net/aes_ctr.h"
+#endif
+
+namespace xiaozi::bench {
+namespace {
+
+#if defined(XIAOZI_HAVE_RUST)
+
+[[noreturn]] void disagree(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: rust %s differs from C++\n", what);
+  std::abort();
+}
+
+constexpr uint8_t kKey[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                              0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+// Nonce layout of the UDP channel: type, flags, size, ssrc, timestamp and
+// sequence; only the sequence changes between packets.
+void packet_iv(uint8_t (&iv)[16], uint32_t sequence) {
+  std::memset(iv, 0, sizeof(iv));
+  iv[0] = 0x01;
+  for (int i = 0; i < 4; ++i) iv[15 - i] = uint8_t(sequence >> (8 * i));
+  // With this timestamp byte, a sequence near its wrap carries through
+  // several counter bytes.
+  iv[11] = 0xff;
+}
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+
+// Runs where the Rust cipher exists (AES-NI).
+void verify_ciphers() {
+  AesCtr openssl(kKey);
+  RustAesCtr rust(kKey);
+  if (!openssl.ok() || !rust.ok()) disagree("cipher setup");
+  for (size_t n : {0, 1, 15, 16, 17, 63, 64, 65, 120, 1000, 4096}) {
+    std::vector<uint8_t> a(n), b(n);
+    for (size_t i = 0; i < n; ++i) a[i] = b[i] = uint8_t(i * 31 + n);
+    uint8_t iv[16];
+    packet_iv(iv, 0xfffffff0u + static_cast<uint32_t>(n));
+    openssl.apply(iv, a);
+    rust.apply(iv, b);
+    if (a != b) disagree("AES-128-CTR keystream");
+  }
+}
+
+template <typename Cipher>
+void cipher_packets(State& state, size_t bytes) {
+  if (!RustAesCtr(kKey).ok()) {
+    state.skip("no AES instructions for the Rust cipher");
+    return;
+  }
+  verify_ciphers();
+  Cipher cipher(kKey);
+  std::vector<uint8_t> packet(bytes, 0x5a);
+  uint8_t iv[16];
+  uint32_t seq = 0;
+  for (auto _ : state) {
+    packet_iv(iv, seq++);
+    cipher.apply(iv, packet);
+    clobber_memory();
+  }
+}
+
+// ns/op is per packet: 120 bytes is a 60 ms Opus frame, 4 KB a burst.
+void aes_opus_openssl(State& state) { cipher_packets<AesCtr>(state, 120); }
+void aes_opus_rust(State& state) { cipher_packets<RustAesCtr>(state, 120); }
+void aes_4k_openssl(State& state) { cipher_packets<AesCtr>(state, 4096); }
+void aes_4k_rust(State& state) { cipher_packets<RustAesCtr>(state, 4096); }
+XIAOZI_BENCH("rust/aes_ctr_120b/openssl", aes_opus_openssl);
+XIAOZI_BENCH("rust/aes_ctr_120b/rust", aes_opus_rust);
+XIAOZI_BENCH("rust/aes_ctr_4k/openssl", aes_4k_openssl);
+XIAOZI_BENCH("rust/aes_ctr_4k/rust", aes_4k_rust);
+
+#endif  // XIAOZI_HAVE_OPENSSL
+
+constexpr size_t kOpusPacketBytes = 120;
+constexpr uint64_t kFrameNs = 60'000'000;
+
+// The bench_jitter.cc pattern: reordered pairs, 2% loss, up to 15 ms of
+// arrival jitter. Returns false for the lost packets.
+bool arrival_at(uint64_t i, uint32_t* seq, uint64_t* arrival_ns) {
+  *seq = static_cast<uint32_t>(i % 16 == 6 ? i + 1 : i % 16 == 7 ? i - 1 : i);
+  *arrival_ns = *seq * kFrameNs + (i * 7919 % 16) * 1'000'000;
+  return i % 50 != 49;
+}
+
+template <typename Jitter>
+void feed(FramePool& pool, Jitter& jitter, uint64_t i) {
+  uint32_t seq;
+  uint64_t arrival;
+  if (!arrival_at(i, &seq, &arrival)) return;
+  FrameRef packet = pool.acquire();
+  packet.set_size(kOpusPacketBytes);
+  packet.set_sequence(seq);
+  packet.set_timestamp_ns(arrival);
+  jitter.push(std::move(packet));
+}
+
+void verify_jitter() {
+  FramePool pool(kOpusPacketBytes, 256);
+  JitterBuffer cpp;
+  RustJitterBuffer rust;
+  FrameRef a, b;
+  for (uint64_t i = 0; i < 5000; ++i) {
+    feed(pool, cpp, i);
+    feed(pool, rust, i);
+    // A sequence restart partway through.
+    if (i == 3000) {
+      FrameRef restart = pool.acquire();
+      restart.set_sequence(900000);
+      restart.set_timestamp_ns(i * kFrameNs);
+      cpp.push(restart);
+      rust.push(restart);
+    }
+    if (cpp.pop(a) != rust.pop(b)) disagree("jitter pop status");
+    if (a && (!b || a.sequence() != b.sequence())) disagree("jitter packet");
+  }
+  const JitterBuffer::Stats sa = cpp.stats();
+  const JitterBuffer::Stats sb = rust.stats();
+  if (sa.received != sb.received || sa.late != sb.late ||
+      sa.duplicates != sb.duplicates || sa.lost != sb.lost ||
+      sa.dropped != sb.dropped || sa.underruns != sb.underruns ||
+      sa.target_frames != sb.target_frames || sa.jitter_ms != sb.jitter_ms) {
+    disagree("jitter stats");
+  }
+}
+
+// One packet in, one frame out per op.
+template <typename Jitter>
+void jitter_push_pop(State& state) {
+  verify_jitter();
+  static FramePool pool(kOpusPacketBytes, 128);
+  Jitter jitter;
+  uint64_t i = 0;
+  uint64_t played = 0;
+  FrameRef out;
+  for (auto _ : state) {
+    feed(pool, jitter, i++);
+    if (jitter.pop(out) != JitterBuffer::Status::kNotReady) ++played;
+  }
+  do_not_optimize(played);
+}
+XIAOZI_BENCH("rust/jitter_reorder_push_pop/cpp", jitter_push_pop<JitterBuffer>);
+XIAOZI_BENCH("rust/jitter_reorder_push_pop/rust",
+             jitter_push_pop<RustJitterBuffer>);
+
+#endif  // XIAOZI_HAVE_RUST
+
+}  // namespace
+}  // namespace xiaozi::bench
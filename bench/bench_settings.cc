@@ -0,0 +1,300 @@
+// Settings persistence into an 8-sector partition in RAM.
+// - get_int: a lock-free read, as the audio and display tasks do;
+// - set_int: a change, RAM only;
+// - drag_batched: a volume slider dragged through 50 steps, then one poll
+//   past the flush delay;
+// - drag_write_through: the same 50 steps each written to flash at once,
+//   as NVS used to be.
+//
+// Checks before timing, any failure aborts: values survive a reopen, a run
+// of changes reaches flash as one record per key and repeated values as
+// none, a torn record falls back to the value before it, a compaction cut
+// off before its commit loses nothing, erases spread evenly over the
+// sectors, and a reader racing a writer never sees a mixed value.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "base/clock.h"
+#include "bench.h"
+#include "ota/flash_partition.h"
+#include "storage/settings_store.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr std::size_t kSectorSize = 4096;
+constexpr std::size_t kSectors = 8;
+constexpr uint64_t kDelay = SettingsStore::Config{}.flush_delay_ns;
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: settings %s\n", what);
+  std::abort();
+}
+
+// Counts erases per sector, and can refuse the write of a sector's commit
+// word (power lost at the end of a compaction).
+class WearPartition : public FlashPartition {
+ public:
+  WearPartition() : flash_(kSectors * kSectorSize, kSectorSize) {}
+
+  std::size_t size() const override { return flash_.size(); }
+  std::size_t sector_size() const override { return kSectorSize; }
+  bool read(std::size_t offset, std::span<uint8_t> out) override {
+    return flash_.read(offset, out);
+  }
+  bool erase(std::size_t offset, std::size_t bytes) override {
+    for (std::size_t s = offset / kSectorSize;
+         s < (offset + bytes) / kSectorSize; ++s) {
+      ++erases[s];
+    }
+    return flash_.erase(offset, bytes);
+  }
+  bool write(std::size_t offset, std::span<const uint8_t> data) override {
+    if (fail_commit && offset % kSectorSize ==
+                           offsetof(settings::SectorHeader, committed)) {
+      return false;
+    }
+    return flash_.write(offset, data);
+  }
+
+  std::span<uint8_t> bytes() { return flash_.bytes(); }
+
+  std::vector<uint64_t> erases = std::vector<uint64_t>(kSectors);
+  bool fail_commit = false;
+
+ private:
+  MemoryPartition flash_;
+};
+
+std::string_view read_string(const SettingsStore& store, std::string_view key,
+                             std::span<char> buf) {
+  const std::optional<std::size_t> n = store.get_bytes(
+      key, {reinterpret_cast<uint8_t*>(buf.data()), buf.size()});
+  if (!n || *n > buf.size()) return {};
+  return {buf.data(), *n};
+}
+
+void check_persistence() {
+  WearPartition flash;
+  {
+    SettingsStore store(flash);
+    if (store.get_int("volume") || store.get_int("volume", 70) != 70) {
+      fail("blank partition not empty");
+    }
+    if (!store.set_int("volume", 55) || !store.set_int("brightness", -3) ||
+        !store.set_string("wifi.ssid", "xiaozi-lab") || !store.flush()) {
+      fail("set or flush failed");
+    }
+    if (store.set_int("a.key.too.long.x", 1) ||
+        store.set_string("big", std::string(65, 'x'))) {
+      fail("oversized key or value accepted");
+    }
+    // Appended behind the first batch.
+    if (!store.set_int("volume", 60) || !store.flush() ||
+        store.stats().compactions != 1) {
+      fail("second flush did not append");
+    }
+  }
+  SettingsStore store(flash);
+  char buf[64];
+  if (store.get_int("volume") != 60 || store.get_int("brightness") != -3 ||
+      read_string(store, "wifi.ssid", buf) != "xiaozi-lab") {
+    fail("values lost on reopen");
+  }
+  if (store.get_int("wifi.ssid") || read_string(store, "volume", buf) != "") {
+    fail("value read as the wrong type");
+  }
+}
+
+void check_coalescing() {
+  WearPartition flash;
+  SettingsStore store(flash);
+  store.set_int("volume", 0);
+  store.flush();
+  const uint64_t start = monotonic_ns();
+  for (int i = 1; i <= 1000; ++i) store.set_int("volume", i % 100);
+  store.set_int("brightness", 80);
+  const SettingsStore::Stats before = store.stats();
+  store.poll(start);
+  if (store.stats().flushes != before.flushes || !store.dirty()) {
+    fail("flushed before the delay");
+  }
+  store.poll(start + 2 * kDelay);
+  const SettingsStore::Stats after = store.stats();
+  if (after.flushes != before.flushes + 1 ||
+      after.records_written != before.records_written + 2 ||
+      after.coalesced != 999 || store.dirty()) {
+    fail("changes not coalesced into one record per key");
+  }
+  store.set_int("volume", 0);  // 1000 % 100: unchanged
+  if (store.dirty() || store.stats().sets != after.sets + 1) {
+    fail("unchanged value marked for writing");
+  }
+}
+
+void check_torn_record() {
+  WearPartition flash;
+  {
+    SettingsStore store(flash);
+    store.set_int("volume", 10);
+    store.flush();
+    store.set_int("volume", 20);
+    store.flush();
+  }
+  // Clear bits of the second record's value, as an interrupted write
+  // leaves it. Each record is 24 bytes: header, "volume", int64, padding.
+  const std::size_t second = sizeof(settings::SectorHeader) + 24;
+  flash.bytes()[second + sizeof(settings::RecordHeader) + 6] &= 0x0f;
+  SettingsStore store(flash);
+  if (store.get_int("volume") != 10) fail("torn record not discarded");
+  const uint64_t compactions = store.stats().compactions;
+  store.set_int("volume", 30);
+  if (!store.flush() || store.stats().compactions != compactions + 1) {
+    fail("flush appended behind a torn record");
+  }
+  if (SettingsStore(flash).get_int("volume") != 30) {
+    fail("value after a torn record lost");
+  }
+}
+
+void check_uncommitted() {
+  WearPartition flash;
+  SettingsStore store(flash);
+  store.set_string("name", "kitchen");
+  store.set_int("volume", 40);
+  store.flush();
+  // Appends still work; the compaction once the sector is full does not.
+  flash.fail_commit = true;
+  int64_t last = 40;
+  for (int64_t i = 0; i < 1000; ++i) {
+    store.set_int("volume", 100 + i % 2);
+    if (!store.flush()) break;
+    last = 100 + i % 2;
+  }
+  if (store.stats().flash_errors != 1 || !store.dirty()) {
+    fail("failed compaction not kept pending");
+  }
+  flash.fail_commit = false;
+  char buf[16];
+  {
+    SettingsStore reopened(flash);
+    if (reopened.get_int("volume") != last ||
+        read_string(reopened, "name", buf) != "kitchen") {
+      fail("uncommitted sector replayed, or the previous one lost");
+    }
+  }
+  if (!store.flush()) fail("retry after a failed commit did not work");
+  SettingsStore reopened(flash);
+  if (reopened.get_int("volume") == last ||
+      read_string(reopened, "name", buf) != "kitchen") {
+    fail("retried compaction lost a value");
+  }
+}
+
+void check_wear() {
+  WearPartition flash;
+  SettingsStore store(flash);
+  for (int i = 0; i < 4000; ++i) {
+    store.set_int("volume", i);
+    store.set_int("brightness", i / 3);
+    store.flush();
+  }
+  const auto [lo, hi] =
+      std::minmax_element(flash.erases.begin(), flash.erases.end());
+  if (*lo == 0 || *hi - *lo > 1) fail("erases not spread over the sectors");
+}
+
+void check_concurrent_reads() {
+  WearPartition flash;
+  SettingsStore store(flash);
+  const std::string a(40, 'a');
+  const std::string b(20, 'b');
+  store.set_string("wifi.ssid", a);
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int i = 0; i < 200000; ++i) {
+      store.set_string("wifi.ssid", i & 1 ? b : a);
+    }
+    done.store(true);
+  });
+  char buf[64];
+  uint64_t reads = 0;
+  while (!done.load() || reads < 1000) {
+    const std::string_view v = read_string(store, "wifi.ssid", buf);
+    if (v != a && v != b) fail("reader saw a mixed value");
+    ++reads;
+  }
+  writer.join();
+}
+
+void check_settings() {
+  static const bool checked = [] {
+    check_persistence();
+    check_coalescing();
+    check_torn_record();
+    check_uncommitted();
+    check_wear();
+    check_concurrent_reads();
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void get_int(State& state) {
+  check_settings();
+  MemoryPartition flash(kSectors * kSectorSize, kSectorSize);
+  SettingsStore store(flash);
+  store.set_int("volume", 70);
+  for (auto _ : state) do_not_optimize(store.get_int("volume", 0));
+}
+XIAOZI_BENCH("settings/get_int", get_int);
+
+void set_int(State& state) {
+  check_settings();
+  MemoryPartition flash(kSectors * kSectorSize, kSectorSize);
+  SettingsStore store(flash);
+  int64_t i = 0;
+  for (auto _ : state) store.set_int("volume", ++i);
+  do_not_optimize(store.dirty());
+}
+XIAOZI_BENCH("settings/set_int", set_int);
+
+void drag_batched(State& state) {
+  check_settings();
+  MemoryPartition flash(kSectors * kSectorSize, kSectorSize);
+  SettingsStore store(flash);
+  int64_t v = 0;
+  for (auto _ : state) {
+    for (int step = 0; step < 50; ++step) store.set_int("volume", ++v);
+    store.poll(monotonic_ns() + kDelay);
+  }
+}
+XIAOZI_BENCH("settings/drag_batched", drag_batched);
+
+void drag_write_through(State& state) {
+  check_settings();
+  MemoryPartition flash(kSectors * kSectorSize, kSectorSize);
+  SettingsStore store(flash);
+  int64_t v = 0;
+  for (auto _ : state) {
+    for (int step = 0; step < 50; ++step) {
+      store.set_int("volume", ++v);
+      store.flush();
+    }
+  }
+}
+XIAOZI_BENCH("settings/drag_write_through", drag_write_through);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,37 @@
+// Cost of the tracing hooks, against the clock they replace. With tracing
+// off at build time the cases are skipped.
+
+#include <cstdint>
+
+#include "base/clock.h"
+#include "base/trace.h"
+#include "bench.h"
+
+namespace xiaozi::bench {
+namespace {
+
+void trace_monotonic_ns(State& state) {
+  for (auto _ : state) do_not_optimize(monotonic_ns());
+}
+XIAOZI_BENCH("trace/monotonic_ns", trace_monotonic_ns);
+
+#if defined(XIAOZI_TRACE)
+void trace_now_ns(State& state) {
+  for (auto _ : state) do_not_optimize(trace::now_ns());
+}
+XIAOZI_BENCH("trace/now_ns", trace_now_ns);
+
+// One hook as the pipeline runs it: clock read, bucket, four stores.
+void trace_record_since(State& state) {
+  const uint64_t origin = trace::now_ns();
+  for (auto _ : state) XIAOZI_TRACE_SINCE(kVad, origin);
+}
+XIAOZI_BENCH("trace/record_since", trace_record_since);
+#else
+void trace_disabled(State& state) { state.skip("built without XIAOZI_TRACE"); }
+XIAOZI_BENCH("trace/now_ns", trace_disabled);
+XIAOZI_BENCH("trace/record_since", trace_disabled);
+#endif
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,134 @@
+// Send paths over a local socketpair: WebSocket per-packet writes against
+// coalesced batches, and the encrypted UDP datagram path. ns/op is per
+// audio packet (reserve, fill, commit and its share of the flush).
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "base/clock.h"
+#include "bench.h"
+#include "net/tcp_stream.h"
+#include "net/websocket_transport.h"
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+#include "net/aes_ctr.h"
+#include "net/mqtt_udp_transport.h"
+#endif
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr size_t kOpusPacketBytes = 120;
+
+// Reads and discards everything from `fd` until the peer closes or the
+// Drain is destroyed.
+class Drain {
+ public:
+  explicit Drain(int fd)
+      : fd_(fd), thread_([this] {
+          uint8_t buf[65536];
+          while (::read(fd_, buf, sizeof(buf)) > 0) {
+          }
+        }) {}
+  ~Drain() {
+    // A datagram reader never sees EOF from its peer; shutdown wakes it.
+    ::shutdown(fd_, SHUT_RDWR);
+    thread_.join();
+    ::close(fd_);
+  }
+
+ private:
+  int fd_;
+  std::thread thread_;
+};
+
+void ws_send(State& state, std::chrono::microseconds budget) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    state.skip("socketpair failed");
+    return;
+  }
+  WebSocketTransport::Config config;
+  config.latency_budget = budget;
+  config.max_packet_bytes = kOpusPacketBytes;
+  WebSocketTransport transport(config);
+  transport.attach(std::make_unique<TcpStream>(fds[0]));
+  auto drain = std::make_unique<Drain>(fds[1]);
+
+  for (auto _ : state) {
+    auto out = transport.reserve(kOpusPacketBytes);
+    std::memset(out.data(), 0x5a, out.size());
+    transport.commit(out.size(), monotonic_ns());
+    transport.poll(0);
+  }
+  state.pause_timing();
+  while (transport.stats().queue_depth != 0) transport.poll(1);
+  transport.close();
+  drain.reset();
+}
+
+void ws_send_unbatched(State& state) {
+  ws_send(state, std::chrono::microseconds(0));
+}
+XIAOZI_BENCH("net/ws_send_unbatched", ws_send_unbatched);
+
+// Budget far above the loop's pace, so batches close on
+// kMaxBatchPackets: the steady-state syscall saving.
+void ws_send_batched(State& state) {
+  ws_send(state, std::chrono::microseconds(10000));
+}
+XIAOZI_BENCH("net/ws_send_batched", ws_send_batched);
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+void aes_ctr_opus_packet(State& state) {
+  const uint8_t key[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+  uint8_t iv[16] = {};
+  uint8_t packet[kOpusPacketBytes] = {};
+  AesCtr cipher(key);
+  uint32_t sequence = 0;
+  for (auto _ : state) {
+    std::memcpy(iv + 12, &sequence, sizeof(sequence));
+    ++sequence;
+    cipher.apply(iv, packet);
+    do_not_optimize(packet);
+  }
+}
+XIAOZI_BENCH("net/aes_ctr_opus_packet", aes_ctr_opus_packet);
+
+// Datagrams are dropped by the reader side as fast as they come; a full
+// socket buffer only shows up as packets_dropped, not as blocking.
+void udp_send_encrypted(State& state) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) != 0) {
+    state.skip("socketpair failed");
+    return;
+  }
+  MqttUdpTransport::Config config;
+  config.max_packet_bytes = kOpusPacketBytes;
+  MqttUdpTransport transport(config);
+  auto params = UdpAudioParams::from_hex(
+      "", 0, "000102030405060708090a0b0c0d0e0f",
+      "01000000a5a5a5a50000000000000000");
+  transport.attach_audio_socket(fds[0], *params);
+  auto drain = std::make_unique<Drain>(fds[1]);
+
+  for (auto _ : state) {
+    auto out = transport.reserve(kOpusPacketBytes);
+    std::memset(out.data(), 0x5a, out.size());
+    transport.commit(out.size(), monotonic_ns());
+  }
+  state.pause_timing();
+  transport.close();
+  drain.reset();
+}
+XIAOZI_BENCH("net/udp_send_encrypted", udp_send_encrypted);
+#endif  // XIAOZI_HAVE_OPENSSL
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,161 @@
+// TTS reply playout. Before the timed case, a 6 s reply is replayed in
+// virtual time through DecoderStage and TtsPlayback, with the 10 ms DMA
+// refills of an I2S driver. Packets start arriving 350 ms after the reply
+// begins and stream faster than real time, but stall for 300 ms after the
+// first clause and then every 20 packets while the server synthesizes the
+// next sentence. The adaptive playback (60 ms start threshold, grown on
+// underrun) has to reach first audio earlier than a fixed 360 ms prebuffer
+// and may underrun only once, at the first stall, before its threshold
+// has grown; both have to play every sample in order. A failed check
+// aborts. As configured, first audio comes after 350 ms instead of 830 ms.
+//
+// The timed case is one pull() at steady state, plus the decode lane's
+// share of topping up the queue.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench.h"
+#include "codec/decoder_stage.h"
+#include "codec/g711_codec.h"
+#include "codec/tts_playback.h"
+#include "memory/frame_pool.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr int kFrameSamples = 960;  // 60 ms
+constexpr int kRefillSamples = 160;  // 10 ms
+constexpr uint64_t kMs = 1000000;
+
+int16_t sample_at(std::size_t index) {
+  return static_cast<int16_t>(((index * 2654435761u) >> 18) & 0x3fff) - 8192;
+}
+
+struct Reply {
+  std::vector<std::vector<uint8_t>> packets;
+  std::vector<uint64_t> arrival_ns;
+  std::vector<int16_t> expected;  // what decoding the packets yields
+};
+
+Reply make_reply() {
+  Reply reply;
+  G711Encoder encoder(kSampleRate, kFrameSamples);
+  G711Decoder decoder(kSampleRate, kFrameSamples);
+  std::vector<int16_t> pcm(kFrameSamples);
+  uint64_t t = 350 * kMs;
+  for (int p = 0; p < 100; ++p) {
+    for (int i = 0; i < kFrameSamples; ++i) {
+      pcm[i] = sample_at(std::size_t(p) * kFrameSamples + i);
+    }
+    std::vector<uint8_t> packet(kFrameSamples);
+    encoder.encode(pcm, packet);
+    decoder.decode(packet, pcm);
+    reply.expected.insert(reply.expected.end(), pcm.begin(), pcm.end());
+    reply.packets.push_back(std::move(packet));
+    reply.arrival_ns.push_back(t);
+    t += (p % 20 == 4) ? 300 * kMs : 45 * kMs;
+  }
+  return reply;
+}
+
+struct Outcome {
+  uint64_t first_audio_ns;
+  uint64_t underruns;
+};
+
+Outcome simulate(const Reply& reply, TtsPlayback::Config config) {
+  FramePool packets(1024, 64);
+  FramePool pcm(kFrameSamples * sizeof(int16_t), 64);
+  G711Decoder decoder(kSampleRate, kFrameSamples);
+  DecoderStage stage(decoder, pcm);
+  TtsPlayback playback(stage, config);
+
+  std::vector<int16_t> played;
+  int16_t block[kRefillSamples];
+  std::size_t next = 0;
+  playback.begin(0);
+  // Bounded, so a stuck playback fails the check instead of hanging.
+  for (uint64_t now = 0; now < 30000 * kMs; now += 10 * kMs) {
+    for (; next < reply.packets.size() && reply.arrival_ns[next] <= now;
+         ++next) {
+      FrameRef packet = packets.acquire();
+      std::copy(reply.packets[next].begin(), reply.packets[next].end(),
+                packet.data());
+      packet.set_size(reply.packets[next].size());
+      packet.set_timestamp_ns(0);  // virtual time stays out of the traces
+      stage.submit(std::move(packet));
+      if (next + 1 == reply.packets.size()) playback.end();
+    }
+    stage.run_once();
+    const std::size_t n = playback.pull(block, now);
+    played.insert(played.end(), block, block + n);
+    if (played.size() >= reply.expected.size()) break;
+  }
+  if (played != reply.expected) {
+    std::fprintf(stderr,
+                 "xiaozi_bench: tts playback lost or reordered samples\n");
+    std::abort();
+  }
+  const TtsPlayback::Stats stats = playback.stats();
+  return {stats.first_audio_ns, stats.underruns};
+}
+
+void check_early_start() {
+  static const bool checked = [] {
+    const Reply reply = make_reply();
+    TtsPlayback::Config adaptive;
+    adaptive.sample_rate = kSampleRate;
+    TtsPlayback::Config fixed = adaptive;
+    fixed.min_prebuffer_ms = fixed.max_prebuffer_ms = 360;
+    const Outcome a = simulate(reply, adaptive);
+    const Outcome f = simulate(reply, fixed);
+    if (a.first_audio_ns >= f.first_audio_ns || a.underruns > 1) {
+      std::fprintf(stderr,
+                   "xiaozi_bench: tts early start: first audio %llu ms "
+                   "(fixed prebuffer %llu ms), %llu underruns\n",
+                   static_cast<unsigned long long>(a.first_audio_ns / kMs),
+                   static_cast<unsigned long long>(f.first_audio_ns / kMs),
+                   static_cast<unsigned long long>(a.underruns));
+      std::abort();
+    }
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void tts_pull_10ms(State& state) {
+  check_early_start();
+  FramePool pcm(kFrameSamples * sizeof(int16_t), 64);
+  G711Decoder decoder(kSampleRate, kFrameSamples);
+  DecoderStage stage(decoder, pcm);
+  TtsPlayback::Config config;
+  config.sample_rate = kSampleRate;
+  TtsPlayback playback(stage, config);
+  const std::vector<uint8_t> packet(kFrameSamples, 0x55);
+  FramePool packets(1024, 64);
+  int16_t block[kRefillSamples];
+  playback.begin(0);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    // Top up one frame per six refills, like the decode lane would.
+    if (i++ % 6 == 0) {
+      FrameRef p = packets.acquire();
+      std::copy(packet.begin(), packet.end(), p.data());
+      p.set_size(packet.size());
+      p.set_timestamp_ns(0);
+      stage.submit(std::move(p));
+      stage.run_once();
+    }
+    do_not_optimize(playback.pull(block, i));
+    clobber_memory();
+  }
+}
+XIAOZI_BENCH("tts/pull_10ms", tts_pull_10ms);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,199 @@
+// VAD gate in front of the encoder on a mostly silent clip, against the
+// same clip encoded and sent in full. ns/op is per 20 ms capture frame.
+// Before timing, the gate's wake latency and pre-roll are checked on a
+// tone burst; a late wake or a lost onset aborts the run.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "audio/vad_gate.h"
+#include "bench.h"
+#include "codec/encoder_stage.h"
+#include "codec/g711_codec.h"
+#include "memory/frame_pool.h"
+#include "net/packet_sink.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr size_t kFrameSamples = 320;  // 20 ms
+// 10 s of audio: one 1.2 s utterance per 5 s, room noise in between.
+constexpr size_t kClipFrames = 500;
+
+class CountingSink : public PacketSink {
+ public:
+  std::span<uint8_t> reserve(std::size_t max_bytes) override {
+    if (offset_ + max_bytes > sizeof(buffer_)) offset_ = 0;
+    return {buffer_ + offset_, max_bytes};
+  }
+  bool commit(std::size_t bytes, uint64_t) override {
+    offset_ += bytes;
+    if (bytes != 0) ++packets_;
+    return true;
+  }
+  uint64_t packets() const { return packets_; }
+
+ private:
+  uint8_t buffer_[16384];
+  std::size_t offset_ = 0;
+  uint64_t packets_ = 0;
+};
+
+class EncoderListener : public VadGate::Listener {
+ public:
+  explicit EncoderListener(EncoderStage& stage) : stage_(stage) {}
+  void on_wake() override {}
+  void on_frame(FrameRef frame) override {
+    stage_.submit(std::move(frame));
+    stage_.run_once();
+  }
+  void on_idle() override { stage_.flush(); }
+
+ private:
+  EncoderStage& stage_;
+};
+
+uint32_t next_random(uint32_t& seed) {
+  seed = seed * 1664525u + 1013904223u;
+  return seed >> 8;
+}
+
+bool speaking(size_t frame) { return frame % 250 < 60; }
+
+std::vector<int16_t> conversation_clip() {
+  std::vector<int16_t> pcm(kClipFrames * kFrameSamples);
+  uint32_t seed = 11;
+  for (size_t i = 0; i < pcm.size(); ++i) {
+    int v = static_cast<int>(next_random(seed) % 9) - 4;
+    if (speaking(i / kFrameSamples)) {
+      v += static_cast<int>(6000 * std::sin(2 * 3.14159265 * 180.0 * i /
+                                            kSampleRate));
+    }
+    pcm[i] = static_cast<int16_t>(v);
+  }
+  return pcm;
+}
+
+FrameRef capture(FramePool& pool, const int16_t* pcm) {
+  FrameRef frame = pool.acquire();
+  frame.set_size(kFrameSamples * sizeof(int16_t));
+  std::copy(pcm, pcm + kFrameSamples, frame.as<int16_t>().begin());
+  return frame;
+}
+
+class RecordingListener : public VadGate::Listener {
+ public:
+  void on_wake() override { ++wakes; }
+  void on_frame(FrameRef frame) override {
+    sequences.push_back(frame.sequence());
+  }
+  void on_idle() override { ++idles; }
+
+  int wakes = 0;
+  int idles = 0;
+  std::vector<uint32_t> sequences;
+};
+
+void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: vad gate %s\n", what);
+  std::abort();
+}
+
+// Capture delivers 2.5 ms DMA chunks; the burst starts 100 samples into
+// frame 20. The gate must wake within one block of the onset, forward the
+// pre-roll in order, and go idle again after the hangover.
+void verify_gate() {
+  FramePool pool(kFrameSamples * sizeof(int16_t), 16);
+  RecordingListener listener;
+  VadGate::Config config;
+  config.preroll_frames = 3;
+  VadGate gate(listener, config);
+  constexpr size_t kOnset = 20 * kFrameSamples + 100;
+  std::vector<int16_t> pcm(60 * kFrameSamples);
+  uint32_t seed = 3;
+  for (size_t i = 0; i < pcm.size(); ++i) {
+    int v = static_cast<int>(next_random(seed) % 9) - 4;
+    if (i >= kOnset && i < kOnset + 4000) v += 5000;
+    pcm[i] = static_cast<int16_t>(v);
+  }
+  size_t woke_at = 0;
+  for (size_t f = 0; f < 60; ++f) {
+    const int16_t* p = &pcm[f * kFrameSamples];
+    for (size_t c = 0; c < kFrameSamples; c += config.block_samples) {
+      if (gate.observe({p + c, config.block_samples}) && woke_at == 0) {
+        woke_at = f * kFrameSamples + c + config.block_samples;
+      }
+    }
+    FrameRef frame = capture(pool, p);
+    frame.set_sequence(static_cast<uint32_t>(f));
+    gate.submit(std::move(frame));
+  }
+  if (listener.wakes != 1 || listener.idles != 1) fail("wake count wrong");
+  if (woke_at < kOnset || woke_at > kOnset + 2 * config.block_samples) {
+    fail("woke late");
+  }
+  if (listener.sequences.empty() || listener.sequences.front() != 17) {
+    fail("lost pre-roll");
+  }
+  for (size_t i = 1; i < listener.sequences.size(); ++i) {
+    if (listener.sequences[i] != listener.sequences[i - 1] + 1) {
+      fail("reordered frames");
+    }
+  }
+}
+
+void conversation(State& state, bool gated) {
+  static FramePool pool(kFrameSamples * sizeof(int16_t), 32);
+  static const std::vector<int16_t> clip = conversation_clip();
+  if (gated) verify_gate();
+  G711Encoder encoder(kSampleRate, kFrameSamples);
+  CountingSink sink;
+  EncoderStage::Config stage_config;
+  stage_config.frames_per_wakeup = 3;
+  stage_config.max_packet_bytes = kFrameSamples;
+  EncoderStage stage(encoder, sink, stage_config);
+  EncoderListener listener(stage);
+  VadGate gate(listener, VadGate::Config{});
+  size_t f = 0;
+  for (auto _ : state) {
+    FrameRef frame = capture(pool, &clip[f * kFrameSamples]);
+    if (gated) {
+      gate.submit(std::move(frame));
+    } else {
+      listener.on_frame(std::move(frame));
+    }
+    f = (f + 1) % kClipFrames;
+  }
+  stage.run_once();
+  // Speech is 24% of the clip; hangover and pre-roll add a little.
+  if (gated && sink.packets() > state.iterations() * 2 / 5 + 64) {
+    fail("forwarded too much silence");
+  }
+}
+
+void conversation_ungated(State& state) { conversation(state, false); }
+XIAOZI_BENCH("vad/conversation_ungated", conversation_ungated);
+
+void conversation_gated(State& state) { conversation(state, true); }
+XIAOZI_BENCH("vad/conversation_gated", conversation_gated);
+
+// Cost of an idle frame: the gate alone, with no speech to let through.
+void gate_silent_frame(State& state) {
+  static FramePool pool(kFrameSamples * sizeof(int16_t), 32);
+  RecordingListener listener;
+  VadGate gate(listener, VadGate::Config{});
+  std::vector<int16_t> pcm(kFrameSamples);
+  uint32_t seed = 9;
+  for (auto& s : pcm) s = static_cast<int16_t>(next_random(seed) % 9) - 4;
+  for (auto _ : state) gate.submit(capture(pool, pcm.data()));
+  if (listener.wakes != 0) fail("woke on silence");
+}
+XIAOZI_BENCH("vad/gate_silent_frame", gate_silent_frame);
+
+}  // namespace
+}  // namespace xiaozi::bench
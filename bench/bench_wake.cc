@@ -0,0 +1,209 @@
+// Wake-word front end and model: one streaming hop against recomputing the
+// window the way a non-streaming engine does on every hop. The model is a
+// synthetic int8 TCN of production shape; its weights do not detect
+// anything, but the arithmetic is the same. Streaming and recomputed
+// logits are compared first and any difference aborts the run, as does a
+// detector accepting a wake class the model does not have.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "audio/int8_net.h"
+#include "audio/log_mel.h"
+#include "audio/wake_word.h"
+#include "bench.h"
+
+namespace xiaozi::bench {
+namespace {
+
+constexpr size_t kHop = LogMelFrontend::kHop;
+constexpr size_t kBands = LogMelFrontend::kBands;
+// A 1 s analysis window: what a whole-window engine recomputes per hop.
+constexpr size_t kWindowHops = 98;
+
+uint32_t next_random(uint32_t& seed) {
+  seed = seed * 1664525u + 1013904223u;
+  return seed >> 8;
+}
+
+// 40 bands -> 4 dilated 3-tap convs of 64 channels -> 2 logits.
+const Int8Model& synthetic_model() {
+  static const Int8Model model = [] {
+    Int8Model m;
+    m.input_scale = 0.25f;
+    uint32_t seed = 42;
+    auto add = [&](uint16_t kernel, uint16_t dilation, uint16_t in,
+                   uint16_t out, bool relu) {
+      Int8Model::Layer& l = m.layers.emplace_back();
+      l.kernel = kernel;
+      l.dilation = dilation;
+      l.in_channels = in;
+      l.out_channels = out;
+      l.relu = relu;
+      l.weight_scale = 1.0f / (127.0f * std::sqrt(float(kernel * in)));
+      l.output_scale = 0.05f;
+      l.output_zero_point = relu ? -128 : 0;
+      l.bias.resize(out);
+      for (auto& b : l.bias) {
+        b = static_cast<int32_t>(next_random(seed) % 2001) - 1000;
+      }
+      l.weights.resize(size_t{out} * kernel * in);
+      for (auto& w : l.weights) {
+        w = static_cast<int8_t>(static_cast<int>(next_random(seed) % 255) -
+                                127);
+      }
+    };
+    add(3, 1, kBands, 64, true);
+    add(3, 2, 64, 64, true);
+    add(3, 4, 64, 64, true);
+    add(3, 8, 64, 64, true);
+    add(1, 1, 64, 2, false);
+    return m;
+  }();
+  return model;
+}
+
+std::vector<int16_t> speech_like(size_t n, uint32_t seed) {
+  std::vector<int16_t> v(n);
+  for (size_t i = 0; i < n; ++i) {
+    const double env = 0.5 + 0.5 * std::sin(2 * 3.14159265 * 4.0 * i / 16000);
+    const double tone = std::sin(2 * 3.14159265 * 220.0 * i / 16000);
+    const int noise = static_cast<int>(next_random(seed) % 2001) - 1000;
+    v[i] = static_cast<int16_t>(env * (8000 * tone + noise));
+  }
+  return v;
+}
+
+// The streaming net must agree with a from-scratch run over its receptive
+// field, the minimum a window-based engine would recompute.
+void verify_streaming(const Int8Model& model,
+                      const std::vector<std::vector<int8_t>>& frames) {
+  Int8StreamingNet streaming(model);
+  Int8StreamingNet fresh(model);
+  const size_t field = model.receptive_field();
+  auto parsed = Int8Model::parse(model.serialize());
+  if (!parsed) {
+    std::fprintf(stderr, "xiaozi_bench: Int8Model round trip failed\n");
+    std::abort();
+  }
+  Int8StreamingNet reloaded(*parsed);
+  for (size_t t = 0; t < frames.size(); ++t) {
+    auto a = streaming.step(frames[t]);
+    auto c = reloaded.step(frames[t]);
+    if (t + 1 < field) continue;
+    fresh.reset();
+    std::span<const int8_t> b;
+    for (size_t i = t + 1 - field; i <= t; ++i) b = fresh.step(frames[i]);
+    if (!std::equal(a.begin(), a.end(), b.begin()) ||
+        !std::equal(a.begin(), a.end(), c.begin())) {
+      std::fprintf(stderr, "xiaozi_bench: streaming logits differ at %zu\n",
+                   t);
+      std::abort();
+    }
+  }
+}
+
+std::vector<std::vector<int8_t>> feature_frames(size_t count) {
+  LogMelFrontend frontend({0.25f, 0});
+  auto pcm = speech_like(count * kHop, 7);
+  std::vector<std::vector<int8_t>> frames(count, std::vector<int8_t>(kBands));
+  for (size_t t = 0; t < count; ++t) {
+    frontend.push(std::span(pcm).subspan(t * kHop, kHop),
+                  std::span<int8_t, kBands>(frames[t]));
+  }
+  return frames;
+}
+
+void frontend_hop_incremental(State& state) {
+  LogMelFrontend frontend({0.25f, 0});
+  auto pcm = speech_like(kWindowHops * kHop, 1);
+  int8_t out[kBands];
+  size_t t = 0;
+  for (auto _ : state) {
+    frontend.push(std::span(pcm).subspan(t * kHop, kHop), out);
+    do_not_optimize(out);
+    t = (t + 1) % kWindowHops;
+  }
+}
+XIAOZI_BENCH("wake/frontend_hop_incremental", frontend_hop_incremental);
+
+void frontend_window_recompute(State& state) {
+  LogMelFrontend frontend({0.25f, 0});
+  auto pcm = speech_like((kWindowHops + 2) * kHop, 1);
+  int8_t out[kBands];
+  for (auto _ : state) {
+    frontend.reset();
+    for (size_t t = 0; t < kWindowHops + 2; ++t) {
+      frontend.push(std::span(pcm).subspan(t * kHop, kHop), out);
+    }
+    do_not_optimize(out);
+  }
+}
+XIAOZI_BENCH("wake/frontend_window_recompute", frontend_window_recompute);
+
+void model_step_streaming(State& state) {
+  const Int8Model& model = synthetic_model();
+  auto frames = feature_frames(kWindowHops);
+  verify_streaming(model, frames);
+  Int8StreamingNet net(model);
+  size_t t = 0;
+  for (auto _ : state) {
+    do_not_optimize(net.step(frames[t]).data());
+    t = (t + 1) % frames.size();
+  }
+}
+XIAOZI_BENCH("wake/model_step_streaming", model_step_streaming);
+
+void model_window_recompute(State& state) {
+  const Int8Model& model = synthetic_model();
+  auto frames = feature_frames(kWindowHops);
+  Int8StreamingNet net(model);
+  const size_t field = model.receptive_field();
+  for (auto _ : state) {
+    net.reset();
+    for (size_t t = 0; t < field; ++t) {
+      do_not_optimize(net.step(frames[t]).data());
+    }
+  }
+}
+XIAOZI_BENCH("wake/model_window_recompute", model_window_recompute);
+
+void detector_hop(State& state, bool speech) {
+  WakeWordDetector::Config config;
+  // The synthetic model has 2 outputs; a wake class past them is refused.
+  config.wake_class = 2;
+  if (WakeWordDetector(synthetic_model(), config).ok()) {
+    std::fprintf(stderr, "xiaozi_bench: wake class past the outputs taken\n");
+    std::abort();
+  }
+  config.wake_class = 1;
+  WakeWordDetector detector(synthetic_model(), config);
+  if (!detector.ok()) {
+    std::fprintf(stderr, "xiaozi_bench: wake detector refused its model\n");
+    std::abort();
+  }
+  std::vector<int16_t> pcm = speech ? speech_like(kWindowHops * kHop, 3)
+                                    : std::vector<int16_t>(kWindowHops * kHop);
+  if (!speech) {
+    uint32_t seed = 5;
+    for (auto& s : pcm) s = static_cast<int16_t>(next_random(seed) % 9) - 4;
+  }
+  size_t t = 0;
+  for (auto _ : state) {
+    do_not_optimize(detector.process(std::span(pcm).subspan(t * kHop, kHop)));
+    t = (t + 1) % kWindowHops;
+  }
+}
+
+void detector_hop_speech(State& state) { detector_hop(state, true); }
+XIAOZI_BENCH("wake/detector_hop_speech", detector_hop_speech);
+
+// Room noise a few LSBs high: the energy gate keeps FFT and model asleep.
+void detector_hop_silence_gated(State& state) { detector_hop(state, false); }
+XIAOZI_BENCH("wake/detector_hop_silence_gated", detector_hop_silence_gated);
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,331 @@
+// Wake to first audio over wss:// on loopback, against a TLS 1.3 server
+// in this process. ns/op is one wake: from the wake word until the server
+// has read the first audio packet.
+// - cold: a new connection with a full handshake, as without warm-up;
+// - resumed: a new connection resuming the session ticket, with the
+//   default config, so no 0-RTT early data;
+// - warm: the connection WarmConnection held open, so only the packet.
+// Loopback has no round-trip time, so the cold/resumed gap here is mostly
+// handshake CPU; on a real network each saved round trip adds to it.
+//
+// Checks before timing, any failure aborts: a reconnect resumes without
+// sending early data, every connection's hello reaches the server, and the
+// transport reports wake-to-first-byte. The early data paths themselves
+// are covered by tests/tls_resumption_test.cc.
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "base/clock.h"
+#include "bench.h"
+#include "net/warm_connection.h"
+#include "net/websocket_transport.h"
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include "base/base64.h"
+#include "base/sha1.h"
+#include "net/websocket_frame.h"
+#endif
+
+namespace xiaozi::bench {
+namespace {
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+
+constexpr std::size_t kOpusPacketBytes = 120;
+constexpr std::string_view kHello =
+    R"({"type":"hello","version":1,"transport":"websocket",)"
+    R"("audio_params":{"format":"opus","sample_rate":16000,"frame_ms":60}})";
+
+[[noreturn]] void fail(const char* what) {
+  std::fprintf(stderr, "xiaozi_bench: warmup %s\n", what);
+  std::abort();
+}
+
+// Self-signed P-256 certificate; the client runs with verify_peer off.
+SSL_CTX* server_ctx() {
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const uint8_t*>("localhost"),
+                             -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, key, EVP_sha256());
+
+  SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+  SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+  if (SSL_CTX_use_certificate(ctx, cert) != 1 ||
+      SSL_CTX_use_PrivateKey(ctx, key) != 1) {
+    fail("server certificate rejected");
+  }
+  SSL_CTX_set_max_early_data(ctx, 16384);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return ctx;
+}
+
+// Serves one connection at a time: reads the upgrade request (from early
+// data if it came that way), answers 101 and counts hellos and audio
+// frames until the client closes.
+class TlsServer {
+ public:
+  TlsServer() : ctx_(server_ctx()) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+        listen(listen_fd_, 4) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len)) {
+      fail("server cannot listen");
+    }
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this] { run(); });
+  }
+
+  ~TlsServer() {
+    stop_.store(true);
+    thread_.join();
+    ::close(listen_fd_);
+    SSL_CTX_free(ctx_);
+  }
+
+  int port() const { return port_; }
+  uint64_t audio() const { return audio_.load(std::memory_order_acquire); }
+  uint64_t hellos() const { return hellos_.load(); }
+  uint64_t early_requests() const { return early_requests_.load(); }
+  // True once the server is back waiting for the next connection.
+  bool idle() const { return !serving_.load(std::memory_order_acquire); }
+
+ private:
+  void run() {
+    while (!stop_.load()) {
+      pollfd pfd{listen_fd_, POLLIN, 0};
+      if (::poll(&pfd, 1, 10) != 1) continue;
+      const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) continue;
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      serving_.store(true, std::memory_order_release);
+      serve(fd);
+      ::close(fd);
+      serving_.store(false, std::memory_order_release);
+    }
+  }
+
+  void serve(int fd) {
+    SSL* ssl = SSL_new(ctx_);
+    SSL_set_fd(ssl, fd);
+    std::string in;
+    char buf[16384];
+    for (;;) {
+      std::size_t n = 0;
+      const int rc = SSL_read_early_data(ssl, buf, sizeof(buf), &n);
+      if (rc == SSL_READ_EARLY_DATA_ERROR) break;
+      in.append(buf, n);
+      if (rc == SSL_READ_EARLY_DATA_FINISH) break;
+    }
+    if (SSL_accept(ssl) != 1) {
+      SSL_free(ssl);
+      return;
+    }
+    if (in.find("\r\n\r\n") != std::string::npos) early_requests_.fetch_add(1);
+
+    bool upgraded = false;
+    for (;;) {
+      if (!upgraded) {
+        const std::size_t end = in.find("\r\n\r\n");
+        if (end != std::string::npos) {
+          if (!upgrade(ssl, in.substr(0, end))) break;
+          in.erase(0, end + 4);
+          upgraded = true;
+        }
+      }
+      if (upgraded && !frames(in)) break;
+      const int n = SSL_read(ssl, buf, sizeof(buf));
+      if (n <= 0) break;
+      in.append(buf, static_cast<std::size_t>(n));
+    }
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+  }
+
+  static bool upgrade(SSL* ssl, std::string_view request) {
+    constexpr std::string_view kKey = "Sec-WebSocket-Key: ";
+    const std::size_t at = request.find(kKey);
+    if (at == std::string_view::npos) return false;
+    std::string_view key = request.substr(at + kKey.size());
+    key = key.substr(0, key.find("\r\n"));
+    const std::string input =
+        std::string(key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    const std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Accept: " +
+        base64_encode(Sha1::of({reinterpret_cast<const uint8_t*>(input.data()),
+                                input.size()})) +
+        "\r\n\r\n";
+    return SSL_write(ssl, response.data(), static_cast<int>(response.size())) >
+           0;
+  }
+
+  // Consumes complete frames from `in`; false on close.
+  bool frames(std::string& in) {
+    std::size_t at = 0;
+    for (;;) {
+      auto* p = reinterpret_cast<uint8_t*>(in.data()) + at;
+      auto h = ws::parse_header({p, in.size() - at});
+      if (!h || in.size() - at < h->header_len + h->payload_len) break;
+      std::span<uint8_t> payload(p + h->header_len,
+                                 static_cast<std::size_t>(h->payload_len));
+      if (h->masked) ws::apply_mask(payload, h->mask_key);
+      at += h->header_len + payload.size();
+      if (h->opcode == ws::kClose) return false;
+      if (h->opcode == ws::kText &&
+          std::string_view(reinterpret_cast<const char*>(payload.data()),
+                           payload.size()) == kHello) {
+        hellos_.fetch_add(1);
+      } else if (h->opcode == ws::kBinary) {
+        audio_.fetch_add(1, std::memory_order_release);
+      }
+    }
+    in.erase(0, at);
+    return true;
+  }
+
+  SSL_CTX* ctx_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::thread thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> serving_{false};
+  std::atomic<uint64_t> audio_{0};
+  std::atomic<uint64_t> hellos_{0};
+  std::atomic<uint64_t> early_requests_{0};
+};
+
+struct Device {
+  WebSocketTransport transport;
+  WarmConnection warm;
+
+  Device(int port, bool resumption)
+      : transport(config(port, resumption)), warm(transport) {}
+
+  static WebSocketTransport::Config config(int port, bool resumption) {
+    WebSocketTransport::Config c;
+    c.url = "wss://127.0.0.1:" + std::to_string(port) + "/xiaozhi/v1/";
+    c.verify_peer = false;
+    c.hello = kHello;
+    c.tls_resumption = resumption;
+    c.max_packet_bytes = kOpusPacketBytes;
+    return c;
+  }
+
+  // Wake word: connect if needed, then send the first packet and wait for
+  // the server to read it.
+  void wake(TlsServer& server) {
+    const uint64_t target = server.audio() + 1;
+    if (!warm.wake(monotonic_ns())) fail("cannot connect");
+    auto out = transport.reserve(kOpusPacketBytes);
+    std::memset(out.data(), 0x5a, out.size());
+    transport.commit(out.size(), monotonic_ns());
+    while (server.audio() < target) {
+      warm.poll(0);
+      std::this_thread::yield();
+    }
+  }
+
+  void hang_up(TlsServer& server) {
+    transport.close();
+    while (!server.idle()) std::this_thread::yield();
+  }
+};
+
+void check_warmup() {
+  static const bool checked = [] {
+    TlsServer server;
+    Device device(server.port(), true);
+    device.wake(server);
+    device.hang_up(server);
+    device.wake(server);
+    const TransportStats s = device.transport.stats();
+    if (s.connects != 2 || s.resumed_connects != 1) {
+      fail("reconnect did not resume");
+    }
+    if (s.early_data_connects != 0 || server.early_requests() != 0) {
+      fail("sent early data by default");
+    }
+    if (server.hellos() != 2) fail("hello did not reach the server");
+    if (s.first_byte_ns == 0 || s.max_first_byte_ns < s.first_byte_ns) {
+      fail("wake-to-first-byte not reported");
+    }
+    device.hang_up(server);
+
+    Device full(server.port(), false);
+    full.wake(server);
+    full.hang_up(server);
+    full.wake(server);
+    if (full.transport.stats().resumed_connects != 0) {
+      fail("resumed with resumption off");
+    }
+    full.hang_up(server);
+    return true;
+  }();
+  do_not_optimize(checked);
+}
+
+void wake_reconnecting(State& state, bool resumption) {
+  check_warmup();
+  TlsServer server;
+  Device device(server.port(), resumption);
+  device.wake(server);
+  for (auto _ : state) {
+    state.pause_timing();
+    device.hang_up(server);
+    state.resume_timing();
+    device.wake(server);
+  }
+  device.hang_up(server);
+}
+
+void wake_cold(State& state) { wake_reconnecting(state, false); }
+XIAOZI_BENCH("net/wake_first_audio_cold", wake_cold);
+
+void wake_resumed(State& state) { wake_reconnecting(state, true); }
+XIAOZI_BENCH("net/wake_first_audio_resumed", wake_resumed);
+
+void wake_warm(State& state) {
+  check_warmup();
+  TlsServer server;
+  Device device(server.port(), true);
+  device.wake(server);
+  for (auto _ : state) device.wake(server);
+  device.hang_up(server);
+}
+XIAOZI_BENCH("net/wake_first_audio_warm", wake_warm);
+
+#endif  // XIAOZI_HAVE_OPENSSL
+
+}  // namespace
+}  // namespace xiaozi::bench
@@ -0,0 +1,222 @@
+// xiaozi_perf_gate: compares xiaozi_bench runs against the committed
+// baseline (bench/perf_baseline.txt) and fails on a regression. Only the
+// cases listed in the baseline are gated: the hot-path ones, measured in a
+// Release LTO build. Each case takes its best ns/op and allocs/op over
+// all the runs given, so one noisy run does not fail the gate.
+//
+//   xiaozi_perf_gate --baseline=<file> [--max-ns-regression=<pct>]
+//                    [--max-allocs-regression=<pct>] [--update]
+//                    <run.txt>...
+//
+// Prints one report line per case. Exits 1 if any case is slower or
+// allocates more than the limits allow (5% each by default), or is
+// missing from every run; a case every run skipped (an instruction set
+// this CPU lacks) is reported and passes. --update rewrites the
+// baseline's cases with these runs' numbers instead, keeping its comment
+// lines, and fails only on missing cases.
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench.h"
+
+namespace {
+
+using xiaozi::bench::Result;
+
+void usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s --baseline=<file> [--max-ns-regression=<pct>] "
+               "[--max-allocs-regression=<pct>] [--update] <run>...\n",
+               argv0);
+}
+
+bool parse_flag(std::string_view arg, std::string_view name,
+                std::string* value) {
+  if (arg.substr(0, name.size()) != name) return false;
+  arg.remove_prefix(name.size());
+  if (arg.empty() || arg.front() != '=') return false;
+  *value = std::string(arg.substr(1));
+  return true;
+}
+
+bool parse_percent(const std::string& value, double* out) {
+  char* end = nullptr;
+  *out = std::strtod(value.c_str(), &end);
+  return end != value.c_str() && *end == '\0' && *out >= 0;
+}
+
+bool read_lines(const std::string& path, std::vector<std::string>* out) {
+  std::ifstream in(path);
+  if (!in) {
+    std::fprintf(stderr, "xiaozi_perf_gate: cannot open %s: %s\n",
+                 path.c_str(), std::strerror(errno));
+    return false;
+  }
+  for (std::string line; std::getline(in, line);) out->push_back(line);
+  return true;
+}
+
+// `# <name> skipped: <reason>`, as format_result() writes it.
+bool skipped_name(const std::string& line, std::string* name) {
+  const std::size_t at = line.find(" skipped: ");
+  if (line.rfind("# ", 0) != 0 || at == std::string::npos) return false;
+  *name = line.substr(2, at - 2);
+  return true;
+}
+
+// Percent increase from `base` to `now`, zero if none. A zero baseline
+// makes any increase infinite, so a case that used to allocate nothing
+// fails on one alloc. The slack is the printed precision, below which
+// values read as equal.
+double increase(double base, double now, double slack) {
+  if (now <= base + slack) return 0;
+  return base > 0 ? (now - base) / base * 100 : HUGE_VAL;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string baseline_path;
+  double max_ns = 5.0;
+  double max_allocs = 5.0;
+  bool update = false;
+  std::vector<std::string> runs;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    std::string value;
+    if (parse_flag(arg, "--baseline", &value)) {
+      baseline_path = value;
+    } else if (parse_flag(arg, "--max-ns-regression", &value)) {
+      if (!parse_percent(value, &max_ns)) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (parse_flag(arg, "--max-allocs-regression", &value)) {
+      if (!parse_percent(value, &max_allocs)) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (arg == "--update") {
+      update = true;
+    } else if (!arg.empty() && arg.front() != '-') {
+      runs.emplace_back(arg);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (baseline_path.empty() || runs.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // Best of every run, per case.
+  std::map<std::string, Result> best;
+  std::map<std::string, bool> skipped;
+  for (const std::string& path : runs) {
+    std::vector<std::string> lines;
+    if (!read_lines(path, &lines)) return 1;
+    for (const std::string& line : lines) {
+      Result r;
+      std::string name;
+      if (xiaozi::bench::parse_result(line, &r)) {
+        auto [it, fresh] = best.try_emplace(r.name, r);
+        if (!fresh) {
+          it->second.ns_per_op = std::min(it->second.ns_per_op, r.ns_per_op);
+          it->second.allocs_per_op =
+              std::min(it->second.allocs_per_op, r.allocs_per_op);
+          it->second.bytes_per_op =
+              std::min(it->second.bytes_per_op, r.bytes_per_op);
+        }
+      } else if (skipped_name(line, &name)) {
+        skipped[name] = true;
+      }
+    }
+  }
+
+  std::vector<std::string> baseline;
+  if (!read_lines(baseline_path, &baseline)) return 1;
+
+  std::printf("# xiaozi_perf_gate: best of %zu run(s) against %s, "
+              "limits +%.1f%% ns/op, +%.1f%% allocs/op\n",
+              runs.size(), baseline_path.c_str(), max_ns, max_allocs);
+  std::printf("%-48s %12s %12s %8s %16s  %s\n", "case", "base ns/op",
+              "ns/op", "delta", "allocs/op", "verdict");
+
+  std::size_t gated = 0, failed = 0;
+  std::vector<std::string> updated;
+  for (const std::string& line : baseline) {
+    Result base;
+    if (!xiaozi::bench::parse_result(line, &base)) {
+      updated.push_back(line);
+      continue;
+    }
+    ++gated;
+    const auto it = best.find(base.name);
+    if (it == best.end()) {
+      const bool skip = skipped.count(base.name) != 0;
+      if (!skip) ++failed;
+      std::printf("%-48s %12.2f %12s %8s %16s  %s\n", base.name.c_str(),
+                  base.ns_per_op, "-", "-", "-",
+                  skip ? "skipped" : "MISSING");
+      updated.push_back(line);
+      continue;
+    }
+    const Result& now = it->second;
+    const double ns = increase(base.ns_per_op, now.ns_per_op, 0.005);
+    const double allocs =
+        increase(base.allocs_per_op, now.allocs_per_op, 0.0005);
+    const char* verdict = "ok";
+    if (!update && ns > max_ns && allocs > max_allocs) {
+      verdict = "REGRESSED ns/op, allocs/op";
+    } else if (!update && ns > max_ns) {
+      verdict = "REGRESSED ns/op";
+    } else if (!update && allocs > max_allocs) {
+      verdict = "REGRESSED allocs/op";
+    } else if (update) {
+      verdict = "updated";
+    }
+    if (verdict[0] == 'R') ++failed;
+    char allocs_text[32];
+    std::snprintf(allocs_text, sizeof(allocs_text), "%.3f -> %.3f",
+                  base.allocs_per_op, now.allocs_per_op);
+    std::printf("%-48s %12.2f %12.2f %+7.1f%% %16s  %s\n", base.name.c_str(),
+                base.ns_per_op, now.ns_per_op,
+                (now.ns_per_op - base.ns_per_op) / base.ns_per_op * 100,
+                allocs_text, verdict);
+    updated.push_back(xiaozi::bench::format_result(now));
+  }
+
+  if (update) {
+    std::FILE* out = std::fopen(baseline_path.c_str(), "w");
+    if (out == nullptr) {
+      std::fprintf(stderr, "xiaozi_perf_gate: cannot write %s: %s\n",
+                   baseline_path.c_str(), std::strerror(errno));
+      return 1;
+    }
+    for (const std::string& line : updated) {
+      std::fprintf(out, "%s\n", line.c_str());
+    }
+    std::fclose(out);
+  }
+
+  if (failed != 0) {
+    std::printf("xiaozi_perf_gate: %zu of %zu case(s) %s\n", failed, gated,
+                update ? "missing" : "failed");
+    return 1;
+  }
+  std::printf("xiaozi_perf_gate: %zu case(s) %s\n", gated,
+              update ? "updated" : "within limits");
+  return 0;
+}
@@ -0,0 +1,95 @@
+# Driver for the perf_gate and perf_baseline targets (bench/CMakeLists.txt),
+# run as `cmake -P` with SOURCE_DIR, BINARY_DIR, GATE_DIR, CTEST_COMMAND,
+# GENERATOR and UPDATE set.
+#
+# 1. Configures GATE_DIR as Release with XIAOZI_LTO and builds it, unless
+#    it is the calling build, which must already be configured that way.
+# 2. Runs ctest there (the bench self-checks and the unit tests), failing
+#    if none are registered; the log goes to SOURCE_DIR/test_output.txt.
+# 3. Runs the bench suite PERF_GATE_RUNS times (3 by default), keeping the
+#    first run as GATE_DIR/bench_output.txt.
+# 4. Hands the runs to xiaozi_perf_gate against bench/perf_baseline.txt,
+#    which prints the per-case report (also saved as
+#    GATE_DIR/perf_gate_report.txt) and decides the result.
+#
+# PERF_GATE_RUNS and PERF_GATE_BENCHTIME (ms per case, default 500) can be
+# set in the environment for a noisier or quieter machine.
+
+cmake_minimum_required(VERSION 3.16)
+
+foreach(_var SOURCE_DIR BINARY_DIR GATE_DIR CTEST_COMMAND GENERATOR)
+  if(NOT DEFINED ${_var})
+    message(FATAL_ERROR "perf_gate.cmake: ${_var} is not set")
+  endif()
+endforeach()
+
+set(_runs 3)
+if(DEFINED ENV{PERF_GATE_RUNS})
+  set(_runs $ENV{PERF_GATE_RUNS})
+endif()
+set(_benchtime 500)
+if(DEFINED ENV{PERF_GATE_BENCHTIME})
+  set(_benchtime $ENV{PERF_GATE_BENCHTIME})
+endif()
+
+function(run_step what)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE _result)
+  if(NOT _result EQUAL 0)
+    message(FATAL_ERROR "perf_gate: ${what} failed (${_result})")
+  endif()
+endfunction()
+
+get_filename_component(_binary "${BINARY_DIR}" REALPATH)
+get_filename_component(_gate "${GATE_DIR}" REALPATH)
+if(_binary STREQUAL _gate)
+  file(STRINGS "${GATE_DIR}/CMakeCache.txt" _type
+    REGEX "^CMAKE_BUILD_TYPE:")
+  file(STRINGS "${GATE_DIR}/CMakeCache.txt" _lto REGEX "^XIAOZI_LTO:")
+  if(NOT _type MATCHES "=Release$" OR NOT _lto MATCHES "=ON$")
+    message(FATAL_ERROR "perf_gate: ${GATE_DIR} is not a Release LTO "
+      "build; run the target from another build directory, or configure "
+      "it with -DCMAKE_BUILD_TYPE=Release -DXIAOZI_LTO=ON")
+  endif()
+else()
+  message(STATUS "perf_gate: building Release with LTO in ${GATE_DIR}")
+  run_step("configure" "${CMAKE_COMMAND}" -S "${SOURCE_DIR}" -B "${GATE_DIR}"
+    -G "${GENERATOR}" -DCMAKE_BUILD_TYPE=Release -DXIAOZI_LTO=ON
+    -DXIAOZI_BUILD_BENCH=ON)
+  cmake_host_system_information(RESULT _jobs QUERY NUMBER_OF_LOGICAL_CORES)
+  run_step("build" "${CMAKE_COMMAND}" --build "${GATE_DIR}" -j ${_jobs})
+endif()
+
+message(STATUS "perf_gate: running tests, log in test_output.txt")
+execute_process(
+  COMMAND "${CTEST_COMMAND}" --output-on-failure --no-tests=error
+  WORKING_DIRECTORY "${GATE_DIR}"
+  OUTPUT_VARIABLE _tests ERROR_VARIABLE _tests RESULT_VARIABLE _result)
+file(WRITE "${SOURCE_DIR}/test_output.txt" "${_tests}")
+if(NOT _result EQUAL 0)
+  message(FATAL_ERROR "perf_gate: tests failed, see test_output.txt")
+endif()
+
+set(_outputs)
+foreach(_run RANGE 1 ${_runs})
+  message(STATUS "perf_gate: bench run ${_run} of ${_runs}")
+  set(_out "${GATE_DIR}/bench_run_${_run}.txt")
+  run_step("bench run ${_run}" "${GATE_DIR}/bench/xiaozi_bench"
+    --benchtime=${_benchtime} --out=${_out})
+  list(APPEND _outputs "${_out}")
+endforeach()
+configure_file("${GATE_DIR}/bench_run_1.txt" "${GATE_DIR}/bench_output.txt"
+  COPYONLY)
+
+set(_compare "${GATE_DIR}/bench/xiaozi_perf_gate"
+  --baseline=${SOURCE_DIR}/bench/perf_baseline.txt)
+if(UPDATE)
+  list(APPEND _compare --update)
+endif()
+execute_process(COMMAND ${_compare} ${_outputs}
+  OUTPUT_VARIABLE _report RESULT_VARIABLE _result)
+file(WRITE "${GATE_DIR}/perf_gate_report.txt" "${_report}")
+message("${_report}")
+if(NOT _result EQUAL 0)
+  message(FATAL_ERROR "perf_gate: failed against bench/perf_baseline.txt, "
+    "report in ${GATE_DIR}/perf_gate_report.txt")
+endif()
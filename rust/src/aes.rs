@@ -0,0 +1,133 @@
+//! AES-128-CTR with the same counter convention as OpenSSL's EVP CTR: the
+//! 16-byte IV is one big-endian 128-bit counter, incremented per block.
+//! AES-NI only. A table-driven software AES leaks the key through cache
+//! timing, so without the instructions there is no cipher here: new()
+//! returns None and callers use OpenSSL's constant-time one instead.
+
+type Block = [u8; 16];
+
+pub struct Aes128Ctr {
+    round_keys: [Block; 11],
+}
+
+impl Aes128Ctr {
+    /// None unless the CPU has AES instructions.
+    pub fn new(key: &Block) -> Option<Self> {
+        #[cfg(target_arch = "x86_64")]
+        if std::arch::is_x86_feature_detected!("aes") {
+            // SAFETY: the CPU supports the feature.
+            return Some(Aes128Ctr {
+                round_keys: unsafe { x86::expand_key(key) },
+            });
+        }
+        let _ = key;
+        None
+    }
+
+    /// XORs `data` in place with the keystream starting at counter `iv`.
+    pub fn apply(&self, iv: &Block, data: &mut [u8]) {
+        let counter = u128::from_be_bytes(*iv);
+        // SAFETY: new() only succeeds where the CPU supports the feature.
+        #[cfg(target_arch = "x86_64")]
+        unsafe {
+            x86::apply(&self.round_keys, counter, data)
+        };
+        #[cfg(not(target_arch = "x86_64"))]
+        let _ = (&self.round_keys, counter, data);
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+mod x86 {
+    use super::Block;
+    use std::arch::x86_64::*;
+
+    #[inline(always)]
+    unsafe fn load(b: &Block) -> __m128i {
+        _mm_loadu_si128(b.as_ptr() as *const __m128i)
+    }
+
+    #[inline(always)]
+    unsafe fn counter_block(counter: u128) -> __m128i {
+        load(&counter.to_be_bytes())
+    }
+
+    // One key schedule step: `assist` is aeskeygenassist of the previous
+    // round key with that round's constant.
+    #[inline(always)]
+    unsafe fn next_round_key(key: __m128i, assist: __m128i) -> __m128i {
+        let mut key = key;
+        key = _mm_xor_si128(key, _mm_slli_si128::<4>(key));
+        key = _mm_xor_si128(key, _mm_slli_si128::<4>(key));
+        key = _mm_xor_si128(key, _mm_slli_si128::<4>(key));
+        _mm_xor_si128(key, _mm_shuffle_epi32::<0xff>(assist))
+    }
+
+    #[target_feature(enable = "aes,sse2")]
+    pub unsafe fn expand_key(key: &Block) -> [Block; 11] {
+        macro_rules! round {
+            ($k:expr, $rcon:literal) => {
+                next_round_key($k, _mm_aeskeygenassist_si128::<$rcon>($k))
+            };
+        }
+        let mut k = [_mm_setzero_si128(); 11];
+        k[0] = load(key);
+        k[1] = round!(k[0], 0x01);
+        k[2] = round!(k[1], 0x02);
+        k[3] = round!(k[2], 0x04);
+        k[4] = round!(k[3], 0x08);
+        k[5] = round!(k[4], 0x10);
+        k[6] = round!(k[5], 0x20);
+        k[7] = round!(k[6], 0x40);
+        k[8] = round!(k[7], 0x80);
+        k[9] = round!(k[8], 0x1b);
+        k[10] = round!(k[9], 0x36);
+        let mut rk = [[0u8; 16]; 11];
+        for (dst, src) in rk.iter_mut().zip(&k) {
+            _mm_storeu_si128(dst.as_mut_ptr() as *mut __m128i, *src);
+        }
+        rk
+    }
+
+    // Four counter blocks per pass keep the AES unit's pipeline full.
+    #[target_feature(enable = "aes,sse2")]
+    pub unsafe fn apply(rk: &[Block; 11], mut counter: u128, data: &mut [u8]) {
+        let mut k = [_mm_setzero_si128(); 11];
+        for (dst, src) in k.iter_mut().zip(rk) {
+            *dst = load(src);
+        }
+        let mut chunks = data.chunks_exact_mut(64);
+        for chunk in &mut chunks {
+            let mut b = [_mm_setzero_si128(); 4];
+            for (j, blk) in b.iter_mut().enumerate() {
+                *blk = _mm_xor_si128(counter_block(counter.wrapping_add(j as u128)), k[0]);
+            }
+            for key in &k[1..10] {
+                for blk in b.iter_mut() {
+                    *blk = _mm_aesenc_si128(*blk, *key);
+                }
+            }
+            for (j, blk) in b.iter().enumerate() {
+                let ks = _mm_aesenclast_si128(*blk, k[10]);
+                let p = chunk.as_mut_ptr().add(16 * j) as *mut __m128i;
+                _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), ks));
+            }
+            counter = counter.wrapping_add(4);
+        }
+        for chunk in chunks.into_remainder().chunks_mut(16) {
+            let mut blk = _mm_xor_si128(counter_block(counter), k[0]);
+            for key in &k[1..10] {
+                blk = _mm_aesenc_si128(blk, *key);
+            }
+            let mut ks = [0u8; 16];
+            _mm_storeu_si128(
+                ks.as_mut_ptr() as *mut __m128i,
+                _mm_aesenclast_si128(blk, k[10]),
+            );
+            for (d, k) in chunk.iter_mut().zip(&ks) {
+                *d ^= k;
+            }
+            counter = counter.wrapping_add(1);
+        }
+    }
+}
@@ -0,0 +1,204 @@
+//! Playout logic of audio/jitter_buffer.cc, decision for decision: the
+//! same RFC 3550 jitter estimate, target depth, refill after underrun and
+//! catch-up drops, so the two can be swapped and compared. Packets are
+//! opaque tokens owned by the caller's pool; the buffer never looks inside
+//! them and hands every one back, either from pop() or through `release`.
+//! Single-threaded; the C++ wrapper keeps the cross-thread inbox.
+
+use std::ffi::c_void;
+use std::ptr;
+
+pub const SLOTS: usize = 64;
+
+pub type Release = extern "C" fn(*mut c_void);
+
+#[derive(Clone, Copy)]
+pub struct Config {
+    pub frame_ms: u32,
+    pub min_frames: u32,
+    pub max_frames: u32,
+}
+
+pub enum Pop {
+    Packet(*mut c_void),
+    Lost,
+    NotReady,
+}
+
+#[derive(Default)]
+pub struct Counters {
+    pub received: u64,
+    pub late: u64,
+    pub duplicates: u64,
+    pub lost: u64,
+    pub dropped: u64,
+    pub underruns: u64,
+}
+
+pub struct JitterBuffer {
+    config: Config,
+    release: Release,
+    slots: [*mut c_void; SLOTS],
+    started: bool,
+    playing: bool,
+    next_seq: u32,
+    newest_seq: u32,
+    have_transit: bool,
+    last_transit_ns: i64,
+    jitter_ns: f64,
+    target: u32,
+    pub counters: Counters,
+}
+
+impl JitterBuffer {
+    pub fn new(config: Config, release: Release) -> Self {
+        JitterBuffer {
+            config,
+            release,
+            slots: [ptr::null_mut(); SLOTS],
+            started: false,
+            playing: false,
+            next_seq: 0,
+            newest_seq: 0,
+            have_transit: false,
+            last_transit_ns: 0,
+            jitter_ns: 0.0,
+            target: config.min_frames,
+            counters: Counters::default(),
+        }
+    }
+
+    fn slot(&mut self, seq: u32) -> &mut *mut c_void {
+        &mut self.slots[seq as usize % SLOTS]
+    }
+
+    fn clear_slots(&mut self) {
+        for i in 0..SLOTS {
+            let token = std::mem::replace(&mut self.slots[i], ptr::null_mut());
+            if !token.is_null() {
+                (self.release)(token);
+            }
+        }
+    }
+
+    /// Takes ownership of `token`.
+    pub fn insert(&mut self, token: *mut c_void, seq: u32, arrival_ns: u64) {
+        self.counters.received += 1;
+        self.update_jitter(seq, arrival_ns);
+        if !self.started {
+            self.started = true;
+            self.next_seq = seq;
+            self.newest_seq = seq;
+        }
+        let ahead = seq.wrapping_sub(self.next_seq) as i32;
+        let window = SLOTS as i32;
+        if ahead < -window || ahead >= window {
+            self.clear_slots();
+            self.next_seq = seq;
+            self.newest_seq = seq;
+            self.playing = false;
+        } else if ahead < 0 {
+            self.counters.late += 1;
+            (self.release)(token);
+            return;
+        }
+        let release = self.release;
+        let slot = self.slot(seq);
+        if !slot.is_null() {
+            self.counters.duplicates += 1;
+            release(token);
+            return;
+        }
+        *slot = token;
+        if seq.wrapping_sub(self.newest_seq) as i32 > 0 {
+            self.newest_seq = seq;
+        }
+    }
+
+    fn update_jitter(&mut self, seq: u32, arrival_ns: u64) {
+        let frame_ns = self.config.frame_ms as i64 * 1_000_000;
+        let transit = arrival_ns as i64 - seq as i64 * frame_ns;
+        if self.have_transit {
+            let d = (transit - self.last_transit_ns).abs() as f64;
+            let cap = (SLOTS as i64 * frame_ns) as f64;
+            self.jitter_ns += (d.min(cap) - self.jitter_ns) / 16.0;
+        }
+        self.have_transit = true;
+        self.last_transit_ns = transit;
+    }
+
+    fn update_target(&mut self) {
+        let frame_ns = self.config.frame_ms as f64 * 1e6;
+        let frames = (2.0 * self.jitter_ns / frame_ns).ceil() as u32 + 1;
+        self.target = frames.clamp(self.config.min_frames, self.config.max_frames);
+    }
+
+    pub fn depth(&self) -> u32 {
+        if !self.started {
+            return 0;
+        }
+        let span = self.newest_seq.wrapping_sub(self.next_seq) as i32;
+        if span < 0 {
+            0
+        } else {
+            span as u32 + 1
+        }
+    }
+
+    pub fn pop(&mut self) -> Pop {
+        self.update_target();
+        let mut d = self.depth();
+        if !self.playing {
+            if d == 0 || d < self.target {
+                return Pop::NotReady;
+            }
+            self.playing = true;
+        }
+        if d == 0 {
+            self.playing = false;
+            self.counters.underruns += 1;
+            return Pop::NotReady;
+        }
+        while d > self.target + 2 {
+            let seq = self.next_seq;
+            self.next_seq = seq.wrapping_add(1);
+            let token = std::mem::replace(self.slot(seq), ptr::null_mut());
+            if !token.is_null() {
+                (self.release)(token);
+                self.counters.dropped += 1;
+            }
+            d -= 1;
+        }
+        let seq = self.next_seq;
+        self.next_seq = seq.wrapping_add(1);
+        let token = std::mem::replace(self.slot(seq), ptr::null_mut());
+        if token.is_null() {
+            self.counters.lost += 1;
+            return Pop::Lost;
+        }
+        Pop::Packet(token)
+    }
+
+    pub fn reset(&mut self) {
+        self.clear_slots();
+        self.started = false;
+        self.playing = false;
+        self.have_transit = false;
+        self.jitter_ns = 0.0;
+        self.target = self.config.min_frames;
+    }
+
+    pub fn target(&self) -> u32 {
+        self.target
+    }
+
+    pub fn jitter_ms(&self) -> f64 {
+        self.jitter_ns / 1e6
+    }
+}
+
+impl Drop for JitterBuffer {
+    fn drop(&mut self) {
+        self.clear_slots();
+    }
+}
@@ -0,0 +1,143 @@
+//! C ABI of the Rust components, declared for C++ in src/rust/xiaozi_rs.h.
+//! Everything crosses the boundary as borrowed pointers: buffers are
+//! worked on in place, packets travel as opaque tokens, and no call copies
+//! or marshals data. Handles are boxed and owned by the C++ wrapper.
+//! Built with panic = "abort", so no unwinding ever reaches C++.
+
+mod aes;
+mod jitter;
+
+use std::ffi::c_void;
+
+use aes::Aes128Ctr;
+use jitter::{Config, JitterBuffer, Pop};
+
+/// Null on a CPU without AES instructions; use OpenSSL there.
+///
+/// # Safety
+/// `key` points to 16 readable bytes.
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_aes128_ctr_new(key: *const u8) -> *mut Aes128Ctr {
+    let key = &*(key as *const [u8; 16]);
+    match Aes128Ctr::new(key) {
+        Some(cipher) => Box::into_raw(Box::new(cipher)),
+        None => std::ptr::null_mut(),
+    }
+}
+
+/// # Safety
+/// `ctx` came from xz_rs_aes128_ctr_new() and is not used afterwards.
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_aes128_ctr_free(ctx: *mut Aes128Ctr) {
+    if !ctx.is_null() {
+        drop(Box::from_raw(ctx));
+    }
+}
+
+/// # Safety
+/// `iv` points to 16 bytes; `data` to `len` writable bytes (or len == 0).
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_aes128_ctr_apply(
+    ctx: *const Aes128Ctr,
+    iv: *const u8,
+    data: *mut u8,
+    len: usize,
+) {
+    if len == 0 {
+        return;
+    }
+    let data = std::slice::from_raw_parts_mut(data, len);
+    (*ctx).apply(&*(iv as *const [u8; 16]), data);
+}
+
+#[repr(C)]
+pub struct XzRsJitterStats {
+    pub received: u64,
+    pub late: u64,
+    pub duplicates: u64,
+    pub lost: u64,
+    pub dropped: u64,
+    pub underruns: u64,
+    pub target_frames: u32,
+    pub depth_frames: u32,
+    pub jitter_ms: f64,
+}
+
+#[no_mangle]
+pub extern "C" fn xz_rs_jitter_new(
+    frame_ms: u32,
+    min_frames: u32,
+    max_frames: u32,
+    release: jitter::Release,
+) -> *mut JitterBuffer {
+    let config = Config {
+        frame_ms,
+        min_frames,
+        max_frames,
+    };
+    Box::into_raw(Box::new(JitterBuffer::new(config, release)))
+}
+
+/// # Safety
+/// `jb` came from xz_rs_jitter_new(); buffered tokens are released.
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_jitter_free(jb: *mut JitterBuffer) {
+    if !jb.is_null() {
+        drop(Box::from_raw(jb));
+    }
+}
+
+/// # Safety
+/// `jb` is live; ownership of `token` passes to the buffer.
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_jitter_insert(
+    jb: *mut JitterBuffer,
+    token: *mut c_void,
+    sequence: u32,
+    arrival_ns: u64,
+) {
+    (*jb).insert(token, sequence, arrival_ns);
+}
+
+/// Returns 0 with the packet's token in `*token`, 1 for a lost frame, 2
+/// while buffering (the JitterBuffer::Status order).
+///
+/// # Safety
+/// `jb` is live and `token` writable.
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_jitter_pop(jb: *mut JitterBuffer, token: *mut *mut c_void) -> u32 {
+    match (*jb).pop() {
+        Pop::Packet(t) => {
+            *token = t;
+            0
+        }
+        Pop::Lost => 1,
+        Pop::NotReady => 2,
+    }
+}
+
+/// # Safety
+/// `jb` is live.
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_jitter_reset(jb: *mut JitterBuffer) {
+    (*jb).reset();
+}
+
+/// # Safety
+/// `jb` is live and `out` writable.
+#[no_mangle]
+pub unsafe extern "C" fn xz_rs_jitter_stats(jb: *const JitterBuffer, out: *mut XzRsJitterStats) {
+    let jb = &*jb;
+    let c = &jb.counters;
+    *out = XzRsJitterStats {
+        received: c.received,
+        late: c.late,
+        duplicates: c.duplicates,
+        lost: c.lost,
+        dropped: c.dropped,
+        underruns: c.underruns,
+        target_frames: jb.target(),
+        depth_frames: jb.depth(),
+        jitter_ms: jb.jitter_ms(),
+    };
+}
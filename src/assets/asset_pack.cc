@@ -0,0 +1,212 @@
+#include "assets/asset_pack.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace xiaozi {
+
+static_assert(std::endian::native == std::endian::little,
+              "asset packs are little-endian and used in place");
+
+namespace {
+
+template <typename T>
+const T* at(std::span<const std::byte> bytes, std::size_t offset) {
+  return reinterpret_cast<const T*>(bytes.data() + offset);
+}
+
+std::span<const uint8_t> as_u8(std::span<const std::byte> bytes) {
+  return {reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size()};
+}
+
+}  // namespace
+
+FontView::FontView(std::span<const std::byte> payload) : payload_(payload) {
+  if (payload.size() < sizeof(pack::FontHeader)) return;
+  const auto* header = at<pack::FontHeader>(payload, 0);
+  const std::size_t table = sizeof(pack::FontHeader) +
+                            std::size_t{header->glyph_count} *
+                                sizeof(pack::Glyph);
+  if (table > payload.size()) return;
+  header_ = header;
+  glyphs_ = at<pack::Glyph>(payload, sizeof(pack::FontHeader));
+  count_ = header->glyph_count;
+}
+
+std::optional<FontView::Glyph> FontView::find(uint32_t codepoint) const {
+  const pack::Glyph* end = glyphs_ + count_;
+  const pack::Glyph* g = std::lower_bound(
+      glyphs_, end, codepoint,
+      [](const pack::Glyph& g, uint32_t cp) { return g.codepoint < cp; });
+  if (g == end || g->codepoint != codepoint) return std::nullopt;
+  const std::size_t stride = (g->width + 7u) / 8u;
+  const std::size_t bytes = stride * g->height;
+  if (g->bitmap_offset > payload_.size() ||
+      bytes > payload_.size() - g->bitmap_offset) {
+    return std::nullopt;
+  }
+  return Glyph{g, as_u8(payload_.subspan(g->bitmap_offset, bytes)), stride};
+}
+
+OpusClipView::OpusClipView(std::span<const std::byte> payload,
+                           const pack::Entry& entry) {
+  const std::size_t count = entry.meta[0];
+  const std::size_t table = count * sizeof(uint32_t);
+  if (table > payload.size()) return;
+  ends_ = at<uint32_t>(payload, 0);
+  data_ = as_u8(payload.subspan(table));
+  count_ = count;
+  input_rate_ = static_cast<int>(entry.meta[1]);
+  channels_ = static_cast<int>(entry.meta[2]);
+  pre_skip_ = static_cast<int>(entry.meta[3]);
+}
+
+std::span<const uint8_t> OpusClipView::packet(std::size_t i) const {
+  if (i >= count_) return {};
+  const uint32_t begin = i == 0 ? 0 : ends_[i - 1];
+  const uint32_t end = ends_[i];
+  if (begin > end || end > data_.size()) return {};
+  return data_.subspan(begin, end - begin);
+}
+
+std::unique_ptr<AssetPack> AssetPack::open(const char* path) {
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < off_t{sizeof(pack::Header)}) {
+    ::close(fd);
+    return nullptr;
+  }
+  const auto size = static_cast<std::size_t>(st.st_size);
+  void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);  // the mapping keeps the file
+  if (base == MAP_FAILED) return nullptr;
+  posix_madvise(base, size, POSIX_MADV_RANDOM);
+  std::unique_ptr<AssetPack> pack(
+      new AssetPack(static_cast<const std::byte*>(base), size, true));
+  if (!pack->validate()) return nullptr;
+  return pack;
+}
+
+std::unique_ptr<AssetPack> AssetPack::attach(
+    std::span<const std::byte> memory) {
+  std::unique_ptr<AssetPack> pack(
+      new AssetPack(memory.data(), memory.size(), false));
+  if (!pack->validate()) return nullptr;
+  return pack;
+}
+
+AssetPack::AssetPack(const std::byte* base, std::size_t size, bool mapped)
+    : base_(base), size_(size), mapped_(mapped) {}
+
+AssetPack::~AssetPack() {
+  if (mapped_) munmap(const_cast<std::byte*>(base_), size_);
+}
+
+bool AssetPack::validate() {
+  if (size_ < sizeof(pack::Header) ||
+      reinterpret_cast<uintptr_t>(base_) % alignof(pack::Entry) != 0) {
+    return false;
+  }
+  const auto* h = reinterpret_cast<const pack::Header*>(base_);
+  if (std::memcmp(h->magic, pack::kMagic, sizeof(h->magic)) != 0 ||
+      h->version != pack::kVersion || h->total_bytes != size_) {
+    return false;
+  }
+  const std::size_t index_end =
+      sizeof(pack::Header) + std::size_t{h->entry_count} * sizeof(pack::Entry);
+  if (index_end > size_ || h->names_offset < index_end ||
+      h->names_offset > size_ || h->names_bytes > size_ - h->names_offset) {
+    return false;
+  }
+  const auto* entries =
+      reinterpret_cast<const pack::Entry*>(base_ + sizeof(pack::Header));
+  for (uint32_t i = 0; i < h->entry_count; ++i) {
+    const pack::Entry& e = entries[i];
+    if (i != 0 && entries[i - 1].name_hash >= e.name_hash) return false;
+    if (e.name_offset > h->names_bytes ||
+        e.name_len > h->names_bytes - e.name_offset || e.offset > size_ ||
+        e.size > size_ - e.offset || e.offset % alignof(uint32_t) != 0) {
+      return false;
+    }
+  }
+  header_ = h;
+  entries_ = entries;
+  return true;
+}
+
+const pack::Entry* AssetPack::find(std::string_view name) const {
+  const uint64_t hash = pack::hash_name(name);
+  const pack::Entry* end = entries_ + header_->entry_count;
+  const pack::Entry* e = std::lower_bound(
+      entries_, end, hash,
+      [](const pack::Entry& e, uint64_t h) { return e.name_hash < h; });
+  if (e == end || e->name_hash != hash || this->name(*e) != name) {
+    return nullptr;
+  }
+  return e;
+}
+
+std::string_view AssetPack::name(const pack::Entry& entry) const {
+  return {reinterpret_cast<const char*>(base_) + header_->names_offset +
+              entry.name_offset,
+          entry.name_len};
+}
+
+std::span<const std::byte> AssetPack::payload(const pack::Entry& entry) const {
+  return {base_ + entry.offset, entry.size};
+}
+
+std::optional<FontView> AssetPack::font(std::string_view name) const {
+  const pack::Entry* e = find(name);
+  if (e == nullptr || e->kind != pack::Kind::kFont) return std::nullopt;
+  FontView view(payload(*e));
+  if (!view.ok()) return std::nullopt;
+  return view;
+}
+
+std::optional<ImageView> AssetPack::image(std::string_view name) const {
+  const pack::Entry* e = find(name);
+  if (e == nullptr || e->kind != pack::Kind::kImage) return std::nullopt;
+  ImageView view;
+  view.width = static_cast<uint16_t>(e->meta[0]);
+  view.height = static_cast<uint16_t>(e->meta[1]);
+  view.format = static_cast<pack::ImageFormat>(e->meta[2]);
+  view.stride = e->meta[3];
+  const std::size_t pixels = view.stride * view.height;
+  const std::size_t alpha = view.format == pack::ImageFormat::kRgb565A8
+                                ? std::size_t{view.width} * view.height
+                                : 0;
+  if ((view.format != pack::ImageFormat::kRgb565 &&
+       view.format != pack::ImageFormat::kRgb565A8) ||
+      view.stride < std::size_t{view.width} * 2 ||
+      pixels + alpha > e->size) {
+    return std::nullopt;
+  }
+  const auto bytes = as_u8(payload(*e));
+  view.pixels = bytes.first(pixels);
+  view.alpha = bytes.subspan(pixels, alpha);
+  return view;
+}
+
+std::optional<OpusClipView> AssetPack::clip(std::string_view name) const {
+  const pack::Entry* e = find(name);
+  if (e == nullptr || e->kind != pack::Kind::kOpusClip) return std::nullopt;
+  OpusClipView view(payload(*e), *e);
+  if (!view.ok()) return std::nullopt;
+  return view;
+}
+
+std::span<const std::byte> AssetPack::blob(std::string_view name) const {
+  const pack::Entry* e = find(name);
+  if (e == nullptr) return {};
+  return payload(*e);
+}
+
+}  // namespace xiaozi
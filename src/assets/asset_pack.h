@@ -0,0 +1,201 @@
+#ifndef XIAOZI_ASSETS_ASSET_PACK_H_
+#define XIAOZI_ASSETS_ASSET_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace xiaozi {
+
+// On-disk layout of an asset pack, as written by AssetPackWriter. All
+// integers little-endian; every payload starts on a Header::alignment
+// boundary so pixels and glyph rows can be handed to a DMA engine as is.
+//
+//   Header | Entry[entry_count] (sorted by name_hash) | names | payloads
+namespace pack {
+
+inline constexpr char kMagic[4] = {'X', 'Z', 'A', 'P'};
+inline constexpr uint16_t kVersion = 1;
+
+enum class Kind : uint8_t { kBlob = 0, kFont = 1, kImage = 2, kOpusClip = 3 };
+
+struct Header {
+  char magic[4];
+  uint16_t version;
+  uint16_t alignment;
+  uint32_t entry_count;
+  uint32_t names_offset;
+  uint32_t names_bytes;
+  uint32_t reserved;
+  uint64_t total_bytes;
+};
+static_assert(sizeof(Header) == 32);
+
+struct Entry {
+  uint64_t name_hash;
+  uint32_t name_offset;  // into the names table
+  uint16_t name_len;
+  Kind kind;
+  uint8_t reserved;
+  uint32_t offset;  // from the start of the pack
+  uint32_t size;
+  // kImage: width, height, ImageFormat, stride in bytes.
+  // kOpusClip: packet count, input sample rate, channels, pre-skip.
+  uint32_t meta[4];
+};
+static_assert(sizeof(Entry) == 40);
+
+// kFont payload: FontHeader, Glyph[glyph_count] sorted by codepoint, then
+// the 1 bpp bitmaps (MSB first, rows padded to whole bytes).
+struct FontHeader {
+  uint32_t glyph_count;
+  uint16_t line_height;
+  int16_t ascent;
+  uint32_t reserved[2];
+};
+static_assert(sizeof(FontHeader) == 16);
+
+struct Glyph {
+  uint32_t codepoint;
+  uint32_t bitmap_offset;  // from the start of the font payload
+  uint8_t width;
+  uint8_t height;
+  int8_t x_offset;  // from the pen position to the bitmap's left edge
+  int8_t y_offset;  // from the baseline up to the bitmap's bottom edge
+  uint8_t advance;
+  uint8_t reserved[3];
+};
+static_assert(sizeof(Glyph) == 16);
+
+enum class ImageFormat : uint32_t {
+  kRgb565 = 1,    // stride * height bytes of pixels
+  kRgb565A8 = 2,  // the same, followed by width * height alpha bytes
+};
+
+// kOpusClip payload: uint32_t ends[packet_count], each the end offset of a
+// packet within the data that follows the table.
+
+// FNV-1a, so callers can hash names at compile time.
+constexpr uint64_t hash_name(std::string_view name) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (char c : name) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+}  // namespace pack
+
+// A pre-rasterized font used in place. find() is a binary search over the
+// glyph table; only the pages holding that table and the glyph's bitmap
+// are ever touched.
+class FontView {
+ public:
+  struct Glyph {
+    const pack::Glyph* metrics;
+    std::span<const uint8_t> bitmap;
+    std::size_t stride;  // bytes per bitmap row
+  };
+
+  FontView() = default;
+  explicit FontView(std::span<const std::byte> payload);
+
+  bool ok() const { return glyphs_ != nullptr; }
+  std::size_t size() const { return count_; }
+  // The payload in the pack; its address identifies the font.
+  std::span<const std::byte> bytes() const { return payload_; }
+  uint16_t line_height() const { return header_->line_height; }
+  int16_t ascent() const { return header_->ascent; }
+
+  // nullopt if the font has no such glyph (or its entry is corrupt).
+  std::optional<Glyph> find(uint32_t codepoint) const;
+
+ private:
+  std::span<const std::byte> payload_;
+  const pack::FontHeader* header_ = nullptr;
+  const pack::Glyph* glyphs_ = nullptr;
+  std::size_t count_ = 0;
+};
+
+struct ImageView {
+  uint16_t width = 0;
+  uint16_t height = 0;
+  pack::ImageFormat format = pack::ImageFormat::kRgb565;
+  std::size_t stride = 0;               // bytes per pixel row
+  std::span<const uint8_t> pixels;      // RGB565, little-endian
+  std::span<const uint8_t> alpha;       // empty unless kRgb565A8
+};
+
+// A prompt sound as Opus packets, ready for the decoder stage.
+class OpusClipView {
+ public:
+  OpusClipView() = default;
+  OpusClipView(std::span<const std::byte> payload, const pack::Entry& entry);
+
+  bool ok() const { return ends_ != nullptr; }
+  std::size_t packets() const { return count_; }
+  int input_sample_rate() const { return input_rate_; }
+  int channels() const { return channels_; }
+  int pre_skip() const { return pre_skip_; }
+
+  // Empty if i is out of range or the table is corrupt.
+  std::span<const uint8_t> packet(std::size_t i) const;
+
+ private:
+  const uint32_t* ends_ = nullptr;
+  std::span<const uint8_t> data_;
+  std::size_t count_ = 0;
+  int input_rate_ = 0;
+  int channels_ = 0;
+  int pre_skip_ = 0;
+};
+
+// Read-only view of a pack, mapped from a file or from memory that is
+// already addressable (a flash partition mapped by the bootloader or
+// esp_partition_mmap). open() checks the header and the index bounds,
+// which touches only the first pages; payloads fault in as they are first
+// used, and the mapping is advised for random access so the kernel does
+// not read ahead into neighbouring assets.
+//
+// Lookups are thread-safe; views stay valid as long as the pack.
+class AssetPack {
+ public:
+  static std::unique_ptr<AssetPack> open(const char* path);
+  // `memory` must outlive the pack.
+  static std::unique_ptr<AssetPack> attach(std::span<const std::byte> memory);
+  ~AssetPack();
+
+  AssetPack(const AssetPack&) = delete;
+  AssetPack& operator=(const AssetPack&) = delete;
+
+  std::size_t size() const { return header_->entry_count; }
+  std::span<const std::byte> bytes() const { return {base_, size_}; }
+
+  const pack::Entry* find(std::string_view name) const;
+  std::string_view name(const pack::Entry& entry) const;
+  std::span<const std::byte> payload(const pack::Entry& entry) const;
+
+  // Typed lookups; nullopt if the name is missing or of another kind.
+  std::optional<FontView> font(std::string_view name) const;
+  std::optional<ImageView> image(std::string_view name) const;
+  std::optional<OpusClipView> clip(std::string_view name) const;
+  std::span<const std::byte> blob(std::string_view name) const;
+
+ private:
+  AssetPack(const std::byte* base, std::size_t size, bool mapped);
+  bool validate();
+
+  const std::byte* base_;
+  std::size_t size_;
+  bool mapped_;
+  const pack::Header* header_ = nullptr;
+  const pack::Entry* entries_ = nullptr;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_ASSETS_ASSET_PACK_H_
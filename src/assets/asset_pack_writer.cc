@@ -0,0 +1,181 @@
+#include "assets/asset_pack_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xiaozi {
+namespace {
+
+template <typename T>
+void append(std::vector<uint8_t>& out, const T& value) {
+  const auto* p = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+std::size_t align_up(std::size_t n, std::size_t alignment) {
+  return (n + alignment - 1) & ~(alignment - 1);
+}
+
+}  // namespace
+
+AssetPackWriter::AssetPackWriter(Config config) : config_(config) {
+  // Round up to a power of two that fits Header::alignment.
+  std::size_t a = 4;
+  while (a < config_.alignment && a < 0x8000) a <<= 1;
+  config_.alignment = a;
+}
+
+bool AssetPackWriter::add(std::string_view name, pack::Kind kind,
+                          std::vector<uint8_t> payload,
+                          const uint32_t (&meta)[4]) {
+  const uint64_t hash = pack::hash_name(name);
+  if (name.size() > 0xffff) return false;
+  for (const Asset& a : assets_) {
+    if (a.hash == hash) return false;
+  }
+  Asset asset{std::string(name), hash, kind, {}, std::move(payload)};
+  std::memcpy(asset.meta, meta, sizeof(meta));
+  assets_.push_back(std::move(asset));
+  return true;
+}
+
+bool AssetPackWriter::add_font(std::string_view name,
+                               const DecodedFont& font) {
+  std::vector<const DecodedGlyph*> glyphs;
+  glyphs.reserve(font.glyphs.size());
+  for (const DecodedGlyph& g : font.glyphs) glyphs.push_back(&g);
+  std::stable_sort(glyphs.begin(), glyphs.end(),
+                   [](const DecodedGlyph* a, const DecodedGlyph* b) {
+                     return a->codepoint < b->codepoint;
+                   });
+  // A BDF file may repeat an encoding; the first definition wins.
+  glyphs.erase(std::unique(glyphs.begin(), glyphs.end(),
+                           [](const DecodedGlyph* a, const DecodedGlyph* b) {
+                             return a->codepoint == b->codepoint;
+                           }),
+               glyphs.end());
+
+  std::vector<uint8_t> out;
+  pack::FontHeader header{};
+  header.glyph_count = static_cast<uint32_t>(glyphs.size());
+  header.line_height = font.line_height;
+  header.ascent = font.ascent;
+  append(out, header);
+  std::size_t bitmap_offset =
+      sizeof(pack::FontHeader) + glyphs.size() * sizeof(pack::Glyph);
+  for (const DecodedGlyph* g : glyphs) {
+    pack::Glyph entry{};
+    entry.codepoint = g->codepoint;
+    entry.bitmap_offset = static_cast<uint32_t>(bitmap_offset);
+    entry.width = g->width;
+    entry.height = g->height;
+    entry.x_offset = g->x_offset;
+    entry.y_offset = g->y_offset;
+    entry.advance = g->advance;
+    append(out, entry);
+    bitmap_offset += g->bitmap.size();
+  }
+  for (const DecodedGlyph* g : glyphs) {
+    out.insert(out.end(), g->bitmap.begin(), g->bitmap.end());
+  }
+  return add(name, pack::Kind::kFont, std::move(out), {});
+}
+
+bool AssetPackWriter::add_image(std::string_view name,
+                                const DecodedImage& image) {
+  // Rows padded to 4 bytes, as LCD DMA engines want them.
+  const std::size_t stride = align_up(std::size_t{image.width} * 2, 4);
+  std::vector<uint8_t> out(stride * image.height, 0);
+  for (std::size_t y = 0; y < image.height; ++y) {
+    std::memcpy(&out[y * stride], &image.rgb565[y * image.width],
+                std::size_t{image.width} * 2);
+  }
+  const bool alpha = !image.alpha.empty();
+  out.insert(out.end(), image.alpha.begin(), image.alpha.end());
+  const auto format = alpha ? pack::ImageFormat::kRgb565A8
+                            : pack::ImageFormat::kRgb565;
+  return add(name, pack::Kind::kImage, std::move(out),
+             {image.width, image.height, static_cast<uint32_t>(format),
+              static_cast<uint32_t>(stride)});
+}
+
+bool AssetPackWriter::add_clip(std::string_view name,
+                               const DecodedOpusClip& clip) {
+  std::vector<uint8_t> out;
+  uint32_t end = 0;
+  for (const auto& packet : clip.packets) {
+    end += static_cast<uint32_t>(packet.size());
+    append(out, end);
+  }
+  for (const auto& packet : clip.packets) {
+    out.insert(out.end(), packet.begin(), packet.end());
+  }
+  return add(name, pack::Kind::kOpusClip, std::move(out),
+             {static_cast<uint32_t>(clip.packets.size()),
+              static_cast<uint32_t>(clip.input_sample_rate),
+              static_cast<uint32_t>(clip.channels),
+              static_cast<uint32_t>(clip.pre_skip)});
+}
+
+bool AssetPackWriter::add_blob(std::string_view name,
+                               std::span<const uint8_t> bytes) {
+  return add(name, pack::Kind::kBlob, {bytes.begin(), bytes.end()}, {});
+}
+
+std::optional<std::vector<uint8_t>> AssetPackWriter::finish() const {
+  std::vector<const Asset*> sorted;
+  for (const Asset& a : assets_) sorted.push_back(&a);
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Asset* a, const Asset* b) { return a->hash < b->hash; });
+
+  const std::size_t names_offset =
+      sizeof(pack::Header) + sorted.size() * sizeof(pack::Entry);
+  std::size_t names_bytes = 0;
+  for (const Asset* a : sorted) names_bytes += a->name.size();
+  std::size_t offset = align_up(names_offset + names_bytes, config_.alignment);
+  std::vector<pack::Entry> entries;
+  std::size_t name_offset = 0;
+  for (const Asset* a : sorted) {
+    pack::Entry e{};
+    e.name_hash = a->hash;
+    e.name_offset = static_cast<uint32_t>(name_offset);
+    e.name_len = static_cast<uint16_t>(a->name.size());
+    e.kind = a->kind;
+    e.offset = static_cast<uint32_t>(offset);
+    e.size = static_cast<uint32_t>(a->payload.size());
+    std::memcpy(e.meta, a->meta, sizeof(e.meta));
+    entries.push_back(e);
+    name_offset += a->name.size();
+    offset = align_up(offset + a->payload.size(), config_.alignment);
+    if (offset > UINT32_MAX) return std::nullopt;
+  }
+  // The last payload is not padded out.
+  const std::size_t total =
+      sorted.empty() ? names_offset + names_bytes
+                     : entries.back().offset + entries.back().size;
+
+  pack::Header header{};
+  std::memcpy(header.magic, pack::kMagic, sizeof(header.magic));
+  header.version = pack::kVersion;
+  header.alignment = static_cast<uint16_t>(config_.alignment);
+  header.entry_count = static_cast<uint32_t>(entries.size());
+  header.names_offset = static_cast<uint32_t>(names_offset);
+  header.names_bytes = static_cast<uint32_t>(names_bytes);
+  header.total_bytes = total;
+
+  std::vector<uint8_t> out;
+  out.reserve(total);
+  append(out, header);
+  for (const pack::Entry& e : entries) append(out, e);
+  for (const Asset* a : sorted) {
+    out.insert(out.end(), a->name.begin(), a->name.end());
+  }
+  for (std::size_t i = 0; i < sorted.size(); ++i) {
+    const std::vector<uint8_t>& payload = sorted[i]->payload;
+    out.resize(entries[i].offset, 0);
+    out.insert(out.end(), payload.begin(), payload.end());
+  }
+  return out;
+}
+
+}  // namespace xiaozi
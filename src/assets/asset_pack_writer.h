@@ -0,0 +1,60 @@
+#ifndef XIAOZI_ASSETS_ASSET_PACK_WRITER_H_
+#define XIAOZI_ASSETS_ASSET_PACK_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assets/asset_pack.h"
+#include "assets/asset_sources.h"
+
+namespace xiaozi {
+
+// Lays decoded assets out in the pack format AssetPack reads (see
+// asset_pack.h). Offline only: used by xiaozi_assetpack and benchmarks.
+class AssetPackWriter {
+ public:
+  struct Config {
+    // Payload alignment, rounded up to a power of two in [4, 32768]. Page
+    // size keeps each asset on pages of its own, so using one never faults
+    // in its neighbours.
+    std::size_t alignment = 4096;
+  };
+
+  explicit AssetPackWriter(Config config);
+  AssetPackWriter() : AssetPackWriter(Config{}) {}
+
+  // Each returns false if the name is already taken (or collides).
+  bool add_font(std::string_view name, const DecodedFont& font);
+  bool add_image(std::string_view name, const DecodedImage& image);
+  bool add_clip(std::string_view name, const DecodedOpusClip& clip);
+  bool add_blob(std::string_view name, std::span<const uint8_t> bytes);
+
+  std::size_t size() const { return assets_.size(); }
+
+  // The finished pack; nullopt if it would exceed the format's 4 GiB.
+  std::optional<std::vector<uint8_t>> finish() const;
+
+ private:
+  struct Asset {
+    std::string name;
+    uint64_t hash;
+    pack::Kind kind;
+    uint32_t meta[4];
+    std::vector<uint8_t> payload;
+  };
+
+  bool add(std::string_view name, pack::Kind kind,
+           std::vector<uint8_t> payload, const uint32_t (&meta)[4]);
+
+  Config config_;
+  std::vector<Asset> assets_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_ASSETS_ASSET_PACK_WRITER_H_
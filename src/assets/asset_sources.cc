@@ -0,0 +1,322 @@
+#include "assets/asset_sources.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+namespace xiaozi {
+namespace {
+
+// Line and token scanning for the text formats.
+class Lines {
+ public:
+  explicit Lines(std::string_view text) : rest_(text) {}
+
+  bool next(std::string_view& line) {
+    if (rest_.empty()) return false;
+    const std::size_t nl = rest_.find('\n');
+    line = rest_.substr(0, nl);
+    rest_ = nl == std::string_view::npos ? std::string_view()
+                                         : rest_.substr(nl + 1);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return true;
+  }
+
+ private:
+  std::string_view rest_;
+};
+
+std::string_view next_token(std::string_view& s) {
+  std::size_t b = s.find_first_not_of(" \t");
+  if (b == std::string_view::npos) {
+    s = {};
+    return {};
+  }
+  s.remove_prefix(b);
+  const std::size_t e = std::min(s.find_first_of(" \t"), s.size());
+  std::string_view token = s.substr(0, e);
+  s.remove_prefix(e);
+  return token;
+}
+
+bool parse_int(std::string_view s, int& out) {
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+  return ec == std::errc() && end == s.data() + s.size();
+}
+
+// Reads the next `n` integers of `s`.
+template <std::size_t N>
+bool parse_ints(std::string_view s, std::array<int, N>& out) {
+  for (int& v : out) {
+    if (!parse_int(next_token(s), v)) return false;
+  }
+  return true;
+}
+
+int hex_digit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool fits_int8(int v) { return v >= -128 && v <= 127; }
+
+}  // namespace
+
+std::optional<DecodedFont> parse_bdf(std::string_view text) {
+  Lines lines(text);
+  std::string_view line;
+  if (!lines.next(line) || next_token(line) != "STARTFONT") return std::nullopt;
+
+  DecodedFont font;
+  int ascent = -1, descent = -1;
+  std::array<int, 4> font_box{};
+  bool have_box = false;
+  while (lines.next(line)) {
+    std::string_view rest = line;
+    const std::string_view key = next_token(rest);
+    if (key == "FONTBOUNDINGBOX") {
+      if (!parse_ints(rest, font_box)) return std::nullopt;
+      have_box = true;
+    } else if (key == "FONT_ASCENT") {
+      if (!parse_int(next_token(rest), ascent)) return std::nullopt;
+    } else if (key == "FONT_DESCENT") {
+      if (!parse_int(next_token(rest), descent)) return std::nullopt;
+    } else if (key == "ENDFONT") {
+      break;
+    } else if (key == "STARTCHAR") {
+      int encoding = -1;
+      std::array<int, 2> dwidth{};
+      std::array<int, 4> bbx{};
+      bool have_bbx = false;
+      DecodedGlyph glyph{};
+      while (lines.next(line)) {
+        rest = line;
+        const std::string_view k = next_token(rest);
+        if (k == "ENCODING") {
+          if (!parse_int(next_token(rest), encoding)) return std::nullopt;
+        } else if (k == "DWIDTH") {
+          if (!parse_ints(rest, dwidth)) return std::nullopt;
+        } else if (k == "BBX") {
+          if (!parse_ints(rest, bbx)) return std::nullopt;
+          have_bbx = true;
+        } else if (k == "BITMAP") {
+          if (!have_bbx || bbx[0] < 0 || bbx[0] > 255 || bbx[1] < 0 ||
+              bbx[1] > 255 || !fits_int8(bbx[2]) || !fits_int8(bbx[3]) ||
+              dwidth[0] < 0 || dwidth[0] > 255) {
+            return std::nullopt;
+          }
+          const std::size_t stride = (bbx[0] + 7) / 8;
+          glyph.bitmap.assign(stride * bbx[1], 0);
+          for (int row = 0; row < bbx[1]; ++row) {
+            if (!lines.next(line) || line.size() < 2 * stride) {
+              return std::nullopt;
+            }
+            for (std::size_t i = 0; i < stride; ++i) {
+              const int hi = hex_digit(line[2 * i]);
+              const int lo = hex_digit(line[2 * i + 1]);
+              if (hi < 0 || lo < 0) return std::nullopt;
+              glyph.bitmap[row * stride + i] =
+                  static_cast<uint8_t>(hi << 4 | lo);
+            }
+          }
+        } else if (k == "ENDCHAR") {
+          break;
+        }
+      }
+      if (encoding < 0) continue;
+      glyph.codepoint = static_cast<uint32_t>(encoding);
+      glyph.width = static_cast<uint8_t>(bbx[0]);
+      glyph.height = static_cast<uint8_t>(bbx[1]);
+      glyph.x_offset = static_cast<int8_t>(bbx[2]);
+      glyph.y_offset = static_cast<int8_t>(bbx[3]);
+      glyph.advance = static_cast<uint8_t>(dwidth[0]);
+      font.glyphs.push_back(std::move(glyph));
+    }
+  }
+  if (ascent < 0 || descent < 0) {
+    if (!have_box) return std::nullopt;
+    ascent = font_box[1] + font_box[3];
+    descent = -font_box[3];
+  }
+  if (ascent + descent <= 0 || ascent + descent > 0xffff) return std::nullopt;
+  font.ascent = static_cast<int16_t>(ascent);
+  font.line_height = static_cast<uint16_t>(ascent + descent);
+  return font;
+}
+
+std::optional<DecodedImage> parse_pnm(std::span<const uint8_t> bytes) {
+  const std::string_view all(reinterpret_cast<const char*>(bytes.data()),
+                             bytes.size());
+  int width = 0, height = 0, maxval = 0, depth = 0;
+  std::size_t data = 0;
+  bool has_alpha = false;
+  if (all.starts_with("P6")) {
+    // Whitespace-separated width, height, maxval; '#' starts a comment.
+    std::size_t p = 2;
+    int* fields[] = {&width, &height, &maxval};
+    for (int* field : fields) {
+      for (;;) {
+        while (p < all.size() && is_space(all[p])) ++p;
+        if (p < all.size() && all[p] == '#') {
+          while (p < all.size() && all[p] != '\n') ++p;
+          continue;
+        }
+        break;
+      }
+      const std::size_t b = p;
+      while (p < all.size() && all[p] >= '0' && all[p] <= '9') ++p;
+      if (!parse_int(all.substr(b, p - b), *field)) return std::nullopt;
+    }
+    if (p >= all.size()) return std::nullopt;
+    data = p + 1;  // exactly one whitespace byte before the raster
+    depth = 3;
+  } else if (all.starts_with("P7\n")) {
+    Lines lines(all.substr(3));
+    std::string_view line;
+    std::size_t consumed = 3;
+    std::string_view tupltype;
+    for (;;) {
+      if (!lines.next(line)) return std::nullopt;
+      consumed += line.size() + 1;
+      std::string_view rest = line;
+      const std::string_view key = next_token(rest);
+      const std::string_view value = next_token(rest);
+      if (key == "ENDHDR") break;
+      if (key == "WIDTH" && !parse_int(value, width)) return std::nullopt;
+      if (key == "HEIGHT" && !parse_int(value, height)) return std::nullopt;
+      if (key == "DEPTH" && !parse_int(value, depth)) return std::nullopt;
+      if (key == "MAXVAL" && !parse_int(value, maxval)) return std::nullopt;
+      if (key == "TUPLTYPE") tupltype = value;
+    }
+    if (!((tupltype == "RGB" && depth == 3) ||
+          (tupltype == "RGB_ALPHA" && depth == 4))) {
+      return std::nullopt;
+    }
+    has_alpha = depth == 4;
+    data = consumed;
+  } else {
+    return std::nullopt;
+  }
+  if (width <= 0 || height <= 0 || width > 0xffff || height > 0xffff ||
+      maxval != 255) {
+    return std::nullopt;
+  }
+  const std::size_t pixels = std::size_t(width) * std::size_t(height);
+  if (data > bytes.size() || (bytes.size() - data) / depth < pixels) {
+    return std::nullopt;
+  }
+
+  DecodedImage image;
+  image.width = static_cast<uint16_t>(width);
+  image.height = static_cast<uint16_t>(height);
+  image.rgb565.resize(pixels);
+  if (has_alpha) image.alpha.resize(pixels);
+  const uint8_t* p = bytes.data() + data;
+  for (std::size_t i = 0; i < pixels; ++i, p += depth) {
+    image.rgb565[i] = to_rgb565(p[0], p[1], p[2]);
+    if (has_alpha) image.alpha[i] = p[3];
+  }
+  return image;
+}
+
+namespace {
+
+// Ogg's CRC-32: polynomial 0x04c11db7, not reflected, zero initial value.
+uint32_t ogg_crc(std::span<const uint8_t> page) {
+  static const auto table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t r = i << 24;
+      for (int j = 0; j < 8; ++j) {
+        r = (r & 0x80000000u) ? (r << 1) ^ 0x04c11db7u : r << 1;
+      }
+      t[i] = r;
+    }
+    return t;
+  }();
+  uint32_t crc = 0;
+  for (std::size_t i = 0; i < page.size(); ++i) {
+    // The CRC field itself (bytes 22..25) counts as zero.
+    const uint8_t b = (i >= 22 && i < 26) ? 0 : page[i];
+    crc = (crc << 8) ^ table[(crc >> 24) ^ b];
+  }
+  return crc;
+}
+
+uint32_t le32(const uint8_t* p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | uint32_t{p[3]} << 24;
+}
+
+}  // namespace
+
+std::optional<DecodedOpusClip> parse_ogg_opus(std::span<const uint8_t> bytes) {
+  DecodedOpusClip clip;
+  std::vector<uint8_t> packet;
+  bool have_serial = false;
+  uint32_t serial = 0;
+  int header_packets = 0;
+  std::size_t pos = 0;
+  while (pos < bytes.size()) {
+    if (bytes.size() - pos < 27 || std::memcmp(&bytes[pos], "OggS", 4) != 0 ||
+        bytes[pos + 4] != 0) {
+      return std::nullopt;
+    }
+    const uint8_t* h = &bytes[pos];
+    const std::size_t segments = h[26];
+    if (bytes.size() - pos < 27 + segments) return std::nullopt;
+    std::size_t body = 0;
+    for (std::size_t i = 0; i < segments; ++i) body += h[27 + i];
+    const std::size_t page_size = 27 + segments + body;
+    if (bytes.size() - pos < page_size) return std::nullopt;
+    if (ogg_crc(bytes.subspan(pos, page_size)) != le32(h + 22)) {
+      return std::nullopt;
+    }
+    const uint32_t page_serial = le32(h + 14);
+    if (!have_serial) {
+      have_serial = true;
+      serial = page_serial;
+    }
+    if (page_serial == serial) {
+      const uint8_t* data = h + 27 + segments;
+      for (std::size_t i = 0; i < segments; ++i) {
+        const uint8_t lace = h[27 + i];
+        packet.insert(packet.end(), data, data + lace);
+        data += lace;
+        if (lace == 255) continue;  // packet continues
+        if (header_packets == 0) {
+          if (packet.size() < 19 ||
+              std::memcmp(packet.data(), "OpusHead", 8) != 0) {
+            return std::nullopt;
+          }
+          clip.channels = packet[9];
+          clip.pre_skip = packet[10] | packet[11] << 8;
+          clip.input_sample_rate = static_cast<int>(le32(&packet[12]));
+          ++header_packets;
+        } else if (header_packets == 1) {
+          if (packet.size() < 8 ||
+              std::memcmp(packet.data(), "OpusTags", 8) != 0) {
+            return std::nullopt;
+          }
+          ++header_packets;
+        } else {
+          clip.packets.push_back(std::move(packet));
+        }
+        packet.clear();
+      }
+    }
+    pos += page_size;
+  }
+  if (header_packets < 2) return std::nullopt;
+  return clip;
+}
+
+}  // namespace xiaozi
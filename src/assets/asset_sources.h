@@ -0,0 +1,65 @@
+#ifndef XIAOZI_ASSETS_ASSET_SOURCES_H_
+#define XIAOZI_ASSETS_ASSET_SOURCES_H_
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace xiaozi {
+
+// Decoders for the source formats an asset pack is built from. They run
+// offline in xiaozi_assetpack (and in the boot-time baseline of
+// bench_assets.cc); the device only ever sees their output, laid out by
+// AssetPackWriter. All return nullopt on malformed input.
+
+struct DecodedGlyph {
+  uint32_t codepoint;
+  uint8_t width;
+  uint8_t height;
+  int8_t x_offset;
+  int8_t y_offset;
+  uint8_t advance;
+  // 1 bpp, MSB first, rows padded to whole bytes.
+  std::vector<uint8_t> bitmap;
+};
+
+struct DecodedFont {
+  uint16_t line_height = 0;
+  int16_t ascent = 0;
+  std::vector<DecodedGlyph> glyphs;  // in file order
+};
+
+// Glyph Bitmap Distribution Format (BDF 2.1), the usual output of bitmap
+// font converters. Glyphs without an encoding are skipped.
+std::optional<DecodedFont> parse_bdf(std::string_view text);
+
+struct DecodedImage {
+  uint16_t width = 0;
+  uint16_t height = 0;
+  std::vector<uint16_t> rgb565;  // width * height
+  std::vector<uint8_t> alpha;    // empty for opaque images
+};
+
+// Binary netpbm: P6 (RGB) or P7 with TUPLTYPE RGB or RGB_ALPHA, 8 bits
+// per channel.
+std::optional<DecodedImage> parse_pnm(std::span<const uint8_t> bytes);
+
+struct DecodedOpusClip {
+  int channels = 0;
+  int pre_skip = 0;
+  int input_sample_rate = 0;
+  std::vector<std::vector<uint8_t>> packets;
+};
+
+// Ogg Opus (RFC 7845), one logical stream; page CRCs are checked.
+std::optional<DecodedOpusClip> parse_ogg_opus(std::span<const uint8_t> bytes);
+
+inline uint16_t to_rgb565(uint8_t r, uint8_t g, uint8_t b) {
+  return static_cast<uint16_t>((r >> 3) << 11 | (g >> 2) << 5 | b >> 3);
+}
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_ASSETS_ASSET_SOURCES_H_
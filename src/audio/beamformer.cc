@@ -0,0 +1,328 @@
+#include "audio/beamformer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace xiaozi {
+namespace {
+
+constexpr double kTwoPi = 6.28318530717958647692;
+
+bool valid(const Beamformer::Config& config) {
+  if (config.array.count < 1 || config.array.count > kMaxMics ||
+      config.sample_rate < 100 || config.sample_rate % 100 != 0) {
+    return false;
+  }
+  for (std::size_t m = 0; m < config.array.count; ++m) {
+    if (config.array.mics[m].slot < 0) return false;
+  }
+  return true;
+}
+
+// Positions about the array's centroid, so steering delays stay within
+// the padding whatever origin the board used.
+MicArray centered(MicArray array) {
+  if (array.count == 0) return array;
+  float cx = 0, cy = 0;
+  for (std::size_t m = 0; m < array.count; ++m) {
+    cx += array.mics[m].x;
+    cy += array.mics[m].y;
+  }
+  cx /= static_cast<float>(array.count);
+  cy /= static_cast<float>(array.count);
+  for (std::size_t m = 0; m < array.count; ++m) {
+    array.mics[m].x -= cx;
+    array.mics[m].y -= cy;
+  }
+  return array;
+}
+
+// The 20 ms window plus room on both sides for the largest steering delay
+// (the aperture), rounded up to a power of two.
+std::size_t fft_size_for(const Beamformer::Config& config, std::size_t hop) {
+  float aperture = 0;
+  for (std::size_t i = 0; i < config.array.count && i < kMaxMics; ++i) {
+    for (std::size_t j = i + 1; j < config.array.count; ++j) {
+      aperture = std::max(aperture, std::hypot(config.array.mics[i].x -
+                                                   config.array.mics[j].x,
+                                               config.array.mics[i].y -
+                                                   config.array.mics[j].y));
+    }
+  }
+  const auto pad = static_cast<std::size_t>(
+      std::ceil(aperture / kSpeedOfSound * config.sample_rate));
+  return std::bit_ceil(std::max<std::size_t>(2 * hop + 2 * pad, 4));
+}
+
+template <typename Word>
+float to_float(Word w) {
+  if constexpr (sizeof(Word) == 4) {
+    return static_cast<float>(w) * (1.0f / 65536.0f);
+  } else {
+    return static_cast<float>(w);
+  }
+}
+
+float plane_delay_s(const MicArray::Mic& mic, float azimuth) {
+  return -(mic.x * std::cos(azimuth) + mic.y * std::sin(azimuth)) /
+         kSpeedOfSound;
+}
+
+}  // namespace
+
+Beamformer::Beamformer(Config config)
+    : config_(config),
+      ok_(valid(config)),
+      mics_(ok_ ? config.array.count : 1),
+      hop_(ok_ ? static_cast<std::size_t>(config.sample_rate) / 100 : 160),
+      fft_size_(fft_size_for(config, hop_)),
+      bins_(fft_size_ / 2 + 1),
+      fft_(fft_size_),
+      window_(2 * hop_),
+      history_(mics_ * hop_),
+      time_(fft_size_),
+      spectra_(mics_ * bins_),
+      beam_(bins_),
+      overlap_(hop_),
+      steer_re_(mics_ * bins_),
+      steer_im_(mics_ * bins_),
+      weight_re_(mics_ * bins_),
+      weight_im_(mics_ * bins_),
+      cov_re_(config.mode == Mode::kMvdr ? mics_ * (mics_ + 1) / 2 * bins_
+                                         : 0),
+      cov_im_(cov_re_.size()) {
+  config_.array = centered(config.array);
+  config_.weight_update_hops =
+      std::max<std::size_t>(config_.weight_update_hops, 1);
+  // Periodic sqrt-Hann: analysis times synthesis is a Hann window, whose
+  // copies a hop apart sum to one.
+  for (std::size_t i = 0; i < window_.size(); ++i) {
+    window_[i] = static_cast<float>(
+        std::sqrt(0.5 - 0.5 * std::cos(kTwoPi * static_cast<double>(i) /
+                                       static_cast<double>(window_.size()))));
+  }
+  reset();
+}
+
+void Beamformer::reset() {
+  std::fill(history_.begin(), history_.end(), 0.0f);
+  std::fill(overlap_.begin(), overlap_.end(), 0.0f);
+  std::fill(cov_re_.begin(), cov_re_.end(), 0.0f);
+  std::fill(cov_im_.begin(), cov_im_.end(), 0.0f);
+  next_solve_ = 0;
+  primed_ = false;
+  steer(config_.azimuth);
+  hops_ = 0;
+  steering_changes_ = 0;
+  if (config_.doa != nullptr && ok_) {
+    config_.doa->start(config_.array, config_.sample_rate, fft_size_);
+  }
+}
+
+void Beamformer::steer(float azimuth) {
+  azimuth_ = azimuth;
+  ++steering_changes_;
+  const double bin_hz =
+      static_cast<double>(config_.sample_rate) / static_cast<double>(fft_size_);
+  const auto share = static_cast<float>(1.0 / static_cast<double>(mics_));
+  for (std::size_t m = 0; m < mics_; ++m) {
+    const double tau = ok_ ? plane_delay_s(config_.array.mics[m], azimuth) : 0;
+    for (std::size_t k = 0; k < bins_; ++k) {
+      // exp(-j w tau): what the plane wave does to mic m.
+      const double phase = -kTwoPi * bin_hz * static_cast<double>(k) * tau;
+      const std::size_t at = m * bins_ + k;
+      steer_re_[at] = static_cast<float>(std::cos(phase));
+      steer_im_[at] = static_cast<float>(std::sin(phase));
+      weight_re_[at] = steer_re_[at] * share;
+      weight_im_[at] = steer_im_[at] * share;
+    }
+  }
+  next_solve_ = 0;
+}
+
+Beamformer::Stats Beamformer::stats() const {
+  return {hops_, steering_changes_, azimuth_};
+}
+
+template <typename Word>
+bool Beamformer::process(std::span<const Word> dma, std::size_t slots,
+                         std::span<int16_t> out) {
+  if (!ok_ || slots == 0 || dma.size() % slots != 0) return false;
+  const std::size_t frames = dma.size() / slots;
+  if (frames % hop_ != 0 || out.size() != frames) return false;
+  for (std::size_t m = 0; m < mics_; ++m) {
+    if (static_cast<std::size_t>(config_.array.mics[m].slot) >= slots) {
+      return false;
+    }
+  }
+  for (std::size_t f = 0; f < frames; f += hop_) {
+    analyze(dma.data() + f * slots, slots);
+    if (config_.doa != nullptr) {
+      ArraySpectra spectra{};
+      for (std::size_t m = 0; m < mics_; ++m) {
+        spectra[m] = {spectra_.data() + m * bins_, bins_};
+      }
+      const float azimuth = config_.doa->update(spectra);
+      if (!std::isnan(azimuth) && azimuth != azimuth_) steer(azimuth);
+    }
+    if (config_.mode == Mode::kMvdr) adapt();
+
+    std::fill(beam_.begin(), beam_.end(), std::complex<float>());
+    for (std::size_t m = 0; m < mics_; ++m) {
+      const float* wr = weight_re_.data() + m * bins_;
+      const float* wi = weight_im_.data() + m * bins_;
+      const std::complex<float>* x = spectra_.data() + m * bins_;
+      for (std::size_t k = 0; k < bins_; ++k) {
+        const float xr = x[k].real();
+        const float xi = x[k].imag();
+        beam_[k] = {beam_[k].real() + wr[k] * xr + wi[k] * xi,
+                    beam_[k].imag() + wr[k] * xi - wi[k] * xr};
+      }
+    }
+    synthesize(out.data() + f);
+    ++hops_;
+  }
+  return true;
+}
+
+template <typename Word>
+void Beamformer::analyze(const Word* dma, std::size_t slots) {
+  const float* w = window_.data();
+  for (std::size_t m = 0; m < mics_; ++m) {
+    const auto slot = static_cast<std::size_t>(config_.array.mics[m].slot);
+    float* hist = history_.data() + m * hop_;
+    for (std::size_t i = 0; i < hop_; ++i) time_[i] = hist[i] * w[i];
+    // The strided read is the window pass itself: no per-mic copy first.
+    for (std::size_t i = 0; i < hop_; ++i) {
+      const float s = to_float(dma[i * slots + slot]);
+      time_[hop_ + i] = s * w[hop_ + i];
+      hist[i] = s;
+    }
+    std::fill(time_.begin() + 2 * hop_, time_.end(), 0.0f);
+    fft_.forward(time_, {spectra_.data() + m * bins_, bins_});
+  }
+}
+
+void Beamformer::adapt() {
+  const float a = primed_ ? config_.covariance_smoothing : 0.0f;
+  const float b = 1.0f - a;
+  std::size_t pair = 0;
+  for (std::size_t i = 0; i < mics_; ++i) {
+    for (std::size_t j = i; j < mics_; ++j, ++pair) {
+      const std::complex<float>* xi = spectra_.data() + i * bins_;
+      const std::complex<float>* xj = spectra_.data() + j * bins_;
+      float* re = cov_re_.data() + pair * bins_;
+      float* im = cov_im_.data() + pair * bins_;
+      for (std::size_t k = 0; k < bins_; ++k) {
+        // x_i conj(x_j)
+        const float r = xi[k].real() * xj[k].real() +
+                        xi[k].imag() * xj[k].imag();
+        const float q = xi[k].imag() * xj[k].real() -
+                        xi[k].real() * xj[k].imag();
+        re[k] = a * re[k] + b * r;
+        im[k] = a * im[k] + b * q;
+      }
+    }
+  }
+  primed_ = true;
+
+  const std::size_t slice =
+      (bins_ + config_.weight_update_hops - 1) / config_.weight_update_hops;
+  const std::size_t end = std::min(bins_, next_solve_ + slice);
+  for (std::size_t k = next_solve_; k < end; ++k) solve_bin(k);
+  next_solve_ = end == bins_ ? 0 : end;
+}
+
+// w = R^-1 d / (d^H R^-1 d) for one bin, through a Cholesky factor of the
+// loaded covariance. A bin without energy keeps delay-and-sum weights.
+void Beamformer::solve_bin(std::size_t k) {
+  using C = std::complex<float>;
+  C r[kMaxMics][kMaxMics];
+  float trace = 0;
+  std::size_t pair = 0;
+  for (std::size_t i = 0; i < mics_; ++i) {
+    for (std::size_t j = i; j < mics_; ++j, ++pair) {
+      r[i][j] = {cov_re_[pair * bins_ + k], cov_im_[pair * bins_ + k]};
+      r[j][i] = std::conj(r[i][j]);
+    }
+    trace += r[i][i].real();
+  }
+  const float share = 1.0f / static_cast<float>(mics_);
+  auto delay_and_sum = [&] {
+    for (std::size_t m = 0; m < mics_; ++m) {
+      weight_re_[m * bins_ + k] = steer_re_[m * bins_ + k] * share;
+      weight_im_[m * bins_ + k] = steer_im_[m * bins_ + k] * share;
+    }
+  };
+  if (!(trace > 1e-3f)) {
+    delay_and_sum();
+    return;
+  }
+  const float load = config_.diagonal_loading * trace * share + 1e-6f * trace;
+  for (std::size_t i = 0; i < mics_; ++i) r[i][i] += load;
+
+  C l[kMaxMics][kMaxMics] = {};
+  for (std::size_t j = 0; j < mics_; ++j) {
+    float diag = r[j][j].real();
+    for (std::size_t p = 0; p < j; ++p) diag -= std::norm(l[j][p]);
+    if (!(diag > 0)) {
+      delay_and_sum();
+      return;
+    }
+    l[j][j] = std::sqrt(diag);
+    for (std::size_t i = j + 1; i < mics_; ++i) {
+      C sum = r[i][j];
+      for (std::size_t p = 0; p < j; ++p) sum -= l[i][p] * std::conj(l[j][p]);
+      l[i][j] = sum / l[j][j].real();
+    }
+  }
+  C d[kMaxMics];
+  C y[kMaxMics];
+  C x[kMaxMics];
+  for (std::size_t m = 0; m < mics_; ++m) {
+    d[m] = {steer_re_[m * bins_ + k], steer_im_[m * bins_ + k]};
+  }
+  for (std::size_t i = 0; i < mics_; ++i) {
+    C sum = d[i];
+    for (std::size_t p = 0; p < i; ++p) sum -= l[i][p] * y[p];
+    y[i] = sum / l[i][i].real();
+  }
+  for (std::size_t i = mics_; i-- > 0;) {
+    C sum = y[i];
+    for (std::size_t p = i + 1; p < mics_; ++p) {
+      sum -= std::conj(l[p][i]) * x[p];
+    }
+    x[i] = sum / l[i][i].real();
+  }
+  float gain = 0;  // d^H R^-1 d, real for Hermitian R
+  for (std::size_t m = 0; m < mics_; ++m) {
+    gain += (std::conj(d[m]) * x[m]).real();
+  }
+  if (!(gain > 0)) {
+    delay_and_sum();
+    return;
+  }
+  for (std::size_t m = 0; m < mics_; ++m) {
+    weight_re_[m * bins_ + k] = x[m].real() / gain;
+    weight_im_[m * bins_ + k] = x[m].imag() / gain;
+  }
+}
+
+void Beamformer::synthesize(int16_t* out) {
+  fft_.inverse(beam_, time_);
+  const float* w = window_.data();
+  for (std::size_t i = 0; i < hop_; ++i) {
+    const float y = overlap_[i] + time_[i] * w[i];
+    overlap_[i] = time_[hop_ + i] * w[hop_ + i];
+    out[i] = static_cast<int16_t>(
+        std::clamp(std::lrint(y), long{-32768}, long{32767}));
+  }
+}
+
+template bool Beamformer::process<int16_t>(std::span<const int16_t>,
+                                           std::size_t, std::span<int16_t>);
+template bool Beamformer::process<int32_t>(std::span<const int32_t>,
+                                           std::size_t, std::span<int16_t>);
+
+}  // namespace xiaozi
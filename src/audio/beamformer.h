@@ -0,0 +1,117 @@
+#ifndef XIAOZI_AUDIO_BEAMFORMER_H_
+#define XIAOZI_AUDIO_BEAMFORMER_H_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "audio/doa_estimator.h"
+#include "audio/fft.h"
+
+namespace xiaozi {
+
+// Combines the mics of a 2-4 mic array into one channel steered at the
+// talker, ahead of the mono capture path on far-field boards. It reads its
+// mics' slots straight out of the interleaved I2S DMA words, at the bus
+// rate, so nothing is deinterleaved into per-mic buffers first.
+//
+// Weighted overlap-add STFT: 10 ms hops, a 20 ms sqrt-Hann window zero
+// padded to a power-of-two RealFft, and one complex weight per mic and
+// bin. kDelayAndSum aligns the mics on the steering direction and
+// averages them. kMvdr tracks each bin's spatial covariance and keeps the
+// steering direction undistorted while minimizing everything else, which
+// nulls a loud interferer (a TV, the speaker's own echo) that delay and
+// sum only attenuates; its weights are re-solved a slice of bins per hop,
+// so a full update is spread over weight_update_hops hops. The steering
+// direction is Config::azimuth until a DoaEstimator reports another.
+//
+// The output lags the input by one hop. Nothing allocates after the
+// constructor, and a hop's work is bounded, so it runs on the realtime
+// capture lane. Not thread-safe; owned by the capture thread.
+class Beamformer {
+ public:
+  enum class Mode : uint8_t { kDelayAndSum, kMvdr };
+
+  struct Config {
+    int sample_rate = 16000;  // of the bus; a multiple of 100
+    MicArray array;
+    Mode mode = Mode::kDelayAndSum;
+    float azimuth = 0.0f;  // initial steering, radians
+    // Not owned; must outlive the beamformer. nullptr: fixed steering.
+    DoaEstimator* doa = nullptr;
+    // MVDR only.
+    float covariance_smoothing = 0.98f;  // per hop
+    float diagonal_loading = 0.01f;      // share of the covariance trace
+    std::size_t weight_update_hops = 4;
+  };
+
+  struct Stats {
+    uint64_t hops;
+    uint64_t steering_changes;
+    float azimuth;
+  };
+
+  explicit Beamformer(Config config);
+
+  // False unless the array has 1 to kMaxMics mics and the rate is a
+  // multiple of 100 Hz; process() then always fails.
+  bool ok() const { return ok_; }
+  // Bus frames per hop.
+  std::size_t hop() const { return hop_; }
+
+  // `dma` holds whole bus frames of `slots` interleaved words (int16_t or
+  // left-justified int32_t, as I2sWord); their count must be a whole
+  // number of hop(). Writes one sample per frame to `out`, which must be
+  // as long. Returns false, writing nothing, for any other shape.
+  template <typename Word>
+  bool process(std::span<const Word> dma, std::size_t slots,
+               std::span<int16_t> out);
+
+  // Steers to `azimuth` now; a DoaEstimator may steer elsewhere later.
+  void steer(float azimuth);
+  void reset();
+  Stats stats() const;
+
+ private:
+  template <typename Word>
+  void analyze(const Word* dma, std::size_t slots);
+  void adapt();
+  void solve_bin(std::size_t k);
+  void synthesize(int16_t* out);
+
+  Config config_;
+  bool ok_;
+  std::size_t mics_;
+  std::size_t hop_;
+  std::size_t fft_size_;
+  std::size_t bins_;
+  RealFft fft_;
+  std::vector<float> window_;   // 2 * hop_ sqrt-Hann
+  std::vector<float> history_;  // last hop of each mic, mic-major
+  std::vector<float> time_;     // fft_size_ scratch
+  std::vector<std::complex<float>> spectra_;  // bins_ per mic, mic-major
+  std::vector<std::complex<float>> beam_;
+  std::vector<float> overlap_;  // second half of the last synthesis
+  // Steering vectors and the applied weights, mic-major, real and
+  // imaginary parts apart so the per-bin loops vectorize; the output is
+  // sum over mics of conj(w) x.
+  std::vector<float> steer_re_;
+  std::vector<float> steer_im_;
+  std::vector<float> weight_re_;
+  std::vector<float> weight_im_;
+  // MVDR: upper triangle of each bin's covariance, pair-major.
+  std::vector<float> cov_re_;
+  std::vector<float> cov_im_;
+  std::size_t next_solve_ = 0;
+  bool primed_ = false;  // covariance has a hop in it
+
+  float azimuth_ = 0.0f;
+  uint64_t hops_ = 0;
+  uint64_t steering_changes_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_BEAMFORMER_H_
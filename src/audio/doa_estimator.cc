@@ -0,0 +1,128 @@
+#include "audio/doa_estimator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace xiaozi {
+namespace {
+
+constexpr float kTwoPi = 6.28318530717958647f;
+// The energy floor creeps up by this per hop, so it follows a room that
+// gets louder (about 10 dB in 5 s at 10 ms hops).
+constexpr float kFloorRise = 1.005f;
+
+// Plane-wave arrival delay at `mic`, relative to the origin.
+float delay_s(const MicArray::Mic& mic, float azimuth) {
+  return -(mic.x * std::cos(azimuth) + mic.y * std::sin(azimuth)) /
+         kSpeedOfSound;
+}
+
+}  // namespace
+
+SrpPhatDoa::SrpPhatDoa(Config config) : config_(config) {
+  config_.directions = std::max<std::size_t>(config_.directions, 1);
+  config_.sweep_hops = std::max<std::size_t>(config_.sweep_hops, 1);
+}
+
+void SrpPhatDoa::start(const MicArray& array, int sample_rate,
+                       std::size_t fft_size) {
+  array_ = array;
+  bin_hz_ = static_cast<float>(sample_rate) / static_cast<float>(fft_size);
+  const std::size_t bins = fft_size / 2 + 1;
+  first_bin_ = std::min(
+      bins, static_cast<std::size_t>(std::ceil(config_.min_hz / bin_hz_)));
+  last_bin_ = std::clamp(
+      static_cast<std::size_t>(config_.max_hz / bin_hz_) + 1, first_bin_,
+      bins);
+  pairs_ = 0;
+  for (std::size_t i = 0; i < array_.count; ++i) {
+    for (std::size_t j = i + 1; j < array_.count; ++j) {
+      pair_mics_[pairs_++] = {i, j};
+    }
+  }
+  cross_.assign(pairs_ * (last_bin_ - first_bin_), {});
+  sweep_.assign(config_.directions, 0.0f);
+  response_.assign(config_.directions, 0.0f);
+  next_direction_ = 0;
+  heard_ = false;
+  floor_ = 0;
+}
+
+float SrpPhatDoa::update(const ArraySpectra& spectra) {
+  constexpr float kKeep = std::numeric_limits<float>::quiet_NaN();
+  if (pairs_ == 0) return kKeep;
+  const std::size_t band = last_bin_ - first_bin_;
+
+  float energy = 0;
+  for (std::size_t k = first_bin_; k < last_bin_; ++k) {
+    energy += std::norm(spectra[0][k]);
+  }
+  const bool active = floor_ > 0 && energy > floor_ * config_.activity_ratio;
+  floor_ = floor_ == 0 || energy < floor_ ? energy : floor_ * kFloorRise;
+
+  if (active) {
+    heard_ = true;
+    const float a = config_.smoothing;
+    for (std::size_t p = 0; p < pairs_; ++p) {
+      const std::complex<float>* xi = spectra[pair_mics_[p][0]].data();
+      const std::complex<float>* xj = spectra[pair_mics_[p][1]].data();
+      std::complex<float>* c = cross_.data() + p * band;
+      for (std::size_t k = 0; k < band; ++k) {
+        const std::complex<float> u = xi[first_bin_ + k];
+        const std::complex<float> v = xj[first_bin_ + k];
+        // u * conj(v), then onto the unit circle.
+        const float re = u.real() * v.real() + u.imag() * v.imag();
+        const float im = u.imag() * v.real() - u.real() * v.imag();
+        const float mag = std::sqrt(re * re + im * im) + 1e-20f;
+        c[k] = {a * c[k].real() + (1 - a) * re / mag,
+                a * c[k].imag() + (1 - a) * im / mag};
+      }
+    }
+  }
+
+  const std::size_t slice =
+      (config_.directions + config_.sweep_hops - 1) / config_.sweep_hops;
+  const std::size_t end =
+      std::min(config_.directions, next_direction_ + slice);
+  for (std::size_t d = next_direction_; d < end; ++d) {
+    sweep_[d] = steered_power(kTwoPi * static_cast<float>(d) /
+                              static_cast<float>(config_.directions));
+  }
+  next_direction_ = end;
+  if (next_direction_ < config_.directions) return kKeep;
+
+  next_direction_ = 0;
+  response_.swap(sweep_);
+  if (!heard_) return kKeep;
+  heard_ = false;
+  const auto best = std::max_element(response_.begin(), response_.end()) -
+                    response_.begin();
+  return kTwoPi * static_cast<float>(best) /
+         static_cast<float>(config_.directions);
+}
+
+float SrpPhatDoa::steered_power(float azimuth) const {
+  const std::size_t band = last_bin_ - first_bin_;
+  float power = 0;
+  for (std::size_t p = 0; p < pairs_; ++p) {
+    const float tdoa = delay_s(array_.mics[pair_mics_[p][0]], azimuth) -
+                       delay_s(array_.mics[pair_mics_[p][1]], azimuth);
+    // exp(j w tdoa) bin by bin, as a rotation from the first bin.
+    const float w0 = kTwoPi * bin_hz_ * tdoa;
+    float rot_re = std::cos(w0 * static_cast<float>(first_bin_));
+    float rot_im = std::sin(w0 * static_cast<float>(first_bin_));
+    const float step_re = std::cos(w0);
+    const float step_im = std::sin(w0);
+    const std::complex<float>* c = cross_.data() + p * band;
+    for (std::size_t k = 0; k < band; ++k) {
+      power += c[k].real() * rot_re - c[k].imag() * rot_im;
+      const float re = rot_re * step_re - rot_im * step_im;
+      rot_im = rot_re * step_im + rot_im * step_re;
+      rot_re = re;
+    }
+  }
+  return power;
+}
+
+}  // namespace xiaozi
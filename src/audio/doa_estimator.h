@@ -0,0 +1,102 @@
+#ifndef XIAOZI_AUDIO_DOA_ESTIMATOR_H_
+#define XIAOZI_AUDIO_DOA_ESTIMATOR_H_
+
+#include <array>
+#include <complex>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace xiaozi {
+
+inline constexpr std::size_t kMaxMics = 4;
+inline constexpr float kSpeedOfSound = 343.0f;  // m/s
+
+// A planar mic array: where each mic sits, in metres from any origin in
+// the board's plane, and the TDM slot it arrives on. Directions are
+// azimuths in radians, counter-clockwise from +x; sound from a direction
+// is taken to arrive as a plane wave.
+struct MicArray {
+  struct Mic {
+    int slot = 0;
+    float x = 0;
+    float y = 0;
+  };
+  std::size_t count = 0;
+  std::array<Mic, kMaxMics> mics{};
+};
+
+// One hop of array audio in the frequency domain, as Beamformer hands it
+// to its estimator: fft_size / 2 + 1 bins per mic, DC to Nyquist, mics in
+// MicArray order.
+using ArraySpectra =
+    std::array<std::span<const std::complex<float>>, kMaxMics>;
+
+// Direction-of-arrival estimation behind Beamformer: where to steer.
+// update() runs on the capture thread once per hop, so an implementation
+// keeps its per-hop work short and bounded and does not allocate there.
+class DoaEstimator {
+ public:
+  virtual ~DoaEstimator() = default;
+
+  // Called by Beamformer's constructor and reset(), before any update();
+  // forgets what was heard. May allocate.
+  virtual void start(const MicArray& array, int sample_rate,
+                     std::size_t fft_size) = 0;
+  // The direction to steer to, or NaN to keep the current one.
+  virtual float update(const ArraySpectra& spectra) = 0;
+};
+
+// SRP-PHAT: the steered response power of the phase-transformed pair
+// cross-spectra over a grid of `directions` azimuths, in the speech band.
+// The cross-spectra are smoothed over hops in which the band energy stands
+// out from its tracked floor (speech, not room noise); the grid is swept a
+// slice per hop, so a full scan's cost is spread over `sweep_hops` hops,
+// and each full sweep that saw speech reports its strongest direction.
+//
+// A linear array cannot tell front from back; its estimates fall in
+// [0, pi] measured from the array axis.
+class SrpPhatDoa final : public DoaEstimator {
+ public:
+  struct Config {
+    std::size_t directions = 36;
+    float min_hz = 300.0f;
+    float max_hz = 3500.0f;
+    float smoothing = 0.9f;       // cross-spectrum memory per speech hop
+    float activity_ratio = 4.0f;  // band energy over its floor, 6 dB
+    std::size_t sweep_hops = 6;
+  };
+
+  explicit SrpPhatDoa(Config config);
+  SrpPhatDoa() : SrpPhatDoa(Config{}) {}
+
+  void start(const MicArray& array, int sample_rate,
+             std::size_t fft_size) override;
+  float update(const ArraySpectra& spectra) override;
+
+  // The response of the last full sweep, one value per direction.
+  std::span<const float> response() const { return response_; }
+
+ private:
+  float steered_power(float azimuth) const;
+
+  Config config_;
+  MicArray array_;
+  float bin_hz_ = 0;
+  std::size_t first_bin_ = 0;
+  std::size_t last_bin_ = 0;  // exclusive
+  std::size_t pairs_ = 0;
+  std::array<std::array<std::size_t, 2>, kMaxMics * (kMaxMics - 1) / 2>
+      pair_mics_{};
+  // Smoothed PHAT cross-spectra, pair-major over the band's bins.
+  std::vector<std::complex<float>> cross_;
+  std::vector<float> sweep_;     // response of the sweep in progress
+  std::vector<float> response_;  // of the last complete one
+  std::size_t next_direction_ = 0;
+  bool heard_ = false;  // speech since the sweep started
+  float floor_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_DOA_ESTIMATOR_H_
@@ -0,0 +1,193 @@
+#include "audio/echo_canceller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace xiaozi {
+namespace {
+
+constexpr std::size_t kFftSize = 2 * EchoCanceller::kBlock;
+constexpr std::size_t kBins = EchoCanceller::kBlock + 1;
+
+// Reference peaks below this are silence: nothing to learn from.
+constexpr float kFarEndFloor = 64.0f;
+// Adaptation stays off this long after the last double-talk detection
+// (200 ms at 16 kHz), through the gaps between a talker's syllables where
+// the detector drops out but the near end still leaks into the error.
+constexpr int kDoubleTalkHoldBlocks = 50;
+// Keeps the NLMS step bounded in bins where the reference has no energy.
+constexpr float kRegularization = 1e4f * kFftSize;
+// ERLE energies decay by this per block (about 1 s at 16 kHz).
+constexpr double kErleDecay = 0.996;
+// Same shape as EncoderStage's complexity control.
+constexpr float kLoadAlpha = 0.125f;
+constexpr int kRelaxAfterFrames = 50;
+
+inline std::complex<float> mul(std::complex<float> a, std::complex<float> b) {
+  return {a.real() * b.real() - a.imag() * b.imag(),
+          a.real() * b.imag() + a.imag() * b.real()};
+}
+
+}  // namespace
+
+EchoCanceller::EchoCanceller(Config config)
+    : config_(config),
+      partitions_(std::max<std::size_t>(
+          1, std::size_t{config.tail_ms} * config.sample_rate / 1000 /
+                 kBlock)),
+      fft_(kFftSize),
+      x_(partitions_, Spectrum(kBins)),
+      w_(partitions_, Spectrum(kBins)),
+      ref_peaks_(partitions_, 0.0f),
+      power_(kBins, 0.0f),
+      y_(kBins),
+      e_(kBins),
+      time_(kFftSize) {}
+
+void EchoCanceller::reset() {
+  for (Spectrum& s : x_) std::fill(s.begin(), s.end(), 0.0f);
+  for (Spectrum& s : w_) std::fill(s.begin(), s.end(), 0.0f);
+  std::fill(ref_peaks_.begin(), ref_peaks_.end(), 0.0f);
+  std::fill(power_.begin(), power_.end(), 0.0f);
+  std::fill(std::begin(prev_ref_), std::end(prev_ref_), 0.0f);
+  head_ = 0;
+  constrain_next_ = 0;
+  hold_blocks_ = 0;
+  mic_energy_ = out_energy_ = 0;
+}
+
+bool EchoCanceller::process(std::span<const int16_t> mic,
+                            std::span<const int16_t> ref,
+                            std::span<int16_t> out) {
+  if (mic.size() % kBlock != 0 || ref.size() != mic.size() ||
+      out.size() != mic.size()) {
+    return false;
+  }
+  const uint64_t start = clock_.now_ns();
+  for (std::size_t i = 0; i < mic.size(); i += kBlock) {
+    process_block(&mic[i], &ref[i], &out[i]);
+  }
+  govern(clock_.now_ns() - start, mic.size());
+  return true;
+}
+
+void EchoCanceller::process_block(const int16_t* mic, const int16_t* ref,
+                                  int16_t* out) {
+  // The newest reference window is the previous block plus this one; it
+  // replaces the oldest in the ring and in the per-bin power sum.
+  head_ = (head_ + partitions_ - 1) % partitions_;
+  Spectrum& x = x_[head_];
+  float ref_peak = 0.0f;
+  for (std::size_t i = 0; i < kBlock; ++i) {
+    const float r = ref[i];
+    time_[i] = prev_ref_[i];
+    time_[kBlock + i] = r;
+    prev_ref_[i] = r;
+    ref_peak = std::max(ref_peak, std::fabs(r));
+  }
+  for (std::size_t k = 0; k < kBins; ++k) power_[k] -= std::norm(x[k]);
+  fft_.forward(time_, x);
+  for (std::size_t k = 0; k < kBins; ++k) {
+    power_[k] = std::max(0.0f, power_[k] + std::norm(x[k]));
+  }
+  ref_peaks_[head_] = ref_peak;
+
+  std::fill(y_.begin(), y_.end(), 0.0f);
+  for (std::size_t p = 0; p < partitions_; ++p) {
+    const std::complex<float>* x = x_[(head_ + p) % partitions_].data();
+    const std::complex<float>* w = w_[p].data();
+    for (std::size_t k = 0; k < kBins; ++k) y_[k] += mul(w[k], x[k]);
+  }
+  fft_.inverse(y_, time_);
+
+  // Overlap-save: the second half is the echo estimate. The error
+  // replaces it in place and the first half is zeroed, ready for the
+  // update's transform.
+  float mic_peak = 0.0f;
+  double mic_energy = 0, out_energy = 0;
+  for (std::size_t i = 0; i < kBlock; ++i) {
+    const float d = mic[i];
+    const float e = d - time_[kBlock + i];
+    time_[i] = 0.0f;
+    time_[kBlock + i] = e;
+    out[i] = static_cast<int16_t>(
+        std::clamp(std::lrint(e), -32768l, 32767l));
+    mic_peak = std::max(mic_peak, std::fabs(d));
+    mic_energy += double{d} * d;
+    out_energy += double{e} * e;
+  }
+
+  ++blocks_;
+  const float far_peak =
+      *std::max_element(ref_peaks_.begin(), ref_peaks_.end());
+  if (far_peak < kFarEndFloor) return;
+  if (mic_peak > config_.double_talk_threshold * far_peak) {
+    hold_blocks_ = kDoubleTalkHoldBlocks;
+  }
+  if (hold_blocks_ > 0) {
+    --hold_blocks_;
+    ++double_talk_blocks_;
+    return;
+  }
+  mic_energy_ = kErleDecay * mic_energy_ + mic_energy;
+  out_energy_ = kErleDecay * out_energy_ + out_energy;
+  if (blocks_ % interval_ != 0) return;
+  fft_.forward(time_, e_);
+  adapt();
+}
+
+void EchoCanceller::adapt() {
+  // Normalized by the reference power over the whole tail, not just the
+  // newest block: a quiet block after a loud one must not blow up the
+  // update of the partitions still holding the loud one.
+  for (std::size_t k = 0; k < kBins; ++k) {
+    e_[k] *= config_.step / (power_[k] + kRegularization);
+  }
+  for (std::size_t p = 0; p < partitions_; ++p) {
+    const std::complex<float>* x = x_[(head_ + p) % partitions_].data();
+    std::complex<float>* w = w_[p].data();
+    for (std::size_t k = 0; k < kBins; ++k) {
+      w[k] += mul(std::conj(x[k]), e_[k]);
+    }
+  }
+  constrain(w_[constrain_next_]);
+  constrain_next_ = (constrain_next_ + 1) % partitions_;
+  ++adapted_blocks_;
+}
+
+void EchoCanceller::constrain(Spectrum& w) {
+  // A partition models kBlock taps; whatever the unconstrained update put
+  // into the other half would wrap around in the circular convolution.
+  fft_.inverse(w, time_);
+  std::fill(time_.begin() + kBlock, time_.end(), 0.0f);
+  fft_.forward(time_, w);
+}
+
+void EchoCanceller::govern(uint64_t ns, std::size_t samples) {
+  const double audio_ns = 1e9 * static_cast<double>(samples) /
+                          config_.sample_rate;
+  load_ += kLoadAlpha * (static_cast<float>(ns / audio_ns) - load_);
+  if (load_ > config_.cpu_budget && interval_ < kMaxAdaptInterval) {
+    interval_ *= 2;
+    calm_frames_ = 0;
+    load_ = config_.cpu_budget;
+  } else if (load_ < config_.cpu_budget / 2 && interval_ > 1) {
+    if (++calm_frames_ >= kRelaxAfterFrames) {
+      interval_ /= 2;
+      calm_frames_ = 0;
+    }
+  } else {
+    calm_frames_ = 0;
+  }
+}
+
+EchoCanceller::Stats EchoCanceller::stats() const {
+  const float erle =
+      out_energy_ > 0 && mic_energy_ > 0
+          ? static_cast<float>(10.0 * std::log10(mic_energy_ / out_energy_))
+          : 0.0f;
+  return {blocks_,    adapted_blocks_, double_talk_blocks_,
+          interval_, load_,           erle};
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,113 @@
+#ifndef XIAOZI_AUDIO_ECHO_CANCELLER_H_
+#define XIAOZI_AUDIO_ECHO_CANCELLER_H_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "audio/fft.h"
+#include "base/cycle_clock.h"
+
+namespace xiaozi {
+
+// Acoustic echo canceller for full-duplex (barge-in) operation: removes
+// the speaker signal, as picked up by the mic, from the capture stream
+// before VAD and wake word see it. It runs on the capture thread, between
+// CapturePath and VadGate::submit(), on PCM that is already sample-aligned
+// with its reference (CapturePath's loopback slot or EchoReference).
+//
+// The echo path is modelled by a partitioned-block frequency-domain
+// adaptive filter (overlap-save, as in Speex MDF): kBlock-sample blocks,
+// tail_ms / kBlock partitions, a per-bin normalized LMS update, with the
+// gradient constraint applied to one partition per block in rotation.
+// Adaptation pauses while the Geigel detector sees near-end speech, and
+// for 200 ms after, so a user talking over the reply does not pull the
+// filter off the echo path.
+//
+// The filter itself runs every block; the update, which is most of the
+// cost, runs every adapt_interval-th block. Like EncoderStage's
+// complexity, the interval doubles (up to kMaxAdaptInterval) when
+// processing takes more than cpu_budget of the audio time and halves again
+// once load stays below half of it, so the capture thread never misses
+// its deadline for the sake of convergence speed.
+//
+// Not thread-safe; owned by the capture thread.
+class EchoCanceller {
+ public:
+  static constexpr std::size_t kBlock = 64;  // 4 ms at 16 kHz
+  static constexpr int kMaxAdaptInterval = 8;
+
+  struct Config {
+    int sample_rate = 16000;
+    uint32_t tail_ms = 128;  // longest echo path covered
+    float step = 0.5f;       // NLMS step, (0, 1]
+    // Near-end speech when a mic peak exceeds this share of the largest
+    // reference peak within the tail; 0.5 assumes 6 dB of echo return
+    // loss.
+    float double_talk_threshold = 0.5f;
+    float cpu_budget = 0.2f;
+  };
+
+  struct Stats {
+    uint64_t blocks;
+    uint64_t adapted_blocks;
+    uint64_t double_talk_blocks;
+    int adapt_interval;
+    float load;     // smoothed processing time / audio time
+    float erle_db;  // echo return loss enhancement while the far end plays
+  };
+
+  explicit EchoCanceller(Config config);
+  EchoCanceller() : EchoCanceller(Config{}) {}
+
+  // `mic` and `ref` are equally long and a whole number of kBlock; the
+  // echo-free signal goes to `out`, which may alias `mic`. Returns false
+  // (and writes nothing) for any other length.
+  bool process(std::span<const int16_t> mic, std::span<const int16_t> ref,
+               std::span<int16_t> out);
+
+  void reset();
+  Stats stats() const;
+
+ private:
+  using Spectrum = std::vector<std::complex<float>>;
+
+  void process_block(const int16_t* mic, const int16_t* ref, int16_t* out);
+  void adapt();
+  void constrain(Spectrum& w);
+  void govern(uint64_t ns, std::size_t samples);
+
+  Config config_;
+  std::size_t partitions_;
+  RealFft fft_;
+  CycleClock clock_;
+
+  // Reference spectra of the last `partitions_` blocks, newest at head_.
+  std::vector<Spectrum> x_;
+  std::vector<Spectrum> w_;
+  std::vector<float> ref_peaks_;  // per block, same ring as x_
+  std::size_t head_ = 0;
+  std::vector<float> power_;      // |X|^2 per bin, summed over x_
+  Spectrum y_;
+  Spectrum e_;
+  std::vector<float> time_;       // 2 * kBlock scratch
+  float prev_ref_[kBlock] = {};
+  std::size_t constrain_next_ = 0;
+
+  int interval_ = 1;
+  int calm_frames_ = 0;
+  float load_ = 0.0f;
+  double mic_energy_ = 0;
+  double out_energy_ = 0;
+  uint64_t blocks_ = 0;
+  uint64_t adapted_blocks_ = 0;
+  uint64_t double_talk_blocks_ = 0;
+  // Blocks left before adaptation resumes after double talk.
+  int hold_blocks_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_ECHO_CANCELLER_H_
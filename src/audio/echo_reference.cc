@@ -0,0 +1,57 @@
+#include "audio/echo_reference.h"
+
+#include <algorithm>
+#include <array>
+
+namespace xiaozi {
+
+EchoReference::EchoReference(std::size_t delay_samples) {
+  const std::array<int16_t, 256> silence{};
+  delay_samples = std::min(delay_samples, kCapacity / 2);
+  while (delay_samples > 0) {
+    const std::size_t n = std::min(delay_samples, silence.size());
+    ring_.push_n(std::span(silence).first(n));
+    delay_samples -= n;
+  }
+}
+
+void EchoReference::write(std::span<const int16_t> played) {
+  const std::size_t n = ring_.push_n(played);
+  if (n < played.size()) {
+    dropped_.fetch_add(played.size() - n, std::memory_order_release);
+  }
+}
+
+void EchoReference::read(std::span<int16_t> out) {
+  // Dropped samples would have been next in line; stand in for them first.
+  const uint64_t dropped = dropped_.load(std::memory_order_acquire);
+  std::size_t pad = static_cast<std::size_t>(dropped - dropped_seen_);
+  while (owed_ > 0) {
+    // Samples zero-filled earlier have arrived since: discard them.
+    std::array<int16_t, 256> discard;
+    const std::size_t n = ring_.pop_n(
+        std::span(discard).first(std::min<uint64_t>(owed_, discard.size())));
+    if (n == 0) break;
+    owed_ -= n;
+  }
+  std::size_t done = 0;
+  if (owed_ == 0) {
+    const std::size_t silence = std::min(pad, out.size());
+    std::fill_n(out.begin(), silence, int16_t{0});
+    pad -= silence;
+    done = silence + ring_.pop_n(out.subspan(silence));
+  }
+  dropped_seen_ = dropped - pad;
+  if (done < out.size()) {
+    std::fill(out.begin() + done, out.end(), int16_t{0});
+    owed_ += out.size() - done;
+    zero_filled_.fetch_add(out.size() - done, std::memory_order_relaxed);
+  }
+}
+
+EchoReference::Stats EchoReference::stats() const {
+  return {zero_filled_.load(std::memory_order_relaxed),
+          dropped_.load(std::memory_order_relaxed)};
+}
+
+}  // namespace xiaozi
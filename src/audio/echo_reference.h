@@ -0,0 +1,55 @@
+#ifndef XIAOZI_AUDIO_ECHO_REFERENCE_H_
+#define XIAOZI_AUDIO_ECHO_REFERENCE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "memory/spsc_ring.h"
+
+namespace xiaozi {
+
+// Software loopback for boards whose ADC has no reference slot: playback
+// writes every sample it queues for the DAC, silence included, and capture
+// reads one reference sample per mic sample. Both I2S directions run off
+// the same clock, so sample counts stay locked and alignment is a fixed
+// offset: `delay_samples` of silence are queued up front to match the
+// extra time a sample spends in the DAC's DMA queue before the mic can
+// hear it.
+//
+// A slip on either side is repaid rather than left as a permanent offset:
+// samples the capture side had to zero-fill because playback was late are
+// skipped once they arrive, and samples playback dropped because the ring
+// was full come out as silence in their place.
+//
+// write() runs on the playback thread, read() on the capture thread.
+class EchoReference {
+ public:
+  static constexpr std::size_t kCapacity = 8192;  // 512 ms at 16 kHz
+
+  struct Stats {
+    uint64_t zero_filled;  // read() found no reference yet
+    uint64_t dropped;      // write() found the ring full
+  };
+
+  explicit EchoReference(std::size_t delay_samples);
+
+  void write(std::span<const int16_t> played);
+  void read(std::span<int16_t> out);
+
+  Stats stats() const;
+
+ private:
+  SpscRing<int16_t, kCapacity> ring_;
+  std::atomic<uint64_t> dropped_{0};
+
+  // Capture thread.
+  uint64_t dropped_seen_ = 0;
+  uint64_t owed_ = 0;  // zero-filled samples still to skip
+  std::atomic<uint64_t> zero_filled_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_ECHO_REFERENCE_H_
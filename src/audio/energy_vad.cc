@@ -0,0 +1,24 @@
+#include "audio/energy_vad.h"
+
+#include <cmath>
+
+namespace xiaozi {
+
+bool EnergyVad::process(std::span<const int16_t> frame) {
+  if (frame.empty()) return false;
+  int64_t sum = 0;
+  for (int16_t s : frame) sum += int32_t{s} * s;
+  const double mean_square =
+      static_cast<double>(sum) / (static_cast<double>(frame.size()) * 32768.0 *
+                                  32768.0);
+  level_db_ = static_cast<float>(10.0 * std::log10(mean_square + 1e-12));
+  if (level_db_ < floor_db_) {
+    floor_db_ = level_db_;
+  } else {
+    floor_db_ += config_.floor_rise_db;
+  }
+  return level_db_ > config_.min_level_db &&
+         level_db_ > floor_db_ + config_.threshold_db;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,45 @@
+#ifndef XIAOZI_AUDIO_ENERGY_VAD_H_
+#define XIAOZI_AUDIO_ENERGY_VAD_H_
+
+#include <cstdint>
+#include <span>
+
+namespace xiaozi {
+
+// Frame-energy voice detector against a tracked noise floor: one integer
+// sum of squares and one log per frame. Good enough to keep heavier stages
+// (wake word, encoder) asleep in silence, not to segment speech.
+class EnergyVad {
+ public:
+  struct Config {
+    // Active when the frame is this far above the noise floor...
+    float threshold_db = 9.0f;
+    // ...and above this absolute level (dBFS), so a quiet room with a
+    // floor near digital silence does not trigger on every breath.
+    float min_level_db = -55.0f;
+    // Per-frame rise of the floor estimate toward louder frames; the floor
+    // follows quieter frames immediately.
+    float floor_rise_db = 0.02f;
+  };
+
+  explicit EnergyVad(Config config) : config_(config) {}
+  EnergyVad() : EnergyVad(Config{}) {}
+
+  // Any frame length; returns whether the frame is active.
+  bool process(std::span<const int16_t> frame);
+  void reset() { floor_db_ = kInitialFloorDb; }
+
+  float level_db() const { return level_db_; }
+  float noise_floor_db() const { return floor_db_; }
+
+ private:
+  static constexpr float kInitialFloorDb = -60.0f;
+
+  Config config_;
+  float level_db_ = -120.0f;
+  float floor_db_ = kInitialFloorDb;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_ENERGY_VAD_H_
@@ -0,0 +1,126 @@
+#include "audio/fft.h"
+
+#include <cassert>
+#include <cmath>
+#include <numbers>
+
+namespace xiaozi {
+namespace {
+
+// Plain product; operator* on std::complex goes through __mulsc3 for the
+// Annex G inf/nan rules unless built with -fcx-limited-range.
+inline std::complex<float> mul(std::complex<float> a, std::complex<float> b) {
+  return {a.real() * b.real() - a.imag() * b.imag(),
+          a.real() * b.imag() + a.imag() * b.real()};
+}
+
+}  // namespace
+
+RealFft::RealFft(std::size_t size)
+    : size_(size),
+      twiddle_re_(size / 2),
+      twiddle_im_(size / 2),
+      split_(size / 2),
+      bit_reverse_(size / 2),
+      re_(size / 2),
+      im_(size / 2) {
+  assert(size >= 4 && (size & (size - 1)) == 0);
+  const std::size_t half = size / 2;
+  for (std::size_t len = 2; len <= half; len <<= 1) {
+    for (std::size_t j = 0; j < len / 2; ++j) {
+      const double angle = -2.0 * std::numbers::pi * j / len;
+      twiddle_re_[len / 2 - 1 + j] = static_cast<float>(std::cos(angle));
+      twiddle_im_[len / 2 - 1 + j] = static_cast<float>(std::sin(angle));
+    }
+  }
+  for (std::size_t k = 0; k < half; ++k) {
+    split_[k] = std::polar(1.0f, static_cast<float>(-2.0 * std::numbers::pi *
+                                                    k / size));
+  }
+  std::size_t bits = 0;
+  while ((std::size_t{1} << bits) < half) ++bits;
+  for (std::size_t i = 0; i < half; ++i) {
+    uint32_t r = 0;
+    for (std::size_t b = 0; b < bits; ++b) {
+      if (i & (std::size_t{1} << b)) r |= 1u << (bits - 1 - b);
+    }
+    bit_reverse_[i] = r;
+  }
+}
+
+void RealFft::transform() {
+  const std::size_t half = size_ / 2;
+  float* __restrict re = re_.data();
+  float* __restrict im = im_.data();
+  for (std::size_t len = 2; len <= half; len <<= 1) {
+    const std::size_t m = len / 2;
+    const float* wr = &twiddle_re_[m - 1];
+    const float* wi = &twiddle_im_[m - 1];
+    for (std::size_t start = 0; start < half; start += len) {
+      float* ar = re + start;
+      float* ai = im + start;
+      float* br = ar + m;
+      float* bi = ai + m;
+      for (std::size_t j = 0; j < m; ++j) {
+        const float tr = wr[j] * br[j] - wi[j] * bi[j];
+        const float ti = wr[j] * bi[j] + wi[j] * br[j];
+        br[j] = ar[j] - tr;
+        bi[j] = ai[j] - ti;
+        ar[j] += tr;
+        ai[j] += ti;
+      }
+    }
+  }
+}
+
+void RealFft::forward(std::span<const float> in,
+                      std::span<std::complex<float>> out) {
+  const std::size_t half = size_ / 2;
+  float* __restrict re = re_.data();
+  float* __restrict im = im_.data();
+  // Even samples as the real part, odd ones as the imaginary part.
+  for (std::size_t i = 0; i < half; ++i) {
+    re[bit_reverse_[i]] = in[2 * i];
+    im[bit_reverse_[i]] = in[2 * i + 1];
+  }
+  transform();
+  // X[k] = E[k] + W^k O[k], with E and O recovered from Z[k], Z[half - k].
+  out[0] = {re[0] + im[0], 0.0f};
+  out[half] = {re[0] - im[0], 0.0f};
+  for (std::size_t k = 1; k < half; ++k) {
+    const std::complex<float> z(re[k], im[k]);
+    const std::complex<float> zc(re[half - k], -im[half - k]);
+    const std::complex<float> even = 0.5f * (z + zc);
+    const std::complex<float> diff = z - zc;
+    const std::complex<float> odd(0.5f * diff.imag(), -0.5f * diff.real());
+    out[k] = even + mul(split_[k], odd);
+  }
+}
+
+void RealFft::inverse(std::span<const std::complex<float>> in,
+                      std::span<float> out) {
+  const std::size_t half = size_ / 2;
+  // Undo the split: E[k] = (X[k] + X*[half - k]) / 2 and
+  // O[k] = (X[k] - X*[half - k]) / (2 W^k), then Z[k] = E[k] + i O[k].
+  // Z is conjugated on the way in so the forward butterflies compute the
+  // inverse transform.
+  for (std::size_t k = 0; k < half; ++k) {
+    const std::complex<float> x = in[k];
+    const std::complex<float> xc = std::conj(in[half - k]);
+    const std::complex<float> even = 0.5f * (x + xc);
+    const std::complex<float> odd =
+        mul(0.5f * (x - xc), std::conj(split_[k]));
+    const std::complex<float> z(even.real() - odd.imag(),
+                                even.imag() + odd.real());
+    re_[bit_reverse_[k]] = z.real();
+    im_[bit_reverse_[k]] = -z.imag();
+  }
+  transform();
+  const float scale = 1.0f / static_cast<float>(half);
+  for (std::size_t i = 0; i < half; ++i) {
+    out[2 * i] = re_[i] * scale;
+    out[2 * i + 1] = -im_[i] * scale;
+  }
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,48 @@
+#ifndef XIAOZI_AUDIO_FFT_H_
+#define XIAOZI_AUDIO_FFT_H_
+
+#include <complex>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace xiaozi {
+
+// FFT of a real signal, size a power of two (>= 4). Runs one
+// complex FFT of half the size and splits the result, with twiddles and
+// the bit-reversal table computed once in the constructor. Real and
+// imaginary parts are kept in separate arrays, and each stage's twiddles are
+// contiguous, so the butterfly loops vectorize. Neither direction
+// allocates; an instance is not thread-safe (it owns its scratch).
+class RealFft {
+ public:
+  explicit RealFft(std::size_t size);
+
+  std::size_t size() const { return size_; }
+  std::size_t bins() const { return size_ / 2 + 1; }
+
+  // in: size() samples; out: bins() values, DC to Nyquist.
+  void forward(std::span<const float> in,
+               std::span<std::complex<float>> out);
+  // in: bins() values of a real signal's spectrum; out: size() samples.
+  // Scaled so that inverse(forward(x)) == x.
+  void inverse(std::span<const std::complex<float>> in, std::span<float> out);
+
+ private:
+  // In-place complex FFT of re_/im_, which hold the input in bit-reversed
+  // order.
+  void transform();
+
+  std::size_t size_;
+  // Stage with butterfly span `len` uses entries [len/2 - 1, len - 1).
+  std::vector<float> twiddle_re_;
+  std::vector<float> twiddle_im_;
+  std::vector<std::complex<float>> split_;  // real-split post pass
+  std::vector<uint32_t> bit_reverse_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_FFT_H_
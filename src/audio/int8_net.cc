@@ -0,0 +1,235 @@
+#include "audio/int8_net.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace xiaozi {
+namespace {
+
+constexpr char kMagic[4] = {'X', 'Q', 'N', '1'};
+
+class Reader {
+ public:
+  explicit Reader(std::span<const uint8_t> data) : data_(data) {}
+
+  template <typename T>
+  bool read(T* value) {
+    if (data_.size() < sizeof(T)) return false;
+    std::memcpy(value, data_.data(), sizeof(T));
+    data_ = data_.subspan(sizeof(T));
+    return true;
+  }
+
+  template <typename T>
+  bool read_array(std::vector<T>* out, std::size_t count) {
+    if (data_.size() / sizeof(T) < count) return false;
+    out->resize(count);
+    std::memcpy(out->data(), data_.data(), count * sizeof(T));
+    data_ = data_.subspan(count * sizeof(T));
+    return true;
+  }
+
+  bool done() const { return data_.empty(); }
+
+ private:
+  std::span<const uint8_t> data_;
+};
+
+template <typename T>
+void append(std::vector<uint8_t>& out, const T& value) {
+  const auto* p = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+// real = multiplier * 2^-shift with multiplier in Q31, as in TFLite's
+// QuantizeMultiplier.
+void quantize_multiplier(double real, int32_t* multiplier, int* shift) {
+  if (real <= 0.0) {
+    *multiplier = 0;
+    *shift = 31;
+    return;
+  }
+  int exp;
+  const double q = std::frexp(real, &exp);
+  auto m = static_cast<int64_t>(std::llround(q * (int64_t{1} << 31)));
+  if (m == (int64_t{1} << 31)) {
+    m /= 2;
+    ++exp;
+  }
+  *multiplier = static_cast<int32_t>(m);
+  *shift = std::clamp(31 - exp, 1, 62);
+}
+
+inline int32_t requantize(int32_t acc, int32_t multiplier, int shift) {
+  const int64_t prod = int64_t{acc} * multiplier;
+  return static_cast<int32_t>((prod + (int64_t{1} << (shift - 1))) >> shift);
+}
+
+// Fixed-length blocks so the loop vectorizes under -O2's cheap cost model,
+// which gives up on a loop that needs a runtime epilogue.
+inline int32_t dot(const int8_t* a, const int8_t* b, std::size_t n) {
+  int32_t sum = 0;
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    int32_t block = 0;
+    for (std::size_t j = 0; j < 16; ++j) {
+      block += int32_t{a[i + j]} * b[i + j];
+    }
+    sum += block;
+  }
+  for (; i < n; ++i) sum += int32_t{a[i]} * b[i];
+  return sum;
+}
+
+}  // namespace
+
+std::size_t Int8Model::receptive_field() const {
+  std::size_t frames = 1;
+  for (const Layer& l : layers) {
+    frames += static_cast<std::size_t>(l.kernel - 1) * l.dilation;
+  }
+  return frames;
+}
+
+std::optional<Int8Model> Int8Model::parse(std::span<const uint8_t> blob) {
+  if (blob.size() < sizeof(kMagic) ||
+      std::memcmp(blob.data(), kMagic, sizeof(kMagic)) != 0) {
+    return std::nullopt;
+  }
+  Reader r(blob.subspan(sizeof(kMagic)));
+  Int8Model model;
+  uint32_t count;
+  if (!r.read(&count) || !r.read(&model.input_scale) ||
+      !r.read(&model.input_zero_point) || count == 0 || count > 64) {
+    return std::nullopt;
+  }
+  uint16_t previous_out = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    Layer& l = model.layers.emplace_back();
+    uint8_t relu;
+    uint8_t pad[3];
+    if (!r.read(&l.kernel) || !r.read(&l.dilation) ||
+        !r.read(&l.in_channels) || !r.read(&l.out_channels) ||
+        !r.read(&relu) || !r.read(&pad) || !r.read(&l.weight_scale) ||
+        !r.read(&l.output_scale) || !r.read(&l.output_zero_point)) {
+      return std::nullopt;
+    }
+    l.relu = relu != 0;
+    if (l.kernel == 0 || l.dilation == 0 || l.in_channels == 0 ||
+        l.out_channels == 0 || (i > 0 && l.in_channels != previous_out)) {
+      return std::nullopt;
+    }
+    previous_out = l.out_channels;
+    const std::size_t weights =
+        std::size_t{l.out_channels} * l.kernel * l.in_channels;
+    if (!r.read_array(&l.bias, l.out_channels) ||
+        !r.read_array(&l.weights, weights)) {
+      return std::nullopt;
+    }
+  }
+  if (!r.done()) return std::nullopt;
+  return model;
+}
+
+std::vector<uint8_t> Int8Model::serialize() const {
+  std::vector<uint8_t> out(kMagic, kMagic + sizeof(kMagic));
+  append(out, static_cast<uint32_t>(layers.size()));
+  append(out, input_scale);
+  append(out, input_zero_point);
+  for (const Layer& l : layers) {
+    append(out, l.kernel);
+    append(out, l.dilation);
+    append(out, l.in_channels);
+    append(out, l.out_channels);
+    const uint8_t flags[4] = {static_cast<uint8_t>(l.relu ? 1 : 0), 0, 0, 0};
+    out.insert(out.end(), flags, flags + 4);
+    append(out, l.weight_scale);
+    append(out, l.output_scale);
+    append(out, l.output_zero_point);
+    for (int32_t b : l.bias) append(out, b);
+    const auto* w = reinterpret_cast<const uint8_t*>(l.weights.data());
+    out.insert(out.end(), w, w + l.weights.size());
+  }
+  return out;
+}
+
+Int8StreamingNet::Int8StreamingNet(const Int8Model& model) : model_(model) {
+  float input_scale = model.input_scale;
+  int32_t input_zero_point = model.input_zero_point;
+  for (const Int8Model::Layer& l : model.layers) {
+    Prepared& p = layers_.emplace_back();
+    p.layer = &l;
+    p.input_zero_point = input_zero_point;
+    quantize_multiplier(static_cast<double>(input_scale) * l.weight_scale /
+                            l.output_scale,
+                        &p.multiplier, &p.shift);
+    const std::size_t taps = std::size_t{l.kernel} * l.in_channels;
+    p.folded_bias.resize(l.out_channels);
+    for (std::size_t oc = 0; oc < l.out_channels; ++oc) {
+      int32_t sum = 0;
+      for (std::size_t i = 0; i < taps; ++i) sum += l.weights[oc * taps + i];
+      p.folded_bias[oc] = l.bias[oc] - input_zero_point * sum;
+    }
+    p.span = std::size_t{l.kernel - 1u} * l.dilation + 1;
+    p.history.resize(p.span * l.in_channels);
+    p.output.resize(l.out_channels);
+    input_scale = l.output_scale;
+    input_zero_point = l.output_zero_point;
+  }
+  reset();
+}
+
+std::size_t Int8StreamingNet::input_size() const {
+  return model_.layers.front().in_channels;
+}
+
+std::size_t Int8StreamingNet::output_size() const {
+  return model_.layers.back().out_channels;
+}
+
+void Int8StreamingNet::reset() {
+  for (Prepared& p : layers_) {
+    std::fill(p.history.begin(), p.history.end(),
+              static_cast<int8_t>(p.input_zero_point));
+    std::fill(p.output.begin(), p.output.end(),
+              static_cast<int8_t>(p.layer->output_zero_point));
+    p.head = 0;
+  }
+}
+
+std::span<const int8_t> Int8StreamingNet::step(std::span<const int8_t> frame) {
+  const int8_t* in = frame.data();
+  for (Prepared& p : layers_) {
+    const Int8Model::Layer& l = *p.layer;
+    const std::size_t cin = l.in_channels;
+    p.head = p.head + 1 == p.span ? 0 : p.head + 1;
+    std::memcpy(&p.history[p.head * cin], in, cin);
+
+    const int32_t zp_out = l.output_zero_point;
+    const int32_t lo = l.relu ? zp_out : -128;
+    const std::size_t taps = std::size_t{l.kernel} * cin;
+    for (std::size_t oc = 0; oc < l.out_channels; ++oc) {
+      const int8_t* w = &l.weights[oc * taps];
+      int32_t acc = p.folded_bias[oc];
+      for (std::size_t k = 0; k < l.kernel; ++k) {
+        const std::size_t age = (l.kernel - 1 - k) * std::size_t{l.dilation};
+        const std::size_t slot =
+            p.head >= age ? p.head - age : p.head + p.span - age;
+        acc += dot(w + k * cin, &p.history[slot * cin], cin);
+      }
+      const int32_t q = zp_out + requantize(acc, p.multiplier, p.shift);
+      p.output[oc] = static_cast<int8_t>(std::clamp(q, lo, int32_t{127}));
+    }
+    in = p.output.data();
+  }
+  return layers_.back().output;
+}
+
+float Int8StreamingNet::logit(std::size_t index) const {
+  const Int8Model::Layer& l = model_.layers.back();
+  return l.output_scale *
+         static_cast<float>(layers_.back().output[index] - l.output_zero_point);
+}
+
+}  // namespace xiaozi
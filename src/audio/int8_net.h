@@ -0,0 +1,85 @@
+#ifndef XIAOZI_AUDIO_INT8_NET_H_
+#define XIAOZI_AUDIO_INT8_NET_H_
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace xiaozi {
+
+// Weights of a causal temporal-convolution network (dilated 1-D convs over
+// feature frames, TFLite-style int8 quantization: symmetric per-tensor
+// weights, asymmetric activations, int32 bias). A kernel-1 layer without
+// ReLU at the end gives the class logits.
+struct Int8Model {
+  struct Layer {
+    uint16_t kernel = 1;
+    uint16_t dilation = 1;
+    uint16_t in_channels = 0;
+    uint16_t out_channels = 0;
+    bool relu = true;
+    float weight_scale = 1.0f;
+    float output_scale = 1.0f;
+    int32_t output_zero_point = 0;
+    std::vector<int32_t> bias;   // out_channels
+    std::vector<int8_t> weights;  // [out][kernel][in], oldest tap first
+  };
+
+  float input_scale = 1.0f;
+  int32_t input_zero_point = 0;
+  std::vector<Layer> layers;
+
+  // Frames of input the last output depends on.
+  std::size_t receptive_field() const;
+
+  // Blob layout, little endian:
+  //   "XQN1" u32 layer_count f32 input_scale i32 input_zero_point
+  //   per layer: u16 kernel u16 dilation u16 in u16 out u8 relu u8[3] pad
+  //              f32 weight_scale f32 output_scale i32 output_zero_point
+  //              i32 bias[out] i8 weights[out * kernel * in]
+  static std::optional<Int8Model> parse(std::span<const uint8_t> blob);
+  std::vector<uint8_t> serialize() const;
+};
+
+// Streaming evaluation of an Int8Model: step() takes one new feature frame
+// and computes one output frame per layer, reusing the per-layer history of
+// earlier inputs instead of re-running the window. Integer-only between the
+// int8 input and the int8 logits.
+class Int8StreamingNet {
+ public:
+  // `model` must outlive the net.
+  explicit Int8StreamingNet(const Int8Model& model);
+
+  std::size_t input_size() const;
+  std::size_t output_size() const;
+
+  // `frame` holds input_size() values; the returned logits stay valid until
+  // the next step() or reset().
+  std::span<const int8_t> step(std::span<const int8_t> frame);
+  // History back to "all inputs at zero point", as at construction.
+  void reset();
+
+  // Dequantized logit `index` (< output_size()) of the last step.
+  float logit(std::size_t index) const;
+
+ private:
+  struct Prepared {
+    const Int8Model::Layer* layer;
+    int32_t input_zero_point;
+    int32_t multiplier;  // Q31
+    int shift;           // right shift applied after the Q31 multiply
+    std::vector<int32_t> folded_bias;  // bias - zp_in * sum(weights)
+    std::vector<int8_t> history;       // ring of span frames * in_channels
+    std::size_t span = 1;              // (kernel - 1) * dilation + 1
+    std::size_t head = 0;              // slot of the newest frame
+    std::vector<int8_t> output;
+  };
+
+  const Int8Model& model_;
+  std::vector<Prepared> layers_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_INT8_NET_H_
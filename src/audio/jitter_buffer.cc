@@ -0,0 +1,150 @@
+#include "audio/jitter_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace xiaozi {
+
+JitterBuffer::JitterBuffer(Config config)
+    : config_(config), target_(config.min_frames) {}
+
+bool JitterBuffer::push(FrameRef packet) {
+  if (!inbox_.try_push(std::move(packet))) {
+    inbox_drops_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void JitterBuffer::drain_inbox() {
+  FrameRef packet;
+  while (inbox_.try_pop(packet)) insert(std::move(packet));
+}
+
+void JitterBuffer::insert(FrameRef packet) {
+  ++received_;
+  update_jitter(packet);
+  const uint32_t seq = packet.sequence();
+  if (!started_) {
+    started_ = true;
+    next_seq_ = seq;
+    newest_seq_ = seq;
+  }
+  const auto ahead = static_cast<int32_t>(seq - next_seq_);
+  const auto window = static_cast<int32_t>(kSlots);
+  if (ahead < -window || ahead >= window) {
+    // Sender restarted its sequence or we were cut off for longer than the
+    // buffer spans: start over from this packet.
+    for (FrameRef& slot : slots_) slot.reset();
+    next_seq_ = seq;
+    newest_seq_ = seq;
+    playing_ = false;
+  } else if (ahead < 0) {
+    ++late_;
+    return;
+  }
+  FrameRef& slot = slots_[seq % kSlots];
+  if (slot) {
+    ++duplicates_;
+    return;
+  }
+  slot = std::move(packet);
+  if (static_cast<int32_t>(seq - newest_seq_) > 0) newest_seq_ = seq;
+}
+
+void JitterBuffer::update_jitter(const FrameRef& packet) {
+  // Transit time up to a constant offset: arrival minus the send time the
+  // sequence number implies.
+  const int64_t frame_ns = int64_t{config_.frame_ms} * 1000000;
+  const int64_t transit = static_cast<int64_t>(packet.timestamp_ns()) -
+                          int64_t{packet.sequence()} * frame_ns;
+  if (have_transit_) {
+    const double d = std::abs(static_cast<double>(transit - last_transit_ns_));
+    // A sequence restart makes one huge sample; cap it at one buffer span.
+    jitter_ns_ += (std::min(d, static_cast<double>(kSlots * frame_ns)) -
+                   jitter_ns_) /
+                  16.0;
+  }
+  have_transit_ = true;
+  last_transit_ns_ = transit;
+}
+
+void JitterBuffer::update_target() {
+  // Twice the mean deviation covers most arrivals, plus the frame being
+  // decoded.
+  const double frame_ns = config_.frame_ms * 1e6;
+  const auto frames = static_cast<uint32_t>(std::ceil(2.0 * jitter_ns_ /
+                                                      frame_ns)) + 1;
+  target_ = std::clamp(frames, config_.min_frames, config_.max_frames);
+}
+
+uint32_t JitterBuffer::depth() const {
+  if (!started_) return 0;
+  const auto span = static_cast<int32_t>(newest_seq_ - next_seq_);
+  return span < 0 ? 0 : static_cast<uint32_t>(span) + 1;
+}
+
+JitterBuffer::Status JitterBuffer::pop(FrameRef& packet) {
+  drain_inbox();
+  update_target();
+  packet.reset();
+  uint32_t d = depth();
+  if (!playing_) {
+    if (d == 0 || d < target_) return Status::kNotReady;
+    playing_ = true;
+  }
+  if (d == 0) {
+    playing_ = false;
+    ++underruns_;
+    return Status::kNotReady;
+  }
+  for (; d > target_ + 2; --d) {
+    FrameRef& slot = slots_[next_seq_++ % kSlots];
+    if (slot) {
+      slot.reset();
+      ++dropped_;
+    }
+  }
+  FrameRef& slot = slots_[next_seq_++ % kSlots];
+  if (!slot) {
+    ++lost_;
+    return Status::kLost;
+  }
+  packet = std::move(slot);
+  return Status::kPacket;
+}
+
+void JitterBuffer::set_frame_ms(uint32_t frame_ms) {
+  if (frame_ms == config_.frame_ms) return;
+  config_.frame_ms = frame_ms;
+  // Transit times before and after the change do not compare; the jitter
+  // estimate itself carries over.
+  have_transit_ = false;
+}
+
+void JitterBuffer::reset() {
+  FrameRef packet;
+  while (inbox_.try_pop(packet)) packet.reset();
+  for (FrameRef& slot : slots_) slot.reset();
+  started_ = false;
+  playing_ = false;
+  have_transit_ = false;
+  jitter_ns_ = 0;
+  target_ = config_.min_frames;
+}
+
+JitterBuffer::Stats JitterBuffer::stats() const {
+  Stats s;
+  s.received = received_;
+  s.late = late_;
+  s.duplicates = duplicates_;
+  s.lost = lost_;
+  s.dropped = dropped_ + inbox_drops_.load(std::memory_order_relaxed);
+  s.underruns = underruns_;
+  s.target_frames = target_;
+  s.depth_frames = depth();
+  s.jitter_ms = jitter_ns_ / 1e6;
+  return s;
+}
+
+}  // namespace xiaozi
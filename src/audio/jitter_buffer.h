@@ -0,0 +1,104 @@
+#ifndef XIAOZI_AUDIO_JITTER_BUFFER_H_
+#define XIAOZI_AUDIO_JITTER_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "memory/frame_pool.h"
+#include "memory/spsc_ring.h"
+
+namespace xiaozi {
+
+// Adaptive playout buffer for packets that arrive out of order or not at
+// all (the UDP audio channel). Packets are keyed by FrameRef::sequence and
+// carry their arrival time in FrameRef::timestamp_ns.
+//
+// The target depth follows the RFC 3550 interarrival jitter estimate,
+// clamped to [min_frames, max_frames]. After an underrun the buffer refills
+// to the target before playing again; when it runs more than two frames
+// above target it drops the oldest packet to catch up.
+//
+// push() runs on the transport thread, everything else on the playback
+// (decoder feeding) thread.
+class JitterBuffer {
+ public:
+  static constexpr std::size_t kSlots = 64;
+
+  struct Config {
+    uint32_t frame_ms = 60;
+    uint32_t min_frames = 1;
+    uint32_t max_frames = 8;
+  };
+
+  enum class Status {
+    kPacket,    // `packet` holds the next frame
+    kLost,      // the next frame is missing; conceal it
+    kNotReady,  // buffering, play nothing (or comfort noise)
+  };
+
+  struct Stats {
+    uint64_t received;
+    uint64_t late;        // arrived after its slot was played
+    uint64_t duplicates;
+    uint64_t lost;        // played out as kLost
+    uint64_t dropped;     // discarded to shrink the buffer or inbox full
+    uint64_t underruns;
+    uint32_t target_frames;
+    uint32_t depth_frames;
+    double jitter_ms;
+  };
+
+  explicit JitterBuffer(Config config);
+  JitterBuffer() : JitterBuffer(Config{}) {}
+
+  bool push(FrameRef packet);
+
+  // Called once per frame_ms by the playback side. kPacket and kLost both
+  // take one frame off the buffer; feed either into DecoderStage::submit()
+  // (an empty `packet` is a loss there too).
+  Status pop(FrameRef& packet);
+
+  // The sender changed its packet duration: later sequence numbers are
+  // `frame_ms` apart.
+  void set_frame_ms(uint32_t frame_ms);
+  uint32_t frame_ms() const { return config_.frame_ms; }
+
+  void reset();
+  Stats stats() const;
+
+ private:
+  void drain_inbox();
+  void insert(FrameRef packet);
+  void update_jitter(const FrameRef& packet);
+  void update_target();
+  // Sequence span from next_seq_ to the newest slot filled, inclusive.
+  uint32_t depth() const;
+
+  Config config_;
+  SpscRing<FrameRef, kSlots> inbox_;
+  std::array<FrameRef, kSlots> slots_;
+
+  bool started_ = false;
+  bool playing_ = false;
+  uint32_t next_seq_ = 0;
+  uint32_t newest_seq_ = 0;
+
+  // RFC 3550 section 6.4.1, in nanoseconds.
+  bool have_transit_ = false;
+  int64_t last_transit_ns_ = 0;
+  double jitter_ns_ = 0;
+  uint32_t target_ = 0;
+
+  std::atomic<uint64_t> inbox_drops_{0};
+  uint64_t received_ = 0;
+  uint64_t late_ = 0;
+  uint64_t duplicates_ = 0;
+  uint64_t lost_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t underruns_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_JITTER_BUFFER_H_
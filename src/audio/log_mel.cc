@@ -0,0 +1,85 @@
+#include "audio/log_mel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+
+#include "audio/pcm_kernels.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr float kLowHz = 20.0f;
+constexpr float kHighHz = 7600.0f;
+// Keeps log() finite on digital silence.
+constexpr float kPowerFloor = 1e-10f;
+
+float hz_to_mel(float hz) { return 2595.0f * std::log10(1.0f + hz / 700.0f); }
+float mel_to_hz(float mel) {
+  return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+}  // namespace
+
+LogMelFrontend::LogMelFrontend(Config config)
+    : config_(config), fft_(kFftSize) {
+  for (std::size_t i = 0; i < kWindow; ++i) {
+    window_fn_[i] = 0.5f - 0.5f * std::cos(2.0f * std::numbers::pi_v<float> *
+                                           i / kWindow);
+  }
+  // Triangles on the mel scale, stored sparsely: each band keeps only the
+  // bins where its weight is non-zero.
+  const float low = hz_to_mel(kLowHz);
+  const float high = hz_to_mel(kHighHz);
+  const float bin_hz = static_cast<float>(kSampleRate) / kFftSize;
+  for (std::size_t b = 0; b < kBands; ++b) {
+    const float left = mel_to_hz(low + (high - low) * b / (kBands + 1));
+    const float center = mel_to_hz(low + (high - low) * (b + 1) / (kBands + 1));
+    const float right = mel_to_hz(low + (high - low) * (b + 2) / (kBands + 1));
+    Band& band = bands_[b];
+    band.first_bin = static_cast<uint16_t>(std::ceil(left / bin_hz));
+    band.weight_offset = static_cast<uint16_t>(weights_.size());
+    for (std::size_t bin = band.first_bin; bin * bin_hz < right; ++bin) {
+      const float hz = bin * bin_hz;
+      weights_.push_back(hz < center ? (hz - left) / (center - left)
+                                     : (right - hz) / (right - center));
+    }
+    band.weight_count =
+        static_cast<uint16_t>(weights_.size() - band.weight_offset);
+  }
+}
+
+void LogMelFrontend::reset() { samples_.fill(0.0f); }
+
+void LogMelFrontend::slide(std::span<const int16_t> hop) {
+  std::memmove(samples_.data(), samples_.data() + kHop,
+               (kWindow - kHop) * sizeof(float));
+  pcm::int16_to_float(hop.first(kHop), samples_.data() + kWindow - kHop);
+}
+
+void LogMelFrontend::skip(std::span<const int16_t> hop) { slide(hop); }
+
+void LogMelFrontend::push(std::span<const int16_t> hop,
+                          std::span<int8_t, kBands> out) {
+  slide(hop);
+  for (std::size_t i = 0; i < kWindow; ++i) {
+    frame_[i] = samples_[i] * window_fn_[i];
+  }
+  fft_.forward(frame_, spectrum_);
+
+  const float inv_scale = 1.0f / config_.output_scale;
+  for (std::size_t b = 0; b < kBands; ++b) {
+    const Band& band = bands_[b];
+    float energy = kPowerFloor;
+    for (std::size_t i = 0; i < band.weight_count; ++i) {
+      energy += weights_[band.weight_offset + i] *
+                std::norm(spectrum_[band.first_bin + i]);
+    }
+    const float q = std::nearbyint(std::log(energy) * inv_scale) +
+                    static_cast<float>(config_.output_zero_point);
+    out[b] = static_cast<int8_t>(std::clamp(q, -128.0f, 127.0f));
+  }
+}
+
+}  // namespace xiaozi
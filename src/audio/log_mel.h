@@ -0,0 +1,62 @@
+#ifndef XIAOZI_AUDIO_LOG_MEL_H_
+#define XIAOZI_AUDIO_LOG_MEL_H_
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "audio/fft.h"
+
+namespace xiaozi {
+
+// Streaming log-mel filterbank for 16 kHz audio: 25 ms Hann window, 10 ms
+// hop, 40 bands from 20 Hz to 7.6 kHz. Each push() consumes one hop and
+// computes exactly one new feature frame; the window overlap is carried in
+// the object, so nothing already computed is recomputed. Output is
+// quantized to int8 with the model's input scale and zero point.
+class LogMelFrontend {
+ public:
+  static constexpr std::size_t kSampleRate = 16000;
+  static constexpr std::size_t kWindow = 400;
+  static constexpr std::size_t kHop = 160;
+  static constexpr std::size_t kFftSize = 512;
+  static constexpr std::size_t kBands = 40;
+
+  struct Config {
+    float output_scale = 0.25f;  // natural-log units per int8 step
+    int32_t output_zero_point = 0;
+  };
+
+  explicit LogMelFrontend(Config config);
+
+  // `hop` holds kHop samples.
+  void push(std::span<const int16_t> hop, std::span<int8_t, kBands> out);
+  // Slides the window without computing a frame, for hops the caller is
+  // not going to look at (e.g. gated silence).
+  void skip(std::span<const int16_t> hop);
+  void reset();
+
+ private:
+  void slide(std::span<const int16_t> hop);
+
+  struct Band {
+    uint16_t first_bin;
+    uint16_t weight_offset;
+    uint16_t weight_count;
+  };
+
+  Config config_;
+  RealFft fft_;
+  std::array<float, kWindow> window_fn_;
+  std::array<float, kWindow> samples_{};
+  std::array<float, kFftSize> frame_{};
+  std::array<std::complex<float>, kFftSize / 2 + 1> spectrum_;
+  std::array<Band, kBands> bands_;
+  std::vector<float> weights_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_LOG_MEL_H_
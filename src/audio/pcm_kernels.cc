@@ -0,0 +1,99 @@
+#include "audio/pcm_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace xiaozi::pcm {
+namespace {
+
+using detail::saturate16;
+
+void int16_to_float_scalar(const int16_t* in, float* out, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) out[i] = in[i] * (1.0f / 32768.0f);
+}
+
+void apply_gain_q12_scalar(int16_t* samples, std::size_t n, int16_t gain) {
+  for (std::size_t i = 0; i < n; ++i) {
+    samples[i] = saturate16((samples[i] * gain + 2048) >> 12);
+  }
+}
+
+void fir_decimate3_scalar(const int16_t* in, int16_t* out, std::size_t n_out,
+                          const int16_t* taps, std::size_t n_taps) {
+  for (std::size_t k = 0; k < n_out; ++k) {
+    const int16_t* x = in + 3 * k;
+    int32_t acc = 0;
+    for (std::size_t j = 0; j < n_taps; ++j) acc += taps[j] * x[j];
+    out[k] = saturate16((acc + (1 << 14)) >> 15);
+  }
+}
+
+constexpr Kernels kScalarKernels = {
+    "scalar",
+    int16_to_float_scalar,
+    apply_gain_q12_scalar,
+    fir_decimate3_scalar,
+};
+
+std::vector<const Kernels*> detect() {
+  std::vector<const Kernels*> found = {&kScalarKernels};
+#if defined(XIAOZI_HAVE_SSE41_KERNELS)
+  if (__builtin_cpu_supports("sse4.1")) found.push_back(&detail::kSse41Kernels);
+#endif
+#if defined(XIAOZI_HAVE_AVX2_KERNELS)
+  if (__builtin_cpu_supports("avx2")) found.push_back(&detail::kAvx2Kernels);
+#endif
+#if defined(XIAOZI_HAVE_NEON_KERNELS)
+  // Baseline on AArch64; nothing to probe.
+  found.push_back(&detail::kNeonKernels);
+#endif
+  return found;
+}
+
+const std::vector<const Kernels*>& detected() {
+  static const std::vector<const Kernels*> found = detect();
+  return found;
+}
+
+}  // namespace
+
+const Kernels& scalar_kernels() { return kScalarKernels; }
+
+std::span<const Kernels* const> available_kernels() { return detected(); }
+
+const Kernels& kernels() {
+  // detect() lists variants in ascending order of preference.
+  static const Kernels* best = detected().back();
+  return *best;
+}
+
+void Downsampler3::reset() {
+  // Start from silence so the first outputs are the filter's ramp-in.
+  std::fill(buf_.begin(), buf_.begin() + kTaps - 1, int16_t{0});
+  fill_ = kTaps - 1;
+}
+
+std::size_t Downsampler3::process(std::span<const int16_t> in, int16_t* out) {
+  std::size_t written = 0;
+  while (!in.empty()) {
+    std::size_t take = std::min(in.size(), buf_.size() - fill_);
+    std::memcpy(buf_.data() + fill_, in.data(), take * sizeof(int16_t));
+    fill_ += take;
+    in = in.subspan(take);
+
+    if (fill_ < kTaps) continue;
+    std::size_t n_out = (fill_ - kTaps) / 3 + 1;
+    kernels_->fir_decimate3(buf_.data(), out + written, n_out,
+                            kFilter.data(), kTaps);
+    written += n_out;
+
+    std::size_t consumed = 3 * n_out;
+    std::memmove(buf_.data(), buf_.data() + consumed,
+                 (fill_ - consumed) * sizeof(int16_t));
+    fill_ -= consumed;
+  }
+  return written;
+}
+
+}  // namespace xiaozi::pcm
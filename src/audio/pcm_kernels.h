@@ -0,0 +1,104 @@
+#ifndef XIAOZI_AUDIO_PCM_KERNELS_H_
+#define XIAOZI_AUDIO_PCM_KERNELS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xiaozi::pcm {
+
+// Hot PCM loops, one table per instruction set. Every variant is bit-exact
+// with the scalar one: conversion multiplies by an exact power of two, and
+// gain and filtering are fixed-point, so wake-word features and encoder
+// input do not depend on which CPU the device happens to run on.
+struct Kernels {
+  const char* name;
+
+  // out[i] = in[i] / 32768.
+  void (*int16_to_float)(const int16_t* in, float* out, std::size_t n);
+
+  // In place: x = saturate((x * gain_q12 + 2048) >> 12), gain in Q3.12.
+  void (*apply_gain_q12)(int16_t* samples, std::size_t n, int16_t gain_q12);
+
+  // out[k] = saturate((sum_j taps[j] * in[3k + j] + 2^14) >> 15) for
+  // k < n_out. `in` must hold 3 * (n_out - 1) + n_taps samples; taps are
+  // Q15, n_taps is a multiple of 16 and sum(|taps|) < 2^16 so the int32
+  // accumulator cannot overflow.
+  void (*fir_decimate3)(const int16_t* in, int16_t* out, std::size_t n_out,
+                        const int16_t* taps, std::size_t n_taps);
+};
+
+// Best variant for this CPU, chosen once on first use.
+const Kernels& kernels();
+
+// Every variant compiled in and supported by this CPU, scalar first.
+std::span<const Kernels* const> available_kernels();
+
+const Kernels& scalar_kernels();
+
+inline void int16_to_float(std::span<const int16_t> in, float* out) {
+  kernels().int16_to_float(in.data(), out, in.size());
+}
+
+inline void apply_gain_q12(std::span<int16_t> samples, int16_t gain_q12) {
+  kernels().apply_gain_q12(samples.data(), samples.size(), gain_q12);
+}
+
+// Linear gain (0 .. ~8) to the Q3.12 value apply_gain_q12() takes.
+inline int16_t gain_to_q12(float gain) {
+  float q = gain * 4096.0f + 0.5f;
+  if (q <= 0.0f) return 0;
+  if (q >= 32767.0f) return 32767;
+  return static_cast<int16_t>(q);
+}
+
+// 48 kHz -> 16 kHz decimator for the wake-word front end. A 48-tap
+// Kaiser-windowed low-pass (-6 dB at 7 kHz) followed by keep-every-third.
+// Carries filter history across calls, so any block size can be fed.
+class Downsampler3 {
+ public:
+  static constexpr std::size_t kTaps = 48;
+  static constexpr std::array<int16_t, kTaps> kFilter = {
+      1,     6,     9,     -1,    -28,   -47,   -23,   56,
+      137,   121,   -47,   -279,  -357,  -98,   417,   791,
+      551,   -401,  -1500, -1710, -181,  3024,  6730,  9213,
+      9213,  6730,  3024,  -181,  -1710, -1500, -401,  551,
+      791,   417,   -98,   -357,  -279,  -47,   121,   137,
+      56,    -23,   -47,   -28,   -1,    9,     6,     1,
+  };
+
+  explicit Downsampler3(const Kernels& k = kernels()) : kernels_(&k) {
+    reset();
+  }
+
+  void reset();
+
+  // Consumes all of `in`; writes up to in.size() / 3 + 1 samples to `out`
+  // and returns how many were written.
+  std::size_t process(std::span<const int16_t> in, int16_t* out);
+
+ private:
+  // 60 ms at 48 kHz per internal pass; longer inputs are chunked.
+  static constexpr std::size_t kBlock = 2880;
+
+  const Kernels* kernels_;
+  std::size_t fill_ = 0;
+  alignas(32) std::array<int16_t, kTaps - 1 + kBlock> buf_{};
+};
+
+namespace detail {
+
+inline int16_t saturate16(int32_t v) {
+  return static_cast<int16_t>(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+// Per-ISA tables, defined in pcm_kernels_<isa>.cc when compiled in.
+extern const Kernels kSse41Kernels;
+extern const Kernels kAvx2Kernels;
+extern const Kernels kNeonKernels;
+}  // namespace detail
+
+}  // namespace xiaozi::pcm
+
+#endif  // XIAOZI_AUDIO_PCM_KERNELS_H_
@@ -0,0 +1,115 @@
+// Built with -mavx2; only reached after a runtime check.
+
+#include <immintrin.h>
+
+#include "audio/pcm_kernels.h"
+
+namespace xiaozi::pcm {
+namespace {
+
+using detail::saturate16;
+
+void int16_to_float(const int16_t* in, float* out, std::size_t n) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+    __m256 fa = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a));
+    __m256 fb = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(fa, scale));
+    _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(fb, scale));
+  }
+  for (; i < n; ++i) out[i] = in[i] * (1.0f / 32768.0f);
+}
+
+void apply_gain_q12(int16_t* samples, std::size_t n, int16_t gain) {
+  const __m256i g = _mm256_set1_epi16(gain);
+  const __m256i round = _mm256_set1_epi32(2048);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto* p = reinterpret_cast<__m256i*>(samples + i);
+    __m256i x = _mm256_loadu_si256(p);
+    __m256i plo = _mm256_mullo_epi16(x, g);
+    __m256i phi = _mm256_mulhi_epi16(x, g);
+    // unpack and packs both work per 128-bit lane, so these two cancel out
+    // and the samples come back in their original order.
+    __m256i lo = _mm256_srai_epi32(
+        _mm256_add_epi32(_mm256_unpacklo_epi16(plo, phi), round), 12);
+    __m256i hi = _mm256_srai_epi32(
+        _mm256_add_epi32(_mm256_unpackhi_epi16(plo, phi), round), 12);
+    _mm256_storeu_si256(p, _mm256_packs_epi32(lo, hi));
+  }
+  for (; i < n; ++i) {
+    samples[i] = saturate16((samples[i] * gain + 2048) >> 12);
+  }
+}
+
+int32_t hsum(__m256i v) {
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s);
+}
+
+// Four outputs per pass, as in the SSE4.1 kernel: one tap load feeds all
+// four, and the sums are reduced together.
+void fir_decimate3(const int16_t* in, int16_t* out, std::size_t n_out,
+                   const int16_t* taps, std::size_t n_taps) {
+  const __m128i round = _mm_set1_epi32(1 << 14);
+  std::size_t k = 0;
+  for (; k + 4 <= n_out; k += 4) {
+    const int16_t* x = in + 3 * k;
+    __m256i a0 = _mm256_setzero_si256();
+    __m256i a1 = _mm256_setzero_si256();
+    __m256i a2 = _mm256_setzero_si256();
+    __m256i a3 = _mm256_setzero_si256();
+    for (std::size_t j = 0; j < n_taps; j += 16) {
+      __m256i hv =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps + j));
+      auto at = [&](std::size_t offset) {
+        return _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(x + offset + j));
+      };
+      a0 = _mm256_add_epi32(a0, _mm256_madd_epi16(at(0), hv));
+      a1 = _mm256_add_epi32(a1, _mm256_madd_epi16(at(3), hv));
+      a2 = _mm256_add_epi32(a2, _mm256_madd_epi16(at(6), hv));
+      a3 = _mm256_add_epi32(a3, _mm256_madd_epi16(at(9), hv));
+    }
+    // hadd works per 128-bit lane: each lane ends up with four partial
+    // sums in output order, and the lanes are added last.
+    const __m256i h = _mm256_hadd_epi32(_mm256_hadd_epi32(a0, a1),
+                                        _mm256_hadd_epi32(a2, a3));
+    __m128i sums = _mm_add_epi32(_mm256_castsi256_si128(h),
+                                 _mm256_extracti128_si256(h, 1));
+    sums = _mm_srai_epi32(_mm_add_epi32(sums, round), 15);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + k),
+                     _mm_packs_epi32(sums, sums));
+  }
+  for (; k < n_out; ++k) {
+    const int16_t* x = in + 3 * k;
+    __m256i acc = _mm256_setzero_si256();
+    for (std::size_t j = 0; j < n_taps; j += 16) {
+      __m256i xv =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + j));
+      __m256i hv =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps + j));
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(xv, hv));
+    }
+    out[k] = saturate16((hsum(acc) + (1 << 14)) >> 15);
+  }
+}
+
+}  // namespace
+
+namespace detail {
+const Kernels kAvx2Kernels = {
+    "avx2",
+    int16_to_float,
+    apply_gain_q12,
+    fir_decimate3,
+};
+}  // namespace detail
+
+}  // namespace xiaozi::pcm
@@ -0,0 +1,68 @@
+// AArch64 NEON; Advanced SIMD is part of the base ISA there.
+
+#include <arm_neon.h>
+
+#include "audio/pcm_kernels.h"
+
+namespace xiaozi::pcm {
+namespace {
+
+using detail::saturate16;
+
+void int16_to_float(const int16_t* in, float* out, std::size_t n) {
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t x = vld1q_s16(in + i);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+    vst1q_f32(out + i, vmulq_n_f32(lo, 1.0f / 32768.0f));
+    vst1q_f32(out + i + 4, vmulq_n_f32(hi, 1.0f / 32768.0f));
+  }
+  for (; i < n; ++i) out[i] = in[i] * (1.0f / 32768.0f);
+}
+
+void apply_gain_q12(int16_t* samples, std::size_t n, int16_t gain) {
+  const int16x4_t g = vdup_n_s16(gain);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t x = vld1q_s16(samples + i);
+    // vrshrq_n_s32 adds 1 << 11 before shifting: the same rounding as the
+    // scalar (x * g + 2048) >> 12.
+    int32x4_t lo = vrshrq_n_s32(vmull_s16(vget_low_s16(x), g), 12);
+    int32x4_t hi = vrshrq_n_s32(vmull_s16(vget_high_s16(x), g), 12);
+    vst1q_s16(samples + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  }
+  for (; i < n; ++i) {
+    samples[i] = saturate16((samples[i] * gain + 2048) >> 12);
+  }
+}
+
+void fir_decimate3(const int16_t* in, int16_t* out, std::size_t n_out,
+                   const int16_t* taps, std::size_t n_taps) {
+  for (std::size_t k = 0; k < n_out; ++k) {
+    const int16_t* x = in + 3 * k;
+    int32x4_t acc0 = vdupq_n_s32(0);
+    int32x4_t acc1 = vdupq_n_s32(0);
+    for (std::size_t j = 0; j < n_taps; j += 8) {
+      int16x8_t xv = vld1q_s16(x + j);
+      int16x8_t hv = vld1q_s16(taps + j);
+      acc0 = vmlal_s16(acc0, vget_low_s16(xv), vget_low_s16(hv));
+      acc1 = vmlal_high_s16(acc1, xv, hv);
+    }
+    int32_t sum = vaddvq_s32(vaddq_s32(acc0, acc1));
+    out[k] = saturate16((sum + (1 << 14)) >> 15);
+  }
+}
+
+}  // namespace
+
+namespace detail {
+const Kernels kNeonKernels = {
+    "neon",
+    int16_to_float,
+    apply_gain_q12,
+    fir_decimate3,
+};
+}  // namespace detail
+
+}  // namespace xiaozi::pcm
@@ -0,0 +1,105 @@
+// Built with -msse4.1; only reached after a runtime check.
+
+#include <smmintrin.h>
+
+#include "audio/pcm_kernels.h"
+
+namespace xiaozi::pcm {
+namespace {
+
+using detail::saturate16;
+
+void int16_to_float(const int16_t* in, float* out, std::size_t n) {
+  const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i lo = _mm_cvtepi16_epi32(x);
+    __m128i hi = _mm_cvtepi16_epi32(_mm_srli_si128(x, 8));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  for (; i < n; ++i) out[i] = in[i] * (1.0f / 32768.0f);
+}
+
+void apply_gain_q12(int16_t* samples, std::size_t n, int16_t gain) {
+  const __m128i g = _mm_set1_epi16(gain);
+  const __m128i round = _mm_set1_epi32(2048);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    auto* p = reinterpret_cast<__m128i*>(samples + i);
+    __m128i x = _mm_loadu_si128(p);
+    __m128i plo = _mm_mullo_epi16(x, g);
+    __m128i phi = _mm_mulhi_epi16(x, g);
+    __m128i lo = _mm_srai_epi32(
+        _mm_add_epi32(_mm_unpacklo_epi16(plo, phi), round), 12);
+    __m128i hi = _mm_srai_epi32(
+        _mm_add_epi32(_mm_unpackhi_epi16(plo, phi), round), 12);
+    _mm_storeu_si128(p, _mm_packs_epi32(lo, hi));
+  }
+  for (; i < n; ++i) {
+    samples[i] = saturate16((samples[i] * gain + 2048) >> 12);
+  }
+}
+
+int32_t hsum(__m128i v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+// Four outputs per pass: each tap vector is loaded once for all four, and
+// their sums are reduced together with two rounds of hadd rather than a
+// shuffle-add tail per output.
+void fir_decimate3(const int16_t* in, int16_t* out, std::size_t n_out,
+                   const int16_t* taps, std::size_t n_taps) {
+  const __m128i round = _mm_set1_epi32(1 << 14);
+  std::size_t k = 0;
+  for (; k + 4 <= n_out; k += 4) {
+    const int16_t* x = in + 3 * k;
+    __m128i a0 = _mm_setzero_si128();
+    __m128i a1 = _mm_setzero_si128();
+    __m128i a2 = _mm_setzero_si128();
+    __m128i a3 = _mm_setzero_si128();
+    for (std::size_t j = 0; j < n_taps; j += 8) {
+      __m128i hv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(taps + j));
+      auto at = [&](std::size_t offset) {
+        return _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(x + offset + j));
+      };
+      a0 = _mm_add_epi32(a0, _mm_madd_epi16(at(0), hv));
+      a1 = _mm_add_epi32(a1, _mm_madd_epi16(at(3), hv));
+      a2 = _mm_add_epi32(a2, _mm_madd_epi16(at(6), hv));
+      a3 = _mm_add_epi32(a3, _mm_madd_epi16(at(9), hv));
+    }
+    __m128i sums = _mm_hadd_epi32(_mm_hadd_epi32(a0, a1),
+                                  _mm_hadd_epi32(a2, a3));
+    sums = _mm_srai_epi32(_mm_add_epi32(sums, round), 15);
+    // packs saturates exactly as saturate16() does.
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + k),
+                     _mm_packs_epi32(sums, sums));
+  }
+  for (; k < n_out; ++k) {
+    const int16_t* x = in + 3 * k;
+    __m128i acc = _mm_setzero_si128();
+    for (std::size_t j = 0; j < n_taps; j += 8) {
+      __m128i xv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + j));
+      __m128i hv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(taps + j));
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(xv, hv));
+    }
+    out[k] = saturate16((hsum(acc) + (1 << 14)) >> 15);
+  }
+}
+
+}  // namespace
+
+namespace detail {
+const Kernels kSse41Kernels = {
+    "sse4.1",
+    int16_to_float,
+    apply_gain_q12,
+    fir_decimate3,
+};
+}  // namespace detail
+
+}  // namespace xiaozi::pcm
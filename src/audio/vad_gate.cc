@@ -0,0 +1,126 @@
+#include "audio/vad_gate.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "base/trace.h"
+
+namespace xiaozi {
+
+VadGate::VadGate(Listener& listener, Config config)
+    : listener_(listener),
+      config_(config),
+      vad_(config.vad),
+      hangover_samples_(uint64_t{config.hangover_ms} * config.sample_rate /
+                        1000) {
+  config_.block_samples = std::max<uint32_t>(config_.block_samples, 1);
+  config_.preroll_frames =
+      std::min(config_.preroll_frames, kMaxPrerollFrames);
+}
+
+bool VadGate::analyse(std::span<const int16_t> pcm) {
+  uint64_t blocks = 0;
+  bool active = false;
+  while (!pcm.empty()) {
+    const std::size_t n = std::min<std::size_t>(pcm.size(),
+                                                config_.block_samples);
+    ++blocks;
+    if (vad_.process(pcm.first(n))) {
+      active = true;
+      break;
+    }
+    pcm = pcm.subspan(n);
+  }
+  blocks_analysed_.fetch_add(blocks, std::memory_order_relaxed);
+  return active;
+}
+
+bool VadGate::observe(std::span<const int16_t> pcm) {
+  observed_ += pcm.size();
+  if (!frame_active_ && analyse(pcm)) {
+    frame_active_ = true;
+    if (!open_) wake();
+  }
+  return open_;
+}
+
+void VadGate::submit(FrameRef frame) {
+  frames_.fetch_add(1, std::memory_order_relaxed);
+  auto pcm = frame.as<const int16_t>();
+  if (!frame_active_ && observed_ < pcm.size()) {
+    frame_active_ = analyse(pcm.subspan(observed_));
+  }
+  const bool active = frame_active_;
+  frame_active_ = false;
+  observed_ = 0;
+
+  if (active) {
+    quiet_samples_ = 0;
+    if (!open_) wake();
+  } else if (open_) {
+    quiet_samples_ += pcm.size();
+    if (quiet_samples_ > hangover_samples_) {
+      open_ = false;
+      listener_.on_idle();
+    }
+  }
+
+  if (open_) {
+    XIAOZI_TRACE_FRAME(kVad, frame);
+    forward(std::move(frame));
+    return;
+  }
+  if (config_.preroll_frames == 0) {
+    frames_gated_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (preroll_count_ == config_.preroll_frames) {
+    preroll_[preroll_head_].reset();
+    preroll_head_ = (preroll_head_ + 1) % config_.preroll_frames;
+    --preroll_count_;
+    frames_gated_.fetch_add(1, std::memory_order_relaxed);
+  }
+  preroll_[(preroll_head_ + preroll_count_) % config_.preroll_frames] =
+      std::move(frame);
+  ++preroll_count_;
+}
+
+void VadGate::wake() {
+  open_ = true;
+  quiet_samples_ = 0;
+  wakes_.fetch_add(1, std::memory_order_relaxed);
+  listener_.on_wake();
+  for (; preroll_count_ > 0; --preroll_count_) {
+    forward(std::move(preroll_[preroll_head_]));
+    preroll_head_ = (preroll_head_ + 1) % config_.preroll_frames;
+  }
+  preroll_head_ = 0;
+}
+
+void VadGate::forward(FrameRef frame) {
+  frames_forwarded_.fetch_add(1, std::memory_order_relaxed);
+  listener_.on_frame(std::move(frame));
+}
+
+void VadGate::reset() {
+  for (FrameRef& f : preroll_) f.reset();
+  preroll_head_ = 0;
+  preroll_count_ = 0;
+  vad_.reset();
+  open_ = false;
+  frame_active_ = false;
+  observed_ = 0;
+  quiet_samples_ = 0;
+}
+
+VadGate::Stats VadGate::stats() const {
+  return Stats{
+      frames_.load(std::memory_order_relaxed),
+      frames_forwarded_.load(std::memory_order_relaxed),
+      frames_gated_.load(std::memory_order_relaxed),
+      wakes_.load(std::memory_order_relaxed),
+      blocks_analysed_.load(std::memory_order_relaxed),
+  };
+}
+
+}  // namespace xiaozi
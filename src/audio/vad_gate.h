@@ -0,0 +1,113 @@
+#ifndef XIAOZI_AUDIO_VAD_GATE_H_
+#define XIAOZI_AUDIO_VAD_GATE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+#include "audio/energy_vad.h"
+#include "memory/frame_pool.h"
+
+namespace xiaozi {
+
+// Voice-activity gate between capture and everything that costs power:
+// wake word, encoder, radio. While the room is silent, captured frames
+// stop here and the downstream stages sit idle (the encoder thread blocks
+// on its semaphore, the transport sends nothing). The last few silent
+// frames are held in a pre-roll ring and forwarded ahead of the frame that
+// woke the gate, so the onset of the first syllable still reaches the
+// server.
+//
+// Frames are analysed in blocks of block_samples; the first active block
+// wakes the gate. A capture driver that gets PCM in DMA chunks shorter than
+// a codec frame can observe() each chunk as it lands and wake downstream
+// before the frame is complete; submit() then only analyses what was not
+// observed.
+//
+// All methods except stats() belong to the capture thread.
+class VadGate {
+ public:
+  static constexpr std::size_t kMaxPrerollFrames = 16;
+
+  // Downstream of the gate, called on the capture thread.
+  class Listener {
+   public:
+    virtual ~Listener() = default;
+
+    // Speech onset. Bring downstream out of idle (e.g. open the audio
+    // channel); pre-roll and current frames follow at once.
+    virtual void on_wake() = 0;
+    virtual void on_frame(FrameRef frame) = 0;
+    // Hangover expired after the last active frame. Downstream may go
+    // idle; EncoderStage::flush() sends the partial batch.
+    virtual void on_idle() = 0;
+  };
+
+  struct Config {
+    uint32_t sample_rate = 16000;
+    // Analysis block: the wake latency granularity. 2.5 ms at 16 kHz.
+    uint32_t block_samples = 40;
+    // Audio kept flowing after the last active block, so word tails and
+    // short pauses between words are not cut.
+    uint32_t hangover_ms = 400;
+    // Silent frames held back for the next wake (0 .. kMaxPrerollFrames).
+    // They stay allocated from the capture pool while idle.
+    std::size_t preroll_frames = 3;
+    EnergyVad::Config vad;
+  };
+
+  struct Stats {
+    uint64_t frames;
+    uint64_t frames_forwarded;  // pre-roll included
+    uint64_t frames_gated;      // dropped while idle
+    uint64_t wakes;
+    uint64_t blocks_analysed;
+  };
+
+  VadGate(Listener& listener, Config config);
+
+  // Capture PCM that will end up in the next submit()ted frame, in order.
+  // Returns true while the gate is open.
+  bool observe(std::span<const int16_t> pcm);
+  // One captured frame. Forwarded (after any pre-roll) if the gate is open
+  // after it, otherwise kept as pre-roll or dropped.
+  void submit(FrameRef frame);
+  // Back to idle with an empty pre-roll; no on_idle() call.
+  void reset();
+
+  bool open() const { return open_; }
+  // Any thread.
+  Stats stats() const;
+
+ private:
+  // Analyses whole blocks of `pcm` and returns true if any was active.
+  // Stops at the first active block: one is enough to keep the gate open.
+  bool analyse(std::span<const int16_t> pcm);
+  void wake();
+  void forward(FrameRef frame);
+
+  Listener& listener_;
+  Config config_;
+  EnergyVad vad_;
+  uint64_t hangover_samples_;
+
+  bool open_ = false;
+  bool frame_active_ = false;  // an active block seen in the current frame
+  std::size_t observed_ = 0;   // samples of the current frame observe()d
+  uint64_t quiet_samples_ = 0;
+
+  std::array<FrameRef, kMaxPrerollFrames> preroll_;
+  std::size_t preroll_head_ = 0;  // oldest
+  std::size_t preroll_count_ = 0;
+
+  std::atomic<uint64_t> frames_{0};
+  std::atomic<uint64_t> frames_forwarded_{0};
+  std::atomic<uint64_t> frames_gated_{0};
+  std::atomic<uint64_t> wakes_{0};
+  std::atomic<uint64_t> blocks_analysed_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_VAD_GATE_H_
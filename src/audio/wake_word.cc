@@ -0,0 +1,108 @@
+#include "audio/wake_word.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace xiaozi {
+
+WakeWordDetector::WakeWordDetector(const Int8Model& model, Config config)
+    : config_(config),
+      frontend_({model.input_scale, model.input_zero_point}),
+      net_(model),
+      vad_(config.vad),
+      ok_(config.wake_class < net_.output_size()) {
+  config_.smoothing_frames =
+      std::clamp<std::size_t>(config_.smoothing_frames, 1, kMaxSmoothing);
+  gate_open_ = !config_.energy_gate;
+}
+
+void WakeWordDetector::reset() {
+  frontend_.reset();
+  net_.reset();
+  vad_.reset();
+  pending_len_ = 0;
+  gate_open_ = !config_.energy_gate;
+  quiet_hops_ = 0;
+  posteriors_.fill(0.0f);
+  score_ = 0.0f;
+  refractory_hops_ = 0;
+}
+
+bool WakeWordDetector::process(std::span<const int16_t> pcm) {
+  if (!ok_) return false;
+  bool detected = false;
+  if (pending_len_ != 0) {
+    const std::size_t n = std::min(pcm.size(), kHop - pending_len_);
+    std::memcpy(pending_.data() + pending_len_, pcm.data(),
+                n * sizeof(int16_t));
+    pending_len_ += n;
+    pcm = pcm.subspan(n);
+    if (pending_len_ < kHop) return false;
+    detected |= process_hop(pending_);
+    pending_len_ = 0;
+  }
+  while (pcm.size() >= kHop) {
+    detected |= process_hop(pcm.first(kHop));
+    pcm = pcm.subspan(kHop);
+  }
+  std::memcpy(pending_.data(), pcm.data(), pcm.size() * sizeof(int16_t));
+  pending_len_ = pcm.size();
+  return detected;
+}
+
+float WakeWordDetector::wake_posterior() const {
+  // Softmax over the logits, for the wake class only.
+  float max_logit = net_.logit(0);
+  for (std::size_t i = 1; i < net_.output_size(); ++i) {
+    max_logit = std::max(max_logit, net_.logit(i));
+  }
+  float sum = 0.0f;
+  for (std::size_t i = 0; i < net_.output_size(); ++i) {
+    sum += std::exp(net_.logit(i) - max_logit);
+  }
+  return std::exp(net_.logit(config_.wake_class) - max_logit) / sum;
+}
+
+bool WakeWordDetector::process_hop(std::span<const int16_t> hop) {
+  ++stats_.hops;
+  if (refractory_hops_ > 0) --refractory_hops_;
+  if (config_.energy_gate) {
+    if (vad_.process(hop)) {
+      quiet_hops_ = 0;
+      if (!gate_open_) {
+        gate_open_ = true;
+        net_.reset();
+        posteriors_.fill(0.0f);
+      }
+    } else if (gate_open_ && ++quiet_hops_ > config_.gate_hangover_hops) {
+      gate_open_ = false;
+      score_ = 0.0f;
+    }
+    if (!gate_open_) {
+      ++stats_.hops_gated;
+      frontend_.skip(hop);
+      return false;
+    }
+  }
+
+  frontend_.push(hop, features_);
+  net_.step(features_);
+  ++stats_.model_steps;
+
+  posteriors_[posterior_index_] = wake_posterior();
+  posterior_index_ = (posterior_index_ + 1) % config_.smoothing_frames;
+  float sum = 0.0f;
+  for (std::size_t i = 0; i < config_.smoothing_frames; ++i) {
+    sum += posteriors_[i];
+  }
+  score_ = sum / static_cast<float>(config_.smoothing_frames);
+  if (score_ < config_.threshold || refractory_hops_ > 0) return false;
+
+  ++stats_.detections;
+  refractory_hops_ = config_.refractory_ms / 10;
+  posteriors_.fill(0.0f);
+  return true;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,92 @@
+#ifndef XIAOZI_AUDIO_WAKE_WORD_H_
+#define XIAOZI_AUDIO_WAKE_WORD_H_
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "audio/energy_vad.h"
+#include "audio/int8_net.h"
+#include "audio/log_mel.h"
+
+namespace xiaozi {
+
+// Streaming wake-word detector on 16 kHz PCM. Every 10 ms hop adds one
+// log-mel frame and one Int8StreamingNet step; the posterior of the wake
+// class is averaged over a few frames and compared with a threshold.
+//
+// With the energy gate on, hops the EnergyVad calls silent (after a
+// hangover) only slide the feature window: no FFT and no model step. The
+// model history is reset when the gate reopens, so the first word after
+// silence is scored against the same "silence" context it was trained on.
+class WakeWordDetector {
+ public:
+  static constexpr std::size_t kHop = LogMelFrontend::kHop;
+
+  struct Config {
+    // Output index of the wake word; the others are background/filler.
+    std::size_t wake_class = 1;
+    float threshold = 0.7f;
+    // Posterior averaged over this many frames (1 .. kMaxSmoothing).
+    std::size_t smoothing_frames = 3;
+    // No second detection within this long after one.
+    uint32_t refractory_ms = 1000;
+    bool energy_gate = true;
+    // Hops kept running after the last active one, so a word's soft tail is
+    // still scored.
+    uint32_t gate_hangover_hops = 30;
+    EnergyVad::Config vad;
+  };
+
+  struct Stats {
+    uint64_t hops;
+    uint64_t hops_gated;  // skipped by the energy gate
+    uint64_t model_steps;
+    uint64_t detections;
+  };
+
+  static constexpr std::size_t kMaxSmoothing = 16;
+
+  // `model` must outlive the detector.
+  WakeWordDetector(const Int8Model& model, Config config);
+
+  // False if config.wake_class is not one of the model's outputs; process()
+  // then never detects.
+  bool ok() const { return ok_; }
+
+  // Any number of samples; returns true if the wake word was detected
+  // somewhere in them. Carries partial hops over to the next call.
+  bool process(std::span<const int16_t> pcm);
+  void reset();
+
+  // Smoothed wake posterior after the latest scored hop.
+  float score() const { return score_; }
+  bool gate_open() const { return gate_open_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  bool process_hop(std::span<const int16_t> hop);
+  float wake_posterior() const;
+
+  Config config_;
+  LogMelFrontend frontend_;
+  Int8StreamingNet net_;
+  EnergyVad vad_;
+  bool ok_;
+
+  std::array<int16_t, kHop> pending_{};
+  std::size_t pending_len_ = 0;
+  std::array<int8_t, LogMelFrontend::kBands> features_{};
+
+  bool gate_open_ = false;
+  uint32_t quiet_hops_ = 0;
+  std::array<float, kMaxSmoothing> posteriors_{};
+  std::size_t posterior_index_ = 0;
+  float score_ = 0.0f;
+  uint32_t refractory_hops_ = 0;
+  Stats stats_{};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_AUDIO_WAKE_WORD_H_
@@ -0,0 +1,15 @@
+#ifndef XIAOZI_BASE_BASE64_H_
+#define XIAOZI_BASE_BASE64_H_
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace xiaozi {
+
+// Standard alphabet with '=' padding.
+std::string base64_encode(std::span<const uint8_t> data);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BASE_BASE64_H_
@@ -0,0 +1,16 @@
+#ifndef XIAOZI_BASE_CACHE_H_
+#define XIAOZI_BASE_CACHE_H_
+
+#include <cstddef>
+
+namespace xiaozi {
+
+// Fixed rather than std::hardware_destructive_interference_size: the value
+// feeds struct layouts that are shared between translation units built with
+// different -march flags, so it must not depend on the compile target.
+// 64 bytes matches Xtensa LX7, Cortex-A and x86.
+inline constexpr std::size_t kCacheLineSize = 64;
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BASE_CACHE_H_
@@ -0,0 +1,20 @@
+#ifndef XIAOZI_BASE_CLOCK_H_
+#define XIAOZI_BASE_CLOCK_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace xiaozi {
+
+// Monotonic nanoseconds since an arbitrary epoch; the one time base for
+// frame timestamps, deadlines and latency counters.
+inline uint64_t monotonic_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BASE_CLOCK_H_
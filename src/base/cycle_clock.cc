@@ -0,0 +1,50 @@
+#include "base/cycle_clock.h"
+
+namespace xiaozi {
+namespace {
+
+// First estimate of the counter rate, measured once per process over 1 ms.
+double initial_ns_per_cycle() {
+  static const double rate = [] {
+    const uint64_t start_ns = monotonic_ns();
+    const uint64_t start_cycles = cycle_count();
+    uint64_t end_ns;
+    uint64_t end_cycles;
+    do {
+      end_ns = monotonic_ns();
+      end_cycles = cycle_count();
+    } while (end_ns - start_ns < 1000000);
+    return end_cycles == start_cycles
+               ? 1.0
+               : static_cast<double>(end_ns - start_ns) /
+                     static_cast<double>(end_cycles - start_cycles);
+  }();
+  return rate;
+}
+
+}  // namespace
+
+CycleClock::CycleClock(uint64_t reanchor_ns)
+    : reanchor_ns_(reanchor_ns), ns_per_cycle_(initial_ns_per_cycle()) {
+  first_ns_ = monotonic_ns();
+  first_cycles_ = cycle_count();
+  anchor_ns_ = first_ns_;
+  anchor_cycles_ = first_cycles_;
+  reanchor_cycles_ =
+      static_cast<uint64_t>(static_cast<double>(reanchor_ns_) / ns_per_cycle_);
+}
+
+uint64_t CycleClock::reanchor(uint64_t cycles) {
+  const uint64_t ns = monotonic_ns();
+  if (cycles > first_cycles_ && ns > first_ns_) {
+    ns_per_cycle_ = static_cast<double>(ns - first_ns_) /
+                    static_cast<double>(cycles - first_cycles_);
+    reanchor_cycles_ = static_cast<uint64_t>(
+        static_cast<double>(reanchor_ns_) / ns_per_cycle_);
+  }
+  anchor_cycles_ = cycles;
+  anchor_ns_ = ns;
+  return ns;
+}
+
+}  // namespace xiaozi
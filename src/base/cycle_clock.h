@@ -0,0 +1,62 @@
+#ifndef XIAOZI_BASE_CYCLE_CLOCK_H_
+#define XIAOZI_BASE_CYCLE_CLOCK_H_
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "base/clock.h"
+
+namespace xiaozi {
+
+// Raw hardware counter: TSC on x86, the generic timer on AArch64. A few
+// cycles to read, with no syscall or vDSO call. Frequency is unknown; use
+// CycleClock to convert.
+inline uint64_t cycle_count() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t v;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+#else
+  return monotonic_ns();
+#endif
+}
+
+// cycle_count() mapped onto the monotonic_ns() time base, so a cheap
+// reading can be subtracted from a frame timestamp. Every reanchor_ns it
+// takes one real monotonic_ns() reading, which bounds the drift and refines
+// the counter rate over the clock's lifetime. Not thread-safe: use one per
+// thread. Assumes an invariant counter (every x86 core of the last decade,
+// and the AArch64 generic timer by definition).
+class CycleClock {
+ public:
+  explicit CycleClock(uint64_t reanchor_ns = 10000000);
+
+  uint64_t now_ns() {
+    const uint64_t cycles = cycle_count();
+    if (cycles - anchor_cycles_ >= reanchor_cycles_) return reanchor(cycles);
+    return anchor_ns_ + static_cast<uint64_t>(
+                            static_cast<double>(cycles - anchor_cycles_) *
+                            ns_per_cycle_);
+  }
+  double ns_per_cycle() const { return ns_per_cycle_; }
+
+ private:
+  uint64_t reanchor(uint64_t cycles);
+
+  uint64_t reanchor_ns_;
+  uint64_t first_cycles_;
+  uint64_t first_ns_;
+  uint64_t anchor_cycles_;
+  uint64_t anchor_ns_;
+  uint64_t reanchor_cycles_;
+  double ns_per_cycle_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BASE_CYCLE_CLOCK_H_
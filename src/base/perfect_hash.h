@@ -0,0 +1,178 @@
+#ifndef XIAOZI_BASE_PERFECT_HASH_H_
+#define XIAOZI_BASE_PERFECT_HASH_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace xiaozi {
+
+// Collision-free lookup of a fixed key set (hash and displace): one hash
+// of the key picks a bucket and a slot, each bucket's displacement moves
+// its keys onto free slots, and one compare confirms the hit. Builds are
+// for sets of up to a few thousand keys; a set that will not place under
+// any salt (duplicate keys) fails to build.
+namespace perfect_hash {
+
+inline constexpr uint32_t kMaxSalts = 64;
+
+// FNV-1a with a salted basis and a final avalanche.
+constexpr uint64_t hash(std::string_view key, uint32_t salt) {
+  uint64_t h = 0xcbf29ce484222325ull ^ (salt * 0x9e3779b97f4a7c15ull);
+  for (char c : key) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 0x100000001b3ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return h;
+}
+
+constexpr std::size_t slot_count(std::size_t keys) {
+  return std::bit_ceil(std::max<std::size_t>(keys * 2, 1));
+}
+
+constexpr std::size_t bucket_count(std::size_t keys) {
+  return std::bit_ceil(std::max<std::size_t>(keys / 2, 1));
+}
+
+// Fills `displace` and `slots` (key index, -1 when empty); both sized by
+// the functions above. Returns the salt, or -1 if no salt worked.
+constexpr int64_t build(std::span<const std::string_view> keys,
+                        std::span<uint32_t> displace,
+                        std::span<int32_t> slots) {
+  const auto bucket_mask = static_cast<uint32_t>(displace.size() - 1);
+  const auto slot_mask = static_cast<uint32_t>(slots.size() - 1);
+  std::vector<uint64_t> hashes(keys.size());
+  for (uint32_t salt = 0; salt < kMaxSalts; ++salt) {
+    std::vector<std::vector<int32_t>> buckets(displace.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      hashes[i] = hash(keys[i], salt);
+      buckets[(hashes[i] >> 32) & bucket_mask].push_back(
+          static_cast<int32_t>(i));
+    }
+    // Largest buckets first, while most slots are still free.
+    std::vector<uint32_t> order(buckets.size());
+    for (std::size_t b = 0; b < order.size(); ++b) {
+      order[b] = static_cast<uint32_t>(b);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return buckets[a].size() > buckets[b].size();
+    });
+    std::fill(slots.begin(), slots.end(), -1);
+    std::fill(displace.begin(), displace.end(), 0u);
+
+    bool placed_all = true;
+    for (uint32_t b : order) {
+      const std::vector<int32_t>& members = buckets[b];
+      bool placed = members.empty();
+      for (uint32_t d = 0; !placed && d <= slot_mask; ++d) {
+        std::size_t taken = 0;
+        for (; taken < members.size(); ++taken) {
+          const uint32_t s =
+              (static_cast<uint32_t>(hashes[members[taken]]) ^ d) & slot_mask;
+          if (slots[s] != -1) break;
+          slots[s] = members[taken];
+        }
+        placed = taken == members.size();
+        for (std::size_t j = 0; !placed && j < taken; ++j) {
+          slots[(static_cast<uint32_t>(hashes[members[j]]) ^ d) &
+                slot_mask] = -1;
+        }
+        if (placed) displace[b] = d;
+      }
+      if (!placed) {
+        placed_all = false;
+        break;
+      }
+    }
+    if (placed_all) return salt;
+  }
+  return -1;
+}
+
+// Not constexpr: reaching it in a constant expression stops the build.
+inline void no_perfect_hash_for_these_keys() {}
+
+}  // namespace perfect_hash
+
+// A key set known at compile time, e.g. protocol method names:
+//   constexpr StaticPerfectHash<2> kMethods({"ping", "tools/list"});
+template <std::size_t N>
+class StaticPerfectHash {
+ public:
+  consteval explicit StaticPerfectHash(
+      const std::array<std::string_view, N>& keys)
+      : keys_(keys) {
+    const int64_t salt = perfect_hash::build(keys_, displace_, slots_);
+    if (salt < 0) perfect_hash::no_perfect_hash_for_these_keys();
+    salt_ = static_cast<uint32_t>(salt);
+  }
+
+  // Index of `key` in the constructor's array, or -1.
+  constexpr int find(std::string_view key) const {
+    const uint64_t h = perfect_hash::hash(key, salt_);
+    const uint32_t d = displace_[(h >> 32) & (kBuckets - 1)];
+    const int32_t i = slots_[(static_cast<uint32_t>(h) ^ d) & (kSlots - 1)];
+    return i >= 0 && keys_[i] == key ? i : -1;
+  }
+
+ private:
+  static constexpr std::size_t kSlots = perfect_hash::slot_count(N);
+  static constexpr std::size_t kBuckets = perfect_hash::bucket_count(N);
+
+  std::array<std::string_view, N> keys_;
+  std::array<uint32_t, kBuckets> displace_{};
+  std::array<int32_t, kSlots> slots_{};
+  uint32_t salt_ = 0;
+};
+
+// The same table over keys known only at run time. The keys are views:
+// their storage must outlive the table (or the next build()).
+class PerfectHash {
+ public:
+  PerfectHash() : displace_(1, 0), slots_(1, -1) {}
+
+  // False if the keys hold a duplicate; the table is then empty.
+  bool build(std::vector<std::string_view> keys) {
+    keys_ = std::move(keys);
+    displace_.assign(perfect_hash::bucket_count(keys_.size()), 0);
+    slots_.assign(perfect_hash::slot_count(keys_.size()), -1);
+    const int64_t salt = perfect_hash::build(keys_, displace_, slots_);
+    if (salt < 0) {
+      keys_.clear();
+      std::fill(slots_.begin(), slots_.end(), -1);
+      return false;
+    }
+    salt_ = static_cast<uint32_t>(salt);
+    return true;
+  }
+
+  // Index of `key` in the build() vector, or -1.
+  int find(std::string_view key) const {
+    const uint64_t h = perfect_hash::hash(key, salt_);
+    const uint32_t d = displace_[(h >> 32) & (displace_.size() - 1)];
+    const int32_t i =
+        slots_[(static_cast<uint32_t>(h) ^ d) & (slots_.size() - 1)];
+    return i >= 0 && keys_[static_cast<std::size_t>(i)] == key ? i : -1;
+  }
+
+  std::size_t size() const { return keys_.size(); }
+
+ private:
+  std::vector<std::string_view> keys_;
+  std::vector<uint32_t> displace_;
+  std::vector<int32_t> slots_;
+  uint32_t salt_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BASE_PERFECT_HASH_H_
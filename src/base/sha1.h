@@ -0,0 +1,39 @@
+#ifndef XIAOZI_BASE_SHA1_H_
+#define XIAOZI_BASE_SHA1_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xiaozi {
+
+// SHA-1 for protocol checks only (the WebSocket accept key). Not for
+// anything that needs collision resistance.
+class Sha1 {
+ public:
+  using Digest = std::array<uint8_t, 20>;
+
+  Sha1() { reset(); }
+  void reset();
+  void update(std::span<const uint8_t> data);
+  Digest finish();
+
+  static Digest of(std::span<const uint8_t> data) {
+    Sha1 h;
+    h.update(data);
+    return h.finish();
+  }
+
+ private:
+  void block(const uint8_t* p);
+
+  std::array<uint32_t, 5> state_;
+  std::array<uint8_t, 64> buffer_;
+  std::size_t buffered_ = 0;
+  uint64_t total_bytes_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BASE_SHA1_H_
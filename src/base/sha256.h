@@ -0,0 +1,39 @@
+#ifndef XIAOZI_BASE_SHA256_H_
+#define XIAOZI_BASE_SHA256_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xiaozi {
+
+// SHA-256, for firmware images: fed incrementally as the bytes arrive, so
+// verification costs no extra pass over flash.
+class Sha256 {
+ public:
+  using Digest = std::array<uint8_t, 32>;
+
+  Sha256() { reset(); }
+  void reset();
+  void update(std::span<const uint8_t> data);
+  Digest finish();
+
+  static Digest of(std::span<const uint8_t> data) {
+    Sha256 h;
+    h.update(data);
+    return h.finish();
+  }
+
+ private:
+  void block(const uint8_t* p);
+
+  std::array<uint32_t, 8> state_;
+  std::array<uint8_t, 64> buffer_;
+  std::size_t buffered_ = 0;
+  uint64_t total_bytes_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BASE_SHA256_H_
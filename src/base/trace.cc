@@ -0,0 +1,259 @@
+#include "base/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+#include "base/cache.h"
+#include "base/cycle_clock.h"
+
+namespace xiaozi::trace {
+namespace {
+
+// Threads that get private histograms (about 20 KB each, all static);
+// any more share one further set and pay for an atomic RMW per record. A
+// slot is freed when its thread exits, keeping its counts, and the next
+// thread to record takes it over. Set with the XIAOZI_TRACE_THREADS CMake
+// cache variable: the audio path records from about four threads.
+#ifndef XIAOZI_TRACE_THREADS
+#define XIAOZI_TRACE_THREADS 4
+#endif
+constexpr std::size_t kMaxThreads = XIAOZI_TRACE_THREADS;
+
+struct Histogram {
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum_ns{0};
+  std::atomic<uint64_t> max_ns{0};
+  std::array<std::atomic<uint32_t>, kBuckets> buckets{};
+};
+
+struct alignas(kCacheLineSize) ThreadHistograms {
+  std::atomic<bool> claimed{false};
+  std::array<Histogram, kStageCount> stages;
+};
+
+ThreadHistograms g_threads[kMaxThreads + 1];
+ThreadHistograms& g_shared = g_threads[kMaxThreads];
+
+ThreadHistograms* claim_slot() {
+  for (std::size_t i = 0; i < kMaxThreads; ++i) {
+    bool expected = false;
+    // Acquire: the previous owner's counts are the base for ours.
+    if (g_threads[i].claimed.compare_exchange_strong(
+            expected, true, std::memory_order_acquire,
+            std::memory_order_relaxed)) {
+      return &g_threads[i];
+    }
+  }
+  return nullptr;
+}
+
+// Holds the thread's slot until the thread exits.
+struct SlotLease {
+  ThreadHistograms* slot = claim_slot();
+  ~SlotLease() {
+    if (slot == nullptr) return;
+    slot->claimed.store(false, std::memory_order_release);
+    slot = nullptr;
+  }
+};
+
+thread_local SlotLease t_lease;
+
+// Event log: a ring of seqlocked slots. Slot i % kEventLogSize holds event
+// i once its sequence reads 2i + 2; odd means a write is in progress.
+struct EventSlot {
+  std::atomic<uint64_t> seq{0};
+  std::atomic<uint64_t> time_ns{0};
+  std::atomic<uint8_t> event{0};
+  std::array<std::atomic<int32_t>, kEventArgs> args{};
+};
+
+EventSlot g_events[kEventLogSize];
+std::atomic<uint64_t> g_next_event{0};
+thread_local CycleClock t_clock;
+
+// The owning thread is the only writer, so a load and a store suffice.
+template <typename T>
+void bump(std::atomic<T>& counter, T by) {
+  counter.store(counter.load(std::memory_order_relaxed) + by,
+                std::memory_order_relaxed);
+}
+
+}  // namespace
+
+const char* stage_name(Stage stage) {
+  switch (stage) {
+    case Stage::kCapture:
+      return "capture";
+    case Stage::kVad:
+      return "vad";
+    case Stage::kEncode:
+      return "encode";
+    case Stage::kSend:
+      return "send";
+    case Stage::kReceive:
+      return "receive";
+    case Stage::kDecode:
+      return "decode";
+    case Stage::kPlayback:
+      return "playback";
+    case Stage::kFirstAudio:
+      return "first_audio";
+    case Stage::kFirstByte:
+      return "first_byte";
+  }
+  return "unknown";
+}
+
+const char* event_name(Event event) {
+  switch (event) {
+    case Event::kRateChange:
+      return "rate_change";
+  }
+  return "unknown";
+}
+
+uint64_t bucket_floor(std::size_t index) {
+  if (index < kSubBuckets) return index;
+  const std::size_t exp = index / kSubBuckets + 3;
+  return (kSubBuckets + index % kSubBuckets) << (exp - 4);
+}
+
+uint64_t Snapshot::percentile(double q) const {
+  if (count == 0) return 0;
+  const auto rank = static_cast<uint64_t>(q * static_cast<double>(count));
+  uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets[i];
+    if (seen > rank) {
+      const uint64_t upper =
+          i + 1 < kBuckets ? bucket_floor(i + 1) - 1 : max_ns;
+      return std::min(upper, max_ns);
+    }
+  }
+  return max_ns;
+}
+
+uint64_t now_ns() { return t_clock.now_ns(); }
+
+void record(Stage stage, uint64_t latency_ns) {
+  const std::size_t bucket = bucket_index(latency_ns);
+  ThreadHistograms* slot = t_lease.slot;
+  if (slot == nullptr) {
+    Histogram& h = g_shared.stages[static_cast<std::size_t>(stage)];
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sum_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+    h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = h.max_ns.load(std::memory_order_relaxed);
+    while (latency_ns > max &&
+           !h.max_ns.compare_exchange_weak(max, latency_ns,
+                                           std::memory_order_relaxed)) {
+    }
+    return;
+  }
+  Histogram& h = slot->stages[static_cast<std::size_t>(stage)];
+  bump<uint64_t>(h.count, 1);
+  bump<uint64_t>(h.sum_ns, latency_ns);
+  bump<uint32_t>(h.buckets[bucket], 1);
+  if (latency_ns > h.max_ns.load(std::memory_order_relaxed)) {
+    h.max_ns.store(latency_ns, std::memory_order_relaxed);
+  }
+}
+
+Snapshot snapshot(Stage stage) {
+  Snapshot s;
+  for (const ThreadHistograms& t : g_threads) {
+    const Histogram& h = t.stages[static_cast<std::size_t>(stage)];
+    s.count += h.count.load(std::memory_order_relaxed);
+    s.sum_ns += h.sum_ns.load(std::memory_order_relaxed);
+    s.max_ns = std::max(s.max_ns, h.max_ns.load(std::memory_order_relaxed));
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      s.buckets[i] += h.buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return s;
+}
+
+void record_event(Event event, std::array<int32_t, kEventArgs> args) {
+  const uint64_t i = g_next_event.fetch_add(1, std::memory_order_relaxed);
+  EventSlot& slot = g_events[i % kEventLogSize];
+  slot.seq.store(2 * i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.time_ns.store(now_ns(), std::memory_order_relaxed);
+  slot.event.store(static_cast<uint8_t>(event), std::memory_order_relaxed);
+  for (std::size_t a = 0; a < kEventArgs; ++a) {
+    slot.args[a].store(args[a], std::memory_order_relaxed);
+  }
+  slot.seq.store(2 * i + 2, std::memory_order_release);
+}
+
+std::vector<EventRecord> events() {
+  std::vector<EventRecord> out;
+  const uint64_t end = g_next_event.load(std::memory_order_acquire);
+  const uint64_t begin = end > kEventLogSize ? end - kEventLogSize : 0;
+  for (uint64_t i = begin; i < end; ++i) {
+    const EventSlot& slot = g_events[i % kEventLogSize];
+    const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    // Still being written, or already overwritten by a later event.
+    if (seq != 2 * i + 2) continue;
+    EventRecord r;
+    r.time_ns = slot.time_ns.load(std::memory_order_relaxed);
+    r.event = static_cast<Event>(slot.event.load(std::memory_order_relaxed));
+    for (std::size_t a = 0; a < kEventArgs; ++a) {
+      r.args[a] = slot.args[a].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+    out.push_back(r);
+  }
+  return out;
+}
+
+void reset() {
+  for (EventSlot& slot : g_events) {
+    slot.seq.store(0, std::memory_order_relaxed);
+  }
+  g_next_event.store(0, std::memory_order_release);
+  for (ThreadHistograms& t : g_threads) {
+    for (Histogram& h : t.stages) {
+      h.count.store(0, std::memory_order_relaxed);
+      h.sum_ns.store(0, std::memory_order_relaxed);
+      h.max_ns.store(0, std::memory_order_relaxed);
+      for (auto& b : h.buckets) b.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+std::string format_stats() {
+  std::string out;
+  char line[256];
+  for (std::size_t i = 0; i < kStageCount; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    const Snapshot s = snapshot(stage);
+    if (s.count == 0) continue;
+    std::snprintf(line, sizeof(line),
+                  "%s count=%llu mean_us=%.1f p50_us=%.1f p90_us=%.1f "
+                  "p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+                  stage_name(stage), static_cast<unsigned long long>(s.count),
+                  s.mean_ns() / 1e3, s.percentile(0.5) / 1e3,
+                  s.percentile(0.9) / 1e3, s.percentile(0.99) / 1e3,
+                  s.percentile(0.999) / 1e3, s.max_ns / 1e3);
+    out += line;
+  }
+  for (const EventRecord& e : events()) {
+    switch (e.event) {
+      case Event::kRateChange:
+        std::snprintf(line, sizeof(line),
+                      "%s at_ms=%.1f bitrate=%d frame_ms=%d fec_loss_pct=%d "
+                      "reason=%d\n",
+                      event_name(e.event), e.time_ns / 1e6, e.args[0],
+                      e.args[1], e.args[2], e.args[3]);
+        break;
+    }
+    out += line;
+  }
+  return out;
+}
+
+}  // namespace xiaozi::trace
@@ -0,0 +1,138 @@
+#ifndef XIAOZI_BASE_TRACE_H_
+#define XIAOZI_BASE_TRACE_H_
+
+// Per-stage latency histograms for the audio path. Each frame carries its
+// origin in FrameRef::timestamp_ns (capture time on the uplink, arrival time
+// on the downlink); a stage records how long after that origin the frame
+// reached it. Comparing adjacent stages shows where the time goes.
+//
+// Control decisions that shape those latencies, such as a bitrate change,
+// go to a small event log next to the histograms.
+//
+// Built with XIAOZI_TRACE (CMake option, on by default). Without it the
+// XIAOZI_TRACE_* macros expand to nothing and their arguments are not
+// evaluated.
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xiaozi::trace {
+
+enum class Stage : uint8_t {
+  kCapture,     // captured PCM frame handed to processing
+  kVad,         // voice activity decision made
+  kEncode,      // packet encoded
+  kSend,        // packet handed to the kernel
+  kReceive,     // received packet handed to the decoder
+  kDecode,      // PCM decoded
+  kPlayback,    // PCM taken by the playback side
+  kFirstAudio,  // first sample of a reply played, since the reply began
+  kFirstByte,   // first audio byte handed to the kernel, since the wake
+};
+inline constexpr std::size_t kStageCount = 9;
+
+const char* stage_name(Stage stage);
+
+// Log-linear buckets in the spirit of HdrHistogram: exact below 16 ns, then
+// 16 sub-buckets per power of two (6% resolution) up to 2^36 ns (~69 s).
+inline constexpr std::size_t kSubBuckets = 16;
+inline constexpr std::size_t kBuckets = 34 * kSubBuckets;
+
+inline std::size_t bucket_index(uint64_t ns) {
+  if (ns < kSubBuckets) return static_cast<std::size_t>(ns);
+  const int exp = 63 - __builtin_clzll(ns);
+  if (exp > 36) return kBuckets - 1;
+  const auto sub = static_cast<std::size_t>(ns >> (exp - 4)) & 15;
+  return static_cast<std::size_t>(exp - 3) * kSubBuckets + sub;
+}
+
+// Smallest value that lands in bucket `index`.
+uint64_t bucket_floor(std::size_t index);
+
+struct Snapshot {
+  uint64_t count = 0;
+  uint64_t sum_ns = 0;
+  uint64_t max_ns = 0;
+  std::array<uint64_t, kBuckets> buckets{};
+
+  // Upper edge of the bucket holding quantile q (0..1); 0 when empty.
+  uint64_t percentile(double q) const;
+  double mean_ns() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum_ns) / count;
+  }
+};
+
+// TSC-based clock in the monotonic_ns() time base.
+uint64_t now_ns();
+
+// Any thread, lock-free. Up to XIAOZI_TRACE_THREADS live threads write
+// their own histograms (plain relaxed stores, no shared cache lines), any
+// others a shared set; readers merge them.
+void record(Stage stage, uint64_t latency_ns);
+
+inline void record_since(Stage stage, uint64_t origin_ns) {
+  // Unstamped frames (origin 0), e.g. concealment output, are skipped.
+  if (origin_ns == 0) return;
+  const uint64_t now = now_ns();
+  record(stage, now > origin_ns ? now - origin_ns : 0);
+}
+
+// Merged over all threads. Concurrent records may or may not be included.
+Snapshot snapshot(Stage stage);
+
+enum class Event : uint8_t {
+  // bitrate, frame_ms, fec_loss_pct (-1 if off), reason (controller enum)
+  kRateChange,
+};
+
+const char* event_name(Event event);
+
+inline constexpr std::size_t kEventArgs = 4;
+// The newest kEventLogSize events are kept.
+inline constexpr std::size_t kEventLogSize = 64;
+
+struct EventRecord {
+  uint64_t time_ns = 0;  // now_ns() time base
+  Event event = Event::kRateChange;
+  std::array<int32_t, kEventArgs> args{};
+};
+
+// Any thread, lock-free; a reader never sees a half-written record.
+void record_event(Event event, std::array<int32_t, kEventArgs> args);
+// Oldest first.
+std::vector<EventRecord> events();
+
+// Clears the histograms and the event log.
+void reset();
+
+// Reply to the `stats` command (add_stats_tool() in protocol/mcp_server.h):
+// one line per stage that has samples,
+//   <stage> count=<n> mean_us=<x> p50_us=<x> p90_us=<x> p99_us=<x>
+//   p999_us=<x> max_us=<x>
+// then one per logged event, oldest first, e.g.
+//   rate_change at_ms=<t> bitrate=<n> frame_ms=<n> fec_loss_pct=<n>
+//   reason=<n>
+std::string format_stats();
+
+}  // namespace xiaozi::trace
+
+#if defined(XIAOZI_TRACE)
+#define XIAOZI_TRACE_SINCE(stage, origin_ns) \
+  ::xiaozi::trace::record_since(::xiaozi::trace::Stage::stage, (origin_ns))
+#define XIAOZI_TRACE_FRAME(stage, frame) \
+  XIAOZI_TRACE_SINCE(stage, (frame).timestamp_ns())
+#define XIAOZI_TRACE_RECORD(stage, latency_ns) \
+  ::xiaozi::trace::record(::xiaozi::trace::Stage::stage, (latency_ns))
+#define XIAOZI_TRACE_EVENT(event, ...)                        \
+  ::xiaozi::trace::record_event(::xiaozi::trace::Event::event, \
+                                {__VA_ARGS__})
+#else
+#define XIAOZI_TRACE_SINCE(stage, origin_ns) ((void)0)
+#define XIAOZI_TRACE_FRAME(stage, frame) ((void)0)
+#define XIAOZI_TRACE_RECORD(stage, latency_ns) ((void)0)
+#define XIAOZI_TRACE_EVENT(event, ...) ((void)0)
+#endif
+
+#endif  // XIAOZI_BASE_TRACE_H_
@@ -0,0 +1,197 @@
+#ifndef XIAOZI_BOARD_AUDIO_PATH_H_
+#define XIAOZI_BOARD_AUDIO_PATH_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#include "audio/beamformer.h"
+#include "audio/pcm_kernels.h"
+#include "base/trace.h"
+#include "board/board.h"
+
+namespace xiaozi {
+
+// I2S DMA words -> 16 kHz mono PCM for one board. Slot stride, sample
+// width, gain and whether to decimate are template constants, so the
+// per-sample loop has no calls or branches and vectorizes; the only
+// runtime dispatch left is pcm::Downsampler3 choosing its kernel once per
+// block. The gain matches pcm::apply_gain_q12 bit for bit.
+//
+// Each process() takes `dma_ns`, the monotonic_ns() time the driver got the
+// DMA block, and records the capture trace stage against it once the PCM
+// is out; 0 records nothing.
+//
+// Single-threaded: owned by the capture driver.
+template <Board B>
+class CapturePath {
+ public:
+  static constexpr I2sLayout kLayout = B::kCapture;
+  using Word = I2sWord<kLayout.slot_bits>;
+  static constexpr bool kDecimate = kLayout.rate != kPipelineRate;
+  static constexpr bool kHasReference = kLayout.ref_slot >= 0;
+
+  // Upper bound on samples process() writes for `frames` bus frames.
+  static constexpr std::size_t max_output(std::size_t frames) {
+    return kDecimate ? frames / 3 + 1 : frames;
+  }
+
+  void reset() {
+    mic_down_.reset();
+    ref_down_.reset();
+  }
+
+  // Consumes whole frames of `dma` (slots interleaved) and writes the mic
+  // channel to `out`, which must hold max_output(frames). Returns samples
+  // written.
+  std::size_t process(std::span<const Word> dma, int16_t* out,
+                      [[maybe_unused]] uint64_t dma_ns = 0) {
+    const std::size_t frames = dma.size() / kLayout.slots;
+    std::size_t written = 0;
+    if constexpr (!kDecimate) {
+      extract<kLayout.mic_slot, true>(dma.data(), out, frames);
+      written = frames;
+    } else {
+      for (std::size_t done = 0; done < frames; done += kChunk) {
+        const std::size_t n = std::min(kChunk, frames - done);
+        extract<kLayout.mic_slot, true>(dma.data() + done * kLayout.slots,
+                                        scratch_, n);
+        written += mic_down_.process({scratch_, n}, out + written);
+      }
+    }
+    XIAOZI_TRACE_SINCE(kCapture, dma_ns);
+    return written;
+  }
+
+  // process() plus the speaker loopback slot, without gain, through a
+  // decimator of its own: mic and reference come out of the same bus
+  // frames and the same filter, so they stay sample-aligned for the echo
+  // canceller. `out` and `ref` must each hold max_output(frames); both get
+  // the returned number of samples.
+  std::size_t process(std::span<const Word> dma, int16_t* out, int16_t* ref,
+                      [[maybe_unused]] uint64_t dma_ns = 0)
+    requires kHasReference
+  {
+    const std::size_t frames = dma.size() / kLayout.slots;
+    std::size_t written = 0;
+    if constexpr (!kDecimate) {
+      extract<kLayout.mic_slot, true>(dma.data(), out, frames);
+      extract<kLayout.ref_slot, false>(dma.data(), ref, frames);
+      written = frames;
+    } else {
+      for (std::size_t done = 0; done < frames; done += kChunk) {
+        const std::size_t n = std::min(kChunk, frames - done);
+        const Word* in = dma.data() + done * kLayout.slots;
+        extract<kLayout.mic_slot, true>(in, scratch_, n);
+        const std::size_t m = mic_down_.process({scratch_, n}, out + written);
+        extract<kLayout.ref_slot, false>(in, scratch_, n);
+        ref_down_.process({scratch_, n}, ref + written);
+        written += m;
+      }
+    }
+    XIAOZI_TRACE_SINCE(kCapture, dma_ns);
+    return written;
+  }
+
+  // process() for mic-array boards: `beam`, set up for this bus (rate and
+  // slots), combines its mics straight from the DMA words, and the beam
+  // takes the mic's gain and decimation in place of the mic slot. `dma`
+  // must be a whole number of beam.hop() frames; returns samples written,
+  // short of max_output() only if the beamformer refused the shape.
+  std::size_t process(std::span<const Word> dma, Beamformer& beam,
+                      int16_t* out, [[maybe_unused]] uint64_t dma_ns = 0) {
+    const std::size_t frames = dma.size() / kLayout.slots;
+    dma = dma.first(frames * kLayout.slots);
+    std::size_t written = 0;
+    if constexpr (!kDecimate) {
+      if (!beam.process(dma, kLayout.slots, {out, frames})) return 0;
+      gain(out, frames);
+      written = frames;
+    } else {
+      for (std::size_t done = 0; done < frames; done += kChunk) {
+        const std::size_t n = std::min(kChunk, frames - done);
+        if (!beam.process(dma.subspan(done * kLayout.slots, n * kLayout.slots),
+                          kLayout.slots, {scratch_, n})) {
+          break;
+        }
+        gain(scratch_, n);
+        written += mic_down_.process({scratch_, n}, out + written);
+      }
+    }
+    XIAOZI_TRACE_SINCE(kCapture, dma_ns);
+    return written;
+  }
+
+  // The speaker loopback slot at the bus rate, without gain. `out` must
+  // hold dma.size() / slots samples.
+  std::size_t reference(std::span<const Word> dma, int16_t* out)
+    requires kHasReference
+  {
+    const std::size_t frames = dma.size() / kLayout.slots;
+    extract<kLayout.ref_slot, false>(dma.data(), out, frames);
+    return frames;
+  }
+
+ private:
+  static constexpr std::size_t kChunk = 480;  // 10 ms at 48 kHz
+
+  template <int Slot, bool Gain>
+  static void extract(const Word* in, int16_t* out, std::size_t frames) {
+    for (std::size_t i = 0; i < frames; ++i) {
+      int32_t s = in[i * kLayout.slots + Slot];
+      if constexpr (kLayout.slot_bits == 32) s >>= 16;
+      if constexpr (Gain && B::kMicGainQ12 != 4096) {
+        s = (s * B::kMicGainQ12 + 2048) >> 12;
+        s = std::clamp(s, int32_t{-32768}, int32_t{32767});
+      }
+      out[i] = static_cast<int16_t>(s);
+    }
+  }
+
+  static void gain(int16_t* pcm, std::size_t n) {
+    if constexpr (B::kMicGainQ12 != 4096) {
+      for (std::size_t i = 0; i < n; ++i) {
+        const int32_t s = (pcm[i] * B::kMicGainQ12 + 2048) >> 12;
+        pcm[i] = static_cast<int16_t>(
+            std::clamp(s, int32_t{-32768}, int32_t{32767}));
+      }
+    }
+  }
+
+  struct Empty {
+    void reset() {}
+  };
+  using Down = std::conditional_t<kDecimate, pcm::Downsampler3, Empty>;
+
+  using RefDown =
+      std::conditional_t<kDecimate && kHasReference, pcm::Downsampler3, Empty>;
+
+  [[no_unique_address]] Down mic_down_;
+  [[no_unique_address]] RefDown ref_down_;
+  int16_t scratch_[kDecimate ? kChunk : 1];
+};
+
+// Mono PCM at the playback rate -> I2S DMA words, copied into every slot
+// so either amp channel (or both) can be wired.
+template <Board B>
+struct PlaybackPath {
+  static constexpr I2sLayout kLayout = B::kPlayback;
+  using Word = I2sWord<kLayout.slot_bits>;
+
+  // `dma` must hold pcm.size() * kLayout.slots words. Returns words
+  // written.
+  static std::size_t render(std::span<const int16_t> pcm, Word* dma) {
+    for (std::size_t i = 0; i < pcm.size(); ++i) {
+      Word w = pcm[i];
+      if constexpr (kLayout.slot_bits == 32) w *= 65536;
+      for (int s = 0; s < kLayout.slots; ++s) dma[i * kLayout.slots + s] = w;
+    }
+    return pcm.size() * kLayout.slots;
+  }
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BOARD_AUDIO_PATH_H_
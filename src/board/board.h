@@ -0,0 +1,74 @@
+#ifndef XIAOZI_BOARD_BOARD_H_
+#define XIAOZI_BOARD_BOARD_H_
+
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+
+namespace xiaozi {
+
+// Boards are policy types, not objects: every property the audio path
+// depends on is a constexpr member, so code templated on a board compiles
+// to straight-line loops for exactly that hardware. Nothing here is
+// virtual, and builds only instantiate the board they target.
+
+enum class CodecChip : uint8_t {
+  kNone,    // PDM/I2S MEMS mic and class-D amp wired straight to I2S
+  kEs7210,  // 4-channel ADC, TDM capture
+  kEs8311,  // mono codec, DAC and ADC
+};
+
+enum class UplinkCodec : uint8_t { kG711, kOpus };
+
+// One direction of the I2S bus as DMA delivers it. Samples are
+// left-justified in their slot, as every supported chip sends them.
+struct I2sLayout {
+  int rate;       // frames per second on the bus
+  int slot_bits;  // 16 or 32
+  int slots;      // slots per frame: 1 mono, 2 stereo, up to 8 TDM
+  int mic_slot;   // capture: slot carrying the microphone
+  int ref_slot;   // capture: loopback of the speaker signal, or -1
+};
+
+// A board provides:
+//   static constexpr const char* kName;
+//   static constexpr I2sLayout kCapture;    // what the ADC sends
+//   static constexpr I2sLayout kPlayback;   // what the DAC expects
+//   static constexpr CodecChip kCodecChip;
+//   static constexpr UplinkCodec kUplinkCodec;
+//   static constexpr int16_t kMicGainQ12;   // fixed front-end gain, Q3.12
+template <typename B>
+concept Board = requires {
+  { B::kName } -> std::convertible_to<const char*>;
+  { B::kCapture } -> std::convertible_to<I2sLayout>;
+  { B::kPlayback } -> std::convertible_to<I2sLayout>;
+  { B::kCodecChip } -> std::convertible_to<CodecChip>;
+  { B::kUplinkCodec } -> std::convertible_to<UplinkCodec>;
+  { B::kMicGainQ12 } -> std::convertible_to<int16_t>;
+} && std::is_empty_v<B>;
+
+// The wake word, VAD and uplink encoder all run at 16 kHz.
+inline constexpr int kPipelineRate = 16000;
+
+constexpr bool valid_layout(const I2sLayout& l) {
+  return (l.slot_bits == 16 || l.slot_bits == 32) && l.slots >= 1 &&
+         l.slots <= 8 && l.mic_slot >= 0 && l.mic_slot < l.slots &&
+         l.ref_slot >= -1 && l.ref_slot < l.slots && l.ref_slot != l.mic_slot;
+}
+
+// Capture is either at the pipeline rate or three times it; the 48 kHz
+// case goes through pcm::Downsampler3.
+template <Board B>
+constexpr bool valid_board() {
+  return valid_layout(B::kCapture) && valid_layout(B::kPlayback) &&
+         (B::kCapture.rate == kPipelineRate ||
+          B::kCapture.rate == 3 * kPipelineRate);
+}
+
+// The word type DMA buffers hold for a layout.
+template <int SlotBits>
+using I2sWord = std::conditional_t<SlotBits == 16, int16_t, int32_t>;
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BOARD_BOARD_H_
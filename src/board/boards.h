@@ -0,0 +1,62 @@
+#ifndef XIAOZI_BOARD_BOARDS_H_
+#define XIAOZI_BOARD_BOARDS_H_
+
+#include "board/board.h"
+
+namespace xiaozi {
+
+// Host builds and simulated devices: 16-bit mono in and out, no codec
+// chip, G.711 so libopus is not required.
+struct HostBoard {
+  static constexpr const char* kName = "host";
+  static constexpr I2sLayout kCapture = {16000, 16, 1, 0, -1};
+  static constexpr I2sLayout kPlayback = {16000, 16, 1, 0, -1};
+  static constexpr CodecChip kCodecChip = CodecChip::kNone;
+  static constexpr UplinkCodec kUplinkCodec = UplinkCodec::kG711;
+  static constexpr int16_t kMicGainQ12 = 4096;
+};
+
+// Breadboard build: INMP441 mic and MAX98357 amp on separate I2S ports.
+// The mic sends 24 bits in 32-bit stereo slots with only the left one
+// populated, and is quiet enough to need +12 dB.
+struct Inmp441Board {
+  static constexpr const char* kName = "inmp441";
+  static constexpr I2sLayout kCapture = {16000, 32, 2, 0, -1};
+  static constexpr I2sLayout kPlayback = {24000, 32, 2, 0, -1};
+  static constexpr CodecChip kCodecChip = CodecChip::kNone;
+  static constexpr UplinkCodec kUplinkCodec = UplinkCodec::kOpus;
+  static constexpr int16_t kMicGainQ12 = 16384;
+};
+
+// ES7210 capturing 4-slot TDM at 48 kHz (mic on slot 0, speaker loopback
+// on slot 2 for echo cancellation) and an ES8311 driving the speaker.
+struct Es7210Board {
+  static constexpr const char* kName = "es7210";
+  static constexpr I2sLayout kCapture = {48000, 16, 4, 0, 2};
+  static constexpr I2sLayout kPlayback = {24000, 16, 2, 0, -1};
+  static constexpr CodecChip kCodecChip = CodecChip::kEs7210;
+  static constexpr UplinkCodec kUplinkCodec = UplinkCodec::kOpus;
+  static constexpr int16_t kMicGainQ12 = 4096;
+};
+
+static_assert(Board<HostBoard> && valid_board<HostBoard>());
+static_assert(Board<Inmp441Board> && valid_board<Inmp441Board>());
+static_assert(Board<Es7210Board> && valid_board<Es7210Board>());
+
+// The board this build targets, picked by XIAOZI_BOARD in CMake.
+#if defined(XIAOZI_BOARD_INMP441)
+using CurrentBoard = Inmp441Board;
+#elif defined(XIAOZI_BOARD_ES7210)
+using CurrentBoard = Es7210Board;
+#else
+using CurrentBoard = HostBoard;
+#endif
+
+#if !defined(XIAOZI_HAVE_OPUS)
+static_assert(CurrentBoard::kUplinkCodec != UplinkCodec::kOpus,
+              "board needs Opus but the build has no libopus");
+#endif
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_BOARD_BOARDS_H_
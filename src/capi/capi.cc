@@ -0,0 +1,362 @@
+#include "capi/xiaozi.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "audio/jitter_buffer.h"
+#include "codec/audio_codec.h"
+#include "codec/g711_codec.h"
+#include "memory/frame_pool.h"
+#include "net/tcp_stream.h"
+#include "net/websocket_transport.h"
+
+#if defined(XIAOZI_HAVE_OPUS)
+#include "codec/opus_codec.h"
+#endif
+
+namespace xiaozi {
+namespace {
+
+// Copies a caller's struct over `out` (already holding defaults), taking
+// only the fields its struct_size says it knows about.
+template <typename T>
+bool read_versioned(const T* in, T* out) {
+  if (in == nullptr) return true;
+  if (in->struct_size < sizeof(uint32_t)) return false;
+  const std::size_t n = std::min<std::size_t>(in->struct_size, sizeof(T));
+  std::memcpy(static_cast<void*>(out), in, n);
+  out->struct_size = sizeof(T);
+  return true;
+}
+
+template <typename T>
+int write_versioned(const T& in, T* out) {
+  if (out == nullptr || out->struct_size < sizeof(uint32_t)) return -EINVAL;
+  const uint32_t size = out->struct_size;
+  std::memcpy(static_cast<void*>(out), &in,
+              std::min<std::size_t>(size, sizeof(T)));
+  out->struct_size = size;
+  return 0;
+}
+
+bool valid_params(int sample_rate, int frame_ms) {
+  return sample_rate >= 8000 && sample_rate <= 48000 &&
+         sample_rate % 1000 == 0 &&
+         (frame_ms == 10 || frame_ms == 20 || frame_ms == 40 ||
+          frame_ms == 60);
+}
+
+std::unique_ptr<AudioEncoder> make_encoder(xz_codec codec, int sample_rate,
+                                           int frame_ms, int bitrate) {
+  if (!valid_params(sample_rate, frame_ms)) return nullptr;
+  switch (codec) {
+    case XZ_CODEC_G711:
+      return std::make_unique<G711Encoder>(sample_rate,
+                                           sample_rate / 1000 * frame_ms);
+    case XZ_CODEC_OPUS:
+#if defined(XIAOZI_HAVE_OPUS)
+    {
+      auto e = std::make_unique<OpusAudioEncoder>(sample_rate, frame_ms,
+                                                  bitrate);
+      if (e->ok()) return e;
+    }
+#endif
+      break;
+  }
+  (void)bitrate;
+  return nullptr;
+}
+
+std::unique_ptr<AudioDecoder> make_decoder(xz_codec codec, int sample_rate,
+                                           int frame_ms) {
+  if (!valid_params(sample_rate, frame_ms)) return nullptr;
+  switch (codec) {
+    case XZ_CODEC_G711:
+      return std::make_unique<G711Decoder>(sample_rate,
+                                           sample_rate / 1000 * frame_ms);
+    case XZ_CODEC_OPUS:
+#if defined(XIAOZI_HAVE_OPUS)
+    {
+      auto d = std::make_unique<OpusAudioDecoder>(sample_rate, frame_ms);
+      if (d->ok()) return d;
+    }
+#endif
+      break;
+  }
+  return nullptr;
+}
+
+// Packets the jitter buffer can hold plus what the transport thread may be
+// copying in meanwhile.
+constexpr std::size_t kJitterPoolPackets = JitterBuffer::kSlots + 16;
+
+}  // namespace
+}  // namespace xiaozi
+
+using namespace xiaozi;
+
+struct xz_encoder {
+  std::unique_ptr<AudioEncoder> codec;
+};
+
+struct xz_decoder {
+  std::unique_ptr<AudioDecoder> codec;
+};
+
+struct xz_jitter {
+  xz_jitter(const JitterBuffer::Config& config, std::size_t max_packet)
+      : pool(max_packet, kJitterPoolPackets, MemoryDomain::kAudio),
+        buffer(config) {}
+
+  FramePool pool;
+  JitterBuffer buffer;
+};
+
+struct xz_session {
+  explicit xz_session(WebSocketTransport::Config config)
+      : transport(std::move(config)) {}
+
+  WebSocketTransport transport;
+  std::unique_ptr<AudioEncoder> encoder;
+  std::size_t max_packet_bytes = 0;
+};
+
+extern "C" {
+
+uint32_t xz_abi_version(void) { return XZ_ABI_VERSION; }
+
+xz_encoder* xz_encoder_create(xz_codec codec, int sample_rate, int frame_ms,
+                              int bitrate) {
+  auto e = make_encoder(codec, sample_rate, frame_ms, bitrate);
+  return e ? new (std::nothrow) xz_encoder{std::move(e)} : nullptr;
+}
+
+void xz_encoder_destroy(xz_encoder* encoder) { delete encoder; }
+
+int xz_encoder_frame_samples(const xz_encoder* encoder) {
+  return encoder->codec->frame_samples();
+}
+
+int xz_encoder_encode(xz_encoder* encoder, const int16_t* pcm,
+                      size_t samples, uint8_t* out, size_t capacity) {
+  if (samples != static_cast<size_t>(encoder->codec->frame_samples())) {
+    return -EINVAL;
+  }
+  const int n = encoder->codec->encode({pcm, samples}, {out, capacity});
+  return n < 0 ? -EMSGSIZE : n;
+}
+
+void xz_encoder_set_bitrate(xz_encoder* encoder, int bitrate) {
+  encoder->codec->set_bitrate(bitrate);
+}
+
+xz_decoder* xz_decoder_create(xz_codec codec, int sample_rate,
+                              int frame_ms) {
+  auto d = make_decoder(codec, sample_rate, frame_ms);
+  return d ? new (std::nothrow) xz_decoder{std::move(d)} : nullptr;
+}
+
+void xz_decoder_destroy(xz_decoder* decoder) { delete decoder; }
+
+int xz_decoder_frame_samples(const xz_decoder* decoder) {
+  return decoder->codec->frame_samples();
+}
+
+int xz_decoder_decode(xz_decoder* decoder, const uint8_t* packet,
+                      size_t size, int16_t* pcm, size_t capacity) {
+  const int n = packet == nullptr
+                    ? decoder->codec->conceal({pcm, capacity})
+                    : decoder->codec->decode({packet, size}, {pcm, capacity});
+  return n < 0 ? -EINVAL : n;
+}
+
+void xz_jitter_config_init(xz_jitter_config* config) {
+  const JitterBuffer::Config defaults;
+  *config = {sizeof(xz_jitter_config), defaults.frame_ms, defaults.min_frames,
+             defaults.max_frames, 1276};
+}
+
+xz_jitter* xz_jitter_create(const xz_jitter_config* config) {
+  xz_jitter_config c;
+  xz_jitter_config_init(&c);
+  if (!read_versioned(config, &c) || c.frame_ms == 0 || c.min_frames == 0 ||
+      c.max_frames < c.min_frames || c.max_frames >= JitterBuffer::kSlots ||
+      c.max_packet_bytes == 0) {
+    return nullptr;
+  }
+  JitterBuffer::Config jc;
+  jc.frame_ms = c.frame_ms;
+  jc.min_frames = c.min_frames;
+  jc.max_frames = c.max_frames;
+  return new (std::nothrow) xz_jitter(jc, c.max_packet_bytes);
+}
+
+void xz_jitter_destroy(xz_jitter* jitter) { delete jitter; }
+
+int xz_jitter_push(xz_jitter* jitter, uint32_t sequence, uint64_t arrival_ns,
+                   const uint8_t* data, size_t size) {
+  if (size > jitter->pool.block_size()) return -EMSGSIZE;
+  FrameRef packet = jitter->pool.acquire();
+  if (!packet) return -ENOBUFS;
+  std::memcpy(packet.data(), data, size);
+  packet.set_size(size);
+  packet.set_sequence(sequence);
+  packet.set_timestamp_ns(arrival_ns);
+  return jitter->buffer.push(std::move(packet)) ? 0 : -ENOBUFS;
+}
+
+int xz_jitter_pop(xz_jitter* jitter, uint8_t* out, size_t capacity,
+                  size_t* size) {
+  FrameRef packet;
+  switch (jitter->buffer.pop(packet)) {
+    case JitterBuffer::Status::kPacket:
+      if (packet.size() > capacity) return -EMSGSIZE;
+      std::memcpy(out, packet.data(), packet.size());
+      *size = packet.size();
+      return XZ_JITTER_PACKET;
+    case JitterBuffer::Status::kLost:
+      return XZ_JITTER_LOST;
+    case JitterBuffer::Status::kNotReady:
+      break;
+  }
+  return XZ_JITTER_NOT_READY;
+}
+
+void xz_jitter_reset(xz_jitter* jitter) { jitter->buffer.reset(); }
+
+int xz_jitter_get_stats(const xz_jitter* jitter, xz_jitter_stats* stats) {
+  const JitterBuffer::Stats s = jitter->buffer.stats();
+  const xz_jitter_stats out = {
+      sizeof(xz_jitter_stats), s.target_frames, s.depth_frames, s.received,
+      s.late, s.duplicates, s.lost, s.dropped, s.underruns, s.jitter_ms};
+  return write_versioned(out, stats);
+}
+
+void xz_session_config_init(xz_session_config* config) {
+  *config = {};
+  config->struct_size = sizeof(xz_session_config);
+  config->latency_budget_us = 10000;
+  config->connect_timeout_ms = 5000;
+  config->verify_peer = 1;
+  config->codec = XZ_CODEC_G711;
+  config->sample_rate = 16000;
+  config->frame_ms = 60;
+  config->bitrate = 24000;
+}
+
+xz_session* xz_session_create(const xz_session_config* config) {
+  xz_session_config c;
+  xz_session_config_init(&c);
+  if (config == nullptr || !read_versioned(config, &c)) return nullptr;
+
+  WebSocketTransport::Config tc;
+  if (c.url != nullptr) tc.url = c.url;
+  for (size_t i = 0; i < c.header_count; ++i) {
+    tc.headers.emplace_back(c.header_names[i], c.header_values[i]);
+  }
+  tc.latency_budget = std::chrono::microseconds(c.latency_budget_us);
+  tc.connect_timeout_ms = c.connect_timeout_ms;
+  tc.verify_peer = c.verify_peer != 0;
+  if (c.hello != nullptr) tc.hello = c.hello;
+
+  auto encoder = make_encoder(c.codec, c.sample_rate, c.frame_ms, c.bitrate);
+  if (!encoder) return nullptr;
+  auto* session = new (std::nothrow) xz_session(tc);
+  if (session == nullptr) return nullptr;
+  session->encoder = std::move(encoder);
+  session->max_packet_bytes = tc.max_packet_bytes;
+
+  void* user = c.user;
+  if (xz_audio_fn fn = c.on_audio) {
+    session->transport.set_audio_handler([fn, user](FrameRef packet) {
+      fn(user, packet.data(), packet.size());
+    });
+  }
+  if (xz_text_fn fn = c.on_text) {
+    session->transport.set_text_handler([fn, user](std::string_view m) {
+      fn(user, m.data(), m.size());
+    });
+  }
+  if (xz_close_fn fn = c.on_close) {
+    session->transport.set_close_handler([fn, user] { fn(user); });
+  }
+  return session;
+}
+
+void xz_session_destroy(xz_session* session) { delete session; }
+
+int xz_session_open(xz_session* session) {
+  return session->transport.open() ? 0 : -ECONNREFUSED;
+}
+
+int xz_session_attach_fd(xz_session* session, int fd) {
+  if (fd < 0) return -EBADF;
+  session->transport.attach(std::make_unique<TcpStream>(fd));
+  return 0;
+}
+
+void xz_session_close(xz_session* session) { session->transport.close(); }
+
+int xz_session_is_open(const xz_session* session) {
+  return session->transport.is_open() ? 1 : 0;
+}
+
+void xz_session_poll(xz_session* session, int timeout_ms) {
+  session->transport.poll(timeout_ms);
+}
+
+int xz_session_send_text(xz_session* session, const char* message,
+                         size_t size) {
+  return session->transport.send_text({message, size}) ? 0 : -ENOTCONN;
+}
+
+int xz_session_send_audio(xz_session* session, const uint8_t* packet,
+                          size_t size, uint64_t capture_ns) {
+  if (size > session->max_packet_bytes) return -EMSGSIZE;
+  std::span<uint8_t> out = session->transport.reserve(size);
+  if (out.empty()) return -ENOBUFS;
+  if (out.size() < size) return -EMSGSIZE;
+  std::memcpy(out.data(), packet, size);
+  return session->transport.commit(size, capture_ns) ? 0 : -ENOBUFS;
+}
+
+int xz_session_send_pcm(xz_session* session, const int16_t* pcm,
+                        size_t samples, uint64_t capture_ns) {
+  AudioEncoder& encoder = *session->encoder;
+  if (samples != static_cast<size_t>(encoder.frame_samples())) {
+    return -EINVAL;
+  }
+  std::span<uint8_t> out =
+      session->transport.reserve(session->max_packet_bytes);
+  if (out.empty()) return -ENOBUFS;
+  const int n = encoder.encode({pcm, samples}, out);
+  if (n < 0) {
+    session->transport.commit(0, capture_ns);
+    return -EIO;
+  }
+  return session->transport.commit(static_cast<size_t>(n), capture_ns)
+             ? n
+             : -ENOBUFS;
+}
+
+int xz_session_get_stats(const xz_session* session, xz_session_stats* stats) {
+  const TransportStats s = session->transport.stats();
+  const xz_session_stats out = {
+      sizeof(xz_session_stats), s.queue_depth,          s.packets_sent,
+      s.bytes_sent,             s.send_syscalls,        s.packets_received,
+      s.bytes_received,         s.packets_dropped,      s.queue_delay_total_ns,
+      s.queue_delay_max_ns,     s.connects,             s.resumed_connects,
+      s.early_data_connects,    s.connect_ns,           s.first_byte_ns,
+      s.max_first_byte_ns,      s.packets_rx_dropped};
+  return write_versioned(out, stats);
+}
+
+void xz_session_mark_wake(xz_session* session, uint64_t wake_ns) {
+  session->transport.mark_wake(wake_ns);
+}
+
+}  // extern "C"
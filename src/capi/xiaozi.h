@@ -0,0 +1,197 @@
+/* C ABI of libxiaozi.so, for load generators and other hosts that drive
+ * the real client code from outside C++.
+ *
+ * Stability rules: functions and enum values are only ever added; config
+ * and stats structs start with `struct_size`, which the caller sets to
+ * sizeof the struct it was compiled against, and new fields are only
+ * appended. Objects are opaque and created and destroyed through this
+ * header. Calls return 0 (or a count) on success and a negative errno
+ * value on failure. Nothing here blocks unless documented. */
+
+#ifndef XIAOZI_CAPI_XIAOZI_H_
+#define XIAOZI_CAPI_XIAOZI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define XZ_API __attribute__((visibility("default")))
+#else
+#define XZ_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped only on an incompatible change, which the rules above avoid. */
+#define XZ_ABI_VERSION 1
+
+XZ_API uint32_t xz_abi_version(void);
+
+typedef enum xz_codec {
+  XZ_CODEC_G711 = 0,
+  XZ_CODEC_OPUS = 1, /* only when the library was built with libopus */
+} xz_codec;
+
+/* ---- Codecs. Each object is for one thread at a time. ---------------- */
+
+typedef struct xz_encoder xz_encoder;
+typedef struct xz_decoder xz_decoder;
+
+/* frame_ms is 10, 20, 40 or 60; bitrate is ignored by G.711. NULL if the
+ * codec is not built in or the parameters are invalid. */
+XZ_API xz_encoder* xz_encoder_create(xz_codec codec, int sample_rate,
+                                     int frame_ms, int bitrate);
+XZ_API void xz_encoder_destroy(xz_encoder* encoder);
+/* PCM samples one xz_encoder_encode() call takes. */
+XZ_API int xz_encoder_frame_samples(const xz_encoder* encoder);
+/* Encodes exactly frame_samples samples; returns the packet length. */
+XZ_API int xz_encoder_encode(xz_encoder* encoder, const int16_t* pcm,
+                             size_t samples, uint8_t* out, size_t capacity);
+XZ_API void xz_encoder_set_bitrate(xz_encoder* encoder, int bitrate);
+
+XZ_API xz_decoder* xz_decoder_create(xz_codec codec, int sample_rate,
+                                     int frame_ms);
+XZ_API void xz_decoder_destroy(xz_decoder* decoder);
+XZ_API int xz_decoder_frame_samples(const xz_decoder* decoder);
+/* Returns samples written to `pcm`. A NULL packet conceals a loss. */
+XZ_API int xz_decoder_decode(xz_decoder* decoder, const uint8_t* packet,
+                             size_t size, int16_t* pcm, size_t capacity);
+
+/* ---- Jitter buffer. push() from one thread, the rest from another. --- */
+
+typedef struct xz_jitter xz_jitter;
+
+typedef struct xz_jitter_config {
+  uint32_t struct_size;
+  uint32_t frame_ms;    /* default 60 */
+  uint32_t min_frames;  /* default 1 */
+  uint32_t max_frames;  /* default 8 */
+  uint32_t max_packet_bytes; /* default 1276 */
+} xz_jitter_config;
+
+typedef struct xz_jitter_stats {
+  uint32_t struct_size;
+  uint32_t target_frames;
+  uint32_t depth_frames;
+  uint64_t received;
+  uint64_t late;
+  uint64_t duplicates;
+  uint64_t lost;
+  uint64_t dropped;
+  uint64_t underruns;
+  double jitter_ms;
+} xz_jitter_stats;
+
+typedef enum xz_jitter_status {
+  XZ_JITTER_PACKET = 0,    /* `out` holds the next packet */
+  XZ_JITTER_LOST = 1,      /* next packet missing: conceal one frame */
+  XZ_JITTER_NOT_READY = 2, /* buffering: play nothing */
+} xz_jitter_status;
+
+XZ_API void xz_jitter_config_init(xz_jitter_config* config);
+/* NULL config means defaults. */
+XZ_API xz_jitter* xz_jitter_create(const xz_jitter_config* config);
+XZ_API void xz_jitter_destroy(xz_jitter* jitter);
+/* Copies the packet in. -ENOBUFS if the buffer's packet pool is full,
+ * -EMSGSIZE if it exceeds max_packet_bytes. */
+XZ_API int xz_jitter_push(xz_jitter* jitter, uint32_t sequence,
+                          uint64_t arrival_ns, const uint8_t* data,
+                          size_t size);
+/* Called once per frame_ms. Returns an xz_jitter_status; for
+ * XZ_JITTER_PACKET the packet is copied to `out` and its length stored in
+ * `*size`. -EMSGSIZE (packet dropped) if `capacity` is too small. */
+XZ_API int xz_jitter_pop(xz_jitter* jitter, uint8_t* out, size_t capacity,
+                         size_t* size);
+XZ_API void xz_jitter_reset(xz_jitter* jitter);
+XZ_API int xz_jitter_get_stats(const xz_jitter* jitter,
+                               xz_jitter_stats* stats);
+
+/* ---- Session: one simulated device on the WebSocket protocol. --------
+ * open(), attach_fd(), poll(), close() and the callbacks belong to the
+ * session's I/O thread; send_pcm() and send_audio() to one producer
+ * thread; send_text() and get_stats() to any thread. */
+
+typedef struct xz_session xz_session;
+
+/* `packet` and `message` are only valid during the call. */
+typedef void (*xz_audio_fn)(void* user, const uint8_t* packet, size_t size);
+typedef void (*xz_text_fn)(void* user, const char* message, size_t size);
+typedef void (*xz_close_fn)(void* user);
+
+typedef struct xz_session_config {
+  uint32_t struct_size;
+  const char* url; /* ws:// (wss:// when built with OpenSSL) */
+  /* Extra upgrade headers as name/value pairs: names[i]: values[i]. */
+  const char* const* header_names;
+  const char* const* header_values;
+  size_t header_count;
+  uint32_t latency_budget_us; /* default 10000 */
+  int connect_timeout_ms;     /* default 5000 */
+  int verify_peer;            /* default 1 */
+  /* Uplink encoder for xz_session_send_pcm(). */
+  xz_codec codec;       /* default XZ_CODEC_G711 */
+  int sample_rate;      /* default 16000 */
+  int frame_ms;         /* default 60 */
+  int bitrate;          /* default 24000 */
+  xz_audio_fn on_audio;
+  xz_text_fn on_text;
+  xz_close_fn on_close;
+  void* user;
+  /* First text message, sent along with the upgrade request; NULL for
+   * none. */
+  const char* hello;
+} xz_session_config;
+
+typedef struct xz_session_stats {
+  uint32_t struct_size;
+  uint32_t queue_depth;
+  uint64_t packets_sent;
+  uint64_t bytes_sent;
+  uint64_t send_syscalls;
+  uint64_t packets_received;
+  uint64_t bytes_received;
+  uint64_t packets_dropped;
+  uint64_t queue_delay_total_ns;
+  uint64_t queue_delay_max_ns;
+  uint64_t connects;
+  uint64_t resumed_connects;    /* TLS session resumed */
+  uint64_t early_data_connects; /* upgrade request sent as 0-RTT */
+  uint64_t connect_ns;          /* latest open() */
+  uint64_t first_byte_ns;       /* latest mark_wake() to first audio sent */
+  uint64_t max_first_byte_ns;
+  uint64_t packets_rx_dropped; /* received audio, receive pool exhausted */
+} xz_session_stats;
+
+XZ_API void xz_session_config_init(xz_session_config* config);
+XZ_API xz_session* xz_session_create(const xz_session_config* config);
+XZ_API void xz_session_destroy(xz_session* session);
+/* Connects and upgrades; blocks up to connect_timeout_ms. */
+XZ_API int xz_session_open(xz_session* session);
+/* Adopts a connected socket whose upgrade is already done. */
+XZ_API int xz_session_attach_fd(xz_session* session, int fd);
+XZ_API void xz_session_close(xz_session* session);
+XZ_API int xz_session_is_open(const xz_session* session);
+/* Runs I/O and callbacks for at most timeout_ms. */
+XZ_API void xz_session_poll(xz_session* session, int timeout_ms);
+XZ_API int xz_session_send_text(xz_session* session, const char* message,
+                                size_t size);
+/* Queues one already encoded packet. -ENOBUFS if the send queue is full. */
+XZ_API int xz_session_send_audio(xz_session* session, const uint8_t* packet,
+                                 size_t size, uint64_t capture_ns);
+/* Encodes one frame of PCM straight into the send queue. Returns the packet
+ * size, -ENOBUFS if the send queue is full, -EIO if encoding fails. */
+XZ_API int xz_session_send_pcm(xz_session* session, const int16_t* pcm,
+                               size_t samples, uint64_t capture_ns);
+XZ_API int xz_session_get_stats(const xz_session* session,
+                                xz_session_stats* stats);
+/* The wake word fired at `wake_ns` (CLOCK_MONOTONIC): the next audio skips
+ * the latency budget and reports first_byte_ns. Any thread. */
+XZ_API void xz_session_mark_wake(xz_session* session, uint64_t wake_ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XIAOZI_CAPI_XIAOZI_H_ */
@@ -0,0 +1,59 @@
+#ifndef XIAOZI_CODEC_AUDIO_CODEC_H_
+#define XIAOZI_CODEC_AUDIO_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xiaozi {
+
+// Frame-at-a-time speech encoder. Implementations encode straight into the
+// caller's buffer and must not allocate after construction.
+class AudioEncoder {
+ public:
+  virtual ~AudioEncoder() = default;
+
+  virtual int sample_rate() const = 0;
+  // PCM samples (mono) consumed by one encode() call.
+  virtual int frame_samples() const = 0;
+
+  // Encodes frame_samples() samples, or a multiple the encoder supports
+  // (see supports_packet_frames()), into `out` as one packet. Returns the
+  // packet length, or -1 if `out` is too small or the encoder failed.
+  virtual int encode(std::span<const int16_t> pcm, std::span<uint8_t> out) = 0;
+
+  // Whether encode() takes `frames` frames as one packet. Longer packets
+  // spend less header and channel access per second of audio.
+  virtual bool supports_packet_frames(int frames) const { return frames == 1; }
+
+  // Live tuning; takes effect from the next encode(). Codecs without the
+  // knob ignore it.
+  virtual void set_bitrate(int bits_per_second) { (void)bits_per_second; }
+  virtual void set_complexity(int complexity) { (void)complexity; }
+  virtual int max_complexity() const { return 0; }
+  // In-band FEC: packets also carry a coarse copy of the previous frame,
+  // sized for the expected loss.
+  virtual void set_fec(bool enabled, int loss_percent) {
+    (void)enabled;
+    (void)loss_percent;
+  }
+};
+
+class AudioDecoder {
+ public:
+  virtual ~AudioDecoder() = default;
+
+  virtual int sample_rate() const = 0;
+  virtual int frame_samples() const = 0;
+
+  // Decodes one packet into `pcm`. Returns samples written or -1.
+  virtual int decode(std::span<const uint8_t> packet,
+                     std::span<int16_t> pcm) = 0;
+
+  // Synthesizes one frame_samples() frame in place of a lost packet.
+  virtual int conceal(std::span<int16_t> pcm) = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_CODEC_AUDIO_CODEC_H_
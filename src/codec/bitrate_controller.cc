@@ -0,0 +1,202 @@
+#include "codec/bitrate_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/trace.h"
+
+namespace xiaozi {
+namespace {
+
+// Ticks after a step down during which a queue or RTT that is already
+// falling does not count as a reason to step down again.
+constexpr int kDrainTicks = 3;
+// Per-tick loss is a handful of packets; it is smoothed with this gain.
+constexpr float kLossGain = 0.25f;
+
+constexpr int kRungs = static_cast<int>(BitrateController::kLadder.size());
+
+// The transport restarts its TCP counters on every open().
+uint32_t since_open(uint32_t now, uint32_t last) {
+  return now >= last ? now - last : now;
+}
+
+uint64_t to_ns(std::chrono::milliseconds ms) {
+  return static_cast<uint64_t>(std::chrono::nanoseconds(ms).count());
+}
+
+}  // namespace
+
+BitrateController::BitrateController(const Config& config)
+    : config_(config), rung_(std::clamp(config.start_rung, 0, kRungs - 1)) {
+  config_.up_after = std::max(config_.up_after, 1);
+  config_.max_backoff = std::max(config_.max_backoff, 1);
+  reported_rung_.store(rung_, std::memory_order_relaxed);
+}
+
+BitrateController::LinkSample BitrateController::sample(
+    const TransportStats& stats) {
+  LinkSample link;
+  link.rtt_us = stats.rtt_us;
+  const uint64_t sent = stats.packets_sent - last_.packets_sent;
+  const uint64_t dropped = stats.packets_dropped - last_.packets_dropped;
+  const uint32_t segments =
+      since_open(stats.segments_sent, last_.segments_sent);
+  const uint32_t retransmits =
+      std::min(since_open(stats.retransmits, last_.retransmits), segments);
+  float loss = 0;
+  if (sent + dropped != 0) {
+    loss += static_cast<float>(dropped) / static_cast<float>(sent + dropped);
+  }
+  if (segments != 0) {
+    loss += static_cast<float>(retransmits) / static_cast<float>(segments);
+  }
+  link.loss = std::min(1.0f, loss);
+  const uint64_t mean_delay =
+      sent == 0 ? 0
+                : (stats.queue_delay_total_ns - last_.queue_delay_total_ns) /
+                      sent;
+  // One packet waiting for its batch is normal; more is a backlog.
+  const uint64_t backlog =
+      stats.queue_depth > 1
+          ? uint64_t{stats.queue_depth - 1} *
+                static_cast<uint64_t>(kLadder[rung_].frame_ms) * 1000000
+          : 0;
+  link.queue_delay_ns = std::max(mean_delay, backlog);
+  last_ = stats;
+  return link;
+}
+
+BitrateController::Decision BitrateController::update(
+    const LinkSample& link) {
+  ticks_.fetch_add(1, std::memory_order_relaxed);
+  if (link.rtt_us != 0) {
+    // The floor creeps up by 1/256 a tick, so a route change to a longer
+    // path stops reading as congestion after a while.
+    min_rtt_us_ += min_rtt_us_ / 256;
+    min_rtt_us_ =
+        min_rtt_us_ == 0 ? link.rtt_us : std::min(min_rtt_us_, link.rtt_us);
+  }
+  loss_ += (link.loss - loss_) * kLossGain;
+  bool changed = !started_;
+  Reason reason = Reason::kStart;
+  started_ = true;
+
+  ++down_ticks_;
+  if (probe_ticks_ >= 0 && ++probe_ticks_ > config_.up_after) {
+    // The step up held.
+    probe_ticks_ = -1;
+    backoff_ = 1;
+  }
+
+  Reason why = Reason::kQueue;
+  if (congested(link, why)) {
+    clear_ticks_ = 0;
+    const bool draining =
+        why != Reason::kLoss && down_ticks_ <= kDrainTicks &&
+        link.queue_delay_ns < last_queue_delay_ns_ &&
+        (link.rtt_us == 0 || link.rtt_us <= last_rtt_us_);
+    if (probe_ticks_ >= 0) {
+      backoff_ = std::min(backoff_ * 2, config_.max_backoff);
+      probe_ticks_ = -1;
+    }
+    if (!draining && rung_ + 1 < kRungs) {
+      ++rung_;
+      down_ticks_ = 0;
+      changed = true;
+      reason = why;
+      steps_down_.fetch_add(1, std::memory_order_relaxed);
+    }
+  } else if (rung_ > 0 && ++clear_ticks_ >= config_.up_after * backoff_) {
+    --rung_;
+    clear_ticks_ = 0;
+    probe_ticks_ = 0;
+    changed = true;
+    reason = Reason::kProbe;
+    steps_up_.fetch_add(1, std::memory_order_relaxed);
+  }
+  last_queue_delay_ns_ = link.queue_delay_ns;
+  last_rtt_us_ = link.rtt_us;
+
+  bool fec_changed = false;
+  update_fec(loss_, fec_changed);
+  if (fec_changed && !changed) reason = Reason::kFec;
+  changed = changed || fec_changed;
+
+  reported_rung_.store(rung_, std::memory_order_relaxed);
+  reported_backoff_.store(backoff_, std::memory_order_relaxed);
+  const Decision d = decision(changed, reason);
+  if (changed) {
+    XIAOZI_TRACE_EVENT(kRateChange, d.bitrate, d.frame_ms,
+                       d.fec ? d.fec_loss_percent : -1,
+                       static_cast<int32_t>(d.reason));
+  }
+  return d;
+}
+
+bool BitrateController::congested(const LinkSample& link, Reason& reason) {
+  if (link.queue_delay_ns > to_ns(config_.queue_delay_limit)) {
+    reason = Reason::kQueue;
+    return true;
+  }
+  const auto rise_us = static_cast<uint32_t>(
+      std::chrono::microseconds(config_.rtt_rise_limit).count());
+  if (min_rtt_us_ != 0 && link.rtt_us >= min_rtt_us_ + rise_us) {
+    reason = Reason::kRtt;
+    return true;
+  }
+  if (loss_ > config_.loss_limit) {
+    reason = Reason::kLoss;
+    return true;
+  }
+  return false;
+}
+
+void BitrateController::update_fec(float loss, bool& changed) {
+  const int percent =
+      std::clamp(static_cast<int>(std::lround(loss * 100.0f)), 0, 100);
+  if (loss >= config_.fec_on_loss) {
+    fec_quiet_ticks_ = 0;
+    if (!fec_) fec_toggles_.fetch_add(1, std::memory_order_relaxed);
+    // The encoder's expected loss only ratchets up while FEC stays on.
+    if (!fec_ || percent > fec_loss_percent_) {
+      fec_ = true;
+      fec_loss_percent_ = percent;
+      changed = true;
+    }
+  } else if (fec_) {
+    if (loss >= config_.fec_off_loss) {
+      fec_quiet_ticks_ = 0;
+    } else if (++fec_quiet_ticks_ >= config_.fec_off_after) {
+      fec_ = false;
+      fec_loss_percent_ = 0;
+      fec_quiet_ticks_ = 0;
+      fec_toggles_.fetch_add(1, std::memory_order_relaxed);
+      changed = true;
+    }
+  }
+}
+
+BitrateController::Decision BitrateController::decision(bool changed,
+                                                        Reason reason) const {
+  const Rung& r = kLadder[rung_];
+  return {r.bitrate, r.frame_ms, fec_, fec_loss_percent_, changed, reason};
+}
+
+void BitrateController::apply(const Decision& decision, EncoderStage& stage,
+                              int capture_frame_ms) {
+  stage.set_bitrate(decision.bitrate);
+  stage.set_packet_frames(decision.frame_ms / std::max(capture_frame_ms, 1));
+  stage.set_fec(decision.fec, decision.fec_loss_percent);
+}
+
+BitrateController::Stats BitrateController::stats() const {
+  return {ticks_.load(std::memory_order_relaxed),
+          steps_down_.load(std::memory_order_relaxed),
+          steps_up_.load(std::memory_order_relaxed),
+          fec_toggles_.load(std::memory_order_relaxed),
+          reported_rung_.load(std::memory_order_relaxed),
+          reported_backoff_.load(std::memory_order_relaxed)};
+}
+
+}  // namespace xiaozi
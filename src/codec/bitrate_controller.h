@@ -0,0 +1,151 @@
+#ifndef XIAOZI_CODEC_BITRATE_CONTROLLER_H_
+#define XIAOZI_CODEC_BITRATE_CONTROLLER_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "codec/encoder_stage.h"
+#include "net/transport.h"
+
+namespace xiaozi {
+
+// Picks the uplink's bitrate, packet duration and FEC from link telemetry,
+// once per tick (a few hundred ms), and hands the result to an
+// EncoderStage.
+//
+// Settings move along a ladder from high quality with short packets to low
+// bitrate with long packets: on a contended Wi-Fi link the per-packet
+// airtime costs as much as the payload, so fewer, longer packets relieve it
+// more than a lower bitrate alone. The controller steps down at once when
+// the send queue backs up, the RTT rises well above the lowest seen, or
+// loss, smoothed over a few ticks, passes loss_limit, but not again while
+// the queue is still draining after a step down. It steps up one rung
+// only after up_after clear ticks. A step up that is followed by
+// congestion within up_after ticks doubles the wait before the next one,
+// up to max_backoff times. Under steady congestion this settles on the
+// highest rung that fits instead of bouncing between two.
+//
+// In-band FEC goes on once loss reaches fec_on_loss and off only after
+// fec_off_after ticks below fec_off_loss.
+//
+// A packet duration change is not announced to the server, which reads
+// each packet's duration from the packet (EncoderStage::set_packet_frames).
+//
+// Every change is logged as a trace::Event::kRateChange.
+class BitrateController {
+ public:
+  struct Rung {
+    int bitrate;
+    int frame_ms;
+  };
+  static constexpr std::array<Rung, 5> kLadder = {{
+      {32000, 20},
+      {24000, 20},
+      {16000, 40},
+      {12000, 60},
+      {8000, 60},
+  }};
+
+  // Why a Decision changed; the `reason` of the trace event.
+  enum class Reason : int32_t {
+    kStart,
+    kQueue,
+    kRtt,
+    kLoss,
+    kProbe,
+    kFec,
+  };
+
+  struct Config {
+    std::chrono::milliseconds queue_delay_limit{40};
+    std::chrono::milliseconds rtt_rise_limit{80};
+    float loss_limit = 0.10f;
+    int up_after = 10;  // ticks
+    int max_backoff = 8;
+    float fec_on_loss = 0.03f;
+    float fec_off_loss = 0.01f;
+    int fec_off_after = 20;  // ticks
+    int start_rung = 0;
+  };
+
+  // One tick of telemetry.
+  struct LinkSample {
+    uint32_t rtt_us = 0;  // 0 if unknown
+    float loss = 0;       // 0..1
+    // Time the audio waiting to be sent covers, or its mean queueing
+    // delay, whichever is larger.
+    uint64_t queue_delay_ns = 0;
+  };
+
+  struct Decision {
+    int bitrate;
+    int frame_ms;
+    bool fec;
+    int fec_loss_percent;
+    bool changed;  // since the previous update()
+    Reason reason;
+  };
+
+  struct Stats {
+    uint64_t ticks;
+    uint64_t steps_down;
+    uint64_t steps_up;
+    uint64_t fec_toggles;
+    int rung;
+    int backoff;  // current multiplier on up_after
+  };
+
+  explicit BitrateController(const Config& config);
+  BitrateController() : BitrateController(Config{}) {}
+
+  // Controller thread. Turns a transport's cumulative counters into the
+  // sample for the tick since the previous call. Loss adds the share of
+  // audio packets dropped on the send side to the share of TCP segments
+  // retransmitted, each counted in its own unit.
+  LinkSample sample(const TransportStats& stats);
+  Decision update(const LinkSample& link);
+
+  // Passes `decision` to the stage, whose frames are `capture_frame_ms`
+  // long.
+  static void apply(const Decision& decision, EncoderStage& stage,
+                    int capture_frame_ms);
+
+  // Any thread.
+  Stats stats() const;
+
+ private:
+  bool congested(const LinkSample& link, Reason& reason);
+  void update_fec(float loss, bool& changed);
+  Decision decision(bool changed, Reason reason) const;
+
+  Config config_;
+
+  // Controller-thread state.
+  int rung_;
+  bool started_ = false;
+  int clear_ticks_ = 0;
+  int down_ticks_ = 0;    // since the latest step down
+  int probe_ticks_ = -1;  // since the latest step up, -1 once it held
+  uint64_t last_queue_delay_ns_ = 0;
+  uint32_t last_rtt_us_ = 0;
+  int backoff_ = 1;
+  uint32_t min_rtt_us_ = 0;
+  float loss_ = 0;
+  bool fec_ = false;
+  int fec_loss_percent_ = 0;
+  int fec_quiet_ticks_ = 0;
+  TransportStats last_{};
+
+  std::atomic<uint64_t> ticks_{0};
+  std::atomic<uint64_t> steps_down_{0};
+  std::atomic<uint64_t> steps_up_{0};
+  std::atomic<uint64_t> fec_toggles_{0};
+  std::atomic<int> reported_rung_{0};
+  std::atomic<int> reported_backoff_{1};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_CODEC_BITRATE_CONTROLLER_H_
@@ -0,0 +1,79 @@
+#include "codec/decoder_stage.h"
+
+#include <array>
+
+#include "base/trace.h"
+
+namespace xiaozi {
+
+DecoderStage::DecoderStage(AudioDecoder& decoder, FramePool& pcm_pool)
+    : decoder_(decoder), pcm_pool_(pcm_pool) {}
+
+bool DecoderStage::submit(FrameRef packet) {
+  if (packet) XIAOZI_TRACE_FRAME(kReceive, packet);
+  if (!input_.try_push(std::move(packet))) {
+    packets_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  wakeup_.release();
+  return true;
+}
+
+std::size_t DecoderStage::wait_and_run(std::chrono::milliseconds timeout) {
+  if (!wakeup_.try_acquire_for(timeout)) return 0;
+  while (wakeup_.try_acquire()) {
+  }
+  return run_once();
+}
+
+std::size_t DecoderStage::run_once() {
+  std::array<FrameRef, kQueueFrames> batch;
+  std::size_t n = input_.pop_n(batch);
+  std::size_t produced = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    FrameRef pcm = pcm_pool_.acquire();
+    if (!pcm) {
+      pool_exhausted_.fetch_add(1, std::memory_order_relaxed);
+      batch[i].reset();
+      continue;
+    }
+    auto out = pcm.as_capacity<int16_t>();
+    int samples;
+    if (batch[i]) {
+      samples = decoder_.decode(batch[i].bytes(), out);
+      pcm.set_sequence(batch[i].sequence());
+      pcm.set_timestamp_ns(batch[i].timestamp_ns());
+    } else {
+      samples = decoder_.conceal(out);
+      frames_concealed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    batch[i].reset();
+    if (samples < 0) {
+      decode_errors_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    pcm.set_size(static_cast<std::size_t>(samples) * sizeof(int16_t));
+    XIAOZI_TRACE_FRAME(kDecode, pcm);
+    if (!output_.try_push(std::move(pcm))) {
+      output_overruns_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    ++produced;
+  }
+  frames_decoded_.fetch_add(static_cast<uint32_t>(produced),
+                            std::memory_order_relaxed);
+  return produced;
+}
+
+DecoderStage::Stats DecoderStage::stats() const {
+  return Stats{
+      frames_decoded_.load(std::memory_order_relaxed),
+      frames_concealed_.load(std::memory_order_relaxed),
+      packets_dropped_.load(std::memory_order_relaxed),
+      pool_exhausted_.load(std::memory_order_relaxed),
+      decode_errors_.load(std::memory_order_relaxed),
+      output_overruns_.load(std::memory_order_relaxed),
+  };
+}
+
+}  // namespace xiaozi
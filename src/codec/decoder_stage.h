@@ -0,0 +1,71 @@
+#ifndef XIAOZI_CODEC_DECODER_STAGE_H_
+#define XIAOZI_CODEC_DECODER_STAGE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <semaphore>
+
+#include "base/trace.h"
+#include "codec/audio_codec.h"
+#include "memory/frame_pool.h"
+#include "memory/spsc_ring.h"
+
+namespace xiaozi {
+
+// Transport -> decoder -> playback. Received packets arrive as pooled
+// frames; the codec thread decodes each straight into a PCM block from
+// `pcm_pool` and queues it for the playback side. A lost packet is
+// submitted as an empty FrameRef and comes out as a concealment frame.
+class DecoderStage {
+ public:
+  static constexpr std::size_t kQueueFrames = 16;
+
+  struct Stats {
+    uint32_t frames_decoded;
+    uint32_t frames_concealed;
+    uint32_t packets_dropped;  // input queue full
+    uint32_t pool_exhausted;   // no PCM block available
+    uint32_t decode_errors;
+    uint32_t output_overruns;  // playback side not draining
+  };
+
+  DecoderStage(AudioDecoder& decoder, FramePool& pcm_pool);
+
+  // Network side. An empty `packet` marks a loss to be concealed.
+  bool submit(FrameRef packet);
+
+  // Codec thread. Decodes everything queued; wait_and_run() first blocks
+  // up to `timeout` for a packet.
+  std::size_t wait_and_run(std::chrono::milliseconds timeout);
+  std::size_t run_once();
+
+  // Playback side.
+  bool pop(FrameRef& pcm) {
+    if (!output_.try_pop(pcm)) return false;
+    XIAOZI_TRACE_FRAME(kPlayback, pcm);
+    return true;
+  }
+
+  Stats stats() const;
+
+ private:
+  AudioDecoder& decoder_;
+  FramePool& pcm_pool_;
+  // An empty slot still means "one lost packet", so a plain FrameRef ring
+  // carries both kinds of entry.
+  SpscRing<FrameRef, kQueueFrames> input_;
+  SpscRing<FrameRef, kQueueFrames> output_;
+  std::counting_semaphore<> wakeup_{0};
+
+  std::atomic<uint32_t> frames_decoded_{0};
+  std::atomic<uint32_t> frames_concealed_{0};
+  std::atomic<uint32_t> packets_dropped_{0};
+  std::atomic<uint32_t> pool_exhausted_{0};
+  std::atomic<uint32_t> decode_errors_{0};
+  std::atomic<uint32_t> output_overruns_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_CODEC_DECODER_STAGE_H_
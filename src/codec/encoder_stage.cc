@@ -0,0 +1,223 @@
+#include "codec/encoder_stage.h"
+
+#include <algorithm>
+#include <array>
+
+#include "base/clock.h"
+#include "base/trace.h"
+
+namespace xiaozi {
+namespace {
+
+// Batches in a row below half the budget before complexity goes back up.
+constexpr int kRaiseAfterBatches = 50;
+// Smoothing for the load estimate: the newest batch gets 1/8 weight.
+constexpr float kLoadAlpha = 0.125f;
+
+}  // namespace
+
+EncoderStage::EncoderStage(AudioEncoder& encoder, PacketSink& sink,
+                           const Config& config)
+    : encoder_(encoder),
+      sink_(sink),
+      config_(config),
+      complexity_ceiling_(encoder.max_complexity()),
+      complexity_(encoder.max_complexity()),
+      staging_(static_cast<std::size_t>(kMaxPacketFrames) *
+               static_cast<std::size_t>(encoder.frame_samples())) {
+  config_.frames_per_wakeup =
+      std::clamp<int>(config_.frames_per_wakeup, 1, kQueueFrames);
+  reported_complexity_.store(complexity_, std::memory_order_relaxed);
+}
+
+bool EncoderStage::submit(FrameRef pcm) {
+  if (!queue_.try_push(std::move(pcm))) {
+    frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (++submitted_ % config_.frames_per_wakeup == 0) wakeup_.release();
+  return true;
+}
+
+void EncoderStage::flush() {
+  flush_pending_.store(true, std::memory_order_release);
+  wakeup_.release();
+}
+
+std::size_t EncoderStage::wait_and_run(std::chrono::milliseconds timeout) {
+  if (!wakeup_.try_acquire_for(timeout)) return 0;
+  // One wakeup drains the queue, so fold in permits that piled up while
+  // this thread was busy instead of waking for an empty queue later.
+  while (wakeup_.try_acquire()) {
+  }
+  wakeups_.fetch_add(1, std::memory_order_relaxed);
+  return run_once();
+}
+
+std::size_t EncoderStage::run_once() {
+  apply_pending_settings();
+  const bool flush = flush_pending_.exchange(false, std::memory_order_acquire);
+
+  std::array<FrameRef, kQueueFrames> batch;
+  std::size_t n = queue_.pop_n(batch);
+  if (n == 0 && !(flush && staged_frames_ != 0)) return 0;
+
+  const std::size_t frame_samples = encoder_.frame_samples();
+  const uint64_t start = monotonic_ns();
+  std::size_t encoded = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    FrameRef& frame = batch[i];
+    auto pcm = frame.as<const int16_t>();
+    if (pcm.size() != frame_samples) {
+      encode_errors_.fetch_add(1, std::memory_order_relaxed);
+      frame.reset();
+      continue;
+    }
+    if (staged_frames_ == 0) apply_packet_frames();
+    if (packet_frames_ == 1) {
+      if (encode_packet(pcm, frame.timestamp_ns())) ++encoded;
+    } else {
+      if (staged_frames_ == 0) staged_capture_ns_ = frame.timestamp_ns();
+      std::copy(pcm.begin(), pcm.end(),
+                staging_.begin() + staged_frames_ * frame_samples);
+      if (++staged_frames_ == packet_frames_ && encode_staged()) {
+        encoded += static_cast<std::size_t>(packet_frames_);
+      }
+    }
+    frame.reset();
+  }
+  if (flush && staged_frames_ != 0) {
+    const int frames = staged_frames_;
+    if (encode_staged()) encoded += static_cast<std::size_t>(frames);
+  }
+  frames_encoded_.fetch_add(static_cast<uint32_t>(encoded),
+                            std::memory_order_relaxed);
+  if (n != 0) adapt_complexity(monotonic_ns() - start, n);
+  return encoded;
+}
+
+bool EncoderStage::encode_packet(std::span<const int16_t> pcm,
+                                 uint64_t capture_ns) {
+  auto out = sink_.reserve(config_.max_packet_bytes);
+  if (out.empty()) {
+    sink_full_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  int bytes = encoder_.encode(pcm, out);
+  if (bytes < 0) {
+    encode_errors_.fetch_add(1, std::memory_order_relaxed);
+    sink_.commit(0, capture_ns);
+    return false;
+  }
+  if (!sink_.commit(static_cast<std::size_t>(bytes), capture_ns)) {
+    sink_full_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  XIAOZI_TRACE_SINCE(kEncode, capture_ns);
+  return true;
+}
+
+bool EncoderStage::encode_staged() {
+  const std::size_t frame_samples = encoder_.frame_samples();
+  // A short packet from flush() is padded up to a length the encoder takes;
+  // packet_frames_ itself always qualifies.
+  int frames = staged_frames_;
+  while (!encoder_.supports_packet_frames(frames)) ++frames;
+  std::fill(staging_.begin() + staged_frames_ * frame_samples,
+            staging_.begin() + frames * frame_samples, int16_t{0});
+  staged_frames_ = 0;
+  return encode_packet({staging_.data(), frames * frame_samples},
+                       staged_capture_ns_);
+}
+
+void EncoderStage::apply_packet_frames() {
+  int frames = pending_packet_frames_.exchange(-1, std::memory_order_acquire);
+  if (frames < 0) return;
+  while (frames > 1 && !encoder_.supports_packet_frames(frames)) --frames;
+  packet_frames_ = std::max(frames, 1);
+  reported_packet_frames_.store(packet_frames_, std::memory_order_relaxed);
+}
+
+void EncoderStage::apply_pending_settings() {
+  int bitrate = pending_bitrate_.exchange(-1, std::memory_order_acquire);
+  if (bitrate >= 0) encoder_.set_bitrate(bitrate);
+  int complexity = pending_complexity_.exchange(-1, std::memory_order_acquire);
+  if (complexity >= 0) {
+    complexity_ceiling_ = std::min(complexity, encoder_.max_complexity());
+    complexity_ = complexity_ceiling_;
+    calm_batches_ = 0;
+    encoder_.set_complexity(complexity_);
+    reported_complexity_.store(complexity_, std::memory_order_relaxed);
+  }
+  int fec = pending_fec_.exchange(-1, std::memory_order_acquire);
+  if (fec >= 0) {
+    encoder_.set_fec(fec > 0, fec > 0 ? fec - 1 : 0);
+    reported_fec_.store(fec > 0, std::memory_order_relaxed);
+  }
+}
+
+void EncoderStage::adapt_complexity(uint64_t encode_ns, std::size_t frames) {
+  const double audio_ns = 1e9 * static_cast<double>(frames) *
+                          encoder_.frame_samples() / encoder_.sample_rate();
+  float batch_load = static_cast<float>(encode_ns / audio_ns);
+  load_ += kLoadAlpha * (batch_load - load_);
+  reported_load_.store(load_, std::memory_order_relaxed);
+  if (!config_.auto_complexity) return;
+
+  int next = complexity_;
+  if (load_ > config_.cpu_budget && complexity_ > 0) {
+    next = complexity_ - 1;
+    calm_batches_ = 0;
+    // Give the new setting a fresh estimate instead of stepping down again
+    // on the history that caused this step.
+    load_ = config_.cpu_budget;
+  } else if (load_ < config_.cpu_budget / 2 &&
+             complexity_ < complexity_ceiling_) {
+    if (++calm_batches_ >= kRaiseAfterBatches) {
+      next = complexity_ + 1;
+      calm_batches_ = 0;
+    }
+  } else {
+    calm_batches_ = 0;
+  }
+  if (next != complexity_) {
+    complexity_ = next;
+    encoder_.set_complexity(complexity_);
+    reported_complexity_.store(complexity_, std::memory_order_relaxed);
+  }
+}
+
+void EncoderStage::set_bitrate(int bits_per_second) {
+  pending_bitrate_.store(bits_per_second, std::memory_order_release);
+}
+
+void EncoderStage::set_complexity(int complexity) {
+  pending_complexity_.store(std::max(complexity, 0),
+                            std::memory_order_release);
+}
+
+void EncoderStage::set_packet_frames(int frames) {
+  pending_packet_frames_.store(std::clamp(frames, 1, kMaxPacketFrames),
+                               std::memory_order_release);
+}
+
+void EncoderStage::set_fec(bool enabled, int loss_percent) {
+  pending_fec_.store(enabled ? 1 + std::clamp(loss_percent, 0, 100) : 0,
+                     std::memory_order_release);
+}
+
+EncoderStage::Stats EncoderStage::stats() const {
+  return Stats{
+      frames_encoded_.load(std::memory_order_relaxed),
+      frames_dropped_.load(std::memory_order_relaxed),
+      sink_full_.load(std::memory_order_relaxed),
+      encode_errors_.load(std::memory_order_relaxed),
+      wakeups_.load(std::memory_order_relaxed),
+      reported_complexity_.load(std::memory_order_relaxed),
+      reported_load_.load(std::memory_order_relaxed),
+      reported_packet_frames_.load(std::memory_order_relaxed),
+      reported_fec_.load(std::memory_order_relaxed),
+  };
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,131 @@
+#ifndef XIAOZI_CODEC_ENCODER_STAGE_H_
+#define XIAOZI_CODEC_ENCODER_STAGE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <semaphore>
+#include <vector>
+
+#include "codec/audio_codec.h"
+#include "memory/frame_pool.h"
+#include "memory/spsc_ring.h"
+#include "net/packet_sink.h"
+
+namespace xiaozi {
+
+// Capture -> encoder -> transport. The capture side submit()s pooled PCM
+// frames; the codec thread wakes once per `frames_per_wakeup` frames,
+// encodes each one directly from the pool block into space reserved in the
+// transport's send buffer, and drops its frame reference. There is no
+// intermediate buffer on either side of the encoder.
+//
+// A packet may span several frames (packet_frames, e.g. 3 x 20 ms). Those
+// are gathered in a staging buffer, the one copy on this path, while
+// single-frame packets are still encoded straight from the pool block.
+// flush() sends a partly gathered packet as it is, padded with silence if
+// the encoder cannot take that length.
+//
+// Bitrate, complexity, FEC and packet_frames may be changed from any
+// thread and are applied at the start of the next batch, packet_frames at
+// the next packet boundary. With auto_complexity the stage also steps
+// complexity down when encoding takes more than cpu_budget of the audio
+// time it covers, and back up (to the configured ceiling) once load has
+// stayed below half the budget for a while.
+class EncoderStage {
+ public:
+  static constexpr std::size_t kQueueFrames = 16;
+  static constexpr int kMaxPacketFrames = 6;
+
+  struct Config {
+    int frames_per_wakeup = 3;
+    // Opus never produces more than 1275 bytes per frame.
+    std::size_t max_packet_bytes = 1276;
+    bool auto_complexity = true;
+    float cpu_budget = 0.25f;
+  };
+
+  struct Stats {
+    uint32_t frames_encoded;
+    uint32_t frames_dropped;  // submit() found the queue full
+    uint32_t sink_full;       // transport had no room; packet lost
+    uint32_t encode_errors;
+    uint32_t wakeups;
+    int complexity;
+    float load;  // smoothed encode time / audio time
+    int packet_frames;
+    bool fec;
+  };
+
+  EncoderStage(AudioEncoder& encoder, PacketSink& sink, const Config& config);
+
+  // Capture side. Never blocks or allocates.
+  bool submit(FrameRef pcm);
+  // Capture side: wake the codec thread for a partial batch, and send any
+  // partly gathered packet, e.g. at the end of an utterance.
+  void flush();
+
+  // Codec thread. Waits for a batch (or flush) up to `timeout`, then
+  // encodes everything queued. Returns frames encoded.
+  std::size_t wait_and_run(std::chrono::milliseconds timeout);
+  // Codec thread. Encodes everything queued without waiting.
+  std::size_t run_once();
+
+  // Any thread.
+  void set_bitrate(int bits_per_second);
+  void set_complexity(int complexity);
+  // Frames per packet; the longest length the encoder supports up to
+  // `frames` is used. Nothing is renegotiated: the hello's frame_duration
+  // stays the capture frame, and the server takes each packet's duration
+  // from the packet itself (the Opus TOC byte; see Gateway::Config).
+  void set_packet_frames(int frames);
+  void set_fec(bool enabled, int loss_percent);
+  Stats stats() const;
+
+ private:
+  void apply_pending_settings();
+  void apply_packet_frames();
+  // Returns whether a packet was committed.
+  bool encode_packet(std::span<const int16_t> pcm, uint64_t capture_ns);
+  bool encode_staged();
+  void adapt_complexity(uint64_t encode_ns, std::size_t frames);
+
+  AudioEncoder& encoder_;
+  PacketSink& sink_;
+  Config config_;
+  SpscRing<FrameRef, kQueueFrames> queue_;
+  std::counting_semaphore<> wakeup_{0};
+  uint32_t submitted_ = 0;
+
+  // -1 means "no change requested".
+  std::atomic<int> pending_bitrate_{-1};
+  std::atomic<int> pending_complexity_{-1};
+  std::atomic<int> pending_packet_frames_{-1};
+  // 0 turns FEC off, 1 + loss_percent turns it on.
+  std::atomic<int> pending_fec_{-1};
+  std::atomic<bool> flush_pending_{false};
+
+  // Codec-thread state.
+  int complexity_ceiling_;
+  int complexity_;
+  float load_ = 0;
+  int calm_batches_ = 0;
+  int packet_frames_ = 1;
+  std::vector<int16_t> staging_;
+  int staged_frames_ = 0;
+  uint64_t staged_capture_ns_ = 0;
+
+  std::atomic<uint32_t> frames_encoded_{0};
+  std::atomic<uint32_t> frames_dropped_{0};
+  std::atomic<uint32_t> sink_full_{0};
+  std::atomic<uint32_t> encode_errors_{0};
+  std::atomic<uint32_t> wakeups_{0};
+  std::atomic<int> reported_complexity_{0};
+  std::atomic<float> reported_load_{0};
+  std::atomic<int> reported_packet_frames_{1};
+  std::atomic<bool> reported_fec_{false};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_CODEC_ENCODER_STAGE_H_
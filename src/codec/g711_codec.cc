@@ -0,0 +1,71 @@
+#include "codec/g711_codec.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace xiaozi {
+namespace {
+
+constexpr int kBias = 0x84;
+constexpr int kClip = 32635;
+
+}  // namespace
+
+uint8_t linear_to_ulaw(int16_t sample) {
+  int v = sample;
+  int sign = 0;
+  if (v < 0) {
+    v = -v;
+    sign = 0x80;
+  }
+  v = std::min(v, kClip) + kBias;
+  int exponent = std::bit_width(static_cast<unsigned>(v >> 7)) - 1;
+  int mantissa = (v >> (exponent + 3)) & 0x0f;
+  return static_cast<uint8_t>(~(sign | (exponent << 4) | mantissa));
+}
+
+int16_t ulaw_to_linear(uint8_t code) {
+  code = static_cast<uint8_t>(~code);
+  int exponent = (code >> 4) & 0x07;
+  int mantissa = code & 0x0f;
+  int v = (((mantissa << 3) + kBias) << exponent) - kBias;
+  return static_cast<int16_t>((code & 0x80) ? -v : v);
+}
+
+int G711Encoder::encode(std::span<const int16_t> pcm, std::span<uint8_t> out) {
+  if (pcm.size() % frame_samples_ != 0 ||
+      !supports_packet_frames(static_cast<int>(pcm.size() / frame_samples_)) ||
+      out.size() < pcm.size()) {
+    return -1;
+  }
+  for (size_t i = 0; i < pcm.size(); ++i) out[i] = linear_to_ulaw(pcm[i]);
+  return static_cast<int>(pcm.size());
+}
+
+bool G711Encoder::supports_packet_frames(int frames) const {
+  return frames >= 1 &&
+         frames * frame_samples_ <= G711Decoder::kMaxFrameSamples;
+}
+
+int G711Decoder::decode(std::span<const uint8_t> packet,
+                        std::span<int16_t> pcm) {
+  if (packet.size() > pcm.size() || packet.size() > last_.size()) return -1;
+  for (size_t i = 0; i < packet.size(); ++i) {
+    pcm[i] = ulaw_to_linear(packet[i]);
+    last_[i] = pcm[i];
+  }
+  losses_ = 0;
+  return static_cast<int>(packet.size());
+}
+
+int G711Decoder::conceal(std::span<int16_t> pcm) {
+  auto n = std::min<size_t>(
+      {pcm.size(), static_cast<size_t>(frame_samples_), last_.size()});
+  int shift = std::min(++losses_, 15);
+  for (size_t i = 0; i < n; ++i) {
+    pcm[i] = static_cast<int16_t>(last_[i] >> shift);
+  }
+  return static_cast<int>(n);
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,54 @@
+#ifndef XIAOZI_CODEC_G711_CODEC_H_
+#define XIAOZI_CODEC_G711_CODEC_H_
+
+#include <array>
+
+#include "codec/audio_codec.h"
+
+namespace xiaozi {
+
+// G.711 mu-law: one byte per sample, no state. Used on hosts built without
+// libopus, by simulated devices and as a cheap fallback codec.
+class G711Encoder : public AudioEncoder {
+ public:
+  G711Encoder(int sample_rate, int frame_samples)
+      : sample_rate_(sample_rate), frame_samples_(frame_samples) {}
+
+  int sample_rate() const override { return sample_rate_; }
+  int frame_samples() const override { return frame_samples_; }
+  int encode(std::span<const int16_t> pcm, std::span<uint8_t> out) override;
+  // Any packet the decoder's kMaxFrameSamples holds.
+  bool supports_packet_frames(int frames) const override;
+
+ private:
+  int sample_rate_;
+  int frame_samples_;
+};
+
+class G711Decoder : public AudioDecoder {
+ public:
+  static constexpr int kMaxFrameSamples = 2880;
+
+  G711Decoder(int sample_rate, int frame_samples)
+      : sample_rate_(sample_rate), frame_samples_(frame_samples) {}
+
+  int sample_rate() const override { return sample_rate_; }
+  int frame_samples() const override { return frame_samples_; }
+  int decode(std::span<const uint8_t> packet,
+             std::span<int16_t> pcm) override;
+  // Replays the last good frame at -6 dB per consecutive loss.
+  int conceal(std::span<int16_t> pcm) override;
+
+ private:
+  int sample_rate_;
+  int frame_samples_;
+  int losses_ = 0;
+  std::array<int16_t, kMaxFrameSamples> last_{};
+};
+
+uint8_t linear_to_ulaw(int16_t sample);
+int16_t ulaw_to_linear(uint8_t code);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_CODEC_G711_CODEC_H_
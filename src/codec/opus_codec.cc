@@ -0,0 +1,90 @@
+#include "codec/opus_codec.h"
+
+#include <algorithm>
+
+#include <opus.h>
+
+namespace xiaozi {
+
+OpusAudioEncoder::OpusAudioEncoder(int sample_rate, int frame_ms, int bitrate)
+    : sample_rate_(sample_rate), frame_samples_(sample_rate / 1000 * frame_ms) {
+  int error = OPUS_OK;
+  encoder_ =
+      opus_encoder_create(sample_rate, 1, OPUS_APPLICATION_VOIP, &error);
+  if (error != OPUS_OK) {
+    encoder_ = nullptr;
+    return;
+  }
+  opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bitrate));
+  opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+}
+
+OpusAudioEncoder::~OpusAudioEncoder() {
+  if (encoder_ != nullptr) opus_encoder_destroy(encoder_);
+}
+
+int OpusAudioEncoder::encode(std::span<const int16_t> pcm,
+                             std::span<uint8_t> out) {
+  if (encoder_ == nullptr) return -1;
+  const std::size_t frames = pcm.size() / frame_samples_;
+  if (pcm.size() % frame_samples_ != 0 ||
+      !supports_packet_frames(static_cast<int>(frames))) {
+    return -1;
+  }
+  opus_int32 n = opus_encode(encoder_, pcm.data(),
+                             static_cast<int>(pcm.size()), out.data(),
+                             static_cast<opus_int32>(out.size()));
+  return n < 0 ? -1 : static_cast<int>(n);
+}
+
+bool OpusAudioEncoder::supports_packet_frames(int frames) const {
+  if (frames < 1) return false;
+  const int ms = frames * frame_samples_ * 1000 / sample_rate_;
+  return ms == 10 || ms == 20 || ms == 40 || ms == 60;
+}
+
+void OpusAudioEncoder::set_bitrate(int bits_per_second) {
+  if (encoder_ == nullptr) return;
+  opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bits_per_second));
+}
+
+void OpusAudioEncoder::set_complexity(int complexity) {
+  if (encoder_ == nullptr) return;
+  opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+}
+
+void OpusAudioEncoder::set_fec(bool enabled, int loss_percent) {
+  if (encoder_ == nullptr) return;
+  opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(enabled ? 1 : 0));
+  opus_encoder_ctl(encoder_,
+                   OPUS_SET_PACKET_LOSS_PERC(std::clamp(loss_percent, 0, 100)));
+}
+
+OpusAudioDecoder::OpusAudioDecoder(int sample_rate, int frame_ms)
+    : sample_rate_(sample_rate), frame_samples_(sample_rate / 1000 * frame_ms) {
+  int error = OPUS_OK;
+  decoder_ = opus_decoder_create(sample_rate, 1, &error);
+  if (error != OPUS_OK) decoder_ = nullptr;
+}
+
+OpusAudioDecoder::~OpusAudioDecoder() {
+  if (decoder_ != nullptr) opus_decoder_destroy(decoder_);
+}
+
+int OpusAudioDecoder::decode(std::span<const uint8_t> packet,
+                             std::span<int16_t> pcm) {
+  if (decoder_ == nullptr) return -1;
+  int n = opus_decode(decoder_, packet.data(),
+                      static_cast<opus_int32>(packet.size()), pcm.data(),
+                      static_cast<int>(pcm.size()), 0);
+  return n < 0 ? -1 : n;
+}
+
+int OpusAudioDecoder::conceal(std::span<int16_t> pcm) {
+  if (decoder_ == nullptr) return -1;
+  int samples = std::min(static_cast<int>(pcm.size()), frame_samples_);
+  int n = opus_decode(decoder_, nullptr, 0, pcm.data(), samples, 0);
+  return n < 0 ? -1 : n;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,64 @@
+#ifndef XIAOZI_CODEC_OPUS_CODEC_H_
+#define XIAOZI_CODEC_OPUS_CODEC_H_
+
+// Only built when libopus is found (XIAOZI_HAVE_OPUS).
+
+#include "codec/audio_codec.h"
+
+struct OpusEncoder;
+struct OpusDecoder;
+
+namespace xiaozi {
+
+// Mono VoIP-mode Opus. frame_ms is one of 10, 20, 40, 60.
+class OpusAudioEncoder : public AudioEncoder {
+ public:
+  OpusAudioEncoder(int sample_rate, int frame_ms, int bitrate);
+  ~OpusAudioEncoder() override;
+
+  // False if libopus refused the parameters; encode() then fails and the
+  // setters do nothing.
+  bool ok() const { return encoder_ != nullptr; }
+
+  int sample_rate() const override { return sample_rate_; }
+  int frame_samples() const override { return frame_samples_; }
+  int encode(std::span<const int16_t> pcm, std::span<uint8_t> out) override;
+  // Packets of 10, 20, 40 or 60 ms.
+  bool supports_packet_frames(int frames) const override;
+
+  void set_bitrate(int bits_per_second) override;
+  void set_complexity(int complexity) override;
+  int max_complexity() const override { return 10; }
+  void set_fec(bool enabled, int loss_percent) override;
+
+ private:
+  OpusEncoder* encoder_ = nullptr;
+  int sample_rate_;
+  int frame_samples_;
+};
+
+class OpusAudioDecoder : public AudioDecoder {
+ public:
+  OpusAudioDecoder(int sample_rate, int frame_ms);
+  ~OpusAudioDecoder() override;
+
+  // False if libopus refused the parameters; decode() and conceal() then
+  // fail.
+  bool ok() const { return decoder_ != nullptr; }
+
+  int sample_rate() const override { return sample_rate_; }
+  int frame_samples() const override { return frame_samples_; }
+  int decode(std::span<const uint8_t> packet,
+             std::span<int16_t> pcm) override;
+  // Opus' own packet-loss concealment.
+  int conceal(std::span<int16_t> pcm) override;
+
+ private:
+  OpusDecoder* decoder_ = nullptr;
+  int sample_rate_;
+  int frame_samples_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_CODEC_OPUS_CODEC_H_
@@ -0,0 +1,134 @@
+#include "codec/tts_playback.h"
+
+#include <algorithm>
+
+#include "base/trace.h"
+
+namespace xiaozi {
+
+TtsPlayback::TtsPlayback(DecoderStage& source, Config config)
+    : source_(source),
+      config_(config),
+      prebuffer_ms_(config.min_prebuffer_ms) {}
+
+void TtsPlayback::begin(uint64_t origin_ns) {
+  origin_ns_.store(origin_ns, std::memory_order_relaxed);
+  ended_.store(false, std::memory_order_relaxed);
+  generation_.fetch_add(1, std::memory_order_release);
+}
+
+void TtsPlayback::end() { ended_.store(true, std::memory_order_release); }
+
+uint32_t TtsPlayback::ms(std::size_t samples) const {
+  return static_cast<uint32_t>(samples * 1000 / config_.sample_rate);
+}
+
+void TtsPlayback::fetch() {
+  FrameRef pcm;
+  while (count_ < kMaxFrames && source_.pop(pcm)) {
+    queued_samples_ += pcm.size() / sizeof(int16_t);
+    queue_[(head_ + count_) % kMaxFrames] = std::move(pcm);
+    ++count_;
+  }
+}
+
+void TtsPlayback::start_reply() {
+  replies_.fetch_add(1, std::memory_order_relaxed);
+  awaiting_first_audio_ = true;
+  reply_underran_ = false;
+  // The tail of a previous reply keeps playing; the new one follows it.
+  tail_samples_ = queued_samples_;
+  if (state_ == State::kIdle) state_ = State::kBuffering;
+}
+
+std::size_t TtsPlayback::pull(std::span<int16_t> out, uint64_t now_ns) {
+  const uint32_t generation = generation_.load(std::memory_order_acquire);
+  if (generation != seen_generation_) {
+    seen_generation_ = generation;
+    start_reply();
+  }
+  fetch();
+  const bool ended = ended_.load(std::memory_order_acquire);
+  const uint32_t prebuffer = prebuffer_ms_.load(std::memory_order_relaxed);
+
+  if (state_ == State::kIdle && count_ > 0) state_ = State::kBuffering;
+  if (state_ == State::kBuffering) {
+    if (ms(queued_samples_) >= prebuffer || (ended && count_ > 0)) {
+      state_ = State::kPlaying;
+    } else if (ended) {
+      state_ = State::kIdle;  // the reply ended while rebuffering
+    }
+  }
+
+  std::size_t written = 0;
+  if (state_ == State::kPlaying) {
+    while (written < out.size() && count_ > 0) {
+      const auto pcm = queue_[head_].as<const int16_t>();
+      const std::size_t n =
+          std::min(pcm.size() - offset_, out.size() - written);
+      std::copy_n(pcm.data() + offset_, n, out.data() + written);
+      offset_ += n;
+      written += n;
+      queued_samples_ -= n;
+      if (offset_ == pcm.size()) {
+        queue_[head_].reset();
+        head_ = (head_ + 1) % kMaxFrames;
+        --count_;
+        offset_ = 0;
+      }
+    }
+    if (written < out.size()) {
+      if (ended) {
+        state_ = State::kIdle;
+        if (!reply_underran_) {
+          prebuffer_ms_.store(
+              std::max(config_.min_prebuffer_ms,
+                       prebuffer > config_.shrink_ms
+                           ? prebuffer - config_.shrink_ms
+                           : 0),
+              std::memory_order_relaxed);
+        }
+      } else if (awaiting_first_audio_ && written <= tail_samples_) {
+        // The previous reply's tail ran out before this one's first audio:
+        // the new reply is still buffering, not underrunning.
+        state_ = State::kBuffering;
+      } else {
+        state_ = State::kBuffering;
+        reply_underran_ = true;
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+        prebuffer_ms_.store(
+            std::min(config_.max_prebuffer_ms, prebuffer + config_.grow_ms),
+            std::memory_order_relaxed);
+      }
+    }
+  }
+
+  const std::size_t tail = std::min(written, tail_samples_);
+  tail_samples_ -= tail;
+  if (written > tail && awaiting_first_audio_) {
+    awaiting_first_audio_ = false;
+    const uint64_t origin = origin_ns_.load(std::memory_order_relaxed);
+    const uint64_t latency = now_ns > origin ? now_ns - origin : 0;
+    first_audio_ns_.store(latency, std::memory_order_relaxed);
+    if (latency > max_first_audio_ns_.load(std::memory_order_relaxed)) {
+      max_first_audio_ns_.store(latency, std::memory_order_relaxed);
+    }
+    XIAOZI_TRACE_RECORD(kFirstAudio, latency);
+  }
+  std::fill(out.begin() + written, out.end(), int16_t{0});
+  buffered_ms_.store(ms(queued_samples_), std::memory_order_relaxed);
+  return written;
+}
+
+TtsPlayback::Stats TtsPlayback::stats() const {
+  return Stats{
+      replies_.load(std::memory_order_relaxed),
+      underruns_.load(std::memory_order_relaxed),
+      prebuffer_ms_.load(std::memory_order_relaxed),
+      buffered_ms_.load(std::memory_order_relaxed),
+      first_audio_ns_.load(std::memory_order_relaxed),
+      max_first_audio_ns_.load(std::memory_order_relaxed),
+  };
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,108 @@
+#ifndef XIAOZI_CODEC_TTS_PLAYBACK_H_
+#define XIAOZI_CODEC_TTS_PLAYBACK_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+#include "codec/decoder_stage.h"
+#include "memory/frame_pool.h"
+
+namespace xiaozi {
+
+// Playout of a streamed TTS reply. The codec thread keeps decoding ahead
+// (DecoderStage); on every I2S DMA refill pull() moves whatever it has
+// decoded into a local queue and starts the reply as soon as prebuffer_ms
+// of audio is queued rather than waiting for a fixed share of the stream.
+// Once end() is signalled the tail plays even below the threshold, so a
+// reply shorter than the prebuffer is not held back.
+//
+// An underrun mid-reply pauses output, raises the threshold by grow_ms (up
+// to max_prebuffer_ms) and rebuffers; a reply that finishes without one
+// lowers it by shrink_ms toward min_prebuffer_ms, so the threshold tracks
+// how bursty the link currently is. The previous reply's tail running out
+// before a new reply's first audio is not an underrun.
+//
+// Time to first audio runs from begin() to the refill that carries the
+// first sample of the reply; it is reported in stats() and, with
+// XIAOZI_TRACE, as the first_audio stage. Samples already queued when the
+// new reply starts are the previous reply's tail and do not count.
+//
+// begin() and end() run on the protocol thread, pull() on the I2S thread,
+// stats() anywhere.
+class TtsPlayback {
+ public:
+  static constexpr std::size_t kMaxFrames = 32;
+
+  struct Config {
+    int sample_rate = 16000;
+    uint32_t min_prebuffer_ms = 60;
+    uint32_t max_prebuffer_ms = 600;
+    uint32_t grow_ms = 60;
+    uint32_t shrink_ms = 20;
+  };
+
+  struct Stats {
+    uint64_t replies;
+    uint64_t underruns;
+    uint32_t prebuffer_ms;  // current start threshold
+    uint32_t buffered_ms;
+    uint64_t first_audio_ns;      // of the latest reply
+    uint64_t max_first_audio_ns;
+  };
+
+  TtsPlayback(DecoderStage& source, Config config);
+  explicit TtsPlayback(DecoderStage& source)
+      : TtsPlayback(source, Config{}) {}
+
+  // A reply starts (the `tts start` message, or the end of the user's
+  // turn); `origin_ns` is the time to first audio's zero.
+  void begin(uint64_t origin_ns);
+  // The server has sent the whole reply.
+  void end();
+
+  // Fills `out` with the next samples of the reply, silence where there
+  // is none, and returns how many are audio.
+  std::size_t pull(std::span<int16_t> out, uint64_t now_ns);
+
+  Stats stats() const;
+
+ private:
+  enum class State { kIdle, kBuffering, kPlaying };
+
+  void fetch();
+  void start_reply();
+  uint32_t ms(std::size_t samples) const;
+
+  DecoderStage& source_;
+  Config config_;
+
+  // Protocol thread -> I2S thread.
+  std::atomic<uint32_t> generation_{0};
+  std::atomic<uint64_t> origin_ns_{0};
+  std::atomic<bool> ended_{false};
+
+  // I2S thread.
+  std::array<FrameRef, kMaxFrames> queue_;
+  std::size_t head_ = 0;
+  std::size_t count_ = 0;
+  std::size_t offset_ = 0;           // samples of queue_[head_] played
+  std::size_t queued_samples_ = 0;   // not yet played
+  std::size_t tail_samples_ = 0;     // of those, the previous reply's
+  State state_ = State::kIdle;
+  uint32_t seen_generation_ = 0;
+  bool awaiting_first_audio_ = false;
+  bool reply_underran_ = false;
+
+  std::atomic<uint32_t> prebuffer_ms_;
+  std::atomic<uint32_t> buffered_ms_{0};
+  std::atomic<uint64_t> replies_{0};
+  std::atomic<uint64_t> underruns_{0};
+  std::atomic<uint64_t> first_audio_ns_{0};
+  std::atomic<uint64_t> max_first_audio_ns_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_CODEC_TTS_PLAYBACK_H_
@@ -0,0 +1,75 @@
+#include "display/dirty_region.h"
+
+#include <limits>
+
+namespace xiaozi {
+
+DirtyRegion::DirtyRegion(Rect screen, int32_t transfer_overhead)
+    : screen_(screen), overhead_(transfer_overhead) {}
+
+int32_t DirtyRegion::area() const {
+  int32_t total = 0;
+  for (std::size_t i = 0; i < count_; ++i) total += rects_[i].area();
+  return total;
+}
+
+int32_t DirtyRegion::waste(const Rect& a, const Rect& b) const {
+  // Overlap would be sent twice, so it counts in favour of merging.
+  return bounding(a, b).area() - (a.area() + b.area()) - overhead_;
+}
+
+void DirtyRegion::remove(std::size_t i) {
+  rects_[i] = rects_[--count_];
+}
+
+void DirtyRegion::add(Rect r) {
+  r = intersect(r, screen_);
+  if (r.empty()) return;
+  // Absorb every rectangle the new one should merge with; the grown
+  // rectangle may now reach others, so rescan until nothing changes.
+  for (bool merged = true; merged;) {
+    merged = false;
+    for (std::size_t i = 0; i < count_; ++i) {
+      if (rects_[i].contains(r)) return;
+      if (r.contains(rects_[i]) || waste(r, rects_[i]) <= 0) {
+        r = bounding(r, rects_[i]);
+        remove(i);
+        merged = true;
+        break;
+      }
+    }
+  }
+  if (count_ < kMaxRects) {
+    rects_[count_++] = r;
+    return;
+  }
+  // Full: fold the cheapest pair, counting the new rectangle as a member.
+  std::size_t best_i = kMaxRects, best_j = 0;
+  int32_t best = std::numeric_limits<int32_t>::max();
+  for (std::size_t i = 0; i <= count_; ++i) {
+    const Rect& a = i == count_ ? r : rects_[i];
+    for (std::size_t j = 0; j < count_; ++j) {
+      if (j >= i && i != count_) break;
+      const int32_t w = waste(a, rects_[j]);
+      if (w < best) {
+        best = w;
+        best_i = i;
+        best_j = j;
+      }
+    }
+  }
+  const Rect& a = best_i == count_ ? r : rects_[best_i];
+  const Rect folded = bounding(a, rects_[best_j]);
+  if (best_i == count_) {
+    remove(best_j);
+  } else {
+    // best_j < best_i, so removing best_i first keeps best_j valid.
+    remove(best_i);
+    remove(best_j);
+    rects_[count_++] = r;
+  }
+  // The folded rectangle may now overlap others; re-adding merges them.
+  add(folded);
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,48 @@
+#ifndef XIAOZI_DISPLAY_DIRTY_REGION_H_
+#define XIAOZI_DISPLAY_DIRTY_REGION_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "display/rect.h"
+
+namespace xiaozi {
+
+// The set of screen areas that changed since the last flush, kept as at
+// most kMaxRects rectangles. Every panel transfer pays a fixed cost for
+// the window commands (CASET/RASET/RAMWR on the usual SPI controllers), so
+// two rectangles are merged whenever their bounding box costs no more
+// pixels to send than both of them plus that overhead. Past kMaxRects the
+// pair whose merge wastes the fewest pixels is merged.
+class DirtyRegion {
+ public:
+  static constexpr std::size_t kMaxRects = 8;
+
+  // `transfer_overhead` is the per-transfer cost expressed in pixels.
+  explicit DirtyRegion(Rect screen, int32_t transfer_overhead = 256);
+
+  // Clipped to the screen; empty rectangles are ignored.
+  void add(Rect r);
+  void add_all() { add(screen_); }
+  void clear() { count_ = 0; }
+
+  bool empty() const { return count_ == 0; }
+  std::span<const Rect> rects() const { return {rects_.data(), count_}; }
+  int32_t area() const;
+
+ private:
+  // Bounding-box pixels minus the pixels the pair would send separately.
+  int32_t waste(const Rect& a, const Rect& b) const;
+  void remove(std::size_t i);
+
+  Rect screen_;
+  int32_t overhead_;
+  std::array<Rect, kMaxRects> rects_;
+  std::size_t count_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_DISPLAY_DIRTY_REGION_H_
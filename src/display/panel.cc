@@ -0,0 +1,24 @@
+#include "display/panel.h"
+
+#include <algorithm>
+
+namespace xiaozi {
+
+FramebufferPanel::FramebufferPanel(int width, int height)
+    : width_(width),
+      height_(height),
+      framebuffer_(std::size_t(width) * height, 0) {}
+
+void FramebufferPanel::transfer(const Rect& rect,
+                                std::span<const uint16_t> pixels) {
+  const Rect r = intersect(rect, {0, 0, int16_t(width_), int16_t(height_)});
+  if (r != rect || pixels.size() < std::size_t(rect.area())) return;
+  for (int row = 0; row < rect.h; ++row) {
+    std::copy_n(&pixels[std::size_t(row) * rect.w], rect.w,
+                &framebuffer_[std::size_t(rect.y + row) * width_ + rect.x]);
+  }
+  ++transfers_;
+  pixels_ += rect.area();
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,65 @@
+#ifndef XIAOZI_DISPLAY_PANEL_H_
+#define XIAOZI_DISPLAY_PANEL_H_
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "display/rect.h"
+
+namespace xiaozi {
+
+// An LCD controller behind a DMA-capable bus (SPI or i80). One transfer is
+// in flight at a time: transfer() starts pushing `pixels` into the window
+// `rect` and may return before the bus is done, so the caller must leave
+// the buffer alone until wait() returns. The renderer uses that to
+// rasterize the next band while the previous one is on the wire.
+//
+// Pixels are RGB565 in the order the controller expects them on the bus;
+// panels that want big-endian words say so with swap_bytes().
+class Panel {
+ public:
+  virtual ~Panel() = default;
+
+  virtual int width() const = 0;
+  virtual int height() const = 0;
+  virtual bool swap_bytes() const { return false; }
+
+  virtual void transfer(const Rect& rect,
+                        std::span<const uint16_t> pixels) = 0;
+  // Blocks until the transfer started last has completed; returns at once
+  // if none is in flight.
+  virtual void wait() = 0;
+};
+
+// A panel kept in host memory, for the simulator and benchmarks. Transfers
+// complete synchronously.
+class FramebufferPanel : public Panel {
+ public:
+  struct Stats {
+    uint64_t transfers;
+    uint64_t pixels;
+  };
+
+  FramebufferPanel(int width, int height);
+
+  int width() const override { return width_; }
+  int height() const override { return height_; }
+  void transfer(const Rect& rect, std::span<const uint16_t> pixels) override;
+  void wait() override {}
+
+  std::span<const uint16_t> pixels() const { return framebuffer_; }
+  uint16_t at(int x, int y) const { return framebuffer_[y * width_ + x]; }
+  Stats stats() const { return {transfers_, pixels_}; }
+
+ private:
+  int width_;
+  int height_;
+  std::vector<uint16_t> framebuffer_;
+  uint64_t transfers_ = 0;
+  uint64_t pixels_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_DISPLAY_PANEL_H_
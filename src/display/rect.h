@@ -0,0 +1,49 @@
+#ifndef XIAOZI_DISPLAY_RECT_H_
+#define XIAOZI_DISPLAY_RECT_H_
+
+#include <algorithm>
+#include <cstdint>
+
+namespace xiaozi {
+
+// Half-open screen rectangle [x, x + w) x [y, y + h) in pixels.
+struct Rect {
+  int16_t x = 0;
+  int16_t y = 0;
+  int16_t w = 0;
+  int16_t h = 0;
+
+  bool empty() const { return w <= 0 || h <= 0; }
+  int right() const { return x + w; }
+  int bottom() const { return y + h; }
+  int32_t area() const { return empty() ? 0 : int32_t{w} * h; }
+
+  bool contains(const Rect& r) const {
+    return !r.empty() && r.x >= x && r.y >= y && r.right() <= right() &&
+           r.bottom() <= bottom();
+  }
+  bool operator==(const Rect&) const = default;
+};
+
+inline Rect intersect(const Rect& a, const Rect& b) {
+  const int x = std::max(a.x, b.x);
+  const int y = std::max(a.y, b.y);
+  const int r = std::min(a.right(), b.right());
+  const int btm = std::min(a.bottom(), b.bottom());
+  if (r <= x || btm <= y) return {};
+  return {int16_t(x), int16_t(y), int16_t(r - x), int16_t(btm - y)};
+}
+
+// Smallest rectangle covering both; an empty operand is ignored.
+inline Rect bounding(const Rect& a, const Rect& b) {
+  if (a.empty()) return b;
+  if (b.empty()) return a;
+  const int x = std::min(a.x, b.x);
+  const int y = std::min(a.y, b.y);
+  return {int16_t(x), int16_t(y), int16_t(std::max(a.right(), b.right()) - x),
+          int16_t(std::max(a.bottom(), b.bottom()) - y)};
+}
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_DISPLAY_RECT_H_
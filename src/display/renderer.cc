@@ -0,0 +1,227 @@
+#include "display/renderer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xiaozi {
+namespace {
+
+// RGB565 alpha blend with the three channels spread into one word
+// (0x07e0f81f keeps a guard gap above each), so one multiply blends all.
+uint16_t blend565(uint16_t fg, uint16_t bg, uint8_t alpha) {
+  if (alpha == 255) return fg;
+  if (alpha == 0) return bg;
+  uint32_t f = (fg | uint32_t{fg} << 16) & 0x07e0f81fu;
+  uint32_t b = (bg | uint32_t{bg} << 16) & 0x07e0f81fu;
+  b += ((f - b) * (alpha >> 3)) >> 5;
+  b &= 0x07e0f81fu;
+  return static_cast<uint16_t>(b | b >> 16);
+}
+
+}  // namespace
+
+Renderer::Renderer(Panel& panel, Config config)
+    : panel_(panel),
+      config_(config),
+      screen_{0, 0, int16_t(panel.width()), int16_t(panel.height())},
+      dirty_(screen_, config.transfer_overhead),
+      text_cache_(config.text_cache_bytes) {
+  // A band is at least one full row of the widest possible rectangle.
+  const std::size_t size =
+      std::max<std::size_t>(config_.band_pixels, screen_.w);
+  config_.band_pixels = size;
+  for (auto& buffer : buffers_) buffer.resize(size);
+  dirty_.add_all();
+}
+
+Renderer::NodeId Renderer::add(Node node) {
+  node.ink = measure(node);
+  dirty_.add(node.ink);
+  nodes_.push_back(std::move(node));
+  return static_cast<NodeId>(nodes_.size() - 1);
+}
+
+Renderer::NodeId Renderer::add_fill(Rect bounds, uint16_t color) {
+  Node node{};
+  node.kind = Kind::kFill;
+  node.bounds = bounds;
+  node.color = color;
+  return add(std::move(node));
+}
+
+Renderer::NodeId Renderer::add_image(int16_t x, int16_t y,
+                                     const ImageView& image) {
+  Node node{};
+  node.kind = Kind::kImage;
+  node.bounds = {x, y, int16_t(image.width), int16_t(image.height)};
+  node.image = image;
+  return add(std::move(node));
+}
+
+Renderer::NodeId Renderer::add_text(Rect bounds, const FontView& font,
+                                    std::string_view text, uint16_t color) {
+  Node node{};
+  node.kind = Kind::kText;
+  node.bounds = bounds;
+  node.font = font;
+  node.text = std::string(text);
+  node.color = color;
+  return add(std::move(node));
+}
+
+Renderer::Node* Renderer::node(NodeId id) {
+  return id < nodes_.size() ? &nodes_[id] : nullptr;
+}
+
+Rect Renderer::measure(const Node& node) {
+  if (!node.visible) return {};
+  if (node.kind != Kind::kText) return node.bounds;
+  const TextBitmap& bitmap =
+      text_cache_.get(node.font, node.text, node.bounds.w);
+  return intersect({node.bounds.x, node.bounds.y, int16_t(bitmap.width),
+                    int16_t(bitmap.height)},
+                   node.bounds);
+}
+
+void Renderer::update(Node& node) {
+  dirty_.add(node.ink);
+  node.ink = measure(node);
+  dirty_.add(node.ink);
+}
+
+void Renderer::set_visible(NodeId id, bool visible) {
+  Node* n = node(id);
+  if (n == nullptr || n->visible == visible) return;
+  n->visible = visible;
+  update(*n);
+}
+
+void Renderer::set_bounds(NodeId id, Rect bounds) {
+  Node* n = node(id);
+  if (n == nullptr || n->bounds == bounds) return;
+  if (n->kind == Kind::kImage) {
+    // Images keep their size; only the position applies.
+    bounds.w = int16_t(n->image.width);
+    bounds.h = int16_t(n->image.height);
+  }
+  n->bounds = bounds;
+  update(*n);
+}
+
+void Renderer::set_color(NodeId id, uint16_t color) {
+  Node* n = node(id);
+  if (n == nullptr || n->color == color) return;
+  n->color = color;
+  update(*n);
+}
+
+void Renderer::set_text(NodeId id, std::string_view text) {
+  Node* n = node(id);
+  if (n == nullptr || n->kind != Kind::kText || n->text == text) return;
+  n->text.assign(text);
+  update(*n);
+}
+
+void Renderer::set_image(NodeId id, const ImageView& image) {
+  Node* n = node(id);
+  if (n == nullptr || n->kind != Kind::kImage) return;
+  if (n->image.pixels.data() == image.pixels.data() &&
+      n->image.width == image.width && n->image.height == image.height) {
+    return;
+  }
+  n->image = image;
+  n->bounds.w = int16_t(image.width);
+  n->bounds.h = int16_t(image.height);
+  update(*n);
+}
+
+std::size_t Renderer::render() {
+  if (dirty_.empty()) return 0;
+  std::size_t sent = 0;
+  for (const Rect& r : dirty_.rects()) {
+    const int rows = std::clamp<int>(config_.band_pixels / r.w, 1, r.h);
+    for (int y = r.y; y < r.bottom(); y += rows) {
+      const Rect band{r.x, int16_t(y), r.w,
+                      int16_t(std::min(rows, r.bottom() - y))};
+      uint16_t* out = buffers_[next_buffer_].data();
+      // Overlaps with the DMA of the previous band, from the other buffer.
+      paint(band, out);
+      panel_.wait();
+      panel_.transfer(band, {out, std::size_t(band.area())});
+      next_buffer_ ^= 1;
+      sent += band.area();
+      ++transfers_;
+    }
+  }
+  dirty_.clear();
+  ++frames_;
+  pixels_ += sent;
+  return sent;
+}
+
+void Renderer::paint(const Rect& band, uint16_t* out) {
+  std::fill_n(out, band.area(), config_.background);
+  for (const Node& node : nodes_) {
+    const Rect area = intersect(node.ink, band);
+    if (area.empty()) continue;
+    switch (node.kind) {
+      case Kind::kFill:
+        for (int y = area.y; y < area.bottom(); ++y) {
+          std::fill_n(out + (y - band.y) * band.w + (area.x - band.x), area.w,
+                      node.color);
+        }
+        break;
+      case Kind::kImage:
+        paint_image(node, band, out);
+        break;
+      case Kind::kText:
+        paint_text(node, band, out);
+        break;
+    }
+  }
+  if (panel_.swap_bytes()) {
+    for (int i = 0; i < band.area(); ++i) {
+      out[i] = static_cast<uint16_t>(out[i] << 8 | out[i] >> 8);
+    }
+  }
+}
+
+void Renderer::paint_image(const Node& node, const Rect& band,
+                           uint16_t* out) {
+  const Rect area = intersect(node.ink, band);
+  const ImageView& image = node.image;
+  const int sx = area.x - node.bounds.x;
+  for (int y = area.y; y < area.bottom(); ++y) {
+    const int sy = y - node.bounds.y;
+    const uint8_t* src = image.pixels.data() + sy * image.stride + sx * 2;
+    uint16_t* dst = out + (y - band.y) * band.w + (area.x - band.x);
+    if (image.alpha.empty()) {
+      std::memcpy(dst, src, std::size_t(area.w) * 2);
+      continue;
+    }
+    const uint8_t* alpha = image.alpha.data() + sy * image.width + sx;
+    for (int x = 0; x < area.w; ++x) {
+      const auto fg = static_cast<uint16_t>(src[2 * x] | src[2 * x + 1] << 8);
+      dst[x] = blend565(fg, dst[x], alpha[x]);
+    }
+  }
+}
+
+void Renderer::paint_text(const Node& node, const Rect& band, uint16_t* out) {
+  const Rect area = intersect(node.ink, band);
+  const TextBitmap& bitmap =
+      text_cache_.get(node.font, node.text, node.bounds.w);
+  for (int y = area.y; y < area.bottom(); ++y) {
+    const int by = y - node.bounds.y;
+    uint16_t* dst = out + (y - band.y) * band.w;
+    for (int x = area.x; x < area.right(); ++x) {
+      if (bitmap.covered(x - node.bounds.x, by)) dst[x - band.x] = node.color;
+    }
+  }
+}
+
+Renderer::Stats Renderer::stats() const {
+  return {frames_, transfers_, pixels_, text_cache_.stats()};
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,117 @@
+#ifndef XIAOZI_DISPLAY_RENDERER_H_
+#define XIAOZI_DISPLAY_RENDERER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assets/asset_pack.h"
+#include "display/dirty_region.h"
+#include "display/panel.h"
+#include "display/rect.h"
+#include "display/text_cache.h"
+
+namespace xiaozi {
+
+// Retained-mode screen: the UI describes the screen once as a list of
+// nodes (fills, images and text, painted in the order they were added) and
+// then only changes them. Every change marks the affected area dirty, and
+// render() repaints just the dirty rectangles, band by band, into two
+// buffers that alternate: while the panel DMAs one band the next is
+// rasterized into the other.
+//
+// Images and fonts are views into an AssetPack and must outlive the
+// renderer. Not thread-safe; everything runs on the UI thread.
+class Renderer {
+ public:
+  using NodeId = uint32_t;
+  static constexpr NodeId kInvalidNode = std::numeric_limits<NodeId>::max();
+
+  struct Config {
+    uint16_t background = 0x0000;
+    // Size of each of the two band buffers. A band covers as many rows of
+    // a dirty rectangle as fit.
+    std::size_t band_pixels = 320 * 20;
+    int32_t transfer_overhead = 256;  // see DirtyRegion
+    std::size_t text_cache_bytes = 64 * 1024;
+  };
+
+  struct Stats {
+    uint64_t frames;  // render() calls that sent something
+    uint64_t transfers;
+    uint64_t pixels;
+    TextCache::Stats text;
+  };
+
+  Renderer(Panel& panel, Config config);
+  explicit Renderer(Panel& panel) : Renderer(panel, Config{}) {}
+
+  NodeId add_fill(Rect bounds, uint16_t color);
+  NodeId add_image(int16_t x, int16_t y, const ImageView& image);
+  // Text is clipped to `bounds` and wraps at its width.
+  NodeId add_text(Rect bounds, const FontView& font, std::string_view text,
+                  uint16_t color);
+
+  // Setters that change nothing mark nothing dirty. Unknown ids are
+  // ignored.
+  void set_visible(NodeId id, bool visible);
+  void set_bounds(NodeId id, Rect bounds);
+  void set_color(NodeId id, uint16_t color);
+  void set_text(NodeId id, std::string_view text);
+  void set_image(NodeId id, const ImageView& image);
+
+  void invalidate(Rect area) { dirty_.add(area); }
+  void invalidate_all() { dirty_.add_all(); }
+
+  // Sends the dirty area and returns the number of pixels sent. The last
+  // band may still be in flight on return; the next render() (or the
+  // panel's wait()) settles it.
+  std::size_t render();
+
+  TextCache& text_cache() { return text_cache_; }
+  Stats stats() const;
+
+ private:
+  enum class Kind : uint8_t { kFill, kImage, kText };
+
+  struct Node {
+    Kind kind;
+    bool visible = true;
+    uint16_t color = 0;
+    Rect bounds;
+    Rect ink;  // what the node paints, within bounds
+    ImageView image;
+    FontView font;
+    std::string text;
+  };
+
+  NodeId add(Node node);
+  Node* node(NodeId id);
+  // Recomputes node.ink and marks the old and new ink dirty.
+  void update(Node& node);
+  Rect measure(const Node& node);
+
+  void paint(const Rect& band, uint16_t* out);
+  void paint_image(const Node& node, const Rect& band, uint16_t* out);
+  void paint_text(const Node& node, const Rect& band, uint16_t* out);
+
+  Panel& panel_;
+  Config config_;
+  Rect screen_;
+  DirtyRegion dirty_;
+  TextCache text_cache_;
+  std::vector<Node> nodes_;
+  std::vector<uint16_t> buffers_[2];
+  int next_buffer_ = 0;
+
+  uint64_t frames_ = 0;
+  uint64_t transfers_ = 0;
+  uint64_t pixels_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_DISPLAY_RENDERER_H_
@@ -0,0 +1,191 @@
+#include "display/text_cache.h"
+
+#include <algorithm>
+#include <iterator>
+#include <optional>
+
+namespace xiaozi {
+namespace {
+
+struct Placed {
+  uint32_t codepoint;
+  std::optional<FontView::Glyph> glyph;  // nullopt for '\n'
+};
+
+// Decodes one UTF-8 sequence; malformed bytes decode to U+FFFD one at a
+// time so a bad byte never swallows the text after it.
+uint32_t next_codepoint(std::string_view& s) {
+  const auto b0 = static_cast<uint8_t>(s[0]);
+  int len = b0 < 0x80 ? 1 : (b0 >> 5) == 6 ? 2 : (b0 >> 4) == 14 ? 3
+                        : (b0 >> 3) == 30 ? 4 : 0;
+  if (len == 0 || std::size_t(len) > s.size()) {
+    s.remove_prefix(1);
+    return 0xfffd;
+  }
+  uint32_t cp = len == 1 ? b0 : b0 & (0x7f >> len);
+  for (int i = 1; i < len; ++i) {
+    const auto b = static_cast<uint8_t>(s[i]);
+    if ((b & 0xc0) != 0x80) {
+      s.remove_prefix(1);
+      return 0xfffd;
+    }
+    cp = cp << 6 | (b & 0x3f);
+  }
+  s.remove_prefix(len);
+  return cp;
+}
+
+uint64_t key_hash(const void* font, int wrap_width, std::string_view text) {
+  uint64_t h = pack::hash_name(text);
+  h ^= reinterpret_cast<uintptr_t>(font) + 0x9e3779b97f4a7c15ull + (h << 6) +
+       (h >> 2);
+  h ^= static_cast<uint64_t>(wrap_width) * 0xff51afd7ed558ccdull;
+  return h;
+}
+
+}  // namespace
+
+TextCache::TextCache(std::size_t budget_bytes) : budget_(budget_bytes) {}
+
+TextCache::~TextCache() { clear(); }
+
+const TextBitmap& TextCache::get(const FontView& font, std::string_view text,
+                                 int wrap_width) {
+  const void* id = font.bytes().data();
+  const uint64_t hash = key_hash(id, wrap_width, text);
+  auto it = index_.find(hash);
+  if (it != index_.end()) {
+    Entry& e = *it->second;
+    if (e.font == id && e.wrap_width == wrap_width && e.text == text) {
+      ++hits_;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return e.bitmap;
+    }
+    // A 64-bit collision: the newcomer takes the slot.
+    drop(it->second);
+  }
+  ++misses_;
+  TextBitmap bitmap = layout(font, text, wrap_width);
+  // Keep at least the entry being returned, even over budget.
+  const std::size_t size = bitmap.bits.size();
+  evict_to(budget_ > size ? budget_ - size : 0);
+  bool charged = memory::try_charge(MemoryDomain::kUi, size);
+  while (!charged && !lru_.empty()) {
+    drop(std::prev(lru_.end()));
+    ++evictions_;
+    charged = memory::try_charge(MemoryDomain::kUi, size);
+  }
+  if (!charged) memory::charge(MemoryDomain::kUi, size);
+  bytes_ += size;
+  lru_.push_front(
+      Entry{hash, id, wrap_width, std::string(text), std::move(bitmap)});
+  index_.emplace(hash, lru_.begin());
+  return lru_.front().bitmap;
+}
+
+void TextCache::evict_to(std::size_t budget) {
+  while (bytes_ > budget && !lru_.empty()) {
+    drop(std::prev(lru_.end()));
+    ++evictions_;
+  }
+}
+
+void TextCache::drop(std::list<Entry>::iterator it) {
+  bytes_ -= it->bitmap.bits.size();
+  memory::release(MemoryDomain::kUi, it->bitmap.bits.size());
+  index_.erase(it->hash);
+  lru_.erase(it);
+}
+
+void TextCache::clear() {
+  while (!lru_.empty()) drop(lru_.begin());
+}
+
+TextCache::Stats TextCache::stats() const {
+  return {hits_, misses_, evictions_, bytes_, lru_.size()};
+}
+
+TextBitmap TextCache::layout(const FontView& font, std::string_view text,
+                             int wrap_width) {
+  std::vector<Placed> glyphs;
+  while (!text.empty()) {
+    const uint32_t cp = next_codepoint(text);
+    if (cp == '\n') {
+      glyphs.push_back({cp, std::nullopt});
+    } else if (auto g = font.find(cp)) {
+      glyphs.push_back({cp, g});
+    }
+  }
+
+  // Break into lines of [begin, end) glyphs, each start recorded.
+  std::vector<std::size_t> starts{0};
+  int pen = 0;
+  std::size_t last_space = 0;  // index after the last space in this line
+  for (std::size_t i = 0; i < glyphs.size(); ++i) {
+    if (!glyphs[i].glyph) {
+      starts.push_back(i + 1);
+      pen = 0;
+      last_space = 0;
+      continue;
+    }
+    const int advance = glyphs[i].glyph->metrics->advance;
+    if (wrap_width > 0 && pen > 0 && pen + advance > wrap_width) {
+      const std::size_t start = last_space > starts.back() ? last_space : i;
+      starts.push_back(start);
+      pen = 0;
+      last_space = 0;
+      for (std::size_t j = start; j < i; ++j) {
+        pen += glyphs[j].glyph->metrics->advance;
+      }
+    }
+    pen += advance;
+    if (glyphs[i].codepoint == ' ') last_space = i + 1;
+  }
+  starts.push_back(glyphs.size());
+
+  // Lines are as wide as their ink reaches, but at most the wrap width.
+  int width = 0;
+  for (std::size_t l = 0; l + 1 < starts.size(); ++l) {
+    int x = 0;
+    for (std::size_t i = starts[l]; i < starts[l + 1]; ++i) {
+      if (!glyphs[i].glyph) continue;
+      const pack::Glyph& m = *glyphs[i].glyph->metrics;
+      width = std::max({width, x + m.advance, x + m.x_offset + m.width});
+      x += m.advance;
+    }
+  }
+  if (wrap_width > 0) width = std::min(width, wrap_width);
+  const int lines = static_cast<int>(starts.size()) - 1;
+
+  TextBitmap out;
+  out.width = static_cast<uint16_t>(std::clamp(width, 0, 0xffff));
+  out.height = static_cast<uint16_t>(
+      std::clamp(lines * font.line_height(), 0, 0xffff));
+  out.stride = (out.width + 7u) / 8u;
+  out.bits.assign(out.stride * out.height, 0);
+  for (int l = 0; l < lines; ++l) {
+    const int baseline = l * font.line_height() + font.ascent();
+    int pen_x = 0;
+    for (std::size_t i = starts[l]; i < starts[l + 1]; ++i) {
+      if (!glyphs[i].glyph) continue;
+      const FontView::Glyph& g = *glyphs[i].glyph;
+      const int left = pen_x + g.metrics->x_offset;
+      const int top = baseline - g.metrics->y_offset - g.metrics->height;
+      pen_x += g.metrics->advance;
+      for (int row = 0; row < g.metrics->height; ++row) {
+        const int y = top + row;
+        if (y < 0 || y >= out.height) continue;
+        for (int col = 0; col < g.metrics->width; ++col) {
+          const int x = left + col;
+          if (x < 0 || x >= out.width) continue;
+          if (g.bitmap[row * g.stride + (col >> 3)] & (0x80 >> (col & 7))) {
+            out.bits[y * out.stride + (x >> 3)] |= uint8_t(0x80 >> (x & 7));
+          }
+        }
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,91 @@
+#ifndef XIAOZI_DISPLAY_TEXT_CACHE_H_
+#define XIAOZI_DISPLAY_TEXT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "assets/asset_pack.h"
+#include "memory/memory_domain.h"
+
+namespace xiaozi {
+
+// A laid-out, rasterized run of text: 1 bpp coverage, MSB first, `stride`
+// bytes per row. Lines break at '\n' and before any glyph that would cross
+// the wrap width (between words where there is one, anywhere for CJK).
+struct TextBitmap {
+  uint16_t width = 0;
+  uint16_t height = 0;
+  std::size_t stride = 0;
+  std::vector<uint8_t> bits;
+
+  bool covered(int x, int y) const {
+    return bits[y * stride + (x >> 3)] & (0x80 >> (x & 7));
+  }
+};
+
+// Text laid out and rasterized once per (font, wrap width, string) and kept
+// in an LRU list bounded by bitmap bytes. The UI redraws the same status
+// strings and chat lines band after band and frame after frame, so a hit
+// replaces UTF-8 decoding, glyph lookups and bit blitting with one hash of
+// the string. Codepoints missing from the font are skipped.
+//
+// Bitmaps are charged to MemoryDomain::kUi; when the domain's budget
+// refuses one, older entries are evicted until it fits, so the cache
+// shrinks under UI memory pressure.
+//
+// Not thread-safe; owned by the UI thread.
+class TextCache {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    std::size_t bytes;
+    std::size_t entries;
+  };
+
+  explicit TextCache(std::size_t budget_bytes = 64 * 1024);
+  ~TextCache();
+
+  TextCache(const TextCache&) = delete;
+  TextCache& operator=(const TextCache&) = delete;
+
+  // Valid until the next get(). Text wider than `wrap_width` wraps; 0
+  // disables wrapping.
+  const TextBitmap& get(const FontView& font, std::string_view text,
+                        int wrap_width);
+
+  void clear();
+  Stats stats() const;
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    const void* font;
+    int wrap_width;
+    std::string text;
+    TextBitmap bitmap;
+  };
+
+  static TextBitmap layout(const FontView& font, std::string_view text,
+                           int wrap_width);
+  void evict_to(std::size_t budget);
+  void drop(std::list<Entry>::iterator it);
+
+  std::size_t budget_;
+  std::size_t bytes_ = 0;
+  std::list<Entry> lru_;  // most recently used first
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  uint64_t evictions_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_DISPLAY_TEXT_CACHE_H_
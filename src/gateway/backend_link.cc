@@ -0,0 +1,188 @@
+#include "gateway/backend_link.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "net/tcp_stream.h"
+
+namespace xiaozi {
+namespace {
+
+void put_be32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+uint32_t get_be32(const uint8_t* p) {
+  return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 |
+         p[3];
+}
+
+}  // namespace
+
+BackendLink::BackendLink(Config config)
+    : config_(config), rx_(kHeaderBytes + config.max_record_bytes) {}
+
+bool BackendLink::connect(const std::string& host, int port, int timeout_ms) {
+  close();
+  stream_ = TcpStream::connect(host, port, timeout_ms);
+  return stream_ != nullptr;
+}
+
+void BackendLink::attach(std::unique_ptr<Stream> stream) {
+  close();
+  stream_ = std::move(stream);
+}
+
+void BackendLink::close() {
+  if (stream_ != nullptr) {
+    stream_->close();
+    stream_.reset();
+  }
+  dropped_.fetch_add(queued_, std::memory_order_relaxed);
+  queued_ = 0;
+  backlog_.clear();
+  rx_len_ = rx_consumed_ = 0;
+}
+
+void BackendLink::fail() { close(); }
+
+void BackendLink::queue(RecordType type, uint32_t session,
+                        std::span<const uint8_t> payload) {
+  if (queued_ == kMaxQueued) flush();
+  std::array<uint8_t, kHeaderBytes>& header = headers_[queued_];
+  header = {type, 0, 0, 0};
+  put_be32(&header[4], session);
+  put_be32(&header[8], static_cast<uint32_t>(payload.size()));
+  // iov_[0] is kept for the backlog.
+  iov_[1 + 2 * queued_] = {header.data(), kHeaderBytes};
+  iov_[2 + 2 * queued_] = {const_cast<uint8_t*>(payload.data()),
+                           payload.size()};
+  ++queued_;
+}
+
+bool BackendLink::flush() {
+  if (stream_ == nullptr) {
+    dropped_.fetch_add(queued_, std::memory_order_relaxed);
+    queued_ = 0;
+    return false;
+  }
+  if (stream_->wants_write() && stream_->flush() < 0 && errno != EAGAIN) {
+    fail();
+    return false;
+  }
+  const bool have_backlog = !backlog_.empty();
+  if (have_backlog) iov_[0] = {backlog_.data(), backlog_.size()};
+  const iovec* iov = have_backlog ? &iov_[0] : &iov_[1];
+  const int count = static_cast<int>(2 * queued_ + (have_backlog ? 1 : 0));
+  if (count == 0) return true;
+
+  ssize_t n = stream_->writev(iov, count);
+  writes_.fetch_add(1, std::memory_order_relaxed);
+  if (n < 0) {
+    if (errno != EAGAIN && errno != EINTR) {
+      fail();
+      return false;
+    }
+    n = 0;
+  }
+  std::size_t written = static_cast<std::size_t>(n);
+  if (have_backlog) {
+    if (written < backlog_.size()) {
+      backlog_.erase(backlog_.begin(), backlog_.begin() + written);
+      written = 0;
+    } else {
+      written -= backlog_.size();
+      backlog_.clear();
+    }
+  }
+
+  // Records the socket took whole are done; the one it stopped in has to
+  // be finished whatever the limit, later ones are kept while they fit.
+  uint64_t sent = 0, payload_bytes = 0, copied = 0, dropped = 0;
+  for (std::size_t i = 0; i < queued_; ++i) {
+    const iovec& h = iov_[1 + 2 * i];
+    const iovec& p = iov_[2 + 2 * i];
+    const std::size_t len = h.iov_len + p.iov_len;
+    if (written >= len) {
+      written -= len;
+      ++sent;
+      payload_bytes += p.iov_len;
+      continue;
+    }
+    if (written == 0 && backlog_.size() + len > config_.max_backlog_bytes) {
+      ++dropped;
+      continue;
+    }
+    for (const iovec* piece : {&h, &p}) {
+      const auto* base = static_cast<const uint8_t*>(piece->iov_base);
+      const std::size_t skip = std::min(written, piece->iov_len);
+      written -= skip;
+      backlog_.insert(backlog_.end(), base + skip, base + piece->iov_len);
+      copied += piece->iov_len - skip;
+    }
+    ++sent;
+    payload_bytes += p.iov_len;
+  }
+  queued_ = 0;
+  records_sent_.fetch_add(sent, std::memory_order_relaxed);
+  bytes_sent_.fetch_add(payload_bytes, std::memory_order_relaxed);
+  copied_bytes_.fetch_add(copied, std::memory_order_relaxed);
+  dropped_.fetch_add(dropped, std::memory_order_relaxed);
+  return true;
+}
+
+bool BackendLink::receive(std::vector<Record>& out) {
+  if (stream_ == nullptr) return false;
+  if (rx_consumed_ > 0) {
+    std::memmove(rx_.data(), rx_.data() + rx_consumed_,
+                 rx_len_ - rx_consumed_);
+    rx_len_ -= rx_consumed_;
+    rx_consumed_ = 0;
+  }
+  while (rx_len_ < rx_.size()) {
+    const ssize_t n =
+        stream_->read({rx_.data() + rx_len_, rx_.size() - rx_len_});
+    if (n == 0) {
+      fail();
+      return false;
+    }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EINTR) break;
+      fail();
+      return false;
+    }
+    rx_len_ += static_cast<std::size_t>(n);
+  }
+
+  uint64_t received = 0;
+  while (rx_len_ - rx_consumed_ >= kHeaderBytes) {
+    const uint8_t* p = rx_.data() + rx_consumed_;
+    const uint32_t len = get_be32(p + 8);
+    if (len > config_.max_record_bytes) {
+      fail();
+      return false;
+    }
+    if (rx_len_ - rx_consumed_ < kHeaderBytes + len) break;
+    out.push_back({static_cast<RecordType>(p[0]), get_be32(p + 4),
+                   {p + kHeaderBytes, len}});
+    rx_consumed_ += kHeaderBytes + len;
+    ++received;
+  }
+  records_received_.fetch_add(received, std::memory_order_relaxed);
+  return true;
+}
+
+BackendLink::Stats BackendLink::stats() const {
+  return {records_sent_.load(std::memory_order_relaxed),
+          bytes_sent_.load(std::memory_order_relaxed),
+          writes_.load(std::memory_order_relaxed),
+          copied_bytes_.load(std::memory_order_relaxed),
+          dropped_.load(std::memory_order_relaxed),
+          records_received_.load(std::memory_order_relaxed)};
+}
+
+}  // namespace xiaozi
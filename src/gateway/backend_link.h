@@ -0,0 +1,123 @@
+#ifndef XIAOZI_GATEWAY_BACKEND_LINK_H_
+#define XIAOZI_GATEWAY_BACKEND_LINK_H_
+
+#include <sys/uio.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "net/stream.h"
+
+namespace xiaozi {
+
+// One gateway shard's connection to the ASR backend. Every session of the
+// shard is multiplexed onto it as records, in both directions:
+//   0      type (RecordType)
+//   1..3   zero
+//   4..7   session id, big endian
+//   8..11  payload bytes, big endian
+// followed by the payload: the device ID for kOpen, an audio packet as the
+// device encoded it for kAudio, a JSON message for kText, nothing for
+// kClose.
+//
+// queue() only records where the payload is; flush() sends the headers and
+// payloads with one writev(), straight from the buffers the packets were
+// received into. The caller keeps those buffers untouched until flush()
+// returns. Whatever the socket does not take is copied into a bounded
+// backlog, sent first on the next flush(); records that do not fit are
+// dropped, so a slow backend costs audio instead of gateway memory.
+//
+// Owned by the shard's thread; only stats() may be called elsewhere.
+class BackendLink {
+ public:
+  static constexpr std::size_t kHeaderBytes = 12;
+  static constexpr std::size_t kMaxQueued = 256;
+
+  enum RecordType : uint8_t {
+    kOpen = 1,
+    kAudio = 2,
+    kText = 3,
+    kClose = 4,
+  };
+
+  struct Record {
+    RecordType type;
+    uint32_t session;
+    std::span<const uint8_t> payload;
+  };
+
+  struct Stats {
+    uint64_t records_sent;
+    uint64_t bytes_sent;  // payload bytes
+    uint64_t writes;      // writev() calls
+    uint64_t copied_bytes;  // moved to the backlog after a short write
+    uint64_t dropped;     // records lost to a full backlog or no link
+    uint64_t records_received;
+  };
+
+  struct Config {
+    std::size_t max_backlog_bytes = 1 << 20;
+    // Largest record accepted from the backend.
+    std::size_t max_record_bytes = 64 * 1024;
+  };
+
+  explicit BackendLink(Config config);
+  BackendLink() : BackendLink(Config{}) {}
+
+  bool connect(const std::string& host, int port, int timeout_ms);
+  // Adopts a connected stream (bench, socketpair).
+  void attach(std::unique_ptr<Stream> stream);
+  void close();
+  bool connected() const { return stream_ != nullptr; }
+  int fd() const { return stream_ != nullptr ? stream_->fd() : -1; }
+
+  // Flushes on its own when kMaxQueued records are waiting, so `payload`
+  // must stay valid up to the next flush() from either side.
+  void queue(RecordType type, uint32_t session,
+             std::span<const uint8_t> payload);
+  // False when the connection failed; the link is closed then.
+  bool flush();
+  // Still holding a backlog: wait for the fd to be writable and flush().
+  bool wants_write() const {
+    return stream_ != nullptr && (!backlog_.empty() || stream_->wants_write());
+  }
+
+  // Reads what has arrived and appends the complete records to `out`; their
+  // payloads stay valid until the next receive(). False on EOF or error.
+  bool receive(std::vector<Record>& out);
+
+  // Any thread.
+  Stats stats() const;
+
+ private:
+  void fail();
+
+  Config config_;
+  std::unique_ptr<Stream> stream_;
+
+  std::array<std::array<uint8_t, kHeaderBytes>, kMaxQueued> headers_;
+  std::array<iovec, 2 * kMaxQueued + 1> iov_;
+  std::size_t queued_ = 0;
+  std::vector<uint8_t> backlog_;
+
+  std::vector<uint8_t> rx_;
+  std::size_t rx_len_ = 0;
+  std::size_t rx_consumed_ = 0;
+
+  std::atomic<uint64_t> records_sent_{0};
+  std::atomic<uint64_t> bytes_sent_{0};
+  std::atomic<uint64_t> writes_{0};
+  std::atomic<uint64_t> copied_bytes_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> records_received_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_GATEWAY_BACKEND_LINK_H_
@@ -0,0 +1,106 @@
+#include "gateway/gateway.h"
+
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "gateway/gateway_shard.h"
+
+namespace xiaozi {
+namespace {
+
+// Reuseport group index = low byte of the SSRC (payload bytes 4..7, big
+// endian), i.e. the owning shard, since shards bind in index order. The
+// kernel runs it with the data pointer past the UDP header.
+bool attach_udp_steering(int fd) {
+  static sock_filter code[] = {
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 7),
+      BPF_STMT(BPF_RET | BPF_A, 0),
+  };
+  sock_fprog prog{static_cast<unsigned short>(std::size(code)), code};
+  return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                    sizeof(prog)) == 0;
+}
+
+}  // namespace
+
+Gateway::Gateway(Config config) : config_(std::move(config)) {
+  if (config_.shards == 0) {
+    config_.shards = std::max(1u, std::thread::hardware_concurrency());
+  }
+  config_.shards = std::min(config_.shards, kMaxShards);
+  config_.max_sessions_per_shard =
+      std::clamp<std::size_t>(config_.max_sessions_per_shard, 1,
+                              kMaxSessionsPerShard);
+  for (std::size_t i = 0; i < config_.shards; ++i) {
+    shards_.push_back(std::make_unique<GatewayShard>(*this, i, config_));
+  }
+}
+
+Gateway::~Gateway() { stop(); }
+
+bool Gateway::start() {
+  if (running_) return true;
+  int port = config_.port;
+  for (auto& shard : shards_) {
+    port = shard->bind(port);
+    if (port < 0) return false;
+  }
+  port_ = port;
+  // Without the program the kernel hashes datagrams onto any shard, which
+  // then hands them to their owner.
+  if (shards_.size() > 1 && shards_[0]->udp_fd() >= 0) {
+    attach_udp_steering(shards_[0]->udp_fd());
+  }
+  for (auto& shard : shards_) shard->connect_backend();
+  const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+  for (std::size_t i = 0; i < shards_.size(); ++i) {
+    shards_[i]->start(config_.pin_threads ? static_cast<int>(i % cpus) : -1);
+  }
+  running_ = true;
+  return true;
+}
+
+void Gateway::stop() {
+  if (!running_) return;
+  for (auto& shard : shards_) shard->stop();
+  running_ = false;
+}
+
+std::size_t Gateway::shard_for(std::string_view device_id) const {
+  // FNV-1a.
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (char c : device_id) {
+    h = (h ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+  }
+  return static_cast<std::size_t>(h % shards_.size());
+}
+
+Gateway::Stats Gateway::stats() const {
+  Stats total{};
+  for (const auto& shard : shards_) {
+    const Stats s = shard->stats();
+    total.sessions += s.sessions;
+    total.accepted += s.accepted;
+    total.handed_off += s.handed_off;
+    total.rejected += s.rejected;
+    total.timed_out += s.timed_out;
+    total.frames += s.frames;
+    total.udp_packets += s.udp_packets;
+    total.udp_misrouted += s.udp_misrouted;
+    total.udp_rejected += s.udp_rejected;
+    total.device_dropped += s.device_dropped;
+    total.backend.records_sent += s.backend.records_sent;
+    total.backend.bytes_sent += s.backend.bytes_sent;
+    total.backend.writes += s.backend.writes;
+    total.backend.copied_bytes += s.backend.copied_bytes;
+    total.backend.dropped += s.backend.dropped;
+    total.backend.records_received += s.backend.records_received;
+  }
+  return total;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,128 @@
+#ifndef XIAOZI_GATEWAY_GATEWAY_H_
+#define XIAOZI_GATEWAY_GATEWAY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gateway/backend_link.h"
+
+namespace xiaozi {
+
+class GatewayShard;
+
+// Server end of the device protocol: terminates device WebSocket sessions
+// (plus their UDP audio channel, with OpenSSL) and relays them to the ASR
+// backend over one BackendLink per shard.
+//
+// Each shard is an epoll loop on its own thread, pinned to its own core,
+// with its own SO_REUSEPORT listener and UDP socket on the shared port, so
+// the kernel spreads accepts across cores without a shared accept queue. A
+// session lives on the shard its Device-Id hashes to for its whole life:
+// the shard that accepted the connection reads the upgrade request and,
+// if the device belongs elsewhere, passes the socket to the owner through
+// a single-producer ring (one per pair of shards). UDP datagrams are
+// steered to the owner in the kernel by a reuseport BPF program keyed on
+// the SSRC, whose low byte is the owning shard. Apart from that hand-off
+// no shard touches another's state, and nothing is locked.
+//
+// Audio is never copied in user space on its way to the backend: frames
+// are unmasked in the session's receive buffer (UDP packets decrypted in
+// their pool block and reordered by a JitterBuffer) and written from
+// there. The session's buffer is only compacted after the shard's
+// end-of-batch flush.
+class Gateway {
+ public:
+  static constexpr std::size_t kMaxShards = 256;
+  static constexpr std::size_t kMaxSessionsPerShard = 65536;
+
+  struct Config {
+    std::string bind_address = "0.0.0.0";
+    int port = 8000;  // TCP and UDP; 0 picks one
+    std::size_t shards = 0;  // 0: one per online CPU
+    bool pin_threads = true;
+    std::string backend_host = "127.0.0.1";
+    int backend_port = 9000;
+    BackendLink::Config backend;
+    // Host devices are told to send UDP audio to; empty (or no OpenSSL)
+    // keeps every session on WebSocket.
+    std::string public_host;
+    std::size_t max_sessions_per_shard = 16384;
+    // Largest WebSocket frame accepted from a device; longer ones close the
+    // session.
+    std::size_t max_message_bytes = 4096;
+    // Device-bound bytes a session may queue before messages are dropped.
+    std::size_t max_send_backlog_bytes = 64 * 1024;
+    // A connection is closed, within a second of the deadline, when its
+    // upgrade request is not complete this long after accept, or when an
+    // upgraded session has received nothing (frame or datagram) for
+    // idle_timeout_ms. Devices held warm send only TCP keepalives unless
+    // their ping_interval is set; they reconnect on the next wake. 0 never
+    // times out.
+    uint32_t upgrade_timeout_ms = 10000;
+    uint32_t idle_timeout_ms = 300000;
+    // UDP audio is only taken from the address the session's WebSocket
+    // connection came from. Off for networks whose NAT maps the two onto
+    // different public addresses; the sequence check on a change of port
+    // still applies.
+    bool udp_same_host = true;
+    // UDP audio: jitter buffers are serviced every frame_ms. A session pops
+    // its next packet once the previous one's duration, from its Opus TOC
+    // byte, has passed, so devices may change packet length mid-session.
+    // Pops stay evenly spaced while frame_ms is no longer than the shortest
+    // packet.
+    uint32_t frame_ms = 20;
+    std::size_t udp_pool_blocks = 4096;
+  };
+
+  struct Stats {
+    uint64_t sessions;   // open now
+    uint64_t accepted;
+    uint64_t handed_off;  // accepted on one shard, owned by another
+    uint64_t rejected;   // bad upgrade, protocol error, no capacity
+    uint64_t timed_out;  // closed by upgrade_timeout_ms or idle_timeout_ms
+    uint64_t frames;     // audio packets forwarded to the backend
+    uint64_t udp_packets;
+    uint64_t udp_misrouted;  // reached the wrong shard's socket
+    uint64_t udp_rejected;
+    uint64_t device_dropped;  // device-bound messages over the backlog
+    BackendLink::Stats backend;
+  };
+
+  explicit Gateway(Config config);
+  Gateway() : Gateway(Config{}) {}
+  // Stops the shards if still running.
+  ~Gateway();
+
+  Gateway(const Gateway&) = delete;
+  Gateway& operator=(const Gateway&) = delete;
+
+  // Binds every shard's sockets, connects each to the backend and starts
+  // the threads. False (with nothing left running) if a socket cannot be
+  // bound; an unreachable backend only drops audio until a shard's retry
+  // gets through.
+  bool start();
+  void stop();
+
+  int port() const { return port_; }
+  std::size_t shard_count() const { return shards_.size(); }
+  // The shard that owns sessions of `device_id`.
+  std::size_t shard_for(std::string_view device_id) const;
+  GatewayShard& shard(std::size_t index) { return *shards_[index]; }
+
+  // Any thread; summed over the shards.
+  Stats stats() const;
+
+ private:
+  Config config_;
+  int port_ = 0;
+  bool running_ = false;
+  std::vector<std::unique_ptr<GatewayShard>> shards_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_GATEWAY_GATEWAY_H_
@@ -0,0 +1,963 @@
+#include "gateway/gateway_shard.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/random.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "audio/jitter_buffer.h"
+#include "base/base64.h"
+#include "base/clock.h"
+#include "base/sha1.h"
+#include "net/websocket_frame.h"
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+#include "net/aes_ctr.h"
+#endif
+
+namespace xiaozi {
+namespace {
+
+constexpr char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+constexpr int kMaxEvents = 256;
+// Longest upgrade request accepted.
+constexpr std::size_t kMaxRequestBytes = 4096;
+// MqttUdpTransport's datagram header, and room for its largest packet.
+constexpr std::size_t kUdpHeaderBytes = 16;
+constexpr std::size_t kUdpBlockBytes = 1536;
+constexpr uint8_t kUdpAudioType = 0x01;
+constexpr std::size_t kUdpBatch = 32;
+constexpr uint64_t kBackendRetryNs = 1000000000;
+constexpr uint64_t kSweepNs = 1000000000;
+// How far past the newest sequence seen a packet from a new port may be:
+// about a minute of 60 ms frames.
+constexpr uint32_t kMaxSequenceJump = 1024;
+
+uint64_t tag_of(uint32_t kind, uint32_t slot = 0) {
+  return uint64_t{kind} << 32 | slot;
+}
+
+uint32_t slot_of(uint32_t id) { return (id >> 8) & 0xffff; }
+
+// `now` plus `timeout_ms`, or 0 (never) for a zero timeout.
+uint64_t deadline_after(uint64_t now, uint32_t timeout_ms) {
+  return timeout_ms == 0 ? 0 : now + uint64_t{timeout_ms} * 1000000;
+}
+
+uint32_t get_be32(const uint8_t* p) {
+  return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 |
+         p[3];
+}
+
+void put_be32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+// Value of header `name` (lower case) in an HTTP request head, or empty.
+std::string_view header_value(std::string_view head, std::string_view name) {
+  auto eol = head.find("\r\n");
+  while (eol != std::string_view::npos) {
+    head.remove_prefix(eol + 2);
+    eol = head.find("\r\n");
+    const std::string_view line = head.substr(0, eol);
+    const auto colon = line.find(':');
+    if (colon != std::string_view::npos &&
+        iequals(line.substr(0, colon), name)) {
+      return trim(line.substr(colon + 1));
+    }
+  }
+  return {};
+}
+
+bool udp_enabled(const Gateway::Config& config) {
+#if defined(XIAOZI_HAVE_OPENSSL)
+  return !config.public_host.empty();
+#else
+  (void)config;
+  return false;
+#endif
+}
+
+// Same IP address, any port.
+bool same_host(const sockaddr_storage& a, const sockaddr_storage& b) {
+  if (a.ss_family != b.ss_family) return false;
+  if (a.ss_family == AF_INET) {
+    return reinterpret_cast<const sockaddr_in&>(a).sin_addr.s_addr ==
+           reinterpret_cast<const sockaddr_in&>(b).sin_addr.s_addr;
+  }
+  if (a.ss_family == AF_INET6) {
+    return std::memcmp(&reinterpret_cast<const sockaddr_in6&>(a).sin6_addr,
+                       &reinterpret_cast<const sockaddr_in6&>(b).sin6_addr,
+                       sizeof(in6_addr)) == 0;
+  }
+  return false;
+}
+
+uint16_t port_of(const sockaddr_storage& a) {
+  return a.ss_family == AF_INET6
+             ? reinterpret_cast<const sockaddr_in6&>(a).sin6_port
+             : reinterpret_cast<const sockaddr_in&>(a).sin_port;
+}
+
+bool same_endpoint(const sockaddr_storage& a, const sockaddr_storage& b) {
+  return same_host(a, b) && port_of(a) == port_of(b);
+}
+
+void append_hex(std::string& out, std::span<const uint8_t> bytes) {
+  static constexpr char kDigits[] = "0123456789abcdef";
+  for (uint8_t b : bytes) {
+    out += kDigits[b >> 4];
+    out += kDigits[b & 0xf];
+  }
+}
+
+// Duration of an Opus packet from its TOC byte (RFC 6716, 3.1), or 0 if it
+// cannot be one.
+uint32_t opus_packet_us(std::span<const uint8_t> packet) {
+  if (packet.empty()) return 0;
+  static constexpr uint32_t kSilkUs[] = {10000, 20000, 40000, 60000};
+  static constexpr uint32_t kCeltUs[] = {2500, 5000, 10000, 20000};
+  const unsigned config = packet[0] >> 3;
+  const uint32_t frame_us = config < 12   ? kSilkUs[config & 3]
+                            : config < 16 ? 10000 << (config & 1)
+                                          : kCeltUs[config & 3];
+  uint32_t frames = 1;
+  switch (packet[0] & 3) {
+    case 1:
+    case 2:
+      frames = 2;
+      break;
+    case 3:
+      if (packet.size() < 2) return 0;
+      frames = packet[1] & 0x3f;
+      break;
+  }
+  const uint32_t us = frames * frame_us;
+  return us <= 120000 ? us : 0;
+}
+
+}  // namespace
+
+struct GatewayShard::UdpChannel {
+  std::array<uint8_t, 16> key;
+  std::array<uint8_t, 16> nonce{};
+#if defined(XIAOZI_HAVE_OPENSSL)
+  AesCtr rx_cipher{key};
+  AesCtr tx_cipher{key};
+#endif
+  JitterBuffer jitter;
+  // The WebSocket connection's address, which the device proved itself
+  // on; datagrams from other hosts are refused.
+  sockaddr_storage host{};
+  // Where replies go: the first datagram's source, then a new port only
+  // with a sequence past rx_newest. The header is not authenticated, so a
+  // replayed or forged old packet must not pull the channel away.
+  sockaddr_storage peer{};
+  socklen_t peer_len = 0;
+  uint32_t rx_newest = 0;
+  uint32_t tx_sequence = 0;
+  // When the packet after the last one popped is due; 0 while buffering.
+  uint64_t next_pop_ns = 0;
+
+  UdpChannel(const std::array<uint8_t, 16>& k, JitterBuffer::Config jitter)
+      : key(k), jitter(jitter) {}
+};
+
+struct GatewayShard::Session {
+  int fd = -1;
+  uint32_t id = 0;
+  bool open = false;     // upgrade answered
+  bool writing = false;  // EPOLLOUT armed
+  uint64_t deadline_ns = 0;  // upgrade, then idle; 0 never
+  std::string device_id;
+  // Frames before rx_start are handled; the buffer is compacted after the
+  // batch's backend flush, since queued payloads still point into it.
+  std::vector<uint8_t> rx;
+  std::size_t rx_len = 0;
+  std::size_t rx_start = 0;
+  std::vector<uint8_t> tx;  // device-bound bytes the socket did not take
+  std::unique_ptr<UdpChannel> udp;
+};
+
+GatewayShard::GatewayShard(Gateway& gateway, std::size_t index,
+                           const Gateway::Config& config)
+    : gateway_(gateway),
+      index_(index),
+      config_(config),
+      backend_(config.backend),
+      arena_(4096, MemoryDomain::kNetwork),
+      udp_pool_(kUdpBlockBytes,
+                udp_enabled(config) ? config.udp_pool_blocks : 1,
+                MemoryDomain::kNetwork),
+      sessions_(config.max_sessions_per_shard),
+      generations_(config.max_sessions_per_shard, 0) {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  for (std::size_t i = 0; i < config.shards; ++i) {
+    inboxes_.push_back(
+        std::make_unique<SpscRing<Handoff, kInboxSlots>>());
+  }
+  free_slots_.reserve(sessions_.size());
+  for (std::size_t slot = sessions_.size(); slot-- > 0;) {
+    free_slots_.push_back(static_cast<uint32_t>(slot));
+  }
+  watch(waker_.fd(), tag_of(kWaker), EPOLLIN, false);
+  watch(timer_fd_, tag_of(kTimer), EPOLLIN, false);
+}
+
+GatewayShard::~GatewayShard() {
+  stop();
+  for (auto& s : sessions_) {
+    if (s != nullptr && s->fd >= 0) ::close(s->fd);
+  }
+  for (auto& inbox : inboxes_) {
+    Handoff h;
+    while (inbox->try_pop(h)) {
+      if (h.fd >= 0) ::close(h.fd);
+    }
+  }
+  for (int fd : {listen_fd_, udp_fd_, timer_fd_, epoll_fd_}) {
+    if (fd >= 0) ::close(fd);
+  }
+}
+
+int GatewayShard::bind(int port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  if (inet_pton(AF_INET, config_.bind_address.c_str(), &addr.sin_addr) != 1) {
+    return -1;
+  }
+  const int one = 1;
+  listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0 ||
+      setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+      setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+      ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    return -1;
+  }
+  socklen_t len = sizeof(addr);
+  getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+  watch(listen_fd_, tag_of(kListener), EPOLLIN, false);
+
+  if (udp_enabled(config_)) {
+    udp_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (udp_fd_ < 0 ||
+        setsockopt(udp_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+        ::bind(udp_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+      return -1;
+    }
+    watch(udp_fd_, tag_of(kUdp), EPOLLIN, false);
+  }
+  return ntohs(addr.sin_port);
+}
+
+bool GatewayShard::connect_backend() {
+  if (!backend_.connect(config_.backend_host, config_.backend_port, 100)) {
+    return false;
+  }
+  backend_writing_ = false;
+  watch(backend_.fd(), tag_of(kBackend), EPOLLIN, false);
+  // The backend only knows sessions it was told about on this link.
+  for (const auto& s : sessions_) {
+    if (s != nullptr && s->fd >= 0 && s->open) {
+      backend_.queue(BackendLink::kOpen, s->id,
+                     {reinterpret_cast<const uint8_t*>(s->device_id.data()),
+                      s->device_id.size()});
+    }
+  }
+  return true;
+}
+
+void GatewayShard::start(int cpu) {
+  const uint64_t period_ns = uint64_t{config_.frame_ms} * 1000000;
+  itimerspec spec{};
+  spec.it_interval.tv_sec = static_cast<time_t>(period_ns / 1000000000);
+  spec.it_interval.tv_nsec = static_cast<long>(period_ns % 1000000000);
+  spec.it_value = spec.it_interval;
+  timerfd_settime(timer_fd_, 0, &spec, nullptr);
+  last_retry_ns_ = monotonic_ns();
+  last_sweep_ns_ = last_retry_ns_;
+  thread_ = std::thread([this] { run(); });
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(thread_.native_handle(), sizeof(set), &set);
+  }
+}
+
+void GatewayShard::stop() {
+  if (!thread_.joinable()) return;
+  stopping_.store(true, std::memory_order_release);
+  waker_.notify();
+  thread_.join();
+}
+
+bool GatewayShard::hand_off(std::size_t from, Handoff handoff) {
+  if (!inboxes_[from]->try_push(std::move(handoff))) return false;
+  waker_.notify();
+  return true;
+}
+
+void GatewayShard::watch(int fd, uint64_t tag, uint32_t events,
+                         bool modify) {
+  epoll_event ev{};
+  ev.events = events;
+  ev.data.u64 = tag;
+  epoll_ctl(epoll_fd_, modify ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+}
+
+void GatewayShard::run() {
+  epoll_event events[kMaxEvents];
+  while (!stopping_.load(std::memory_order_acquire)) {
+    const int n = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (n < 0 && errno != EINTR) break;
+    now_ns_ = monotonic_ns();
+    for (int i = 0; i < n; ++i) {
+      const uint64_t tag = events[i].data.u64;
+      switch (static_cast<Tag>(tag >> 32)) {
+        case kListener:
+          on_accept();
+          break;
+        case kUdp:
+          on_datagrams();
+          break;
+        case kWaker:
+          waker_.drain();
+          on_inbox();
+          break;
+        case kTimer:
+          on_timer();
+          break;
+        case kBackend:
+          if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            on_backend();
+          }
+          break;
+        case kSession: {
+          Session* s = sessions_[static_cast<uint32_t>(tag)].get();
+          if (s != nullptr && s->fd >= 0) on_session(*s, events[i].events);
+          break;
+        }
+      }
+    }
+    finish_batch();
+  }
+}
+
+void GatewayShard::finish_batch() {
+  // Also drops what was queued while the link is down: the payloads are
+  // about to be overwritten.
+  if (!backend_.flush()) backend_writing_ = false;
+  if (backend_.connected() && backend_.wants_write() != backend_writing_) {
+    backend_writing_ = !backend_writing_;
+    watch(backend_.fd(), tag_of(kBackend),
+          EPOLLIN | (backend_writing_ ? EPOLLOUT : 0u), true);
+  }
+  held_.clear();
+  for (uint32_t slot : dirty_) {
+    Session* s = sessions_[slot].get();
+    if (s == nullptr || s->rx_start == 0) continue;
+    std::memmove(s->rx.data(), s->rx.data() + s->rx_start,
+                 s->rx_len - s->rx_start);
+    s->rx_len -= s->rx_start;
+    s->rx_start = 0;
+  }
+  dirty_.clear();
+  for (uint32_t slot : closed_) {
+    sessions_[slot].reset();
+    ++generations_[slot];
+    free_slots_.push_back(slot);
+  }
+  closed_.clear();
+}
+
+GatewayShard::Session* GatewayShard::open_session(int fd,
+                                                  std::vector<uint8_t> rx) {
+  if (free_slots_.empty()) return nullptr;
+  const uint32_t slot = free_slots_.back();
+  free_slots_.pop_back();
+  auto s = std::make_unique<Session>();
+  s->fd = fd;
+  s->deadline_ns = deadline_after(now_ns_, config_.upgrade_timeout_ms);
+  s->id = uint32_t{generations_[slot]} << 24 | slot << 8 |
+          static_cast<uint32_t>(index_);
+  s->rx_len = rx.size();
+  s->rx = std::move(rx);
+  s->rx.resize(ws::kMaxHeaderBytes +
+               std::max(config_.max_message_bytes, kMaxRequestBytes));
+  watch(fd, tag_of(kSession, slot), EPOLLIN | EPOLLRDHUP, false);
+  sessions_[slot] = std::move(s);
+  sessions_open_.fetch_add(1, std::memory_order_relaxed);
+  return sessions_[slot].get();
+}
+
+GatewayShard::Session* GatewayShard::find(uint32_t id) {
+  if ((id & 0xff) != index_ || slot_of(id) >= sessions_.size()) {
+    return nullptr;
+  }
+  Session* s = sessions_[slot_of(id)].get();
+  return s != nullptr && s->id == id && s->fd >= 0 ? s : nullptr;
+}
+
+void GatewayShard::close_session(Session& s, bool rejected) {
+  if (s.fd < 0) return;
+  if (s.open) backend_.queue(BackendLink::kClose, s.id, {});
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, s.fd, nullptr);
+  ::close(s.fd);
+  s.fd = -1;
+  const uint32_t slot = slot_of(s.id);
+  if (s.udp != nullptr) {
+    udp_slots_.erase(std::find(udp_slots_.begin(), udp_slots_.end(), slot));
+  }
+  closed_.push_back(slot);
+  sessions_open_.fetch_sub(1, std::memory_order_relaxed);
+  if (rejected) rejected_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void GatewayShard::on_accept() {
+  for (;;) {
+    const int fd =
+        accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    accepted_.fetch_add(1, std::memory_order_relaxed);
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (open_session(fd, {}) == nullptr) {
+      ::close(fd);
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void GatewayShard::on_inbox() {
+  for (auto& inbox : inboxes_) {
+    Handoff h;
+    while (inbox->try_pop(h)) {
+      if (h.datagram) {
+        on_datagram(std::move(h.datagram), h.peer, h.peer_len);
+        continue;
+      }
+      Session* s = open_session(h.fd, std::move(h.request));
+      if (s == nullptr) {
+        ::close(h.fd);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+      } else if (!upgrade(*s)) {
+        close_session(*s, true);
+      }
+    }
+  }
+}
+
+void GatewayShard::on_timer() {
+  uint64_t expirations;
+  if (read(timer_fd_, &expirations, sizeof(expirations)) < 0) return;
+  if (!backend_.connected() && now_ns_ - last_retry_ns_ >= kBackendRetryNs) {
+    last_retry_ns_ = now_ns_;
+    connect_backend();
+  }
+  if (now_ns_ - last_sweep_ns_ >= kSweepNs) {
+    last_sweep_ns_ = now_ns_;
+    expire_sessions();
+  }
+  // Half a tick of slack for the timer's wakeup latency.
+  const uint64_t slack_ns = uint64_t{config_.frame_ms} * 500000;
+  for (uint32_t slot : udp_slots_) {
+    Session& s = *sessions_[slot];
+    UdpChannel& udp = *s.udp;
+    // Every pop that fell due since the last tick, so packets shorter than
+    // the tick are not held back.
+    while (udp.next_pop_ns <= now_ns_ + slack_ns) {
+      FrameRef packet;
+      const JitterBuffer::Status status = udp.jitter.pop(packet);
+      if (status == JitterBuffer::Status::kNotReady) {
+        udp.next_pop_ns = 0;
+        break;
+      }
+      if (status == JitterBuffer::Status::kPacket) {
+        const auto payload = packet.bytes().subspan(kUdpHeaderBytes);
+        if (const uint32_t us = opus_packet_us(payload)) {
+          udp.jitter.set_frame_ms(std::max<uint32_t>(1, (us + 500) / 1000));
+        }
+        backend_.queue(BackendLink::kAudio, s.id, payload);
+        held_.push_back(std::move(packet));
+        frames_.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        backend_.queue(BackendLink::kAudio, s.id, {});
+      }
+      udp.next_pop_ns = (udp.next_pop_ns == 0 ? now_ns_ : udp.next_pop_ns) +
+                        uint64_t{udp.jitter.frame_ms()} * 1000000;
+    }
+  }
+}
+
+void GatewayShard::expire_sessions() {
+  for (const auto& p : sessions_) {
+    Session* s = p.get();
+    if (s == nullptr || s->fd < 0 || s->deadline_ns == 0 ||
+        now_ns_ < s->deadline_ns) {
+      continue;
+    }
+    timed_out_.fetch_add(1, std::memory_order_relaxed);
+    if (s->open) {
+      static constexpr uint8_t kGoingAway[] = {0x03, 0xe9};  // 1001
+      send_frame(*s, ws::kClose, kGoingAway);
+    }
+    // A slot held by a request that never completed counts as rejected.
+    close_session(*s, !s->open);
+  }
+}
+
+void GatewayShard::on_backend() {
+  records_.clear();
+  if (!backend_.receive(records_)) {
+    backend_writing_ = false;
+    return;
+  }
+  for (const BackendLink::Record& r : records_) {
+    Session* s = find(r.session);
+    if (s == nullptr || !s->open) continue;
+    switch (r.type) {
+      case BackendLink::kText:
+        send_frame(*s, ws::kText, r.payload);
+        break;
+      case BackendLink::kAudio:
+        if (s->udp != nullptr && s->udp->peer_len != 0) {
+          send_datagram(*s, r.payload);
+        } else {
+          send_frame(*s, ws::kBinary, r.payload);
+        }
+        break;
+      case BackendLink::kClose: {
+        static constexpr uint8_t kNormal[] = {0x03, 0xe8};  // 1000
+        send_frame(*s, ws::kClose, kNormal);
+        close_session(*s, false);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
+
+void GatewayShard::on_session(Session& s, uint32_t events) {
+  if (events & EPOLLOUT) write_pending(s);
+  if (s.fd < 0 || !(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+    return;
+  }
+  // Full of handled frames: level-triggered, so the socket is read again
+  // once finish_batch() has compacted the buffer.
+  if (s.rx_len == s.rx.size()) return;
+  ssize_t n;
+  do {
+    n = recv(s.fd, s.rx.data() + s.rx_len, s.rx.size() - s.rx_len, 0);
+  } while (n < 0 && errno == EINTR);
+  if (n == 0 || (n < 0 && errno != EAGAIN)) {
+    close_session(s, false);
+    return;
+  }
+  if (n < 0) return;
+  s.rx_len += static_cast<std::size_t>(n);
+  if (!s.open) {
+    if (!read_request(s)) close_session(s, true);
+    return;
+  }
+  s.deadline_ns = deadline_after(now_ns_, config_.idle_timeout_ms);
+  if (!process_frames(s)) close_session(s, true);
+}
+
+bool GatewayShard::read_request(Session& s) {
+  const std::string_view seen(reinterpret_cast<const char*>(s.rx.data()),
+                              s.rx_len);
+  const auto end = seen.find("\r\n\r\n");
+  if (end == std::string_view::npos) return s.rx_len < kMaxRequestBytes;
+  const std::string_view device = header_value(seen.substr(0, end),
+                                               "device-id");
+  if (device.empty()) return false;
+  const std::size_t owner = gateway_.shard_for(device);
+  if (owner == index_) return upgrade(s);
+
+  // The owner takes the socket and the bytes read so far; this slot is
+  // released without telling the backend, which never heard of it.
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, s.fd, nullptr);
+  s.rx.resize(s.rx_len);
+  Handoff h{s.fd, std::move(s.rx), {}, {}, 0};
+  if (!gateway_.shard(owner).hand_off(index_, std::move(h))) {
+    ::close(s.fd);
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    handed_off_.fetch_add(1, std::memory_order_relaxed);
+  }
+  s.fd = -1;
+  closed_.push_back(slot_of(s.id));
+  sessions_open_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool GatewayShard::upgrade(Session& s) {
+  const std::string_view seen(reinterpret_cast<const char*>(s.rx.data()),
+                              s.rx_len);
+  const auto end = seen.find("\r\n\r\n");
+  if (end == std::string_view::npos) return false;
+  const std::string_view head = seen.substr(0, end);
+  const std::string_view key = header_value(head, "sec-websocket-key");
+  const std::string_view device = header_value(head, "device-id");
+  if (!head.starts_with("GET ") || key.empty() || device.empty() ||
+      !iequals(header_value(head, "upgrade"), "websocket")) {
+    return false;
+  }
+  const std::string accept_input = std::string(key) + kAcceptGuid;
+  const std::string response =
+      "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+      "Connection: Upgrade\r\nSec-WebSocket-Accept: " +
+      base64_encode(Sha1::of(
+          {reinterpret_cast<const uint8_t*>(accept_input.data()),
+           accept_input.size()})) +
+      "\r\n\r\n";
+  const iovec iov{const_cast<char*>(response.data()), response.size()};
+  send_raw(s, {&iov, 1});
+  s.open = true;
+  s.deadline_ns = deadline_after(now_ns_, config_.idle_timeout_ms);
+  s.device_id = device;
+  backend_.queue(BackendLink::kOpen, s.id,
+                 {reinterpret_cast<const uint8_t*>(s.device_id.data()),
+                  s.device_id.size()});
+  // A device may pipeline its hello behind the request.
+  s.rx_start = end + 4;
+  dirty_.push_back(slot_of(s.id));
+  return process_frames(s);
+}
+
+bool GatewayShard::process_frames(Session& s) {
+  for (;;) {
+    const std::span<uint8_t> data(s.rx.data() + s.rx_start,
+                                  s.rx_len - s.rx_start);
+    const auto h = ws::parse_header(data);
+    if (!h) break;
+    // Devices send single-frame messages, masked as clients must.
+    if (!h->masked || !h->fin || h->opcode == ws::kContinuation ||
+        h->payload_len > config_.max_message_bytes) {
+      return false;
+    }
+    const std::size_t frame_len =
+        h->header_len + static_cast<std::size_t>(h->payload_len);
+    if (data.size() < frame_len) break;
+    const std::span<uint8_t> payload =
+        data.subspan(h->header_len, static_cast<std::size_t>(h->payload_len));
+    ws::apply_mask(payload, h->mask_key);
+    s.rx_start += frame_len;
+    switch (h->opcode) {
+      case ws::kBinary:
+        backend_.queue(BackendLink::kAudio, s.id, payload);
+        frames_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      case ws::kText:
+        on_text(s, payload);
+        break;
+      case ws::kPing:
+        send_frame(s, ws::kPong, payload);
+        break;
+      case ws::kClose:
+        send_frame(s, ws::kClose, payload.first(std::min<std::size_t>(
+                                      2, payload.size())));
+        close_session(s, false);
+        return true;
+      default:
+        break;
+    }
+  }
+  dirty_.push_back(slot_of(s.id));
+  return true;
+}
+
+void GatewayShard::on_text(Session& s, std::span<const uint8_t> text) {
+  arena_.reset();
+  const JsonValue* msg = json_.parse(
+      {reinterpret_cast<const char*>(text.data()), text.size()}, arena_);
+  if (msg != nullptr && msg->string_at("type") == "hello") {
+    send_hello(s, msg->string_at("transport") == "udp");
+  }
+  backend_.queue(BackendLink::kText, s.id, text);
+}
+
+void GatewayShard::send_hello(Session& s, bool want_udp) {
+#if defined(XIAOZI_HAVE_OPENSSL)
+  if (want_udp && udp_fd_ >= 0 && s.udp == nullptr) {
+    std::array<uint8_t, 16> key;
+    if (getrandom(key.data(), key.size(), 0) ==
+        static_cast<ssize_t>(key.size())) {
+      JitterBuffer::Config jitter;
+      jitter.frame_ms = std::max<uint32_t>(config_.frame_ms, 1);
+      s.udp = std::make_unique<UdpChannel>(key, jitter);
+      socklen_t len = sizeof(s.udp->host);
+      getpeername(s.fd, reinterpret_cast<sockaddr*>(&s.udp->host), &len);
+      s.udp->nonce[0] = kUdpAudioType;
+      put_be32(&s.udp->nonce[4], s.id);
+      udp_slots_.push_back(slot_of(s.id));
+    }
+  }
+#else
+  (void)want_udp;
+#endif
+  char id[9];
+  std::snprintf(id, sizeof(id), "%08x", s.id);
+  std::string reply = R"({"type":"hello","transport":")";
+  reply += s.udp != nullptr ? "udp" : "websocket";
+  reply += R"(","session_id":")";
+  reply += id;
+  reply += '"';
+  if (s.udp != nullptr) {
+    reply += R"(,"udp":{"server":")" + config_.public_host +
+             R"(","port":)" + std::to_string(gateway_.port()) +
+             R"(,"key":")";
+    append_hex(reply, s.udp->key);
+    reply += R"(","nonce":")";
+    append_hex(reply, s.udp->nonce);
+    reply += R"("})";
+  }
+  reply += '}';
+  send_frame(s, ws::kText,
+             {reinterpret_cast<const uint8_t*>(reply.data()), reply.size()});
+}
+
+void GatewayShard::send_frame(Session& s, ws::Opcode opcode,
+                              std::span<const uint8_t> body) {
+  uint8_t header[ws::kMaxHeaderBytes];
+  const std::size_t n =
+      ws::encode_header(header, opcode, body.size(), false, 0);
+  const iovec iov[2] = {{header, n},
+                        {const_cast<uint8_t*>(body.data()), body.size()}};
+  send_raw(s, iov);
+}
+
+void GatewayShard::send_raw(Session& s, std::span<const iovec> iov) {
+  if (s.fd < 0) return;
+  std::size_t total = 0;
+  for (const iovec& v : iov) total += v.iov_len;
+  std::size_t written = 0;
+  if (s.tx.empty()) {
+    msghdr msg{};
+    msg.msg_iov = const_cast<iovec*>(iov.data());
+    msg.msg_iovlen = iov.size();
+    ssize_t n;
+    do {
+      n = sendmsg(s.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0 && errno != EAGAIN) {
+      close_session(s, false);
+      return;
+    }
+    written = n < 0 ? 0 : static_cast<std::size_t>(n);
+    if (written == total) return;
+  }
+  // A message the device has started receiving must be finished; a new
+  // one is dropped when the backlog is full.
+  if (written == 0 && s.tx.size() + total > config_.max_send_backlog_bytes) {
+    device_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  for (const iovec& v : iov) {
+    const auto* base = static_cast<const uint8_t*>(v.iov_base);
+    const std::size_t skip = std::min(written, v.iov_len);
+    written -= skip;
+    s.tx.insert(s.tx.end(), base + skip, base + v.iov_len);
+  }
+  if (!s.writing) {
+    s.writing = true;
+    watch(s.fd, tag_of(kSession, slot_of(s.id)),
+          EPOLLIN | EPOLLRDHUP | EPOLLOUT, true);
+  }
+}
+
+void GatewayShard::write_pending(Session& s) {
+  ssize_t n;
+  do {
+    n = send(s.fd, s.tx.data(), s.tx.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    if (errno != EAGAIN) close_session(s, false);
+    return;
+  }
+  s.tx.erase(s.tx.begin(), s.tx.begin() + n);
+  if (s.tx.empty()) {
+    s.writing = false;
+    watch(s.fd, tag_of(kSession, slot_of(s.id)), EPOLLIN | EPOLLRDHUP, true);
+  }
+}
+
+void GatewayShard::on_datagrams() {
+  std::array<FrameRef, kUdpBatch> frames;
+  std::array<mmsghdr, kUdpBatch> msgs{};
+  std::array<iovec, kUdpBatch> iov;
+  std::array<sockaddr_storage, kUdpBatch> peers;
+  for (;;) {
+    std::size_t count = 0;
+    for (; count < kUdpBatch; ++count) {
+      if (!frames[count]) frames[count] = udp_pool_.acquire();
+      if (!frames[count]) break;
+      iov[count] = {frames[count].data(), frames[count].capacity()};
+      msgs[count].msg_hdr = {};
+      msgs[count].msg_hdr.msg_iov = &iov[count];
+      msgs[count].msg_hdr.msg_iovlen = 1;
+      msgs[count].msg_hdr.msg_name = &peers[count];
+      msgs[count].msg_hdr.msg_namelen = sizeof(peers[count]);
+    }
+    if (count == 0) {
+      // Every block is held by a jitter buffer: shed the datagram.
+      uint8_t discard;
+      if (recv(udp_fd_, &discard, 1, MSG_DONTWAIT) >= 0) {
+        udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+      }
+      return;
+    }
+    const int n = recvmmsg(udp_fd_, msgs.data(), static_cast<unsigned>(count),
+                           MSG_DONTWAIT, nullptr);
+    if (n <= 0) return;
+    for (int i = 0; i < n; ++i) {
+      frames[i].set_size(msgs[i].msg_len);
+      on_datagram(std::move(frames[i]), peers[i], msgs[i].msg_hdr.msg_namelen);
+    }
+    if (static_cast<std::size_t>(n) < count) return;
+  }
+}
+
+void GatewayShard::on_datagram(FrameRef packet, const sockaddr_storage& peer,
+                               socklen_t peer_len) {
+#if defined(XIAOZI_HAVE_OPENSSL)
+  uint8_t* p = packet.data();
+  if (packet.size() < kUdpHeaderBytes || p[0] != kUdpAudioType ||
+      (p[2] << 8 | p[3]) != static_cast<int>(packet.size() - kUdpHeaderBytes)) {
+    udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const uint32_t id = get_be32(p + 4);
+  const std::size_t owner = id & 0xff;
+  if (owner != index_) {
+    udp_misrouted_.fetch_add(1, std::memory_order_relaxed);
+    if (owner >= gateway_.shard_count() ||
+        !gateway_.shard(owner).hand_off(
+            index_, {-1, {}, std::move(packet), peer, peer_len})) {
+      udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return;
+  }
+  Session* s = find(id);
+  if (s == nullptr || s->udp == nullptr) {
+    udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  UdpChannel& udp = *s->udp;
+  if (config_.udp_same_host && !same_host(peer, udp.host)) {
+    udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  const uint32_t sequence = get_be32(p + 12);
+  const uint32_t ahead = sequence - udp.rx_newest;
+  if (udp.peer_len == 0) {
+    udp.peer = peer;
+    udp.peer_len = peer_len;
+    udp.rx_newest = sequence;
+  } else if (!same_endpoint(peer, udp.peer)) {
+    // Follows the device across NAT rebinding, which only ever moves it
+    // forward in sequence.
+    if (ahead == 0 || ahead > kMaxSequenceJump) {
+      udp_rejected_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    udp.peer = peer;
+    udp.peer_len = peer_len;
+  }
+  if (ahead != 0 && ahead <= kMaxSequenceJump) udp.rx_newest = sequence;
+  udp.rx_cipher.apply(std::span<const uint8_t, 16>(p, kUdpHeaderBytes),
+                      packet.bytes().subspan(kUdpHeaderBytes));
+  packet.set_sequence(sequence);
+  packet.set_timestamp_ns(monotonic_ns());
+  s->deadline_ns = deadline_after(now_ns_, config_.idle_timeout_ms);
+  udp.jitter.push(std::move(packet));
+  udp_packets_.fetch_add(1, std::memory_order_relaxed);
+#else
+  (void)packet;
+  (void)peer;
+  (void)peer_len;
+#endif
+}
+
+void GatewayShard::send_datagram(Session& s, std::span<const uint8_t> payload) {
+#if defined(XIAOZI_HAVE_OPENSSL)
+  UdpChannel& udp = *s.udp;
+  uint8_t datagram[kUdpBlockBytes];
+  if (payload.size() > sizeof(datagram) - kUdpHeaderBytes) {
+    device_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  std::memcpy(datagram, udp.nonce.data(), kUdpHeaderBytes);
+  datagram[2] = static_cast<uint8_t>(payload.size() >> 8);
+  datagram[3] = static_cast<uint8_t>(payload.size());
+  put_be32(datagram + 8, static_cast<uint32_t>(monotonic_ns() / 1000000));
+  put_be32(datagram + 12, udp.tx_sequence++);
+  std::memcpy(datagram + kUdpHeaderBytes, payload.data(), payload.size());
+  udp.tx_cipher.apply(std::span<const uint8_t, 16>(datagram, kUdpHeaderBytes),
+                      {datagram + kUdpHeaderBytes, payload.size()});
+  sendto(udp_fd_, datagram, kUdpHeaderBytes + payload.size(), MSG_DONTWAIT,
+         reinterpret_cast<const sockaddr*>(&udp.peer), udp.peer_len);
+#else
+  (void)s;
+  (void)payload;
+#endif
+}
+
+Gateway::Stats GatewayShard::stats() const {
+  Gateway::Stats out{};
+  out.sessions = sessions_open_.load(std::memory_order_relaxed);
+  out.accepted = accepted_.load(std::memory_order_relaxed);
+  out.handed_off = handed_off_.load(std::memory_order_relaxed);
+  out.rejected = rejected_.load(std::memory_order_relaxed);
+  out.timed_out = timed_out_.load(std::memory_order_relaxed);
+  out.frames = frames_.load(std::memory_order_relaxed);
+  out.udp_packets = udp_packets_.load(std::memory_order_relaxed);
+  out.udp_misrouted = udp_misrouted_.load(std::memory_order_relaxed);
+  out.udp_rejected = udp_rejected_.load(std::memory_order_relaxed);
+  out.device_dropped = device_dropped_.load(std::memory_order_relaxed);
+  out.backend = backend_.stats();
+  return out;
+}
+
+}  // namespace xiaozi
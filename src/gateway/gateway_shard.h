@@ -0,0 +1,162 @@
+#ifndef XIAOZI_GATEWAY_GATEWAY_SHARD_H_
+#define XIAOZI_GATEWAY_GATEWAY_SHARD_H_
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "gateway/backend_link.h"
+#include "gateway/gateway.h"
+#include "memory/arena.h"
+#include "memory/frame_pool.h"
+#include "memory/spsc_ring.h"
+#include "net/tcp_stream.h"
+#include "net/websocket_frame.h"
+#include "protocol/json.h"
+
+namespace xiaozi {
+
+// One core's share of a Gateway (see there). Everything below runs on the
+// shard's thread except hand_off(), which the other shards call, and
+// stats().
+//
+// Session IDs, which double as the UDP SSRC, are generation:8 slot:16
+// shard:8, so any shard, and the kernel's BPF steering, can tell a
+// session's owner from its ID.
+class GatewayShard {
+ public:
+  static constexpr std::size_t kInboxSlots = 64;
+
+  // A connection whose upgrade request has been read, or a datagram, for
+  // the owning shard. Plain aggregate for SpscRing.
+  struct Handoff {
+    int fd;
+    std::vector<uint8_t> request;  // bytes read so far, request first
+    FrameRef datagram;
+    sockaddr_storage peer;
+    socklen_t peer_len;
+  };
+
+  GatewayShard(Gateway& gateway, std::size_t index,
+               const Gateway::Config& config);
+  ~GatewayShard();
+
+  GatewayShard(const GatewayShard&) = delete;
+  GatewayShard& operator=(const GatewayShard&) = delete;
+
+  // Binds the listener and UDP socket on `port` (0 on the first shard picks
+  // one) and returns the port, or -1. Shards must bind in index order: the
+  // UDP steering program selects sockets by their position in the group.
+  int bind(int port);
+  // UDP socket, for attaching the steering program once all are bound.
+  int udp_fd() const { return udp_fd_; }
+  bool connect_backend();
+
+  void start(int cpu);
+  void stop();
+
+  // Called by shard `from` only. False when the inbox is full; the caller
+  // still owns the fd then.
+  bool hand_off(std::size_t from, Handoff handoff);
+
+  Gateway::Stats stats() const;
+
+ private:
+  struct Session;
+  struct UdpChannel;
+  enum Tag : uint32_t {
+    kListener,
+    kUdp,
+    kWaker,
+    kTimer,
+    kBackend,
+    kSession,
+  };
+
+  void run();
+  void on_accept();
+  void on_inbox();
+  void on_timer();
+  void expire_sessions();
+  void on_backend();
+  void on_session(Session& s, uint32_t events);
+  void on_datagrams();
+  void on_datagram(FrameRef packet, const sockaddr_storage& peer,
+                   socklen_t peer_len);
+
+  // `rx` holds what has been read from the socket so far.
+  Session* open_session(int fd, std::vector<uint8_t> rx);
+  Session* find(uint32_t id);
+  void close_session(Session& s, bool rejected);
+  void finish_batch();
+
+  bool read_request(Session& s);
+  bool upgrade(Session& s);
+  bool process_frames(Session& s);
+  void on_text(Session& s, std::span<const uint8_t> text);
+  void send_hello(Session& s, bool want_udp);
+  void send_frame(Session& s, ws::Opcode opcode,
+                  std::span<const uint8_t> body);
+  void send_raw(Session& s, std::span<const iovec> iov);
+  void write_pending(Session& s);
+  void send_datagram(Session& s, std::span<const uint8_t> payload);
+  void watch(int fd, uint64_t tag, uint32_t events, bool modify);
+
+  Gateway& gateway_;
+  const std::size_t index_;
+  const Gateway::Config& config_;
+  BackendLink backend_;
+  bool backend_writing_ = false;  // EPOLLOUT armed on the link
+  uint64_t last_retry_ns_ = 0;
+  uint64_t last_sweep_ns_ = 0;
+  uint64_t now_ns_ = 0;  // read once per epoll_wait()
+  JsonParser json_;
+  Arena arena_;
+  FramePool udp_pool_;
+
+  int epoll_fd_ = -1;
+  int listen_fd_ = -1;
+  int udp_fd_ = -1;
+  int timer_fd_ = -1;
+  Waker waker_;
+
+  // One ring per sending shard.
+  std::vector<std::unique_ptr<SpscRing<Handoff, kInboxSlots>>> inboxes_;
+
+  std::vector<std::unique_ptr<Session>> sessions_;  // by slot
+  std::vector<uint8_t> generations_;                // by slot
+  std::vector<uint32_t> free_slots_;
+  std::vector<uint32_t> udp_slots_;
+  // Touched this batch: compacted, or released, after the backend flush.
+  std::vector<uint32_t> dirty_;
+  std::vector<uint32_t> closed_;
+  // UDP packets whose payload is queued on the backend link.
+  std::vector<FrameRef> held_;
+  std::vector<BackendLink::Record> records_;
+
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+
+  std::atomic<uint64_t> sessions_open_{0};
+  std::atomic<uint64_t> accepted_{0};
+  std::atomic<uint64_t> handed_off_{0};
+  std::atomic<uint64_t> rejected_{0};
+  std::atomic<uint64_t> timed_out_{0};
+  std::atomic<uint64_t> frames_{0};
+  std::atomic<uint64_t> udp_packets_{0};
+  std::atomic<uint64_t> udp_misrouted_{0};
+  std::atomic<uint64_t> udp_rejected_{0};
+  std::atomic<uint64_t> device_dropped_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_GATEWAY_GATEWAY_SHARD_H_
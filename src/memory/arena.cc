@@ -0,0 +1,111 @@
+#include "memory/arena.h"
+
+#include <algorithm>
+
+namespace xiaozi {
+namespace {
+
+std::byte* data_of(void* block, std::size_t header) {
+  return static_cast<std::byte*>(block) + header;
+}
+
+}  // namespace
+
+Arena::Arena(std::size_t block_bytes, MemoryDomain domain)
+    : block_bytes_(block_bytes), domain_(domain) {
+  blocks_ = new_block(block_bytes_, true);
+  enter(blocks_);
+}
+
+Arena::Arena(std::span<std::byte> storage, std::size_t block_bytes,
+             MemoryDomain domain)
+    : block_bytes_(block_bytes), domain_(domain), storage_(storage) {
+  if (storage_.empty()) blocks_ = new_block(block_bytes_, true);
+  enter(storage_.empty() ? blocks_ : nullptr);
+}
+
+Arena::~Arena() {
+  for (Block* b = blocks_; b != nullptr;) {
+    Block* next = b->next;
+    memory::release(domain_, sizeof(Block) + b->size);
+    ::operator delete(b);
+    b = next;
+  }
+}
+
+Arena::Block* Arena::new_block(std::size_t min_bytes, bool first) {
+  const std::size_t size = std::max(block_bytes_, min_bytes);
+  if (first) {
+    memory::charge(domain_, sizeof(Block) + size, __builtin_return_address(0));
+  } else if (!memory::try_charge(domain_, sizeof(Block) + size,
+                                 __builtin_return_address(0))) {
+    return nullptr;
+  }
+  auto* block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+  block->next = nullptr;
+  block->size = size;
+  return block;
+}
+
+void Arena::enter(Block* block) {
+  current_ = block;
+  if (block == nullptr) {
+    begin_ = storage_.data();
+    end_ = begin_ + storage_.size();
+  } else {
+    begin_ = data_of(block, sizeof(Block));
+    end_ = begin_ + block->size;
+  }
+  cursor_ = begin_;
+}
+
+void* Arena::allocate_slow(std::size_t bytes, std::size_t align) {
+  const std::size_t needed = bytes + align - 1;
+  Block* last = current_;
+  Block* next = current_ != nullptr ? current_->next : blocks_;
+  // Blocks kept from earlier rounds first; one too small for this request
+  // is skipped for the rest of the round.
+  while (next != nullptr && next->size < needed) {
+    last = next;
+    next = next->next;
+  }
+  if (next == nullptr) {
+    next = new_block(needed, false);
+    if (next == nullptr) return nullptr;
+    if (last == nullptr) {
+      blocks_ = next;
+    } else {
+      last->next = next;
+    }
+  }
+  used_before_current_ += static_cast<std::size_t>(cursor_ - begin_);
+  enter(next);
+  return allocate(bytes, align);
+}
+
+std::size_t Arena::used_bytes() const {
+  return used_before_current_ + static_cast<std::size_t>(cursor_ - begin_);
+}
+
+void Arena::reset() {
+  high_water_ = std::max(high_water_, used_bytes());
+  used_before_current_ = 0;
+  enter(storage_.empty() ? blocks_ : nullptr);
+}
+
+Arena::Stats Arena::stats() const {
+  Stats s{};
+  for (const Block* b = blocks_; b != nullptr; b = b->next) {
+    ++s.blocks;
+    s.reserved_bytes += b->size;
+  }
+  if (!storage_.empty()) {
+    ++s.blocks;
+    s.reserved_bytes += storage_.size();
+  }
+  s.used_bytes = used_bytes();
+  s.high_water_bytes = std::max(high_water_, s.used_bytes);
+  return s;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,108 @@
+#ifndef XIAOZI_MEMORY_ARENA_H_
+#define XIAOZI_MEMORY_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "memory/memory_domain.h"
+
+namespace xiaozi {
+
+// Bump allocator for data that dies together, e.g. the DOM of one control
+// message. allocate() is a pointer bump; there is no per-object free, and
+// reset() releases everything at once. Blocks grown past the first one are
+// kept for the next round, so an arena that has seen its largest message
+// stops touching the heap.
+//
+// Heap blocks are charged to the arena's MemoryDomain. The first is
+// charged whatever the budget; when the budget refuses a later one,
+// allocate() returns nullptr, so a message too large for what the domain
+// has left fails to parse instead of growing the heap.
+//
+// Only for trivially destructible objects: nothing runs destructors.
+// Single-threaded.
+class Arena {
+ public:
+  struct Stats {
+    std::size_t blocks;
+    std::size_t reserved_bytes;
+    std::size_t used_bytes;  // since the last reset()
+    std::size_t high_water_bytes;
+  };
+
+  // Heap blocks of block_bytes each (larger on demand).
+  explicit Arena(std::size_t block_bytes = 4096,
+                 MemoryDomain domain = MemoryDomain::kUntagged);
+  // Starts in `storage` (e.g. a static buffer), which must outlive the
+  // arena and is not charged; grows on the heap when it runs out.
+  explicit Arena(std::span<std::byte> storage, std::size_t block_bytes = 4096,
+                 MemoryDomain domain = MemoryDomain::kUntagged);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // nullptr only when the domain's budget refused a new block; `align`
+  // must be a power of two.
+  void* allocate(std::size_t bytes, std::size_t align) {
+    auto p = (reinterpret_cast<uintptr_t>(cursor_) + align - 1) & ~(align - 1);
+    if (p + bytes > reinterpret_cast<uintptr_t>(end_)) {
+      return allocate_slow(bytes, align);
+    }
+    cursor_ = reinterpret_cast<std::byte*>(p + bytes);
+    return reinterpret_cast<void*>(p);
+  }
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    void* p = allocate(sizeof(T), alignof(T));
+    if (p == nullptr) return nullptr;
+    return ::new (p) T(std::forward<Args>(args)...);
+  }
+
+  // `count` default-initialized elements; empty if refused.
+  template <typename T>
+  std::span<T> make_array(std::size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    if (count == 0) return {};
+    auto* p = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    if (p == nullptr) return {};
+    for (std::size_t i = 0; i < count; ++i) ::new (p + i) T;
+    return {p, count};
+  }
+
+  void reset();
+  Stats stats() const;
+
+ private:
+  struct Block {
+    Block* next;
+    std::size_t size;  // usable bytes after the header
+  };
+
+  void* allocate_slow(std::size_t bytes, std::size_t align);
+  void enter(Block* block);
+  Block* new_block(std::size_t min_bytes, bool first);
+  std::size_t used_bytes() const;
+
+  std::size_t block_bytes_;
+  MemoryDomain domain_;
+  std::span<std::byte> storage_;
+  Block* blocks_ = nullptr;   // heap blocks, in allocation order
+  Block* current_ = nullptr;  // block being bumped, nullptr for storage_
+  std::byte* begin_ = nullptr;
+  std::byte* cursor_ = nullptr;
+  std::byte* end_ = nullptr;
+  std::size_t used_before_current_ = 0;
+  std::size_t high_water_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_MEMORY_ARENA_H_
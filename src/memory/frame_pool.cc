@@ -0,0 +1,143 @@
+#include "memory/frame_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+#include "base/cache.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr uint16_t kNil = 0xffff;
+
+static_assert(sizeof(detail::FrameHeader) <= FramePool::kPayloadOffset);
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+std::size_t block_stride(std::size_t block_size) {
+  std::size_t bytes = FramePool::kPayloadOffset + block_size;
+  return (bytes + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+}
+
+uint32_t pack(uint32_t tag, uint16_t index) { return (tag << 16) | index; }
+uint16_t index_of(uint32_t head) { return static_cast<uint16_t>(head); }
+uint32_t tag_of(uint32_t head) { return head >> 16; }
+
+}  // namespace
+
+std::size_t FramePool::storage_bytes(std::size_t block_size,
+                                     std::size_t block_count) {
+  return block_stride(block_size) * block_count;
+}
+
+FramePool::FramePool(std::size_t block_size, std::size_t block_count,
+                     MemoryDomain domain)
+    : block_size_(block_size),
+      block_count_(block_count),
+      stride_(block_stride(block_size)),
+      domain_(domain) {
+  const void* site = __builtin_return_address(0);
+  if (!memory::try_charge(domain_, owned_bytes(), site)) {
+    const std::size_t per_block = stride_ + sizeof(std::atomic<uint16_t>);
+    block_count_ = std::max<std::size_t>(
+        1, std::min(memory::headroom(domain_) / per_block, block_count));
+    memory::charge(domain_, owned_bytes(), site);
+  }
+  owned_.reset(new (std::align_val_t(kCacheLineSize))
+                   std::byte[storage_bytes(block_size, block_count_)]);
+  base_ = owned_.get();
+  init();
+}
+
+FramePool::FramePool(std::span<std::byte> storage, std::size_t block_size,
+                     std::size_t block_count)
+    : block_size_(block_size),
+      block_count_(block_count),
+      stride_(block_stride(block_size)),
+      base_(storage.data()) {
+  assert(storage.size() >= storage_bytes(block_size, block_count));
+  assert(reinterpret_cast<uintptr_t>(storage.data()) % kCacheLineSize == 0);
+  init();
+}
+
+FramePool::~FramePool() {
+  // A live FrameRef would release into freed memory.
+  assert(in_use_.load() == 0);
+  for (std::size_t i = 0; i < block_count_; ++i) header_at(i)->~FrameHeader();
+  if (owned_ != nullptr) memory::release(domain_, owned_bytes());
+}
+
+std::size_t FramePool::owned_bytes() const {
+  return storage_bytes(block_size_, block_count_) +
+         block_count_ * sizeof(std::atomic<uint16_t>);
+}
+
+void FramePool::init() {
+  assert(block_count_ > 0 && block_count_ <= kMaxBlocks);
+  next_.reset(new std::atomic<uint16_t>[block_count_]);
+  for (std::size_t i = 0; i < block_count_; ++i) {
+    auto* header = new (base_ + i * stride_) detail::FrameHeader();
+    header->index = static_cast<uint32_t>(i);
+    header->pool = this;
+    uint16_t next = i + 1 < block_count_ ? static_cast<uint16_t>(i + 1) : kNil;
+    next_[i].store(next, std::memory_order_relaxed);
+  }
+  free_head_.store(pack(0, 0), std::memory_order_release);
+}
+
+FrameRef FramePool::acquire() {
+  uint32_t head = free_head_.load(std::memory_order_acquire);
+  uint16_t index;
+  for (;;) {
+    index = index_of(head);
+    if (index == kNil) {
+      exhaustions_.fetch_add(1, std::memory_order_relaxed);
+      return FrameRef();
+    }
+    // May read a stale link if another thread pops `index` first; the tag
+    // check in the CAS then fails and we retry.
+    uint16_t next = next_[index].load(std::memory_order_relaxed);
+    if (free_head_.compare_exchange_weak(head, pack(tag_of(head) + 1, next),
+                                         std::memory_order_acquire,
+                                         std::memory_order_acquire)) {
+      break;
+    }
+  }
+
+  uint32_t in_use = in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint32_t high = high_water_.load(std::memory_order_relaxed);
+  while (in_use > high && !high_water_.compare_exchange_weak(
+                              high, in_use, std::memory_order_relaxed)) {
+  }
+
+  detail::FrameHeader* header = header_at(index);
+  header->refs.store(1, std::memory_order_relaxed);
+  header->size = 0;
+  header->sequence = 0;
+  header->timestamp_ns = 0;
+  return FrameRef(header);
+}
+
+void FramePool::release(detail::FrameHeader* header) {
+  const auto index = static_cast<uint16_t>(header->index);
+  uint32_t head = free_head_.load(std::memory_order_relaxed);
+  do {
+    next_[index].store(index_of(head), std::memory_order_relaxed);
+  } while (!free_head_.compare_exchange_weak(head,
+                                             pack(tag_of(head) + 1, index),
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+  in_use_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+FramePool::Stats FramePool::stats() const {
+  return Stats{
+      static_cast<uint32_t>(block_size_),
+      static_cast<uint32_t>(block_count_),
+      in_use_.load(std::memory_order_relaxed),
+      high_water_.load(std::memory_order_relaxed),
+      exhaustions_.load(std::memory_order_relaxed),
+  };
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,214 @@
+#ifndef XIAOZI_MEMORY_FRAME_POOL_H_
+#define XIAOZI_MEMORY_FRAME_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+#include "base/cache.h"
+#include "memory/memory_domain.h"
+
+namespace xiaozi {
+
+class FramePool;
+
+namespace detail {
+
+// Lives at the start of every block; the payload follows at kPayloadOffset.
+struct FrameHeader {
+  std::atomic<uint32_t> refs{0};
+  uint32_t index = 0;
+  FramePool* pool = nullptr;
+  uint32_t size = 0;
+  uint32_t sequence = 0;
+  uint64_t timestamp_ns = 0;
+};
+
+}  // namespace detail
+
+// Refcounted handle to one pool block. Copying a FrameRef shares the block
+// (one atomic increment); the block goes back to its pool when the last
+// handle is dropped, on whichever thread that happens. A default-constructed
+// or moved-from FrameRef is empty.
+//
+// By convention a frame is written only while its producer holds the sole
+// reference; once it has been handed on (pushed into a ring, passed to the
+// next stage) all holders treat the payload as read-only.
+class FrameRef {
+ public:
+  FrameRef() = default;
+  FrameRef(const FrameRef& other) noexcept : header_(other.header_) {
+    if (header_ != nullptr) {
+      header_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  FrameRef(FrameRef&& other) noexcept : header_(other.header_) {
+    other.header_ = nullptr;
+  }
+  FrameRef& operator=(const FrameRef& other) noexcept {
+    FrameRef(other).swap(*this);
+    return *this;
+  }
+  FrameRef& operator=(FrameRef&& other) noexcept {
+    FrameRef(std::move(other)).swap(*this);
+    return *this;
+  }
+  ~FrameRef() { reset(); }
+
+  void reset() noexcept;
+  void swap(FrameRef& other) noexcept { std::swap(header_, other.header_); }
+
+  explicit operator bool() const { return header_ != nullptr; }
+  bool unique() const {
+    return header_->refs.load(std::memory_order_acquire) == 1;
+  }
+
+  uint8_t* data() const;
+  std::size_t capacity() const;
+
+  // Bytes of valid payload, set by the producer.
+  std::size_t size() const { return header_->size; }
+  void set_size(std::size_t size) {
+    header_->size = static_cast<uint32_t>(size);
+  }
+  std::span<uint8_t> bytes() const { return {data(), size()}; }
+
+  // Typed views for PCM payloads, e.g. `frame.as<int16_t>()`.
+  template <typename T>
+  std::span<T> as() const {
+    return {reinterpret_cast<T*>(data()), size() / sizeof(T)};
+  }
+  template <typename T>
+  std::span<T> as_capacity() const {
+    return {reinterpret_cast<T*>(data()), capacity() / sizeof(T)};
+  }
+
+  // Hands the reference to foreign code as an opaque pointer, leaving this
+  // handle empty; from_raw() turns it back into a FrameRef. Used to pass
+  // packets across the Rust boundary without copying them.
+  void* into_raw() noexcept { return std::exchange(header_, nullptr); }
+  static FrameRef from_raw(void* raw) noexcept {
+    return FrameRef(static_cast<detail::FrameHeader*>(raw));
+  }
+
+  uint32_t sequence() const { return header_->sequence; }
+  void set_sequence(uint32_t sequence) { header_->sequence = sequence; }
+  uint64_t timestamp_ns() const { return header_->timestamp_ns; }
+  void set_timestamp_ns(uint64_t ts) { header_->timestamp_ns = ts; }
+
+ private:
+  friend class FramePool;
+  explicit FrameRef(detail::FrameHeader* header) : header_(header) {}
+
+  detail::FrameHeader* header_ = nullptr;
+};
+
+// Fixed-size block allocator for PCM frames and network packets. acquire()
+// and release are O(1) and lock-free (a tagged Treiber stack over block
+// indices), so frames can be acquired in the capture path and released on
+// any other thread without touching the heap. All memory is reserved up
+// front, either owned by the pool or placed in caller-provided storage (e.g.
+// a static buffer in internal RAM or a PSRAM region).
+//
+// Owned storage is charged to the pool's MemoryDomain. A pool that does
+// not fit the domain's budget is built with as many blocks as do (at least
+// one), so an over-budget subsystem runs with fewer frames in flight and
+// drops the rest rather than taking the heap down with it.
+class FramePool {
+ public:
+  // Payload alignment; blocks themselves are cache-line aligned.
+  static constexpr std::size_t kPayloadOffset = 32;
+  // Indices and ABA tag share one 32-bit word so the freelist stays
+  // lock-free on 32-bit cores.
+  static constexpr std::size_t kMaxBlocks = 0xfffe;
+
+  struct Stats {
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t in_use;
+    uint32_t high_water;
+    uint32_t exhaustions;
+  };
+
+  // Bytes of caller storage needed for the placement constructor.
+  static std::size_t storage_bytes(std::size_t block_size,
+                                   std::size_t block_count);
+
+  FramePool(std::size_t block_size, std::size_t block_count,
+            MemoryDomain domain = MemoryDomain::kUntagged);
+  // `storage` must be cache-line aligned and at least storage_bytes() long;
+  // it must outlive the pool.
+  FramePool(std::span<std::byte> storage, std::size_t block_size,
+            std::size_t block_count);
+  ~FramePool();
+
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  // Returns an empty FrameRef when every block is in use; the caller decides
+  // whether to drop the frame or back off. Never allocates.
+  FrameRef acquire();
+
+  std::size_t block_size() const { return block_size_; }
+  std::size_t block_count() const { return block_count_; }
+  Stats stats() const;
+
+ private:
+  friend class FrameRef;
+
+  void init();
+  void release(detail::FrameHeader* header);
+  std::size_t owned_bytes() const;
+  detail::FrameHeader* header_at(uint32_t index) const {
+    return reinterpret_cast<detail::FrameHeader*>(base_ + index * stride_);
+  }
+
+  // owned_ comes from the cache-line-aligned operator new[], so it must
+  // go back through the matching aligned delete.
+  struct AlignedDelete {
+    void operator()(std::byte* p) const {
+      ::operator delete[](p, std::align_val_t{kCacheLineSize});
+    }
+  };
+
+  std::size_t block_size_;
+  std::size_t block_count_;
+  std::size_t stride_;
+  MemoryDomain domain_ = MemoryDomain::kUntagged;
+  std::unique_ptr<std::byte[], AlignedDelete> owned_;
+  std::byte* base_ = nullptr;
+  std::unique_ptr<std::atomic<uint16_t>[]> next_;
+
+  // Low 16 bits: index of the first free block (kNil if none); high 16 bits:
+  // tag bumped on every update to defeat ABA.
+  std::atomic<uint32_t> free_head_{0};
+  std::atomic<uint32_t> in_use_{0};
+  std::atomic<uint32_t> high_water_{0};
+  std::atomic<uint32_t> exhaustions_{0};
+};
+
+inline uint8_t* FrameRef::data() const {
+  return reinterpret_cast<uint8_t*>(header_) + FramePool::kPayloadOffset;
+}
+
+inline std::size_t FrameRef::capacity() const {
+  return header_->pool->block_size();
+}
+
+inline void FrameRef::reset() noexcept {
+  if (header_ == nullptr) return;
+  // Sole owner: nobody else can take a new reference, so skip the RMW.
+  if (header_->refs.load(std::memory_order_acquire) == 1 ||
+      header_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    header_->pool->release(header_);
+  }
+  header_ = nullptr;
+}
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_MEMORY_FRAME_POOL_H_
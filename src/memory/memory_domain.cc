@@ -0,0 +1,217 @@
+#include "memory/memory_domain.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <limits>
+
+#include "base/cache.h"
+#include "base/clock.h"
+
+namespace xiaozi {
+namespace {
+
+// One cache line per domain: the audio and network threads charge their
+// own domains without sharing lines.
+struct alignas(kCacheLineSize) Domain {
+  std::atomic<uint64_t> live{0};
+  std::atomic<uint64_t> current{0};
+  std::atomic<uint64_t> peak{0};
+  std::atomic<uint64_t> budget{0};
+  std::atomic<uint64_t> charges{0};
+  std::atomic<uint64_t> refusals{0};
+  // Bytes left until the next sample.
+  std::atomic<int64_t> until_sample{0};
+};
+
+Domain g_domains[kMemoryDomainCount];
+
+// Sample log: a ring of seqlocked slots, as the trace event log. Slot
+// i % kSampleLogSize holds sample i once its sequence reads 2i + 2.
+struct SampleSlot {
+  std::atomic<uint64_t> seq{0};
+  std::atomic<uint64_t> time_ns{0};
+  std::atomic<uintptr_t> site{0};
+  std::atomic<uint32_t> bytes{0};
+  std::atomic<uint8_t> domain{0};
+};
+
+SampleSlot g_samples[memory::kSampleLogSize];
+std::atomic<uint64_t> g_next_sample{0};
+std::atomic<int64_t> g_sample_interval{0};
+
+Domain& domain_of(MemoryDomain d) {
+  return g_domains[static_cast<std::size_t>(d)];
+}
+
+void record_sample(MemoryDomain d, std::size_t bytes, const void* site) {
+  const uint64_t i = g_next_sample.fetch_add(1, std::memory_order_relaxed);
+  SampleSlot& slot = g_samples[i % memory::kSampleLogSize];
+  slot.seq.store(2 * i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.time_ns.store(monotonic_ns(), std::memory_order_relaxed);
+  slot.site.store(reinterpret_cast<uintptr_t>(site),
+                  std::memory_order_relaxed);
+  slot.bytes.store(static_cast<uint32_t>(std::min<std::size_t>(
+                       bytes, std::numeric_limits<uint32_t>::max())),
+                   std::memory_order_relaxed);
+  slot.domain.store(static_cast<uint8_t>(d), std::memory_order_relaxed);
+  slot.seq.store(2 * i + 2, std::memory_order_release);
+}
+
+void account(MemoryDomain d, Domain& dom, uint64_t now_bytes,
+             std::size_t bytes, const void* site) {
+  uint64_t peak = dom.peak.load(std::memory_order_relaxed);
+  while (now_bytes > peak &&
+         !dom.peak.compare_exchange_weak(peak, now_bytes,
+                                         std::memory_order_relaxed)) {
+  }
+  dom.live.fetch_add(1, std::memory_order_relaxed);
+  dom.charges.fetch_add(1, std::memory_order_relaxed);
+
+  const int64_t interval = g_sample_interval.load(std::memory_order_relaxed);
+  if (interval == 0) return;
+  const auto n = static_cast<int64_t>(bytes);
+  if (dom.until_sample.fetch_sub(n, std::memory_order_relaxed) > n) return;
+  // Racing chargers may both sample; the log tolerates that.
+  dom.until_sample.store(interval, std::memory_order_relaxed);
+  record_sample(d, bytes, site);
+}
+
+}  // namespace
+
+const char* domain_name(MemoryDomain domain) {
+  switch (domain) {
+    case MemoryDomain::kUntagged: return "untagged";
+    case MemoryDomain::kAudio: return "audio";
+    case MemoryDomain::kNetwork: return "network";
+    case MemoryDomain::kUi: return "ui";
+    case MemoryDomain::kAssets: return "assets";
+    case MemoryDomain::kTools: return "tools";
+  }
+  return "?";
+}
+
+namespace memory {
+
+bool try_charge(MemoryDomain domain, std::size_t bytes, const void* site) {
+  Domain& d = domain_of(domain);
+  const uint64_t budget = d.budget.load(std::memory_order_relaxed);
+  uint64_t current = d.current.load(std::memory_order_relaxed);
+  uint64_t next;
+  do {
+    next = current + bytes;
+    if (budget != 0 && next > budget) {
+      d.refusals.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!d.current.compare_exchange_weak(current, next,
+                                            std::memory_order_relaxed));
+  account(domain, d, next, bytes, site);
+  return true;
+}
+
+void charge(MemoryDomain domain, std::size_t bytes, const void* site) {
+  Domain& d = domain_of(domain);
+  const uint64_t next =
+      d.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  account(domain, d, next, bytes, site);
+}
+
+void release(MemoryDomain domain, std::size_t bytes) {
+  Domain& d = domain_of(domain);
+  d.current.fetch_sub(bytes, std::memory_order_relaxed);
+  d.live.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void set_budget(MemoryDomain domain, std::size_t bytes) {
+  domain_of(domain).budget.store(bytes, std::memory_order_relaxed);
+}
+
+std::size_t headroom(MemoryDomain domain) {
+  const Domain& d = domain_of(domain);
+  const uint64_t budget = d.budget.load(std::memory_order_relaxed);
+  if (budget == 0) return std::numeric_limits<std::size_t>::max();
+  const uint64_t current = d.current.load(std::memory_order_relaxed);
+  return current < budget ? static_cast<std::size_t>(budget - current) : 0;
+}
+
+DomainStats stats(MemoryDomain domain) {
+  const Domain& d = domain_of(domain);
+  DomainStats s;
+  s.live = d.live.load(std::memory_order_relaxed);
+  s.current_bytes = d.current.load(std::memory_order_relaxed);
+  s.peak_bytes = d.peak.load(std::memory_order_relaxed);
+  s.budget_bytes = d.budget.load(std::memory_order_relaxed);
+  s.charges = d.charges.load(std::memory_order_relaxed);
+  s.refusals = d.refusals.load(std::memory_order_relaxed);
+  return s;
+}
+
+void reset_peaks() {
+  for (Domain& d : g_domains) {
+    d.peak.store(d.current.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+    d.charges.store(0, std::memory_order_relaxed);
+    d.refusals.store(0, std::memory_order_relaxed);
+  }
+}
+
+void set_sample_interval(std::size_t interval_bytes) {
+  const auto interval = static_cast<int64_t>(interval_bytes);
+  for (Domain& d : g_domains) {
+    d.until_sample.store(interval, std::memory_order_relaxed);
+  }
+  g_sample_interval.store(interval, std::memory_order_relaxed);
+}
+
+std::vector<Sample> samples() {
+  const uint64_t next = g_next_sample.load(std::memory_order_acquire);
+  const uint64_t first = next > kSampleLogSize ? next - kSampleLogSize : 0;
+  std::vector<Sample> out;
+  out.reserve(next - first);
+  for (uint64_t i = first; i < next; ++i) {
+    const SampleSlot& slot = g_samples[i % kSampleLogSize];
+    const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * i + 2) continue;
+    Sample s;
+    s.time_ns = slot.time_ns.load(std::memory_order_relaxed);
+    s.site = slot.site.load(std::memory_order_relaxed);
+    s.bytes = slot.bytes.load(std::memory_order_relaxed);
+    s.domain =
+        static_cast<MemoryDomain>(slot.domain.load(std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+    out.push_back(s);
+  }
+  return out;
+}
+
+std::string format_stats() {
+  std::string out;
+  char line[192];
+  for (std::size_t i = 0; i < kMemoryDomainCount; ++i) {
+    const auto domain = static_cast<MemoryDomain>(i);
+    const DomainStats s = stats(domain);
+    if (s.peak_bytes == 0 && s.refusals == 0) continue;
+    std::snprintf(line, sizeof(line),
+                  "memory %s live=%llu current_kb=%.1f peak_kb=%.1f "
+                  "budget_kb=%.1f refusals=%llu\n",
+                  domain_name(domain), static_cast<unsigned long long>(s.live),
+                  s.current_bytes / 1024.0, s.peak_bytes / 1024.0,
+                  s.budget_bytes / 1024.0,
+                  static_cast<unsigned long long>(s.refusals));
+    out += line;
+  }
+  for (const Sample& s : samples()) {
+    std::snprintf(line, sizeof(line),
+                  "memory_sample %s at_ms=%.1f bytes=%u site=0x%llx\n",
+                  domain_name(s.domain), s.time_ns / 1e6, s.bytes,
+                  static_cast<unsigned long long>(s.site));
+    out += line;
+  }
+  return out;
+}
+
+}  // namespace memory
+}  // namespace xiaozi
@@ -0,0 +1,90 @@
+#ifndef XIAOZI_MEMORY_MEMORY_DOMAIN_H_
+#define XIAOZI_MEMORY_MEMORY_DOMAIN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xiaozi {
+
+// The subsystem heap memory is charged to. FramePool, Arena,
+// FrameAllocator and the UI and asset owners take one and charge what they
+// take from the heap, so when a board runs low, memory::stats() says who
+// holds it. Memory nobody tagged lands in kUntagged.
+enum class MemoryDomain : uint8_t {
+  kUntagged,
+  kAudio,
+  kNetwork,
+  kUi,
+  kAssets,
+  kTools,  // MCP tools, replay and other offline tooling
+};
+inline constexpr std::size_t kMemoryDomainCount = 6;
+
+const char* domain_name(MemoryDomain domain);
+
+namespace memory {
+
+struct DomainStats {
+  uint64_t live;           // charges not yet released
+  uint64_t current_bytes;
+  uint64_t peak_bytes;
+  uint64_t budget_bytes;   // 0: no budget
+  uint64_t charges;        // since start or reset_peaks()
+  uint64_t refusals;       // try_charge() calls the budget turned down
+};
+
+// Any thread, lock-free. Charges `bytes` to `domain` unless that would take
+// it past its budget; then nothing is charged, the refusal is counted and
+// the owner falls back (a smaller pool, a failed parse, a cache entry
+// dropped) instead of allocating. `site` is where the allocation came
+// from, kept by the sampled profile.
+bool try_charge(MemoryDomain domain, std::size_t bytes,
+                const void* site = nullptr);
+// Charges regardless of the budget, for memory that has to exist (the
+// first block of an arena, a coroutine frame).
+void charge(MemoryDomain domain, std::size_t bytes,
+            const void* site = nullptr);
+// Undoes one charge of `bytes`.
+void release(MemoryDomain domain, std::size_t bytes);
+
+// Any thread. 0 removes the budget. Memory already charged stays charged;
+// a budget below it only refuses what comes next.
+void set_budget(MemoryDomain domain, std::size_t bytes);
+// Bytes try_charge() would still accept; SIZE_MAX without a budget.
+std::size_t headroom(MemoryDomain domain);
+
+DomainStats stats(MemoryDomain domain);
+// Peaks back to the current bytes; charge and refusal counts to 0.
+void reset_peaks();
+
+// Sampled allocation profile: about one charge per `interval_bytes`
+// charged to a domain is logged with its size and site, so a leak shows
+// up as a site that keeps appearing. 0 (the default) turns it off, which
+// leaves one relaxed load per charge.
+inline constexpr std::size_t kSampleLogSize = 128;
+
+struct Sample {
+  uint64_t time_ns = 0;  // monotonic_ns()
+  uintptr_t site = 0;    // for addr2line
+  uint32_t bytes = 0;
+  MemoryDomain domain = MemoryDomain::kUntagged;
+};
+
+void set_sample_interval(std::size_t interval_bytes);
+// The newest kSampleLogSize samples, oldest first.
+std::vector<Sample> samples();
+
+// Lines for the `stats` reply (after the trace lines; add_stats_tool() in
+// protocol/mcp_server.h), one per domain that has been charged:
+//   memory <domain> live=<n> current_kb=<x> peak_kb=<x> budget_kb=<x>
+//   refusals=<n>
+// (budget_kb=0 for none), then one per sample, oldest first:
+//   memory_sample <domain> at_ms=<t> bytes=<n> site=0x<addr>
+std::string format_stats();
+
+}  // namespace memory
+}  // namespace xiaozi
+
+#endif  // XIAOZI_MEMORY_MEMORY_DOMAIN_H_
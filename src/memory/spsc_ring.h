@@ -0,0 +1,154 @@
+#ifndef XIAOZI_MEMORY_SPSC_RING_H_
+#define XIAOZI_MEMORY_SPSC_RING_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "base/cache.h"
+
+namespace xiaozi {
+
+// Bounded single-producer/single-consumer ring. Exactly one thread (or ISR)
+// may call the push side and exactly one the pop side; neither side ever
+// locks, allocates or blocks, so a low-priority consumer cannot stall the
+// capture path.
+//
+// head_ and tail_ are free-running counters (mask on access), which makes all
+// N slots usable and keeps full/empty unambiguous. Each side keeps a private
+// copy of the other side's counter and only reloads it when the copy says the
+// ring is full/empty, so in steady state the two cores do not bounce each
+// other's cache lines on every element.
+template <typename T, std::size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+  static_assert(std::is_default_constructible_v<T>);
+  static_assert(std::is_nothrow_move_assignable_v<T>);
+  static_assert(std::atomic<std::size_t>::is_always_lock_free);
+
+ public:
+  SpscRing() = default;
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  static constexpr std::size_t capacity() { return N; }
+
+  // Producer side.
+
+  bool try_push(T value) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ == N) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ == N) return false;
+    }
+    slots_[tail & kMask] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Copies as many leading elements of `in` as fit; returns how many. The
+  // ring wrap is handled as at most two contiguous runs.
+  std::size_t push_n(std::span<const T> in) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    std::size_t space = N - (tail - head_cache_);
+    if (space < in.size()) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      space = N - (tail - head_cache_);
+    }
+    const std::size_t n = std::min(space, in.size());
+    if (n == 0) return 0;
+    const std::size_t start = tail & kMask;
+    const std::size_t first = std::min(n, N - start);
+    copy_run(in.data(), &slots_[start], first);
+    copy_run(in.data() + first, &slots_[0], n - first);
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer side.
+
+  bool try_pop(T& out) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) return false;
+    }
+    out = std::move(slots_[head & kMask]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // The oldest element, or nullptr if the ring is empty. Stays valid until
+  // the next pop.
+  T* peek() {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) return nullptr;
+    }
+    return &slots_[head & kMask];
+  }
+
+  // Moves up to out.size() elements into `out`; returns how many.
+  std::size_t pop_n(std::span<T> out) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    std::size_t avail = tail_cache_ - head;
+    if (avail < out.size()) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      avail = tail_cache_ - head;
+    }
+    const std::size_t n = std::min(avail, out.size());
+    if (n == 0) return 0;
+    const std::size_t start = head & kMask;
+    const std::size_t first = std::min(n, N - start);
+    move_run(&slots_[start], out.data(), first);
+    move_run(&slots_[0], out.data() + first, n - first);
+    head_.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+  // Either side. Exact only when the other side is quiescent.
+  std::size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+
+ private:
+  static constexpr std::size_t kMask = N - 1;
+
+  static void copy_run(const T* src, T* dst, std::size_t n) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (n != 0) std::memcpy(dst, src, n * sizeof(T));
+    } else {
+      std::copy_n(src, n, dst);
+    }
+  }
+
+  static void move_run(T* src, T* dst, std::size_t n) {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      if (n != 0) std::memcpy(dst, src, n * sizeof(T));
+    } else {
+      std::move(src, src + n, dst);
+    }
+  }
+
+  // Consumer-owned line: its index plus its view of the producer's index.
+  alignas(kCacheLineSize) std::atomic<std::size_t> head_{0};
+  std::size_t tail_cache_ = 0;
+
+  // Producer-owned line.
+  alignas(kCacheLineSize) std::atomic<std::size_t> tail_{0};
+  std::size_t head_cache_ = 0;
+
+  alignas(kCacheLineSize) std::array<T, N> slots_{};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_MEMORY_SPSC_RING_H_
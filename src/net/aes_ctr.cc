@@ -0,0 +1,28 @@
+#include "net/aes_ctr.h"
+
+#include <openssl/evp.h>
+
+namespace xiaozi {
+
+AesCtr::AesCtr(std::span<const uint8_t, 16> key) : ctx_(EVP_CIPHER_CTX_new()) {
+  if (ctx_ != nullptr &&
+      EVP_EncryptInit_ex(ctx_, EVP_aes_128_ctr(), nullptr, key.data(),
+                         nullptr) != 1) {
+    EVP_CIPHER_CTX_free(ctx_);
+    ctx_ = nullptr;
+  }
+}
+
+AesCtr::~AesCtr() {
+  if (ctx_ != nullptr) EVP_CIPHER_CTX_free(ctx_);
+}
+
+void AesCtr::apply(std::span<const uint8_t, 16> iv, std::span<uint8_t> data) {
+  // Re-arming only the IV keeps the expanded key schedule.
+  EVP_EncryptInit_ex(ctx_, nullptr, nullptr, nullptr, iv.data());
+  int out_len = 0;
+  EVP_EncryptUpdate(ctx_, data.data(), &out_len, data.data(),
+                    static_cast<int>(data.size()));
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,33 @@
+#ifndef XIAOZI_NET_AES_CTR_H_
+#define XIAOZI_NET_AES_CTR_H_
+
+// Only built with OpenSSL (XIAOZI_HAVE_OPENSSL).
+
+#include <cstdint>
+#include <span>
+
+typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+namespace xiaozi {
+
+// AES-128-CTR for the UDP audio channel. Encryption and decryption are the
+// same operation. One instance per direction; not thread-safe.
+class AesCtr {
+ public:
+  explicit AesCtr(std::span<const uint8_t, 16> key);
+  ~AesCtr();
+  AesCtr(const AesCtr&) = delete;
+  AesCtr& operator=(const AesCtr&) = delete;
+
+  bool ok() const { return ctx_ != nullptr; }
+
+  // XORs `data` in place with the keystream starting at counter block `iv`.
+  void apply(std::span<const uint8_t, 16> iv, std::span<uint8_t> data);
+
+ private:
+  EVP_CIPHER_CTX* ctx_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_AES_CTR_H_
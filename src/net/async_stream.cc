@@ -0,0 +1,48 @@
+#include "net/async_stream.h"
+
+#include <sys/uio.h>
+
+#include <cerrno>
+
+namespace xiaozi {
+
+Task<ssize_t> async_read(IoReactor& reactor, Stream& stream,
+                         std::span<uint8_t> buf) {
+  for (;;) {
+    const ssize_t n = stream.read(buf);
+    if (n >= 0) co_return n;
+    if (errno != EAGAIN && errno != EWOULDBLOCK) co_return -errno;
+    if (stream.has_buffered_input()) continue;
+    const int error = co_await reactor.readable(stream.fd());
+    if (error != 0) co_return error;
+  }
+}
+
+Task<ssize_t> async_write(IoReactor& reactor, Stream& stream,
+                          std::span<const uint8_t> data) {
+  std::size_t done = 0;
+  for (;;) {
+    if (stream.wants_write()) {
+      if (stream.flush() < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        co_return -errno;
+      }
+      if (stream.wants_write()) {
+        const int error = co_await reactor.writable(stream.fd());
+        if (error != 0) co_return error;
+        continue;
+      }
+    }
+    if (done == data.size()) co_return static_cast<ssize_t>(done);
+    iovec iov{const_cast<uint8_t*>(data.data()) + done, data.size() - done};
+    const ssize_t n = stream.writev(&iov, 1);
+    if (n > 0) {
+      done += static_cast<std::size_t>(n);
+      continue;
+    }
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) co_return -errno;
+    const int error = co_await reactor.writable(stream.fd());
+    if (error != 0) co_return error;
+  }
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,30 @@
+#ifndef XIAOZI_NET_ASYNC_STREAM_H_
+#define XIAOZI_NET_ASYNC_STREAM_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <span>
+
+#include "net/stream.h"
+#include "runtime/io_reactor.h"
+#include "runtime/task.h"
+
+namespace xiaozi {
+
+// Coroutine reads and writes on a non-blocking Stream, suspending on the
+// reactor instead of polling. Errors come back as -errno rather than in
+// errno, because the coroutine may resume on a different thread than the
+// one that saw the failure.
+
+// At least one byte, 0 on EOF, or -errno.
+Task<ssize_t> async_read(IoReactor& reactor, Stream& stream,
+                         std::span<uint8_t> buf);
+
+// All of `data`, including anything a TLS stream staged, or -errno.
+Task<ssize_t> async_write(IoReactor& reactor, Stream& stream,
+                          std::span<const uint8_t> data);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_ASYNC_STREAM_H_
@@ -0,0 +1,290 @@
+#include "net/mqtt_client.h"
+
+#include <poll.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "base/clock.h"
+
+namespace xiaozi {
+namespace {
+
+enum PacketType : uint8_t {
+  kConnect = 0x10,
+  kConnack = 0x20,
+  kPublish = 0x30,
+  kPuback = 0x40,
+  kSubscribe = 0x82,  // includes the mandatory 0b0010 flags
+  kSuback = 0x90,
+  kPingreq = 0xc0,
+  kPingresp = 0xd0,
+  kDisconnect = 0xe0,
+};
+
+constexpr std::size_t kInputBytes = 16 * 1024;
+
+void put_u16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back(static_cast<uint8_t>(v >> 8));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+void put_string(std::vector<uint8_t>& out, std::string_view s) {
+  put_u16(out, static_cast<uint16_t>(s.size()));
+  out.insert(out.end(), s.begin(), s.end());
+}
+
+// Prepends the fixed header (type byte + variable-length remaining length)
+// to a packet body built from offset 5 of `packet`.
+void finish_packet(std::vector<uint8_t>& packet, uint8_t type) {
+  std::size_t remaining = packet.size() - 5;
+  uint8_t header[5];
+  std::size_t n = 0;
+  header[n++] = type;
+  do {
+    uint8_t byte = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) byte |= 0x80;
+    header[n++] = byte;
+  } while (remaining > 0);
+  std::size_t start = 5 - n;
+  std::memcpy(packet.data() + start, header, n);
+  packet.erase(packet.begin(), packet.begin() + static_cast<long>(start));
+}
+
+// Room for the largest fixed header in front of the body.
+std::vector<uint8_t> new_packet() {
+  std::vector<uint8_t> packet;
+  packet.reserve(64);
+  packet.resize(5);
+  return packet;
+}
+
+// Decodes the fixed header at the front of `data`. Returns false until the
+// whole header is present.
+bool parse_fixed_header(std::span<const uint8_t> data, std::size_t* header_len,
+                        std::size_t* body_len) {
+  std::size_t value = 0;
+  for (std::size_t i = 1; i < data.size() && i <= 4; ++i) {
+    value |= static_cast<std::size_t>(data[i] & 0x7f) << (7 * (i - 1));
+    if ((data[i] & 0x80) == 0) {
+      *header_len = i + 1;
+      *body_len = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t keepalive_ns(int keepalive_s) {
+  return uint64_t{1000000000} * static_cast<uint64_t>(keepalive_s);
+}
+
+}  // namespace
+
+MqttClient::MqttClient() : in_(kInputBytes) {}
+
+MqttClient::~MqttClient() { disconnect(); }
+
+bool MqttClient::connect(std::unique_ptr<Stream> stream,
+                         const Options& options) {
+  {
+    std::lock_guard lock(io_mutex_);
+    stream_ = std::move(stream);
+  }
+  keepalive_s_ = options.keepalive_s;
+  in_len_ = 0;
+
+  auto packet = new_packet();
+  put_string(packet, "MQTT");
+  packet.push_back(4);  // protocol level 3.1.1
+  uint8_t flags = 0x02;  // clean session
+  if (!options.username.empty()) flags |= 0x80;
+  if (!options.password.empty()) flags |= 0x40;
+  packet.push_back(flags);
+  put_u16(packet, static_cast<uint16_t>(options.keepalive_s));
+  put_string(packet, options.client_id);
+  if (!options.username.empty()) put_string(packet, options.username);
+  if (!options.password.empty()) put_string(packet, options.password);
+  finish_packet(packet, kConnect);
+  if (!send_packet(packet)) return false;
+
+  const uint64_t deadline =
+      monotonic_ns() + uint64_t{1000000} * options.timeout_ms;
+  while (in_len_ < 4) {
+    if (wants_write()) on_writable();
+    uint64_t now = monotonic_ns();
+    if (now >= deadline) break;
+    pollfd pfd{fd(), POLLIN, 0};
+    if (!has_buffered_input() &&
+        ::poll(&pfd, 1, static_cast<int>((deadline - now) / 1000000)) <= 0) {
+      continue;
+    }
+    const ssize_t n = read_input();
+    if (n == 0 || (n < 0 && errno != EAGAIN)) break;
+    if (n > 0) in_len_ += static_cast<std::size_t>(n);
+  }
+  // CONNACK: 20 02 <session present> <return code 0 = accepted>.
+  if (in_len_ < 4 || in_[0] != kConnack || in_[1] != 2 || in_[3] != 0) {
+    teardown();
+    return false;
+  }
+  std::memmove(in_.data(), in_.data() + 4, in_len_ - 4);
+  in_len_ -= 4;
+  next_ping_ns_ = monotonic_ns() + keepalive_ns(keepalive_s_);
+  return true;
+}
+
+void MqttClient::disconnect() {
+  if (!connected()) return;
+  std::vector<uint8_t> packet = {kDisconnect, 0};
+  send_packet(packet);
+  teardown();
+}
+
+void MqttClient::teardown() {
+  std::lock_guard lock(io_mutex_);
+  if (stream_ != nullptr) {
+    stream_->close();
+    stream_.reset();
+  }
+  out_.clear();
+  ping_outstanding_ = false;
+}
+
+bool MqttClient::subscribe(std::string_view topic) {
+  auto packet = new_packet();
+  put_u16(packet, next_packet_id_++);
+  if (next_packet_id_ == 0) next_packet_id_ = 1;
+  put_string(packet, topic);
+  packet.push_back(0);  // QoS 0
+  finish_packet(packet, kSubscribe);
+  return send_packet(packet);
+}
+
+bool MqttClient::publish(std::string_view topic, std::string_view payload) {
+  auto packet = new_packet();
+  put_string(packet, topic);
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  finish_packet(packet, kPublish);
+  return send_packet(packet);
+}
+
+bool MqttClient::send_packet(std::vector<uint8_t>& packet) {
+  std::lock_guard lock(io_mutex_);
+  if (stream_ == nullptr) return false;
+  out_.insert(out_.end(), packet.begin(), packet.end());
+  return flush_locked();
+}
+
+bool MqttClient::flush_locked() {
+  if (stream_->wants_write() && stream_->flush() < 0 && errno != EAGAIN) {
+    return false;
+  }
+  while (!out_.empty() && !stream_->wants_write()) {
+    iovec iov{out_.data(), out_.size()};
+    ssize_t n = stream_->writev(&iov, 1);
+    if (n < 0) return errno == EAGAIN;
+    out_.erase(out_.begin(), out_.begin() + n);
+  }
+  return true;
+}
+
+// Reads into in_; -1 with errno ENOTCONN once torn down.
+ssize_t MqttClient::read_input() {
+  std::lock_guard lock(io_mutex_);
+  if (stream_ == nullptr) {
+    errno = ENOTCONN;
+    return -1;
+  }
+  return stream_->read({in_.data() + in_len_, in_.size() - in_len_});
+}
+
+bool MqttClient::wants_write() {
+  std::lock_guard lock(io_mutex_);
+  return stream_ != nullptr && (!out_.empty() || stream_->wants_write());
+}
+
+bool MqttClient::on_writable() {
+  std::lock_guard lock(io_mutex_);
+  if (stream_ == nullptr) return false;
+  return flush_locked();
+}
+
+bool MqttClient::on_timer(uint64_t now_ns) {
+  if (!connected()) return false;
+  if (now_ns < next_ping_ns_) return true;
+  if (ping_outstanding_) {
+    // A whole keepalive interval without PINGRESP: the broker is gone.
+    teardown();
+    return false;
+  }
+  std::vector<uint8_t> packet = {kPingreq, 0};
+  ping_outstanding_ = true;
+  next_ping_ns_ = now_ns + keepalive_ns(keepalive_s_);
+  return send_packet(packet);
+}
+
+bool MqttClient::on_readable() {
+  for (;;) {
+    if (in_len_ == in_.size()) {
+      teardown();
+      return false;
+    }
+    const ssize_t n = read_input();
+    if (n == 0 || (n < 0 && errno != EAGAIN)) {
+      teardown();
+      return false;
+    }
+    if (n < 0) return true;
+    in_len_ += static_cast<std::size_t>(n);
+    if (!dispatch()) {
+      teardown();
+      return false;
+    }
+  }
+}
+
+bool MqttClient::dispatch() {
+  std::size_t offset = 0;
+  for (;;) {
+    std::span<const uint8_t> data(in_.data() + offset, in_len_ - offset);
+    std::size_t header_len, body_len;
+    if (data.empty() || !parse_fixed_header(data, &header_len, &body_len)) {
+      break;
+    }
+    if (header_len + body_len > in_.size()) return false;
+    if (data.size() < header_len + body_len) break;
+    std::span<const uint8_t> body = data.subspan(header_len, body_len);
+    const uint8_t type = data[0] & 0xf0;
+    if (type == kPublish && body.size() >= 2) {
+      std::size_t topic_len = (std::size_t{body[0]} << 8) | body[1];
+      std::size_t pos = 2 + topic_len;
+      // QoS 1/2 deliveries carry a packet id; we subscribe at QoS 0, but a
+      // broker may still deliver retained messages at a higher QoS.
+      const int qos = (data[0] >> 1) & 3;
+      if (qos != 0) pos += 2;
+      if (pos <= body.size() && on_message_) {
+        on_message_({reinterpret_cast<const char*>(body.data() + 2), topic_len},
+                    body.subspan(pos));
+      }
+      // Unacknowledged, a QoS 1 message comes back on every reconnect.
+      if (qos == 1 && pos <= body.size()) {
+        std::vector<uint8_t> puback = {kPuback, 2, body[pos - 2],
+                                       body[pos - 1]};
+        if (!send_packet(puback)) return false;
+      }
+    } else if (type == kPingresp) {
+      ping_outstanding_ = false;
+    }
+    // SUBACK and anything else needs no action.
+    offset += header_len + body_len;
+  }
+  if (offset != 0) {
+    std::memmove(in_.data(), in_.data() + offset, in_len_ - offset);
+    in_len_ -= offset;
+  }
+  return true;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,99 @@
+#ifndef XIAOZI_NET_MQTT_CLIENT_H_
+#define XIAOZI_NET_MQTT_CLIENT_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "net/stream.h"
+
+namespace xiaozi {
+
+// Minimal MQTT 3.1.1 client for the control channel: QoS 0 publish and
+// subscribe, keepalive, clean session. Everything the device sends on this
+// channel is small JSON, so there is no QoS 1/2 machinery beyond the PUBACK
+// for a message the broker delivers at QoS 1 anyway.
+//
+// publish() may be called from any thread; the rest from the owning
+// (transport) thread. An SSL stream takes one caller at a time, so every
+// call into the stream, and its teardown, holds io_mutex_.
+class MqttClient {
+ public:
+  struct Options {
+    std::string client_id;
+    std::string username;
+    std::string password;
+    int keepalive_s = 90;
+    int timeout_ms = 5000;
+  };
+
+  using MessageHandler = std::function<void(std::string_view topic,
+                                            std::span<const uint8_t> payload)>;
+
+  MqttClient();
+  ~MqttClient();
+
+  // Sends CONNECT on `stream` and waits for CONNACK.
+  bool connect(std::unique_ptr<Stream> stream, const Options& options);
+  void disconnect();
+  bool connected() const {
+    std::lock_guard lock(io_mutex_);
+    return stream_ != nullptr;
+  }
+
+  bool subscribe(std::string_view topic);
+  bool publish(std::string_view topic, std::string_view payload);
+
+  void set_message_handler(MessageHandler handler) {
+    on_message_ = std::move(handler);
+  }
+
+  int fd() const {
+    std::lock_guard lock(io_mutex_);
+    return stream_ ? stream_->fd() : -1;
+  }
+  bool has_buffered_input() const {
+    std::lock_guard lock(io_mutex_);
+    return stream_ && stream_->has_buffered_input();
+  }
+  bool wants_write();
+
+  // Transport thread: after POLLIN, after POLLOUT, and at least once per
+  // keepalive interval. Each returns false once the connection is lost.
+  bool on_readable();
+  bool on_writable();
+  bool on_timer(uint64_t now_ns);
+  // monotonic_ns() time at which on_timer() next has work to do.
+  uint64_t next_timer_ns() const { return next_ping_ns_; }
+
+ private:
+  bool send_packet(std::vector<uint8_t>& packet);
+  bool flush_locked();
+  ssize_t read_input();
+  bool dispatch();
+  void teardown();
+
+  // Guards stream_ and out_. Never held while on_message_ runs, which may
+  // publish.
+  mutable std::mutex io_mutex_;
+  std::unique_ptr<Stream> stream_;
+  MessageHandler on_message_;
+  int keepalive_s_ = 0;
+  uint16_t next_packet_id_ = 1;
+  uint64_t next_ping_ns_ = 0;
+  bool ping_outstanding_ = false;
+
+  std::vector<uint8_t> out_;
+
+  std::vector<uint8_t> in_;
+  std::size_t in_len_ = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_MQTT_CLIENT_H_
@@ -0,0 +1,337 @@
+#include "net/mqtt_udp_transport.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "base/clock.h"
+#include "base/trace.h"
+#include "net/tls_stream.h"
+#include "net/url.h"
+
+namespace xiaozi {
+namespace {
+
+// Datagrams read per poll() before the control channel gets a turn.
+constexpr int kMaxDatagramsPerPoll = 32;
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool parse_hex(std::string_view hex, std::span<uint8_t> out) {
+  if (hex.size() != 2 * out.size()) return false;
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    int hi = hex_value(hex[2 * i]);
+    int lo = hex_value(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = static_cast<uint8_t>(hi << 4 | lo);
+  }
+  return true;
+}
+
+void put_be16(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 8);
+  p[1] = static_cast<uint8_t>(v);
+}
+
+void put_be32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+uint32_t get_be32(const uint8_t* p) {
+  return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 |
+         p[3];
+}
+
+}  // namespace
+
+std::optional<UdpAudioParams> UdpAudioParams::from_hex(
+    std::string server, int port, std::string_view key_hex,
+    std::string_view nonce_hex) {
+  UdpAudioParams params;
+  params.server = std::move(server);
+  params.port = port;
+  if (!parse_hex(key_hex, params.key) || !parse_hex(nonce_hex, params.nonce)) {
+    return std::nullopt;
+  }
+  return params;
+}
+
+MqttUdpTransport::MqttUdpTransport(Config config)
+    : config_(std::move(config)),
+      send_pool_(config_.max_packet_bytes, 1, MemoryDomain::kNetwork),
+      receive_pool_(config_.max_packet_bytes, config_.receive_pool_blocks,
+                    MemoryDomain::kNetwork) {}
+
+MqttUdpTransport::~MqttUdpTransport() {
+  close();
+  reserved_.reset();
+}
+
+bool MqttUdpTransport::open() {
+  auto url = parse_url(config_.url);
+  if (!url || (url->scheme != "mqtt" && url->scheme != "mqtts")) return false;
+  const uint64_t start_ns = monotonic_ns();
+
+  std::unique_ptr<Stream> stream;
+  bool resumed = false;
+  if (url->secure()) {
+    TlsStream::Options options;
+    options.verify_peer = config_.verify_peer;
+    options.timeout_ms = config_.connect_timeout_ms;
+    options.session_cache = &tls_cache_;
+    auto tls = TlsStream::connect(url->host, url->port, options);
+    resumed = tls != nullptr && tls->resumed();
+    stream = std::move(tls);
+  } else {
+    stream = TcpStream::connect(url->host, url->port,
+                                config_.connect_timeout_ms);
+  }
+  if (stream == nullptr || !attach(std::move(stream))) return false;
+  connects_.fetch_add(1, std::memory_order_relaxed);
+  if (resumed) resumed_connects_.fetch_add(1, std::memory_order_relaxed);
+  connect_ns_.store(monotonic_ns() - start_ns, std::memory_order_relaxed);
+  return true;
+}
+
+bool MqttUdpTransport::attach(std::unique_ptr<Stream> stream) {
+  close();
+  MqttClient::Options options = config_.mqtt;
+  options.timeout_ms = config_.connect_timeout_ms;
+  if (!mqtt_.connect(std::move(stream), options)) return false;
+  mqtt_.set_message_handler(
+      [this](std::string_view, std::span<const uint8_t> payload) {
+        packets_received_.fetch_add(1, std::memory_order_relaxed);
+        if (on_text_) {
+          on_text_({reinterpret_cast<const char*>(payload.data()),
+                    payload.size()});
+        }
+      });
+  if (!config_.subscribe_topic.empty() &&
+      !mqtt_.subscribe(config_.subscribe_topic)) {
+    mqtt_.disconnect();
+    return false;
+  }
+  return true;
+}
+
+void MqttUdpTransport::close() {
+  close_audio_channel();
+  mqtt_.disconnect();
+}
+
+bool MqttUdpTransport::open_audio_channel(const UdpAudioParams& params) {
+  int fd = udp_connect(params.server, params.port);
+  if (fd < 0) return false;
+  return attach_audio_socket(fd, params);
+}
+
+bool MqttUdpTransport::attach_audio_socket(int fd,
+                                           const UdpAudioParams& params) {
+  close_audio_channel();
+  auto send_cipher = std::make_unique<AesCtr>(params.key);
+  auto receive_cipher = std::make_unique<AesCtr>(params.key);
+  if (!send_cipher->ok() || !receive_cipher->ok()) {
+    ::close(fd);
+    return false;
+  }
+  std::lock_guard lock(audio_mutex_);
+  udp_fd_ = fd;
+  nonce_ = params.nonce;
+  send_cipher_ = std::move(send_cipher);
+  receive_cipher_ = std::move(receive_cipher);
+  send_sequence_ = 0;
+  audio_ready_.store(true, std::memory_order_release);
+  return true;
+}
+
+void MqttUdpTransport::close_audio_channel() {
+  std::lock_guard lock(audio_mutex_);
+  audio_ready_.store(false, std::memory_order_release);
+  if (udp_fd_ >= 0) {
+    ::close(udp_fd_);
+    udp_fd_ = -1;
+  }
+  send_cipher_.reset();
+  receive_cipher_.reset();
+}
+
+void MqttUdpTransport::fail() {
+  close();
+  if (on_close_) on_close_();
+}
+
+std::span<uint8_t> MqttUdpTransport::reserve(std::size_t max_bytes) {
+  if (!reserved_) {
+    reserved_ = send_pool_.acquire();
+    if (!reserved_) return {};
+  }
+  return {reserved_.data(), std::min(max_bytes, send_pool_.block_size())};
+}
+
+bool MqttUdpTransport::commit(std::size_t bytes, uint64_t capture_ns) {
+  if (bytes == 0) return true;
+  if (!reserved_) return false;
+  const uint64_t start_ns = monotonic_ns();
+  std::unique_lock lock(audio_mutex_);
+  if (send_cipher_ == nullptr || bytes > 0xffff) {
+    packets_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  std::array<uint8_t, kHeaderBytes> header = nonce_;
+  put_be16(&header[2], static_cast<uint32_t>(bytes));
+  put_be32(&header[8], static_cast<uint32_t>(capture_ns / 1000000));
+  put_be32(&header[12], send_sequence_++);
+  send_cipher_->apply(header, {reserved_.data(), bytes});
+
+  iovec iov[2] = {{header.data(), header.size()}, {reserved_.data(), bytes}};
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  ssize_t n;
+  do {
+    n = ::sendmsg(udp_fd_, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+  } while (n < 0 && errno == EINTR);
+  lock.unlock();
+  send_syscalls_.fetch_add(1, std::memory_order_relaxed);
+  if (n < 0) {
+    // Socket buffer full or ICMP unreachable: the packet is lost, exactly as
+    // it would be on the wire.
+    packets_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  XIAOZI_TRACE_SINCE(kSend, capture_ns);
+  const uint64_t sent_ns = monotonic_ns();
+  note_audio_sent(sent_ns);
+  const uint64_t delay = sent_ns - start_ns;
+  packets_sent_.fetch_add(1, std::memory_order_relaxed);
+  bytes_sent_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+  queue_delay_total_ns_.fetch_add(delay, std::memory_order_relaxed);
+  if (delay > queue_delay_max_ns_.load(std::memory_order_relaxed)) {
+    queue_delay_max_ns_.store(delay, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+bool MqttUdpTransport::send_text(std::string_view message) {
+  if (!mqtt_.connected()) return false;
+  if (!mqtt_.publish(config_.publish_topic, message)) return false;
+  // Whatever did not fit into the socket is left for poll()'s POLLOUT.
+  if (mqtt_.wants_write()) waker_.notify();
+  return true;
+}
+
+void MqttUdpTransport::poll(int timeout_ms) {
+  if (!mqtt_.connected()) {
+    pollfd pfd{waker_.fd(), POLLIN, 0};
+    ::poll(&pfd, 1, timeout_ms);
+    waker_.drain();
+    return;
+  }
+
+  uint64_t now = monotonic_ns();
+  int64_t wait_ns = int64_t{timeout_ms} * 1000000;
+  const uint64_t timer = mqtt_.next_timer_ns();
+  wait_ns = std::clamp<int64_t>(static_cast<int64_t>(timer - now), 0, wait_ns);
+  if (mqtt_.has_buffered_input()) wait_ns = 0;
+
+  pollfd fds[3] = {
+      {mqtt_.fd(), POLLIN, 0},
+      {waker_.fd(), POLLIN, 0},
+      {udp_fd_, POLLIN, 0},
+  };
+  if (mqtt_.wants_write()) fds[0].events |= POLLOUT;
+  const nfds_t count = udp_fd_ >= 0 ? 3 : 2;
+  timespec ts{static_cast<time_t>(wait_ns / 1000000000),
+              static_cast<long>(wait_ns % 1000000000)};
+  int rc = ::ppoll(fds, count, &ts, nullptr);
+  if (rc < 0 && errno != EINTR) {
+    fail();
+    return;
+  }
+  if (fds[1].revents & POLLIN) waker_.drain();
+  if (count == 3 && (fds[2].revents & POLLIN)) read_audio();
+
+  bool ok = true;
+  if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) ||
+      mqtt_.has_buffered_input()) {
+    ok = mqtt_.on_readable();
+  }
+  if (ok && mqtt_.wants_write()) ok = mqtt_.on_writable();
+  if (ok) ok = mqtt_.on_timer(monotonic_ns());
+  if (!ok) fail();
+}
+
+void MqttUdpTransport::read_audio() {
+  std::array<uint8_t, kHeaderBytes> header;
+  for (int i = 0; i < kMaxDatagramsPerPoll; ++i) {
+    FrameRef frame = receive_pool_.acquire();
+    // Without a block the datagram still has to leave the socket buffer.
+    uint8_t discard[1];
+    iovec iov[2] = {
+        {header.data(), header.size()},
+        frame ? iovec{frame.data(), frame.capacity()} : iovec{discard, 1},
+    };
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    ssize_t n;
+    do {
+      n = ::recvmsg(udp_fd_, &msg, MSG_DONTWAIT);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return;
+    bytes_received_.fetch_add(static_cast<uint64_t>(n),
+                              std::memory_order_relaxed);
+    if (!frame) {
+      packets_rx_dropped_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    const auto payload = static_cast<std::size_t>(n) - kHeaderBytes;
+    if (n < static_cast<ssize_t>(kHeaderBytes) || (msg.msg_flags & MSG_TRUNC) ||
+        header[0] != nonce_[0] ||
+        (std::size_t{header[2]} << 8 | header[3]) != payload) {
+      packets_rejected_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    receive_cipher_->apply(header, {frame.data(), payload});
+    frame.set_size(payload);
+    frame.set_sequence(get_be32(&header[12]));
+    frame.set_timestamp_ns(monotonic_ns());
+    packets_received_.fetch_add(1, std::memory_order_relaxed);
+    if (on_audio_) on_audio_(std::move(frame));
+  }
+}
+
+TransportStats MqttUdpTransport::stats() const {
+  TransportStats s;
+  s.packets_sent = packets_sent_.load(std::memory_order_relaxed);
+  s.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+  s.send_syscalls = send_syscalls_.load(std::memory_order_relaxed);
+  s.packets_received = packets_received_.load(std::memory_order_relaxed);
+  s.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+  s.packets_dropped = packets_dropped_.load(std::memory_order_relaxed);
+  s.packets_rx_dropped =
+      packets_rx_dropped_.load(std::memory_order_relaxed);
+  s.queue_delay_total_ns =
+      queue_delay_total_ns_.load(std::memory_order_relaxed);
+  s.queue_delay_max_ns = queue_delay_max_ns_.load(std::memory_order_relaxed);
+  s.connects = connects_.load(std::memory_order_relaxed);
+  s.resumed_connects = resumed_connects_.load(std::memory_order_relaxed);
+  s.connect_ns = connect_ns_.load(std::memory_order_relaxed);
+  fill_wake_stats(s);
+  return s;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,153 @@
+#ifndef XIAOZI_NET_MQTT_UDP_TRANSPORT_H_
+#define XIAOZI_NET_MQTT_UDP_TRANSPORT_H_
+
+// Only built with OpenSSL (XIAOZI_HAVE_OPENSSL).
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "memory/frame_pool.h"
+#include "net/aes_ctr.h"
+#include "net/mqtt_client.h"
+#include "net/tcp_stream.h"
+#include "net/tls_stream.h"
+#include "net/transport.h"
+
+namespace xiaozi {
+
+// Parameters of the UDP audio channel, as handed out by the server in its
+// reply to the device's "hello" on the control channel.
+struct UdpAudioParams {
+  std::string server;
+  int port = 0;
+  std::array<uint8_t, 16> key{};
+  // Header template: byte 0 packet type, bytes 4..7 the session's SSRC.
+  // The rest is overwritten per packet.
+  std::array<uint8_t, 16> nonce{};
+
+  // Both keys are 32 hex digits.
+  static std::optional<UdpAudioParams> from_hex(std::string server, int port,
+                                                std::string_view key_hex,
+                                                std::string_view nonce_hex);
+};
+
+// MQTT (mqtt:// or mqtts://) for control messages plus AES-CTR encrypted
+// UDP datagrams for audio, so a lost audio packet costs one frame of
+// concealment instead of a TCP retransmit stall for everything behind it.
+//
+// Datagram layout, 16-byte header followed by the encrypted payload:
+//   0      type (0x01, from the nonce template)
+//   2..3   payload bytes, big endian
+//   4..7   SSRC (from the nonce template)
+//   8..11  timestamp in ms, big endian
+//   12..15 sequence number, big endian
+// The header doubles as the CTR IV, so every packet has a unique keystream.
+//
+// Unlike the WebSocket transport there is no batching: commit() encrypts in
+// place and sends the datagram straight from the producer thread, under
+// audio_mutex_ so the channel cannot close underneath it. Received
+// packets carry their sequence number (FrameRef::sequence) and arrival time
+// (FrameRef::timestamp_ns) for a JitterBuffer on the playback side.
+class MqttUdpTransport : public Transport {
+  static constexpr std::size_t kHeaderBytes = 16;
+
+ public:
+  struct Config {
+    std::string url;
+    MqttClient::Options mqtt;
+    // send_text() publishes here; messages on subscribe_topic go to the text
+    // handler.
+    std::string publish_topic;
+    std::string subscribe_topic;
+    std::size_t max_packet_bytes = 1276;
+    std::size_t receive_pool_blocks = 32;
+    int connect_timeout_ms = 5000;
+    bool verify_peer = true;
+  };
+
+  explicit MqttUdpTransport(Config config);
+  ~MqttUdpTransport() override;
+
+  // Connects the control channel only; audio needs open_audio_channel().
+  bool open() override;
+  // Adopts an already connected MQTT stream (tests, replay, bench).
+  bool attach(std::unique_ptr<Stream> stream);
+  void close() override;
+  bool is_open() const override { return mqtt_.connected(); }
+
+  // Transport thread. Replaces any previous channel; a commit() meanwhile
+  // sends on the old channel or the new one, or is dropped.
+  bool open_audio_channel(const UdpAudioParams& params);
+  // Same with a connected datagram socket the transport takes over.
+  bool attach_audio_socket(int fd, const UdpAudioParams& params);
+  void close_audio_channel();
+  bool audio_open() const {
+    return audio_ready_.load(std::memory_order_acquire);
+  }
+
+  std::span<uint8_t> reserve(std::size_t max_bytes) override;
+  bool commit(std::size_t bytes, uint64_t capture_ns) override;
+
+  bool send_text(std::string_view message) override;
+  void poll(int timeout_ms) override;
+  TransportStats stats() const override;
+
+  // Datagrams dropped on receipt: wrong type, bad length, truncated.
+  uint64_t packets_rejected() const {
+    return packets_rejected_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void read_audio();
+  void fail();
+
+  Config config_;
+  MqttClient mqtt_;
+  Waker waker_;
+  // mqtts:// reconnects resume the previous session.
+  TlsSessionCache tls_cache_;
+
+  // Audio channel, set up and closed on the transport thread. Changes and
+  // every send hold audio_mutex_; the transport thread's own reads don't
+  // need it. Held for one sendmsg(), and contended only while the channel
+  // opens or closes.
+  std::mutex audio_mutex_;
+  int udp_fd_ = -1;
+  std::array<uint8_t, kHeaderBytes> nonce_{};
+  std::unique_ptr<AesCtr> send_cipher_;
+  std::unique_ptr<AesCtr> receive_cipher_;
+  uint32_t send_sequence_ = 0;
+  std::atomic<bool> audio_ready_{false};
+
+  // Producer thread. The datagram is copied by the kernel, so one block is
+  // reserved once and reused for every packet.
+  FramePool send_pool_;
+  FrameRef reserved_;
+
+  // Transport thread.
+  FramePool receive_pool_;
+
+  std::atomic<uint64_t> packets_sent_{0};
+  std::atomic<uint64_t> bytes_sent_{0};
+  std::atomic<uint64_t> send_syscalls_{0};
+  std::atomic<uint64_t> packets_received_{0};
+  std::atomic<uint64_t> bytes_received_{0};
+  std::atomic<uint64_t> packets_dropped_{0};
+  std::atomic<uint64_t> packets_rx_dropped_{0};
+  std::atomic<uint64_t> packets_rejected_{0};
+  std::atomic<uint64_t> queue_delay_total_ns_{0};
+  std::atomic<uint64_t> queue_delay_max_ns_{0};
+  std::atomic<uint64_t> connects_{0};
+  std::atomic<uint64_t> resumed_connects_{0};
+  std::atomic<uint64_t> connect_ns_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_MQTT_UDP_TRANSPORT_H_
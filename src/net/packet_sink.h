@@ -0,0 +1,32 @@
+#ifndef XIAOZI_NET_PACKET_SINK_H_
+#define XIAOZI_NET_PACKET_SINK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xiaozi {
+
+// Where an encoder puts outgoing audio packets. A transport implements this
+// over its own send buffer, so the encoder writes each packet in place,
+// directly behind the room the transport keeps for its framing header, and
+// nothing is copied between codec and socket.
+class PacketSink {
+ public:
+  virtual ~PacketSink() = default;
+
+  // Lends out contiguous space for one packet of up to max_bytes. An empty
+  // span means the send buffer is full; the caller drops the packet or
+  // retries later.
+  virtual std::span<uint8_t> reserve(std::size_t max_bytes) = 0;
+
+  // Publishes the first `bytes` of the last reserve() as one packet;
+  // bytes == 0 abandons the reservation. capture_ns is the capture time of
+  // the packet's first sample. False if the packet was dropped instead
+  // (queue full, channel closed); an abandoned reservation is never a drop.
+  virtual bool commit(std::size_t bytes, uint64_t capture_ns) = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_PACKET_SINK_H_
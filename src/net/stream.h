@@ -0,0 +1,41 @@
+#ifndef XIAOZI_NET_STREAM_H_
+#define XIAOZI_NET_STREAM_H_
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace xiaozi {
+
+// A connected, non-blocking byte stream (plain TCP or TLS). Return values
+// follow the POSIX calls they mirror: bytes transferred, 0 for EOF on read,
+// -1 with errno set (EAGAIN when the call would block).
+class Stream {
+ public:
+  virtual ~Stream() = default;
+
+  virtual ssize_t read(std::span<uint8_t> buf) = 0;
+  // Gathers all of `iov` into as few transport writes as the stream allows:
+  // one writev() for TCP, one TLS record sequence for TLS.
+  virtual ssize_t writev(const struct iovec* iov, int count) = 0;
+
+  // True if bytes accepted by writev() are still waiting for socket space
+  // (TLS keeps them in its own staging buffer). The owner then polls for
+  // POLLOUT and calls flush().
+  virtual bool wants_write() const { return false; }
+  virtual ssize_t flush() { return 0; }
+
+  // Bytes already decrypted and buffered inside the stream; the owner must
+  // read() them before waiting on the fd again.
+  virtual bool has_buffered_input() const { return false; }
+
+  virtual int fd() const = 0;
+  virtual void close() = 0;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_STREAM_H_
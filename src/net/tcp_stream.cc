@@ -0,0 +1,173 @@
+#include "net/tcp_stream.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace xiaozi {
+namespace {
+
+bool set_nonblocking(int fd, bool on) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0) return false;
+  flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+  return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+// Non-blocking connect + poll so the timeout applies per address.
+int connect_one(const addrinfo* ai, int timeout_ms) {
+  int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                  ai->ai_protocol);
+  if (fd < 0) return -1;
+  set_nonblocking(fd, true);
+  if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+    if (errno != EINPROGRESS) {
+      ::close(fd);
+      return -1;
+    }
+    pollfd pfd{fd, POLLOUT, 0};
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (::poll(&pfd, 1, timeout_ms) != 1 ||
+        getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 ||
+        error != 0) {
+      ::close(fd);
+      return -1;
+    }
+  }
+  return fd;
+}
+
+bool set_tcp_option(int fd, int option, int value) {
+  return setsockopt(fd, IPPROTO_TCP, option, &value, sizeof(value)) == 0;
+}
+
+}  // namespace
+
+int tcp_connect(const std::string& host, int port, int timeout_ms) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &result) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (addrinfo* ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+    fd = connect_one(ai, timeout_ms);
+  }
+  freeaddrinfo(result);
+  if (fd < 0) return -1;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+bool set_keepalive(int fd, int idle_s, int interval_s, int probes) {
+  const int one = 1;
+  return setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one)) == 0 &&
+         set_tcp_option(fd, TCP_KEEPIDLE, idle_s) &&
+         set_tcp_option(fd, TCP_KEEPINTVL, interval_s) &&
+         set_tcp_option(fd, TCP_KEEPCNT, probes);
+}
+
+std::optional<TcpLinkInfo> read_tcp_info(int fd) {
+  tcp_info info{};
+  socklen_t len = sizeof(info);
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) {
+    return std::nullopt;
+  }
+  return TcpLinkInfo{info.tcpi_rtt, info.tcpi_rttvar, info.tcpi_total_retrans,
+                     info.tcpi_data_segs_out};
+}
+
+int udp_connect(const std::string& host, int port) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo* result = nullptr;
+  if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints,
+                  &result) != 0) {
+    return -1;
+  }
+  int fd = -1;
+  for (addrinfo* ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                ai->ai_protocol);
+    if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(result);
+  return fd;
+}
+
+std::unique_ptr<TcpStream> TcpStream::connect(const std::string& host,
+                                              int port, int timeout_ms) {
+  int fd = tcp_connect(host, port, timeout_ms);
+  if (fd < 0) return nullptr;
+  return std::make_unique<TcpStream>(fd);
+}
+
+ssize_t TcpStream::read(std::span<uint8_t> buf) {
+  ssize_t n;
+  do {
+    n = ::recv(fd_, buf.data(), buf.size(), 0);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+ssize_t TcpStream::writev(const struct iovec* iov, int count) {
+  msghdr msg{};
+  msg.msg_iov = const_cast<struct iovec*>(iov);
+  msg.msg_iovlen = static_cast<size_t>(count);
+  ssize_t n;
+  do {
+    // sendmsg rather than writev for MSG_NOSIGNAL: a peer reset must not
+    // raise SIGPIPE in the device process.
+    n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+void TcpStream::close() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+Waker::Waker() {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) == 0) {
+    read_fd_ = fds[0];
+    write_fd_ = fds[1];
+  }
+}
+
+Waker::~Waker() {
+  if (read_fd_ >= 0) ::close(read_fd_);
+  if (write_fd_ >= 0) ::close(write_fd_);
+}
+
+void Waker::notify() {
+  const uint8_t byte = 1;
+  // A full pipe already guarantees a pending wakeup.
+  [[maybe_unused]] ssize_t n = ::write(write_fd_, &byte, 1);
+}
+
+void Waker::drain() {
+  uint8_t buf[64];
+  while (::read(read_fd_, buf, sizeof(buf)) > 0) {
+  }
+}
+
+}  // namespace xiaozi
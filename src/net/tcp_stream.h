@@ -0,0 +1,80 @@
+#ifndef XIAOZI_NET_TCP_STREAM_H_
+#define XIAOZI_NET_TCP_STREAM_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "net/stream.h"
+
+namespace xiaozi {
+
+// Resolves `host` and connects with a blocking connect bounded by
+// timeout_ms, then switches the socket to non-blocking with TCP_NODELAY.
+// Returns the fd or -1.
+int tcp_connect(const std::string& host, int port, int timeout_ms);
+
+// TCP keepalive: the first probe after idle_s seconds without traffic,
+// then one every interval_s, and the connection fails after `probes`
+// unanswered. The kernel sends them, so holding an idle connection open
+// costs the process no wakeups. False if the socket refuses an option.
+bool set_keepalive(int fd, int idle_s, int interval_s, int probes);
+
+struct TcpLinkInfo {
+  uint32_t rtt_us;  // smoothed round-trip time
+  uint32_t rtt_var_us;
+  uint32_t retransmits;  // segments retransmitted since connect
+  // Data segments sent since connect, retransmits included; 0 before
+  // Linux 4.6.
+  uint32_t segments_sent;
+};
+
+// The kernel's view of a connected TCP socket (TCP_INFO); nullopt if the
+// socket is not TCP.
+std::optional<TcpLinkInfo> read_tcp_info(int fd);
+
+// Non-blocking UDP socket connected to the first address of `host` that
+// accepts one. Returns the fd or -1.
+int udp_connect(const std::string& host, int port);
+
+class TcpStream : public Stream {
+ public:
+  // Takes ownership of a connected socket.
+  explicit TcpStream(int fd) : fd_(fd) {}
+  ~TcpStream() override { close(); }
+
+  static std::unique_ptr<TcpStream> connect(const std::string& host, int port,
+                                            int timeout_ms);
+
+  ssize_t read(std::span<uint8_t> buf) override;
+  ssize_t writev(const struct iovec* iov, int count) override;
+  int fd() const override { return fd_; }
+  void close() override;
+
+ private:
+  int fd_;
+};
+
+// Self-pipe used to interrupt a poll() from another thread. notify() is
+// async-signal-safe and never blocks; repeated notifies before the next
+// drain() collapse into one wakeup.
+class Waker {
+ public:
+  Waker();
+  ~Waker();
+  Waker(const Waker&) = delete;
+  Waker& operator=(const Waker&) = delete;
+
+  int fd() const { return read_fd_; }
+  void notify();
+  void drain();
+
+ private:
+  int read_fd_ = -1;
+  int write_fd_ = -1;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_TCP_STREAM_H_
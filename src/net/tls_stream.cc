@@ -0,0 +1,237 @@
+#include "net/tls_stream.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "net/tcp_stream.h"
+
+namespace xiaozi {
+namespace {
+
+// Polls for what OpenSSL asked for after a call returned `rc`; false on a
+// real error or timeout.
+bool wait_for(SSL* ssl, int fd, int rc, int timeout_ms) {
+  const int err = SSL_get_error(ssl, rc);
+  short events;
+  if (err == SSL_ERROR_WANT_READ) {
+    events = POLLIN;
+  } else if (err == SSL_ERROR_WANT_WRITE) {
+    events = POLLOUT;
+  } else {
+    return false;
+  }
+  pollfd pfd{fd, events, 0};
+  return ::poll(&pfd, 1, timeout_ms) == 1;
+}
+
+// Runs the handshake on the non-blocking socket, polling as OpenSSL asks.
+bool handshake(SSL* ssl, int fd, int timeout_ms) {
+  for (;;) {
+    const int rc = SSL_connect(ssl);
+    if (rc == 1) return true;
+    if (!wait_for(ssl, fd, rc, timeout_ms)) return false;
+  }
+}
+
+// Queues `data` in the resumed ClientHello's flight, ahead of the
+// handshake finishing.
+bool write_early_data(SSL* ssl, int fd, std::string_view data,
+                      int timeout_ms) {
+  while (!data.empty()) {
+    std::size_t written = 0;
+    const int rc =
+        SSL_write_early_data(ssl, data.data(), data.size(), &written);
+    if (rc == 1) {
+      data.remove_prefix(written);
+    } else if (!wait_for(ssl, fd, rc, timeout_ms)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SSL_CTX* new_client_ctx(bool verify_peer) {
+  SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+  if (ctx == nullptr) return nullptr;
+  SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+  if (verify_peer) {
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+    SSL_CTX_set_default_verify_paths(ctx);
+  }
+  return ctx;
+}
+
+ssize_t map_error(SSL* ssl, int rc) {
+  switch (SSL_get_error(ssl, rc)) {
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+      errno = EAGAIN;
+      return -1;
+    case SSL_ERROR_ZERO_RETURN:
+      return 0;
+    default:
+      ERR_clear_error();
+      errno = EIO;
+      return -1;
+  }
+}
+
+}  // namespace
+
+TlsSessionCache::~TlsSessionCache() {
+  clear();
+  if (ctx_ != nullptr) {
+    // Streams may outlive the cache; their tickets are dropped from now on.
+    SSL_CTX_set_app_data(ctx_, nullptr);
+    SSL_CTX_free(ctx_);
+  }
+}
+
+uint32_t TlsSessionCache::max_early_data() const {
+  return session_ == nullptr ? 0 : SSL_SESSION_get_max_early_data(session_);
+}
+
+void TlsSessionCache::clear() {
+  if (session_ != nullptr) {
+    SSL_SESSION_free(session_);
+    session_ = nullptr;
+  }
+}
+
+int TlsSessionCache::on_new_session(SSL* ssl, SSL_SESSION* session) {
+  auto* cache =
+      static_cast<TlsSessionCache*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  if (cache == nullptr) return 0;
+  cache->clear();
+  cache->session_ = session;
+  return 1;  // the reference is ours now
+}
+
+std::unique_ptr<TlsStream> TlsStream::connect(const std::string& host,
+                                              int port,
+                                              const Options& options) {
+  int fd = tcp_connect(host, port, options.timeout_ms);
+  if (fd < 0) return nullptr;
+
+  TlsSessionCache* cache = options.session_cache;
+  SSL_CTX* ctx;
+  if (cache != nullptr && cache->ctx_ != nullptr) {
+    ctx = cache->ctx_;
+    SSL_CTX_up_ref(ctx);
+  } else {
+    ctx = new_client_ctx(options.verify_peer);
+    if (ctx == nullptr) {
+      ::close(fd);
+      return nullptr;
+    }
+    if (cache != nullptr) {
+      SSL_CTX_set_session_cache_mode(
+          ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_sess_set_new_cb(ctx, &TlsSessionCache::on_new_session);
+      SSL_CTX_set_app_data(ctx, cache);
+      SSL_CTX_up_ref(ctx);
+      cache->ctx_ = ctx;
+    }
+  }
+  SSL* ssl = SSL_new(ctx);
+  SSL_set_fd(ssl, fd);
+  SSL_set_tlsext_host_name(ssl, host.c_str());
+  if (options.verify_peer) SSL_set1_host(ssl, host.c_str());
+  if (cache != nullptr && cache->session_ != nullptr) {
+    SSL_set_session(ssl, cache->session_);
+  }
+  // flush() compacts the staging buffer between retries.
+  SSL_set_mode(ssl, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                        SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+  auto stream = std::unique_ptr<TlsStream>(new TlsStream(ctx, ssl, fd));
+  const bool early = !options.early_data.empty() && cache != nullptr &&
+                     options.early_data.size() <= cache->max_early_data();
+  if (early &&
+      !write_early_data(ssl, fd, options.early_data, options.timeout_ms)) {
+    cache->clear();
+    return nullptr;
+  }
+  if (!handshake(ssl, fd, options.timeout_ms)) {
+    // Next attempt starts from a full handshake.
+    if (cache != nullptr) cache->clear();
+    return nullptr;
+  }
+  stream->early_data_accepted_ =
+      early && SSL_get_early_data_status(ssl) == SSL_EARLY_DATA_ACCEPTED;
+  return stream;
+}
+
+TlsStream::~TlsStream() { close(); }
+
+bool TlsStream::resumed() const {
+  return ssl_ != nullptr && SSL_session_reused(ssl_) == 1;
+}
+
+ssize_t TlsStream::read(std::span<uint8_t> buf) {
+  int rc = SSL_read(ssl_, buf.data(), static_cast<int>(buf.size()));
+  return rc > 0 ? rc : map_error(ssl_, rc);
+}
+
+ssize_t TlsStream::writev(const struct iovec* iov, int count) {
+  if (staged_ != 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+  std::size_t total = 0;
+  for (int i = 0; i < count; ++i) {
+    std::size_t take = std::min(iov[i].iov_len, kStagingBytes - total);
+    std::memcpy(staging_->data() + total, iov[i].iov_base, take);
+    total += take;
+    if (take < iov[i].iov_len) break;
+  }
+  staged_ = total;
+  ssize_t rc = flush();
+  if (rc < 0 && errno != EAGAIN) return -1;
+  return static_cast<ssize_t>(total);
+}
+
+ssize_t TlsStream::flush() {
+  std::size_t done = 0;
+  while (staged_ > done) {
+    // With partial writes enabled SSL_write may take part of the buffer;
+    // on WANT_WRITE the remaining bytes are retried on the next flush().
+    int rc = SSL_write(ssl_, staging_->data() + done,
+                       static_cast<int>(staged_ - done));
+    if (rc <= 0) {
+      std::memmove(staging_->data(), staging_->data() + done, staged_ - done);
+      staged_ -= done;
+      return map_error(ssl_, rc);
+    }
+    done += static_cast<std::size_t>(rc);
+  }
+  staged_ = 0;
+  return static_cast<ssize_t>(done);
+}
+
+bool TlsStream::has_buffered_input() const { return SSL_pending(ssl_) > 0; }
+
+void TlsStream::close() {
+  if (ssl_ != nullptr) {
+    SSL_shutdown(ssl_);
+    SSL_free(ssl_);
+    ssl_ = nullptr;
+  }
+  if (ctx_ != nullptr) {
+    SSL_CTX_free(ctx_);
+    ctx_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+}  // namespace xiaozi
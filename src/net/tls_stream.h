@@ -0,0 +1,102 @@
+#ifndef XIAOZI_NET_TLS_STREAM_H_
+#define XIAOZI_NET_TLS_STREAM_H_
+
+// Only built with OpenSSL (XIAOZI_HAVE_OPENSSL).
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "net/stream.h"
+
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+typedef struct ssl_session_st SSL_SESSION;
+
+namespace xiaozi {
+
+// Client context plus the newest session ticket from one server, kept
+// across reconnects so the next handshake resumes instead of repeating the
+// full exchange and certificate check, and may carry 0-RTT data. Every
+// connect through one cache must use the same host and Options. Owned by
+// the connection's thread.
+class TlsSessionCache {
+ public:
+  TlsSessionCache() = default;
+  ~TlsSessionCache();
+  TlsSessionCache(const TlsSessionCache&) = delete;
+  TlsSessionCache& operator=(const TlsSessionCache&) = delete;
+
+  bool has_session() const { return session_ != nullptr; }
+  // Early data bytes the cached ticket allows; 0 without one.
+  uint32_t max_early_data() const;
+  void clear();
+
+ private:
+  friend class TlsStream;
+  // OpenSSL new-session callback; TLS 1.3 tickets arrive after the
+  // handshake, during a later read.
+  static int on_new_session(SSL* ssl, SSL_SESSION* session);
+
+  SSL_CTX* ctx_ = nullptr;
+  SSL_SESSION* session_ = nullptr;
+};
+
+class TlsStream : public Stream {
+ public:
+  // Largest plaintext a single writev() accepts; the TLS layer cuts it into
+  // as few 16 KiB records as possible.
+  static constexpr std::size_t kStagingBytes = 32 * 1024;
+
+  struct Options {
+    bool verify_peer = true;
+    int timeout_ms = 5000;
+    // Resumes from, and stores new tickets in, this cache when set.
+    TlsSessionCache* session_cache = nullptr;
+    // Sent as TLS 1.3 early data when resuming with a ticket that allows
+    // this much; must be safe for the server to see twice (replay).
+    std::string_view early_data;
+  };
+
+  // TCP connect plus a blocking TLS handshake (SNI and hostname checked
+  // when verify_peer); the stream is non-blocking afterwards.
+  static std::unique_ptr<TlsStream> connect(const std::string& host, int port,
+                                            const Options& options);
+  ~TlsStream() override;
+
+  // The handshake resumed a cached session.
+  bool resumed() const;
+  // Options::early_data went out and the server accepted it. Otherwise the
+  // caller still has to write it.
+  bool early_data_accepted() const { return early_data_accepted_; }
+
+  ssize_t read(std::span<uint8_t> buf) override;
+  // Copies the gathered pieces into one staging buffer and hands that to
+  // SSL_write in one go, so a coalesced batch becomes one TLS record
+  // instead of one per WebSocket frame. Returns -1/EAGAIN while a previous
+  // batch is still staged.
+  ssize_t writev(const struct iovec* iov, int count) override;
+  bool wants_write() const override { return staged_ != 0; }
+  ssize_t flush() override;
+  bool has_buffered_input() const override;
+
+  int fd() const override { return fd_; }
+  void close() override;
+
+ private:
+  TlsStream(SSL_CTX* ctx, SSL* ssl, int fd) : ctx_(ctx), ssl_(ssl), fd_(fd) {}
+
+  SSL_CTX* ctx_;
+  SSL* ssl_;
+  int fd_;
+  std::size_t staged_ = 0;
+  bool early_data_accepted_ = false;
+  std::unique_ptr<std::array<uint8_t, kStagingBytes>> staging_ =
+      std::make_unique<std::array<uint8_t, kStagingBytes>>();
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_TLS_STREAM_H_
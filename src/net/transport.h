@@ -0,0 +1,141 @@
+#ifndef XIAOZI_NET_TRANSPORT_H_
+#define XIAOZI_NET_TRANSPORT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+#include "base/trace.h"
+#include "memory/frame_pool.h"
+#include "net/packet_sink.h"
+
+namespace xiaozi {
+
+struct TransportStats {
+  uint64_t packets_sent = 0;
+  uint64_t bytes_sent = 0;
+  // Calls that put bytes on the wire (writev, SSL_write, sendto, ...).
+  uint64_t send_syscalls = 0;
+  uint64_t packets_received = 0;
+  uint64_t bytes_received = 0;
+  // Audio lost on the send side: pool exhausted or queue full.
+  uint64_t packets_dropped = 0;
+  // Audio lost on the receive side: receive pool exhausted.
+  uint64_t packets_rx_dropped = 0;
+  // Audio packets committed but not yet on the wire.
+  uint32_t queue_depth = 0;
+  // Commit -> hand-off to the kernel, over all sent audio packets.
+  uint64_t queue_delay_total_ns = 0;
+  uint64_t queue_delay_max_ns = 0;
+  // Successful open()s, and those that resumed a TLS session or sent the
+  // upgrade request as 0-RTT early data.
+  uint64_t connects = 0;
+  uint64_t resumed_connects = 0;
+  uint64_t early_data_connects = 0;
+  // DNS, TCP, TLS and protocol handshake of the latest open().
+  uint64_t connect_ns = 0;
+  // mark_wake() to the first audio byte handed to the kernel after it.
+  uint64_t first_byte_ns = 0;  // latest wake
+  uint64_t max_first_byte_ns = 0;
+  // Sampled from the kernel's TCP state a few times a second; 0 where the
+  // transport has no TCP connection carrying audio.
+  uint32_t rtt_us = 0;
+  uint32_t retransmits = 0;  // segments, since the latest open()
+  uint32_t segments_sent = 0;  // data segments, since the latest open()
+
+  double packets_per_syscall() const {
+    return send_syscalls == 0 ? 0.0
+                              : static_cast<double>(packets_sent) /
+                                    static_cast<double>(send_syscalls);
+  }
+  double mean_queue_delay_us() const {
+    return packets_sent == 0 ? 0.0
+                             : static_cast<double>(queue_delay_total_ns) /
+                                   static_cast<double>(packets_sent) / 1000.0;
+  }
+};
+
+// Device <-> server channel: audio packets in both directions plus JSON
+// control messages. Outgoing audio uses the PacketSink interface, so the
+// encoder writes into the transport's own buffers.
+//
+// Threading: reserve()/commit() come from one producer thread (the codec);
+// send_text() from any thread; open(), close() and poll() from the
+// transport's thread, which is also where the handlers run.
+class Transport : public PacketSink {
+ public:
+  // `packet` holds one received audio packet; keep the reference as long as
+  // needed, it costs no copy.
+  using AudioHandler = std::function<void(FrameRef packet)>;
+  // `message` is only valid during the call.
+  using TextHandler = std::function<void(std::string_view message)>;
+  using CloseHandler = std::function<void()>;
+
+  ~Transport() override = default;
+
+  virtual bool open() = 0;
+  virtual void close() = 0;
+  virtual bool is_open() const = 0;
+
+  // Queues one control message. Control messages do not wait for the audio
+  // latency budget; they leave on the next poll() together with whatever
+  // audio is already queued.
+  virtual bool send_text(std::string_view message) = 0;
+
+  // Runs I/O for at most timeout_ms: sends batches that are due, reads and
+  // dispatches incoming messages.
+  virtual void poll(int timeout_ms) = 0;
+
+  virtual TransportStats stats() const = 0;
+
+  // Records that the wake word fired at `wake_ns` (monotonic_ns() time
+  // base). The next audio sent reports the wake-to-first-byte latency in
+  // stats() and the first_byte trace stage, and does not wait out any
+  // batching delay. Any thread.
+  void mark_wake(uint64_t wake_ns) {
+    wake_ns_.store(wake_ns, std::memory_order_relaxed);
+  }
+
+  void set_audio_handler(AudioHandler handler) {
+    on_audio_ = std::move(handler);
+  }
+  void set_text_handler(TextHandler handler) { on_text_ = std::move(handler); }
+  void set_close_handler(CloseHandler handler) {
+    on_close_ = std::move(handler);
+  }
+
+ protected:
+  bool wake_pending() const {
+    return wake_ns_.load(std::memory_order_relaxed) != 0;
+  }
+  // Send path, once audio bytes are with the kernel.
+  void note_audio_sent(uint64_t now_ns) {
+    if (!wake_pending()) return;
+    const uint64_t wake = wake_ns_.exchange(0, std::memory_order_relaxed);
+    if (wake == 0) return;
+    const uint64_t latency = now_ns > wake ? now_ns - wake : 0;
+    first_byte_ns_.store(latency, std::memory_order_relaxed);
+    if (latency > max_first_byte_ns_.load(std::memory_order_relaxed)) {
+      max_first_byte_ns_.store(latency, std::memory_order_relaxed);
+    }
+    XIAOZI_TRACE_RECORD(kFirstByte, latency);
+  }
+  void fill_wake_stats(TransportStats& s) const {
+    s.first_byte_ns = first_byte_ns_.load(std::memory_order_relaxed);
+    s.max_first_byte_ns = max_first_byte_ns_.load(std::memory_order_relaxed);
+  }
+
+  AudioHandler on_audio_;
+  TextHandler on_text_;
+  CloseHandler on_close_;
+
+ private:
+  std::atomic<uint64_t> wake_ns_{0};
+  std::atomic<uint64_t> first_byte_ns_{0};
+  std::atomic<uint64_t> max_first_byte_ns_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_TRANSPORT_H_
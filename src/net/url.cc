@@ -0,0 +1,66 @@
+#include "net/url.h"
+
+#include <cctype>
+#include <charconv>
+
+namespace xiaozi {
+namespace {
+
+int default_port(const std::string& scheme) {
+  if (scheme == "ws" || scheme == "http") return 80;
+  if (scheme == "wss" || scheme == "https") return 443;
+  if (scheme == "mqtt") return 1883;
+  if (scheme == "mqtts") return 8883;
+  return 0;
+}
+
+}  // namespace
+
+std::optional<Url> parse_url(std::string_view text) {
+  Url url;
+  auto sep = text.find("://");
+  if (sep == std::string_view::npos || sep == 0) return std::nullopt;
+  for (unsigned char c : text.substr(0, sep)) {
+    url.scheme += static_cast<char>(std::tolower(c));
+  }
+  text.remove_prefix(sep + 3);
+
+  auto path_start = text.find('/');
+  std::string_view authority = text.substr(0, path_start);
+  url.path = path_start == std::string_view::npos
+                 ? "/"
+                 : std::string(text.substr(path_start));
+
+  std::string_view port_text;
+  if (!authority.empty() && authority.front() == '[') {
+    auto close = authority.find(']');
+    if (close == std::string_view::npos) return std::nullopt;
+    url.host = std::string(authority.substr(1, close - 1));
+    std::string_view rest = authority.substr(close + 1);
+    if (!rest.empty()) {
+      if (rest.front() != ':') return std::nullopt;
+      port_text = rest.substr(1);
+    }
+  } else {
+    auto colon = authority.rfind(':');
+    url.host = std::string(authority.substr(0, colon));
+    if (colon != std::string_view::npos) {
+      port_text = authority.substr(colon + 1);
+    }
+  }
+  if (url.host.empty()) return std::nullopt;
+
+  url.port = default_port(url.scheme);
+  if (!port_text.empty()) {
+    auto [end, ec] = std::from_chars(
+        port_text.data(), port_text.data() + port_text.size(), url.port);
+    if (ec != std::errc() || end != port_text.data() + port_text.size() ||
+        url.port <= 0 || url.port > 65535) {
+      return std::nullopt;
+    }
+  }
+  if (url.port == 0) return std::nullopt;
+  return url;
+}
+
+}  // namespace xiaozi
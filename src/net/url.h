@@ -0,0 +1,26 @@
+#ifndef XIAOZI_NET_URL_H_
+#define XIAOZI_NET_URL_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace xiaozi {
+
+struct Url {
+  std::string scheme;  // lower case: "ws", "wss", "mqtt", "mqtts", ...
+  std::string host;
+  int port = 0;        // scheme default when the URL has none
+  std::string path;    // includes the query; "/" if empty
+
+  bool secure() const {
+    return scheme == "wss" || scheme == "mqtts" || scheme == "https";
+  }
+};
+
+// scheme://host[:port][/path]; IPv6 literals in brackets. No userinfo.
+std::optional<Url> parse_url(std::string_view text);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_URL_H_
@@ -0,0 +1,62 @@
+#include "net/warm_connection.h"
+
+#include <algorithm>
+
+#include "base/clock.h"
+
+namespace xiaozi {
+namespace {
+
+uint64_t to_ns(std::chrono::milliseconds ms) {
+  return static_cast<uint64_t>(std::chrono::nanoseconds(ms).count());
+}
+
+}  // namespace
+
+WarmConnection::WarmConnection(Transport& transport, Config config)
+    : transport_(transport),
+      config_(config),
+      backoff_ns_(to_ns(config.min_backoff)) {}
+
+void WarmConnection::poll(int timeout_ms) {
+  if (!transport_.is_open()) {
+    const uint64_t now = monotonic_ns();
+    if (now < next_attempt_ns_ || !connect(now)) {
+      const uint64_t wait_ms = (next_attempt_ns_ - now) / 1000000;
+      timeout_ms = static_cast<int>(
+          std::min<uint64_t>(static_cast<uint64_t>(timeout_ms), wait_ms));
+    }
+  }
+  transport_.poll(timeout_ms);
+}
+
+bool WarmConnection::wake(uint64_t wake_ns) {
+  transport_.mark_wake(wake_ns);
+  if (transport_.is_open()) {
+    warm_wakes_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  cold_wakes_.fetch_add(1, std::memory_order_relaxed);
+  return connect(monotonic_ns());
+}
+
+bool WarmConnection::connect(uint64_t now_ns) {
+  if (transport_.open()) {
+    connects_.fetch_add(1, std::memory_order_relaxed);
+    backoff_ns_ = to_ns(config_.min_backoff);
+    return true;
+  }
+  failures_.fetch_add(1, std::memory_order_relaxed);
+  next_attempt_ns_ = now_ns + backoff_ns_;
+  backoff_ns_ = std::min(backoff_ns_ * 2, to_ns(config_.max_backoff));
+  return false;
+}
+
+WarmConnection::Stats WarmConnection::stats() const {
+  return {connects_.load(std::memory_order_relaxed),
+          failures_.load(std::memory_order_relaxed),
+          warm_wakes_.load(std::memory_order_relaxed),
+          cold_wakes_.load(std::memory_order_relaxed)};
+}
+
+}  // namespace xiaozi
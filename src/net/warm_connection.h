@@ -0,0 +1,64 @@
+#ifndef XIAOZI_NET_WARM_CONNECTION_H_
+#define XIAOZI_NET_WARM_CONNECTION_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "net/transport.h"
+
+namespace xiaozi {
+
+// Holds a Transport open between wakes, so the wake word only has to
+// start sending instead of paying DNS, TCP, TLS and the hello first.
+//
+// poll() stands in for Transport::poll() on the transport thread and
+// reconnects after a drop. Failed attempts back off exponentially from
+// min_backoff to max_backoff, so an unreachable server does not keep the
+// radio awake. While connected the transport's own keepalive holds the
+// link; nothing here wakes up.
+class WarmConnection {
+ public:
+  struct Config {
+    std::chrono::milliseconds min_backoff{500};
+    std::chrono::milliseconds max_backoff{60000};
+  };
+
+  struct Stats {
+    uint64_t connects;
+    uint64_t failures;
+    uint64_t warm_wakes;  // connection already up
+    uint64_t cold_wakes;  // had to connect first
+  };
+
+  WarmConnection(Transport& transport, Config config);
+  explicit WarmConnection(Transport& transport)
+      : WarmConnection(transport, Config{}) {}
+
+  // Transport thread.
+  void poll(int timeout_ms);
+  // Transport thread, as soon as the wake word fires (`wake_ns` in the
+  // monotonic_ns() time base). Connects at once if the link is down,
+  // ignoring the backoff. False if there is still no connection.
+  bool wake(uint64_t wake_ns);
+
+  // Any thread.
+  Stats stats() const;
+
+ private:
+  bool connect(uint64_t now_ns);
+
+  Transport& transport_;
+  Config config_;
+  uint64_t next_attempt_ns_ = 0;
+  uint64_t backoff_ns_;
+
+  std::atomic<uint64_t> connects_{0};
+  std::atomic<uint64_t> failures_{0};
+  std::atomic<uint64_t> warm_wakes_{0};
+  std::atomic<uint64_t> cold_wakes_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_WARM_CONNECTION_H_
@@ -0,0 +1,85 @@
+#include "net/websocket_frame.h"
+
+#include <cstring>
+
+namespace xiaozi::ws {
+
+std::size_t encode_header(uint8_t* out, Opcode opcode, std::size_t payload_len,
+                          bool masked, uint32_t mask_key) {
+  std::size_t n = 0;
+  out[n++] = static_cast<uint8_t>(0x80 | opcode);
+  const uint8_t mask_bit = masked ? 0x80 : 0x00;
+  if (payload_len <= 125) {
+    out[n++] = static_cast<uint8_t>(mask_bit | payload_len);
+  } else if (payload_len <= 0xffff) {
+    out[n++] = mask_bit | 126;
+    out[n++] = static_cast<uint8_t>(payload_len >> 8);
+    out[n++] = static_cast<uint8_t>(payload_len);
+  } else {
+    out[n++] = mask_bit | 127;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      out[n++] = static_cast<uint8_t>(static_cast<uint64_t>(payload_len) >>
+                                      shift);
+    }
+  }
+  if (masked) {
+    // Key bytes go on the wire in the order they are applied.
+    out[n++] = static_cast<uint8_t>(mask_key >> 24);
+    out[n++] = static_cast<uint8_t>(mask_key >> 16);
+    out[n++] = static_cast<uint8_t>(mask_key >> 8);
+    out[n++] = static_cast<uint8_t>(mask_key);
+  }
+  return n;
+}
+
+std::optional<FrameHeader> parse_header(std::span<const uint8_t> data) {
+  if (data.size() < 2) return std::nullopt;
+  FrameHeader h{};
+  h.fin = (data[0] & 0x80) != 0;
+  h.opcode = static_cast<Opcode>(data[0] & 0x0f);
+  h.masked = (data[1] & 0x80) != 0;
+  uint64_t len = data[1] & 0x7f;
+  std::size_t n = 2;
+  if (len == 126) {
+    if (data.size() < 4) return std::nullopt;
+    len = (uint64_t{data[2]} << 8) | data[3];
+    n = 4;
+  } else if (len == 127) {
+    if (data.size() < 10) return std::nullopt;
+    len = 0;
+    for (int i = 0; i < 8; ++i) len = (len << 8) | data[2 + i];
+    n = 10;
+  }
+  if (h.masked) {
+    if (data.size() < n + 4) return std::nullopt;
+    h.mask_key = (uint32_t{data[n]} << 24) | (uint32_t{data[n + 1]} << 16) |
+                 (uint32_t{data[n + 2]} << 8) | data[n + 3];
+    n += 4;
+  }
+  h.header_len = n;
+  h.payload_len = len;
+  return h;
+}
+
+void apply_mask(std::span<uint8_t> payload, uint32_t mask_key,
+                std::size_t offset) {
+  uint8_t key[4] = {
+      static_cast<uint8_t>(mask_key >> 24), static_cast<uint8_t>(mask_key >> 16),
+      static_cast<uint8_t>(mask_key >> 8), static_cast<uint8_t>(mask_key)};
+  std::size_t i = 0;
+  // Align to the key phase, then XOR whole words.
+  for (; i < payload.size() && (offset + i) % 4 != 0; ++i) {
+    payload[i] ^= key[(offset + i) % 4];
+  }
+  uint32_t word_key;
+  std::memcpy(&word_key, key, 4);
+  for (; i + 4 <= payload.size(); i += 4) {
+    uint32_t w;
+    std::memcpy(&w, payload.data() + i, 4);
+    w ^= word_key;
+    std::memcpy(payload.data() + i, &w, 4);
+  }
+  for (; i < payload.size(); ++i) payload[i] ^= key[(offset + i) % 4];
+}
+
+}  // namespace xiaozi::ws
@@ -0,0 +1,51 @@
+#ifndef XIAOZI_NET_WEBSOCKET_FRAME_H_
+#define XIAOZI_NET_WEBSOCKET_FRAME_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+namespace xiaozi::ws {
+
+// RFC 6455 framing, shared by the device transport (client: masks) and the
+// gateway (server: does not).
+
+enum Opcode : uint8_t {
+  kContinuation = 0x0,
+  kText = 0x1,
+  kBinary = 0x2,
+  kClose = 0x8,
+  kPing = 0x9,
+  kPong = 0xa,
+};
+
+// 2 bytes + 8 bytes extended length + 4 bytes mask key.
+inline constexpr std::size_t kMaxHeaderBytes = 14;
+
+// Writes a FIN frame header for `payload_len` bytes; `mask_key` is only
+// emitted when `masked`. Returns the header length.
+std::size_t encode_header(uint8_t* out, Opcode opcode, std::size_t payload_len,
+                          bool masked, uint32_t mask_key);
+
+struct FrameHeader {
+  bool fin;
+  Opcode opcode;
+  bool masked;
+  uint32_t mask_key;
+  std::size_t header_len;
+  uint64_t payload_len;
+};
+
+// Parses the header at the front of `data`; nullopt until enough bytes for
+// the whole header have arrived.
+std::optional<FrameHeader> parse_header(std::span<const uint8_t> data);
+
+// XORs `payload` with the key in place. `offset` is the payload position of
+// payload[0], so a payload may be masked in pieces.
+void apply_mask(std::span<uint8_t> payload, uint32_t mask_key,
+                std::size_t offset = 0);
+
+}  // namespace xiaozi::ws
+
+#endif  // XIAOZI_NET_WEBSOCKET_FRAME_H_
@@ -0,0 +1,723 @@
+#include "net/websocket_transport.h"
+
+#include <poll.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <random>
+
+#include "base/base64.h"
+#include "base/clock.h"
+#include "base/sha1.h"
+#include "base/trace.h"
+#include "net/url.h"
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+#include "net/tls_stream.h"
+#endif
+
+namespace xiaozi {
+namespace {
+
+constexpr char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+// Linux UIO_MAXIOV.
+constexpr std::size_t kMaxIov = 1024;
+// Reads per poll() before giving the send side a turn.
+constexpr int kMaxReadsPerPoll = 4;
+// How often poll() samples TCP_INFO for stats().
+constexpr uint64_t kTcpInfoIntervalNs = 250000000;
+
+uint32_t next_mask_key(uint32_t& state) {
+  // xorshift32: masking only has to be unpredictable to intermediaries
+  // (RFC 6455 section 10.3), not cryptographically strong.
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+uint32_t random_seed() {
+  std::random_device rd;
+  uint32_t seed = rd();
+  return seed == 0 ? 0x9e3779b9u : seed;
+}
+
+int remaining_ms(uint64_t deadline_ns) {
+  uint64_t now = monotonic_ns();
+  return now >= deadline_ns ? 0
+                            : static_cast<int>((deadline_ns - now) / 1000000);
+}
+
+bool wait_fd(int fd, short events, uint64_t deadline_ns) {
+  pollfd pfd{fd, events, 0};
+  int rc;
+  do {
+    rc = ::poll(&pfd, 1, remaining_ms(deadline_ns));
+  } while (rc < 0 && errno == EINTR);
+  return rc == 1;
+}
+
+bool write_all(Stream& stream, std::string_view data, uint64_t deadline_ns) {
+  while (!data.empty() || stream.wants_write()) {
+    ssize_t n;
+    if (stream.wants_write()) {
+      n = stream.flush();
+      if (n >= 0) continue;
+    } else {
+      iovec iov{const_cast<char*>(data.data()), data.size()};
+      n = stream.writev(&iov, 1);
+      if (n >= 0) {
+        data.remove_prefix(static_cast<std::size_t>(n));
+        continue;
+      }
+    }
+    if (errno != EAGAIN || !wait_fd(stream.fd(), POLLOUT, deadline_ns)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool iequals_prefix(std::string_view line, std::string_view name) {
+  if (line.size() < name.size()) return false;
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+}  // namespace
+
+WebSocketTransport::WebSocketTransport(Config config)
+    : config_(std::move(config)),
+      send_pool_(config_.max_packet_bytes, config_.send_pool_blocks,
+                 MemoryDomain::kNetwork),
+      mask_state_(random_seed()),
+      control_mask_state_(random_seed()),
+      receive_pool_(config_.max_message_bytes, config_.receive_pool_blocks,
+                    MemoryDomain::kNetwork),
+      rx_(config_.receive_buffer_bytes) {
+  control_queue_.reserve(8);
+  batch_control_.reserve(8);
+  iov_.reserve(2 * kMaxBatchPackets + 16);
+}
+
+WebSocketTransport::~WebSocketTransport() {
+  close();
+  reserved_.reset();
+}
+
+bool WebSocketTransport::open() {
+  auto url = parse_url(config_.url);
+  if (!url || (url->scheme != "ws" && url->scheme != "wss")) return false;
+  const uint64_t start_ns = monotonic_ns();
+
+  uint8_t nonce[16];
+  std::random_device rd;
+  for (auto& b : nonce) b = static_cast<uint8_t>(rd());
+  const std::string key = base64_encode(nonce);
+
+  std::string request = "GET " + url->path + " HTTP/1.1\r\nHost: " + url->host;
+  if (url->port != 80 && url->port != 443) {
+    request += ":" + std::to_string(url->port);
+  }
+  request +=
+      "\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+      "Sec-WebSocket-Version: 13\r\nSec-WebSocket-Key: " +
+      key + "\r\n";
+  for (const auto& [name, value] : config_.headers) {
+    request += name + ": " + value + "\r\n";
+  }
+  request += "\r\n";
+  std::string hello;
+  if (!config_.hello.empty()) {
+    uint8_t header[ws::kMaxHeaderBytes];
+    uint32_t mask;
+    {
+      std::lock_guard lock(control_mutex_);
+      mask = next_mask_key(control_mask_state_);
+    }
+    const std::size_t n = ws::encode_header(header, ws::kText,
+                                            config_.hello.size(), true, mask);
+    hello.assign(reinterpret_cast<const char*>(header), n);
+    hello += config_.hello;
+    ws::apply_mask(
+        {reinterpret_cast<uint8_t*>(hello.data()) + n, config_.hello.size()},
+        mask);
+  }
+
+  std::unique_ptr<Stream> stream =
+      connect(url->host, url->port, url->secure(), request);
+  if (stream == nullptr) return false;
+  if (config_.keepalive_idle.count() > 0) {
+    set_keepalive(stream->fd(),
+                  static_cast<int>(config_.keepalive_idle.count()),
+                  static_cast<int>(config_.keepalive_interval.count()),
+                  config_.keepalive_probes);
+  }
+
+  stream_ = std::move(stream);
+  rx_len_ = 0;
+  if (!handshake(key, early_data_ ? std::string_view() : request)) {
+    teardown();
+    return false;
+  }
+  // Frames may only follow the server's 101 (RFC 6455 4.1).
+  if (!hello.empty() &&
+      !write_all(*stream_, hello,
+                 monotonic_ns() +
+                     uint64_t{1000000} * config_.connect_timeout_ms)) {
+    teardown();
+    return false;
+  }
+  last_send_ns_ = monotonic_ns();
+  connects_.fetch_add(1, std::memory_order_relaxed);
+  if (resumed_) resumed_connects_.fetch_add(1, std::memory_order_relaxed);
+  if (early_data_) {
+    early_data_connects_.fetch_add(1, std::memory_order_relaxed);
+  }
+  connect_ns_.store(last_send_ns_ - start_ns, std::memory_order_relaxed);
+  rtt_us_.store(0, std::memory_order_relaxed);
+  retransmits_.store(0, std::memory_order_relaxed);
+  segments_sent_.store(0, std::memory_order_relaxed);
+  last_tcp_info_ns_ = 0;
+  open_.store(true, std::memory_order_release);
+  // Frames that came in the same read as the 101 would otherwise wait for
+  // the next one, which may never come.
+  if (rx_len_ != 0) dispatch_frames();
+  return stream_ != nullptr;
+}
+
+std::unique_ptr<Stream> WebSocketTransport::connect(
+    const std::string& host, int port, bool secure,
+    const std::string& request) {
+  resumed_ = early_data_ = false;
+  if (!secure) {
+    return TcpStream::connect(host, port, config_.connect_timeout_ms);
+  }
+#if defined(XIAOZI_HAVE_OPENSSL)
+  TlsStream::Options options;
+  options.verify_peer = config_.verify_peer;
+  options.timeout_ms = config_.connect_timeout_ms;
+  if (config_.tls_resumption) {
+    options.session_cache = &tls_cache_;
+    // Never credentials in a replayable flight.
+    if (config_.early_data && config_.headers.empty()) {
+      options.early_data = request;
+    }
+  }
+  auto stream = TlsStream::connect(host, port, options);
+  if (stream != nullptr) {
+    resumed_ = stream->resumed();
+    early_data_ = stream->early_data_accepted();
+  }
+  return stream;
+#else
+  (void)request;
+  return nullptr;
+#endif
+}
+
+void WebSocketTransport::attach(std::unique_ptr<Stream> stream) {
+  teardown();
+  stream_ = std::move(stream);
+  rx_len_ = 0;
+  last_send_ns_ = monotonic_ns();
+  open_.store(stream_ != nullptr, std::memory_order_release);
+}
+
+bool WebSocketTransport::handshake(const std::string& key,
+                                   std::string_view request) {
+  const uint64_t deadline =
+      monotonic_ns() + uint64_t{1000000} * config_.connect_timeout_ms;
+  if (!request.empty() && !write_all(*stream_, request, deadline)) {
+    return false;
+  }
+
+  std::size_t header_end = std::string_view::npos;
+  while (header_end == std::string_view::npos) {
+    if (rx_len_ == rx_.size()) return false;
+    ssize_t n = stream_->read({rx_.data() + rx_len_, rx_.size() - rx_len_});
+    if (n == 0) return false;
+    if (n < 0) {
+      if (errno != EAGAIN) return false;
+      if (!stream_->has_buffered_input() &&
+          !wait_fd(stream_->fd(), POLLIN, deadline)) {
+        return false;
+      }
+      continue;
+    }
+    rx_len_ += static_cast<std::size_t>(n);
+    std::string_view seen(reinterpret_cast<const char*>(rx_.data()), rx_len_);
+    header_end = seen.find("\r\n\r\n");
+  }
+
+  std::string_view response(reinterpret_cast<const char*>(rx_.data()),
+                            header_end);
+  if (response.substr(0, 12) != "HTTP/1.1 101") return false;
+
+  std::string expected_input = key + kAcceptGuid;
+  const std::string expected = base64_encode(Sha1::of(
+      {reinterpret_cast<const uint8_t*>(expected_input.data()),
+       expected_input.size()}));
+  bool accepted = false;
+  while (!response.empty()) {
+    auto eol = response.find("\r\n");
+    std::string_view line = response.substr(0, eol);
+    response = eol == std::string_view::npos ? std::string_view()
+                                             : response.substr(eol + 2);
+    constexpr std::string_view kAccept = "sec-websocket-accept:";
+    if (iequals_prefix(line, kAccept)) {
+      accepted = trim(line.substr(kAccept.size())) == expected;
+    }
+  }
+  if (!accepted) return false;
+
+  // The server may start sending right behind its 101 response.
+  const std::size_t consumed = header_end + 4;
+  std::memmove(rx_.data(), rx_.data() + consumed, rx_len_ - consumed);
+  rx_len_ -= consumed;
+  return true;
+}
+
+void WebSocketTransport::close() {
+  if (stream_ == nullptr) return;
+  // Best-effort close frame (status 1000); the peer may already be gone.
+  uint8_t frame[ws::kMaxHeaderBytes + 2];
+  uint32_t key;
+  {
+    std::lock_guard lock(control_mutex_);
+    key = next_mask_key(control_mask_state_);
+  }
+  std::size_t n = ws::encode_header(frame, ws::kClose, 2, true, key);
+  frame[n] = 0x03;
+  frame[n + 1] = 0xe8;
+  ws::apply_mask({frame + n, 2}, key);
+  iovec iov{frame, n + 2};
+  stream_->writev(&iov, 1);
+  teardown();
+}
+
+void WebSocketTransport::teardown() {
+  open_.store(false, std::memory_order_release);
+  if (stream_ != nullptr) {
+    stream_->close();
+    stream_.reset();
+  }
+  for (std::size_t i = 0; i < batch_count_; ++i) batch_[i].frame.reset();
+  batch_count_ = 0;
+  batch_control_.clear();
+  iov_.clear();
+  writing_ = false;
+  OutPacket dropped;
+  while (queue_.try_pop(dropped)) {
+    queued_bytes_.fetch_sub(dropped.frame.size(), std::memory_order_relaxed);
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    dropped.frame.reset();
+  }
+  fragment_.clear();
+  fragmenting_ = false;
+}
+
+void WebSocketTransport::fail() {
+  teardown();
+  if (on_close_) on_close_();
+}
+
+std::span<uint8_t> WebSocketTransport::reserve(std::size_t max_bytes) {
+  if (!reserved_) {
+    reserved_ = send_pool_.acquire();
+    if (!reserved_) {
+      packets_dropped_.fetch_add(1, std::memory_order_relaxed);
+      return {};
+    }
+  }
+  return {reserved_.data(), std::min(max_bytes, send_pool_.block_size())};
+}
+
+bool WebSocketTransport::commit(std::size_t bytes, uint64_t capture_ns) {
+  // bytes == 0 keeps the block reserved for the next packet.
+  if (bytes == 0) return true;
+  if (!reserved_) return false;
+
+  OutPacket packet;
+  packet.frame = std::move(reserved_);
+  packet.frame.set_size(bytes);
+  packet.frame.set_timestamp_ns(capture_ns);
+  const uint32_t key = next_mask_key(mask_state_);
+  packet.header_len = static_cast<uint8_t>(
+      ws::encode_header(packet.header.data(), ws::kBinary, bytes, true, key));
+  ws::apply_mask(packet.frame.bytes(), key);
+  packet.enqueue_ns = monotonic_ns();
+
+  // Count first so the transport thread never pops more than it has seen
+  // counted.
+  std::size_t queued_bytes =
+      queued_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  uint32_t depth = queued_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (!queue_.try_push(std::move(packet))) {
+    queued_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    packets_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (depth == 1 || depth == kMaxBatchPackets ||
+      (queued_bytes >= config_.max_batch_bytes &&
+       queued_bytes - bytes < config_.max_batch_bytes)) {
+    waker_.notify();
+  }
+  return true;
+}
+
+void WebSocketTransport::queue_control(ws::Opcode opcode,
+                                       std::string_view payload) {
+  {
+    std::lock_guard lock(control_mutex_);
+    ControlFrame& frame = control_queue_.emplace_back();
+    frame.opcode = opcode;
+    frame.payload.assign(payload);
+    const uint32_t key = next_mask_key(control_mask_state_);
+    frame.header_len = static_cast<uint8_t>(ws::encode_header(
+        frame.header.data(), opcode, payload.size(), true, key));
+    ws::apply_mask({reinterpret_cast<uint8_t*>(frame.payload.data()),
+                    frame.payload.size()},
+                   key);
+    control_pending_.store(true, std::memory_order_release);
+  }
+  waker_.notify();
+}
+
+bool WebSocketTransport::send_text(std::string_view message) {
+  if (!open_.load(std::memory_order_acquire)) return false;
+  queue_control(ws::kText, message);
+  return true;
+}
+
+bool WebSocketTransport::batch_due(uint64_t now) {
+  if (control_pending_.load(std::memory_order_acquire)) return true;
+  // The first audio after a wake owes nothing to batching.
+  if (wake_pending() && queue_.peek() != nullptr) return true;
+  if (queued_.load(std::memory_order_acquire) >= kMaxBatchPackets ||
+      queued_bytes_.load(std::memory_order_relaxed) >=
+          config_.max_batch_bytes) {
+    return true;
+  }
+  const OutPacket* oldest = queue_.peek();
+  if (oldest == nullptr) return false;
+  const auto budget = static_cast<uint64_t>(
+      std::chrono::nanoseconds(config_.latency_budget).count());
+  return now >= oldest->enqueue_ns + budget;
+}
+
+void WebSocketTransport::poll(int timeout_ms) {
+  if (stream_ == nullptr) {
+    pollfd pfd{waker_.fd(), POLLIN, 0};
+    ::poll(&pfd, 1, timeout_ms);
+    waker_.drain();
+    return;
+  }
+
+  uint64_t now = monotonic_ns();
+  int64_t wait_ns = int64_t{timeout_ms} * 1000000;
+  if (!writing_) {
+    if (batch_due(now)) {
+      wait_ns = 0;
+    } else if (const OutPacket* oldest = queue_.peek()) {
+      const auto budget =
+          std::chrono::nanoseconds(config_.latency_budget).count();
+      int64_t until_due =
+          static_cast<int64_t>(oldest->enqueue_ns + budget - now);
+      wait_ns = std::clamp<int64_t>(until_due, 0, wait_ns);
+    }
+  }
+  if (config_.ping_interval.count() > 0 && !writing_) {
+    const auto interval = static_cast<uint64_t>(
+        std::chrono::nanoseconds(config_.ping_interval).count());
+    if (now >= last_send_ns_ + interval) {
+      queue_control(ws::kPing, {});
+      last_send_ns_ = now;
+      wait_ns = 0;
+    } else {
+      wait_ns = std::min<int64_t>(
+          wait_ns, static_cast<int64_t>(last_send_ns_ + interval - now));
+    }
+  }
+  if (stream_->has_buffered_input()) wait_ns = 0;
+
+  pollfd fds[2] = {
+      {stream_->fd(), POLLIN, 0},
+      {waker_.fd(), POLLIN, 0},
+  };
+  if (writing_ || stream_->wants_write()) fds[0].events |= POLLOUT;
+  timespec ts{static_cast<time_t>(wait_ns / 1000000000),
+              static_cast<long>(wait_ns % 1000000000)};
+  int rc = ::ppoll(fds, 2, &ts, nullptr);
+  if (rc < 0 && errno != EINTR) {
+    fail();
+    return;
+  }
+  if (fds[1].revents & POLLIN) waker_.drain();
+
+  if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) ||
+      stream_->has_buffered_input()) {
+    read_input();
+    if (stream_ == nullptr) return;
+  }
+
+  if (writing_ || stream_->wants_write()) write_batch();
+  if (stream_ != nullptr && !writing_ && batch_due(monotonic_ns())) {
+    start_batch();
+    write_batch();
+  }
+  if (stream_ != nullptr && now >= last_tcp_info_ns_ + kTcpInfoIntervalNs) {
+    last_tcp_info_ns_ = now;
+    if (auto info = read_tcp_info(stream_->fd())) {
+      rtt_us_.store(info->rtt_us, std::memory_order_relaxed);
+      retransmits_.store(info->retransmits, std::memory_order_relaxed);
+      segments_sent_.store(info->segments_sent, std::memory_order_relaxed);
+    }
+  }
+}
+
+void WebSocketTransport::start_batch() {
+  batch_count_ = queue_.pop_n(batch_);
+  std::size_t bytes = 0;
+  const uint64_t now = monotonic_ns();
+  uint64_t delay_max = queue_delay_max_ns_.load(std::memory_order_relaxed);
+  uint64_t delay_total = 0;
+  iov_.clear();
+  iov_index_ = 0;
+  for (std::size_t i = 0; i < batch_count_; ++i) {
+    OutPacket& p = batch_[i];
+    bytes += p.frame.size();
+    uint64_t delay = now - p.enqueue_ns;
+    delay_total += delay;
+    delay_max = std::max(delay_max, delay);
+    iov_.push_back({p.header.data(), p.header_len});
+    iov_.push_back({p.frame.data(), p.frame.size()});
+    XIAOZI_TRACE_FRAME(kSend, p.frame);
+  }
+  queued_.fetch_sub(static_cast<uint32_t>(batch_count_),
+                    std::memory_order_relaxed);
+  queued_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  queue_delay_total_ns_.fetch_add(delay_total, std::memory_order_relaxed);
+  queue_delay_max_ns_.store(delay_max, std::memory_order_relaxed);
+
+  if (control_pending_.load(std::memory_order_acquire)) {
+    std::lock_guard lock(control_mutex_);
+    batch_control_.swap(control_queue_);
+    control_pending_.store(false, std::memory_order_relaxed);
+  }
+  // Control frames go behind audio that was committed before them, so a
+  // "stop listening" message never overtakes the tail of the utterance.
+  for (ControlFrame& c : batch_control_) {
+    iov_.push_back({c.header.data(), c.header_len});
+    iov_.push_back({c.payload.data(), c.payload.size()});
+  }
+  writing_ = !iov_.empty();
+}
+
+void WebSocketTransport::write_batch() {
+  if (stream_->wants_write()) {
+    if (stream_->flush() < 0 && errno != EAGAIN) {
+      fail();
+      return;
+    }
+    if (stream_->wants_write()) return;
+  }
+  while (writing_ && iov_index_ < iov_.size()) {
+    int count =
+        static_cast<int>(std::min(iov_.size() - iov_index_, kMaxIov));
+    ssize_t n = stream_->writev(&iov_[iov_index_], count);
+    if (n < 0) {
+      if (errno != EAGAIN) fail();
+      return;
+    }
+    send_syscalls_.fetch_add(1, std::memory_order_relaxed);
+    bytes_sent_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+    last_send_ns_ = monotonic_ns();
+    if (batch_count_ != 0) note_audio_sent(last_send_ns_);
+    auto left = static_cast<std::size_t>(n);
+    while (left > 0) {
+      iovec& v = iov_[iov_index_];
+      if (left >= v.iov_len) {
+        left -= v.iov_len;
+        ++iov_index_;
+      } else {
+        v.iov_base = static_cast<uint8_t*>(v.iov_base) + left;
+        v.iov_len -= left;
+        left = 0;
+      }
+    }
+    // Skip zero-length entries (empty control payloads) without a syscall.
+    while (iov_index_ < iov_.size() && iov_[iov_index_].iov_len == 0) {
+      ++iov_index_;
+    }
+  }
+  if (writing_ && iov_index_ == iov_.size()) finish_batch();
+}
+
+void WebSocketTransport::finish_batch() {
+  packets_sent_.fetch_add(batch_count_, std::memory_order_relaxed);
+  for (std::size_t i = 0; i < batch_count_; ++i) batch_[i].frame.reset();
+  batch_count_ = 0;
+  batch_control_.clear();
+  iov_.clear();
+  iov_index_ = 0;
+  writing_ = false;
+}
+
+void WebSocketTransport::read_input() {
+  for (int i = 0; i < kMaxReadsPerPoll; ++i) {
+    if (rx_len_ == rx_.size()) {
+      // A single message larger than the receive buffer.
+      fail();
+      return;
+    }
+    ssize_t n = stream_->read({rx_.data() + rx_len_, rx_.size() - rx_len_});
+    if (n == 0 || (n < 0 && errno != EAGAIN)) {
+      fail();
+      return;
+    }
+    if (n < 0) return;
+    rx_len_ += static_cast<std::size_t>(n);
+    bytes_received_.fetch_add(static_cast<uint64_t>(n),
+                              std::memory_order_relaxed);
+    dispatch_frames();
+    if (stream_ == nullptr) return;
+  }
+}
+
+void WebSocketTransport::dispatch_frames() {
+  std::size_t offset = 0;
+  for (;;) {
+    auto h = ws::parse_header({rx_.data() + offset, rx_len_ - offset});
+    if (!h) break;
+    // payload_len is whatever 64-bit value the peer sent: compare it
+    // without adding to it, which could wrap.
+    if (h->payload_len > rx_.size() - h->header_len ||
+        h->payload_len > config_.max_message_bytes) {
+      fail();
+      return;
+    }
+    const std::size_t total =
+        h->header_len + static_cast<std::size_t>(h->payload_len);
+    if (rx_len_ - offset < total) break;
+    std::span<uint8_t> payload(rx_.data() + offset + h->header_len,
+                               static_cast<std::size_t>(h->payload_len));
+    if (h->masked) ws::apply_mask(payload, h->mask_key);
+    handle_frame(*h, payload);
+    if (stream_ == nullptr) return;
+    offset += total;
+  }
+  if (offset != 0) {
+    std::memmove(rx_.data(), rx_.data() + offset, rx_len_ - offset);
+    rx_len_ -= offset;
+  }
+}
+
+void WebSocketTransport::handle_frame(const ws::FrameHeader& h,
+                                      std::span<uint8_t> payload) {
+  switch (h.opcode) {
+    case ws::kText:
+    case ws::kBinary:
+      if (fragmenting_) break;  // the previous message is unfinished
+      if (!h.fin) {
+        fragmenting_ = true;
+        fragment_opcode_ = h.opcode;
+        fragment_.assign(payload.begin(), payload.end());
+        return;
+      }
+      deliver(h.opcode, payload);
+      return;
+    case ws::kContinuation:
+      if (!fragmenting_ ||
+          payload.size() > config_.max_message_bytes - fragment_.size()) {
+        break;
+      }
+      fragment_.append(payload.begin(), payload.end());
+      if (h.fin) {
+        fragmenting_ = false;
+        deliver(fragment_opcode_,
+                {reinterpret_cast<const uint8_t*>(fragment_.data()),
+                 fragment_.size()});
+        fragment_.clear();
+      }
+      return;
+    case ws::kPing:
+      queue_control(ws::kPong,
+                    {reinterpret_cast<const char*>(payload.data()),
+                     payload.size()});
+      return;
+    case ws::kPong:
+      return;
+    case ws::kClose:
+      close();
+      if (on_close_) on_close_();
+      return;
+  }
+  // Reserved opcode, a stray or oversized continuation: protocol error.
+  fail();
+}
+
+void WebSocketTransport::deliver(ws::Opcode opcode,
+                                 std::span<const uint8_t> payload) {
+  packets_received_.fetch_add(1, std::memory_order_relaxed);
+  if (opcode == ws::kText) {
+    if (on_text_) {
+      on_text_({reinterpret_cast<const char*>(payload.data()), payload.size()});
+    }
+    return;
+  }
+  FrameRef frame = receive_pool_.acquire();
+  if (!frame || payload.size() > frame.capacity()) {
+    packets_rx_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  std::memcpy(frame.data(), payload.data(), payload.size());
+  frame.set_size(payload.size());
+  frame.set_timestamp_ns(monotonic_ns());
+  if (on_audio_) on_audio_(std::move(frame));
+}
+
+TransportStats WebSocketTransport::stats() const {
+  TransportStats s;
+  s.packets_sent = packets_sent_.load(std::memory_order_relaxed);
+  s.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+  s.send_syscalls = send_syscalls_.load(std::memory_order_relaxed);
+  s.packets_received = packets_received_.load(std::memory_order_relaxed);
+  s.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+  s.packets_dropped = packets_dropped_.load(std::memory_order_relaxed);
+  s.packets_rx_dropped =
+      packets_rx_dropped_.load(std::memory_order_relaxed);
+  s.queue_depth = queued_.load(std::memory_order_relaxed);
+  s.queue_delay_total_ns =
+      queue_delay_total_ns_.load(std::memory_order_relaxed);
+  s.queue_delay_max_ns = queue_delay_max_ns_.load(std::memory_order_relaxed);
+  s.connects = connects_.load(std::memory_order_relaxed);
+  s.resumed_connects = resumed_connects_.load(std::memory_order_relaxed);
+  s.early_data_connects = early_data_connects_.load(std::memory_order_relaxed);
+  s.connect_ns = connect_ns_.load(std::memory_order_relaxed);
+  s.rtt_us = rtt_us_.load(std::memory_order_relaxed);
+  s.retransmits = retransmits_.load(std::memory_order_relaxed);
+  s.segments_sent = segments_sent_.load(std::memory_order_relaxed);
+  fill_wake_stats(s);
+  return s;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,208 @@
+#ifndef XIAOZI_NET_WEBSOCKET_TRANSPORT_H_
+#define XIAOZI_NET_WEBSOCKET_TRANSPORT_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "memory/frame_pool.h"
+#include "memory/spsc_ring.h"
+#include "net/stream.h"
+#include "net/tcp_stream.h"
+#include "net/transport.h"
+#include "net/websocket_frame.h"
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+#include "net/tls_stream.h"
+#endif
+
+namespace xiaozi {
+
+// WebSocket (ws:// or wss://) transport that coalesces outgoing frames.
+//
+// Audio packets are encoded in place into blocks of the transport's packet
+// pool and queued with their frame header. The transport thread collects
+// them into a batch and sends the batch with a single writev() (header,
+// payload, header, payload, ...) once the oldest packet has waited
+// latency_budget, the batch reaches max_batch_bytes/kMaxBatchPackets, or a
+// control message is waiting. Over TLS the batch becomes one SSL_write and
+// therefore one run of records instead of one record per packet.
+//
+// Connection set-up is trimmed for the wake path: the hello goes out the
+// moment the 101 arrives, a reconnect resumes the TLS session (see
+// Config::early_data for 0-RTT), and an idle connection is held open
+// by kernel keepalives, so a wake finds it ready (see WarmConnection). The
+// first packet after mark_wake() skips the latency budget.
+class WebSocketTransport : public Transport {
+ public:
+  static constexpr std::size_t kQueuePackets = 64;
+  static constexpr std::size_t kMaxBatchPackets = 32;
+
+  struct Config {
+    std::string url;
+    // Extra upgrade request headers (Authorization, Device-Id, ...).
+    std::vector<std::pair<std::string, std::string>> headers;
+    // Longest an audio packet waits for others to share its write. Zero
+    // sends every packet on its own.
+    std::chrono::microseconds latency_budget{10000};
+    std::size_t max_batch_bytes = 16 * 1024;
+    std::size_t max_packet_bytes = 1276;
+    std::size_t send_pool_blocks = 64;
+    // Received binary messages in flight, max_message_bytes each.
+    std::size_t receive_pool_blocks = 32;
+    // Largest WebSocket frame accepted from the server, header included.
+    std::size_t receive_buffer_bytes = 64 * 1024;
+    // Largest message, summed over its continuation frames. A frame or
+    // message past either limit is a protocol error and drops the
+    // connection.
+    std::size_t max_message_bytes = 64 * 1024;
+    int connect_timeout_ms = 5000;
+    bool verify_peer = true;
+    // First text message of every connection, written as soon as the 101
+    // arrives, before open() returns. Empty sends none.
+    std::string hello;
+    // wss:// only: reconnects resume the last TLS session.
+    bool tls_resumption = true;
+    // With resumption, sends the upgrade request in the 0-RTT flight, which
+    // anyone on the path can replay to the server. Only a request without
+    // `headers` (so without credentials) goes that way; the hello, which
+    // starts the server's session, and audio never do. Enable it only for
+    // a server that accepts such upgrades.
+    bool early_data = false;
+    // Kernel keepalive probes on the TCP connection; zero idle leaves them
+    // off.
+    std::chrono::seconds keepalive_idle{45};
+    std::chrono::seconds keepalive_interval{15};
+    int keepalive_probes = 4;
+    // WebSocket ping after this long without sending, for servers that drop
+    // quiet sessions themselves. Zero disables it.
+    std::chrono::seconds ping_interval{0};
+  };
+
+  explicit WebSocketTransport(Config config);
+  ~WebSocketTransport() override;
+
+  bool open() override;
+  // Adopts a stream whose upgrade handshake is already done (benchmarks,
+  // replay, load generation over a socketpair).
+  void attach(std::unique_ptr<Stream> stream);
+  void close() override;
+  bool is_open() const override {
+    return open_.load(std::memory_order_acquire);
+  }
+
+  std::span<uint8_t> reserve(std::size_t max_bytes) override;
+  bool commit(std::size_t bytes, uint64_t capture_ns) override;
+
+  bool send_text(std::string_view message) override;
+  void poll(int timeout_ms) override;
+  TransportStats stats() const override;
+
+ private:
+  // Plain aggregate on purpose: with member initializers GCC does not treat
+  // a nested type as default-constructible until the enclosing class is
+  // complete, and SpscRing static_asserts exactly that.
+  struct OutPacket {
+    FrameRef frame;
+    uint64_t enqueue_ns;
+    uint8_t header_len;
+    std::array<uint8_t, ws::kMaxHeaderBytes> header;
+  };
+
+  struct ControlFrame {
+    ws::Opcode opcode;
+    std::string payload;  // already masked
+    std::array<uint8_t, ws::kMaxHeaderBytes> header;
+    uint8_t header_len;
+  };
+
+  std::unique_ptr<Stream> connect(const std::string& host, int port,
+                                  bool secure, const std::string& request);
+  // Writes `request` (empty when it went as early data) and checks the
+  // server's 101 for `key`.
+  bool handshake(const std::string& key, std::string_view request);
+  void queue_control(ws::Opcode opcode, std::string_view payload);
+
+  // Transport thread.
+  bool batch_due(uint64_t now);
+  void start_batch();
+  void write_batch();
+  void finish_batch();
+  void read_input();
+  void dispatch_frames();
+  void handle_frame(const ws::FrameHeader& h, std::span<uint8_t> payload);
+  void deliver(ws::Opcode opcode, std::span<const uint8_t> payload);
+  void teardown();
+  void fail();
+
+  Config config_;
+  // Transport thread only. Other threads see the connection through open_,
+  // which open(), attach() and teardown() publish.
+  std::unique_ptr<Stream> stream_;
+  std::atomic<bool> open_{false};
+  Waker waker_;
+
+  // Producer (codec thread) state. The producer wakes the transport thread
+  // only when the queue goes from empty to non-empty or reaches a batch
+  // limit, not per packet.
+  FramePool send_pool_;
+  FrameRef reserved_;
+  uint32_t mask_state_;
+  SpscRing<OutPacket, kQueuePackets> queue_;
+  std::atomic<uint32_t> queued_{0};
+  std::atomic<std::size_t> queued_bytes_{0};
+
+  std::mutex control_mutex_;
+  std::vector<ControlFrame> control_queue_;
+  uint32_t control_mask_state_;
+  std::atomic<bool> control_pending_{false};
+
+  // Transport-thread state. A batch is popped from queue_ when due and is
+  // sealed until every byte of it has been written.
+  std::array<OutPacket, kMaxBatchPackets> batch_;
+  std::size_t batch_count_ = 0;
+  std::vector<ControlFrame> batch_control_;
+  bool writing_ = false;
+  std::vector<struct iovec> iov_;
+  std::size_t iov_index_ = 0;
+  uint64_t last_send_ns_ = 0;
+  uint64_t last_tcp_info_ns_ = 0;
+#if defined(XIAOZI_HAVE_OPENSSL)
+  TlsSessionCache tls_cache_;
+#endif
+  bool resumed_ = false;     // by the latest connect()
+  bool early_data_ = false;  // request and hello went as 0-RTT
+
+  FramePool receive_pool_;
+  std::vector<uint8_t> rx_;
+  std::size_t rx_len_ = 0;
+  std::string fragment_;
+  ws::Opcode fragment_opcode_ = ws::kText;
+  bool fragmenting_ = false;  // a message's first frame had no FIN
+
+  std::atomic<uint64_t> packets_sent_{0};
+  std::atomic<uint64_t> bytes_sent_{0};
+  std::atomic<uint64_t> send_syscalls_{0};
+  std::atomic<uint64_t> packets_received_{0};
+  std::atomic<uint64_t> bytes_received_{0};
+  std::atomic<uint64_t> packets_dropped_{0};
+  std::atomic<uint64_t> packets_rx_dropped_{0};
+  std::atomic<uint64_t> queue_delay_total_ns_{0};
+  std::atomic<uint64_t> queue_delay_max_ns_{0};
+  std::atomic<uint64_t> connects_{0};
+  std::atomic<uint64_t> resumed_connects_{0};
+  std::atomic<uint64_t> early_data_connects_{0};
+  std::atomic<uint64_t> connect_ns_{0};
+  std::atomic<uint32_t> rtt_us_{0};
+  std::atomic<uint32_t> retransmits_{0};
+  std::atomic<uint32_t> segments_sent_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_NET_WEBSOCKET_TRANSPORT_H_
@@ -0,0 +1,144 @@
+#include "ota/flash_partition.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace xiaozi {
+namespace {
+
+bool in_range(std::size_t offset, std::size_t bytes, std::size_t size) {
+  return offset <= size && bytes <= size - offset;
+}
+
+std::size_t round_up(std::size_t value, std::size_t unit) {
+  return (value + unit - 1) / unit * unit;
+}
+
+}  // namespace
+
+MemoryPartition::MemoryPartition(std::size_t size, std::size_t sector_size)
+    : bytes_(size, 0xff), sector_size_(sector_size) {}
+
+bool MemoryPartition::read(std::size_t offset, std::span<uint8_t> out) {
+  if (!in_range(offset, out.size(), bytes_.size())) return false;
+  std::memcpy(out.data(), bytes_.data() + offset, out.size());
+  return true;
+}
+
+bool MemoryPartition::erase(std::size_t offset, std::size_t bytes) {
+  if (!in_range(offset, bytes, bytes_.size()) || offset % sector_size_ != 0 ||
+      bytes % sector_size_ != 0) {
+    return false;
+  }
+  std::memset(bytes_.data() + offset, 0xff, bytes);
+  sectors_erased_ += bytes / sector_size_;
+  return true;
+}
+
+bool MemoryPartition::write(std::size_t offset,
+                            std::span<const uint8_t> data) {
+  if (!in_range(offset, data.size(), bytes_.size())) return false;
+  uint8_t* p = bytes_.data() + offset;
+  for (std::size_t i = 0; i < data.size(); ++i) p[i] &= data[i];
+  ++writes_;
+  bytes_written_ += data.size();
+  return true;
+}
+
+FilePartition::FilePartition(const std::string& path, std::size_t size,
+                             std::size_t sector_size)
+    : fd_(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)),
+      size_(size),
+      sector_size_(sector_size) {}
+
+FilePartition::~FilePartition() {
+  if (fd_ >= 0) ::close(fd_);
+}
+
+bool FilePartition::read(std::size_t offset, std::span<uint8_t> out) {
+  if (!in_range(offset, out.size(), size_)) return false;
+  std::size_t done = 0;
+  while (done < out.size()) {
+    const ssize_t n = ::pread(fd_, out.data() + done, out.size() - done,
+                              static_cast<off_t>(offset + done));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return false;
+    if (n == 0) {
+      std::memset(out.data() + done, 0xff, out.size() - done);
+      break;
+    }
+    done += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+bool FilePartition::erase(std::size_t offset, std::size_t bytes) {
+  if (!in_range(offset, bytes, size_) || offset % sector_size_ != 0 ||
+      bytes % sector_size_ != 0) {
+    return false;
+  }
+  const std::vector<uint8_t> erased(sector_size_, 0xff);
+  for (std::size_t at = offset; at < offset + bytes; at += sector_size_) {
+    if (::pwrite(fd_, erased.data(), erased.size(), static_cast<off_t>(at)) !=
+        static_cast<ssize_t>(erased.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FilePartition::write(std::size_t offset, std::span<const uint8_t> data) {
+  if (!in_range(offset, data.size(), size_)) return false;
+  std::size_t done = 0;
+  while (done < data.size()) {
+    const ssize_t n = ::pwrite(fd_, data.data() + done, data.size() - done,
+                               static_cast<off_t>(offset + done));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    done += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+FlashWriter::FlashWriter(FlashPartition& partition, std::size_t offset,
+                         std::size_t buffer_bytes)
+    : partition_(partition),
+      buffer_(std::max<std::size_t>(buffer_bytes, 1)),
+      offset_(offset),
+      erased_end_(round_up(offset, partition.sector_size())) {}
+
+bool FlashWriter::write(std::span<const uint8_t> data) {
+  while (!data.empty()) {
+    const std::size_t take =
+        std::min(data.size(), buffer_.size() - buffered_);
+    std::memcpy(buffer_.data() + buffered_, data.data(), take);
+    buffered_ += take;
+    data = data.subspan(take);
+    if (buffered_ == buffer_.size() && !write_out()) return false;
+  }
+  return true;
+}
+
+bool FlashWriter::flush() { return buffered_ == 0 || write_out(); }
+
+bool FlashWriter::write_out() {
+  const std::size_t end = offset_ + buffered_;
+  if (end > erased_end_) {
+    const std::size_t erase_end = round_up(end, partition_.sector_size());
+    if (erase_end > partition_.size() ||
+        !partition_.erase(erased_end_, erase_end - erased_end_)) {
+      return false;
+    }
+    erased_end_ = erase_end;
+  }
+  if (!partition_.write(offset_, {buffer_.data(), buffered_})) return false;
+  offset_ = end;
+  buffered_ = 0;
+  return true;
+}
+
+}  // namespace xiaozi
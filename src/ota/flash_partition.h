@@ -0,0 +1,109 @@
+#ifndef XIAOZI_OTA_FLASH_PARTITION_H_
+#define XIAOZI_OTA_FLASH_PARTITION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace xiaozi {
+
+// One firmware slot in NOR flash. Erasing sets a whole sector to 0xff;
+// writing can only clear bits, so each byte is written once between
+// erases. Offsets are relative to the partition.
+class FlashPartition {
+ public:
+  virtual ~FlashPartition() = default;
+
+  virtual std::size_t size() const = 0;
+  virtual std::size_t sector_size() const = 0;
+
+  virtual bool read(std::size_t offset, std::span<uint8_t> out) = 0;
+  // `offset` and `bytes` are multiples of sector_size().
+  virtual bool erase(std::size_t offset, std::size_t bytes) = 0;
+  virtual bool write(std::size_t offset, std::span<const uint8_t> data) = 0;
+};
+
+// A partition in host memory with NOR semantics (writes AND into the
+// contents), for the simulator and benchmarks.
+class MemoryPartition : public FlashPartition {
+ public:
+  struct Stats {
+    uint64_t sectors_erased;
+    uint64_t writes;
+    uint64_t bytes_written;
+  };
+
+  MemoryPartition(std::size_t size, std::size_t sector_size);
+
+  std::size_t size() const override { return bytes_.size(); }
+  std::size_t sector_size() const override { return sector_size_; }
+  bool read(std::size_t offset, std::span<uint8_t> out) override;
+  bool erase(std::size_t offset, std::size_t bytes) override;
+  bool write(std::size_t offset, std::span<const uint8_t> data) override;
+
+  std::span<uint8_t> bytes() { return bytes_; }
+  Stats stats() const { return {sectors_erased_, writes_, bytes_written_}; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+  std::size_t sector_size_;
+  uint64_t sectors_erased_ = 0;
+  uint64_t writes_ = 0;
+  uint64_t bytes_written_ = 0;
+};
+
+// A partition backed by a file (an image on the host, or an MTD device).
+class FilePartition : public FlashPartition {
+ public:
+  // Opens `path` read-write; is_open() tells whether that worked. Files
+  // shorter than `size` read as erased past their end.
+  FilePartition(const std::string& path, std::size_t size,
+                std::size_t sector_size);
+  ~FilePartition() override;
+  FilePartition(const FilePartition&) = delete;
+  FilePartition& operator=(const FilePartition&) = delete;
+
+  bool is_open() const { return fd_ >= 0; }
+  std::size_t size() const override { return size_; }
+  std::size_t sector_size() const override { return sector_size_; }
+  bool read(std::size_t offset, std::span<uint8_t> out) override;
+  bool erase(std::size_t offset, std::size_t bytes) override;
+  bool write(std::size_t offset, std::span<const uint8_t> data) override;
+
+ private:
+  int fd_ = -1;
+  std::size_t size_;
+  std::size_t sector_size_;
+};
+
+// Writes a partition front to back through a buffer of `buffer_bytes`,
+// erasing each sector just before the first write into it. Starting at a
+// non-zero offset continues an earlier write: the sector holding `offset`
+// is taken as already erased.
+class FlashWriter {
+ public:
+  FlashWriter(FlashPartition& partition, std::size_t offset,
+              std::size_t buffer_bytes);
+
+  bool write(std::span<const uint8_t> data);
+  // Writes out what is buffered; offset() is then on flash.
+  bool flush();
+
+  // Bytes accepted so far, buffered ones included.
+  std::size_t offset() const { return offset_ + buffered_; }
+
+ private:
+  bool write_out();
+
+  FlashPartition& partition_;
+  std::vector<uint8_t> buffer_;
+  std::size_t buffered_ = 0;
+  std::size_t offset_;
+  std::size_t erased_end_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_OTA_FLASH_PARTITION_H_
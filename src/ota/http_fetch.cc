@@ -0,0 +1,273 @@
+#include "ota/http_fetch.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "base/clock.h"
+#include "net/tcp_stream.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr std::size_t kMaxHeadBytes = 4096;
+
+uint64_t deadline_after(int ms) {
+  return monotonic_ns() + uint64_t{1000000} * static_cast<uint64_t>(ms);
+}
+
+bool wait_fd(int fd, short events, uint64_t deadline_ns) {
+  pollfd pfd{fd, events, 0};
+  int rc;
+  do {
+    const uint64_t now = monotonic_ns();
+    const int ms = now >= deadline_ns
+                       ? 0
+                       : static_cast<int>((deadline_ns - now) / 1000000);
+    rc = ::poll(&pfd, 1, ms);
+  } while (rc < 0 && errno == EINTR);
+  return rc == 1;
+}
+
+bool write_all(Stream& stream, std::string_view data, uint64_t deadline_ns) {
+  while (!data.empty() || stream.wants_write()) {
+    ssize_t n;
+    if (stream.wants_write()) {
+      n = stream.flush();
+      if (n >= 0) continue;
+    } else {
+      iovec iov{const_cast<char*>(data.data()), data.size()};
+      n = stream.writev(&iov, 1);
+      if (n >= 0) {
+        data.remove_prefix(static_cast<std::size_t>(n));
+        continue;
+      }
+    }
+    if (errno != EAGAIN || !wait_fd(stream.fd(), POLLOUT, deadline_ns)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reads what is available, waiting up to the deadline for something. 0 at
+// EOF, -1 on error or timeout (errno ETIMEDOUT).
+ssize_t read_some(Stream& stream, std::span<uint8_t> buf,
+                  uint64_t deadline_ns) {
+  for (;;) {
+    const ssize_t n = stream.read(buf);
+    if (n >= 0 || errno != EAGAIN) return n;
+    if (!stream.has_buffered_input() &&
+        !wait_fd(stream.fd(), POLLIN, deadline_ns)) {
+      errno = ETIMEDOUT;
+      return -1;
+    }
+  }
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+// Parses a decimal prefix of `s`, advancing past it.
+bool take_number(std::string_view& s, uint64_t& value) {
+  const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (ec != std::errc()) return false;
+  s.remove_prefix(static_cast<std::size_t>(end - s.data()));
+  return true;
+}
+
+std::string host_header(const Url& url) {
+  std::string host = url.host.find(':') != std::string::npos
+                         ? "[" + url.host + "]"
+                         : url.host;
+  if (url.port != (url.secure() ? 443 : 80)) {
+    host += ":" + std::to_string(url.port);
+  }
+  return host;
+}
+
+}  // namespace
+
+HttpFetch::HttpFetch(Config config)
+    : config_(config),
+      buffer_(std::max(config.read_bytes, kMaxHeadBytes)) {}
+
+std::unique_ptr<Stream> HttpFetch::connect(const Url& url) {
+  if (url.scheme == "http") {
+    return TcpStream::connect(url.host, url.port, config_.connect_timeout_ms);
+  }
+#if defined(XIAOZI_HAVE_OPENSSL)
+  if (url.scheme == "https") {
+    TlsStream::Options options;
+    options.verify_peer = config_.verify_peer;
+    options.timeout_ms = config_.connect_timeout_ms;
+    options.session_cache = &tls_cache_;
+    return TlsStream::connect(url.host, url.port, options);
+  }
+#endif
+  return nullptr;
+}
+
+HttpFetch::Status HttpFetch::get(const Url& url, uint64_t offset,
+                                 const BodyHandler& on_body) {
+  if (url.scheme == "http" && !config_.allow_http) return Status::kInsecure;
+  std::unique_ptr<Stream> stream = connect(url);
+  if (stream == nullptr) return Status::kConnectFailed;
+
+  std::string request = "GET " + url.path + " HTTP/1.1\r\nHost: " +
+                        host_header(url) + "\r\nConnection: close\r\n";
+  if (offset != 0) {
+    request += "Range: bytes=" + std::to_string(offset) + "-\r\n";
+  }
+  request += "\r\n";
+  if (!write_all(*stream, request,
+                 deadline_after(config_.io_timeout_ms))) {
+    return Status::kConnectFailed;
+  }
+
+  uint64_t left = 0;
+  uint64_t skip = 0;
+  const Status head = read_head(
+      *stream, deadline_after(config_.io_timeout_ms), offset, left, skip);
+  if (head != Status::kDone) return head;
+  const bool to_close = left == UINT64_MAX;
+
+  // What came in behind the headers, then the rest of the body.
+  for (;;) {
+    std::span<const uint8_t> data{buffer_.data(),
+                                  std::min<uint64_t>(buffered_, left)};
+    const std::size_t skipped =
+        static_cast<std::size_t>(std::min<uint64_t>(skip, data.size()));
+    skip -= skipped;
+    left -= data.size();
+    data = data.subspan(skipped);
+    if (!data.empty() && !on_body(data)) return Status::kAborted;
+    buffered_ = 0;
+    if (left == 0) return Status::kDone;
+
+    const ssize_t n = read_some(
+        *stream, {buffer_.data(), config_.read_bytes},
+        deadline_after(config_.io_timeout_ms));
+    if (n < 0) {
+      return errno == ETIMEDOUT ? Status::kTimeout : Status::kTruncated;
+    }
+    if (n == 0) {
+      // Without a Content-Length the body runs to the close.
+      return to_close && skip == 0 ? Status::kDone : Status::kTruncated;
+    }
+    buffered_ = static_cast<std::size_t>(n);
+  }
+}
+
+HttpFetch::Status HttpFetch::read_head(Stream& stream, uint64_t deadline_ns,
+                                       uint64_t offset, uint64_t& body_bytes,
+                                       uint64_t& skip) {
+  buffered_ = 0;
+  std::size_t head_end = std::string_view::npos;
+  while (head_end == std::string_view::npos) {
+    if (buffered_ == kMaxHeadBytes) return Status::kBadResponse;
+    const ssize_t n = read_some(
+        stream, {buffer_.data() + buffered_, kMaxHeadBytes - buffered_},
+        deadline_ns);
+    if (n < 0) {
+      return errno == ETIMEDOUT ? Status::kTimeout : Status::kTruncated;
+    }
+    if (n == 0) return Status::kTruncated;
+    buffered_ += static_cast<std::size_t>(n);
+    head_end = std::string_view(reinterpret_cast<const char*>(buffer_.data()),
+                                buffered_)
+                   .find("\r\n\r\n");
+  }
+  std::string_view head(reinterpret_cast<const char*>(buffer_.data()),
+                        head_end + 2);
+
+  // "HTTP/1.1 206 Partial Content"
+  const std::size_t eol = head.find("\r\n");
+  std::string_view status_line = head.substr(0, eol);
+  head.remove_prefix(eol + 2);
+  const std::size_t space = status_line.find(' ');
+  if (!status_line.starts_with("HTTP/1.") ||
+      space == std::string_view::npos) {
+    return Status::kBadResponse;
+  }
+  status_line.remove_prefix(space + 1);
+  uint64_t code = 0;
+  if (!take_number(status_line, code) || (code != 200 && code != 206)) {
+    return Status::kBadResponse;
+  }
+
+  bool has_length = false;
+  uint64_t length = 0;
+  bool has_range = false;
+  uint64_t range_first = 0;
+  uint64_t range_total = 0;
+  while (!head.empty()) {
+    const std::size_t end = head.find("\r\n");
+    const std::string_view line = head.substr(0, end);
+    head.remove_prefix(end + 2);
+    const std::size_t colon = line.find(':');
+    if (colon == std::string_view::npos) continue;
+    const std::string_view name = line.substr(0, colon);
+    std::string_view value = trim(line.substr(colon + 1));
+    if (iequals(name, "content-length")) {
+      has_length = take_number(value, length) && value.empty();
+      if (!has_length) return Status::kBadResponse;
+    } else if (iequals(name, "transfer-encoding") &&
+               !iequals(value, "identity")) {
+      return Status::kBadResponse;
+    } else if (iequals(name, "content-range")) {
+      // "bytes first-last/total"
+      uint64_t last = 0;
+      if (!value.starts_with("bytes ")) return Status::kBadResponse;
+      value.remove_prefix(6);
+      has_range = take_number(value, range_first) && value.starts_with('-');
+      if (has_range) value.remove_prefix(1);
+      has_range = has_range && take_number(value, last) &&
+                  value.starts_with('/');
+      if (has_range) value.remove_prefix(1);
+      has_range = has_range && take_number(value, range_total) &&
+                  value.empty() && last < range_total;
+      if (!has_range) return Status::kBadResponse;
+    }
+  }
+
+  if (code == 206) {
+    if (!has_range || range_first != offset) return Status::kBadResponse;
+    total_bytes_ = range_total;
+    skip = 0;
+  } else {
+    if (has_length && offset > length) return Status::kBadResponse;
+    total_bytes_ = has_length ? length : 0;
+    skip = offset;
+  }
+  body_bytes = has_length ? length : UINT64_MAX;
+
+  const std::size_t consumed = head_end + 4;
+  std::memmove(buffer_.data(), buffer_.data() + consumed,
+               buffered_ - consumed);
+  buffered_ -= consumed;
+  return Status::kDone;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,79 @@
+#ifndef XIAOZI_OTA_HTTP_FETCH_H_
+#define XIAOZI_OTA_HTTP_FETCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "net/stream.h"
+#include "net/url.h"
+
+#if defined(XIAOZI_HAVE_OPENSSL)
+#include "net/tls_stream.h"
+#endif
+
+namespace xiaozi {
+
+// Blocking HTTP/1.1 GET for firmware downloads, from any byte offset: a
+// Range request, so a dropped download carries on where it stopped.
+// https:// with OpenSSL, and http:// only where Config::allow_http says
+// so; the TLS session is kept between requests, so a resumed download does
+// not pay a full handshake. Chunked responses are refused (update files
+// are served as static files). Not thread-safe; one fetch at a time.
+class HttpFetch {
+ public:
+  enum class Status {
+    kDone,
+    kAborted,        // the body handler returned false
+    kConnectFailed,
+    kBadResponse,    // not 200/206, wrong range, or chunked
+    kTimeout,
+    kTruncated,      // the connection ended before the body did
+    kInsecure,       // http:// without Config::allow_http
+  };
+
+  struct Config {
+    int connect_timeout_ms = 5000;
+    // Longest wait for the next byte once connected.
+    int io_timeout_ms = 10000;
+    bool verify_peer = true;
+    // Plain http:// lets anyone on the path swap the file; only for a
+    // local test server.
+    bool allow_http = false;
+    std::size_t read_bytes = 4096;
+  };
+
+  // Receives the body in order; returning false stops the transfer.
+  using BodyHandler = std::function<bool(std::span<const uint8_t> bytes)>;
+
+  explicit HttpFetch(Config config);
+  HttpFetch() : HttpFetch(Config{}) {}
+
+  // Fetches `url` from byte `offset` to its end. A server that ignores
+  // the range (200) is read from the start and the first `offset` bytes
+  // skipped.
+  Status get(const Url& url, uint64_t offset, const BodyHandler& on_body);
+
+  // Size of the whole resource, once the last get() saw its headers.
+  uint64_t total_bytes() const { return total_bytes_; }
+
+ private:
+  std::unique_ptr<Stream> connect(const Url& url);
+  Status read_head(Stream& stream, uint64_t deadline_ns, uint64_t offset,
+                   uint64_t& body_bytes, uint64_t& skip);
+
+  Config config_;
+  std::vector<uint8_t> buffer_;
+  std::size_t buffered_ = 0;
+  uint64_t total_bytes_ = 0;
+#if defined(XIAOZI_HAVE_OPENSSL)
+  TlsSessionCache tls_cache_;
+#endif
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_OTA_HTTP_FETCH_H_
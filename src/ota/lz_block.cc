@@ -0,0 +1,137 @@
+#include "ota/lz_block.h"
+
+#include <cstring>
+
+namespace xiaozi {
+namespace {
+
+constexpr std::size_t kMinMatch = 4;
+// The format wants the last match to start 12 bytes before the end and
+// the last 5 bytes to be literals.
+constexpr std::size_t kMatchLimit = 12;
+constexpr std::size_t kLastLiterals = 5;
+constexpr int kHashBits = 12;
+constexpr std::size_t kMaxOffset = 65535;
+
+uint32_t load32(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t hash(uint32_t v) { return (v * 2654435761u) >> (32 - kHashBits); }
+
+void put_length(std::vector<uint8_t>& out, std::size_t len) {
+  for (; len >= 255; len -= 255) out.push_back(255);
+  out.push_back(static_cast<uint8_t>(len));
+}
+
+void put_sequence(std::vector<uint8_t>& out, const uint8_t* literals,
+                  std::size_t literal_len, std::size_t offset,
+                  std::size_t match_len) {
+  const std::size_t match_code = match_len == 0 ? 0 : match_len - kMinMatch;
+  const uint8_t token =
+      static_cast<uint8_t>((literal_len >= 15 ? 15 : literal_len) << 4 |
+                           (match_code >= 15 ? 15 : match_code));
+  out.push_back(token);
+  if (literal_len >= 15) put_length(out, literal_len - 15);
+  out.insert(out.end(), literals, literals + literal_len);
+  if (match_len == 0) return;
+  out.push_back(static_cast<uint8_t>(offset));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (match_code >= 15) put_length(out, match_code - 15);
+}
+
+// Reads an extended length after a nibble of 15; false past the end.
+bool get_length(const uint8_t*& p, const uint8_t* end, std::size_t& len) {
+  uint8_t b;
+  do {
+    if (p == end) return false;
+    b = *p++;
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+}  // namespace
+
+std::size_t lz_compress(std::span<const uint8_t> in,
+                        std::vector<uint8_t>& out) {
+  const std::size_t start_size = out.size();
+  const uint8_t* src = in.data();
+  const std::size_t n = in.size();
+  std::vector<int32_t> table(std::size_t{1} << kHashBits, -1);
+
+  std::size_t anchor = 0;
+  std::size_t i = 0;
+  std::size_t misses = 0;
+  while (i + kMatchLimit <= n) {
+    const uint32_t v = load32(src + i);
+    int32_t& slot = table[hash(v)];
+    const int32_t previous = slot;
+    slot = static_cast<int32_t>(i);
+    const auto candidate = static_cast<std::size_t>(previous);
+    if (previous < 0 || i - candidate > kMaxOffset ||
+        load32(src + candidate) != v) {
+      // Skip faster through data that does not compress.
+      i += 1 + (misses++ >> 6);
+      continue;
+    }
+    misses = 0;
+    std::size_t len = kMinMatch;
+    const std::size_t limit = n - kLastLiterals;
+    while (i + len < limit && src[candidate + len] == src[i + len]) ++len;
+    put_sequence(out, src + anchor, i - anchor, i - candidate, len);
+    // Index one position inside the match, enough for runs.
+    if (len > 2) {
+      table[hash(load32(src + i + len - 2))] =
+          static_cast<int32_t>(i + len - 2);
+    }
+    i += len;
+    anchor = i;
+  }
+  put_sequence(out, src + anchor, n - anchor, 0, 0);
+  return out.size() - start_size;
+}
+
+bool lz_decompress(std::span<const uint8_t> in, std::span<uint8_t> out) {
+  const uint8_t* p = in.data();
+  const uint8_t* const end = p + in.size();
+  uint8_t* dst = out.data();
+  uint8_t* const dst_end = dst + out.size();
+  while (p < end) {
+    const uint8_t token = *p++;
+    std::size_t literal_len = token >> 4;
+    if (literal_len == 15 && !get_length(p, end, literal_len)) return false;
+    if (literal_len > static_cast<std::size_t>(end - p) ||
+        literal_len > static_cast<std::size_t>(dst_end - dst)) {
+      return false;
+    }
+    std::memcpy(dst, p, literal_len);
+    dst += literal_len;
+    p += literal_len;
+    if (p == end) break;  // the last sequence has no match
+
+    if (end - p < 2) return false;
+    const std::size_t offset = p[0] | std::size_t{p[1]} << 8;
+    p += 2;
+    std::size_t match_len = token & 15;
+    if (match_len == 15 && !get_length(p, end, match_len)) return false;
+    match_len += kMinMatch;
+    if (offset == 0 || offset > static_cast<std::size_t>(dst - out.data()) ||
+        match_len > static_cast<std::size_t>(dst_end - dst)) {
+      return false;
+    }
+    const uint8_t* from = dst - offset;
+    if (offset >= match_len) {
+      std::memcpy(dst, from, match_len);
+      dst += match_len;
+    } else {
+      // Overlapping: a run of the last `offset` bytes.
+      for (std::size_t k = 0; k < match_len; ++k) *dst++ = from[k];
+    }
+  }
+  return dst == dst_end;
+}
+
+}  // namespace xiaozi
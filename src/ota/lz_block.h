@@ -0,0 +1,30 @@
+#ifndef XIAOZI_OTA_LZ_BLOCK_H_
+#define XIAOZI_OTA_LZ_BLOCK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace xiaozi {
+
+// LZ4 block format, one independent block at a time: greedy, hash-chained
+// matching on the host, and a decoder small enough for the device's boot
+// path. Blocks are at most 64 KiB, so offsets fit the format's 16 bits.
+
+// Worst-case packed size of `raw_bytes` of input.
+inline std::size_t lz_bound(std::size_t raw_bytes) {
+  return raw_bytes + raw_bytes / 255 + 16;
+}
+
+// Appends the packed form of `in` to `out`; returns its size.
+std::size_t lz_compress(std::span<const uint8_t> in,
+                        std::vector<uint8_t>& out);
+
+// Decodes one block into `out`, which must be exactly the raw size.
+// False on malformed input; `out` is then partly written.
+bool lz_decompress(std::span<const uint8_t> in, std::span<uint8_t> out);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_OTA_LZ_BLOCK_H_
@@ -0,0 +1,88 @@
+#include "ota/ota_updater.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+namespace xiaozi {
+
+OtaUpdater::OtaUpdater(FlashPartition& base, FlashPartition& target,
+                       Config config)
+    : base_(base),
+      target_(target),
+      config_(config),
+      fetch_(config.fetch) {}
+
+OtaUpdater::Status OtaUpdater::run(
+    const Url& url, const Sha256::Digest& expected_sha256,
+    const CheckpointHandler& on_checkpoint,
+    const std::optional<UpdateStream::Checkpoint>& resume) {
+  if (url.scheme == "http" && !config_.fetch.allow_http) {
+    return Status::kInsecure;
+  }
+  UpdateStream::Config stream_config = config_.stream;
+  stream_config.expected_sha256 = expected_sha256;
+  std::optional<UpdateStream::Checkpoint> saved = resume;
+  std::chrono::milliseconds backoff = config_.min_backoff;
+  int stalled = 0;
+  for (;;) {
+    // A fresh stream each attempt: bytes fed past the checkpoint belong to
+    // a block that was cut off and are fetched again.
+    auto stream = saved ? std::make_unique<UpdateStream>(base_, target_,
+                                                         stream_config, *saved)
+                        : std::make_unique<UpdateStream>(base_, target_,
+                                                         stream_config);
+    const uint64_t offset = saved ? saved->file_offset : 0;
+    requests_.fetch_add(1, std::memory_order_relaxed);
+    if (saved) resumes_.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t reported = offset;
+    if (stream->status() == UpdateStream::Status::kRunning) {
+      fetch_.get(url, offset, [&](std::span<const uint8_t> bytes) {
+        bytes_downloaded_.fetch_add(bytes.size(), std::memory_order_relaxed);
+        const UpdateStream::Status s = stream->feed(bytes);
+        const UpdateStream::Checkpoint& c = stream->checkpoint();
+        if (c.file_offset > reported) {
+          reported = c.file_offset;
+          saved = c;
+          target_bytes_.store(c.target_offset, std::memory_order_relaxed);
+          if (on_checkpoint) on_checkpoint(c);
+        }
+        return s == UpdateStream::Status::kRunning;
+      });
+    }
+    stream_status_ = stream->status();
+
+    switch (stream_status_) {
+      case UpdateStream::Status::kDone:
+        target_bytes_.store(stream->checkpoint().header.target_size,
+                            std::memory_order_relaxed);
+        return Status::kDone;
+      case UpdateStream::Status::kFlashError:
+        return Status::kFlashError;
+      case UpdateStream::Status::kRunning:
+        break;
+      default:
+        return Status::kRejected;
+    }
+    // The transfer ended early: retry, backing off only without progress.
+    if (reported > offset) {
+      stalled = 0;
+      backoff = config_.min_backoff;
+    } else if (++stalled >= config_.max_stalled_attempts) {
+      return Status::kUnreachable;
+    } else {
+      std::this_thread::sleep_for(backoff);
+      backoff = std::min(backoff * 2, config_.max_backoff);
+    }
+  }
+}
+
+OtaUpdater::Stats OtaUpdater::stats() const {
+  return {requests_.load(std::memory_order_relaxed),
+          resumes_.load(std::memory_order_relaxed),
+          bytes_downloaded_.load(std::memory_order_relaxed),
+          target_bytes_.load(std::memory_order_relaxed)};
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,92 @@
+#ifndef XIAOZI_OTA_OTA_UPDATER_H_
+#define XIAOZI_OTA_OTA_UPDATER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+#include "base/sha256.h"
+#include "net/url.h"
+#include "ota/flash_partition.h"
+#include "ota/http_fetch.h"
+#include "ota/update_stream.h"
+
+namespace xiaozi {
+
+// Downloads an update file and applies it to the inactive partition as it
+// arrives (UpdateStream), so the image is never held in RAM and is
+// verified the moment the last byte is written. A dropped connection is
+// retried with a range request from the last checkpoint; only the block
+// in flight is fetched again. Attempts that make no progress back off
+// from min_backoff to max_backoff and give up after max_stalled_attempts.
+//
+// The caller names the image it expects, by the SHA-256 its authenticated
+// update check announced; a file for any other image is rejected before
+// it touches flash (UpdateStream::Config::expected_sha256).
+//
+// The checkpoint handler sees every checkpoint; a caller that stores it
+// survives a reboot too, by passing the stored one back to run(). Marking
+// the new partition bootable is left to the board.
+class OtaUpdater {
+ public:
+  enum class Status {
+    kDone,
+    kRejected,      // the file is not a valid update for this device
+    kFlashError,
+    kUnreachable,   // download kept failing
+    kInsecure,      // http:// without HttpFetch::Config::allow_http
+  };
+
+  struct Config {
+    HttpFetch::Config fetch;
+    UpdateStream::Config stream;
+    int max_stalled_attempts = 5;
+    std::chrono::milliseconds min_backoff{500};
+    std::chrono::milliseconds max_backoff{30000};
+  };
+
+  struct Stats {
+    uint64_t requests;
+    uint64_t resumes;           // requests that continued from a checkpoint
+    uint64_t bytes_downloaded;  // body bytes, refetched ones included
+    uint64_t target_bytes;      // on flash
+  };
+
+  using CheckpointHandler =
+      std::function<void(const UpdateStream::Checkpoint& checkpoint)>;
+
+  OtaUpdater(FlashPartition& base, FlashPartition& target, Config config);
+  OtaUpdater(FlashPartition& base, FlashPartition& target)
+      : OtaUpdater(base, target, Config{}) {}
+
+  // Blocks the calling thread until the update is on flash or has failed.
+  // `expected_sha256` is the target image's digest from the update check;
+  // `resume` continues from a checkpoint saved by an earlier run.
+  Status run(const Url& url, const Sha256::Digest& expected_sha256,
+             const CheckpointHandler& on_checkpoint,
+             const std::optional<UpdateStream::Checkpoint>& resume = {});
+
+  // Why the last run() stopped, at the UpdateStream level.
+  UpdateStream::Status stream_status() const { return stream_status_; }
+
+  // Any thread.
+  Stats stats() const;
+
+ private:
+  FlashPartition& base_;
+  FlashPartition& target_;
+  Config config_;
+  HttpFetch fetch_;
+  UpdateStream::Status stream_status_ = UpdateStream::Status::kRunning;
+
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> resumes_{0};
+  std::atomic<uint64_t> bytes_downloaded_{0};
+  std::atomic<uint64_t> target_bytes_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_OTA_OTA_UPDATER_H_
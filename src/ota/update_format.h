@@ -0,0 +1,64 @@
+#ifndef XIAOZI_OTA_UPDATE_FORMAT_H_
+#define XIAOZI_OTA_UPDATE_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xiaozi {
+
+// Layout of an update file, as written by UpdateWriter and applied by
+// UpdateStream. All integers little-endian.
+//
+//   Header | payload
+//
+// A compressed payload is a run of blocks, each BlockHeader followed by
+// packed_bytes of LZ4-format data (or raw_bytes stored as is when
+// packed_bytes is 0); every block decodes on its own, so the device needs
+// one block of RAM and a download can resume at any block boundary.
+//
+// A kFull payload decodes to the target image. A kDelta payload decodes
+// to bsdiff-style records against the base image:
+//
+//   varint add_len | varint copy_len | zigzag varint seek
+//   add_len bytes:  target byte = base[pos++] + this byte (mod 256)
+//   copy_len bytes: target byte = this byte
+//   then pos += seek
+//
+// pos starts at 0. Most add bytes are zero, which the block compression
+// then removes.
+namespace ota {
+
+inline constexpr char kMagic[4] = {'X', 'Z', 'U', 'P'};
+inline constexpr uint16_t kVersion = 1;
+
+enum class Kind : uint16_t { kFull = 0, kDelta = 1 };
+
+inline constexpr uint32_t kCompressed = 1;  // Header::flags
+
+struct Header {
+  char magic[4];
+  uint16_t version;
+  Kind kind;
+  uint32_t flags;
+  uint32_t block_bytes;  // largest raw block
+  uint64_t base_size;    // kDelta only
+  uint64_t target_size;
+  uint8_t base_sha256[32];
+  uint8_t target_sha256[32];
+};
+static_assert(sizeof(Header) == 96);
+
+struct BlockHeader {
+  uint32_t raw_bytes;
+  uint32_t packed_bytes;
+};
+static_assert(sizeof(BlockHeader) == 8);
+
+inline constexpr uint32_t kDefaultBlockBytes = 16 * 1024;
+// Upper bound the device accepts for Header::block_bytes.
+inline constexpr uint32_t kMaxBlockBytes = 64 * 1024;
+
+}  // namespace ota
+}  // namespace xiaozi
+
+#endif  // XIAOZI_OTA_UPDATE_FORMAT_H_
@@ -0,0 +1,329 @@
+#include "ota/update_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ota/lz_block.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr std::size_t kRehashBytes = 4096;
+
+bool valid_header(const ota::Header& h) {
+  return std::memcmp(h.magic, ota::kMagic, sizeof(h.magic)) == 0 &&
+         h.version == ota::kVersion &&
+         (h.kind == ota::Kind::kFull || h.kind == ota::Kind::kDelta) &&
+         (h.flags & ~ota::kCompressed) == 0 && h.block_bytes != 0 &&
+         h.block_bytes <= ota::kMaxBlockBytes;
+}
+
+}  // namespace
+
+UpdateStream::UpdateStream(FlashPartition& base, FlashPartition& target,
+                           const Config& config)
+    : base_(base),
+      target_(target),
+      config_(config),
+      writer_(target, 0, config.write_buffer_bytes) {}
+
+UpdateStream::UpdateStream(FlashPartition& base, FlashPartition& target,
+                           const Config& config, const Checkpoint& resume)
+    : base_(base),
+      target_(target),
+      config_(config),
+      writer_(target, resume.target_offset, config.write_buffer_bytes),
+      checkpoint_(resume),
+      have_header_(true),
+      header_(resume.header),
+      header_fill_(sizeof(ota::Header)),
+      file_offset_(resume.file_offset),
+      target_offset_(resume.target_offset),
+      phase_(static_cast<Phase>(resume.phase)),
+      varint_(resume.varint),
+      varint_shift_(resume.varint_shift),
+      base_pos_(resume.base_pos),
+      add_left_(resume.add_left),
+      copy_left_(resume.copy_left),
+      seek_(resume.seek) {
+  if (!valid_header(header_) || resume.phase > kCopy ||
+      target_offset_ > header_.target_size ||
+      base_pos_ > header_.base_size) {
+    status_ = Status::kBadHeader;
+    return;
+  }
+  if (!trusted()) {
+    status_ = Status::kUntrusted;
+    return;
+  }
+  allocate();
+  if (!rehash_target()) status_ = Status::kFlashError;
+}
+
+std::size_t UpdateStream::window_bytes() const {
+  return packed_.capacity() + raw_.capacity() + base_buffer_.capacity() +
+         config_.write_buffer_bytes;
+}
+
+UpdateStream::Status UpdateStream::feed(std::span<const uint8_t> bytes) {
+  if (status_ != Status::kRunning) return status_;
+  stats_.file_bytes += bytes.size();
+  if (!have_header_) {
+    if (!read_header(bytes)) return status_;
+    if (bytes.empty()) return status_;
+  }
+  if (header_.flags & ota::kCompressed) {
+    feed_blocks(bytes);
+  } else if (payload(bytes)) {
+    file_offset_ += bytes.size();
+    end_of_chunk();
+  }
+  return status_;
+}
+
+bool UpdateStream::read_header(std::span<const uint8_t>& bytes) {
+  const std::size_t take =
+      std::min(bytes.size(), sizeof(ota::Header) - header_fill_);
+  std::memcpy(reinterpret_cast<uint8_t*>(&header_) + header_fill_,
+              bytes.data(), take);
+  header_fill_ += take;
+  bytes = bytes.subspan(take);
+  if (header_fill_ < sizeof(ota::Header)) return true;
+
+  if (!valid_header(header_) || header_.target_size > target_.size() ||
+      (header_.kind == ota::Kind::kDelta &&
+       header_.base_size > base_.size())) {
+    status_ = Status::kBadHeader;
+    return false;
+  }
+  if (!trusted()) {
+    status_ = Status::kUntrusted;
+    return false;
+  }
+  allocate();
+  if (header_.kind == ota::Kind::kDelta && !verify_base()) return false;
+  have_header_ = true;
+  file_offset_ = sizeof(ota::Header);
+  end_of_chunk();
+  if (header_.target_size == 0) output({});
+  return status_ == Status::kRunning || status_ == Status::kDone;
+}
+
+bool UpdateStream::trusted() const {
+  return !config_.expected_sha256 ||
+         std::memcmp(config_.expected_sha256->data(), header_.target_sha256,
+                     sizeof(header_.target_sha256)) == 0;
+}
+
+void UpdateStream::allocate() {
+  if (header_.flags & ota::kCompressed) {
+    packed_.resize(lz_bound(header_.block_bytes));
+    raw_.resize(header_.block_bytes);
+  }
+  if (header_.kind == ota::Kind::kDelta) {
+    base_buffer_.resize(std::max<std::size_t>(config_.base_read_bytes, 64));
+  }
+}
+
+bool UpdateStream::verify_base() {
+  Sha256 sha;
+  for (uint64_t at = 0; at < header_.base_size;) {
+    const auto n = static_cast<std::size_t>(
+        std::min<uint64_t>(base_buffer_.size(), header_.base_size - at));
+    if (!base_.read(at, {base_buffer_.data(), n})) {
+      status_ = Status::kFlashError;
+      return false;
+    }
+    sha.update({base_buffer_.data(), n});
+    at += n;
+  }
+  if (std::memcmp(sha.finish().data(), header_.base_sha256,
+                  sizeof(header_.base_sha256)) != 0) {
+    status_ = Status::kBadBase;
+    return false;
+  }
+  return true;
+}
+
+bool UpdateStream::rehash_target() {
+  uint8_t buf[kRehashBytes];
+  for (uint64_t at = 0; at < target_offset_;) {
+    const auto n = static_cast<std::size_t>(
+        std::min<uint64_t>(sizeof(buf), target_offset_ - at));
+    if (!target_.read(at, {buf, n})) return false;
+    sha_.update({buf, n});
+    at += n;
+  }
+  return true;
+}
+
+bool UpdateStream::feed_blocks(std::span<const uint8_t> bytes) {
+  while (!bytes.empty() && status_ == Status::kRunning) {
+    if (block_header_fill_ < sizeof(ota::BlockHeader)) {
+      const std::size_t take = std::min(
+          bytes.size(), sizeof(ota::BlockHeader) - block_header_fill_);
+      std::memcpy(reinterpret_cast<uint8_t*>(&block_) + block_header_fill_,
+                  bytes.data(), take);
+      block_header_fill_ += take;
+      bytes = bytes.subspan(take);
+      if (block_header_fill_ < sizeof(ota::BlockHeader)) break;
+      const std::size_t stored =
+          block_.packed_bytes == 0 ? block_.raw_bytes : block_.packed_bytes;
+      if (block_.raw_bytes == 0 || block_.raw_bytes > raw_.size() ||
+          stored > packed_.size()) {
+        status_ = Status::kCorrupt;
+        return false;
+      }
+      packed_fill_ = 0;
+    }
+    const std::size_t stored =
+        block_.packed_bytes == 0 ? block_.raw_bytes : block_.packed_bytes;
+    const std::size_t take = std::min(bytes.size(), stored - packed_fill_);
+    std::memcpy(packed_.data() + packed_fill_, bytes.data(), take);
+    packed_fill_ += take;
+    bytes = bytes.subspan(take);
+    if (packed_fill_ < stored) break;
+
+    std::span<const uint8_t> raw{packed_.data(), block_.raw_bytes};
+    if (block_.packed_bytes != 0) {
+      if (!lz_decompress({packed_.data(), stored},
+                         {raw_.data(), block_.raw_bytes})) {
+        status_ = Status::kCorrupt;
+        return false;
+      }
+      raw = {raw_.data(), block_.raw_bytes};
+    }
+    if (!payload(raw)) return false;
+    ++stats_.blocks;
+    file_offset_ += sizeof(ota::BlockHeader) + stored;
+    block_header_fill_ = 0;
+    end_of_chunk();
+  }
+  return status_ == Status::kRunning || status_ == Status::kDone;
+}
+
+bool UpdateStream::payload(std::span<const uint8_t> data) {
+  if (header_.kind == ota::Kind::kFull) return output(data);
+  return delta(data);
+}
+
+bool UpdateStream::delta(std::span<const uint8_t> data) {
+  while (!data.empty() && status_ == Status::kRunning) {
+    switch (phase_) {
+      case kAddLen:
+      case kCopyLen:
+      case kSeek: {
+        const uint8_t b = data[0];
+        data = data.subspan(1);
+        if (varint_shift_ > 63) {
+          status_ = Status::kCorrupt;
+          return false;
+        }
+        varint_ |= uint64_t{b & 0x7fu} << varint_shift_;
+        varint_shift_ = static_cast<uint8_t>(varint_shift_ + 7);
+        if (b & 0x80) break;
+        const uint64_t v = varint_;
+        varint_ = 0;
+        varint_shift_ = 0;
+        if (phase_ == kAddLen) {
+          add_left_ = v;
+          phase_ = kCopyLen;
+        } else if (phase_ == kCopyLen) {
+          copy_left_ = v;
+          phase_ = kSeek;
+        } else {
+          seek_ = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+          if (add_left_ > header_.base_size - base_pos_) {
+            status_ = Status::kCorrupt;
+            return false;
+          }
+          phase_ = add_left_ != 0 ? kAdd : kCopy;
+        }
+        break;
+      }
+      case kAdd: {
+        const auto n = static_cast<std::size_t>(std::min<uint64_t>(
+            {add_left_, data.size(), base_buffer_.size()}));
+        if (!base_.read(base_pos_, {base_buffer_.data(), n})) {
+          status_ = Status::kFlashError;
+          return false;
+        }
+        stats_.base_bytes_read += n;
+        for (std::size_t i = 0; i < n; ++i) base_buffer_[i] += data[i];
+        if (!output({base_buffer_.data(), n})) return false;
+        data = data.subspan(n);
+        base_pos_ += n;
+        add_left_ -= n;
+        if (add_left_ == 0) phase_ = kCopy;
+        break;
+      }
+      case kCopy: {
+        const auto n = static_cast<std::size_t>(
+            std::min<uint64_t>(copy_left_, data.size()));
+        if (!output(data.first(n))) return false;
+        data = data.subspan(n);
+        copy_left_ -= n;
+        break;
+      }
+    }
+    if (phase_ == kCopy && copy_left_ == 0) {
+      const int64_t pos = static_cast<int64_t>(base_pos_) + seek_;
+      if (pos < 0 || static_cast<uint64_t>(pos) > header_.base_size) {
+        status_ = Status::kCorrupt;
+        return false;
+      }
+      base_pos_ = static_cast<uint64_t>(pos);
+      phase_ = kAddLen;
+    }
+  }
+  return status_ == Status::kRunning || status_ == Status::kDone;
+}
+
+bool UpdateStream::output(std::span<const uint8_t> data) {
+  if (data.size() > header_.target_size - target_offset_) {
+    status_ = Status::kCorrupt;
+    return false;
+  }
+  sha_.update(data);
+  // The last bytes are held back until the whole image hashes right.
+  const bool last = data.size() == header_.target_size - target_offset_;
+  if (last && std::memcmp(sha_.finish().data(), header_.target_sha256,
+                          sizeof(header_.target_sha256)) != 0) {
+    status_ = Status::kHashMismatch;
+    return false;
+  }
+  if (!writer_.write(data)) {
+    status_ = Status::kFlashError;
+    return false;
+  }
+  target_offset_ += data.size();
+  stats_.target_bytes += data.size();
+  if (last) {
+    if (!writer_.flush()) {
+      status_ = Status::kFlashError;
+      return false;
+    }
+    status_ = Status::kDone;
+  }
+  return true;
+}
+
+void UpdateStream::end_of_chunk() {
+  if (status_ != Status::kRunning) return;
+  if (!writer_.flush()) {
+    status_ = Status::kFlashError;
+    return;
+  }
+  checkpoint_.header = header_;
+  checkpoint_.file_offset = file_offset_;
+  checkpoint_.target_offset = target_offset_;
+  checkpoint_.base_pos = base_pos_;
+  checkpoint_.add_left = add_left_;
+  checkpoint_.copy_left = copy_left_;
+  checkpoint_.seek = seek_;
+  checkpoint_.varint = varint_;
+  checkpoint_.varint_shift = varint_shift_;
+  checkpoint_.phase = phase_;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,143 @@
+#ifndef XIAOZI_OTA_UPDATE_STREAM_H_
+#define XIAOZI_OTA_UPDATE_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "base/sha256.h"
+#include "ota/flash_partition.h"
+#include "ota/update_format.h"
+
+namespace xiaozi {
+
+// Applies an update file (ota/update_format.h) to the inactive partition
+// while it downloads: feed() takes the file's bytes in whatever pieces the
+// network delivers, decodes them one block at a time, applies delta
+// records against the running image in `base`, and writes the result
+// straight to `target`. Nothing is staged beyond one block, so RAM use is
+// window_bytes() whatever the image size. The target's SHA-256 is hashed
+// as it is written and checked before the last bytes are: an image that
+// does not match never reaches flash whole.
+//
+// The header's digest only shows the file is intact, since whoever served
+// the file wrote it too. Config::expected_sha256 ties the file to the
+// image an authenticated update check announced; a header naming any
+// other image is refused before anything is written.
+//
+// After every block (or every feed() for an uncompressed file) the
+// target's writes are flushed and checkpoint() moves forward. A new
+// UpdateStream built from a saved checkpoint carries on from there; the
+// caller fetches the file again from Checkpoint::file_offset.
+class UpdateStream {
+ public:
+  enum class Status {
+    kRunning,
+    kDone,
+    kBadHeader,     // not an update file, or too large for the partition
+    kBadBase,       // delta made against another image than `base`
+    kCorrupt,       // malformed block or record
+    kFlashError,
+    kHashMismatch,  // complete, but not the image the header names
+    kUntrusted,     // names another image than Config::expected_sha256
+  };
+
+  struct Config {
+    std::size_t write_buffer_bytes = 4096;
+    std::size_t base_read_bytes = 4096;
+    std::optional<Sha256::Digest> expected_sha256;
+  };
+
+  // Plain data; the caller persists it (e.g. in the settings store).
+  struct Checkpoint {
+    ota::Header header;
+    uint64_t file_offset;    // next byte of the update file to feed
+    uint64_t target_offset;  // bytes already on flash
+    // Delta record decoder.
+    uint64_t base_pos;
+    uint64_t add_left;
+    uint64_t copy_left;
+    int64_t seek;
+    uint64_t varint;
+    uint8_t varint_shift;
+    uint8_t phase;
+  };
+
+  struct Stats {
+    uint64_t file_bytes;
+    uint64_t blocks;
+    uint64_t target_bytes;
+    uint64_t base_bytes_read;
+  };
+
+  UpdateStream(FlashPartition& base, FlashPartition& target,
+               const Config& config);
+  UpdateStream(FlashPartition& base, FlashPartition& target)
+      : UpdateStream(base, target, Config{}) {}
+  // Continues from `resume`.
+  UpdateStream(FlashPartition& base, FlashPartition& target,
+               const Config& config, const Checkpoint& resume);
+
+  Status feed(std::span<const uint8_t> bytes);
+
+  Status status() const { return status_; }
+  // Valid once the header has been read.
+  const Checkpoint& checkpoint() const { return checkpoint_; }
+  // Heap held for buffers, the decode window included.
+  std::size_t window_bytes() const;
+  Stats stats() const { return stats_; }
+
+ private:
+  enum Phase : uint8_t { kAddLen, kCopyLen, kSeek, kAdd, kCopy };
+
+  bool read_header(std::span<const uint8_t>& bytes);
+  bool trusted() const;
+  void allocate();
+  bool verify_base();
+  bool feed_blocks(std::span<const uint8_t> bytes);
+  bool payload(std::span<const uint8_t> data);
+  bool delta(std::span<const uint8_t> data);
+  bool output(std::span<const uint8_t> data);
+  bool rehash_target();
+  void end_of_chunk();
+
+  FlashPartition& base_;
+  FlashPartition& target_;
+  Config config_;
+  FlashWriter writer_;
+  Sha256 sha_;
+  Status status_ = Status::kRunning;
+  Checkpoint checkpoint_{};
+
+  // Reading the header, then decoding.
+  bool have_header_ = false;
+  ota::Header header_{};
+  std::size_t header_fill_ = 0;
+  uint64_t file_offset_ = 0;
+  uint64_t target_offset_ = 0;
+
+  // Compressed payload: the block being gathered.
+  ota::BlockHeader block_{};
+  std::size_t block_header_fill_ = 0;
+  std::vector<uint8_t> packed_;
+  std::size_t packed_fill_ = 0;
+  std::vector<uint8_t> raw_;
+
+  // Delta records.
+  std::vector<uint8_t> base_buffer_;
+  Phase phase_ = kAddLen;
+  uint64_t varint_ = 0;
+  uint8_t varint_shift_ = 0;
+  uint64_t base_pos_ = 0;
+  uint64_t add_left_ = 0;
+  uint64_t copy_left_ = 0;
+  int64_t seek_ = 0;
+
+  Stats stats_{};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_OTA_UPDATE_STREAM_H_
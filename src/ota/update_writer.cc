@@ -0,0 +1,273 @@
+#include "ota/update_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "base/sha256.h"
+#include "ota/lz_block.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr uint32_t kMinBlockBytes = 4096;
+// Characters packed into the first sort key, 9 bits each (0 past the end).
+constexpr int kKeyChars = 7;
+
+template <typename T>
+void append(std::vector<uint8_t>& out, const T& value) {
+  const auto* p = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), p, p + sizeof(T));
+}
+
+void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+  for (; v >= 0x80; v >>= 7) out.push_back(static_cast<uint8_t>(v | 0x80));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+// Suffix array of `s`, the empty suffix first, by prefix doubling: sort on
+// the first kKeyChars bytes, then refine each tied group by the rank h
+// bytes further on, doubling h until every rank is distinct.
+std::vector<int32_t> suffix_array(std::span<const uint8_t> s) {
+  const auto n = static_cast<int32_t>(s.size());
+  const std::size_t count = s.size() + 1;
+  std::vector<int32_t> sa(count);
+  std::vector<int32_t> rank(count);
+  {
+    std::vector<uint64_t> key(count);
+    for (int32_t i = 0; i <= n; ++i) {
+      uint64_t k = 0;
+      for (int c = 0; c < kKeyChars; ++c) {
+        k = k << 9 | (i + c < n ? s[i + c] + 1u : 0u);
+      }
+      key[i] = k;
+    }
+    for (int32_t i = 0; i <= n; ++i) sa[i] = i;
+    std::sort(sa.begin(), sa.end(),
+              [&](int32_t a, int32_t b) { return key[a] < key[b]; });
+    // A suffix's rank is where its group starts in `sa`.
+    for (std::size_t j = 0; j < count; ++j) {
+      rank[sa[j]] = j > 0 && key[sa[j]] == key[sa[j - 1]]
+                        ? rank[sa[j - 1]]
+                        : static_cast<int32_t>(j);
+    }
+  }
+
+  std::vector<int32_t> next(rank);
+  for (int32_t h = kKeyChars;; h *= 2) {
+    // Suffixes shorter than h are already unique and sort first.
+    auto later = [&](int32_t i) { return i + h <= n ? rank[i + h] : -1; };
+    bool tied = false;
+    for (std::size_t a = 0; a < count;) {
+      std::size_t b = a + 1;
+      while (b < count && rank[sa[b]] == rank[sa[a]]) ++b;
+      if (b - a > 1) {
+        tied = true;
+        std::sort(sa.begin() + a, sa.begin() + b, [&](int32_t x, int32_t y) {
+          return later(x) < later(y);
+        });
+        for (std::size_t j = a; j < b; ++j) {
+          next[sa[j]] = j > a && later(sa[j]) == later(sa[j - 1])
+                            ? next[sa[j - 1]]
+                            : static_cast<int32_t>(j);
+        }
+      }
+      a = b;
+    }
+    if (!tied) break;
+    rank = next;
+  }
+  return sa;
+}
+
+std::size_t match_length(std::span<const uint8_t> a,
+                         std::span<const uint8_t> b) {
+  const std::size_t n = std::min(a.size(), b.size());
+  std::size_t i = 0;
+  while (i < n && a[i] == b[i]) ++i;
+  return i;
+}
+
+// Longest match for `target` among the suffixes of `base`; binary search
+// over `sa` as in bsdiff.
+std::size_t search(const std::vector<int32_t>& sa,
+                   std::span<const uint8_t> base,
+                   std::span<const uint8_t> target, std::size_t& pos) {
+  std::size_t lo = 0;
+  std::size_t hi = sa.size() - 1;
+  while (hi - lo >= 2) {
+    const std::size_t mid = lo + (hi - lo) / 2;
+    const auto suffix = base.subspan(sa[mid]);
+    const std::size_t n = std::min(suffix.size(), target.size());
+    if (std::memcmp(suffix.data(), target.data(), n) < 0) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  const std::size_t x = match_length(base.subspan(sa[lo]), target);
+  const std::size_t y = match_length(base.subspan(sa[hi]), target);
+  pos = static_cast<std::size_t>(x > y ? sa[lo] : sa[hi]);
+  return std::max(x, y);
+}
+
+// bsdiff's scan: find the next match that beats extending the current
+// alignment by more than 8 bytes, then split the gap between the two into
+// a forward extension of the old match, literal bytes, and a backward
+// extension of the new one.
+std::vector<uint8_t> diff_records(std::span<const uint8_t> base,
+                                  std::span<const uint8_t> target) {
+  const std::vector<int32_t> sa = suffix_array(base);
+  const auto old_size = static_cast<int64_t>(base.size());
+  const auto new_size = static_cast<int64_t>(target.size());
+  std::vector<uint8_t> out;
+
+  int64_t scan = 0;
+  int64_t len = 0;
+  int64_t pos = 0;
+  int64_t last_scan = 0;
+  int64_t last_pos = 0;
+  int64_t last_offset = 0;
+  auto old_agrees = [&](int64_t at) {
+    return at + last_offset < old_size &&
+           base[at + last_offset] == target[at];
+  };
+  while (scan < new_size) {
+    int64_t old_score = 0;
+    scan += len;
+    for (int64_t scsc = scan; scan < new_size; ++scan) {
+      std::size_t match_pos;
+      len = static_cast<int64_t>(
+          search(sa, base, target.subspan(scan), match_pos));
+      pos = static_cast<int64_t>(match_pos);
+      for (; scsc < scan + len; ++scsc) {
+        if (old_agrees(scsc)) ++old_score;
+      }
+      if ((len == old_score && len != 0) || len > old_score + 8) break;
+      if (old_agrees(scan)) --old_score;
+    }
+    if (len == old_score && scan != new_size) continue;
+
+    int64_t forward = 0;
+    for (int64_t i = 0, s = 0, best = 0;
+         last_scan + i < scan && last_pos + i < old_size;) {
+      if (base[last_pos + i] == target[last_scan + i]) ++s;
+      ++i;
+      if (s * 2 - i > best * 2 - forward) {
+        best = s;
+        forward = i;
+      }
+    }
+    int64_t backward = 0;
+    if (scan < new_size) {
+      for (int64_t i = 1, s = 0, best = 0;
+           scan >= last_scan + i && pos >= i; ++i) {
+        if (base[pos - i] == target[scan - i]) ++s;
+        if (s * 2 - i > best * 2 - backward) {
+          best = s;
+          backward = i;
+        }
+      }
+    }
+    if (last_scan + forward > scan - backward) {
+      const int64_t overlap = last_scan + forward - (scan - backward);
+      int64_t s = 0;
+      int64_t best = 0;
+      int64_t split = 0;
+      for (int64_t i = 0; i < overlap; ++i) {
+        if (target[last_scan + forward - overlap + i] ==
+            base[last_pos + forward - overlap + i]) {
+          ++s;
+        }
+        if (target[scan - backward + i] == base[pos - backward + i]) --s;
+        if (s > best) {
+          best = s;
+          split = i + 1;
+        }
+      }
+      forward += split - overlap;
+      backward -= split;
+    }
+
+    const int64_t literal = scan - backward - (last_scan + forward);
+    const int64_t seek = pos - backward - (last_pos + forward);
+    put_varint(out, static_cast<uint64_t>(forward));
+    put_varint(out, static_cast<uint64_t>(literal));
+    put_varint(out, static_cast<uint64_t>(seek) << 1 ^
+                        static_cast<uint64_t>(seek >> 63));
+    for (int64_t i = 0; i < forward; ++i) {
+      out.push_back(
+          static_cast<uint8_t>(target[last_scan + i] - base[last_pos + i]));
+    }
+    out.insert(out.end(), target.begin() + last_scan + forward,
+               target.begin() + last_scan + forward + literal);
+
+    last_scan = scan - backward;
+    last_pos = pos - backward;
+    last_offset = pos - scan;
+  }
+  return out;
+}
+
+}  // namespace
+
+UpdateWriter::UpdateWriter(Config config) : config_(config) {
+  config_.block_bytes =
+      std::clamp(config_.block_bytes, kMinBlockBytes, ota::kMaxBlockBytes);
+}
+
+std::vector<uint8_t> UpdateWriter::full(
+    std::span<const uint8_t> target) const {
+  ota::Header header{};
+  header.kind = ota::Kind::kFull;
+  header.target_size = target.size();
+  const Sha256::Digest digest = Sha256::of(target);
+  std::memcpy(header.target_sha256, digest.data(), digest.size());
+  return finish(header, target);
+}
+
+std::vector<uint8_t> UpdateWriter::delta(
+    std::span<const uint8_t> base, std::span<const uint8_t> target) const {
+  ota::Header header{};
+  header.kind = ota::Kind::kDelta;
+  header.base_size = base.size();
+  header.target_size = target.size();
+  Sha256::Digest digest = Sha256::of(base);
+  std::memcpy(header.base_sha256, digest.data(), digest.size());
+  digest = Sha256::of(target);
+  std::memcpy(header.target_sha256, digest.data(), digest.size());
+  return finish(header, diff_records(base, target));
+}
+
+std::vector<uint8_t> UpdateWriter::finish(
+    ota::Header header, std::span<const uint8_t> payload) const {
+  std::memcpy(header.magic, ota::kMagic, sizeof(header.magic));
+  header.version = ota::kVersion;
+  header.flags = config_.compress ? ota::kCompressed : 0;
+  header.block_bytes = config_.block_bytes;
+
+  std::vector<uint8_t> out;
+  append(out, header);
+  if (!config_.compress) {
+    out.insert(out.end(), payload.begin(), payload.end());
+    return out;
+  }
+  for (std::size_t at = 0; at < payload.size(); at += config_.block_bytes) {
+    const auto raw = payload.subspan(
+        at, std::min<std::size_t>(config_.block_bytes, payload.size() - at));
+    const std::size_t header_at = out.size();
+    append(out, ota::BlockHeader{});
+    const std::size_t packed = lz_compress(raw, out);
+    ota::BlockHeader block{static_cast<uint32_t>(raw.size()),
+                           static_cast<uint32_t>(packed)};
+    if (packed >= raw.size()) {
+      // Stored: incompressible data must not grow.
+      out.resize(header_at + sizeof(block));
+      out.insert(out.end(), raw.begin(), raw.end());
+      block.packed_bytes = 0;
+    }
+    std::memcpy(out.data() + header_at, &block, sizeof(block));
+  }
+  return out;
+}
+
+}  // namespace xiaozi
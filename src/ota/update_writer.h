@@ -0,0 +1,44 @@
+#ifndef XIAOZI_OTA_UPDATE_WRITER_H_
+#define XIAOZI_OTA_UPDATE_WRITER_H_
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "ota/update_format.h"
+
+namespace xiaozi {
+
+// Builds update files (see update_format.h) for UpdateStream. Offline
+// only: used by xiaozi_mkota and benchmarks.
+class UpdateWriter {
+ public:
+  struct Config {
+    bool compress = true;
+    // Raw bytes per block, clamped to [4 KiB, ota::kMaxBlockBytes]. The
+    // device holds one packed and one raw block.
+    uint32_t block_bytes = ota::kDefaultBlockBytes;
+  };
+
+  explicit UpdateWriter(Config config);
+  UpdateWriter() : UpdateWriter(Config{}) {}
+
+  // The whole of `target`.
+  std::vector<uint8_t> full(std::span<const uint8_t> target) const;
+  // `target` as bsdiff records against `base`: matches found through a
+  // suffix array of `base`, extended while at least half the bytes agree,
+  // so code that moved or had its addresses shifted costs a few bytes of
+  // differences instead of a copy.
+  std::vector<uint8_t> delta(std::span<const uint8_t> base,
+                             std::span<const uint8_t> target) const;
+
+ private:
+  std::vector<uint8_t> finish(ota::Header header,
+                              std::span<const uint8_t> payload) const;
+
+  Config config_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_OTA_UPDATE_WRITER_H_
@@ -0,0 +1,405 @@
+#include "protocol/json.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace xiaozi {
+namespace {
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool read_hex4(const char* p, uint32_t* out) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; ++i) {
+    const int h = hex_value(p[i]);
+    if (h < 0) return false;
+    v = v << 4 | static_cast<uint32_t>(h);
+  }
+  *out = v;
+  return true;
+}
+
+char* put_utf8(char* out, uint32_t cp) {
+  if (cp < 0x80) {
+    *out++ = static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    *out++ = static_cast<char>(0xc0 | cp >> 6);
+    *out++ = static_cast<char>(0x80 | (cp & 0x3f));
+  } else if (cp < 0x10000) {
+    *out++ = static_cast<char>(0xe0 | cp >> 12);
+    *out++ = static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+    *out++ = static_cast<char>(0x80 | (cp & 0x3f));
+  } else {
+    *out++ = static_cast<char>(0xf0 | cp >> 18);
+    *out++ = static_cast<char>(0x80 | (cp >> 12 & 0x3f));
+    *out++ = static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+    *out++ = static_cast<char>(0x80 | (cp & 0x3f));
+  }
+  return out;
+}
+
+// Decodes the escaped string body [p, end) into `out`; the source was
+// validated by the scan, except for the escapes themselves.
+char* unescape(const char* p, const char* end, char* out) {
+  while (p < end) {
+    if (*p != '\\') {
+      *out++ = *p++;
+      continue;
+    }
+    const char c = p[1];
+    p += 2;
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        *out++ = c;
+        break;
+      case 'b':
+        *out++ = '\b';
+        break;
+      case 'f':
+        *out++ = '\f';
+        break;
+      case 'n':
+        *out++ = '\n';
+        break;
+      case 'r':
+        *out++ = '\r';
+        break;
+      case 't':
+        *out++ = '\t';
+        break;
+      case 'u': {
+        uint32_t cp;
+        if (end - p < 4 || !read_hex4(p, &cp)) return nullptr;
+        p += 4;
+        if (cp >= 0xd800 && cp < 0xdc00) {
+          uint32_t low;
+          if (end - p >= 6 && p[0] == '\\' && p[1] == 'u' &&
+              read_hex4(p + 2, &low) && low >= 0xdc00 && low < 0xe000) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            p += 6;
+          } else {
+            cp = 0xfffd;
+          }
+        } else if (cp >= 0xdc00 && cp < 0xe000) {
+          cp = 0xfffd;
+        }
+        out = put_utf8(out, cp);
+        break;
+      }
+      default:
+        return nullptr;
+    }
+  }
+  return out;
+}
+
+}  // namespace
+
+bool JsonValue::as_bool(bool fallback) const {
+  return type_ == Type::kBool ? size_ != 0 : fallback;
+}
+
+std::optional<double> JsonValue::as_double() const {
+  if (type_ != Type::kNumber) return std::nullopt;
+  const char* p = static_cast<const char*>(data_);
+  double v;
+  auto [end, ec] = std::from_chars(p, p + size_, v);
+  if (ec != std::errc() || end != p + size_) return std::nullopt;
+  return v;
+}
+
+std::optional<int64_t> JsonValue::as_int() const {
+  if (type_ != Type::kNumber) return std::nullopt;
+  const char* p = static_cast<const char*>(data_);
+  int64_t v;
+  auto [end, ec] = std::from_chars(p, p + size_, v);
+  if (ec != std::errc() || end != p + size_) return std::nullopt;
+  return v;
+}
+
+std::string_view JsonValue::as_string() const {
+  if (type_ != Type::kString) return {};
+  return {static_cast<const char*>(data_), size_};
+}
+
+std::string_view JsonValue::number_text() const {
+  if (type_ != Type::kNumber) return {};
+  return {static_cast<const char*>(data_), size_};
+}
+
+std::span<const JsonValue> JsonValue::items() const {
+  if (type_ != Type::kArray) return {};
+  return {static_cast<const JsonValue*>(data_), size_};
+}
+
+std::span<const JsonMember> JsonValue::members() const {
+  if (type_ != Type::kObject) return {};
+  return {static_cast<const JsonMember*>(data_), size_};
+}
+
+const JsonValue* JsonValue::find(std::string_view key) const {
+  for (const JsonMember& m : members()) {
+    if (m.key == key) return &m.value;
+  }
+  return nullptr;
+}
+
+std::string_view JsonValue::string_at(std::string_view key) const {
+  const JsonValue* v = find(key);
+  return v != nullptr ? v->as_string() : std::string_view();
+}
+
+JsonParser::JsonParser(Config config) : config_(config) {
+  values_.reserve(64);
+  members_.reserve(64);
+}
+
+const JsonValue* JsonParser::parse(std::string_view text, Arena& arena) {
+  begin_ = p_ = text.data();
+  end_ = text.data() + text.size();
+  arena_ = &arena;
+  values_.clear();
+  members_.clear();
+  error_offset_ = 0;
+  JsonValue root;
+  skip_space();
+  if (!parse_value(root, 0)) return nullptr;
+  skip_space();
+  if (p_ != end_) {
+    fail();
+    return nullptr;
+  }
+  return arena.make<JsonValue>(root);
+}
+
+bool JsonParser::fail() {
+  error_offset_ = static_cast<std::size_t>(p_ - begin_);
+  return false;
+}
+
+void JsonParser::skip_space() {
+  while (p_ < end_ &&
+         (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) {
+    ++p_;
+  }
+}
+
+bool JsonParser::literal(std::string_view word) {
+  if (static_cast<std::size_t>(end_ - p_) < word.size() ||
+      std::memcmp(p_, word.data(), word.size()) != 0) {
+    return fail();
+  }
+  p_ += word.size();
+  return true;
+}
+
+bool JsonParser::parse_value(JsonValue& out, std::size_t depth) {
+  if (p_ == end_) return fail();
+  switch (*p_) {
+    case '{':
+      return parse_object(out, depth + 1);
+    case '[':
+      return parse_array(out, depth + 1);
+    case '"': {
+      std::string_view s;
+      if (!parse_string(s)) return false;
+      out.type_ = JsonValue::Type::kString;
+      out.data_ = s.data();
+      out.size_ = static_cast<uint32_t>(s.size());
+      return true;
+    }
+    case 't':
+      out.type_ = JsonValue::Type::kBool;
+      out.size_ = 1;
+      return literal("true");
+    case 'f':
+      out.type_ = JsonValue::Type::kBool;
+      out.size_ = 0;
+      return literal("false");
+    case 'n':
+      out.type_ = JsonValue::Type::kNull;
+      return literal("null");
+    default:
+      return parse_number(out);
+  }
+}
+
+bool JsonParser::parse_string(std::string_view& out) {
+  const char* start = ++p_;  // past the opening quote
+  bool escaped = false;
+  while (p_ < end_ && *p_ != '"') {
+    const auto c = static_cast<unsigned char>(*p_);
+    if (c < 0x20) return fail();
+    if (c == '\\') {
+      escaped = true;
+      if (++p_ == end_) return fail();
+    }
+    ++p_;
+  }
+  if (p_ == end_) return fail();
+  const char* stop = p_++;
+  if (!escaped) {
+    out = {start, static_cast<std::size_t>(stop - start)};
+    return true;
+  }
+  const auto raw = static_cast<std::size_t>(stop - start);
+  auto* buf = static_cast<char*>(arena_->allocate(raw, 1));
+  if (buf == nullptr) return fail();
+  char* last = unescape(start, stop, buf);
+  if (last == nullptr) {
+    p_ = start;
+    return fail();
+  }
+  out = {buf, static_cast<std::size_t>(last - buf)};
+  return true;
+}
+
+bool JsonParser::parse_number(JsonValue& out) {
+  const char* start = p_;
+  if (p_ < end_ && *p_ == '-') ++p_;
+  if (p_ == end_ || !is_digit(*p_)) return fail();
+  if (*p_ == '0') {
+    ++p_;
+  } else {
+    while (p_ < end_ && is_digit(*p_)) ++p_;
+  }
+  if (p_ < end_ && *p_ == '.') {
+    ++p_;
+    if (p_ == end_ || !is_digit(*p_)) return fail();
+    while (p_ < end_ && is_digit(*p_)) ++p_;
+  }
+  if (p_ < end_ && (*p_ == 'e' || *p_ == 'E')) {
+    ++p_;
+    if (p_ < end_ && (*p_ == '+' || *p_ == '-')) ++p_;
+    if (p_ == end_ || !is_digit(*p_)) return fail();
+    while (p_ < end_ && is_digit(*p_)) ++p_;
+  }
+  out.type_ = JsonValue::Type::kNumber;
+  out.data_ = start;
+  out.size_ = static_cast<uint32_t>(p_ - start);
+  return true;
+}
+
+bool JsonParser::parse_array(JsonValue& out, std::size_t depth) {
+  if (depth > config_.max_depth) return fail();
+  ++p_;
+  const std::size_t first = values_.size();
+  skip_space();
+  if (p_ < end_ && *p_ == ']') {
+    ++p_;
+  } else {
+    for (;;) {
+      JsonValue item;
+      skip_space();
+      if (!parse_value(item, depth)) return false;
+      values_.push_back(item);
+      skip_space();
+      if (p_ == end_) return fail();
+      if (*p_ == ']') {
+        ++p_;
+        break;
+      }
+      if (*p_++ != ',') {
+        --p_;
+        return fail();
+      }
+    }
+  }
+  const std::size_t count = values_.size() - first;
+  auto items = arena_->make_array<JsonValue>(count);
+  if (items.size() != count) return fail();
+  std::copy(values_.begin() + first, values_.end(), items.begin());
+  values_.resize(first);
+  out.type_ = JsonValue::Type::kArray;
+  out.data_ = items.data();
+  out.size_ = static_cast<uint32_t>(count);
+  return true;
+}
+
+bool JsonParser::parse_object(JsonValue& out, std::size_t depth) {
+  if (depth > config_.max_depth) return fail();
+  ++p_;
+  const std::size_t first = members_.size();
+  skip_space();
+  if (p_ < end_ && *p_ == '}') {
+    ++p_;
+  } else {
+    for (;;) {
+      JsonMember member;
+      skip_space();
+      if (p_ == end_ || *p_ != '"') return fail();
+      if (!parse_string(member.key)) return false;
+      skip_space();
+      if (p_ == end_ || *p_ != ':') return fail();
+      ++p_;
+      skip_space();
+      if (!parse_value(member.value, depth)) return false;
+      members_.push_back(member);
+      skip_space();
+      if (p_ == end_) return fail();
+      if (*p_ == '}') {
+        ++p_;
+        break;
+      }
+      if (*p_++ != ',') {
+        --p_;
+        return fail();
+      }
+    }
+  }
+  const std::size_t count = members_.size() - first;
+  auto members = arena_->make_array<JsonMember>(count);
+  if (members.size() != count) return fail();
+  std::copy(members_.begin() + first, members_.end(), members.begin());
+  members_.resize(first);
+  out.type_ = JsonValue::Type::kObject;
+  out.data_ = members.data();
+  out.size_ = static_cast<uint32_t>(count);
+  return true;
+}
+
+void append_json_string(std::string& out, std::string_view text) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  out.push_back('"');
+  std::size_t run = 0;  // start of the bytes copied as they are
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    const auto c = static_cast<unsigned char>(text[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') continue;
+    out.append(text.substr(run, i - run));
+    run = i + 1;
+    out.push_back('\\');
+    switch (c) {
+      case '"':
+      case '\\':
+        out.push_back(static_cast<char>(c));
+        break;
+      case '\n':
+        out.push_back('n');
+        break;
+      case '\r':
+        out.push_back('r');
+        break;
+      case '\t':
+        out.push_back('t');
+        break;
+      default:
+        out.append("u00");
+        out.push_back(kHex[c >> 4]);
+        out.push_back(kHex[c & 15]);
+    }
+  }
+  out.append(text.substr(run));
+  out.push_back('"');
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,116 @@
+#ifndef XIAOZI_PROTOCOL_JSON_H_
+#define XIAOZI_PROTOCOL_JSON_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory/arena.h"
+
+namespace xiaozi {
+
+struct JsonMember;
+
+// One node of a parsed document. Nodes, arrays and member lists live in
+// the Arena passed to JsonParser::parse(); strings without escapes and all
+// numbers are views into the parsed text itself. Everything stays valid as
+// long as both the text and the arena (until its reset()) do.
+class JsonValue {
+ public:
+  enum class Type : uint8_t { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  JsonValue() = default;
+
+  Type type() const { return type_; }
+  bool is_null() const { return type_ == Type::kNull; }
+  bool is_string() const { return type_ == Type::kString; }
+  bool is_number() const { return type_ == Type::kNumber; }
+  bool is_array() const { return type_ == Type::kArray; }
+  bool is_object() const { return type_ == Type::kObject; }
+
+  // Conversions return the fallback / nullopt / empty for other types.
+  bool as_bool(bool fallback = false) const;
+  std::optional<double> as_double() const;
+  // Integers only: no fraction or exponent, fits in int64.
+  std::optional<int64_t> as_int() const;
+  std::string_view as_string() const;
+  // Source text of a number, e.g. "1.5e3".
+  std::string_view number_text() const;
+
+  std::span<const JsonValue> items() const;
+  std::span<const JsonMember> members() const;
+  std::size_t size() const { return size_; }
+
+  // First member named `key` of an object, or nullptr. Linear: control
+  // messages have a handful of members.
+  const JsonValue* find(std::string_view key) const;
+  // find(key)->as_string(), or empty.
+  std::string_view string_at(std::string_view key) const;
+
+ private:
+  friend class JsonParser;
+
+  const void* data_ = nullptr;
+  uint32_t size_ = 0;  // bytes, elements or members; 1/0 for bool
+  Type type_ = Type::kNull;
+};
+
+struct JsonMember {
+  std::string_view key;
+  JsonValue value;
+};
+
+// Strict RFC 8259 parser into an Arena. Nothing is allocated on the heap
+// once the parser's scratch stacks have grown to the widest container seen;
+// escaped strings are decoded into the arena (never longer than their
+// source).
+//
+// One parser per thread (per connection, typically), reused across
+// messages.
+class JsonParser {
+ public:
+  struct Config {
+    std::size_t max_depth = 32;
+  };
+
+  explicit JsonParser(Config config);
+  JsonParser() : JsonParser(Config{}) {}
+
+  // The document's root, or nullptr on a syntax error or when the arena's
+  // budget ran out (see Arena); error_offset() then tells how far into
+  // `text` it got.
+  const JsonValue* parse(std::string_view text, Arena& arena);
+  std::size_t error_offset() const { return error_offset_; }
+
+ private:
+  bool parse_value(JsonValue& out, std::size_t depth);
+  bool parse_string(std::string_view& out);
+  bool parse_number(JsonValue& out);
+  bool parse_array(JsonValue& out, std::size_t depth);
+  bool parse_object(JsonValue& out, std::size_t depth);
+  bool literal(std::string_view word);
+  void skip_space();
+  bool fail();
+
+  Config config_;
+  const char* begin_ = nullptr;
+  const char* p_ = nullptr;
+  const char* end_ = nullptr;
+  Arena* arena_ = nullptr;
+  std::size_t error_offset_ = 0;
+  // Elements and members of the containers still open, innermost last.
+  std::vector<JsonValue> values_;
+  std::vector<JsonMember> members_;
+};
+
+// Appends `text` as a JSON string literal, quotes included. Control
+// characters are escaped; other bytes, UTF-8 included, go out as they are.
+void append_json_string(std::string& out, std::string_view text);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_PROTOCOL_JSON_H_
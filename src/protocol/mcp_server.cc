@@ -0,0 +1,312 @@
+#include "protocol/mcp_server.h"
+
+#include <charconv>
+#include <optional>
+
+#include "base/trace.h"
+#include "memory/memory_domain.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr std::string_view kProtocolVersion = "2024-11-05";
+
+enum Method { kInitialize, kToolsList, kToolsCall, kPing };
+constexpr StaticPerfectHash<4> kMethods({
+    "initialize",
+    "tools/list",
+    "tools/call",
+    "ping",
+});
+
+// JSON-RPC 2.0 error codes.
+constexpr int kInvalidRequest = -32600;
+constexpr int kMethodNotFound = -32601;
+constexpr int kInvalidParams = -32602;
+
+struct NoArgs {};
+
+void append_int(std::string& out, int64_t value) {
+  char buf[24];
+  const auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+  out.append(buf, end);
+}
+
+std::string_view type_name(McpParamType type) {
+  switch (type) {
+    case McpParamType::kInteger:
+      return "integer";
+    case McpParamType::kNumber:
+      return "number";
+    case McpParamType::kBoolean:
+      return "boolean";
+    case McpParamType::kString:
+      return "string";
+  }
+  return "string";
+}
+
+}  // namespace
+
+McpServer::McpServer(Config config) : config_(config) {}
+
+std::string McpServer::describe(std::string_view name,
+                                std::string_view description,
+                                std::span<const McpParamInfo> params) {
+  std::string out = R"({"name":)";
+  append_json_string(out, name);
+  out += R"(,"description":)";
+  append_json_string(out, description);
+  out += R"(,"inputSchema":{"type":"object","properties":{)";
+  bool first = true;
+  for (const McpParamInfo& p : params) {
+    if (!first) out += ',';
+    first = false;
+    append_json_string(out, p.name);
+    out += R"(:{"type":")";
+    out += type_name(p.type);
+    out += '"';
+    if (p.type == McpParamType::kInteger) {
+      out += R"(,"minimum":)";
+      append_int(out, p.min);
+      out += R"(,"maximum":)";
+      append_int(out, p.max);
+    }
+    if (!p.description.empty()) {
+      out += R"(,"description":)";
+      append_json_string(out, p.description);
+    }
+    out += '}';
+  }
+  out += R"(},"required":[)";
+  first = true;
+  for (const McpParamInfo& p : params) {
+    if (!p.required) continue;
+    if (!first) out += ',';
+    first = false;
+    append_json_string(out, p.name);
+  }
+  out += "]}}";
+  return out;
+}
+
+bool McpServer::read_argument(const McpParamInfo& param,
+                              const JsonValue* arguments, Value& value,
+                              std::string& error) {
+  value = {};
+  const JsonValue* v =
+      arguments != nullptr ? arguments->find(param.name) : nullptr;
+  if (v == nullptr || v->is_null()) {
+    if (!param.required) return true;
+    error.append("missing argument ").append(param.name);
+    return false;
+  }
+  bool ok = false;
+  switch (param.type) {
+    case McpParamType::kInteger: {
+      const std::optional<int64_t> i = v->as_int();
+      ok = i && *i >= param.min && *i <= param.max;
+      if (ok) value.integer = *i;
+      break;
+    }
+    case McpParamType::kNumber: {
+      const std::optional<double> d = v->as_double();
+      ok = d.has_value();
+      if (ok) value.number = *d;
+      break;
+    }
+    case McpParamType::kBoolean:
+      ok = v->type() == JsonValue::Type::kBool;
+      value.boolean = v->as_bool();
+      break;
+    case McpParamType::kString:
+      ok = v->is_string();
+      value.string = v->as_string();
+      break;
+  }
+  if (!ok) {
+    error.append(param.name).append(": expected ").append(
+        type_name(param.type));
+    if (param.type == McpParamType::kInteger) {
+      error.append(" in [");
+      append_int(error, param.min);
+      error.append(", ");
+      append_int(error, param.max);
+      error.append("]");
+    }
+    return false;
+  }
+  value.present = true;
+  return true;
+}
+
+bool McpServer::add(Tool tool) {
+  for (const Tool& t : tools_) {
+    if (t.name == tool.name) return false;
+  }
+  tools_.push_back(std::move(tool));
+  stale_ = true;
+  return true;
+}
+
+bool McpServer::remove_tool(std::string_view name) {
+  for (auto it = tools_.begin(); it != tools_.end(); ++it) {
+    if (it->name == name) {
+      tools_.erase(it);
+      stale_ = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+void McpServer::refresh() {
+  if (!stale_) return;
+  stale_ = false;
+  std::vector<std::string_view> names;
+  names.reserve(tools_.size());
+  for (const Tool& t : tools_) names.push_back(t.name);
+  // Names are unique (add() checks), so the build cannot fail.
+  index_.build(std::move(names));
+
+  list_ = R"({"tools":[)";
+  for (std::size_t i = 0; i < tools_.size(); ++i) {
+    if (i != 0) list_ += ',';
+    list_ += tools_[i].descriptor;
+  }
+  list_ += "]}";
+  list_renders_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string_view McpServer::tools_list() {
+  refresh();
+  return list_;
+}
+
+McpServer::CallStatus McpServer::call(std::string_view name,
+                                      const JsonValue* arguments,
+                                      Arena& arena, std::string& text) {
+  refresh();
+  calls_.fetch_add(1, std::memory_order_relaxed);
+  const int i = index_.find(name);
+  if (i < 0) {
+    unknown_tools_.fetch_add(1, std::memory_order_relaxed);
+    text.append("unknown tool ").append(name);
+    return CallStatus::kUnknownTool;
+  }
+  if (arguments != nullptr && !arguments->is_object()) arguments = nullptr;
+  const CallStatus status =
+      tools_[static_cast<std::size_t>(i)].call(arguments, arena, text);
+  if (status == CallStatus::kBadArguments) {
+    bad_arguments_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return status;
+}
+
+void McpServer::begin_reply(const JsonValue* id, std::string& reply) const {
+  reply.assign(R"({"jsonrpc":"2.0","id":)");
+  if (id != nullptr && id->is_number()) {
+    reply += id->number_text();
+  } else if (id != nullptr && id->is_string()) {
+    append_json_string(reply, id->as_string());
+  } else {
+    reply += "null";
+  }
+}
+
+void McpServer::error_reply(const JsonValue* id, int code,
+                            std::string_view message,
+                            std::string& reply) const {
+  begin_reply(id, reply);
+  reply += R"(,"error":{"code":)";
+  append_int(reply, code);
+  reply += R"(,"message":)";
+  append_json_string(reply, message);
+  reply += "}}";
+}
+
+bool McpServer::handle(const JsonValue& request, Arena& arena,
+                       std::string& reply) {
+  requests_.fetch_add(1, std::memory_order_relaxed);
+  reply.clear();
+  const JsonValue* id = request.find("id");
+  const std::string_view method = request.string_at("method");
+  if (!request.is_object() || method.empty()) {
+    error_reply(id, kInvalidRequest, "invalid request", reply);
+    return true;
+  }
+  // Notifications get no reply, known or not.
+  if (id == nullptr) return false;
+
+  switch (kMethods.find(method)) {
+    case kInitialize:
+      begin_reply(id, reply);
+      reply += R"(,"result":{"protocolVersion":")";
+      reply += kProtocolVersion;
+      reply += R"(","capabilities":{"tools":{}},"serverInfo":{"name":)";
+      append_json_string(reply, config_.name);
+      reply += R"(,"version":)";
+      append_json_string(reply, config_.version);
+      reply += "}}}";
+      return true;
+    case kToolsList:
+      refresh();
+      begin_reply(id, reply);
+      reply += R"(,"result":)";
+      reply += list_;
+      reply += '}';
+      return true;
+    case kToolsCall: {
+      const JsonValue* params = request.find("params");
+      const std::string_view name =
+          params != nullptr ? params->string_at("name") : std::string_view();
+      text_.clear();
+      const CallStatus status =
+          call(name, params != nullptr ? params->find("arguments") : nullptr,
+               arena, text_);
+      if (status == CallStatus::kUnknownTool ||
+          status == CallStatus::kBadArguments) {
+        error_reply(id, kInvalidParams, text_, reply);
+        return true;
+      }
+      begin_reply(id, reply);
+      reply += R"(,"result":{"content":[{"type":"text","text":)";
+      append_json_string(reply, text_);
+      reply += R"(}],"isError":)";
+      reply += status == CallStatus::kOk ? "false}}" : "true}}";
+      return true;
+    }
+    case kPing:
+      begin_reply(id, reply);
+      reply += R"(,"result":{}})";
+      return true;
+    default:
+      error_reply(id, kMethodNotFound, "method not found", reply);
+      return true;
+  }
+}
+
+McpServer::Stats McpServer::stats() const {
+  return {requests_.load(std::memory_order_relaxed),
+          calls_.load(std::memory_order_relaxed),
+          list_renders_.load(std::memory_order_relaxed),
+          unknown_tools_.load(std::memory_order_relaxed),
+          bad_arguments_.load(std::memory_order_relaxed)};
+}
+
+bool add_stats_tool(McpServer& server) {
+  return server.add_tool<NoArgs>(
+      std::string(kStatsTool),
+      "Reports the device's audio path latencies and memory use, for "
+      "diagnosing slow or choppy replies. Use only when asked for device "
+      "statistics.",
+      {}, [](const NoArgs&, std::string& text) {
+#if defined(XIAOZI_TRACE)
+        text += trace::format_stats();
+#endif
+        text += memory::format_stats();
+        return true;
+      });
+}
+
+}  // namespace xiaozi
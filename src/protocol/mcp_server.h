@@ -0,0 +1,225 @@
+#ifndef XIAOZI_PROTOCOL_MCP_SERVER_H_
+#define XIAOZI_PROTOCOL_MCP_SERVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "base/perfect_hash.h"
+#include "memory/arena.h"
+#include "protocol/json.h"
+
+namespace xiaozi {
+
+enum class McpParamType : uint8_t { kInteger, kNumber, kBoolean, kString };
+
+// What tools/list says about one argument.
+struct McpParamInfo {
+  std::string_view name;
+  std::string_view description;
+  McpParamType type;
+  bool required;
+  int64_t min;  // kInteger only
+  int64_t max;
+};
+
+// One argument of a tool, bound to the field of its Args struct that
+// receives it. The strings are views; keep them static.
+template <typename Args>
+struct McpParam {
+  using Field = std::variant<int64_t Args::*, double Args::*, bool Args::*,
+                             std::string_view Args::*>;
+
+  static McpParam integer(std::string_view name, int64_t Args::*field,
+                          int64_t min, int64_t max,
+                          std::string_view description = {}) {
+    return {{name, description, McpParamType::kInteger, true, min, max},
+            field};
+  }
+  static McpParam number(std::string_view name, double Args::*field,
+                         std::string_view description = {}) {
+    return {{name, description, McpParamType::kNumber, true, 0, 0}, field};
+  }
+  static McpParam boolean(std::string_view name, bool Args::*field,
+                          std::string_view description = {}) {
+    return {{name, description, McpParamType::kBoolean, true, 0, 0}, field};
+  }
+  // The field views the request text or the arena it was parsed into.
+  static McpParam string(std::string_view name, std::string_view Args::*field,
+                         std::string_view description = {}) {
+    return {{name, description, McpParamType::kString, true, 0, 0}, field};
+  }
+
+  // Absent arguments leave the field at its default member initializer.
+  McpParam optional() const {
+    McpParam p = *this;
+    p.info.required = false;
+    return p;
+  }
+
+  McpParamInfo info;
+  Field field;
+};
+
+// Builds the reply text; false reports a tool error (isError) to the
+// model, with `text` saying what went wrong.
+template <typename Args>
+using McpHandler = std::function<bool(const Args& args, std::string& text)>;
+
+// The device's MCP server: the tools it offers the model, and JSON-RPC
+// handling for the payload of {"type":"mcp"} messages.
+//
+// The tools/list result is rendered once and reused until a tool is added
+// or removed. tools/call finds its tool through a perfect hash of the
+// names (rebuilt with the list), so dispatch is one hash and one compare
+// whatever the number of tools, and JSON-RPC methods go through a table
+// generated at compile time. Arguments are validated against the declared
+// params and written straight into the tool's Args struct, allocated in
+// the caller's arena; no heap allocation once the reply buffer has grown.
+//
+// Not thread-safe: register tools and handle messages on one thread (the
+// interactive executor's). stats() may be read from any thread.
+class McpServer {
+ public:
+  enum class CallStatus {
+    kOk,
+    kToolError,     // the handler returned false, or no arena memory
+    kUnknownTool,
+    kBadArguments,  // `text` names the argument
+  };
+
+  struct Config {
+    std::string_view name = "xiaozi";
+    std::string_view version = "1.0";
+  };
+
+  struct Stats {
+    uint64_t requests;
+    uint64_t calls;
+    uint64_t list_renders;  // tools/list results rendered, not served
+    uint64_t unknown_tools;
+    uint64_t bad_arguments;
+  };
+
+  explicit McpServer(Config config);
+  McpServer() : McpServer(Config{}) {}
+
+  // False if `name` is taken. Args is default-constructed in the arena, so
+  // it must be trivially destructible.
+  template <typename Args>
+  bool add_tool(std::string name, std::string_view description,
+                std::vector<McpParam<Args>> params, McpHandler<Args> handler);
+  bool remove_tool(std::string_view name);
+  std::size_t tool_count() const { return tools_.size(); }
+
+  // The tools/list result object, {"tools":[...]}.
+  std::string_view tools_list();
+
+  // Runs tool `name` on `arguments` (an object, or nullptr for none). Also
+  // the entry for IoT commands, registered as "<device>.<method>". The
+  // reply text, or the error, goes to `text`.
+  CallStatus call(std::string_view name, const JsonValue* arguments,
+                  Arena& arena, std::string& text);
+
+  // Handles one JSON-RPC request; `reply` is overwritten with the response
+  // payload. False, and `reply` empty, for notifications.
+  bool handle(const JsonValue& request, Arena& arena, std::string& reply);
+
+  Stats stats() const;
+
+ private:
+  // One argument after validation.
+  struct Value {
+    bool present;
+    int64_t integer;
+    double number;
+    bool boolean;
+    std::string_view string;
+  };
+
+  using Call = std::function<CallStatus(const JsonValue* arguments,
+                                        Arena& arena, std::string& text)>;
+  struct Tool {
+    std::string name;
+    std::string descriptor;  // its entry in the tools/list result
+    Call call;
+  };
+
+  static std::string describe(std::string_view name,
+                              std::string_view description,
+                              std::span<const McpParamInfo> params);
+  static bool read_argument(const McpParamInfo& param,
+                            const JsonValue* arguments, Value& value,
+                            std::string& error);
+  static void set(int64_t& field, const Value& v) { field = v.integer; }
+  static void set(double& field, const Value& v) { field = v.number; }
+  static void set(bool& field, const Value& v) { field = v.boolean; }
+  static void set(std::string_view& field, const Value& v) {
+    field = v.string;
+  }
+
+  bool add(Tool tool);
+  void refresh();
+  void begin_reply(const JsonValue* id, std::string& reply) const;
+  void error_reply(const JsonValue* id, int code, std::string_view message,
+                   std::string& reply) const;
+
+  Config config_;
+  std::vector<Tool> tools_;
+  bool stale_ = false;
+  PerfectHash index_;
+  std::string list_;
+  std::string text_;
+
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> calls_{0};
+  std::atomic<uint64_t> list_renders_{0};
+  std::atomic<uint64_t> unknown_tools_{0};
+  std::atomic<uint64_t> bad_arguments_{0};
+};
+
+template <typename Args>
+bool McpServer::add_tool(std::string name, std::string_view description,
+                         std::vector<McpParam<Args>> params,
+                         McpHandler<Args> handler) {
+  static_assert(std::is_trivially_destructible_v<Args>);
+  std::vector<McpParamInfo> infos;
+  infos.reserve(params.size());
+  for (const McpParam<Args>& p : params) infos.push_back(p.info);
+  std::string descriptor = describe(name, description, infos);
+  Call call = [params = std::move(params), handler = std::move(handler)](
+                  const JsonValue* arguments, Arena& arena,
+                  std::string& text) {
+    Args* args = arena.make<Args>();
+    if (args == nullptr) {
+      text.append("out of memory");
+      return CallStatus::kToolError;
+    }
+    for (const McpParam<Args>& p : params) {
+      Value v;
+      if (!read_argument(p.info, arguments, v, text)) {
+        return CallStatus::kBadArguments;
+      }
+      if (!v.present) continue;
+      std::visit([&](auto field) { set(args->*field, v); }, p.field);
+    }
+    return handler(*args, text) ? CallStatus::kOk : CallStatus::kToolError;
+  };
+  return add({std::move(name), std::move(descriptor), std::move(call)});
+}
+
+// Registers kStatsTool, the `stats` command: no arguments, replies with
+// trace::format_stats() (nothing without XIAOZI_TRACE), then
+// memory::format_stats(). False if the name is taken.
+inline constexpr std::string_view kStatsTool = "self.get_stats";
+bool add_stats_tool(McpServer& server);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_PROTOCOL_MCP_SERVER_H_
@@ -0,0 +1,255 @@
+#include "replay/capture_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "codec/g711_codec.h"
+
+namespace xiaozi {
+namespace {
+
+using replay::FileHeader;
+using replay::Kind;
+using replay::RecordHeader;
+
+bool read_file(const std::string& path, std::vector<uint8_t>& out) {
+  std::FILE* f = std::fopen(path.c_str(), "rb");
+  if (f == nullptr) return false;
+  uint8_t buf[65536];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+    out.insert(out.end(), buf, buf + n);
+  }
+  const bool ok = !std::ferror(f);
+  std::fclose(f);
+  return ok;
+}
+
+uint32_t next_random(uint32_t& seed) {
+  seed = seed * 1664525u + 1013904223u;
+  return seed >> 8;
+}
+
+constexpr int kRate = 16000;
+constexpr double kPi = 3.14159265358979;
+
+}  // namespace
+
+CaptureWriter::CaptureWriter(const CaptureFormat& format) : format_(format) {
+  FileHeader header{};
+  std::memcpy(header.magic, replay::kMagic, sizeof(header.magic));
+  header.version = replay::kVersion;
+  header.downlink_rate = format.downlink_rate;
+  header.frame_samples = format.frame_samples;
+  header.downlink_frame_ms = format.downlink_frame_ms;
+  header.channels = format.reference ? 2 : 1;
+  header.downlink_codec = format.downlink_codec;
+  bytes_.resize(sizeof(header));
+  std::memcpy(bytes_.data(), &header, sizeof(header));
+}
+
+void CaptureWriter::record(Kind kind, uint64_t time_ns, uint32_t sequence,
+                           std::size_t bytes) {
+  const RecordHeader header{time_ns, sequence, static_cast<uint16_t>(bytes),
+                            kind, 0};
+  const std::size_t at = bytes_.size();
+  bytes_.resize(at + sizeof(header));
+  std::memcpy(bytes_.data() + at, &header, sizeof(header));
+}
+
+void CaptureWriter::mic(uint64_t time_ns, std::span<const int16_t> pcm,
+                        std::span<const int16_t> ref) {
+  const std::size_t frame = format_.frame_samples;
+  record(Kind::kMic, time_ns, 0, format_.mic_bytes());
+  const std::size_t at = bytes_.size();
+  bytes_.resize(at + format_.mic_bytes(), 0);
+  std::memcpy(bytes_.data() + at, pcm.data(),
+              std::min(pcm.size(), frame) * sizeof(int16_t));
+  if (format_.reference) {
+    std::memcpy(bytes_.data() + at + frame * sizeof(int16_t), ref.data(),
+                std::min(ref.size(), frame) * sizeof(int16_t));
+  }
+}
+
+void CaptureWriter::packet(uint64_t time_ns, uint32_t sequence,
+                           std::span<const uint8_t> payload) {
+  record(Kind::kPacket, time_ns, sequence, payload.size());
+  bytes_.insert(bytes_.end(), payload.begin(), payload.end());
+}
+
+void CaptureWriter::reply_start(uint64_t time_ns) {
+  record(Kind::kReplyStart, time_ns, 0, 0);
+}
+
+void CaptureWriter::reply_end(uint64_t time_ns) {
+  record(Kind::kReplyEnd, time_ns, 0, 0);
+}
+
+bool CaptureWriter::save(const std::string& path) const {
+  std::FILE* f = std::fopen(path.c_str(), "wb");
+  if (f == nullptr) return false;
+  bool ok = std::fwrite(bytes_.data(), 1, bytes_.size(), f) == bytes_.size();
+  ok = std::fclose(f) == 0 && ok;
+  return ok;
+}
+
+bool CaptureReader::open(std::vector<uint8_t> bytes) {
+  bytes_ = std::move(bytes);
+  FileHeader header;
+  if (bytes_.size() < sizeof(header)) return false;
+  std::memcpy(&header, bytes_.data(), sizeof(header));
+  if (std::memcmp(header.magic, replay::kMagic, sizeof(header.magic)) != 0 ||
+      header.version != replay::kVersion || header.frame_samples == 0 ||
+      (header.channels != 1 && header.channels != 2) ||
+      header.downlink_frame_ms == 0 || header.downlink_rate == 0) {
+    return false;
+  }
+  format_.frame_samples = header.frame_samples;
+  format_.reference = header.channels == 2;
+  format_.downlink_codec = header.downlink_codec;
+  format_.downlink_rate = header.downlink_rate;
+  format_.downlink_frame_ms = header.downlink_frame_ms;
+
+  // One pass up front, so next() only ever sees whole, ordered records.
+  std::size_t at = sizeof(header);
+  records_ = 0;
+  duration_ns_ = 0;
+  truncated_ = false;
+  while (at < bytes_.size()) {
+    RecordHeader r;
+    if (bytes_.size() - at < sizeof(r)) {
+      truncated_ = true;
+      break;
+    }
+    std::memcpy(&r, bytes_.data() + at, sizeof(r));
+    if (bytes_.size() - at - sizeof(r) < r.bytes ||
+        (r.kind == Kind::kMic && r.bytes != format_.mic_bytes()) ||
+        r.time_ns < duration_ns_) {
+      truncated_ = true;
+      break;
+    }
+    at += sizeof(r) + r.bytes;
+    duration_ns_ = r.time_ns;
+    ++records_;
+  }
+  end_ = at;
+  rewind();
+  return true;
+}
+
+bool CaptureReader::load(const std::string& path) {
+  std::vector<uint8_t> bytes;
+  return read_file(path, bytes) && open(std::move(bytes));
+}
+
+bool CaptureReader::next(Record& out) {
+  if (offset_ >= end_) return false;
+  RecordHeader r;
+  std::memcpy(&r, bytes_.data() + offset_, sizeof(r));
+  out.kind = r.kind;
+  out.time_ns = r.time_ns;
+  out.sequence = r.sequence;
+  out.payload = {bytes_.data() + offset_ + sizeof(r), r.bytes};
+  offset_ += sizeof(r) + r.bytes;
+  return true;
+}
+
+std::vector<uint8_t> synthetic_capture(uint32_t seconds, uint32_t seed) {
+  const CaptureFormat format = {320, true, replay::Codec::kG711, kRate, 60};
+  constexpr uint64_t kMs = 1000000;
+  constexpr uint64_t kCycle = 8000 * kMs;
+  constexpr uint64_t kSpeech = 500 * kMs;
+  constexpr uint64_t kSpeechEnd = 1700 * kMs;
+  constexpr uint64_t kReplyStart = 1900 * kMs;
+  constexpr uint64_t kFirstPacket = 2050 * kMs;
+  constexpr uint64_t kPlayStart = 2200 * kMs;
+  constexpr int kReplyPackets = 34;  // 2 s of 60 ms packets
+  constexpr std::size_t kPacketSamples = kRate * 60 / 1000;
+
+  auto reply_sample = [](std::size_t n) {
+    const double env = 0.5 + 0.5 * std::sin(2 * kPi * 3.0 * n / kRate);
+    return static_cast<int16_t>(
+        5000 * env * std::sin(2 * kPi * 220.0 * n / kRate) +
+        1500 * std::sin(2 * kPi * 660.0 * n / kRate));
+  };
+
+  struct Event {
+    uint64_t time_ns;
+    Kind kind;
+    uint32_t sequence;
+    std::vector<uint8_t> payload;
+  };
+  std::vector<Event> events;
+  uint32_t sequence = 0;
+  G711Encoder encoder(kRate, static_cast<int>(kPacketSamples));
+  std::vector<int16_t> pcm(kPacketSamples);
+  std::vector<uint8_t> packet(kPacketSamples);
+  const uint64_t end_ns = uint64_t{seconds} * 1000 * kMs;
+  for (uint64_t cycle = 0; cycle < end_ns; cycle += kCycle) {
+    if (cycle + kReplyStart >= end_ns) break;
+    events.push_back({cycle + kReplyStart, Kind::kReplyStart, 0, {}});
+    uint64_t last = cycle + kReplyStart;
+    for (int i = 0; i < kReplyPackets; ++i, ++sequence) {
+      for (std::size_t s = 0; s < kPacketSamples; ++s) {
+        pcm[s] = reply_sample(i * kPacketSamples + s);
+      }
+      const int bytes = encoder.encode(pcm, packet);
+      if (next_random(seed) % 50 == 0) continue;
+      const uint64_t arrival = cycle + kFirstPacket + i * 60 * kMs +
+                               next_random(seed) % 40 * kMs;
+      last = std::max(last, arrival);
+      events.push_back({arrival, Kind::kPacket, sequence,
+                        {packet.begin(), packet.begin() + bytes}});
+    }
+    events.push_back({last + kMs, Kind::kReplyEnd, 0, {}});
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const Event& a, const Event& b) {
+                     return a.time_ns < b.time_ns;
+                   });
+
+  CaptureWriter writer(format);
+  std::vector<int16_t> mic(format.frame_samples);
+  std::vector<int16_t> ref(format.frame_samples);
+  std::size_t next_event = 0;
+  const uint64_t frame_ns = uint64_t{format.frame_samples} * 1000000000 / kRate;
+  for (uint64_t t = 0, n = 0; t < end_ns; t += frame_ns) {
+    for (std::size_t s = 0; s < mic.size(); ++s, ++n) {
+      const uint64_t at = n * 1000000000 / kRate;
+      const uint64_t phase = at % kCycle;
+      int v = static_cast<int>(next_random(seed) % 17) - 8;
+      if (phase >= kSpeech && phase < kSpeechEnd) {
+        v += static_cast<int>(
+            6000 * std::sin(2 * kPi * 180.0 * n / kRate) +
+            2000 * std::sin(2 * kPi * 540.0 * n / kRate));
+      }
+      const uint64_t play_end =
+          kPlayStart + kReplyPackets * kPacketSamples * 1000000000 / kRate;
+      int16_t r = 0;
+      if (phase >= kPlayStart && phase < play_end) {
+        r = reply_sample((phase - kPlayStart) * kRate / 1000000000);
+      }
+      ref[s] = r;
+      v += r * 3 / 10;
+      mic[s] = static_cast<int16_t>(std::clamp(v, -32768, 32767));
+    }
+    // Packets and reply markers land between the frames around them.
+    for (; next_event < events.size() && events[next_event].time_ns <= t;
+         ++next_event) {
+      const Event& e = events[next_event];
+      if (e.kind == Kind::kPacket) {
+        writer.packet(e.time_ns, e.sequence, e.payload);
+      } else if (e.kind == Kind::kReplyStart) {
+        writer.reply_start(e.time_ns);
+      } else {
+        writer.reply_end(e.time_ns);
+      }
+    }
+    writer.mic(t, mic, ref);
+  }
+  return writer.bytes();
+}
+
+}  // namespace xiaozi
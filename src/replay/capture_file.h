@@ -0,0 +1,139 @@
+#ifndef XIAOZI_REPLAY_CAPTURE_FILE_H_
+#define XIAOZI_REPLAY_CAPTURE_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace xiaozi {
+
+// Layout of a pipeline capture: what the device's audio path saw, with
+// the time each piece arrived, for replay on a host (PipelineReplay).
+//
+//   FileHeader | RecordHeader payload | RecordHeader payload | ...
+//
+// kMic payloads are one uplink frame of 16 kHz PCM as CapturePath hands it
+// on, followed by the same span of speaker reference when channels is 2.
+// kPacket payloads are downlink audio packets as the transport received
+// them. Times are nanoseconds since the start of the capture and never
+// decrease. All fields little endian.
+namespace replay {
+
+inline constexpr char kMagic[4] = {'X', 'Z', 'R', 'C'};
+inline constexpr uint32_t kVersion = 1;
+
+enum class Codec : uint8_t { kG711 = 0, kOpus = 1 };
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t downlink_rate;
+  uint16_t frame_samples;  // per kMic record and channel
+  uint16_t downlink_frame_ms;
+  uint8_t channels;        // 1, or 2 with the speaker reference
+  Codec downlink_codec;
+  uint8_t reserved[6];
+};
+static_assert(sizeof(FileHeader) == 24);
+
+enum class Kind : uint8_t {
+  kMic = 1,
+  kPacket = 2,
+  kReplyStart = 3,  // `tts start`: time to first audio counts from here
+  kReplyEnd = 4,    // the server has sent the whole reply
+};
+
+struct RecordHeader {
+  uint64_t time_ns;
+  uint32_t sequence;  // kPacket only
+  uint16_t bytes;     // of payload
+  Kind kind;
+  uint8_t reserved;
+};
+static_assert(sizeof(RecordHeader) == 16);
+
+}  // namespace replay
+
+struct CaptureFormat {
+  uint16_t frame_samples = 320;  // 20 ms
+  bool reference = false;
+  replay::Codec downlink_codec = replay::Codec::kG711;
+  uint32_t downlink_rate = 16000;
+  uint16_t downlink_frame_ms = 60;
+
+  std::size_t mic_bytes() const {
+    return std::size_t{frame_samples} * (reference ? 2 : 1) * sizeof(int16_t);
+  }
+};
+
+// Records a capture in memory. Calls must come in time order, from one
+// thread (the capture tap's).
+class CaptureWriter {
+ public:
+  explicit CaptureWriter(const CaptureFormat& format);
+
+  // `pcm` (and `ref`, when the format has a reference) hold
+  // frame_samples.
+  void mic(uint64_t time_ns, std::span<const int16_t> pcm,
+           std::span<const int16_t> ref = {});
+  void packet(uint64_t time_ns, uint32_t sequence,
+              std::span<const uint8_t> payload);
+  void reply_start(uint64_t time_ns);
+  void reply_end(uint64_t time_ns);
+
+  const std::vector<uint8_t>& bytes() const { return bytes_; }
+  bool save(const std::string& path) const;
+
+ private:
+  void record(replay::Kind kind, uint64_t time_ns, uint32_t sequence,
+              std::size_t bytes);
+
+  CaptureFormat format_;
+  std::vector<uint8_t> bytes_;
+};
+
+// Walks the records of a capture held in memory.
+class CaptureReader {
+ public:
+  struct Record {
+    replay::Kind kind;
+    uint64_t time_ns;
+    uint32_t sequence;
+    std::span<const uint8_t> payload;
+  };
+
+  // False if `bytes` is not a capture. A capture cut off mid-record (the
+  // recorder crashed) opens with the records before the cut.
+  bool open(std::vector<uint8_t> bytes);
+  bool load(const std::string& path);
+
+  const CaptureFormat& format() const { return format_; }
+  std::size_t records() const { return records_; }
+  uint64_t duration_ns() const { return duration_ns_; }
+  bool truncated() const { return truncated_; }
+
+  // False after the last record.
+  bool next(Record& out);
+  void rewind() { offset_ = sizeof(replay::FileHeader); }
+
+ private:
+  std::vector<uint8_t> bytes_;
+  std::size_t end_ = 0;  // of the last whole record
+  std::size_t offset_ = 0;
+  CaptureFormat format_;
+  std::size_t records_ = 0;
+  uint64_t duration_ns_ = 0;
+  bool truncated_ = false;
+};
+
+// Offline only: used by xiaozi_replay and benchmarks. A conversation of
+// `seconds`: every 8 s the user speaks for 1.2 s, then a G.711 reply of
+// 2 s streams in over a link with arrival jitter and 2% loss, and its
+// echo, with the reference, reaches the mic while it plays.
+std::vector<uint8_t> synthetic_capture(uint32_t seconds, uint32_t seed);
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_REPLAY_CAPTURE_FILE_H_
@@ -0,0 +1,304 @@
+#include "replay/pipeline_replay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "base/clock.h"
+#include "board/boards.h"
+#include "codec/decoder_stage.h"
+#include "codec/g711_codec.h"
+#include "memory/frame_pool.h"
+#include "net/packet_sink.h"
+
+#if defined(XIAOZI_HAVE_OPUS)
+#include "codec/opus_codec.h"
+#endif
+
+namespace xiaozi {
+namespace {
+
+// After the last record: long enough for a full jitter buffer and the
+// largest prebuffer to play out.
+constexpr uint64_t kDrainNs = 2000000000;
+
+// Stands in for the transport: hashes what would have been sent.
+class DigestSink : public PacketSink {
+ public:
+  std::span<uint8_t> reserve(std::size_t max_bytes) override {
+    if (buffer_.size() < max_bytes) buffer_.resize(max_bytes);
+    return {buffer_.data(), max_bytes};
+  }
+  bool commit(std::size_t bytes, uint64_t) override {
+    if (bytes == 0) return true;
+    const auto length = static_cast<uint16_t>(bytes);
+    hash.update({reinterpret_cast<const uint8_t*>(&length), sizeof(length)});
+    hash.update({buffer_.data(), bytes});
+    ++packets;
+    total_bytes += bytes;
+    return true;
+  }
+
+  Sha256 hash;
+  uint64_t packets = 0;
+  uint64_t total_bytes = 0;
+
+ private:
+  std::vector<uint8_t> buffer_;
+};
+
+// Downstream of the gate, as on the device: wake word, then encoder.
+class Uplink : public VadGate::Listener {
+ public:
+  Uplink(EncoderStage& encoder, WakeWordDetector* wake)
+      : encoder_(encoder), wake_(wake) {}
+
+  void on_wake() override {}
+  void on_frame(FrameRef frame) override {
+    if (wake_ != nullptr && wake_->process(frame.as<const int16_t>())) {
+      ++detections;
+    }
+    encoder_.submit(std::move(frame));
+    encoder_.run_once();
+  }
+  void on_idle() override {
+    encoder_.flush();
+    encoder_.run_once();
+  }
+
+  uint64_t detections = 0;
+
+ private:
+  EncoderStage& encoder_;
+  WakeWordDetector* wake_;
+};
+
+// The board's uplink codec, as the device would encode.
+std::unique_ptr<AudioEncoder> make_encoder(const CaptureFormat& format) {
+#if defined(XIAOZI_HAVE_OPUS)
+  if constexpr (CurrentBoard::kUplinkCodec == UplinkCodec::kOpus) {
+    const int frame_ms = format.frame_samples * 1000 / kPipelineRate;
+    auto opus =
+        std::make_unique<OpusAudioEncoder>(kPipelineRate, frame_ms, 24000);
+    if (!opus->ok() || opus->frame_samples() != format.frame_samples) {
+      return nullptr;
+    }
+    return opus;
+  }
+#endif
+  return std::make_unique<G711Encoder>(kPipelineRate, format.frame_samples);
+}
+
+std::size_t downlink_samples(const CaptureFormat& format) {
+  return std::size_t{format.downlink_rate} * format.downlink_frame_ms / 1000;
+}
+
+std::unique_ptr<AudioDecoder> make_decoder(const CaptureFormat& format) {
+  const int samples = static_cast<int>(downlink_samples(format));
+  if (format.downlink_codec == replay::Codec::kG711) {
+    if (samples == 0 || samples > G711Decoder::kMaxFrameSamples) {
+      return nullptr;
+    }
+    return std::make_unique<G711Decoder>(
+        static_cast<int>(format.downlink_rate), samples);
+  }
+#if defined(XIAOZI_HAVE_OPUS)
+  auto opus = std::make_unique<OpusAudioDecoder>(
+      static_cast<int>(format.downlink_rate), format.downlink_frame_ms);
+  if (opus->ok()) return opus;
+#endif
+  return nullptr;
+}
+
+PipelineReplay::Latency summarize(std::vector<uint64_t>& ns) {
+  PipelineReplay::Latency l{ns.size(), 0, 0, 0};
+  if (ns.empty()) return l;
+  auto at = [&](double q) {
+    const auto i = static_cast<std::size_t>(q * (ns.size() - 1));
+    std::nth_element(ns.begin(), ns.begin() + i, ns.end());
+    return ns[i];
+  };
+  l.p50_ns = at(0.5);
+  l.p99_ns = at(0.99);
+  l.max_ns = *std::max_element(ns.begin(), ns.end());
+  return l;
+}
+
+}  // namespace
+
+PipelineReplay::PipelineReplay(const CaptureFormat& format, Config config)
+    : format_(format),
+      config_(config),
+      ok_(make_encoder(format) != nullptr && make_decoder(format) != nullptr &&
+          config.refill_ms != 0) {}
+
+PipelineReplay::Result PipelineReplay::run(CaptureReader& capture) {
+  Result result{};
+  if (!ok_) return result;
+  const std::size_t frame = format_.frame_samples;
+  const std::size_t packet_samples = downlink_samples(format_);
+
+  // Enough blocks for every queue on the path to be full at once.
+  FramePool mic_pool(
+      frame * sizeof(int16_t),
+      VadGate::kMaxPrerollFrames + EncoderStage::kQueueFrames + 4,
+      MemoryDomain::kTools);
+  // G.711 is the largest packet per sample of the codecs.
+  FramePool packet_pool(std::max<std::size_t>(packet_samples, 1500),
+                        JitterBuffer::kSlots + DecoderStage::kQueueFrames + 4,
+                        MemoryDomain::kTools);
+  FramePool pcm_pool(packet_samples * sizeof(int16_t),
+                     DecoderStage::kQueueFrames + TtsPlayback::kMaxFrames + 4,
+                     MemoryDomain::kTools);
+
+  std::unique_ptr<AudioEncoder> encoder = make_encoder(format_);
+  std::unique_ptr<AudioDecoder> decoder = make_decoder(format_);
+  DigestSink sink;
+  EncoderStage encoder_stage(*encoder, sink, config_.encoder);
+  std::optional<WakeWordDetector> wake;
+  if (config_.wake_model != nullptr) {
+    wake.emplace(*config_.wake_model, config_.wake);
+  }
+  Uplink uplink(encoder_stage, wake ? &*wake : nullptr);
+  VadGate gate(uplink, config_.vad);
+  std::optional<EchoCanceller> echo;
+  if (format_.reference && frame % EchoCanceller::kBlock == 0) {
+    echo.emplace(config_.echo);
+  }
+  std::vector<int16_t> ref(frame);
+
+  JitterBuffer::Config jitter_config = config_.jitter;
+  jitter_config.frame_ms = format_.downlink_frame_ms;
+  JitterBuffer jitter(jitter_config);
+  DecoderStage decoder_stage(*decoder, pcm_pool);
+  TtsPlayback::Config playback_config = config_.playback;
+  playback_config.sample_rate = static_cast<int>(format_.downlink_rate);
+  TtsPlayback playback(decoder_stage, playback_config);
+  std::vector<int16_t> refill(format_.downlink_rate * config_.refill_ms /
+                              1000);
+  Sha256 played;
+
+  std::vector<Spike> spikes;
+  const uint64_t start = monotonic_ns();
+  // Capture time -> the clock the stages see.
+  auto clock_at = [&](uint64_t t) {
+    if (config_.realtime) {
+      std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+          std::chrono::nanoseconds(start + t)));
+    }
+    return start + t;
+  };
+
+  const uint64_t pop_ns = uint64_t{format_.downlink_frame_ms} * 1000000;
+  const uint64_t refill_ns = uint64_t{config_.refill_ms} * 1000000;
+  uint64_t next_pop = 0;
+  uint64_t next_refill = 0;
+  auto run_ticks_until = [&](uint64_t t) {
+    while (next_pop <= t || next_refill <= t) {
+      if (next_pop <= next_refill) {
+        clock_at(next_pop);
+        const uint64_t begin = monotonic_ns();
+        FrameRef packet;
+        if (jitter.pop(packet) != JitterBuffer::Status::kNotReady) {
+          decoder_stage.submit(std::move(packet));
+          decoder_stage.run_once();
+          spikes.push_back(
+              {next_pop, monotonic_ns() - begin, Path::kDownlink});
+        }
+        next_pop += pop_ns;
+      } else {
+        const uint64_t now = clock_at(next_refill);
+        result.played_samples += playback.pull(refill, now);
+        played.update({reinterpret_cast<const uint8_t*>(refill.data()),
+                       refill.size() * sizeof(int16_t)});
+        next_refill += refill_ns;
+      }
+    }
+  };
+
+  capture.rewind();
+  CaptureReader::Record r;
+  uint32_t mic_sequence = 0;
+  while (capture.next(r)) {
+    run_ticks_until(r.time_ns);
+    const uint64_t now = clock_at(r.time_ns);
+    switch (r.kind) {
+      case replay::Kind::kMic: {
+        const uint64_t begin = monotonic_ns();
+        FrameRef f = mic_pool.acquire();
+        if (!f) break;
+        f.set_size(frame * sizeof(int16_t));
+        f.set_sequence(mic_sequence++);
+        f.set_timestamp_ns(begin);
+        std::memcpy(f.data(), r.payload.data(), frame * sizeof(int16_t));
+        if (echo) {
+          std::memcpy(ref.data(), r.payload.data() + frame * sizeof(int16_t),
+                      frame * sizeof(int16_t));
+          const std::span<int16_t> pcm = f.as<int16_t>();
+          echo->process(pcm, ref, pcm);
+        }
+        gate.submit(std::move(f));
+        spikes.push_back({r.time_ns, monotonic_ns() - begin, Path::kUplink});
+        ++result.mic_frames;
+        break;
+      }
+      case replay::Kind::kPacket: {
+        FrameRef p = packet_pool.acquire();
+        if (!p || r.payload.size() > p.capacity()) break;
+        std::memcpy(p.data(), r.payload.data(), r.payload.size());
+        p.set_size(r.payload.size());
+        p.set_sequence(r.sequence);
+        p.set_timestamp_ns(now);
+        jitter.push(std::move(p));
+        ++result.downlink_packets;
+        break;
+      }
+      case replay::Kind::kReplyStart:
+        playback.begin(now);
+        break;
+      case replay::Kind::kReplyEnd:
+        playback.end();
+        break;
+    }
+  }
+  encoder_stage.flush();
+  encoder_stage.run_once();
+  run_ticks_until(capture.duration_ns() + kDrainNs);
+  result.wall_ns = monotonic_ns() - start;
+  result.capture_ns = capture.duration_ns();
+
+  const VadGate::Stats gate_stats = gate.stats();
+  result.frames_forwarded = gate_stats.frames_forwarded;
+  result.vad_wakes = gate_stats.wakes;
+  result.wake_detections = uplink.detections;
+  result.uplink_packets = sink.packets;
+  result.uplink_bytes = sink.total_bytes;
+  result.frames_concealed = decoder_stage.stats().frames_concealed;
+  const TtsPlayback::Stats playback_stats = playback.stats();
+  result.replies = playback_stats.replies;
+  result.playback_underruns = playback_stats.underruns;
+  result.max_first_audio_ns = playback_stats.max_first_audio_ns;
+  result.uplink_digest = sink.hash.finish();
+  result.playback_digest = played.finish();
+
+  std::vector<uint64_t> up;
+  std::vector<uint64_t> down;
+  for (const Spike& s : spikes) {
+    (s.path == Path::kUplink ? up : down).push_back(s.wall_ns);
+  }
+  result.uplink = summarize(up);
+  result.downlink = summarize(down);
+  const std::size_t keep = std::min(config_.slowest, spikes.size());
+  std::partial_sort(spikes.begin(), spikes.begin() + keep, spikes.end(),
+                    [](const Spike& a, const Spike& b) {
+                      return a.wall_ns > b.wall_ns;
+                    });
+  spikes.resize(keep);
+  result.slowest = std::move(spikes);
+  return result;
+}
+
+}  // namespace xiaozi
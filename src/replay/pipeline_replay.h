@@ -0,0 +1,116 @@
+#ifndef XIAOZI_REPLAY_PIPELINE_REPLAY_H_
+#define XIAOZI_REPLAY_PIPELINE_REPLAY_H_
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "audio/echo_canceller.h"
+#include "audio/int8_net.h"
+#include "audio/jitter_buffer.h"
+#include "audio/vad_gate.h"
+#include "audio/wake_word.h"
+#include "base/sha256.h"
+#include "codec/encoder_stage.h"
+#include "codec/tts_playback.h"
+#include "replay/capture_file.h"
+
+namespace xiaozi {
+
+// Runs a capture through the device's audio path on one host thread:
+// uplink frames through the echo canceller (when the capture has a
+// reference), VadGate, wake word and EncoderStage; downlink packets
+// through JitterBuffer, DecoderStage and TtsPlayback, with the jitter
+// buffer popped every downlink frame and playback pulled every I2S
+// refill.
+//
+// Time is the capture's: events and the periodic pops and pulls are
+// ordered by their capture timestamps, and the stages that look at time
+// (jitter estimate, time to first audio) see those, so a replay takes
+// only as long as the processing and gives the same output on every run.
+// The CPU-load governors (encoder complexity, echo canceller adaptation
+// interval) are pinned by default for the same reason; turning them back
+// on makes the output depend on the machine. With `realtime` each event
+// waits for its wall-clock moment instead, which is what the trace
+// histograms' downlink stages need to mean anything.
+//
+// Every run() builds fresh stages, so runs are independent.
+class PipelineReplay {
+ public:
+  struct Config {
+    // No wake word stage without a model. Must outlive the replay.
+    const Int8Model* wake_model = nullptr;
+    bool realtime = false;
+    uint32_t refill_ms = 10;
+    VadGate::Config vad;
+    WakeWordDetector::Config wake;
+    EncoderStage::Config encoder = {.auto_complexity = false};
+    EchoCanceller::Config echo = {
+        .cpu_budget = std::numeric_limits<float>::infinity()};
+    JitterBuffer::Config jitter;
+    TtsPlayback::Config playback;
+    // Slowest events kept in Result::slowest.
+    std::size_t slowest = 10;
+  };
+
+  enum class Path : uint8_t {
+    kUplink,    // one mic frame, capture to encoded packet
+    kDownlink,  // one jitter buffer pop, decode included
+  };
+
+  struct Spike {
+    uint64_t capture_ns;  // when it happened in the capture
+    uint64_t wall_ns;     // processing time
+    Path path;
+  };
+
+  struct Latency {
+    uint64_t count;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+  };
+
+  struct Result {
+    uint64_t capture_ns;  // audio time replayed
+    uint64_t wall_ns;
+    uint64_t mic_frames;
+    uint64_t frames_forwarded;  // past the VAD gate
+    uint64_t vad_wakes;
+    uint64_t wake_detections;
+    uint64_t uplink_packets;
+    uint64_t uplink_bytes;
+    uint64_t downlink_packets;
+    uint64_t frames_concealed;
+    uint64_t replies;
+    uint64_t playback_underruns;
+    uint64_t max_first_audio_ns;
+    uint64_t played_samples;  // reply audio, silence excluded
+    // Equal digests: the same packets sent, the same samples played.
+    Sha256::Digest uplink_digest;
+    Sha256::Digest playback_digest;
+    Latency uplink;
+    Latency downlink;
+    std::vector<Spike> slowest;  // slowest first
+  };
+
+  PipelineReplay(const CaptureFormat& format, Config config);
+  explicit PipelineReplay(const CaptureFormat& format)
+      : PipelineReplay(format, Config{}) {}
+
+  // False if this build cannot decode the capture's downlink (Opus
+  // without libopus) or its frames do not fit the uplink encoder.
+  bool ok() const { return ok_; }
+
+  // Replays `capture` from its first record.
+  Result run(CaptureReader& capture);
+
+ private:
+  CaptureFormat format_;
+  Config config_;
+  bool ok_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_REPLAY_PIPELINE_REPLAY_H_
@@ -0,0 +1,32 @@
+#include "runtime/async_event.h"
+
+namespace xiaozi {
+
+bool AsyncEvent::Awaiter::await_suspend(
+    std::coroutine_handle<> handle) noexcept {
+  resume_.capture(event_.fallback_, handle);
+  uintptr_t expected = kEmpty;
+  if (event_.state_.compare_exchange_strong(
+          expected, reinterpret_cast<uintptr_t>(this),
+          std::memory_order_acq_rel, std::memory_order_acquire)) {
+    return true;
+  }
+  // set() got in between await_ready() and here: consume it and go on.
+  event_.state_.store(kEmpty, std::memory_order_relaxed);
+  return false;
+}
+
+void AsyncEvent::set() {
+  uintptr_t state = state_.load(std::memory_order_acquire);
+  for (;;) {
+    if (state == kSet) return;
+    const uintptr_t next = state == kEmpty ? kSet : kEmpty;
+    if (state_.compare_exchange_weak(state, next, std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+      break;
+    }
+  }
+  if (state != kEmpty) reinterpret_cast<Awaiter*>(state)->resume_.resume();
+}
+
+}  // namespace xiaozi
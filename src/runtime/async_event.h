@@ -0,0 +1,69 @@
+#ifndef XIAOZI_RUNTIME_ASYNC_EVENT_H_
+#define XIAOZI_RUNTIME_ASYNC_EVENT_H_
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+
+#include "runtime/executor.h"
+#include "runtime/task.h"
+
+namespace xiaozi {
+
+// Auto-reset event a coroutine can co_await, set from any thread: the
+// bridge from audio callbacks (VadGate::Listener::on_wake, wake word hits,
+// playback drained) into protocol coroutines. set() never resumes the
+// waiter inline; it posts the resume to the executor, so the capture
+// thread only pays for a CAS and a post.
+//
+// One waiter at a time. A set() with nobody waiting is remembered and
+// consumed by the next co_await; several such set()s count once.
+class AsyncEvent {
+ public:
+  class Awaiter {
+   public:
+    bool await_ready() noexcept { return event_.try_consume(); }
+    bool await_suspend(std::coroutine_handle<> handle) noexcept;
+    void await_resume() const noexcept {}
+
+   private:
+    friend class AsyncEvent;
+    explicit Awaiter(AsyncEvent& event) : event_(event) {}
+
+    AsyncEvent& event_;
+    detail::ResumePoint resume_;
+  };
+
+  // Waiters suspended outside an executor resume on `fallback`.
+  explicit AsyncEvent(Executor& fallback) : fallback_(fallback) {}
+
+  AsyncEvent(const AsyncEvent&) = delete;
+  AsyncEvent& operator=(const AsyncEvent&) = delete;
+
+  Awaiter operator co_await() noexcept { return Awaiter(*this); }
+
+  // Any thread.
+  void set();
+  bool is_set() const {
+    return state_.load(std::memory_order_acquire) == kSet;
+  }
+
+ private:
+  static constexpr uintptr_t kEmpty = 0;
+  static constexpr uintptr_t kSet = 1;
+
+  bool try_consume() {
+    uintptr_t expected = kSet;
+    return state_.compare_exchange_strong(expected, kEmpty,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  Executor& fallback_;
+  // kEmpty, kSet, or the waiting Awaiter.
+  std::atomic<uintptr_t> state_{kEmpty};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUNTIME_ASYNC_EVENT_H_
@@ -0,0 +1,292 @@
+#include "runtime/executor.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+
+namespace xiaozi {
+namespace {
+
+uint32_t pack(uint32_t tag, uint16_t index) { return (tag << 16) | index; }
+uint16_t index_of(uint32_t head) { return static_cast<uint16_t>(head); }
+uint32_t tag_of(uint32_t head) { return head >> 16; }
+
+void pin_to_core(std::thread& thread, int core) {
+#if defined(__linux__)
+  if (core < 0 || core >= CPU_SETSIZE) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+  (void)thread;
+  (void)core;
+#endif
+}
+
+// The owning thread is the only writer.
+void bump(std::atomic<uint64_t>& counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+struct Context {
+  Executor* executor = nullptr;
+  void* worker = nullptr;
+  Priority priority = Priority::kInteractive;
+};
+
+thread_local Context t_context;
+
+}  // namespace
+
+struct alignas(kCacheLineSize) Executor::Worker {
+  std::size_t index = 0;
+  WorkStealingDeque<uint16_t, kDequeSlots> deques[2];
+  std::counting_semaphore<> wake{0};
+  std::thread thread;
+  std::atomic<uint64_t> executed{0};
+  std::atomic<uint64_t> stolen{0};
+  std::atomic<uint64_t> wakeups{0};
+};
+
+Executor::Executor(Config config)
+    : config_(std::move(config)),
+      worker_count_(std::clamp<std::size_t>(config_.workers, 1, kMaxWorkers)) {
+  config_.max_tasks = std::clamp<std::size_t>(config_.max_tasks, 1, kNil - 1);
+  nodes_.reset(new Node[config_.max_tasks]);
+  for (std::size_t i = 0; i < config_.max_tasks; ++i) {
+    const uint16_t next =
+        i + 1 < config_.max_tasks ? static_cast<uint16_t>(i + 1) : kNil;
+    nodes_[i].next_free.store(next, std::memory_order_relaxed);
+  }
+  free_head_.store(pack(0, 0), std::memory_order_release);
+
+  workers_.reset(new Worker[worker_count_]);
+  for (std::size_t i = 0; i < worker_count_; ++i) {
+    Worker& w = workers_[i];
+    w.index = i;
+    w.thread = std::thread([this, &w] { worker_main(w); });
+    if (i < config_.worker_cores.size()) {
+      pin_to_core(w.thread, config_.worker_cores[i]);
+    }
+  }
+  if (config_.realtime_lane) {
+    lane_thread_ = std::thread([this] { lane_main(); });
+    pin_to_core(lane_thread_, config_.realtime_core);
+    if (config_.realtime_sched_priority > 0) {
+      sched_param param{};
+      param.sched_priority = config_.realtime_sched_priority;
+      realtime_elevated_ = pthread_setschedparam(lane_thread_.native_handle(),
+                                                 SCHED_FIFO, &param) == 0;
+    }
+  }
+}
+
+Executor::~Executor() { stop(); }
+
+Executor* Executor::current() { return t_context.executor; }
+
+Priority Executor::current_priority() { return t_context.priority; }
+
+uint16_t Executor::allocate_node() {
+  uint32_t head = free_head_.load(std::memory_order_acquire);
+  for (;;) {
+    const uint16_t index = index_of(head);
+    if (index == kNil) return kNil;
+    const uint16_t next =
+        nodes_[index].next_free.load(std::memory_order_relaxed);
+    if (free_head_.compare_exchange_weak(head, pack(tag_of(head) + 1, next),
+                                         std::memory_order_acquire,
+                                         std::memory_order_acquire)) {
+      return index;
+    }
+  }
+}
+
+void Executor::release_node(uint16_t index) {
+  uint32_t head = free_head_.load(std::memory_order_relaxed);
+  do {
+    nodes_[index].next_free.store(index_of(head), std::memory_order_relaxed);
+  } while (!free_head_.compare_exchange_weak(head,
+                                             pack(tag_of(head) + 1, index),
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+void Executor::push_fifo(Fifo& fifo, uint16_t index) {
+  nodes_[index].next_queued = kNil;
+  std::lock_guard<std::mutex> lock(fifo.mutex);
+  if (fifo.tail == kNil) {
+    fifo.head = index;
+  } else {
+    nodes_[fifo.tail].next_queued = index;
+  }
+  fifo.tail = index;
+  fifo.size.fetch_add(1, std::memory_order_release);
+}
+
+uint16_t Executor::pop_fifo(Fifo& fifo) {
+  // Unlocked peek: the shared queues are empty most of the time.
+  if (fifo.size.load(std::memory_order_acquire) == 0) return kNil;
+  std::lock_guard<std::mutex> lock(fifo.mutex);
+  const uint16_t index = fifo.head;
+  if (index == kNil) return kNil;
+  fifo.head = nodes_[index].next_queued;
+  if (fifo.head == kNil) fifo.tail = kNil;
+  fifo.size.fetch_sub(1, std::memory_order_relaxed);
+  return index;
+}
+
+bool Executor::enqueue(uint16_t index, bool deferred) {
+  if (index == kNil) {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  Node& node = nodes_[index];
+  const bool inside = t_context.executor == this;
+  if (!inside && stopping_.load(std::memory_order_acquire)) {
+    node.invoke(node.storage, false);
+    release_node(index);
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (node.priority == Priority::kRealtime && config_.realtime_lane) {
+    push_fifo(lane_, index);
+    lane_wake_.release();
+    return true;
+  }
+  const std::size_t level = node.priority == Priority::kBackground ? 1 : 0;
+  auto* worker = static_cast<Worker*>(inside ? t_context.worker : nullptr);
+  if (worker == nullptr || !worker->deques[level].push(index)) {
+    push_fifo(shared_[level], index);
+    deferred = false;
+  }
+  if (!deferred) notify_one();
+  return true;
+}
+
+void Executor::notify_one() {
+  // Pairs with the fence in worker_main: either the sleeper sees the new
+  // task on its re-check, or this load sees its idle bit.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint32_t mask = idle_.load(std::memory_order_relaxed);
+  while (mask != 0) {
+    const uint32_t bit = mask & (~mask + 1);
+    if (idle_.fetch_and(~bit, std::memory_order_acq_rel) & bit) {
+      workers_[__builtin_ctz(bit)].wake.release();
+      return;
+    }
+    mask = idle_.load(std::memory_order_relaxed);
+  }
+}
+
+uint16_t Executor::find_task(Worker& worker, std::size_t level) {
+  if (auto index = worker.deques[level].pop()) return *index;
+  uint16_t index = pop_fifo(shared_[level]);
+  if (index != kNil) return index;
+  for (std::size_t i = 1; i < worker_count_; ++i) {
+    Worker& victim = workers_[(worker.index + i) % worker_count_];
+    if (auto stolen = victim.deques[level].steal()) {
+      bump(worker.stolen);
+      return *stolen;
+    }
+  }
+  return kNil;
+}
+
+uint16_t Executor::find_task(Worker& worker) {
+  const uint16_t index = find_task(worker, 0);
+  return index != kNil ? index : find_task(worker, 1);
+}
+
+void Executor::run(uint16_t index) {
+  Node& node = nodes_[index];
+  t_context.priority = node.priority;
+  node.invoke(node.storage, true);
+  release_node(index);
+}
+
+void Executor::worker_main(Worker& worker) {
+  t_context = Context{this, &worker, Priority::kInteractive};
+  const uint32_t bit = uint32_t{1} << worker.index;
+  for (;;) {
+    uint16_t index = find_task(worker);
+    if (index == kNil) {
+      idle_.fetch_or(bit, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      index = find_task(worker);
+      if (index == kNil) {
+        if (stopping_.load(std::memory_order_acquire)) {
+          idle_.fetch_and(~bit, std::memory_order_relaxed);
+          return;
+        }
+        worker.wake.acquire();
+        bump(worker.wakeups);
+        continue;
+      }
+      idle_.fetch_and(~bit, std::memory_order_relaxed);
+    }
+    run(index);
+    bump(worker.executed);
+  }
+}
+
+void Executor::lane_main() {
+  t_context = Context{this, nullptr, Priority::kRealtime};
+  for (;;) {
+    const uint16_t index = pop_fifo(lane_);
+    if (index != kNil) {
+      run(index);
+      bump(lane_executed_);
+      continue;
+    }
+    if (stopping_.load(std::memory_order_acquire)) return;
+    lane_wake_.acquire();
+  }
+}
+
+void Executor::stop() {
+  stopping_.store(true, std::memory_order_release);
+  for (std::size_t i = 0; i < worker_count_; ++i) workers_[i].wake.release();
+  for (std::size_t i = 0; i < worker_count_; ++i) {
+    if (workers_[i].thread.joinable()) workers_[i].thread.join();
+  }
+  lane_wake_.release();
+  if (lane_thread_.joinable()) lane_thread_.join();
+
+  // Left behind only if a realtime task posted to the workers after they
+  // had drained; destroy rather than leak the callables.
+  auto discard = [this](uint16_t index) {
+    nodes_[index].invoke(nodes_[index].storage, false);
+    release_node(index);
+  };
+  for (Fifo& fifo : shared_) {
+    for (uint16_t i = pop_fifo(fifo); i != kNil; i = pop_fifo(fifo)) {
+      discard(i);
+    }
+  }
+  for (std::size_t w = 0; w < worker_count_; ++w) {
+    for (auto& deque : workers_[w].deques) {
+      while (auto index = deque.steal()) discard(*index);
+    }
+  }
+}
+
+Executor::Stats Executor::stats() const {
+  Stats s{};
+  for (std::size_t i = 0; i < worker_count_; ++i) {
+    const Worker& w = workers_[i];
+    s.executed += w.executed.load(std::memory_order_relaxed);
+    s.stolen += w.stolen.load(std::memory_order_relaxed);
+    s.wakeups += w.wakeups.load(std::memory_order_relaxed);
+  }
+  s.executed_realtime = lane_executed_.load(std::memory_order_relaxed);
+  s.executed += s.executed_realtime;
+  s.rejected = rejected_.load(std::memory_order_relaxed);
+  s.realtime_elevated = realtime_elevated_;
+  return s;
+}
+
+}  // namespace xiaozi
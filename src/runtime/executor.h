@@ -0,0 +1,193 @@
+#ifndef XIAOZI_RUNTIME_EXECUTOR_H_
+#define XIAOZI_RUNTIME_EXECUTOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <semaphore>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "base/cache.h"
+#include "runtime/work_stealing_deque.h"
+
+namespace xiaozi {
+
+enum class Priority : uint8_t {
+  kRealtime,     // audio deadlines; own lane, never behind other work
+  kInteractive,  // network, display, MCP tool calls
+  kBackground,   // OTA, settings flush, logging
+};
+
+// Shared thread pool for the subsystems that used to own a thread each.
+// Tasks are small callables stored inline in preallocated nodes, so post()
+// never allocates; when all max_tasks nodes are in flight it fails and the
+// caller decides what to drop.
+//
+// Interactive and background tasks run on the workers. Each worker keeps
+// one Chase-Lev deque per class and prefers, in order: its own interactive
+// deque, the shared interactive queue, interactive work stolen from other
+// workers, then the same three for background. A worker never interrupts
+// the task it is running, so a long background task delays interactive
+// work on that worker until it returns; others steal around it.
+//
+// Realtime tasks bypass the workers entirely and run FIFO on a dedicated
+// lane thread (pinned, SCHED_FIFO where permitted), which the kernel
+// schedules ahead of any worker. Nothing but realtime tasks ever runs on
+// it. Keep realtime tasks short and non-blocking.
+//
+// Tasks are not ordered relative to each other, except on the realtime
+// lane. Anything that needs ordering chains itself with defer().
+class Executor {
+ public:
+  static constexpr std::size_t kTaskBytes = 48;
+  static constexpr std::size_t kMaxWorkers = 32;
+  static constexpr std::size_t kDequeSlots = 256;
+
+  struct Config {
+    std::size_t workers = 2;
+    // Core for worker i, or none (-1 or missing) to leave it floating.
+    std::vector<int> worker_cores;
+    bool realtime_lane = true;
+    int realtime_core = -1;
+    // SCHED_FIFO priority for the lane; 0 keeps the default policy.
+    int realtime_sched_priority = 0;
+    // Task nodes, in flight and queued together (at most 0xfffe).
+    std::size_t max_tasks = 1024;
+  };
+
+  struct Stats {
+    uint64_t executed;
+    uint64_t executed_realtime;
+    uint64_t stolen;
+    uint64_t wakeups;   // idle workers woken for new work
+    uint64_t rejected;  // post() found no free node or a stopped executor
+    bool realtime_elevated;  // the lane got SCHED_FIFO
+  };
+
+  explicit Executor(Config config);
+  Executor() : Executor(Config{}) {}
+  // stop()s.
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  // Any thread. Queues `fn` to run once and wakes an idle worker. Returns
+  // false, dropping `fn`, when out of task nodes or after stop().
+  template <typename F>
+  bool post(Priority priority, F&& fn) {
+    return enqueue(make_task(priority, std::forward<F>(fn)), false);
+  }
+
+  // Inside a task: queues `fn` as the continuation of the current task, at
+  // its priority, on the same worker, without waking another one. It
+  // normally runs next. Outside a task this is post(kInteractive, fn).
+  template <typename F>
+  bool defer(F&& fn) {
+    const bool inside = current() == this;
+    const Priority priority =
+        inside ? current_priority() : Priority::kInteractive;
+    return enqueue(make_task(priority, std::forward<F>(fn)), inside);
+  }
+
+  // Runs everything already queued (and whatever that queues from inside),
+  // rejects new posts from outside, then joins the threads. Call from the
+  // owning thread, not from a task.
+  void stop();
+  // True once stop() has begun; post() from outside a task then fails for
+  // good.
+  bool stopping() const { return stopping_.load(std::memory_order_acquire); }
+
+  // The executor whose thread is calling, or nullptr.
+  static Executor* current();
+  // Priority of the task running on this thread.
+  static Priority current_priority();
+
+  std::size_t workers() const { return worker_count_; }
+  Stats stats() const;
+
+ private:
+  static constexpr uint16_t kNil = 0xffff;
+
+  struct alignas(kCacheLineSize) Node {
+    alignas(std::max_align_t) std::byte storage[kTaskBytes];
+    // run == false only destroys the callable.
+    void (*invoke)(void* storage, bool run) = nullptr;
+    Priority priority = Priority::kInteractive;
+    uint16_t next_queued = kNil;          // shared/lane FIFO link
+    std::atomic<uint16_t> next_free{kNil};  // freelist link
+  };
+
+  struct Worker;
+  struct Fifo {
+    std::mutex mutex;
+    uint16_t head = kNil;
+    uint16_t tail = kNil;
+    std::atomic<uint32_t> size{0};
+  };
+
+  template <typename Fn>
+  static void invoke(void* storage, bool run) {
+    Fn& fn = *std::launder(reinterpret_cast<Fn*>(storage));
+    if (run) fn();
+    fn.~Fn();
+  }
+
+  template <typename F>
+  uint16_t make_task(Priority priority, F&& fn) {
+    using Fn = std::decay_t<F>;
+    static_assert(sizeof(Fn) <= kTaskBytes,
+                  "task captures too much; capture a pointer instead");
+    static_assert(alignof(Fn) <= alignof(std::max_align_t));
+    static_assert(std::is_invocable_v<Fn&>);
+    const uint16_t index = allocate_node();
+    if (index == kNil) return kNil;
+    Node& node = nodes_[index];
+    ::new (node.storage) Fn(std::forward<F>(fn));
+    node.invoke = &invoke<Fn>;
+    node.priority = priority;
+    return index;
+  }
+
+  uint16_t allocate_node();
+  void release_node(uint16_t index);
+  bool enqueue(uint16_t index, bool deferred);
+  void push_fifo(Fifo& fifo, uint16_t index);
+  uint16_t pop_fifo(Fifo& fifo);
+  void notify_one();
+  uint16_t find_task(Worker& worker);
+  uint16_t find_task(Worker& worker, std::size_t level);
+  void run(uint16_t index);
+  void worker_main(Worker& worker);
+  void lane_main();
+
+  Config config_;
+  std::unique_ptr<Node[]> nodes_;
+  // Low 16 bits: first free node; high 16 bits: ABA tag.
+  std::atomic<uint32_t> free_head_{0};
+
+  std::size_t worker_count_;
+  std::unique_ptr<Worker[]> workers_;
+  // Bit i set: worker i is about to sleep or asleep.
+  std::atomic<uint32_t> idle_{0};
+  Fifo shared_[2];  // interactive, background
+
+  Fifo lane_;
+  std::counting_semaphore<> lane_wake_{0};
+  std::thread lane_thread_;
+  std::atomic<uint64_t> lane_executed_{0};
+  bool realtime_elevated_ = false;
+
+  std::atomic<bool> stopping_{false};
+  std::atomic<uint64_t> rejected_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUNTIME_EXECUTOR_H_
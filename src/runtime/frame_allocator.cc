@@ -0,0 +1,92 @@
+#include "runtime/frame_allocator.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace xiaozi {
+namespace {
+
+// Room ahead of the frame for the owning FrameRef (empty for heap frames,
+// which keep their size in the last word), keeping the frame itself
+// max-aligned.
+constexpr std::size_t kPrefix = alignof(std::max_align_t);
+static_assert(sizeof(FrameRef) + sizeof(std::size_t) <= kPrefix);
+static_assert(FramePool::kPayloadOffset % kPrefix == 0);
+
+std::atomic<FrameAllocator*> g_installed{nullptr};
+
+FrameRef* owner_of(void* frame) {
+  return std::launder(
+      reinterpret_cast<FrameRef*>(static_cast<std::byte*>(frame) - kPrefix));
+}
+
+std::size_t* heap_size_of(void* frame) {
+  return reinterpret_cast<std::size_t*>(static_cast<std::byte*>(frame) -
+                                        sizeof(std::size_t));
+}
+
+}  // namespace
+
+FrameAllocator::FrameAllocator(Config config) : domain_(config.domain) {
+  for (std::size_t i = 0; i < kClasses; ++i) {
+    if (config.blocks[i] == 0) continue;
+    pools_[i] = std::make_unique<FramePool>(
+        kClassBytes[i], std::min(config.blocks[i], FramePool::kMaxBlocks),
+        domain_);
+  }
+}
+
+void* FrameAllocator::allocate(std::size_t bytes) {
+  const std::size_t needed = bytes + kPrefix;
+  for (std::size_t i = 0; i < kClasses; ++i) {
+    if (needed > kClassBytes[i] || pools_[i] == nullptr) continue;
+    FrameRef block = pools_[i]->acquire();
+    if (!block) continue;
+    std::byte* base = reinterpret_cast<std::byte*>(block.data());
+    ::new (base) FrameRef(std::move(block));
+    pooled_.fetch_add(1, std::memory_order_relaxed);
+    return base + kPrefix;
+  }
+  heap_fallback_.fetch_add(1, std::memory_order_relaxed);
+  memory::charge(domain_, needed, __builtin_return_address(0));
+  auto* base = static_cast<std::byte*>(::operator new(needed));
+  ::new (base) FrameRef();
+  *heap_size_of(base + kPrefix) = needed;
+  return base + kPrefix;
+}
+
+void FrameAllocator::deallocate(void* frame) {
+  FrameRef* owner = owner_of(frame);
+  if (*owner) {
+    FrameRef block = std::move(*owner);
+    owner->~FrameRef();
+    return;  // `block` goes back to its pool here
+  }
+  owner->~FrameRef();
+  memory::release(domain_, *heap_size_of(frame));
+  ::operator delete(static_cast<std::byte*>(frame) - kPrefix);
+}
+
+FrameAllocator::Stats FrameAllocator::stats() const {
+  Stats s{};
+  s.pooled = pooled_.load(std::memory_order_relaxed);
+  s.heap_fallback = heap_fallback_.load(std::memory_order_relaxed);
+  for (std::size_t i = 0; i < kClasses; ++i) {
+    if (pools_[i] != nullptr) s.high_water[i] = pools_[i]->stats().high_water;
+  }
+  return s;
+}
+
+FrameAllocator& FrameAllocator::global() {
+  FrameAllocator* installed = g_installed.load(std::memory_order_acquire);
+  if (installed != nullptr) return *installed;
+  static FrameAllocator fallback;
+  return fallback;
+}
+
+void FrameAllocator::install(FrameAllocator* allocator) {
+  g_installed.store(allocator, std::memory_order_release);
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,69 @@
+#ifndef XIAOZI_RUNTIME_FRAME_ALLOCATOR_H_
+#define XIAOZI_RUNTIME_FRAME_ALLOCATOR_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "memory/frame_pool.h"
+#include "memory/memory_domain.h"
+
+namespace xiaozi {
+
+// Coroutine frames from a few FramePools, one per size class. A frame
+// takes the smallest class that fits; the block starts with the FrameRef
+// that owns it, so deallocate() needs nothing but the pointer. Frames too
+// large for every class, or whose class ran dry, fall back to the heap and
+// are counted, so a stats() check shows whether the steady state is
+// allocation-free. Pools and heap frames are charged to Config::domain;
+// a frame cannot be refused, so heap frames are charged past its budget.
+//
+// allocate() and deallocate() are lock-free and may run on any thread.
+class FrameAllocator {
+ public:
+  static constexpr std::size_t kClasses = 4;
+  static constexpr std::array<std::size_t, kClasses> kClassBytes = {
+      256, 512, 1024, 4096};
+
+  struct Config {
+    // Blocks per size class.
+    std::array<std::size_t, kClasses> blocks = {128, 64, 32, 8};
+    MemoryDomain domain = MemoryDomain::kUntagged;
+  };
+
+  struct Stats {
+    uint64_t pooled;         // allocations served from a pool
+    uint64_t heap_fallback;  // allocations that went to operator new
+    std::array<uint32_t, kClasses> high_water;
+  };
+
+  explicit FrameAllocator(Config config);
+  FrameAllocator() : FrameAllocator(Config{}) {}
+
+  FrameAllocator(const FrameAllocator&) = delete;
+  FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+  void* allocate(std::size_t bytes);
+  void deallocate(void* frame);
+
+  Stats stats() const;
+
+  // The allocator behind every Task frame. Lazily built with the default
+  // Config unless install() ran first.
+  static FrameAllocator& global();
+  // Replaces the global allocator; call before the first coroutine starts.
+  // `allocator` must outlive every frame.
+  static void install(FrameAllocator* allocator);
+
+ private:
+  MemoryDomain domain_;
+  std::array<std::unique_ptr<FramePool>, kClasses> pools_;
+  std::atomic<uint64_t> pooled_{0};
+  std::atomic<uint64_t> heap_fallback_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUNTIME_FRAME_ALLOCATOR_H_
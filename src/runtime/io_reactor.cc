@@ -0,0 +1,142 @@
+#include "runtime/io_reactor.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "base/clock.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr int kMaxEvents = 16;
+
+bool later(const auto& a, const auto& b) {
+  return a.deadline_ns > b.deadline_ns;
+}
+
+}  // namespace
+
+const uint32_t IoReactor::kReadEvents = EPOLLIN | EPOLLRDHUP;
+const uint32_t IoReactor::kWriteEvents = EPOLLOUT;
+
+bool IoReactor::FdAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  resume_.capture(reactor_.executor_, handle);
+  epoll_event ev{};
+  ev.events = events_ | EPOLLONESHOT;
+  ev.data.ptr = this;
+  // Once this succeeds the reactor may resume the coroutine on another
+  // thread, which can destroy *this; do not touch members afterwards.
+  if (epoll_ctl(reactor_.epoll_fd_, EPOLL_CTL_MOD, fd_, &ev) == 0) return true;
+  if (errno == ENOENT &&
+      epoll_ctl(reactor_.epoll_fd_, EPOLL_CTL_ADD, fd_, &ev) == 0) {
+    return true;
+  }
+  error_ = -errno;
+  return false;
+}
+
+bool IoReactor::TimerAwaiter::await_ready() const noexcept {
+  return deadline_ns_ <= monotonic_ns();
+}
+
+void IoReactor::TimerAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  resume_.capture(reactor_.executor_, handle);
+  reactor_.add_timer(this);
+}
+
+IoReactor::IoReactor(Executor& executor, Config config)
+    : executor_(executor) {
+  timers_.reserve(config.max_timers);
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+    epoll_fd_ = wake_fd_ = -1;
+    return;
+  }
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+  thread_ = std::thread([this] { run(); });
+}
+
+IoReactor::~IoReactor() {
+  if (!ok()) return;
+  stopping_.store(true, std::memory_order_release);
+  const uint64_t one = 1;
+  (void)::write(wake_fd_, &one, sizeof(one));
+  thread_.join();
+  ::close(wake_fd_);
+  ::close(epoll_fd_);
+}
+
+IoReactor::TimerAwaiter IoReactor::sleep_for(std::chrono::nanoseconds delay) {
+  const auto ns = static_cast<uint64_t>(std::max<int64_t>(delay.count(), 0));
+  return TimerAwaiter(*this, monotonic_ns() + ns);
+}
+
+void IoReactor::add_timer(TimerAwaiter* awaiter) {
+  bool earliest;
+  {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    timers_.push_back(Timer{awaiter->deadline_ns_, awaiter});
+    std::push_heap(timers_.begin(), timers_.end(), later<Timer, Timer>);
+    earliest = timers_.front().awaiter == awaiter;
+  }
+  if (earliest) {
+    const uint64_t one = 1;
+    (void)::write(wake_fd_, &one, sizeof(one));
+  }
+}
+
+int IoReactor::next_timeout_ms() {
+  std::lock_guard<std::mutex> lock(timers_mutex_);
+  if (timers_.empty()) return -1;
+  const uint64_t now = monotonic_ns();
+  const uint64_t deadline = timers_.front().deadline_ns;
+  if (deadline <= now) return 0;
+  // Round up so the wait never ends before the deadline.
+  return static_cast<int>(
+      std::min<uint64_t>((deadline - now + 999'999) / 1'000'000, 60'000));
+}
+
+void IoReactor::fire_expired() {
+  const uint64_t now = monotonic_ns();
+  for (;;) {
+    TimerAwaiter* awaiter;
+    {
+      std::lock_guard<std::mutex> lock(timers_mutex_);
+      if (timers_.empty() || timers_.front().deadline_ns > now) return;
+      awaiter = timers_.front().awaiter;
+      std::pop_heap(timers_.begin(), timers_.end(), later<Timer, Timer>);
+      timers_.pop_back();
+    }
+    // Unlocked: once the executor has stopped the coroutine resumes here,
+    // and may add a timer of its own.
+    awaiter->resume_.resume();
+  }
+}
+
+void IoReactor::run() {
+  epoll_event events[kMaxEvents];
+  while (!stopping_.load(std::memory_order_acquire)) {
+    const int n = epoll_wait(epoll_fd_, events, kMaxEvents, next_timeout_ms());
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.ptr == nullptr) {
+        uint64_t count;
+        (void)::read(wake_fd_, &count, sizeof(count));
+        continue;
+      }
+      static_cast<FdAwaiter*>(events[i].data.ptr)->resume_.resume();
+    }
+    fire_expired();
+  }
+}
+
+}  // namespace xiaozi
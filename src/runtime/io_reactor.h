@@ -0,0 +1,116 @@
+#ifndef XIAOZI_RUNTIME_IO_REACTOR_H_
+#define XIAOZI_RUNTIME_IO_REACTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "runtime/executor.h"
+#include "runtime/task.h"
+
+namespace xiaozi {
+
+// Readiness and timer notifications for coroutines. One thread sits in
+// epoll_wait(); when an fd a coroutine waits on becomes ready, or its timer
+// expires, the coroutine is resumed as an executor task at the priority it
+// suspended with. Nothing but that bookkeeping runs on the reactor thread,
+// unless the executor has stopped; then the coroutine resumes there.
+//
+// At most one coroutine may wait on a given fd at a time (one-shot epoll
+// registration per fd). Timers are kept in a heap reserved for max_timers
+// entries; more than that still works but allocates.
+class IoReactor {
+ public:
+  struct Config {
+    std::size_t max_timers = 64;
+  };
+
+  // Suspends until the fd is readable/writable (or errored/hung up, which
+  // the next read or write reports). co_await yields 0, or -errno if the
+  // fd could not be registered.
+  class FdAwaiter {
+   public:
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle);
+    int await_resume() const noexcept { return error_; }
+
+   private:
+    friend class IoReactor;
+    FdAwaiter(IoReactor& reactor, int fd, uint32_t events)
+        : reactor_(reactor), fd_(fd), events_(events) {}
+
+    IoReactor& reactor_;
+    int fd_;
+    uint32_t events_;
+    int error_ = 0;
+    detail::ResumePoint resume_;
+  };
+
+  class TimerAwaiter {
+   public:
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const noexcept {}
+
+   private:
+    friend class IoReactor;
+    TimerAwaiter(IoReactor& reactor, uint64_t deadline_ns)
+        : reactor_(reactor), deadline_ns_(deadline_ns) {}
+
+    IoReactor& reactor_;
+    uint64_t deadline_ns_;
+    detail::ResumePoint resume_;
+  };
+
+  // Resumes coroutines on `executor`, which must outlive the reactor.
+  IoReactor(Executor& executor, Config config);
+  explicit IoReactor(Executor& executor) : IoReactor(executor, Config{}) {}
+  // Timers still pending are dropped with their coroutines suspended.
+  ~IoReactor();
+
+  IoReactor(const IoReactor&) = delete;
+  IoReactor& operator=(const IoReactor&) = delete;
+
+  bool ok() const { return epoll_fd_ >= 0; }
+
+  FdAwaiter readable(int fd) { return FdAwaiter(*this, fd, kReadEvents); }
+  FdAwaiter writable(int fd) { return FdAwaiter(*this, fd, kWriteEvents); }
+  // monotonic_ns() time base.
+  TimerAwaiter sleep_until(uint64_t deadline_ns) {
+    return TimerAwaiter(*this, deadline_ns);
+  }
+  TimerAwaiter sleep_for(std::chrono::nanoseconds delay);
+
+  Executor& executor() { return executor_; }
+
+ private:
+  static const uint32_t kReadEvents;
+  static const uint32_t kWriteEvents;
+
+  struct Timer {
+    uint64_t deadline_ns;
+    TimerAwaiter* awaiter;
+  };
+
+  void add_timer(TimerAwaiter* awaiter);
+  int next_timeout_ms();
+  void fire_expired();
+  void run();
+
+  Executor& executor_;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;  // eventfd: a new timer may be the earliest
+  std::mutex timers_mutex_;
+  std::vector<Timer> timers_;  // min-heap on deadline
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUNTIME_IO_REACTOR_H_
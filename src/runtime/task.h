@@ -0,0 +1,172 @@
+#ifndef XIAOZI_RUNTIME_TASK_H_
+#define XIAOZI_RUNTIME_TASK_H_
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "runtime/executor.h"
+#include "runtime/frame_allocator.h"
+
+namespace xiaozi {
+
+namespace detail {
+
+// Frames come from FrameAllocator::global() instead of the heap.
+struct FramePromise {
+  static void* operator new(std::size_t bytes) {
+    return FrameAllocator::global().allocate(bytes);
+  }
+  static void operator delete(void* frame) {
+    FrameAllocator::global().deallocate(frame);
+  }
+  // The library is built without relying on exceptions; one escaping a
+  // coroutine is a bug.
+  void unhandled_exception() { std::terminate(); }
+};
+
+// Resumes `handle` as a task on `executor`, not on the calling thread.
+// After stop() the executor never runs it, so it resumes right here
+// instead, and runs on to completion, freeing its frames, rather than
+// leaking them or spinning.
+inline void resume_later(Executor* executor, Priority priority,
+                         std::coroutine_handle<> handle) {
+  while (!executor->post(priority, [handle] { handle.resume(); })) {
+    if (executor->stopping() && Executor::current() != executor) {
+      handle.resume();
+      return;
+    }
+    // Out of task nodes only under overload; the resume must not be lost.
+    std::this_thread::yield();
+  }
+}
+
+// Where an awaiter resumes its coroutine, captured at suspension: the
+// executor and priority of the suspending task, or interactive work on
+// `fallback` when it was suspended outside any executor.
+struct ResumePoint {
+  Executor* executor = nullptr;
+  Priority priority = Priority::kInteractive;
+  std::coroutine_handle<> handle;
+
+  void capture(Executor& fallback, std::coroutine_handle<> h) {
+    executor = Executor::current();
+    priority = executor != nullptr ? Executor::current_priority()
+                                   : Priority::kInteractive;
+    if (executor == nullptr) executor = &fallback;
+    handle = h;
+  }
+  void resume() const { resume_later(executor, priority, handle); }
+};
+
+}  // namespace detail
+
+// Lazily started coroutine returning T. Nothing runs until the Task is
+// co_awaited (by another coroutine) or handed to spawn(); the awaiting
+// coroutine resumes directly from the final suspend point, with no trip
+// through the executor. Move-only; destroying an unstarted Task destroys
+// its frame.
+//
+// Protocol flows written as Tasks keep their per-request state in the
+// coroutine frame, which lives in a FrameAllocator pool block rather than
+// on the heap.
+template <typename T = void>
+class Task {
+ public:
+  struct promise_type;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend(Handle h) noexcept {
+      auto next = h.promise().continuation;
+      return next ? next : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  struct PromiseBase : detail::FramePromise {
+    std::coroutine_handle<> continuation;
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+  };
+
+  struct promise_type : PromiseBase {
+    std::optional<T> value;
+    Task get_return_object() { return Task(Handle::from_promise(*this)); }
+    template <typename U>
+    void return_value(U&& v) {
+      value.emplace(std::forward<U>(v));
+    }
+  };
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle_) handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  ~Task() {
+    if (handle_) handle_.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    handle_.promise().continuation = awaiting;
+    return handle_;
+  }
+  T await_resume() { return std::move(*handle_.promise().value); }
+
+ private:
+  explicit Task(Handle handle) : handle_(handle) {}
+  Handle handle_;
+};
+
+template <>
+struct Task<void>::promise_type : Task<void>::PromiseBase {
+  Task get_return_object() { return Task(Handle::from_promise(*this)); }
+  void return_void() {}
+};
+
+template <>
+inline void Task<void>::await_resume() {}
+
+namespace detail {
+
+// Owns itself: destroyed as soon as the spawned task returns.
+struct Detached {
+  struct promise_type : FramePromise {
+    Detached get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+  };
+  std::coroutine_handle<promise_type> handle;
+};
+
+inline Detached run_detached(Task<void> task) { co_await std::move(task); }
+
+}  // namespace detail
+
+// Starts `task` as a `priority` task on `executor` and lets it run to
+// completion on its own. Returns false (and drops the task) when the
+// executor has no free task node.
+inline bool spawn(Executor& executor, Priority priority, Task<void> task) {
+  auto handle = detail::run_detached(std::move(task)).handle;
+  if (!executor.post(priority, [handle] { handle.resume(); })) {
+    handle.destroy();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUNTIME_TASK_H_
@@ -0,0 +1,95 @@
+#ifndef XIAOZI_RUNTIME_WORK_STEALING_DEQUE_H_
+#define XIAOZI_RUNTIME_WORK_STEALING_DEQUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+#include "base/cache.h"
+
+namespace xiaozi {
+
+// Bounded Chase-Lev deque of small trivially copyable values (task
+// indices), after Le et al., "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (PPoPP'13). The owner thread push()es and pop()s at the
+// bottom, LIFO; any other thread may steal() from the top, FIFO.
+//
+// Fixed capacity instead of a growable array: a full deque makes push()
+// fail and the caller spills elsewhere. Counters are 32-bit and compared
+// by difference so the deque stays lock-free on 32-bit cores.
+template <typename T, std::size_t N>
+class WorkStealingDeque {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two");
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  WorkStealingDeque() = default;
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Owner only.
+  bool push(T value) {
+    const uint32_t b = bottom_.load(std::memory_order_relaxed);
+    const uint32_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= N) return false;
+    slots_[b & (N - 1)].store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only. Newest first.
+  std::optional<T> pop() {
+    const uint32_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t t = top_.load(std::memory_order_relaxed);
+    if (static_cast<int32_t>(b - t) < 0) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    T value = slots_[b & (N - 1)].load(std::memory_order_relaxed);
+    if (b == t) {
+      // Last element: race the thieves for it.
+      const bool won = top_.compare_exchange_strong(
+          t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      if (!won) return std::nullopt;
+    }
+    return value;
+  }
+
+  // Any thread. Oldest first; nullopt when empty or when another thief (or
+  // the owner) won the race, in which case trying again may succeed.
+  std::optional<T> steal() {
+    uint32_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const uint32_t b = bottom_.load(std::memory_order_acquire);
+    if (static_cast<int32_t>(b - t) <= 0) return std::nullopt;
+    T value = slots_[t & (N - 1)].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  // Racy snapshot; exact only on the owner thread with no thieves.
+  bool empty() const {
+    const uint32_t b = bottom_.load(std::memory_order_relaxed);
+    const uint32_t t = top_.load(std::memory_order_relaxed);
+    return static_cast<int32_t>(b - t) <= 0;
+  }
+
+ private:
+  alignas(kCacheLineSize) std::atomic<uint32_t> top_{0};
+  alignas(kCacheLineSize) std::atomic<uint32_t> bottom_{0};
+  alignas(kCacheLineSize) std::array<std::atomic<T>, N> slots_{};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUNTIME_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,37 @@
+#ifndef XIAOZI_RUST_RUST_AES_CTR_H_
+#define XIAOZI_RUST_RUST_AES_CTR_H_
+
+// Only built with the Rust crate (XIAOZI_HAVE_RUST).
+
+#include <cstdint>
+#include <span>
+
+#include "rust/xiaozi_rs.h"
+
+namespace xiaozi {
+
+// Drop-in for AesCtr backed by the Rust cipher, which is AES-NI only:
+// ok() is false on any other CPU, and callers use AesCtr there. Same
+// keystream as OpenSSL's AES-128-CTR. One instance per direction; not
+// thread-safe.
+class RustAesCtr {
+ public:
+  explicit RustAesCtr(std::span<const uint8_t, 16> key)
+      : ctx_(xz_rs_aes128_ctr_new(key.data())) {}
+  ~RustAesCtr() { xz_rs_aes128_ctr_free(ctx_); }
+  RustAesCtr(const RustAesCtr&) = delete;
+  RustAesCtr& operator=(const RustAesCtr&) = delete;
+
+  bool ok() const { return ctx_ != nullptr; }
+
+  void apply(std::span<const uint8_t, 16> iv, std::span<uint8_t> data) {
+    xz_rs_aes128_ctr_apply(ctx_, iv.data(), data.data(), data.size());
+  }
+
+ private:
+  XzRsAes128Ctr* ctx_;
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUST_RUST_AES_CTR_H_
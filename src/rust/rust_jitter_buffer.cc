@@ -0,0 +1,70 @@
+#include "rust/rust_jitter_buffer.h"
+
+namespace xiaozi {
+namespace {
+
+void release_frame(void* raw) { FrameRef::from_raw(raw).reset(); }
+
+}  // namespace
+
+RustJitterBuffer::RustJitterBuffer(Config config)
+    : jb_(xz_rs_jitter_new(config.frame_ms, config.min_frames,
+                           config.max_frames, release_frame)) {}
+
+RustJitterBuffer::~RustJitterBuffer() { xz_rs_jitter_free(jb_); }
+
+bool RustJitterBuffer::push(FrameRef packet) {
+  if (!inbox_.try_push(std::move(packet))) {
+    inbox_drops_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void RustJitterBuffer::drain_inbox() {
+  FrameRef packet;
+  while (inbox_.try_pop(packet)) {
+    const uint32_t seq = packet.sequence();
+    const uint64_t arrival = packet.timestamp_ns();
+    xz_rs_jitter_insert(jb_, packet.into_raw(), seq, arrival);
+  }
+}
+
+RustJitterBuffer::Status RustJitterBuffer::pop(FrameRef& packet) {
+  drain_inbox();
+  packet.reset();
+  void* token = nullptr;
+  switch (xz_rs_jitter_pop(jb_, &token)) {
+    case 0:
+      packet = FrameRef::from_raw(token);
+      return Status::kPacket;
+    case 1:
+      return Status::kLost;
+    default:
+      return Status::kNotReady;
+  }
+}
+
+void RustJitterBuffer::reset() {
+  FrameRef packet;
+  while (inbox_.try_pop(packet)) packet.reset();
+  xz_rs_jitter_reset(jb_);
+}
+
+RustJitterBuffer::Stats RustJitterBuffer::stats() const {
+  XzRsJitterStats r;
+  xz_rs_jitter_stats(jb_, &r);
+  Stats s;
+  s.received = r.received;
+  s.late = r.late;
+  s.duplicates = r.duplicates;
+  s.lost = r.lost;
+  s.dropped = r.dropped + inbox_drops_.load(std::memory_order_relaxed);
+  s.underruns = r.underruns;
+  s.target_frames = r.target_frames;
+  s.depth_frames = r.depth_frames;
+  s.jitter_ms = r.jitter_ms;
+  return s;
+}
+
+}  // namespace xiaozi
@@ -0,0 +1,48 @@
+#ifndef XIAOZI_RUST_RUST_JITTER_BUFFER_H_
+#define XIAOZI_RUST_RUST_JITTER_BUFFER_H_
+
+// Only built with the Rust crate (XIAOZI_HAVE_RUST).
+
+#include <atomic>
+#include <cstdint>
+
+#include "audio/jitter_buffer.h"
+#include "memory/frame_pool.h"
+#include "memory/spsc_ring.h"
+#include "rust/xiaozi_rs.h"
+
+namespace xiaozi {
+
+// JitterBuffer with the playout logic in Rust. Same interface, threading
+// and decisions; packets stay in their pool and only the FrameRef handle
+// crosses into Rust. The transport-thread inbox is the same SpscRing, so
+// push() never calls into Rust.
+class RustJitterBuffer {
+ public:
+  using Config = JitterBuffer::Config;
+  using Status = JitterBuffer::Status;
+  using Stats = JitterBuffer::Stats;
+
+  explicit RustJitterBuffer(Config config);
+  RustJitterBuffer() : RustJitterBuffer(Config{}) {}
+  ~RustJitterBuffer();
+
+  RustJitterBuffer(const RustJitterBuffer&) = delete;
+  RustJitterBuffer& operator=(const RustJitterBuffer&) = delete;
+
+  bool push(FrameRef packet);
+  Status pop(FrameRef& packet);
+  void reset();
+  Stats stats() const;
+
+ private:
+  void drain_inbox();
+
+  XzRsJitter* jb_;
+  SpscRing<FrameRef, JitterBuffer::kSlots> inbox_;
+  std::atomic<uint64_t> inbox_drops_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_RUST_RUST_JITTER_BUFFER_H_
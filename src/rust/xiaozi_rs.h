@@ -0,0 +1,49 @@
+#ifndef XIAOZI_RUST_XIAOZI_RS_H_
+#define XIAOZI_RUST_XIAOZI_RS_H_
+
+// C declarations of the Rust crate in rust/ (src/lib.rs); only built with
+// XIAOZI_HAVE_RUST. Keep in sync with the #[no_mangle] functions there.
+// Buffers are borrowed for the duration of a call and worked on in place;
+// packets cross as FrameRef::into_raw() tokens.
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+
+struct XzRsAes128Ctr;
+struct XzRsJitter;
+
+struct XzRsJitterStats {
+  uint64_t received;
+  uint64_t late;
+  uint64_t duplicates;
+  uint64_t lost;
+  uint64_t dropped;
+  uint64_t underruns;
+  uint32_t target_frames;
+  uint32_t depth_frames;
+  double jitter_ms;
+};
+
+// Null on a CPU without AES instructions.
+XzRsAes128Ctr* xz_rs_aes128_ctr_new(const uint8_t* key);
+void xz_rs_aes128_ctr_free(XzRsAes128Ctr* ctx);
+void xz_rs_aes128_ctr_apply(const XzRsAes128Ctr* ctx, const uint8_t* iv,
+                            uint8_t* data, size_t len);
+
+// `release` gets back every token the buffer discards (late, duplicate,
+// dropped to catch up, reset or freed).
+XzRsJitter* xz_rs_jitter_new(uint32_t frame_ms, uint32_t min_frames,
+                             uint32_t max_frames, void (*release)(void*));
+void xz_rs_jitter_free(XzRsJitter* jb);
+void xz_rs_jitter_insert(XzRsJitter* jb, void* token, uint32_t sequence,
+                         uint64_t arrival_ns);
+// 0: packet in *token, 1: lost, 2: not ready.
+uint32_t xz_rs_jitter_pop(XzRsJitter* jb, void** token);
+void xz_rs_jitter_reset(XzRsJitter* jb);
+void xz_rs_jitter_stats(const XzRsJitter* jb, XzRsJitterStats* out);
+
+}  // extern "C"
+
+#endif  // XIAOZI_RUST_XIAOZI_RS_H_
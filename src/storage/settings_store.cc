@@ -0,0 +1,393 @@
+#include "storage/settings_store.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+
+#include "base/clock.h"
+#include "base/perfect_hash.h"
+
+namespace xiaozi {
+namespace {
+
+using settings::RecordHeader;
+using settings::SectorHeader;
+using settings::Type;
+
+constexpr std::size_t kCrcOffset = sizeof(uint32_t);
+
+constexpr std::array<uint32_t, 256> make_crc_table() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (c & 1 ? 0xedb88320u : 0u);
+    table[i] = c;
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, 256> kCrcTable = make_crc_table();
+
+// CRC-32 (IEEE, reflected), as zlib computes it.
+uint32_t crc32(std::span<const uint8_t> data) {
+  uint32_t crc = 0xffffffffu;
+  for (uint8_t b : data) crc = kCrcTable[(crc ^ b) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+bool all_erased(std::span<const uint8_t> bytes) {
+  return std::all_of(bytes.begin(), bytes.end(),
+                     [](uint8_t b) { return b == 0xff; });
+}
+
+}  // namespace
+
+SettingsStore::SettingsStore(FlashPartition& partition, Config config)
+    : partition_(partition),
+      config_(config),
+      mask_(std::bit_ceil(std::max<std::size_t>(config.capacity, 1) * 2) - 1),
+      slots_(std::make_unique<Slot[]>(mask_ + 1)),
+      sectors_(partition.size() / partition.sector_size()) {
+  load();
+}
+
+std::size_t SettingsStore::record_bytes(std::size_t key_bytes,
+                                        std::size_t value_bytes) {
+  return (sizeof(RecordHeader) + key_bytes + value_bytes + 3) & ~std::size_t{3};
+}
+
+const SettingsStore::Slot* SettingsStore::find(std::string_view key) const {
+  const auto h = static_cast<std::size_t>(perfect_hash::hash(key, 0));
+  for (std::size_t i = h & mask_;; i = (i + 1) & mask_) {
+    const Slot& slot = slots_[i];
+    // Slots are never freed, so the first unused one ends the probe.
+    if (!slot.used.load(std::memory_order_acquire)) return nullptr;
+    if (slot.name() == key) return &slot;
+  }
+}
+
+void SettingsStore::read(const Slot& slot, Value& out) const {
+  for (;;) {
+    const uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq & 1) {
+      // A writer was preempted mid-store; let it finish.
+      std::this_thread::yield();
+      continue;
+    }
+    out.type = static_cast<Type>(slot.type.load(std::memory_order_relaxed));
+    out.bytes = slot.value_bytes.load(std::memory_order_relaxed);
+    for (std::size_t w = 0; w < kValueWords; ++w) {
+      out.words[w] = slot.value[w].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) == seq) return;
+  }
+}
+
+void SettingsStore::store(Slot& slot, Type type,
+                          std::span<const uint8_t> value) {
+  std::array<uint64_t, kValueWords> words{};
+  std::memcpy(words.data(), value.data(), value.size());
+  const uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.type.store(static_cast<uint8_t>(type), std::memory_order_relaxed);
+  slot.value_bytes.store(static_cast<uint8_t>(value.size()),
+                         std::memory_order_relaxed);
+  for (std::size_t w = 0; w < kValueWords; ++w) {
+    slot.value[w].store(words[w], std::memory_order_relaxed);
+  }
+  slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+std::optional<int64_t> SettingsStore::get_int(std::string_view key) const {
+  const Slot* slot = find(key);
+  if (slot == nullptr) return std::nullopt;
+  Value v;
+  read(*slot, v);
+  if (v.type != Type::kInt) return std::nullopt;
+  int64_t value;
+  std::memcpy(&value, v.words.data(), sizeof(value));
+  return value;
+}
+
+std::optional<std::size_t> SettingsStore::get_bytes(
+    std::string_view key, std::span<uint8_t> out) const {
+  const Slot* slot = find(key);
+  if (slot == nullptr) return std::nullopt;
+  Value v;
+  read(*slot, v);
+  if (v.type != Type::kBytes) return std::nullopt;
+  std::memcpy(out.data(), v.words.data(),
+              std::min<std::size_t>(out.size(), v.bytes));
+  return v.bytes;
+}
+
+bool SettingsStore::set_int(std::string_view key, int64_t value) {
+  uint8_t bytes[sizeof(value)];
+  std::memcpy(bytes, &value, sizeof(value));
+  return set(key, Type::kInt, bytes, true);
+}
+
+bool SettingsStore::set_bytes(std::string_view key,
+                              std::span<const uint8_t> value) {
+  return set(key, Type::kBytes, value, true);
+}
+
+bool SettingsStore::set(std::string_view key, Type type,
+                        std::span<const uint8_t> value, bool pending) {
+  if (key.empty() || key.size() > settings::kMaxKeyBytes ||
+      value.size() > settings::kMaxValueBytes) {
+    return false;
+  }
+  const std::size_t bytes = record_bytes(key.size(), value.size());
+  const std::size_t limit = partition_.sector_size() / 2;
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto h = static_cast<std::size_t>(perfect_hash::hash(key, 0));
+  std::size_t i = h & mask_;
+  while (slots_[i].used.load(std::memory_order_relaxed) &&
+         slots_[i].name() != key) {
+    i = (i + 1) & mask_;
+  }
+  Slot& slot = slots_[i];
+  if (!slot.used.load(std::memory_order_relaxed)) {
+    if (keys_ == config_.capacity ||
+        sizeof(SectorHeader) + snapshot_bytes_ + bytes > limit) {
+      return false;
+    }
+    slot.key_bytes = static_cast<uint8_t>(key.size());
+    std::memcpy(slot.key, key.data(), key.size());
+    store(slot, type, value);
+    slot.used.store(true, std::memory_order_release);
+    ++keys_;
+    snapshot_bytes_ += bytes;
+  } else {
+    Value old;
+    read(slot, old);
+    if (old.type == type && old.bytes == value.size() &&
+        std::memcmp(old.words.data(), value.data(), value.size()) == 0) {
+      // Unchanged: nothing to write.
+      if (pending) sets_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    const std::size_t old_bytes = record_bytes(key.size(), old.bytes);
+    if (sizeof(SectorHeader) + snapshot_bytes_ - old_bytes + bytes > limit) {
+      return false;
+    }
+    snapshot_bytes_ = snapshot_bytes_ - old_bytes + bytes;
+    store(slot, type, value);
+  }
+  if (!pending) return true;
+  sets_.fetch_add(1, std::memory_order_relaxed);
+  if (slot.dirty) {
+    coalesced_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    mark_dirty(slot);
+  }
+  return true;
+}
+
+void SettingsStore::mark_dirty(Slot& slot) {
+  slot.dirty = true;
+  if (dirty_count_.fetch_add(1, std::memory_order_relaxed) == 0) {
+    first_dirty_ns_ = monotonic_ns();
+  }
+}
+
+void SettingsStore::append_record(std::vector<uint8_t>& out,
+                                  const Slot& slot) const {
+  Value v;
+  read(slot, v);
+  const RecordHeader header{0, slot.key_bytes, v.type, v.bytes};
+  const std::size_t start = out.size();
+  out.resize(start + record_bytes(slot.key_bytes, v.bytes), 0xff);
+  uint8_t* p = out.data() + start;
+  std::memcpy(p, &header, sizeof(header));
+  std::memcpy(p + sizeof(header), slot.key, slot.key_bytes);
+  std::memcpy(p + sizeof(header) + slot.key_bytes, v.words.data(), v.bytes);
+  // Padding stays 0xff, which leaves the erased bytes as they are.
+  const uint32_t crc = crc32(
+      {p + kCrcOffset, sizeof(header) - kCrcOffset + slot.key_bytes + v.bytes});
+  std::memcpy(p, &crc, sizeof(crc));
+}
+
+void SettingsStore::load() {
+  // With nothing on flash the first compaction goes to sector 0.
+  sector_ = sectors_ - 1;
+  if (sectors_ < 2) return;
+  const std::size_t sector_size = partition_.sector_size();
+  bool found = false;
+  for (std::size_t s = 0; s < sectors_; ++s) {
+    SectorHeader header;
+    if (!partition_.read(s * sector_size,
+                         {reinterpret_cast<uint8_t*>(&header),
+                          sizeof(header)}) ||
+        std::memcmp(header.magic, settings::kMagic, sizeof(header.magic)) !=
+            0 ||
+        header.committed != settings::kCommitted) {
+      continue;
+    }
+    // Serial number order, so the sequence may wrap.
+    if (!found || static_cast<int32_t>(header.sequence - sequence_) > 0) {
+      found = true;
+      sector_ = s;
+      sequence_ = header.sequence;
+    }
+  }
+  if (!found) return;
+  append_ = replay(sector_);
+  reported_sequence_.store(sequence_, std::memory_order_relaxed);
+}
+
+std::size_t SettingsStore::replay(std::size_t sector) {
+  const std::size_t sector_size = partition_.sector_size();
+  std::vector<uint8_t> data(sector_size);
+  if (!partition_.read(sector * sector_size, data)) return 0;
+  std::size_t at = sizeof(SectorHeader);
+  while (at + sizeof(RecordHeader) <= data.size()) {
+    const std::span<const uint8_t> rest(data.data() + at, data.size() - at);
+    if (all_erased(rest.first(sizeof(RecordHeader)))) return at;
+    RecordHeader header;
+    std::memcpy(&header, rest.data(), sizeof(header));
+    const bool valid_type =
+        header.type == Type::kBytes ||
+        (header.type == Type::kInt && header.value_bytes == sizeof(int64_t));
+    const std::size_t bytes =
+        record_bytes(header.key_bytes, header.value_bytes);
+    // Anything else is the tail of a flush cut short: replay stops there
+    // and the next flush compacts instead of appending behind it.
+    if (!valid_type || header.key_bytes == 0 ||
+        header.key_bytes > settings::kMaxKeyBytes ||
+        header.value_bytes > settings::kMaxValueBytes ||
+        bytes > rest.size() ||
+        crc32(rest.subspan(kCrcOffset, sizeof(header) - kCrcOffset +
+                                           header.key_bytes +
+                                           header.value_bytes)) !=
+            header.crc) {
+      return 0;
+    }
+    const std::string_view key(
+        reinterpret_cast<const char*>(rest.data() + sizeof(header)),
+        header.key_bytes);
+    set(key, header.type,
+        rest.subspan(sizeof(header) + header.key_bytes, header.value_bytes),
+        false);
+    at += bytes;
+  }
+  return at;
+}
+
+void SettingsStore::poll(uint64_t now_ns) {
+  if (dirty_count_.load(std::memory_order_relaxed) == 0) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now_ns < first_dirty_ns_ + config_.flush_delay_ns) return;
+  }
+  flush();
+}
+
+bool SettingsStore::flush() {
+  batch_.clear();
+  batch_slots_.clear();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dirty_count_.load(std::memory_order_relaxed) == 0) return true;
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      Slot& slot = slots_[i];
+      if (!slot.dirty) continue;
+      append_record(batch_, slot);
+      batch_slots_.push_back(i);
+      slot.dirty = false;
+    }
+    dirty_count_.store(0, std::memory_order_relaxed);
+  }
+
+  bool ok;
+  const std::size_t sector_size = partition_.sector_size();
+  if (append_ != 0 && append_ + batch_.size() <= sector_size) {
+    ok = write_at(sector_ * sector_size + append_, batch_);
+    if (ok) {
+      append_ += batch_.size();
+      records_written_.fetch_add(batch_slots_.size(),
+                                 std::memory_order_relaxed);
+    } else {
+      // Part of the batch may be on flash; never append behind it.
+      append_ = 0;
+    }
+  } else {
+    ok = compact();
+  }
+  if (ok) {
+    flushes_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Pending again, retried after another flush_delay.
+  flash_errors_.fetch_add(1, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i : batch_slots_) {
+    if (!slots_[i].dirty) mark_dirty(slots_[i]);
+  }
+  return false;
+}
+
+bool SettingsStore::compact() {
+  if (sectors_ < 2) return false;
+  const std::size_t sector_size = partition_.sector_size();
+  const std::size_t next = (sector_ + 1) % sectors_;
+  SectorHeader header;
+  std::memcpy(header.magic, settings::kMagic, sizeof(header.magic));
+  header.sequence = sequence_ + 1;
+  header.committed = 0xffffffff;
+  snapshot_.resize(sizeof(header));
+  std::memcpy(snapshot_.data(), &header, sizeof(header));
+  std::size_t records = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      if (!slots_[i].used.load(std::memory_order_relaxed)) continue;
+      append_record(snapshot_, slots_[i]);
+      ++records;
+    }
+  }
+
+  // Until `committed` is written the sector is ignored at start-up, and
+  // the one in use keeps every value.
+  const std::size_t base = next * sector_size;
+  const uint32_t committed = settings::kCommitted;
+  if (!partition_.erase(base, sector_size) || !write_at(base, snapshot_) ||
+      !write_at(base + offsetof(SectorHeader, committed),
+                {reinterpret_cast<const uint8_t*>(&committed),
+                 sizeof(committed)})) {
+    return false;
+  }
+  sector_ = next;
+  sequence_ = header.sequence;
+  append_ = snapshot_.size();
+  compactions_.fetch_add(1, std::memory_order_relaxed);
+  records_written_.fetch_add(records, std::memory_order_relaxed);
+  reported_sequence_.store(sequence_, std::memory_order_relaxed);
+  return true;
+}
+
+bool SettingsStore::write_at(std::size_t offset,
+                             std::span<const uint8_t> bytes) {
+  if (!partition_.write(offset, bytes)) return false;
+  bytes_written_.fetch_add(bytes.size(), std::memory_order_relaxed);
+  return true;
+}
+
+SettingsStore::Stats SettingsStore::stats() const {
+  return {sets_.load(std::memory_order_relaxed),
+          coalesced_.load(std::memory_order_relaxed),
+          flushes_.load(std::memory_order_relaxed),
+          records_written_.load(std::memory_order_relaxed),
+          bytes_written_.load(std::memory_order_relaxed),
+          compactions_.load(std::memory_order_relaxed),
+          flash_errors_.load(std::memory_order_relaxed),
+          reported_sequence_.load(std::memory_order_relaxed)};
+}
+
+}  // namespace xiaozi
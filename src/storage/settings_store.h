@@ -0,0 +1,199 @@
+#ifndef XIAOZI_STORAGE_SETTINGS_STORE_H_
+#define XIAOZI_STORAGE_SETTINGS_STORE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "ota/flash_partition.h"
+
+namespace xiaozi {
+
+// Layout of the settings log. Each sector of the partition, in turn, holds
+// the whole store:
+//
+//   SectorHeader | record | record | ... | erased
+//
+// A sector is started by a compaction: its header's magic and sequence
+// are written first, then one record per key, then `committed`. Later
+// flushes append records behind those until the sector is full, and the
+// next compaction moves on to the following sector, so erases spread over
+// the partition. At start-up the committed sector with the highest
+// sequence is replayed; a record whose CRC fails ends it (a flush cut off
+// by power loss).
+namespace settings {
+
+inline constexpr char kMagic[4] = {'X', 'Z', 'S', 'T'};
+inline constexpr uint32_t kCommitted = 0x00000000;  // erased is 0xffffffff
+
+struct SectorHeader {
+  char magic[4];
+  uint32_t sequence;
+  uint32_t committed;
+};
+static_assert(sizeof(SectorHeader) == 12);
+
+enum class Type : uint8_t { kInt = 1, kBytes = 2 };
+
+// Followed by key_bytes of key and value_bytes of value, padded to 4.
+struct RecordHeader {
+  uint32_t crc;  // CRC-32 of everything after this field
+  uint8_t key_bytes;
+  Type type;
+  uint16_t value_bytes;
+};
+static_assert(sizeof(RecordHeader) == 8);
+
+inline constexpr std::size_t kMaxKeyBytes = 15;
+inline constexpr std::size_t kMaxValueBytes = 64;
+
+}  // namespace settings
+
+// Device settings (volume, brightness, Wi-Fi credentials...) kept in RAM
+// and written to flash in batches.
+//
+// set() only updates the in-RAM copy; poll() writes the changes out once
+// the oldest has waited flush_delay, so dragging a volume slider costs one
+// flash record instead of one per step, and flush() writes them at once
+// (before a reboot or power-off). The flash side is an append-only log
+// compacted a sector at a time (see settings::SectorHeader).
+//
+// Reads are lock-free from any thread: every key keeps its slot for the
+// store's lifetime and each value sits behind a seqlock. Writers from any
+// thread serialize on a mutex held only for the in-RAM update; poll() and
+// flush() must come from one thread, which does the flash I/O.
+class SettingsStore {
+ public:
+  struct Config {
+    // Distinct keys the store can hold.
+    std::size_t capacity = 64;
+    uint64_t flush_delay_ns = 2000000000;
+  };
+
+  struct Stats {
+    uint64_t sets;
+    uint64_t coalesced;  // sets that replaced a change not yet on flash
+    uint64_t flushes;
+    uint64_t records_written;
+    uint64_t bytes_written;
+    uint64_t compactions;
+    uint64_t flash_errors;
+    uint32_t sequence;  // of the sector in use
+  };
+
+  // Loads the newest committed sector of `partition`, which needs at
+  // least two sectors. A blank or unreadable partition starts empty.
+  SettingsStore(FlashPartition& partition, Config config);
+  explicit SettingsStore(FlashPartition& partition)
+      : SettingsStore(partition, Config{}) {}
+
+  // Any thread. False if the key or value is too long, the store is at
+  // capacity, or the whole store would no longer fit half a sector.
+  bool set_int(std::string_view key, int64_t value);
+  bool set_bytes(std::string_view key, std::span<const uint8_t> value);
+  bool set_string(std::string_view key, std::string_view value) {
+    return set_bytes(key, {reinterpret_cast<const uint8_t*>(value.data()),
+                           value.size()});
+  }
+
+  // Any thread, lock-free.
+  std::optional<int64_t> get_int(std::string_view key) const;
+  int64_t get_int(std::string_view key, int64_t fallback) const {
+    return get_int(key).value_or(fallback);
+  }
+  // Copies the value into `out` (truncated to fit) and returns its full
+  // length; nullopt if unset or not bytes.
+  std::optional<std::size_t> get_bytes(std::string_view key,
+                                       std::span<uint8_t> out) const;
+
+  // Flash thread. poll() flushes once changes have waited flush_delay
+  // (`now_ns` in the monotonic_ns() time base).
+  void poll(uint64_t now_ns);
+  // False if the flash write failed; the changes stay pending.
+  bool flush();
+  bool dirty() const { return dirty_count_.load() != 0; }
+
+  // Any thread.
+  Stats stats() const;
+
+ private:
+  static constexpr std::size_t kValueWords = settings::kMaxValueBytes / 8;
+
+  // Claimed once (key written, then `used` released) and never moved.
+  struct Slot {
+    std::atomic<bool> used{false};
+    uint8_t key_bytes = 0;
+    char key[settings::kMaxKeyBytes] = {};
+    std::atomic<uint64_t> seq{0};  // odd while the value is being written
+    std::atomic<uint8_t> type{0};
+    std::atomic<uint8_t> value_bytes{0};
+    std::array<std::atomic<uint64_t>, kValueWords> value{};
+    bool dirty = false;  // under mutex_
+
+    std::string_view name() const { return {key, key_bytes}; }
+  };
+
+  struct Value {
+    settings::Type type;
+    uint8_t bytes;
+    std::array<uint64_t, kValueWords> words;
+  };
+
+  static std::size_t record_bytes(std::size_t key_bytes,
+                                  std::size_t value_bytes);
+
+  const Slot* find(std::string_view key) const;
+  void read(const Slot& slot, Value& out) const;
+  void store(Slot& slot, settings::Type type, std::span<const uint8_t> value);
+  // `pending` is false when replaying flash: no flush, no stats.
+  bool set(std::string_view key, settings::Type type,
+           std::span<const uint8_t> value, bool pending);
+  void mark_dirty(Slot& slot);
+  void append_record(std::vector<uint8_t>& out, const Slot& slot) const;
+
+  void load();
+  // Returns where the next record goes, or 0 if the log must be compacted.
+  std::size_t replay(std::size_t sector);
+  bool compact();
+  bool write_at(std::size_t offset, std::span<const uint8_t> bytes);
+
+  FlashPartition& partition_;
+  Config config_;
+  std::size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  std::size_t sectors_;
+
+  mutable std::mutex mutex_;
+  std::size_t keys_ = 0;
+  std::size_t snapshot_bytes_ = 0;  // every key's record, as compacted
+  std::atomic<std::size_t> dirty_count_{0};
+  uint64_t first_dirty_ns_ = 0;
+
+  // Flash thread.
+  std::size_t sector_ = 0;
+  std::size_t append_ = 0;  // next record's offset in the sector, or 0
+  uint32_t sequence_ = 0;
+  std::vector<uint8_t> batch_;
+  std::vector<std::size_t> batch_slots_;
+  std::vector<uint8_t> snapshot_;
+
+  std::atomic<uint64_t> sets_{0};
+  std::atomic<uint64_t> coalesced_{0};
+  std::atomic<uint64_t> flushes_{0};
+  std::atomic<uint64_t> records_written_{0};
+  std::atomic<uint64_t> bytes_written_{0};
+  std::atomic<uint64_t> compactions_{0};
+  std::atomic<uint64_t> flash_errors_{0};
+  std::atomic<uint32_t> reported_sequence_{0};
+};
+
+}  // namespace xiaozi
+
+#endif  // XIAOZI_STORAGE_SETTINGS_STORE_H_
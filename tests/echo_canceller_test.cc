@@ -0,0 +1,110 @@
+// EchoCanceller on a committed recording, data/echo_double_talk.xzrc: a
+// capture with the speaker reference (CaptureFormat::reference), 16 kHz,
+// 5.5 s. The far end talks throughout; its echo reaches the mic through a
+// 75 ms room response with 10 dB of echo return loss, over a noise floor.
+// From 3 s to 4.5 s a near-end talker, 4 dB above the echo, joins in.
+//
+// Thresholds: 20 dB ERLE over the last second before the near end starts;
+// during double talk the output keeps the talker (within 3 dB of the mic,
+// which is mostly them); and 20 dB ERLE again over the last second, so
+// the double talk did not pull the filter off the echo path. RealFft's
+// round trip and EchoReference's slip repair, which the canceller relies
+// on, are checked here too.
+
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "audio/echo_canceller.h"
+#include "audio/echo_reference.h"
+#include "audio/fft.h"
+#include "replay/capture_file.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr std::size_t kRate = 16000;
+constexpr std::size_t kNearStart = 3 * kRate;
+constexpr std::size_t kNearEnd = 9 * kRate / 2;
+
+double energy(std::span<const int16_t> x) {
+  double e = 0;
+  for (int16_t v : x) e += double(v) * v;
+  return e;
+}
+
+double db(double ratio) { return 10 * std::log10(ratio); }
+
+XIAOZI_TEST(aec, cancels_recorded_echo_through_double_talk) {
+  CaptureReader capture;
+  REQUIRE(capture.load(XIAOZI_TEST_DATA_DIR "/echo_double_talk.xzrc"));
+  REQUIRE(capture.format().reference);
+  const std::size_t frame = capture.format().frame_samples;
+  std::vector<int16_t> mic, ref;
+  CaptureReader::Record record;
+  while (capture.next(record)) {
+    if (record.kind != replay::Kind::kMic) continue;
+    const std::size_t at = mic.size();
+    mic.resize(at + frame);
+    ref.resize(at + frame);
+    std::memcpy(&mic[at], record.payload.data(), frame * sizeof(int16_t));
+    std::memcpy(&ref[at], record.payload.data() + frame * sizeof(int16_t),
+                frame * sizeof(int16_t));
+  }
+  REQUIRE(mic.size() == 11 * kRate / 2);
+
+  // No CPU governor: every block adapts, on any machine.
+  EchoCanceller::Config config;
+  config.cpu_budget = 100.0f;
+  EchoCanceller aec(config);
+  std::vector<int16_t> out(mic.size());
+  for (std::size_t i = 0; i < mic.size(); i += frame) {
+    REQUIRE(aec.process(std::span(mic).subspan(i, frame),
+                        std::span(ref).subspan(i, frame),
+                        std::span(out).subspan(i, frame)));
+  }
+
+  auto erle_db = [&](std::size_t from, std::size_t n) {
+    return db(energy(std::span(mic).subspan(from, n)) /
+              energy(std::span(out).subspan(from, n)));
+  };
+  CHECK(erle_db(kNearStart - kRate, kRate) >= 20.0);
+  const std::size_t talk = kNearEnd - kNearStart;
+  CHECK(db(energy(std::span(out).subspan(kNearStart, talk)) /
+           energy(std::span(mic).subspan(kNearStart, talk))) >= -3.0);
+  CHECK(erle_db(mic.size() - kRate, kRate) >= 20.0);
+  CHECK(aec.stats().double_talk_blocks > 0);
+}
+
+XIAOZI_TEST(aec, fft_round_trip) {
+  RealFft fft(128);
+  std::vector<float> x(128), y(128);
+  std::vector<std::complex<float>> spectrum(fft.bins());
+  for (std::size_t i = 0; i < x.size(); ++i) x[i] = std::sin(0.3f * i) * i;
+  fft.forward(x, spectrum);
+  fft.inverse(spectrum, y);
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    CHECK(std::fabs(x[i] - y[i]) <= 1e-3f * 128);
+  }
+}
+
+XIAOZI_TEST(aec, reference_keeps_alignment_across_slips) {
+  EchoReference reference(100);
+  std::vector<int16_t> played(300), got(300);
+  for (std::size_t i = 0; i < played.size(); ++i) played[i] = int16_t(i + 1);
+  // Playback is late: the first read comes from the pre-roll only.
+  reference.read(std::span(got).first(150));
+  reference.write(played);
+  reference.read(std::span(got).subspan(150));
+  // Sample n captured is sample n - 100 played, zero-fill or not.
+  for (std::size_t n = 150; n < got.size(); ++n) {
+    CHECK(got[n] == int16_t(n - 100 + 1));
+  }
+}
+
+}  // namespace
+}  // namespace xiaozi
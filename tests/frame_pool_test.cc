@@ -0,0 +1,42 @@
+// FramePool's owned storage: aligned blocks, exhaustion and reuse. Under
+// ASan, destroying a pool also checks that its storage goes back through
+// the aligned operator delete[] it came from.
+
+#include <cstdint>
+#include <vector>
+
+#include "base/cache.h"
+#include "memory/frame_pool.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+XIAOZI_TEST(frame_pool, blocks_are_aligned_and_reused) {
+  FramePool pool(320, 4);
+  std::vector<FrameRef> held;
+  for (int i = 0; i < 4; ++i) {
+    FrameRef frame = pool.acquire();
+    REQUIRE(frame);
+    CHECK(frame.capacity() >= 320);
+    CHECK(reinterpret_cast<uintptr_t>(frame.data()) % 32 == 0);
+    held.push_back(std::move(frame));
+  }
+  CHECK(!pool.acquire());
+  CHECK(pool.stats().exhaustions == 1);
+  held.pop_back();
+  CHECK(static_cast<bool>(pool.acquire()));
+}
+
+XIAOZI_TEST(frame_pool, many_pools_come_and_go) {
+  for (std::size_t blocks = 1; blocks <= 64; blocks *= 2) {
+    FramePool pool(1276, blocks);
+    FrameRef frame = pool.acquire();
+    REQUIRE(frame);
+    CHECK(reinterpret_cast<uintptr_t>(frame.data()) % kCacheLineSize ==
+          FramePool::kPayloadOffset);
+  }
+}
+
+}  // namespace
+}  // namespace xiaozi
@@ -0,0 +1,402 @@
+// Gateway over loopback with a stand-in backend and one shard: which of a
+// UDP device's sockets the gateway answers, how its audio is paced, and
+// connections that stall before or after the upgrade.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base/clock.h"
+#include "gateway/gateway.h"
+#include "net/aes_ctr.h"
+#include "net/websocket_frame.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr std::size_t kUdpHeaderBytes = 16;
+
+uint32_t get_be32(const uint8_t* p) {
+  return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 |
+         p[3];
+}
+
+void put_be32(uint8_t* p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+sockaddr_in loopback(const char* ip, int port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  inet_pton(AF_INET, ip, &addr.sin_addr);
+  return addr;
+}
+
+// Blocks up to a second for `n` bytes.
+bool read_exact(int fd, uint8_t* out, std::size_t n) {
+  while (n > 0) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (poll(&pfd, 1, 1000) != 1) return false;
+    const ssize_t r = recv(fd, out, n, 0);
+    if (r <= 0) return false;
+    out += r;
+    n -= static_cast<std::size_t>(r);
+  }
+  return true;
+}
+
+std::array<uint8_t, 16> from_hex(std::string_view hex) {
+  std::array<uint8_t, 16> out{};
+  for (std::size_t i = 0; i < out.size() && 2 * i + 1 < hex.size(); ++i) {
+    out[i] = static_cast<uint8_t>(
+        std::stoi(std::string(hex.substr(2 * i, 2)), nullptr, 16));
+  }
+  return out;
+}
+
+std::string_view json_string(std::string_view json, std::string_view key) {
+  const std::string quoted = "\"" + std::string(key) + "\":\"";
+  const auto at = json.find(quoted);
+  if (at == std::string_view::npos) return {};
+  json.remove_prefix(at + quoted.size());
+  return json.substr(0, json.find('"'));
+}
+
+// Accepts the one shard's link and reads its records.
+class Backend {
+ public:
+  Backend() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr = loopback("127.0.0.1", 0);
+    socklen_t len = sizeof(addr);
+    ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len);
+    listen(listen_fd_, 4);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+  }
+  ~Backend() {
+    if (fd_ >= 0) ::close(fd_);
+    ::close(listen_fd_);
+  }
+
+  int port() const { return port_; }
+  bool accept_link() {
+    fd_ = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    return fd_ >= 0;
+  }
+
+  // Next record of `type`, skipping others.
+  std::optional<std::vector<uint8_t>> next(BackendLink::RecordType type,
+                                           uint32_t* session = nullptr) {
+    for (;;) {
+      uint8_t header[BackendLink::kHeaderBytes];
+      if (!read_exact(fd_, header, sizeof(header))) return std::nullopt;
+      std::vector<uint8_t> payload(get_be32(header + 8));
+      if (!read_exact(fd_, payload.data(), payload.size())) {
+        return std::nullopt;
+      }
+      if (header[0] != type) continue;
+      if (session != nullptr) *session = get_be32(header + 4);
+      return payload;
+    }
+  }
+
+  void send_audio(uint32_t session, std::string_view payload) {
+    std::vector<uint8_t> record(BackendLink::kHeaderBytes + payload.size());
+    record[0] = BackendLink::kAudio;
+    put_be32(&record[4], session);
+    put_be32(&record[8], static_cast<uint32_t>(payload.size()));
+    std::memcpy(&record[BackendLink::kHeaderBytes], payload.data(),
+                payload.size());
+    (void)send(fd_, record.data(), record.size(), MSG_NOSIGNAL);
+  }
+
+ private:
+  int listen_fd_ = -1;
+  int fd_ = -1;
+  int port_ = 0;
+};
+
+// A device that asked for UDP audio: the WebSocket connection plus what
+// the hello reply handed out.
+struct UdpDevice {
+  int fd = -1;
+  std::array<uint8_t, 16> key{};
+  std::array<uint8_t, 16> nonce{};
+
+  ~UdpDevice() {
+    if (fd >= 0) ::close(fd);
+  }
+
+  bool connect(int port) {
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const sockaddr_in addr = loopback("127.0.0.1", port);
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                  sizeof(addr)) != 0) {
+      return false;
+    }
+    std::string out =
+        "GET /xiaozhi/v1/ HTTP/1.1\r\nHost: gateway\r\n"
+        "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Device-Id: dev-udp\r\n\r\n";
+    const std::string_view hello =
+        R"({"type":"hello","version":1,"transport":"udp"})";
+    uint8_t frame[ws::kMaxHeaderBytes + 64];
+    const uint32_t mask = 0x11223344;
+    const std::size_t n =
+        ws::encode_header(frame, ws::kText, hello.size(), true, mask);
+    std::memcpy(frame + n, hello.data(), hello.size());
+    ws::apply_mask({frame + n, hello.size()}, mask);
+    out.append(reinterpret_cast<const char*>(frame), n + hello.size());
+    if (send(fd, out.data(), out.size(), MSG_NOSIGNAL) !=
+        static_cast<ssize_t>(out.size())) {
+      return false;
+    }
+    std::string response;
+    uint8_t c;
+    while (!response.ends_with("\r\n\r\n")) {
+      if (!read_exact(fd, &c, 1)) return false;
+      response += static_cast<char>(c);
+    }
+    // The reply with the UDP parameters takes a 16-bit length.
+    uint8_t head[4];
+    if (!read_exact(fd, head, 4) || (head[1] & 0x7f) != 126) return false;
+    std::string reply(std::size_t{head[2]} << 8 | head[3], '\0');
+    if (!read_exact(fd, reinterpret_cast<uint8_t*>(reply.data()),
+                    reply.size())) {
+      return false;
+    }
+    key = from_hex(json_string(reply, "key"));
+    nonce = from_hex(json_string(reply, "nonce"));
+    return json_string(reply, "transport") == "udp";
+  }
+
+  // The datagram MqttUdpTransport would send for `payload`.
+  std::vector<uint8_t> packet(uint32_t sequence, std::string_view payload) {
+    std::vector<uint8_t> out(kUdpHeaderBytes + payload.size());
+    std::memcpy(out.data(), nonce.data(), kUdpHeaderBytes);
+    out[2] = static_cast<uint8_t>(payload.size() >> 8);
+    out[3] = static_cast<uint8_t>(payload.size());
+    put_be32(&out[12], sequence);
+    std::memcpy(&out[kUdpHeaderBytes], payload.data(), payload.size());
+    AesCtr cipher(key);
+    cipher.apply(std::span<const uint8_t, 16>(out.data(), kUdpHeaderBytes),
+                 {out.data() + kUdpHeaderBytes, payload.size()});
+    return out;
+  }
+};
+
+int udp_socket(const char* ip) {
+  const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  const sockaddr_in addr = loopback(ip, 0);
+  ::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+  return fd;
+}
+
+// Polls `done` for up to three seconds.
+template <typename Done>
+bool eventually(Done done) {
+  const uint64_t deadline = monotonic_ns() + 3000000000;
+  while (monotonic_ns() < deadline) {
+    if (done()) return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+// Waits for the gateway to have taken or refused `n` datagrams in all.
+bool settled(const Gateway& gateway, uint64_t n) {
+  return eventually([&] {
+    const Gateway::Stats stats = gateway.stats();
+    return stats.udp_packets + stats.udp_rejected >= n;
+  });
+}
+
+Gateway::Config one_shard(const Backend& backend) {
+  Gateway::Config config;
+  config.bind_address = "127.0.0.1";
+  config.port = 0;
+  config.shards = 1;
+  config.pin_threads = false;
+  config.backend_port = backend.port();
+  config.public_host = "127.0.0.1";
+  config.frame_ms = 10;
+  return config;
+}
+
+// Decrypted payload of the next datagram on `fd`, or empty after 200 ms.
+std::string receive(int fd, const UdpDevice& device) {
+  pollfd pfd{fd, POLLIN, 0};
+  if (poll(&pfd, 1, 200) != 1) return {};
+  uint8_t buf[1536];
+  const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+  if (n < static_cast<ssize_t>(kUdpHeaderBytes)) return {};
+  AesCtr cipher(device.key);
+  cipher.apply(std::span<const uint8_t, 16>(buf, kUdpHeaderBytes),
+               {buf + kUdpHeaderBytes, n - kUdpHeaderBytes});
+  return std::string(reinterpret_cast<char*>(buf + kUdpHeaderBytes),
+                     n - kUdpHeaderBytes);
+}
+
+XIAOZI_TEST(gateway, udp_peer_moves_only_forward_from_the_device_host) {
+  Backend backend;
+  Gateway gateway(one_shard(backend));
+  REQUIRE(gateway.start());
+  REQUIRE(backend.accept_link());
+  UdpDevice device;
+  REQUIRE(device.connect(gateway.port()));
+  uint32_t session = 0;
+  REQUIRE(backend.next(BackendLink::kOpen, &session).has_value());
+
+  const sockaddr_in to = loopback("127.0.0.1", gateway.port());
+  auto send_from = [&](int fd, uint32_t sequence, std::string_view text) {
+    const std::vector<uint8_t> p = device.packet(sequence, text);
+    sendto(fd, p.data(), p.size(), 0, reinterpret_cast<const sockaddr*>(&to),
+           sizeof(to));
+  };
+  const int first = udp_socket("127.0.0.1");
+  const int rebound = udp_socket("127.0.0.1");
+  const int stranger = udp_socket("127.0.0.2");
+  uint64_t sent = 0;
+
+  for (uint32_t seq = 0; seq < 4; ++seq) send_from(first, seq, "audio");
+  REQUIRE(settled(gateway, sent += 4));
+  // Skips the losses played out before the jitter buffer filled.
+  auto audio = backend.next(BackendLink::kAudio);
+  while (audio.has_value() && audio->empty()) {
+    audio = backend.next(BackendLink::kAudio);
+  }
+  REQUIRE(audio.has_value());
+  CHECK(std::string(audio->begin(), audio->end()) == "audio");
+  backend.send_audio(session, "tts-1");
+  CHECK(receive(first, device) == "tts-1");
+
+  // Another host, even with the next sequence, and the device's own host
+  // replaying an old packet from a new port, leave replies where they go.
+  send_from(stranger, 4, "audio");
+  send_from(rebound, 2, "audio");
+  REQUIRE(settled(gateway, sent += 2));
+  CHECK(gateway.stats().udp_rejected == 2);
+  backend.send_audio(session, "tts-2");
+  CHECK(receive(first, device) == "tts-2");
+  CHECK(receive(rebound, device).empty());
+  CHECK(receive(stranger, device).empty());
+
+  // A NAT rebinding: the device's host, a new port, the next sequence.
+  send_from(rebound, 4, "audio");
+  REQUIRE(settled(gateway, sent += 1));
+  backend.send_audio(session, "tts-3");
+  CHECK(receive(rebound, device) == "tts-3");
+  CHECK(receive(first, device).empty());
+  CHECK(gateway.stats().udp_rejected == 2);
+
+  for (int fd : {first, rebound, stranger}) ::close(fd);
+  gateway.stop();
+}
+
+// A connection that never finishes its request gives its slot back.
+XIAOZI_TEST(gateway, unfinished_upgrade_times_out) {
+  Backend backend;
+  Gateway::Config config = one_shard(backend);
+  config.upgrade_timeout_ms = 50;
+  Gateway gateway(config);
+  REQUIRE(gateway.start());
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  const sockaddr_in addr = loopback("127.0.0.1", gateway.port());
+  REQUIRE(connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                  sizeof(addr)) == 0);
+  const std::string_view partial = "GET /xiaozhi/v1/ HTTP/1.1\r\n";
+  REQUIRE(send(fd, partial.data(), partial.size(), MSG_NOSIGNAL) > 0);
+  REQUIRE(eventually([&] { return gateway.stats().sessions == 1; }));
+
+  CHECK(eventually([&] { return gateway.stats().sessions == 0; }));
+  const Gateway::Stats stats = gateway.stats();
+  CHECK(stats.timed_out == 1);
+  CHECK(stats.rejected == 1);
+  uint8_t byte;
+  CHECK(!read_exact(fd, &byte, 1));  // EOF
+  ::close(fd);
+  gateway.stop();
+}
+
+// An upgraded session that goes quiet is closed with 1001 Going Away, and
+// the backend is told.
+XIAOZI_TEST(gateway, idle_session_times_out) {
+  Backend backend;
+  Gateway::Config config = one_shard(backend);
+  config.idle_timeout_ms = 50;
+  Gateway gateway(config);
+  REQUIRE(gateway.start());
+  REQUIRE(backend.accept_link());
+  UdpDevice device;
+  REQUIRE(device.connect(gateway.port()));
+
+  CHECK(eventually([&] { return gateway.stats().sessions == 0; }));
+  CHECK(gateway.stats().timed_out == 1);
+  CHECK(gateway.stats().rejected == 0);
+  uint8_t close[4];
+  REQUIRE(read_exact(device.fd, close, sizeof(close)));
+  CHECK(close[0] == (0x80 | ws::kClose));
+  CHECK(close[2] == 0x03);
+  CHECK(close[3] == 0xe9);
+  CHECK(backend.next(BackendLink::kClose).has_value());
+  gateway.stop();
+}
+
+// A device on 20 ms packets and a gateway ticking every 60 ms: the packets
+// are paced by their own duration, three pops a tick, not one.
+XIAOZI_TEST(gateway, udp_pops_follow_packet_duration) {
+  Backend backend;
+  Gateway::Config config = one_shard(backend);
+  config.frame_ms = 60;
+  Gateway gateway(config);
+  REQUIRE(gateway.start());
+  REQUIRE(backend.accept_link());
+  UdpDevice device;
+  REQUIRE(device.connect(gateway.port()));
+  REQUIRE(backend.next(BackendLink::kOpen).has_value());
+
+  // TOC byte 0x48: SILK wideband, one 20 ms frame.
+  const std::string_view opus_20ms = "\x48opus";
+  const sockaddr_in to = loopback("127.0.0.1", gateway.port());
+  const int fd = udp_socket("127.0.0.1");
+  constexpr uint32_t kPackets = 50;
+  for (uint32_t seq = 0; seq < kPackets; ++seq) {
+    const std::vector<uint8_t> p = device.packet(seq, opus_20ms);
+    sendto(fd, p.data(), p.size(), 0, reinterpret_cast<const sockaddr*>(&to),
+           sizeof(to));
+    usleep(20000);
+  }
+  REQUIRE(settled(gateway, kPackets));
+
+  uint32_t forwarded = 0;
+  while (forwarded < kPackets) {
+    const auto audio = backend.next(BackendLink::kAudio);
+    if (!audio.has_value()) break;
+    if (!audio->empty()) ++forwarded;
+  }
+  // Only packets that came in while the buffer was still filling may go.
+  CHECK(forwarded >= kPackets - 3);
+  ::close(fd);
+  gateway.stop();
+}
+
+}  // namespace
+}  // namespace xiaozi
@@ -0,0 +1,95 @@
+// MqttClient over a socketpair standing in for the broker: publish() from
+// another thread while the transport thread reads and tears down, and the
+// PUBACK for a message delivered at QoS 1.
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "net/mqtt_client.h"
+#include "net/tcp_stream.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+XIAOZI_TEST(mqtt_client, publish_races_reads_and_teardown) {
+  for (int round = 0; round < 20; ++round) {
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+    const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+    REQUIRE(::write(fds[1], connack, sizeof(connack)) == 4);
+
+    MqttClient client;
+    REQUIRE(client.connect(std::make_unique<TcpStream>(fds[0]), {}));
+    std::atomic<bool> stop{false};
+    std::thread publisher([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        client.publish("t", "{\"type\":\"listen\"}");
+      }
+    });
+    // PINGRESPs keep the transport thread reading while the publisher
+    // writes; the broker drains what it was sent.
+    uint8_t sink[4096];
+    for (int i = 0; i < 200; ++i) {
+      const uint8_t pingresp[] = {0xd0, 0x00};
+      (void)::write(fds[1], pingresp, sizeof(pingresp));
+      while (::read(fds[1], sink, sizeof(sink)) > 0) {
+      }
+      client.on_readable();
+      client.on_writable();
+    }
+    client.disconnect();
+    CHECK(!client.connected());
+    CHECK(!client.publish("t", "late"));
+    stop.store(true);
+    publisher.join();
+    ::close(fds[1]);
+  }
+}
+
+// A broker may deliver at QoS 1 despite the QoS 0 subscription; the
+// message still reaches the handler and is acknowledged with its id.
+XIAOZI_TEST(mqtt_client, acknowledges_qos1_publish) {
+  int fds[2];
+  REQUIRE(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == 0);
+  const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+  REQUIRE(::write(fds[1], connack, sizeof(connack)) == 4);
+  MqttClient client;
+  REQUIRE(client.connect(std::make_unique<TcpStream>(fds[0]), {}));
+  uint8_t sink[4096];
+  while (::read(fds[1], sink, sizeof(sink)) > 0) {
+  }
+
+  std::string received;
+  client.set_message_handler(
+      [&](std::string_view topic, std::span<const uint8_t> payload) {
+        received.assign(topic);
+        received.append(payload.begin(), payload.end());
+      });
+  // QoS 0 then QoS 1 (packet id 0x1234), topic "t", payload "hi".
+  const uint8_t publish[] = {0x30, 0x05, 0x00, 0x01, 't',  'h',  'i',
+                             0x32, 0x07, 0x00, 0x01, 't',  0x12, 0x34,
+                             'h',  'i'};
+  REQUIRE(::write(fds[1], publish, sizeof(publish)) ==
+          static_cast<ssize_t>(sizeof(publish)));
+  CHECK(client.on_readable());
+  CHECK(received == "thi");
+
+  uint8_t reply[8];
+  CHECK(::read(fds[1], reply, sizeof(reply)) == 4);
+  CHECK(reply[0] == 0x40 && reply[1] == 0x02);
+  CHECK(reply[2] == 0x12 && reply[3] == 0x34);
+  client.disconnect();
+  ::close(fds[1]);
+}
+
+}  // namespace
+}  // namespace xiaozi
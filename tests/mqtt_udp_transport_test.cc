@@ -0,0 +1,52 @@
+// MqttUdpTransport's audio channel closing and reopening on the transport
+// thread while the producer thread keeps committing packets.
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "base/clock.h"
+#include "net/mqtt_udp_transport.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+XIAOZI_TEST(mqtt_udp, commit_races_channel_close) {
+  MqttUdpTransport::Config config;
+  config.max_packet_bytes = 120;
+  MqttUdpTransport transport(config);
+  const auto params = UdpAudioParams::from_hex(
+      "", 0, "000102030405060708090a0b0c0d0e0f",
+      "01000000a5a5a5a50000000000000000");
+  REQUIRE(params.has_value());
+
+  std::atomic<bool> stop{false};
+  std::thread producer([&] {
+    while (!stop.load(std::memory_order_relaxed)) {
+      const auto out = transport.reserve(120);
+      if (out.empty()) continue;
+      std::memset(out.data(), 0x5a, out.size());
+      transport.commit(out.size(), monotonic_ns());
+    }
+  });
+  for (int i = 0; i < 200; ++i) {
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, fds) == 0);
+    CHECK(transport.attach_audio_socket(fds[0], *params));
+    std::this_thread::yield();
+    transport.close_audio_channel();
+    ::close(fds[1]);
+  }
+  stop.store(true);
+  producer.join();
+  const TransportStats s = transport.stats();
+  CHECK(s.packets_sent + s.packets_dropped > 0);
+  CHECK(!transport.audio_open());
+}
+
+}  // namespace
+}  // namespace xiaozi
@@ -0,0 +1,85 @@
+// Update files against the image the update check announced: a file for
+// another image is refused before flash is touched, a file that does not
+// hash to its header keeps its last bytes off flash, and OtaUpdater will
+// not fetch over plain http:// unless told to.
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "base/sha256.h"
+#include "net/url.h"
+#include "ota/flash_partition.h"
+#include "ota/ota_updater.h"
+#include "ota/update_stream.h"
+#include "ota/update_writer.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr std::size_t kPartitionBytes = 64 * 1024;
+constexpr std::size_t kSectorBytes = 4096;
+
+std::vector<uint8_t> image(uint32_t seed) {
+  std::vector<uint8_t> out(20000);
+  for (uint8_t& b : out) {
+    seed = seed * 1664525u + 1013904223u;
+    b = static_cast<uint8_t>(seed >> 24);
+  }
+  return out;
+}
+
+UpdateStream::Config expecting(const std::vector<uint8_t>& target) {
+  UpdateStream::Config config;
+  config.expected_sha256 = Sha256::of(target);
+  return config;
+}
+
+XIAOZI_TEST(ota, applies_expected_image) {
+  const std::vector<uint8_t> v2 = image(2);
+  MemoryPartition base(kPartitionBytes, kSectorBytes);
+  MemoryPartition target(kPartitionBytes, kSectorBytes);
+  UpdateStream stream(base, target, expecting(v2));
+  CHECK(stream.feed(UpdateWriter().full(v2)) == UpdateStream::Status::kDone);
+  CHECK(std::equal(v2.begin(), v2.end(), target.bytes().begin()));
+}
+
+// A well-formed file whose header names a different image than the one
+// announced: whoever served it could have written any header.
+XIAOZI_TEST(ota, refuses_unexpected_image_before_writing) {
+  MemoryPartition base(kPartitionBytes, kSectorBytes);
+  MemoryPartition target(kPartitionBytes, kSectorBytes);
+  UpdateStream stream(base, target, expecting(image(2)));
+  CHECK(stream.feed(UpdateWriter().full(image(3))) ==
+        UpdateStream::Status::kUntrusted);
+  CHECK(target.stats().sectors_erased == 0);
+  CHECK(target.stats().bytes_written == 0);
+}
+
+XIAOZI_TEST(ota, holds_back_image_failing_its_hash) {
+  const std::vector<uint8_t> v2 = image(2);
+  UpdateWriter::Config raw;
+  raw.compress = false;
+  std::vector<uint8_t> file = UpdateWriter(raw).full(v2);
+  file.back() ^= 0x01;
+  MemoryPartition base(kPartitionBytes, kSectorBytes);
+  MemoryPartition target(kPartitionBytes, kSectorBytes);
+  UpdateStream stream(base, target, expecting(v2));
+  CHECK(stream.feed(file) == UpdateStream::Status::kHashMismatch);
+  CHECK(target.stats().bytes_written == 0);
+}
+
+XIAOZI_TEST(ota, updater_refuses_plain_http) {
+  MemoryPartition base(kPartitionBytes, kSectorBytes);
+  MemoryPartition target(kPartitionBytes, kSectorBytes);
+  OtaUpdater updater(base, target);
+  const auto url = parse_url("http://127.0.0.1:9/fw.xzup");
+  REQUIRE(url.has_value());
+  CHECK(updater.run(*url, Sha256::of(image(2)), nullptr) ==
+        OtaUpdater::Status::kInsecure);
+  CHECK(updater.stats().requests == 0);
+}
+
+}  // namespace
+}  // namespace xiaozi
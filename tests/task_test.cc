@@ -0,0 +1,75 @@
+// Coroutine tasks resumed through AsyncEvent: on the executor while it
+// runs, and after stop(), when the resume can no longer be posted and used
+// to spin forever. Frames left suspended would also trip the frame pool's
+// leak assertion at exit.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "runtime/async_event.h"
+#include "runtime/executor.h"
+#include "runtime/task.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+Executor::Config one_worker() {
+  Executor::Config config;
+  config.workers = 1;
+  config.realtime_lane = false;
+  return config;
+}
+
+// Counts its destruction, to see a coroutine frame go.
+struct Local {
+  explicit Local(std::atomic<int>& destroyed) : destroyed(destroyed) {}
+  ~Local() { destroyed.fetch_add(1); }
+  std::atomic<int>& destroyed;
+};
+
+Task<int> wait_for(AsyncEvent& event, std::atomic<int>& destroyed) {
+  Local local(destroyed);
+  co_await event;
+  co_return 7;
+}
+
+Task<void> waiter(AsyncEvent& event, std::atomic<int>& destroyed,
+                  std::atomic<int>& result) {
+  result.store(co_await wait_for(event, destroyed));
+}
+
+XIAOZI_TEST(task, resumes_on_executor) {
+  Executor executor(one_worker());
+  AsyncEvent event(executor);
+  std::atomic<int> destroyed{0}, result{0};
+  REQUIRE(spawn(executor, Priority::kInteractive,
+                waiter(event, destroyed, result)));
+  event.set();
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (result.load() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  CHECK(result.load() == 7);
+  CHECK(destroyed.load() == 1);
+  executor.stop();
+}
+
+XIAOZI_TEST(task, resume_after_stop_runs_inline) {
+  Executor executor(one_worker());
+  AsyncEvent event(executor);
+  std::atomic<int> destroyed{0}, result{0};
+  REQUIRE(spawn(executor, Priority::kInteractive,
+                waiter(event, destroyed, result)));
+  // stop() runs the task up to its co_await before returning.
+  executor.stop();
+  CHECK(result.load() == 0);
+  event.set();
+  CHECK(result.load() == 7);
+  CHECK(destroyed.load() == 1);
+}
+
+}  // namespace
+}  // namespace xiaozi
@@ -0,0 +1,56 @@
+#ifndef XIAOZI_TESTS_TEST_H_
+#define XIAOZI_TESTS_TEST_H_
+
+#include <string>
+#include <vector>
+
+namespace xiaozi::test {
+
+// Unit tests, run by xiaozi_tests and registered with ctest one suite at a
+// time (tests/CMakeLists.txt). A test is a plain function; CHECK records a
+// failure and carries on, REQUIRE also returns from the test.
+using Function = void (*)();
+
+struct Case {
+  std::string name;
+  Function fn;
+};
+
+std::vector<Case>& registry();
+
+struct Registrar {
+  Registrar(const char* name, Function fn);
+};
+
+void record_failure(const char* file, int line, const char* expr);
+
+}  // namespace xiaozi::test
+
+#define XIAOZI_TEST_CONCAT_(a, b) a##b
+#define XIAOZI_TEST_CONCAT(a, b) XIAOZI_TEST_CONCAT_(a, b)
+
+// Defines and registers a test named "<suite>/<name>"; ctest runs each
+// suite listed in tests/CMakeLists.txt as one test.
+#define XIAOZI_TEST(suite, name)                                    \
+  static void XIAOZI_TEST_CONCAT(suite##_, name)();                 \
+  static const ::xiaozi::test::Registrar XIAOZI_TEST_CONCAT(        \
+      xiaozi_test_registrar_, __COUNTER__)(                         \
+      #suite "/" #name, XIAOZI_TEST_CONCAT(suite##_, name));        \
+  static void XIAOZI_TEST_CONCAT(suite##_, name)()
+
+#define CHECK(cond)                                                 \
+  do {                                                              \
+    if (!(cond)) {                                                  \
+      ::xiaozi::test::record_failure(__FILE__, __LINE__, #cond);    \
+    }                                                               \
+  } while (0)
+
+#define REQUIRE(cond)                                               \
+  do {                                                              \
+    if (!(cond)) {                                                  \
+      ::xiaozi::test::record_failure(__FILE__, __LINE__, #cond);    \
+      return;                                                       \
+    }                                                               \
+  } while (0)
+
+#endif  // XIAOZI_TESTS_TEST_H_
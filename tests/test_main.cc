@@ -0,0 +1,80 @@
+// xiaozi_tests: runs every registered test whose name starts with
+// --filter (all of them without one), one line per test, and exits 1 if
+// any failed.
+//
+//   xiaozi_tests [--filter=<prefix>] [--list]
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include "test.h"
+
+namespace xiaozi::test {
+namespace {
+
+int failures = 0;
+
+}  // namespace
+
+std::vector<Case>& registry() {
+  static std::vector<Case> cases;
+  return cases;
+}
+
+Registrar::Registrar(const char* name, Function fn) {
+  registry().push_back(Case{name, fn});
+}
+
+void record_failure(const char* file, int line, const char* expr) {
+  std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expr);
+  ++failures;
+}
+
+}  // namespace xiaozi::test
+
+int main(int argc, char** argv) {
+  using xiaozi::test::failures;
+  std::string filter;
+  bool list_only = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.substr(0, 9) == "--filter=") {
+      filter = std::string(arg.substr(9));
+    } else if (arg == "--list") {
+      list_only = true;
+    } else {
+      std::fprintf(stderr, "usage: %s [--filter=<prefix>] [--list]\n",
+                   argv[0]);
+      return 2;
+    }
+  }
+
+  auto cases = xiaozi::test::registry();
+  std::sort(cases.begin(), cases.end(),
+            [](const auto& a, const auto& b) { return a.name < b.name; });
+  int failed = 0, run = 0;
+  for (const auto& c : cases) {
+    if (c.name.compare(0, filter.size(), filter) != 0) continue;
+    if (list_only) {
+      std::printf("%s\n", c.name.c_str());
+      continue;
+    }
+    const int before = failures;
+    c.fn();
+    ++run;
+    const bool ok = failures == before;
+    if (!ok) ++failed;
+    std::printf("%s %s\n", ok ? "ok  " : "FAIL", c.name.c_str());
+    std::fflush(stdout);
+  }
+  if (list_only) return 0;
+  if (run == 0) {
+    std::fprintf(stderr, "xiaozi_tests: no test matches \"%s\"\n",
+                 filter.c_str());
+    return 1;
+  }
+  std::printf("%d of %d test(s) failed\n", failed, run);
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+// WebSocketTransport reconnecting over wss:// against a TLS 1.3 server in
+// this process: the session resumes, nothing goes out as 0-RTT early data
+// unless asked for, and then only an upgrade request without credentials.
+// The hello always follows the 101.
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/base64.h"
+#include "base/sha1.h"
+#include "net/websocket_transport.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr std::string_view kHello = R"({"type":"hello"})";
+
+// Self-signed P-256 certificate; the client runs with verify_peer off.
+SSL_CTX* server_ctx() {
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  X509_set_issuer_name(cert, X509_get_subject_name(cert));
+  X509_sign(cert, key, EVP_sha256());
+  SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+  SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+  SSL_CTX_use_certificate(ctx, cert);
+  SSL_CTX_use_PrivateKey(ctx, key);
+  SSL_CTX_set_max_early_data(ctx, 16384);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return ctx;
+}
+
+// Serves `count` connections one after another on loopback, answering
+// each upgrade with a 101 and recording what the client sent.
+class TlsServer {
+ public:
+  struct Connection {
+    bool resumed = false;
+    std::string early_data;  // accepted 0-RTT bytes
+    std::string request;     // upgrade request, up to the blank line
+    std::string after_101;   // everything the client sent after the 101
+  };
+
+  explicit TlsServer(int count) : ctx_(server_ctx()) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+        listen(listen_fd_, 4) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len)) {
+      return;
+    }
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this, count] {
+      for (int i = 0; i < count; ++i) serve();
+    });
+  }
+  ~TlsServer() {
+    // Wakes an accept() still waiting for a connection that never came.
+    ::shutdown(listen_fd_, SHUT_RDWR);
+    join();
+    ::close(listen_fd_);
+    SSL_CTX_free(ctx_);
+  }
+
+  int port() const { return port_; }
+  // Valid once every connection has closed; join() waits for that.
+  void join() {
+    if (thread_.joinable()) thread_.join();
+  }
+  const std::vector<Connection>& connections() const { return connections_; }
+
+ private:
+  void serve() {
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) return;
+    Connection c;
+    SSL* ssl = SSL_new(ctx_);
+    SSL_set_fd(ssl, fd);
+    char buf[16384];
+    for (;;) {
+      std::size_t n = 0;
+      const int rc = SSL_read_early_data(ssl, buf, sizeof(buf), &n);
+      if (rc == SSL_READ_EARLY_DATA_ERROR) break;
+      c.early_data.append(buf, n);
+      if (rc == SSL_READ_EARLY_DATA_FINISH) break;
+    }
+    if (SSL_accept(ssl) == 1) {
+      c.resumed = SSL_session_reused(ssl) == 1;
+      std::string in = c.early_data;
+      std::size_t end;
+      int n = 1;
+      while ((end = in.find("\r\n\r\n")) == std::string::npos && n > 0) {
+        n = SSL_read(ssl, buf, sizeof(buf));
+        if (n > 0) in.append(buf, static_cast<std::size_t>(n));
+      }
+      if (end != std::string::npos) {
+        c.request = in.substr(0, end + 4);
+        // Anything past the request before the 101 is a protocol error;
+        // keep it where the test will see it.
+        c.after_101 = in.substr(end + 4);
+        upgrade(ssl, c.request);
+        while ((n = SSL_read(ssl, buf, sizeof(buf))) > 0) {
+          c.after_101.append(buf, static_cast<std::size_t>(n));
+        }
+      }
+      // A connection freed without shutdown drops its session from the
+      // server cache, and with it the client's ticket.
+      SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    ::close(fd);
+    connections_.push_back(std::move(c));
+  }
+
+  static void upgrade(SSL* ssl, std::string_view request) {
+    constexpr std::string_view kKey = "Sec-WebSocket-Key: ";
+    std::string key(request.substr(request.find(kKey) + kKey.size()));
+    key = key.substr(0, key.find("\r\n")) +
+          "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    const std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Accept: " +
+        base64_encode(Sha1::of(
+            {reinterpret_cast<const uint8_t*>(key.data()), key.size()})) +
+        "\r\n\r\n";
+    SSL_write(ssl, response.data(), static_cast<int>(response.size()));
+  }
+
+  SSL_CTX* ctx_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::thread thread_;
+  std::vector<Connection> connections_;
+};
+
+WebSocketTransport::Config config(const TlsServer& server) {
+  WebSocketTransport::Config c;
+  c.url = "wss://127.0.0.1:" + std::to_string(server.port()) + "/";
+  c.verify_peer = false;
+  c.hello = kHello;
+  return c;
+}
+
+// Connects twice through one transport, so the second resumes.
+bool reconnect(WebSocketTransport& transport) {
+  if (!transport.open()) return false;
+  transport.close();
+  if (!transport.open()) return false;
+  transport.close();
+  return true;
+}
+
+// The first frame after the 101 is the masked hello.
+bool hello_first(const std::string& after_101) {
+  if (after_101.size() < 6 + kHello.size() || uint8_t(after_101[0]) != 0x81 ||
+      uint8_t(after_101[1]) != (0x80 | kHello.size())) {
+    return false;
+  }
+  std::string hello = after_101.substr(6, kHello.size());
+  for (std::size_t i = 0; i < hello.size(); ++i) {
+    hello[i] ^= after_101[2 + i % 4];
+  }
+  return hello == kHello;
+}
+
+XIAOZI_TEST(websocket_tls, resumes_without_early_data_by_default) {
+  TlsServer server(2);
+  REQUIRE(server.port() != 0);
+  WebSocketTransport transport(config(server));
+  REQUIRE(reconnect(transport));
+  server.join();
+  const TransportStats s = transport.stats();
+  CHECK(s.connects == 2);
+  CHECK(s.resumed_connects == 1);
+  CHECK(s.early_data_connects == 0);
+  const auto& c = server.connections();
+  REQUIRE(c.size() == 2);
+  CHECK(!c[0].resumed);
+  CHECK(c[1].resumed);
+  CHECK(c[1].early_data.empty());
+  CHECK(hello_first(c[0].after_101));
+  CHECK(hello_first(c[1].after_101));
+}
+
+XIAOZI_TEST(websocket_tls, early_data_carries_only_the_request) {
+  TlsServer server(2);
+  REQUIRE(server.port() != 0);
+  WebSocketTransport::Config c = config(server);
+  c.early_data = true;
+  WebSocketTransport transport(c);
+  REQUIRE(reconnect(transport));
+  server.join();
+  CHECK(transport.stats().early_data_connects == 1);
+  const auto& conns = server.connections();
+  REQUIRE(conns.size() == 2);
+  CHECK(conns[0].early_data.empty());
+  CHECK(conns[1].resumed);
+  CHECK(conns[1].early_data == conns[1].request);
+  CHECK(hello_first(conns[1].after_101));
+}
+
+XIAOZI_TEST(websocket_tls, no_early_data_with_credentials) {
+  TlsServer server(2);
+  REQUIRE(server.port() != 0);
+  WebSocketTransport::Config c = config(server);
+  c.early_data = true;
+  c.headers = {{"Authorization", "Bearer secret"}};
+  WebSocketTransport transport(c);
+  REQUIRE(reconnect(transport));
+  server.join();
+  CHECK(transport.stats().resumed_connects == 1);
+  CHECK(transport.stats().early_data_connects == 0);
+  const auto& conns = server.connections();
+  REQUIRE(conns.size() == 2);
+  CHECK(conns[1].resumed);
+  CHECK(conns[1].early_data.empty());
+  CHECK(conns[1].request.find("Authorization: Bearer secret\r\n") !=
+        std::string::npos);
+}
+
+}  // namespace
+}  // namespace xiaozi
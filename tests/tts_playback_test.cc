@@ -0,0 +1,116 @@
+// TtsPlayback when a reply starts while the previous one is still playing:
+// the previous reply's queued tail must count neither as the new reply's
+// first audio nor, when it runs dry, as the new reply's underrun.
+
+#include <cstdint>
+#include <vector>
+
+#include "codec/decoder_stage.h"
+#include "codec/g711_codec.h"
+#include "codec/tts_playback.h"
+#include "memory/frame_pool.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+constexpr int kSampleRate = 16000;
+constexpr std::size_t kFrameSamples = 960;  // 60 ms
+constexpr std::size_t kRefillSamples = 160;  // 10 ms
+constexpr uint64_t kMs = 1000000;
+
+class Reply {
+ public:
+  Reply()
+      : packets_(kFrameSamples, 8),
+        pcm_(kFrameSamples * sizeof(int16_t), 16),
+        decoder_(kSampleRate, kFrameSamples),
+        stage_(decoder_, pcm_) {}
+
+  DecoderStage& stage() { return stage_; }
+
+  // One decoded frame of mid-level audio, ready for pull().
+  void deliver() {
+    G711Encoder encoder(kSampleRate, kFrameSamples);
+    std::vector<int16_t> pcm(kFrameSamples, 4000);
+    FrameRef packet = packets_.acquire();
+    encoder.encode(pcm, {packet.data(), kFrameSamples});
+    packet.set_size(kFrameSamples);
+    stage_.submit(std::move(packet));
+    stage_.run_once();
+  }
+
+ private:
+  FramePool packets_;
+  FramePool pcm_;
+  G711Decoder decoder_;
+  DecoderStage stage_;
+};
+
+XIAOZI_TEST(tts_playback, first_audio_skips_previous_reply_tail) {
+  Reply source;
+  TtsPlayback playback(source.stage());
+  int16_t block[kRefillSamples];
+  uint64_t now = 0;
+  auto refill = [&] {
+    const std::size_t n = playback.pull(block, now);
+    now += 10 * kMs;
+    return n;
+  };
+
+  // Reply A: two frames, 120 ms, start playing at once.
+  playback.begin(0);
+  source.deliver();
+  source.deliver();
+  playback.end();
+  CHECK(refill() == kRefillSamples);
+  CHECK(playback.stats().first_audio_ns == 0);
+
+  // Reply B starts 10 ms in, with 110 ms of A still queued; its own audio,
+  // all of it, arrives at 300 ms.
+  const uint64_t origin = now;
+  playback.begin(origin);
+  while (now < 300 * kMs) refill();
+  source.deliver();
+  playback.end();
+  const uint64_t first = now;
+  CHECK(refill() == kRefillSamples);
+
+  const TtsPlayback::Stats stats = playback.stats();
+  CHECK(stats.replies == 2);
+  CHECK(stats.first_audio_ns == first - origin);
+}
+
+// The previous reply's tail running dry before the new reply has any audio
+// is the new reply buffering: no underrun, and the threshold stays put.
+XIAOZI_TEST(tts_playback, tail_drain_is_not_an_underrun) {
+  Reply source;
+  TtsPlayback playback(source.stage());
+  int16_t block[kRefillSamples];
+  uint64_t now = 0;
+  auto refill = [&] {
+    const std::size_t n = playback.pull(block, now);
+    now += 10 * kMs;
+    return n;
+  };
+
+  playback.begin(0);
+  source.deliver();
+  playback.end();
+  CHECK(refill() == kRefillSamples);
+  const uint32_t prebuffer = playback.stats().prebuffer_ms;
+
+  // Reply B, not ended, gets one prebuffer's worth of audio only after A's
+  // tail has run out.
+  playback.begin(now);
+  while (now < 200 * kMs) refill();
+  source.deliver();
+  CHECK(refill() == kRefillSamples);
+
+  const TtsPlayback::Stats stats = playback.stats();
+  CHECK(stats.underruns == 0);
+  CHECK(stats.prebuffer_ms == prebuffer);
+}
+
+}  // namespace
+}  // namespace xiaozi
@@ -0,0 +1,317 @@
+// WebSocketTransport against hostile and fragmented frames, over a
+// socketpair standing in for the server, and its ws:// handshake against
+// a one-connection server on loopback.
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/base64.h"
+#include "base/sha1.h"
+#include "net/tcp_stream.h"
+#include "net/websocket_frame.h"
+#include "net/websocket_transport.h"
+#include "test.h"
+
+namespace xiaozi {
+namespace {
+
+// A transport attached to one end of a socketpair; the test writes server
+// frames into the other end.
+struct Connected {
+  explicit Connected(WebSocketTransport::Config config = {})
+      : transport(std::move(config)) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) != 0) return;
+    transport.attach(std::make_unique<TcpStream>(fds[0]));
+    server = fds[1];
+    transport.set_text_handler(
+        [this](std::string_view text) { texts.emplace_back(text); });
+    transport.set_close_handler([this] { ++closes; });
+  }
+  ~Connected() {
+    transport.close();
+    if (server >= 0) ::close(server);
+  }
+
+  void send(const std::vector<uint8_t>& bytes) {
+    CHECK(::write(server, bytes.data(), bytes.size()) ==
+          static_cast<ssize_t>(bytes.size()));
+    for (int i = 0; i < 4 && transport.is_open(); ++i) transport.poll(10);
+  }
+
+  WebSocketTransport transport;
+  int server = -1;
+  std::vector<std::string> texts;
+  int closes = 0;
+};
+
+// An unmasked server frame; `fin` false leaves the message open.
+std::vector<uint8_t> frame(ws::Opcode opcode, std::string_view payload,
+                           bool fin = true) {
+  std::vector<uint8_t> out(ws::kMaxHeaderBytes + payload.size());
+  const std::size_t n =
+      ws::encode_header(out.data(), opcode, payload.size(), false, 0);
+  if (!fin) out[0] &= 0x7f;
+  out.resize(n);
+  out.insert(out.end(), payload.begin(), payload.end());
+  return out;
+}
+
+// Accepts one ws:// connection on loopback and answers its upgrade with a
+// 101 followed by `after_101` in the same write. Records what the client
+// sent before the 101 beyond its request, and everything after it.
+class UpgradeServer {
+ public:
+  explicit UpgradeServer(std::vector<uint8_t> after_101)
+      : after_101_(std::move(after_101)) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), len) != 0 ||
+        listen(listen_fd_, 1) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len)) {
+      return;
+    }
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this] { serve(); });
+  }
+  ~UpgradeServer() {
+    if (thread_.joinable()) thread_.join();
+    ::close(listen_fd_);
+  }
+
+  int port() const { return port_; }
+  std::string url() const {
+    return "ws://127.0.0.1:" + std::to_string(port_) + "/";
+  }
+  // Valid once the client has closed; join() waits for that.
+  void join() {
+    if (thread_.joinable()) thread_.join();
+  }
+  const std::string& request() const { return request_; }
+  const std::string& before_101() const { return before_101_; }
+  const std::string& after_handshake() const { return after_handshake_; }
+
+ private:
+  void serve() {
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) return;
+    std::string in;
+    char buf[4096];
+    std::size_t end;
+    while ((end = in.find("\r\n\r\n")) == std::string::npos) {
+      const ssize_t n = ::read(fd, buf, sizeof(buf));
+      if (n <= 0) {
+        ::close(fd);
+        return;
+      }
+      in.append(buf, static_cast<std::size_t>(n));
+    }
+    request_ = in.substr(0, end + 4);
+    // Give a client that writes ahead of the 101 time to do it.
+    pollfd pfd{fd, POLLIN, 0};
+    while (::poll(&pfd, 1, 50) == 1) {
+      const ssize_t n = ::read(fd, buf, sizeof(buf));
+      if (n <= 0) break;
+      in.append(buf, static_cast<std::size_t>(n));
+    }
+    before_101_ = in.substr(end + 4);
+
+    constexpr std::string_view kKey = "Sec-WebSocket-Key: ";
+    std::string key = request_.substr(request_.find(kKey) + kKey.size());
+    key = key.substr(0, key.find("\r\n")) +
+          "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    std::string response =
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+        "Connection: Upgrade\r\nSec-WebSocket-Accept: " +
+        base64_encode(Sha1::of(
+            {reinterpret_cast<const uint8_t*>(key.data()), key.size()})) +
+        "\r\n\r\n";
+    response.append(after_101_.begin(), after_101_.end());
+    if (::write(fd, response.data(), response.size()) !=
+        static_cast<ssize_t>(response.size())) {
+      ::close(fd);
+      return;
+    }
+    for (;;) {
+      const ssize_t n = ::read(fd, buf, sizeof(buf));
+      if (n <= 0) break;
+      after_handshake_.append(buf, static_cast<std::size_t>(n));
+    }
+    ::close(fd);
+  }
+
+  std::vector<uint8_t> after_101_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::thread thread_;
+  std::string request_;
+  std::string before_101_;
+  std::string after_handshake_;
+};
+
+XIAOZI_TEST(websocket, delivers_frames_sent_with_101) {
+  UpgradeServer server(frame(ws::kText, "welcome"));
+  REQUIRE(server.port() != 0);
+  WebSocketTransport::Config config;
+  config.url = server.url();
+  WebSocketTransport transport(config);
+  std::vector<std::string> texts;
+  transport.set_text_handler(
+      [&](std::string_view text) { texts.emplace_back(text); });
+  REQUIRE(transport.open());
+  // No poll(): the frame arrived with the handshake and must not wait for
+  // another read.
+  REQUIRE(texts.size() == 1);
+  CHECK(texts[0] == "welcome");
+  transport.close();
+  server.join();
+}
+
+// The hello is a frame, and frames may only follow the 101.
+XIAOZI_TEST(websocket, hello_waits_for_101) {
+  UpgradeServer server({});
+  REQUIRE(server.port() != 0);
+  WebSocketTransport::Config config;
+  config.url = server.url();
+  config.hello = R"({"type":"hello"})";
+  WebSocketTransport transport(config);
+  REQUIRE(transport.open());
+  transport.close();
+  server.join();
+  CHECK(server.before_101().empty());
+  const std::string& after = server.after_handshake();
+  REQUIRE(after.size() >= 6 + config.hello.size());
+  CHECK(uint8_t(after[0]) == 0x81);
+  CHECK(uint8_t(after[1]) == (0x80 | config.hello.size()));
+  std::string hello = after.substr(6, config.hello.size());
+  for (std::size_t i = 0; i < hello.size(); ++i) hello[i] ^= after[2 + i % 4];
+  CHECK(hello == config.hello);
+}
+
+XIAOZI_TEST(websocket, delivers_fragmented_message) {
+  Connected c;
+  REQUIRE(c.server >= 0);
+  auto bytes = frame(ws::kText, "hel", false);
+  const auto rest = frame(ws::kContinuation, "lo");
+  bytes.insert(bytes.end(), rest.begin(), rest.end());
+  c.send(bytes);
+  REQUIRE(c.texts.size() == 1);
+  CHECK(c.texts[0] == "hello");
+  CHECK(c.transport.is_open());
+}
+
+// A 64-bit length near 2^64 used to wrap the size check and hand the
+// handler a view far past the receive buffer.
+XIAOZI_TEST(websocket, rejects_wrapping_payload_length) {
+  Connected c;
+  REQUIRE(c.server >= 0);
+  c.send({0x82, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe});
+  CHECK(!c.transport.is_open());
+  CHECK(c.closes == 1);
+}
+
+XIAOZI_TEST(websocket, rejects_frame_over_max_message) {
+  WebSocketTransport::Config config;
+  config.max_message_bytes = 16;
+  Connected c(config);
+  REQUIRE(c.server >= 0);
+  c.send(frame(ws::kText, std::string(17, 'x')));
+  CHECK(c.texts.empty());
+  CHECK(!c.transport.is_open());
+}
+
+XIAOZI_TEST(websocket, caps_message_across_continuations) {
+  WebSocketTransport::Config config;
+  config.max_message_bytes = 16;
+  Connected c(config);
+  REQUIRE(c.server >= 0);
+  std::vector<uint8_t> bytes = frame(ws::kText, std::string(10, 'x'), false);
+  for (int i = 0; i < 3; ++i) {
+    const auto more = frame(ws::kContinuation, std::string(4, 'x'), false);
+    bytes.insert(bytes.end(), more.begin(), more.end());
+  }
+  c.send(bytes);
+  CHECK(c.texts.empty());
+  CHECK(!c.transport.is_open());
+}
+
+XIAOZI_TEST(websocket, rejects_stray_continuation) {
+  Connected c;
+  REQUIRE(c.server >= 0);
+  c.send(frame(ws::kContinuation, "x"));
+  CHECK(!c.transport.is_open());
+}
+
+// Binary messages past max_packet_bytes still arrive whole; one that finds
+// the receive pool empty is counted, not silently lost.
+XIAOZI_TEST(websocket, counts_receive_drops) {
+  WebSocketTransport::Config config;
+  config.receive_pool_blocks = 1;
+  Connected c(config);
+  REQUIRE(c.server >= 0);
+  std::vector<FrameRef> held;
+  c.transport.set_audio_handler(
+      [&](FrameRef packet) { held.push_back(std::move(packet)); });
+  const std::string payload(4000, 'x');
+  c.send(frame(ws::kBinary, payload));
+  REQUIRE(held.size() == 1);
+  CHECK(held[0].size() == payload.size());
+  CHECK(c.transport.stats().packets_rx_dropped == 0);
+  c.send(frame(ws::kBinary, payload));
+  CHECK(held.size() == 1);
+  CHECK(c.transport.stats().packets_rx_dropped == 1);
+  CHECK(c.transport.is_open());
+}
+
+// send_text() and is_open() from another thread while the transport
+// thread closes the connection (a data race on the stream under TSan).
+XIAOZI_TEST(websocket, send_text_races_close) {
+  Connected c;
+  REQUIRE(c.server >= 0);
+  std::atomic<bool> go{false};
+  std::thread sender([&] {
+    while (!go.load()) {
+    }
+    while (c.transport.is_open()) c.transport.send_text("ping");
+    CHECK(!c.transport.send_text("late"));
+  });
+  go.store(true);
+  c.transport.poll(0);
+  c.transport.close();
+  sender.join();
+  CHECK(!c.transport.is_open());
+}
+
+// With more pool blocks than queue slots and no poll() draining the queue,
+// commit() runs out of room and has to say so.
+XIAOZI_TEST(websocket, commit_reports_full_queue) {
+  WebSocketTransport::Config config;
+  config.send_pool_blocks = 2 * WebSocketTransport::kQueuePackets;
+  Connected c(config);
+  REQUIRE(c.server >= 0);
+  std::size_t queued = 0, dropped = 0;
+  for (std::size_t i = 0; i < config.send_pool_blocks; ++i) {
+    std::span<uint8_t> out = c.transport.reserve(16);
+    REQUIRE(!out.empty());
+    (c.transport.commit(out.size(), 0) ? queued : dropped) += 1;
+  }
+  CHECK(queued >= WebSocketTransport::kQueuePackets - 1);
+  CHECK(dropped > 0);
+  CHECK(c.transport.stats().packets_dropped == dropped);
+  CHECK(c.transport.commit(0, 0));
+}
+
+}  // namespace
+}  // namespace xiaozi
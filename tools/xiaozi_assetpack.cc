@@ -0,0 +1,127 @@
+// xiaozi_assetpack: builds the asset pack the firmware maps at boot (see
+// assets/asset_pack.h) from source files. The kind of each asset follows
+// from its extension: .bdf is a font, .ppm/.pam an image, .opus/.ogg a
+// prompt clip; anything else is stored as a blob.
+//
+//   xiaozi_assetpack -o <out.xzap> [--align=<bytes>] <name>=<path>...
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "assets/asset_pack_writer.h"
+#include "assets/asset_sources.h"
+
+namespace {
+
+void usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s -o <out> [--align=<bytes>] <name>=<path>...\n",
+               argv0);
+}
+
+bool read_file(const std::string& path, std::vector<uint8_t>* out) {
+  std::FILE* f = std::fopen(path.c_str(), "rb");
+  if (f == nullptr) return false;
+  uint8_t buf[65536];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+    out->insert(out->end(), buf, buf + n);
+  }
+  const bool ok = !std::ferror(f);
+  std::fclose(f);
+  return ok;
+}
+
+bool ends_with(std::string_view s, std::string_view suffix) {
+  return s.size() >= suffix.size() &&
+         s.substr(s.size() - suffix.size()) == suffix;
+}
+
+// Returns an error message, or nullptr once the asset is added.
+const char* add(xiaozi::AssetPackWriter& writer, std::string_view name,
+                const std::string& path) {
+  std::vector<uint8_t> bytes;
+  if (!read_file(path, &bytes)) return std::strerror(errno);
+  bool added;
+  if (ends_with(path, ".bdf")) {
+    const auto font = xiaozi::parse_bdf(
+        {reinterpret_cast<const char*>(bytes.data()), bytes.size()});
+    if (!font) return "not a BDF font";
+    added = writer.add_font(name, *font);
+  } else if (ends_with(path, ".ppm") || ends_with(path, ".pam")) {
+    const auto image = xiaozi::parse_pnm(bytes);
+    if (!image) return "not an 8-bit RGB or RGBA netpbm image";
+    added = writer.add_image(name, *image);
+  } else if (ends_with(path, ".opus") || ends_with(path, ".ogg")) {
+    const auto clip = xiaozi::parse_ogg_opus(bytes);
+    if (!clip) return "not an Ogg Opus stream";
+    added = writer.add_clip(name, *clip);
+  } else {
+    added = writer.add_blob(name, bytes);
+  }
+  return added ? nullptr : "duplicate name";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string out_path;
+  xiaozi::AssetPackWriter::Config config;
+  std::vector<std::string_view> inputs;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc) {
+      out_path = argv[++i];
+    } else if (arg.starts_with("--align=")) {
+      config.alignment = std::strtoul(argv[i] + 8, nullptr, 10);
+      if (config.alignment == 0) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (arg.find('=') != std::string_view::npos &&
+               !arg.starts_with("-")) {
+      inputs.push_back(arg);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (out_path.empty() || inputs.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  xiaozi::AssetPackWriter writer(config);
+  for (std::string_view input : inputs) {
+    const std::size_t eq = input.find('=');
+    const std::string_view name = input.substr(0, eq);
+    const std::string path(input.substr(eq + 1));
+    if (const char* error = add(writer, name, path)) {
+      std::fprintf(stderr, "xiaozi_assetpack: %s: %s\n", path.c_str(),
+                   error);
+      return 1;
+    }
+  }
+  const auto pack = writer.finish();
+  if (!pack) {
+    std::fprintf(stderr, "xiaozi_assetpack: pack exceeds 4 GiB\n");
+    return 1;
+  }
+
+  std::FILE* out = std::fopen(out_path.c_str(), "wb");
+  if (out == nullptr ||
+      std::fwrite(pack->data(), 1, pack->size(), out) != pack->size() ||
+      std::fclose(out) != 0) {
+    std::fprintf(stderr, "xiaozi_assetpack: cannot write %s: %s\n",
+                 out_path.c_str(), std::strerror(errno));
+    return 1;
+  }
+  std::printf("%s: %zu assets, %zu bytes\n", out_path.c_str(), writer.size(),
+              pack->size());
+  return 0;
+}
@@ -0,0 +1,90 @@
+// xiaozi_gateway: the fleet gateway (see gateway/gateway.h) as a server
+// process. Runs until SIGINT or SIGTERM, then prints its counters.
+//
+//   xiaozi_gateway [--port=<n>] [--shards=<n>] [--backend=<host>:<port>]
+//                  [--public-host=<host>] [--no-pin]
+
+#include <signal.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+#include "gateway/gateway.h"
+
+namespace {
+
+void usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s [--port=<n>] [--shards=<n>] "
+               "[--backend=<host>:<port>] [--public-host=<host>] "
+               "[--no-pin]\n",
+               argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  xiaozi::Gateway::Config config;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--port=")) {
+      config.port = std::atoi(argv[i] + 7);
+    } else if (arg.starts_with("--shards=")) {
+      config.shards = std::strtoul(argv[i] + 9, nullptr, 10);
+    } else if (arg.starts_with("--backend=") &&
+               arg.rfind(':') > std::string_view("--backend=").size()) {
+      const std::size_t colon = arg.rfind(':');
+      config.backend_host = std::string(arg.substr(10, colon - 10));
+      config.backend_port = std::atoi(argv[i] + colon + 1);
+    } else if (arg.starts_with("--public-host=")) {
+      config.public_host = std::string(arg.substr(14));
+    } else if (arg == "--no-pin") {
+      config.pin_threads = false;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  // Blocked before the shard threads exist, so only sigwait() sees them.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  xiaozi::Gateway gateway(config);
+  if (!gateway.start()) {
+    std::fprintf(stderr, "xiaozi_gateway: cannot bind port %d\n",
+                 config.port);
+    return 1;
+  }
+  std::printf("xiaozi_gateway: port %d, %zu shards, backend %s:%d\n",
+              gateway.port(), gateway.shard_count(),
+              config.backend_host.c_str(), config.backend_port);
+  std::fflush(stdout);
+  int signal;
+  sigwait(&signals, &signal);
+  gateway.stop();
+
+  const xiaozi::Gateway::Stats s = gateway.stats();
+  std::printf(
+      "accepted %llu, handed off %llu, rejected %llu\n"
+      "frames %llu, backend records %llu in %llu writes, %llu bytes copied, "
+      "%llu dropped\n"
+      "udp packets %llu, misrouted %llu, rejected %llu\n",
+      static_cast<unsigned long long>(s.accepted),
+      static_cast<unsigned long long>(s.handed_off),
+      static_cast<unsigned long long>(s.rejected),
+      static_cast<unsigned long long>(s.frames),
+      static_cast<unsigned long long>(s.backend.records_sent),
+      static_cast<unsigned long long>(s.backend.writes),
+      static_cast<unsigned long long>(s.backend.copied_bytes),
+      static_cast<unsigned long long>(s.backend.dropped),
+      static_cast<unsigned long long>(s.udp_packets),
+      static_cast<unsigned long long>(s.udp_misrouted),
+      static_cast<unsigned long long>(s.udp_rejected));
+  return 0;
+}
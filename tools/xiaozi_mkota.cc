@@ -0,0 +1,103 @@
+// xiaozi_mkota: builds the update file the device downloads and applies
+// in place (see ota/update_format.h). With --base the file is a delta
+// against that image, which the device must be running; without it the
+// file carries the whole image.
+//
+//   xiaozi_mkota -o <out.xzup> [--base=<old.bin>] [--no-compress]
+//                [--block=<bytes>] <new.bin>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ota/update_writer.h"
+
+namespace {
+
+void usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s -o <out> [--base=<old>] [--no-compress] "
+               "[--block=<bytes>] <new>\n",
+               argv0);
+}
+
+bool read_file(const std::string& path, std::vector<uint8_t>* out) {
+  std::FILE* f = std::fopen(path.c_str(), "rb");
+  if (f == nullptr) return false;
+  uint8_t buf[65536];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+    out->insert(out->end(), buf, buf + n);
+  }
+  const bool ok = !std::ferror(f);
+  std::fclose(f);
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string out_path;
+  std::string base_path;
+  std::string target_path;
+  xiaozi::UpdateWriter::Config config;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg == "-o" && i + 1 < argc) {
+      out_path = argv[++i];
+    } else if (arg.starts_with("--base=")) {
+      base_path = argv[i] + 7;
+    } else if (arg == "--no-compress") {
+      config.compress = false;
+    } else if (arg.starts_with("--block=")) {
+      config.block_bytes =
+          static_cast<uint32_t>(std::strtoul(argv[i] + 8, nullptr, 10));
+      if (config.block_bytes == 0) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (!arg.starts_with("-") && target_path.empty()) {
+      target_path = argv[i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (out_path.empty() || target_path.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> base;
+  std::vector<uint8_t> target;
+  for (const auto& [path, bytes] :
+       {std::pair{&base_path, &base}, std::pair{&target_path, &target}}) {
+    if (!path->empty() && !read_file(*path, bytes)) {
+      std::fprintf(stderr, "xiaozi_mkota: %s: %s\n", path->c_str(),
+                   std::strerror(errno));
+      return 1;
+    }
+  }
+
+  const xiaozi::UpdateWriter writer(config);
+  const std::vector<uint8_t> update =
+      base_path.empty() ? writer.full(target) : writer.delta(base, target);
+
+  std::FILE* out = std::fopen(out_path.c_str(), "wb");
+  if (out == nullptr ||
+      std::fwrite(update.data(), 1, update.size(), out) != update.size() ||
+      std::fclose(out) != 0) {
+    std::fprintf(stderr, "xiaozi_mkota: cannot write %s: %s\n",
+                 out_path.c_str(), std::strerror(errno));
+    return 1;
+  }
+  std::printf("%s: %s of %zu bytes, %zu bytes\n", out_path.c_str(),
+              base_path.empty() ? "full image" : "delta", target.size(),
+              update.size());
+  return 0;
+}
@@ -0,0 +1,205 @@
+// xiaozi_replay: runs a recorded capture (see replay/capture_file.h)
+// through the device audio path on the host, faster than real time and
+// with the same output on every run, for profiling under perf and for
+// chasing latency spikes seen in the field. Prints throughput, per-path
+// processing time, the slowest events with their capture times, digests
+// of the uplink packets and played audio, and the memory domain counters.
+//
+//   xiaozi_replay [--model=<wake.xqn>] [--loop=<n>] [--realtime]
+//                 [--slowest=<n>] <capture.xzrc>
+//   xiaozi_replay --synthesize=<out.xzrc> [--seconds=<n>]
+//
+// --loop replays the capture n times (each run from fresh stages) to give
+// a profiler more samples; runs that disagree are reported. --realtime
+// paces the replay to the capture's own timing.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "audio/int8_net.h"
+#include "base/trace.h"
+#include "memory/memory_domain.h"
+#include "replay/capture_file.h"
+#include "replay/pipeline_replay.h"
+
+namespace {
+
+void usage(const char* argv0) {
+  std::fprintf(stderr,
+               "usage: %s [--model=<file>] [--loop=<n>] [--realtime] "
+               "[--slowest=<n>] <capture>\n"
+               "       %s --synthesize=<out> [--seconds=<n>]\n",
+               argv0, argv0);
+}
+
+bool read_file(const std::string& path, std::vector<uint8_t>* out) {
+  std::FILE* f = std::fopen(path.c_str(), "rb");
+  if (f == nullptr) return false;
+  uint8_t buf[65536];
+  std::size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+    out->insert(out->end(), buf, buf + n);
+  }
+  const bool ok = !std::ferror(f);
+  std::fclose(f);
+  return ok;
+}
+
+std::string hex(const xiaozi::Sha256::Digest& d) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string s;
+  for (uint8_t b : d) {
+    s += kDigits[b >> 4];
+    s += kDigits[b & 15];
+  }
+  return s;
+}
+
+double us(uint64_t ns) { return static_cast<double>(ns) / 1e3; }
+
+void print_latency(const char* path, const xiaozi::PipelineReplay::Latency& l) {
+  std::printf("%s events=%" PRIu64 " p50_us=%.1f p99_us=%.1f max_us=%.1f\n",
+              path, l.count, us(l.p50_ns), us(l.p99_ns), us(l.max_ns));
+}
+
+void print_result(const xiaozi::PipelineReplay::Result& r) {
+  const double capture_s = static_cast<double>(r.capture_ns) / 1e9;
+  const double wall_s = static_cast<double>(r.wall_ns) / 1e9;
+  std::printf("replayed %.1f s of capture in %.3f s (%.0fx real time)\n",
+              capture_s, wall_s, wall_s > 0 ? capture_s / wall_s : 0.0);
+  std::printf("uplink mic_frames=%" PRIu64 " forwarded=%" PRIu64
+              " vad_wakes=%" PRIu64 " wake_detections=%" PRIu64
+              " packets=%" PRIu64 " bytes=%" PRIu64 "\n",
+              r.mic_frames, r.frames_forwarded, r.vad_wakes,
+              r.wake_detections, r.uplink_packets, r.uplink_bytes);
+  std::printf("downlink packets=%" PRIu64 " concealed=%" PRIu64
+              " replies=%" PRIu64 " underruns=%" PRIu64
+              " max_first_audio_ms=%.1f played_samples=%" PRIu64 "\n",
+              r.downlink_packets, r.frames_concealed, r.replies,
+              r.playback_underruns, us(r.max_first_audio_ns) / 1e3,
+              r.played_samples);
+  print_latency("uplink_frame", r.uplink);
+  print_latency("downlink_pop", r.downlink);
+  for (const auto& s : r.slowest) {
+    std::printf("slow %s at_ms=%.1f us=%.1f\n",
+                s.path == xiaozi::PipelineReplay::Path::kUplink ? "uplink"
+                                                                : "downlink",
+                us(s.capture_ns) / 1e3, us(s.wall_ns));
+  }
+  std::printf("uplink_digest %s\nplayback_digest %s\n",
+              hex(r.uplink_digest).c_str(), hex(r.playback_digest).c_str());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string capture_path;
+  std::string model_path;
+  std::string synthesize_path;
+  uint32_t seconds = 60;
+  int loops = 1;
+  xiaozi::PipelineReplay::Config config;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--model=")) {
+      model_path = argv[i] + 8;
+    } else if (arg.starts_with("--loop=")) {
+      loops = std::atoi(argv[i] + 7);
+    } else if (arg == "--realtime") {
+      config.realtime = true;
+    } else if (arg.starts_with("--slowest=")) {
+      config.slowest = std::strtoul(argv[i] + 10, nullptr, 10);
+    } else if (arg.starts_with("--synthesize=")) {
+      synthesize_path = argv[i] + 13;
+    } else if (arg.starts_with("--seconds=")) {
+      seconds = static_cast<uint32_t>(std::strtoul(argv[i] + 10, nullptr, 10));
+    } else if (!arg.starts_with("-") && capture_path.empty()) {
+      capture_path = arg;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (!synthesize_path.empty()) {
+    if (seconds == 0) {
+      usage(argv[0]);
+      return 2;
+    }
+    const std::vector<uint8_t> bytes = xiaozi::synthetic_capture(seconds, 1);
+    std::FILE* f = std::fopen(synthesize_path.c_str(), "wb");
+    if (f == nullptr ||
+        std::fwrite(bytes.data(), 1, bytes.size(), f) != bytes.size() ||
+        std::fclose(f) != 0) {
+      std::fprintf(stderr, "xiaozi_replay: cannot write %s\n",
+                   synthesize_path.c_str());
+      return 1;
+    }
+    return 0;
+  }
+  if (capture_path.empty() || loops < 1) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  xiaozi::CaptureReader capture;
+  if (!capture.load(capture_path)) {
+    std::fprintf(stderr, "xiaozi_replay: %s is not a capture\n",
+                 capture_path.c_str());
+    return 1;
+  }
+  if (capture.truncated()) {
+    std::fprintf(stderr, "xiaozi_replay: %s is cut off; replaying %zu "
+                 "whole records\n", capture_path.c_str(), capture.records());
+  }
+  std::optional<xiaozi::Int8Model> model;
+  if (!model_path.empty()) {
+    std::vector<uint8_t> blob;
+    if (read_file(model_path, &blob)) model = xiaozi::Int8Model::parse(blob);
+    if (!model) {
+      std::fprintf(stderr, "xiaozi_replay: cannot load model %s\n",
+                   model_path.c_str());
+      return 1;
+    }
+    config.wake_model = &*model;
+  }
+
+  xiaozi::PipelineReplay replay(capture.format(), config);
+  if (!replay.ok()) {
+    std::fprintf(stderr,
+                 "xiaozi_replay: this build cannot replay %s (downlink "
+                 "codec or frame size)\n",
+                 capture_path.c_str());
+    return 1;
+  }
+#if defined(XIAOZI_TRACE)
+  xiaozi::trace::reset();
+#endif
+  std::optional<xiaozi::PipelineReplay::Result> first;
+  int mismatches = 0;
+  for (int i = 0; i < loops; ++i) {
+    xiaozi::PipelineReplay::Result r = replay.run(capture);
+    if (!first) {
+      first = std::move(r);
+    } else if (r.uplink_digest != first->uplink_digest ||
+               r.playback_digest != first->playback_digest) {
+      ++mismatches;
+    }
+  }
+  print_result(*first);
+#if defined(XIAOZI_TRACE)
+  std::fputs(xiaozi::trace::format_stats().c_str(), stdout);
+#endif
+  std::fputs(xiaozi::memory::format_stats().c_str(), stdout);
+  if (mismatches != 0) {
+    std::fprintf(stderr, "xiaozi_replay: %d of %d runs gave other output\n",
+                 mismatches, loops);
+    return 1;
+  }
+  return 0;
+}